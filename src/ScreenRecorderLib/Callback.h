@@ -10,17 +10,6 @@ namespace ScreenRecorderLib {
 		Paused,
 		Finishing
 	};
-	public ref class FrameData {
-	public:
-		property String^ Path;
-		property int Delay;
-		FrameData() {}
-		FrameData(String^ path, int delay) {
-			Path = path;
-			Delay = delay;
-		}
-	};
-
 	public ref class FrameBitmapData {
 	public:
 		property int Stride;
@@ -28,6 +17,7 @@ namespace ScreenRecorderLib {
 		property int Height;
 		property IntPtr Data;
 		property int Length;
+		property VideoFramePreviewFormat Format;
 		FrameBitmapData() {}
 		FrameBitmapData(int stride, byte* data, int length, int width, int height) {
 			Stride = stride;
@@ -35,7 +25,121 @@ namespace ScreenRecorderLib {
 			Length = length;
 			Width = width;
 			Height = height;
+			Format = VideoFramePreviewFormat::BGRA;
+		}
+		FrameBitmapData(int stride, byte* data, int length, int width, int height, VideoFramePreviewFormat format) {
+			Stride = stride;
+			Data = IntPtr(data);
+			Length = length;
+			Width = width;
+			Height = height;
+			Format = format;
+		}
+	};
+
+	public ref class FramePreviewStatistics {
+	public:
+		/// <summary>
+		/// Frames delivered through the OnFrameRecorded event with a bitmap.
+		/// </summary>
+		property UInt64 DeliveredFrameCount;
+		/// <summary>
+		/// Frames that were due for a bitmap, but were delivered without one because the GPU or the event handler was not keeping up, the bitmap could not be read back, or the device was reinitialized.
+		/// </summary>
+		property UInt64 DroppedFrameCount;
+		/// <summary>
+		/// Frames delivered without a bitmap to keep the previews at VideoFramePreviewFramerate.
+		/// </summary>
+		property UInt64 SkippedFrameCount;
+		/// <summary>
+		/// Total milliseconds the recording thread has spent on previews, including resizing and readback.
+		/// </summary>
+		property double RecordingThreadMillis;
+		/// <summary>
+		/// Total milliseconds of GPU time spent resizing and copying previews.
+		/// </summary>
+		property double GpuMillis;
+		/// <summary>
+		/// Total milliseconds spent converting previews to VideoFramePreviewFormat, excluding the event handlers.
+		/// </summary>
+		property double ProcessingMillis;
+	};
+
+	public ref class SnapshotStatistics {
+	public:
+		/// <summary>
+		/// Snapshots written successfully.
+		/// </summary>
+		property UInt64 WrittenCount;
+		/// <summary>
+		/// Snapshots discarded because the snapshot queue was full.
+		/// </summary>
+		property UInt64 DroppedCount;
+		/// <summary>
+		/// Snapshots that failed to encode or write.
+		/// </summary>
+		property UInt64 FailedCount;
+		/// <summary>
+		/// Snapshots currently waiting for a worker.
+		/// </summary>
+		property UInt32 QueueDepth;
+		/// <summary>
+		/// The highest number of snapshots that have been waiting for a worker at the same time.
+		/// </summary>
+		property UInt32 MaxQueueDepth;
+		/// <summary>
+		/// The average milliseconds from a snapshot being taken until it is written.
+		/// </summary>
+		property double AverageLatencyMillis;
+		/// <summary>
+		/// The longest milliseconds from a snapshot being taken until it is written.
+		/// </summary>
+		property double MaxLatencyMillis;
+	};
+	public ref class LatencyHistogram {
+	public:
+		/// <summary>
+		/// The number of recorded values.
+		/// </summary>
+		property UInt64 Count;
+		property UInt64 Min;
+		property UInt64 Max;
+		property double Mean;
+		/// <summary>
+		/// The median. Percentiles are accurate to about 3%.
+		/// </summary>
+		property UInt64 P50;
+		property UInt64 P90;
+		property UInt64 P99;
+		property UInt64 P999;
+	};
+	public ref class GaugeValue {
+	public:
+		property Int64 Value;
+		/// <summary>
+		/// The highest value since the recording started.
+		/// </summary>
+		property Int64 MaxValue;
+	};
+	public ref class RecorderStatistics {
+	public:
+		RecorderStatistics() {
+			Counters = gcnew Dictionary<String^, UInt64>();
+			Gauges = gcnew Dictionary<String^, GaugeValue^>();
+			Histograms = gcnew Dictionary<String^, LatencyHistogram^>();
 		}
+		/// <summary>
+		/// Event counts, e.g. "capture.dropped_frames".
+		/// </summary>
+		property Dictionary<String^, UInt64>^ Counters;
+		/// <summary>
+		/// Current levels, e.g. "audio.output.buffered_bytes".
+		/// </summary>
+		property Dictionary<String^, GaugeValue^>^ Gauges;
+		/// <summary>
+		/// Latency distributions. Names ending with "_us" are in microseconds, e.g. "encoder.video_write_us".
+		/// </summary>
+		property Dictionary<String^, LatencyHistogram^>^ Histograms;
 	};
 
 	public ref class RecordingStatusEventArgs :System::EventArgs {
@@ -48,10 +152,13 @@ namespace ScreenRecorderLib {
 	public ref class RecordingCompleteEventArgs :System::EventArgs {
 	public:
 		property String^ FilePath;
-		property  List<FrameData^>^ FrameInfos;
-		RecordingCompleteEventArgs(String^ path, List<FrameData^>^ frameInfos) {
+		/// <summary>
+		///For slideshows, the path of the manifest listing the frames in order, with one JSON object per line containing the frame number, image path and delay in milliseconds. Null for other recording modes.
+		/// </summary>
+		property String^ ManifestFilePath;
+		RecordingCompleteEventArgs(String^ path, String^ manifestPath) {
 			FilePath = path;
-			FrameInfos = frameInfos;
+			ManifestFilePath = manifestPath;
 		}
 	};
 	public ref class RecordingFailedEventArgs :System::EventArgs {
@@ -88,6 +195,102 @@ namespace ScreenRecorderLib {
 		}
 	};
 
+	public ref class QualityChangedEventArgs :System::EventArgs {
+	public:
+		/// <summary>
+		/// 0 is the configured quality. Higher levels lower the quality further.
+		/// </summary>
+		property int Level;
+		/// <summary>
+		/// The frame rate recorded at, or the maximum frame rate if the frame rate is not fixed.
+		/// </summary>
+		property double Framerate;
+		/// <summary>
+		/// The fraction of the configured bitrate, or of the configured quality with quality based rate control, that is encoded at.
+		/// </summary>
+		property double BitrateScale;
+		QualityChangedEventArgs() {}
+		QualityChangedEventArgs(int level, double framerate, double bitrateScale) {
+			Level = level;
+			Framerate = framerate;
+			BitrateScale = bitrateScale;
+		}
+	};
+
+	public ref class SegmentCompletedEventArgs :System::EventArgs {
+	public:
+		property String^ FilePath;
+		/// <summary>
+		/// The index of the segment, starting at 0. The first segment is written to the output path, and the following ones get the index appended to the file name, e.g. recording_001.mp4.
+		/// </summary>
+		property int Index;
+		/// <summary>
+		/// The start of the segment, in milliseconds from the start of the recording.
+		/// </summary>
+		property INT64 StartMillis;
+		property INT64 DurationMillis;
+		SegmentCompletedEventArgs() {}
+		SegmentCompletedEventArgs(String^ path, int index, INT64 startMillis, INT64 durationMillis) {
+			FilePath = path;
+			Index = index;
+			StartMillis = startMillis;
+			DurationMillis = durationMillis;
+		}
+	};
+
+	public enum class EncodedPacketType {
+		Video,
+		Audio
+	};
+
+	/// <summary>
+	/// An encoded video frame or block of AAC audio. The data is lent from the recorder, and is only valid until the event handler returns. Use ToArray to keep it.
+	/// </summary>
+	public ref class EncodedPacketEventArgs :System::EventArgs {
+	public:
+		property EncodedPacketType PacketType;
+		/// <summary>
+		/// The presentation timestamp, in 100 nanosecond units.
+		/// </summary>
+		property INT64 Timestamp;
+		/// <summary>
+		/// The duration, in 100 nanosecond units.
+		/// </summary>
+		property INT64 Duration;
+		/// <summary>
+		/// True for video frames that can be decoded without the frames before them.
+		/// </summary>
+		property bool IsKeyFrame;
+		property IntPtr Data;
+		property int Length;
+		/// <summary>
+		/// The sequence and picture parameter sets in Annex B format, and for HEVC the video parameter set. Only set on video key frames.
+		/// </summary>
+		property IntPtr ParameterSets;
+		property int ParameterSetsLength;
+		EncodedPacketEventArgs() {}
+		EncodedPacketEventArgs(EncodedPacketType packetType, INT64 timestamp, INT64 duration, bool isKeyFrame, const byte *data, int length, const byte *parameterSets, int parameterSetsLength) {
+			PacketType = packetType;
+			Timestamp = timestamp;
+			Duration = duration;
+			IsKeyFrame = isKeyFrame;
+			Data = IntPtr(const_cast<byte *>(data));
+			Length = length;
+			ParameterSets = IntPtr(const_cast<byte *>(parameterSets));
+			ParameterSetsLength = parameterSetsLength;
+		}
+		/// <summary>
+		/// Copies the packet data to a new array.
+		/// </summary>
+		array<byte>^ ToArray() {
+			array<byte>^ data = gcnew array<byte>(Length);
+			if (Length > 0) {
+				System::Runtime::InteropServices::Marshal::Copy(Data, data, 0, Length);
+			}
+			return data;
+		}
+	};
+
 	public ref class FrameDataRecordedEventArgs :System::EventArgs {
 	public:
 		property FrameBitmapData^ BitmapData;
@@ -72,6 +72,8 @@ namespace ScreenRecorderLib {
 		ReadDelegate^ m_ReadDelegate;
 		WriteDelegate^ m_WriteDelegate;
 		SetLengthDelegate^ m_SetLengthDelegate;
+		//Reused between writes, as the recording is written in blocks of several megabytes, which would otherwise each be allocated on the large object heap.
+		cli::array<byte, 1>^ m_WriteBuffer;
 
 		long long GetLength() {
 			return m_Stream->Length;
@@ -95,9 +97,11 @@ namespace ScreenRecorderLib {
 			return bytesRead;
 		};
 		void Write(System::IntPtr source, int offset, int count) {
-			auto tempBytes = gcnew cli::array<byte, 1>(count);
-			System::Runtime::InteropServices::Marshal::Copy(source, tempBytes, 0, count);
-			return m_Stream->Write(tempBytes, offset, count);
+			if (m_WriteBuffer == nullptr || m_WriteBuffer->Length < count) {
+				m_WriteBuffer = gcnew cli::array<byte, 1>(count);
+			}
+			System::Runtime::InteropServices::Marshal::Copy(source, m_WriteBuffer, 0, count);
+			return m_Stream->Write(m_WriteBuffer, offset, count);
 		};
 		void SetLength(long long value) {
 			return m_Stream->SetLength(value);
@@ -31,7 +31,9 @@ namespace ScreenRecorderLib {
 		PNG,
 		JPEG,
 		TIFF,
-		BMP
+		BMP,
+		///<summary>"Quite OK Image" format. Always encoded with the built-in encoder, as Windows has no codec for it.</summary>
+		QOI
 	};
 
 	public enum class AudioChannels {
@@ -56,6 +58,59 @@ namespace ScreenRecorderLib {
 		Screenshot = (int)RecorderModeInternal::Screenshot
 	};
 
+	public enum class Compositor {
+		///<summary>Compose frames on the GPU with Direct3D shaders. Falls back to Software if the shaders can't be created.</summary>
+		Direct3D = (int)CompositorBackend::Direct3D,
+		///<summary>Compose frames on the CPU. This is slower, but does not depend on the shader support of the graphics device.</summary>
+		Software = (int)CompositorBackend::Software
+	};
+
+	public enum class SnapshotEncoderType {
+		///<summary>Snapshots are encoded with Windows Imaging Component.</summary>
+		WIC = (int)SnapshotEncoderBackend::WIC,
+		///<summary>PNG and BMP snapshots are encoded with the built-in encoders, which are faster than WIC for large images. Other formats fall back to WIC.</summary>
+		BuiltIn = (int)SnapshotEncoderBackend::BuiltIn
+	};
+
+	public enum class SnapshotOverflowPolicy {
+		///<summary>When the snapshot queue is full, new snapshots are discarded.</summary>
+		Drop = (int)SnapshotQueuePolicy::Drop,
+		///<summary>When the snapshot queue is full, the most recently queued snapshot is replaced with the new one, so the latest frame is always saved.</summary>
+		Coalesce = (int)SnapshotQueuePolicy::Coalesce
+	};
+
+	public enum class LateFramePolicy {
+		///<summary>The frames missed while a frame was late are dropped, and the frame is shown from the latest frame time that is due.</summary>
+		Drop = (int)FrameSchedulePolicy::Drop,
+		///<summary>The late frame is repeated for each of the frames missed, so the frame count catches up with the framerate.</summary>
+		Duplicate = (int)FrameSchedulePolicy::Duplicate,
+		///<summary>The late frame is written once, with a duration that covers the frames missed.</summary>
+		StretchDuration = (int)FrameSchedulePolicy::StretchDuration
+	};
+
+	public enum class EncoderOverloadPolicy {
+		///<summary>The recording waits up to a frame duration for the encoder to release a frame, and drops the new frame if it does not.</summary>
+		Wait = (int)InFlightFramePolicy::Wait,
+		///<summary>The new frame is dropped right away.</summary>
+		Drop = (int)InFlightFramePolicy::Drop
+	};
+
+	public enum class VideoFramePreviewFormat {
+		///<summary>32bpp BGRA pixels.</summary>
+		BGRA = (int)FramePreviewFormat::BGRA,
+		///<summary>8 bit 4:2:0 in BT.709 limited range. A Y plane with a stride equal to the width, followed by an interleaved UV plane with a stride equal to the width rounded up to an even number.</summary>
+		NV12 = (int)FramePreviewFormat::NV12,
+		///<summary>A complete JPEG file.</summary>
+		JPEG = (int)FramePreviewFormat::JPEG
+	};
+
+	public enum class VideoBitstreamFormat {
+		///<summary>NAL units separated by start codes, with the parameter sets repeated in each key frame.</summary>
+		AnnexB = (int)BitstreamFormat::AnnexB,
+		///<summary>NAL units prefixed with their 4 byte big endian length, as in MP4 and AVCC. The parameter sets are only passed in EncodedPacketEventArgs.ParameterSets.</summary>
+		LengthPrefixed = (int)BitstreamFormat::LengthPrefixed
+	};
+
 	public ref class SourceOptions : public INotifyPropertyChanged {
 	private:
 		List<RecordingSourceBase^>^ _recordingSources;
@@ -93,12 +148,16 @@ namespace ScreenRecorderLib {
 		Nullable<bool> _isVideoCaptureEnabled;
 		Nullable<bool> _isVideoFramePreviewEnabled;
 		ScreenSize^ _videoFramePreviewSize;
+		Nullable<double> _videoFramePreviewFramerate;
+		Nullable<ScreenRecorderLib::VideoFramePreviewFormat> _videoFramePreviewFormat;
 	public:
 		DynamicOutputOptions() {
 			SourceRect = ScreenRect::Empty;
 			IsVideoCaptureEnabled = true;
 			IsVideoFramePreviewEnabled = false;
 			VideoFramePreviewSize = ScreenSize::Empty;
+			VideoFramePreviewFramerate = 0;
+			VideoFramePreviewFormat = ScreenRecorderLib::VideoFramePreviewFormat::BGRA;
 		}
 		virtual event PropertyChangedEventHandler^ PropertyChanged;
 		void OnPropertyChanged(String^ info)
@@ -159,18 +218,68 @@ namespace ScreenRecorderLib {
 				}
 			}
 		}
+		/// <summary>
+		/// The maximum number of video frame bitmaps per second. Frames in between are reported without a bitmap, and are not copied from the GPU. 0 generates a bitmap for every recorded frame.
+		/// </summary>
+		property Nullable<double> VideoFramePreviewFramerate {
+			Nullable<double> get() {
+				return _videoFramePreviewFramerate;
+			}
+			void set(Nullable<double> value) {
+				if (!Object::Equals(_videoFramePreviewFramerate, value)) {
+					_videoFramePreviewFramerate = value;
+					OnPropertyChanged("VideoFramePreviewFramerate");
+				}
+			}
+		}
+		/// <summary>
+		/// The pixel format of the video frame bitmaps. Default is BGRA.
+		/// </summary>
+		property Nullable<ScreenRecorderLib::VideoFramePreviewFormat> VideoFramePreviewFormat {
+			Nullable<ScreenRecorderLib::VideoFramePreviewFormat> get() {
+				return _videoFramePreviewFormat;
+			}
+			void set(Nullable<ScreenRecorderLib::VideoFramePreviewFormat> value) {
+				if (!Object::Equals(_videoFramePreviewFormat, value)) {
+					_videoFramePreviewFormat = value;
+					OnPropertyChanged("VideoFramePreviewFormat");
+				}
+			}
+		}
 	};
 
+	ref class AdditionalOutputOptions;
+
 	public ref class OutputOptions :public DynamicOutputOptions {
 	private:
+		List<AdditionalOutputOptions^>^ _additionalOutputs;
 		StretchMode _stretch;
 		ScreenSize^ _outputFrameSize;
 		RecorderMode _recorderMode;
+		ScreenRecorderLib::Compositor _compositor;
+		int _segmentDurationMillis;
+		Int64 _maxSegmentSizeBytes;
+		int _replayBufferDurationMillis;
+		Int64 _replayBufferMaxSizeBytes;
+		bool _isBitstreamOutputEnabled;
+		VideoBitstreamFormat _bitstreamFormat;
+		int _maxQueuedBitstreamPackets;
+		int _streamWriteBufferSizeBytes;
 	public:
 		OutputOptions() :DynamicOutputOptions() {
 			Stretch = StretchMode::Uniform;
 			OutputFrameSize = ScreenSize::Empty;
 			RecorderMode = ScreenRecorderLib::RecorderMode::Video;
+			Compositor = ScreenRecorderLib::Compositor::Direct3D;
+			AdditionalOutputs = gcnew List<AdditionalOutputOptions^>();
+			SegmentDurationMillis = 0;
+			MaxSegmentSizeBytes = 0;
+			ReplayBufferDurationMillis = 0;
+			ReplayBufferMaxSizeBytes = 0;
+			IsBitstreamOutputEnabled = false;
+			BitstreamFormat = VideoBitstreamFormat::AnnexB;
+			MaxQueuedBitstreamPackets = 64;
+			StreamWriteBufferSizeBytes = 2 * 1024 * 1024;
 		}
 
 		/// <summary>
@@ -207,11 +316,137 @@ namespace ScreenRecorderLib {
 				OnPropertyChanged("RecorderMode");
 			}
 		}
+		/// <summary>
+		/// How frames, overlays and the mouse pointer are composed. Default is Direct3D.
+		/// </summary>
+		property ScreenRecorderLib::Compositor Compositor {
+			ScreenRecorderLib::Compositor get() {
+				return _compositor;
+			}
+			void set(ScreenRecorderLib::Compositor value) {
+				_compositor = value;
+				OnPropertyChanged("Compositor");
+			}
+		}
+		/// <summary>
+		/// Video files recorded at the same time as the main output, from the same captured frames. Each output is encoded on its own thread, so a slow output does not hold back the others. Only used in video mode.
+		/// </summary>
+		property List<AdditionalOutputOptions^>^ AdditionalOutputs {
+			List<AdditionalOutputOptions^>^ get() {
+				return _additionalOutputs;
+			}
+			void set(List<AdditionalOutputOptions^>^ value) {
+				_additionalOutputs = value;
+				OnPropertyChanged("AdditionalOutputs");
+			}
+		}
+		/// <summary>
+		/// Splits a video recorded to a file into segments of this duration. The first segment is written to the output path, and the following ones get their index appended to the file name, e.g. recording_001.mp4.
+		/// Each segment starts at a key frame and can be played on its own. 0 disables splitting by duration. Default is 0.
+		/// </summary>
+		property int SegmentDurationMillis {
+			int get() {
+				return _segmentDurationMillis;
+			}
+			void set(int value) {
+				_segmentDurationMillis = value;
+				OnPropertyChanged("SegmentDurationMillis");
+			}
+		}
+		/// <summary>
+		/// Splits a video recorded to a file into segments of about this size. A new segment is started at the first frame after the limit is reached, so segments can be slightly larger. 0 disables splitting by size. Default is 0.
+		/// </summary>
+		property Int64 MaxSegmentSizeBytes {
+			Int64 get() {
+				return _maxSegmentSizeBytes;
+			}
+			void set(Int64 value) {
+				_maxSegmentSizeBytes = value;
+				OnPropertyChanged("MaxSegmentSizeBytes");
+			}
+		}
+		/// <summary>
+		/// Keeps the last encoded video and audio of this duration in memory, instead of writing the recording to a file or stream. Call Recorder.SaveReplay to write it to an MP4 file without encoding it again.
+		/// The buffer is trimmed at key frames, which are forced every 2 seconds, so up to 2 seconds more can be kept. Only used in video mode. 0 disables the replay buffer. Default is 0.
+		/// </summary>
+		property int ReplayBufferDurationMillis {
+			int get() {
+				return _replayBufferDurationMillis;
+			}
+			void set(int value) {
+				_replayBufferDurationMillis = value;
+				OnPropertyChanged("ReplayBufferDurationMillis");
+			}
+		}
+		/// <summary>
+		/// The maximum size of the encoded video and audio kept in the replay buffer. 0 only limits the buffer by ReplayBufferDurationMillis. Default is 0.
+		/// </summary>
+		property Int64 ReplayBufferMaxSizeBytes {
+			Int64 get() {
+				return _replayBufferMaxSizeBytes;
+			}
+			void set(Int64 value) {
+				_replayBufferMaxSizeBytes = value;
+				OnPropertyChanged("ReplayBufferMaxSizeBytes");
+			}
+		}
+		/// <summary>
+		/// Raise Recorder.OnEncodedPacket with each encoded video frame and block of audio, for streaming them without reading a file.
+		/// Call Recorder.Record without a path or stream to only receive the packets. When recording to a file or stream at the same time, it is written by the built-in muxer, and is not split into segments.
+		/// B-frames are disabled, so the packets arrive in presentation order. Only used in video mode. Default is false.
+		/// </summary>
+		property bool IsBitstreamOutputEnabled {
+			bool get() {
+				return _isBitstreamOutputEnabled;
+			}
+			void set(bool value) {
+				_isBitstreamOutputEnabled = value;
+				OnPropertyChanged("IsBitstreamOutputEnabled");
+			}
+		}
+		/// <summary>
+		/// The format of the video passed to Recorder.OnEncodedPacket. Default is AnnexB.
+		/// </summary>
+		property VideoBitstreamFormat BitstreamFormat {
+			VideoBitstreamFormat get() {
+				return _bitstreamFormat;
+			}
+			void set(VideoBitstreamFormat value) {
+				_bitstreamFormat = value;
+				OnPropertyChanged("BitstreamFormat");
+			}
+		}
+		/// <summary>
+		/// The number of packets that can wait for the Recorder.OnEncodedPacket handlers. When it is full, packets are dropped, and video is dropped until the next key frame. Default is 64.
+		/// </summary>
+		property int MaxQueuedBitstreamPackets {
+			int get() {
+				return _maxQueuedBitstreamPackets;
+			}
+			void set(int value) {
+				_maxQueuedBitstreamPackets = value;
+				OnPropertyChanged("MaxQueuedBitstreamPackets");
+			}
+		}
+		/// <summary>
+		/// When recording to a stream, the video is collected in buffers of this size, which are written to the stream on a background thread. This makes far fewer calls to the stream, and a slow stream does not hold up the encoder.
+		/// The recording is fully written to the stream before Recorder.OnRecordingComplete is raised. 0 writes to the stream directly. Default is 2 MB.
+		/// </summary>
+		property int StreamWriteBufferSizeBytes {
+			int get() {
+				return _streamWriteBufferSizeBytes;
+			}
+			void set(int value) {
+				_streamWriteBufferSizeBytes = value;
+				OnPropertyChanged("StreamWriteBufferSizeBytes");
+			}
+		}
 	};
 
 	public ref class VideoEncoderOptions : public INotifyPropertyChanged {
 	private:
 		int _framerate;
+		double _minFramerate;
 		int _quality;
 		int _bitrate;
 		bool _isFixedFramerate;
@@ -220,10 +455,18 @@ namespace ScreenRecorderLib {
 		bool _isHardwareEncodingEnabled;
 		bool _isMp4FastStartEnabled;
 		bool _isFragmentedMp4Enabled;
+		bool _isNativeMuxerEnabled;
+		int _fragmentDurationMillis;
+		ScreenRecorderLib::LateFramePolicy _lateFramePolicy;
+		bool _isAdaptiveQualityEnabled;
+		int _maxInFlightFrames;
+		INT64 _maxInFlightBytes;
+		ScreenRecorderLib::EncoderOverloadPolicy _encoderOverloadPolicy;
 		IVideoEncoder^ _encoder = gcnew H264VideoEncoder();
 	public:
 		VideoEncoderOptions() {
 			Framerate = 30;
+			MinFramerate = 2;
 			Quality = 70;
 			Bitrate = 4000 * 1000;
 			IsFixedFramerate = false;
@@ -232,6 +475,13 @@ namespace ScreenRecorderLib {
 			IsHardwareEncodingEnabled = true;
 			IsMp4FastStartEnabled = true;
 			IsFragmentedMp4Enabled = false;
+			IsNativeMuxerEnabled = false;
+			FragmentDurationMillis = 0;
+			LateFramePolicy = ScreenRecorderLib::LateFramePolicy::StretchDuration;
+			IsAdaptiveQualityEnabled = false;
+			MaxInFlightFrames = 0;
+			MaxInFlightBytes = 0;
+			EncoderOverloadPolicy = ScreenRecorderLib::EncoderOverloadPolicy::Wait;
 			Encoder = gcnew H264VideoEncoder();
 		}
 		virtual event PropertyChangedEventHandler^ PropertyChanged;
@@ -240,7 +490,7 @@ namespace ScreenRecorderLib {
 			PropertyChanged(this, gcnew PropertyChangedEventArgs(info));
 		}
 		/// <summary>
-		///Framerate in frames per second.
+		///Framerate in frames per second. If IsFixedFramerate is false, this is the maximum framerate.
 		/// </summary>
 		property int Framerate {
 			int get() {
@@ -252,6 +502,18 @@ namespace ScreenRecorderLib {
 			}
 		}
 		/// <summary>
+		///The minimum framerate in frames per second, if IsFixedFramerate is false. Frames are only written when the content changes, and at this rate while it does not. The default is 2, and the lowest value used is 0.1.
+		/// </summary>
+		property double MinFramerate {
+			double get() {
+				return _minFramerate;
+			}
+			void set(double value) {
+				_minFramerate = value;
+				OnPropertyChanged("MinFramerate");
+			}
+		}
+		/// <summary>
 		///Bitrate in bits per second
 		/// </summary>
 		property int Bitrate {
@@ -348,6 +610,90 @@ namespace ScreenRecorderLib {
 			}
 		}
 		/// <summary>
+		/// Write the mp4 file with the built-in muxer instead of the Windows one. It writes the file as the frames are encoded, with fewer and larger writes. B-frames are disabled, and IsMp4FastStartEnabled is not supported. The default is false.
+		/// </summary>
+		property bool IsNativeMuxerEnabled {
+			bool get() {
+				return _isNativeMuxerEnabled;
+			}
+			void set(bool value) {
+				_isNativeMuxerEnabled = value;
+				OnPropertyChanged("IsNativeMuxerEnabled");
+			}
+		}
+		/// <summary>
+		/// The minimum duration of each fragment of a fragmented mp4 file, in milliseconds. Only used when IsNativeMuxerEnabled and IsFragmentedMp4Enabled are set. A key frame is written at this interval. 0 starts a fragment at each key frame of the encoder.
+		/// </summary>
+		property int FragmentDurationMillis {
+			int get() {
+				return _fragmentDurationMillis;
+			}
+			void set(int value) {
+				_fragmentDurationMillis = value;
+				OnPropertyChanged("FragmentDurationMillis");
+			}
+		}
+		/// <summary>
+		/// What happens to the frames missed when a frame is late, for example after the system stalls. Only used when IsFixedFramerate is set. The default is StretchDuration.
+		/// </summary>
+		property ScreenRecorderLib::LateFramePolicy LateFramePolicy {
+			ScreenRecorderLib::LateFramePolicy get() {
+				return _lateFramePolicy;
+			}
+			void set(ScreenRecorderLib::LateFramePolicy value) {
+				_lateFramePolicy = value;
+				OnPropertyChanged("LateFramePolicy");
+			}
+		}
+		/// <summary>
+		/// Lower the frame rate and bitrate in steps while the encoder cannot keep up, and restore them when it has recovered. Changes are reported with Recorder.OnQualityChanged. The default is false.
+		/// </summary>
+		property bool IsAdaptiveQualityEnabled {
+			bool get() {
+				return _isAdaptiveQualityEnabled;
+			}
+			void set(bool value) {
+				_isAdaptiveQualityEnabled = value;
+				OnPropertyChanged("IsAdaptiveQualityEnabled");
+			}
+		}
+		/// <summary>
+		/// The maximum number of frames written to the encoder that it has not finished with. Bounds the memory used when the encoder falls behind, also with IsThrottlingDisabled. 0 does not limit the frames. The default is 0.
+		/// </summary>
+		property int MaxInFlightFrames {
+			int get() {
+				return _maxInFlightFrames;
+			}
+			void set(int value) {
+				_maxInFlightFrames = value;
+				OnPropertyChanged("MaxInFlightFrames");
+			}
+		}
+		/// <summary>
+		/// The maximum size in bytes of the frames written to the encoder that it has not finished with. 0 does not limit the size. The default is 0.
+		/// </summary>
+		property INT64 MaxInFlightBytes {
+			INT64 get() {
+				return _maxInFlightBytes;
+			}
+			void set(INT64 value) {
+				_maxInFlightBytes = value;
+				OnPropertyChanged("MaxInFlightBytes");
+			}
+		}
+		/// <summary>
+		/// What happens to a frame when the encoder holds MaxInFlightFrames or MaxInFlightBytes. The default is Wait.
+		/// </summary>
+		property ScreenRecorderLib::EncoderOverloadPolicy EncoderOverloadPolicy {
+			ScreenRecorderLib::EncoderOverloadPolicy get() {
+				return _encoderOverloadPolicy;
+			}
+			void set(ScreenRecorderLib::EncoderOverloadPolicy value) {
+				_encoderOverloadPolicy = value;
+				OnPropertyChanged("EncoderOverloadPolicy");
+			}
+		}
+		/// <summary>
 		/// Set the video encoder to use. Current supported encoders are H264VideoEncoder and H265VideoEncoder.
 		/// </summary>
 		property IVideoEncoder^ Encoder {
@@ -361,17 +707,96 @@ namespace ScreenRecorderLib {
 		}
 	};
 
+	/// <summary>
+	/// A video file recorded at the same time as the main output, from the same captured frames, with its own frame size and encoder options.
+	/// </summary>
+	public ref class AdditionalOutputOptions : public INotifyPropertyChanged {
+	private:
+		String^ _path;
+		ScreenSize^ _outputFrameSize;
+		ScreenRecorderLib::VideoEncoderOptions^ _videoEncoderOptions;
+		int _maxQueuedFrames;
+	public:
+		AdditionalOutputOptions() {
+			OutputFrameSize = ScreenSize::Empty;
+			MaxQueuedFrames = 8;
+		}
+		virtual event PropertyChangedEventHandler^ PropertyChanged;
+		void OnPropertyChanged(String^ info)
+		{
+			PropertyChanged(this, gcnew PropertyChangedEventArgs(info));
+		}
+		/// <summary>
+		/// The path of the video file.
+		/// </summary>
+		property String^ Path {
+			String^ get() {
+				return _path;
+			}
+			void set(String^ value) {
+				_path = value;
+				OnPropertyChanged("Path");
+			}
+		}
+		/// <summary>
+		/// The frame size of the output in pixels. If empty, the frame size of the main output is used.
+		/// </summary>
+		property ScreenSize^ OutputFrameSize {
+			ScreenSize^ get() {
+				return _outputFrameSize;
+			}
+			void set(ScreenSize^ value) {
+				_outputFrameSize = value;
+				OnPropertyChanged("OutputFrameSize");
+			}
+		}
+		/// <summary>
+		/// The encoder options of the output. If null, the encoder options of the main output are used. A framerate below the framerate of the main output is reached by skipping frames.
+		/// </summary>
+		property ScreenRecorderLib::VideoEncoderOptions^ VideoEncoderOptions {
+			ScreenRecorderLib::VideoEncoderOptions^ get() {
+				return _videoEncoderOptions;
+			}
+			void set(ScreenRecorderLib::VideoEncoderOptions^ value) {
+				_videoEncoderOptions = value;
+				OnPropertyChanged("VideoEncoderOptions");
+			}
+		}
+		/// <summary>
+		/// The maximum number of frames waiting to be encoded for this output. When it is reached, new frames are dropped for this output only, and the other outputs are not affected. Default is 8.
+		/// </summary>
+		property int MaxQueuedFrames {
+			int get() {
+				return _maxQueuedFrames;
+			}
+			void set(int value) {
+				_maxQueuedFrames = value;
+				OnPropertyChanged("MaxQueuedFrames");
+			}
+		}
+	};
+
 	public ref class SnapshotOptions : public INotifyPropertyChanged {
 	private:
 		ImageFormat _snapshotFormat;
 		bool _snapshotsWithVideo;
 		int _snapshotsIntervalMillis;
 		String^ _snapshotsDirectory;
+		int _workerCount;
+		int _maxQueuedSnapshots;
+		SnapshotOverflowPolicy _overflowPolicy;
+		SnapshotEncoderType _encoderType;
+		int _encoderThreadCount;
 	public:
 		SnapshotOptions() {
 			SnapshotFormat = ImageFormat::PNG;
 			SnapshotsWithVideo = false;
 			SnapshotsIntervalMillis = 10000;
+			WorkerCount = 1;
+			MaxQueuedSnapshots = 3;
+			OverflowPolicy = SnapshotOverflowPolicy::Coalesce;
+			EncoderType = SnapshotEncoderType::WIC;
+			EncoderThreadCount = 0;
 		}
 		virtual event PropertyChangedEventHandler^ PropertyChanged;
 		void OnPropertyChanged(String^ info)
@@ -426,6 +851,66 @@ namespace ScreenRecorderLib {
 				OnPropertyChanged("SnapshotsDirectory");
 			}
 		}
+		/// <summary>
+		///The number of threads encoding snapshots in parallel. Default is 1.
+		/// </summary>
+		property int WorkerCount {
+			int get() {
+				return _workerCount;
+			}
+			void set(int value) {
+				_workerCount = value;
+				OnPropertyChanged("WorkerCount");
+			}
+		}
+		/// <summary>
+		///The maximum number of snapshots waiting to be encoded. When exceeded, OverflowPolicy decides which snapshot is discarded. Default is 3.
+		/// </summary>
+		property int MaxQueuedSnapshots {
+			int get() {
+				return _maxQueuedSnapshots;
+			}
+			void set(int value) {
+				_maxQueuedSnapshots = value;
+				OnPropertyChanged("MaxQueuedSnapshots");
+			}
+		}
+		/// <summary>
+		///What to do with new snapshots when the snapshot queue is full. Default is Coalesce.
+		/// </summary>
+		property SnapshotOverflowPolicy OverflowPolicy {
+			SnapshotOverflowPolicy get() {
+				return _overflowPolicy;
+			}
+			void set(SnapshotOverflowPolicy value) {
+				_overflowPolicy = value;
+				OnPropertyChanged("OverflowPolicy");
+			}
+		}
+		/// <summary>
+		///The encoder used for PNG and BMP snapshots. Default is WIC.
+		/// </summary>
+		property SnapshotEncoderType EncoderType {
+			SnapshotEncoderType get() {
+				return _encoderType;
+			}
+			void set(SnapshotEncoderType value) {
+				_encoderType = value;
+				OnPropertyChanged("EncoderType");
+			}
+		}
+		/// <summary>
+		///The maximum number of threads used to encode one PNG snapshot with the built-in encoder. Large images are split into row bands that are compressed in parallel. 0 uses all hardware threads. Default is 0.
+		/// </summary>
+		property int EncoderThreadCount {
+			int get() {
+				return _encoderThreadCount;
+			}
+			void set(int value) {
+				_encoderThreadCount = value;
+				OnPropertyChanged("EncoderThreadCount");
+			}
+		}
 	};
 
 	public ref class DynamicAudioOptions : public INotifyPropertyChanged {
@@ -4,7 +4,6 @@
 #include <msclr\marshal_cppstd.h>
 #include "ManagedIStream.h"
 using namespace ScreenRecorderLib;
-using namespace nlohmann;
 
 Recorder::Recorder(RecorderOptions^ options)
 {
@@ -18,43 +17,60 @@ Recorder::Recorder(RecorderOptions^ options)
 	SetOptions(options);
 }
 
+ENCODER_OPTIONS* Recorder::CreateEncoderOptions(_In_ VideoEncoderOptions^ videoEncoderOptions) {
+	if (!videoEncoderOptions->Encoder) {
+		videoEncoderOptions->Encoder = gcnew H264VideoEncoder();
+	}
+	ENCODER_OPTIONS* encoderOptions = nullptr;
+
+	switch (videoEncoderOptions->Encoder->EncodingFormat)
+	{
+		default:
+		case VideoEncoderFormat::H264: {
+			encoderOptions = new H264_ENCODER_OPTIONS();
+			break;
+		}
+		case VideoEncoderFormat::H265: {
+			encoderOptions = new H265_ENCODER_OPTIONS();
+			break;
+		}
+	}
+	encoderOptions->SetVideoBitrateMode((UINT32)videoEncoderOptions->Encoder->GetBitrateMode());
+	encoderOptions->SetEncoderProfile((UINT32)videoEncoderOptions->Encoder->GetEncoderProfile());
+	encoderOptions->SetVideoBitrate(videoEncoderOptions->Bitrate);
+	encoderOptions->SetVideoQuality(videoEncoderOptions->Quality);
+	encoderOptions->SetVideoFps(videoEncoderOptions->Framerate);
+	encoderOptions->SetMinVideoFps(videoEncoderOptions->MinFramerate);
+	encoderOptions->SetFixedFramerate(videoEncoderOptions->IsFixedFramerate);
+	encoderOptions->SetThrottlingDisabled(videoEncoderOptions->IsThrottlingDisabled);
+	encoderOptions->SetLowLatencyModeEnabled(videoEncoderOptions->IsLowLatencyEnabled);
+	encoderOptions->SetFastStartEnabled(videoEncoderOptions->IsMp4FastStartEnabled);
+	encoderOptions->SetHardwareEncodingEnabled(videoEncoderOptions->IsHardwareEncodingEnabled);
+	encoderOptions->SetFragmentedMp4Enabled(videoEncoderOptions->IsFragmentedMp4Enabled);
+	encoderOptions->SetNativeMuxerEnabled(videoEncoderOptions->IsNativeMuxerEnabled);
+	encoderOptions->SetFragmentDuration(std::chrono::milliseconds(videoEncoderOptions->FragmentDurationMillis > 0 ? videoEncoderOptions->FragmentDurationMillis : 0));
+	encoderOptions->SetFrameSchedulePolicy(static_cast<FrameSchedulePolicy>(videoEncoderOptions->LateFramePolicy));
+	encoderOptions->SetIsAdaptiveQualityEnabled(videoEncoderOptions->IsAdaptiveQualityEnabled);
+	encoderOptions->SetMaxInFlightFrames(videoEncoderOptions->MaxInFlightFrames > 0 ? videoEncoderOptions->MaxInFlightFrames : 0);
+	encoderOptions->SetMaxInFlightBytes(videoEncoderOptions->MaxInFlightBytes > 0 ? videoEncoderOptions->MaxInFlightBytes : 0);
+	encoderOptions->SetInFlightFramePolicy(static_cast<InFlightFramePolicy>(videoEncoderOptions->EncoderOverloadPolicy));
+	return encoderOptions;
+}
+
 void Recorder::SetOptions(RecorderOptions^ options) {
 	if (options && m_Rec && !m_Rec->IsRecording()) {
 		if (options->VideoEncoderOptions) {
-			if (!options->VideoEncoderOptions->Encoder) {
-				options->VideoEncoderOptions->Encoder = gcnew H264VideoEncoder();
-			}
-			ENCODER_OPTIONS* encoderOptions = nullptr;
-
-			switch (options->VideoEncoderOptions->Encoder->EncodingFormat)
-			{
-				default:
-				case VideoEncoderFormat::H264: {
-					encoderOptions = new H264_ENCODER_OPTIONS();
-					break;
-				}
-				case VideoEncoderFormat::H265: {
-					encoderOptions = new H265_ENCODER_OPTIONS();
-					break;
-				}
-			}
-			encoderOptions->SetVideoBitrateMode((UINT32)options->VideoEncoderOptions->Encoder->GetBitrateMode());
-			encoderOptions->SetEncoderProfile((UINT32)options->VideoEncoderOptions->Encoder->GetEncoderProfile());
-			encoderOptions->SetVideoBitrate(options->VideoEncoderOptions->Bitrate);
-			encoderOptions->SetVideoQuality(options->VideoEncoderOptions->Quality);
-			encoderOptions->SetVideoFps(options->VideoEncoderOptions->Framerate);
-			encoderOptions->SetFixedFramerate(options->VideoEncoderOptions->IsFixedFramerate);
-			encoderOptions->SetThrottlingDisabled(options->VideoEncoderOptions->IsThrottlingDisabled);
-			encoderOptions->SetLowLatencyModeEnabled(options->VideoEncoderOptions->IsLowLatencyEnabled);
-			encoderOptions->SetFastStartEnabled(options->VideoEncoderOptions->IsMp4FastStartEnabled);
-			encoderOptions->SetHardwareEncodingEnabled(options->VideoEncoderOptions->IsHardwareEncodingEnabled);
-			encoderOptions->SetFragmentedMp4Enabled(options->VideoEncoderOptions->IsFragmentedMp4Enabled);
-			m_Rec->SetEncoderOptions(encoderOptions);
+			m_Rec->SetEncoderOptions(CreateEncoderOptions(options->VideoEncoderOptions));
 		}
 		if (options->SnapshotOptions) {
 			SNAPSHOT_OPTIONS* snapshotOptions = new SNAPSHOT_OPTIONS();
 			snapshotOptions->SetTakeSnapshotsWithVideo(options->SnapshotOptions->SnapshotsWithVideo);
 			snapshotOptions->SetSnapshotsWithVideoInterval(options->SnapshotOptions->SnapshotsIntervalMillis);
+			snapshotOptions->SetWorkerCount(options->SnapshotOptions->WorkerCount > 0 ? options->SnapshotOptions->WorkerCount : 1);
+			snapshotOptions->SetMaxQueuedSnapshots(options->SnapshotOptions->MaxQueuedSnapshots > 0 ? options->SnapshotOptions->MaxQueuedSnapshots : 1);
+			snapshotOptions->SetQueuePolicy(static_cast<SnapshotQueuePolicy>(options->SnapshotOptions->OverflowPolicy));
+			snapshotOptions->SetEncoderBackend(static_cast<SnapshotEncoderBackend>(options->SnapshotOptions->EncoderType));
+			snapshotOptions->SetEncoderThreadCount(options->SnapshotOptions->EncoderThreadCount > 0 ? options->SnapshotOptions->EncoderThreadCount : 0);
 			if (options->SnapshotOptions->SnapshotsDirectory != nullptr) {
 				snapshotOptions->SetSnapshotDirectory(msclr::interop::marshal_as<std::wstring>(options->SnapshotOptions->SnapshotsDirectory));
 			}
@@ -69,6 +85,9 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 				case ImageFormat::TIFF:
 					snapshotOptions->SetSnapshotSaveFormat(GUID_ContainerFormatTiff);
 					break;
+				case ImageFormat::QOI:
+					snapshotOptions->SetSnapshotSaveFormat(GUID_ContainerFormatQoi);
+					break;
 				default:
 				case ImageFormat::PNG:
 					snapshotOptions->SetSnapshotSaveFormat(GUID_ContainerFormatPng);
@@ -89,12 +108,55 @@ void Recorder::SetOptions(RecorderOptions^ options) {
 			}
 			outputOptions->SetRecorderMode(static_cast<RecorderModeInternal>(options->OutputOptions->RecorderMode));
 			outputOptions->SetStretch(static_cast<TextureStretchMode>(options->OutputOptions->Stretch));
+			outputOptions->SetCompositorBackend(static_cast<CompositorBackend>(options->OutputOptions->Compositor));
 			if (options->OutputOptions->IsVideoFramePreviewEnabled.HasValue) {
 				outputOptions->SetVideoFramePreviewEnabled(options->OutputOptions->IsVideoFramePreviewEnabled.Value);
 			}
 			if (options->OutputOptions->VideoFramePreviewSize && !options->OutputOptions->VideoFramePreviewSize->Equals(ScreenSize::Empty)) {
 				outputOptions->SetVideoFramePreviewSize(SIZE{ (long)round(options->OutputOptions->VideoFramePreviewSize->Width),(long)round(options->OutputOptions->VideoFramePreviewSize->Height) });
 			}
+			if (options->OutputOptions->VideoFramePreviewFramerate.HasValue) {
+				outputOptions->SetVideoFramePreviewFramerate(options->OutputOptions->VideoFramePreviewFramerate.Value);
+			}
+			if (options->OutputOptions->VideoFramePreviewFormat.HasValue) {
+				outputOptions->SetVideoFramePreviewFormat(static_cast<FramePreviewFormat>(options->OutputOptions->VideoFramePreviewFormat.Value));
+			}
+			if (options->OutputOptions->AdditionalOutputs) {
+				std::vector<ADDITIONAL_OUTPUT> additionalOutputs{};
+				for each (AdditionalOutputOptions^ managedOutput in options->OutputOptions->AdditionalOutputs)
+				{
+					if (!managedOutput || String::IsNullOrEmpty(managedOutput->Path)) {
+						continue;
+					}
+					ADDITIONAL_OUTPUT output{};
+					output.Path = msclr::interop::marshal_as<std::wstring>(managedOutput->Path);
+					if (managedOutput->OutputFrameSize && !managedOutput->OutputFrameSize->Equals(ScreenSize::Empty)) {
+						output.FrameSize = SIZE{ (long)round(managedOutput->OutputFrameSize->Width),(long)round(managedOutput->OutputFrameSize->Height) };
+					}
+					if (managedOutput->VideoEncoderOptions) {
+						output.EncoderOptions.reset(CreateEncoderOptions(managedOutput->VideoEncoderOptions));
+					}
+					output.MaxQueuedFrames = managedOutput->MaxQueuedFrames > 0 ? managedOutput->MaxQueuedFrames : 1;
+					additionalOutputs.push_back(output);
+				}
+				outputOptions->SetAdditionalOutputs(additionalOutputs);
+			}
+			if (options->OutputOptions->SegmentDurationMillis > 0) {
+				outputOptions->SetSegmentDuration(std::chrono::milliseconds(options->OutputOptions->SegmentDurationMillis));
+			}
+			if (options->OutputOptions->MaxSegmentSizeBytes > 0) {
+				outputOptions->SetMaxSegmentSize(static_cast<UINT64>(options->OutputOptions->MaxSegmentSizeBytes));
+			}
+			if (options->OutputOptions->ReplayBufferDurationMillis > 0) {
+				outputOptions->SetReplayBufferDuration(std::chrono::milliseconds(options->OutputOptions->ReplayBufferDurationMillis));
+			}
+			if (options->OutputOptions->ReplayBufferMaxSizeBytes > 0) {
+				outputOptions->SetReplayBufferMaxSize(static_cast<UINT64>(options->OutputOptions->ReplayBufferMaxSizeBytes));
+			}
+			outputOptions->SetBitstreamOutputEnabled(options->OutputOptions->IsBitstreamOutputEnabled);
+			outputOptions->SetBitstreamFormat(static_cast<BitstreamFormat>(options->OutputOptions->BitstreamFormat));
+			outputOptions->SetMaxQueuedBitstreamPackets(options->OutputOptions->MaxQueuedBitstreamPackets > 0 ? options->OutputOptions->MaxQueuedBitstreamPackets : 1);
+			outputOptions->SetStreamWriteBufferSize(options->OutputOptions->StreamWriteBufferSizeBytes > 0 ? options->OutputOptions->StreamWriteBufferSizeBytes : 0);
 			m_Rec->SetOutputOptions(outputOptions);
 		}
 		if (options->AudioOptions) {
@@ -171,6 +233,64 @@ DynamicOptionsBuilder^ ScreenRecorderLib::Recorder::GetDynamicOptionsBuilder()
 	return gcnew DynamicOptionsBuilder(this);
 }
 
+FramePreviewStatistics^ Recorder::GetFramePreviewStatistics()
+{
+	FRAME_PREVIEW_STATISTICS stats = m_Rec->GetFramePreviewStatistics();
+	FramePreviewStatistics^ managedStats = gcnew FramePreviewStatistics();
+	managedStats->DeliveredFrameCount = stats.DeliveredFrameCount;
+	managedStats->DroppedFrameCount = stats.DroppedFrameCount;
+	managedStats->SkippedFrameCount = stats.SkippedFrameCount;
+	managedStats->RecordingThreadMillis = stats.RecordingThreadMillis;
+	managedStats->GpuMillis = stats.GpuMillis;
+	managedStats->ProcessingMillis = stats.ProcessingMillis;
+	return managedStats;
+}
+
+SnapshotStatistics^ Recorder::GetSnapshotStatistics()
+{
+	SNAPSHOT_STATISTICS stats = m_Rec->GetSnapshotStatistics();
+	SnapshotStatistics^ managedStats = gcnew SnapshotStatistics();
+	managedStats->WrittenCount = stats.WrittenCount;
+	managedStats->DroppedCount = stats.DroppedCount;
+	managedStats->FailedCount = stats.FailedCount;
+	managedStats->QueueDepth = stats.QueueDepth;
+	managedStats->MaxQueueDepth = stats.MaxQueueDepth;
+	managedStats->AverageLatencyMillis = stats.AverageLatencyMillis;
+	managedStats->MaxLatencyMillis = stats.MaxLatencyMillis;
+	return managedStats;
+}
+
+RecorderStatistics^ Recorder::GetStatistics()
+{
+	METRICS_SNAPSHOT snapshot = m_Rec->GetStatistics();
+	RecorderStatistics^ managedStats = gcnew RecorderStatistics();
+	for each (const METRIC_COUNTER_VALUE &counter in snapshot.Counters)
+	{
+		managedStats->Counters[gcnew String(counter.Name.c_str())] = counter.Value;
+	}
+	for each (const METRIC_GAUGE_VALUE &gauge in snapshot.Gauges)
+	{
+		GaugeValue^ value = gcnew GaugeValue();
+		value->Value = gauge.Value;
+		value->MaxValue = gauge.MaxValue;
+		managedStats->Gauges[gcnew String(gauge.Name.c_str())] = value;
+	}
+	for each (const METRIC_HISTOGRAM_VALUE &histogram in snapshot.Histograms)
+	{
+		LatencyHistogram^ value = gcnew LatencyHistogram();
+		value->Count = histogram.Count;
+		value->Min = histogram.Min;
+		value->Max = histogram.Max;
+		value->Mean = histogram.Mean;
+		value->P50 = histogram.P50;
+		value->P90 = histogram.P90;
+		value->P99 = histogram.P99;
+		value->P999 = histogram.P999;
+		managedStats->Histograms[gcnew String(histogram.Name.c_str())] = value;
+	}
+	return managedStats;
+}
+
 void Recorder::SetDynamicOptions(DynamicOptions^ options)
 {
 	if (options->AudioOptions) {
@@ -220,6 +340,12 @@ void Recorder::SetDynamicOptions(DynamicOptions^ options)
 		if (options->OutputOptions->VideoFramePreviewSize) {
 			m_Rec->GetOutputOptions()->SetVideoFramePreviewSize(options->OutputOptions->VideoFramePreviewSize->ToSIZE());
 		}
+		if (options->OutputOptions->VideoFramePreviewFramerate.HasValue) {
+			m_Rec->GetOutputOptions()->SetVideoFramePreviewFramerate(options->OutputOptions->VideoFramePreviewFramerate.Value);
+		}
+		if (options->OutputOptions->VideoFramePreviewFormat.HasValue) {
+			m_Rec->GetOutputOptions()->SetVideoFramePreviewFormat(static_cast<FramePreviewFormat>(options->OutputOptions->VideoFramePreviewFormat.Value));
+		}
 	}
 	if (options->SourceRects) {
 		for each (KeyValuePair<String^, ScreenRect^> ^ kvp in options->SourceRects)
@@ -375,6 +501,21 @@ bool Recorder::SetExcludeFromCapture(System::IntPtr hwnd, bool isExcluded)
 	return RecordingManager::SetExcludeFromCapture((HWND)hwnd.ToPointer(), isExcluded);
 }
 
+void Recorder::SetTracingEnabled(bool isEnabled)
+{
+	RecordingManager::SetTracingEnabled(isEnabled);
+}
+
+bool Recorder::WriteTrace(String^ path)
+{
+	return SUCCEEDED(RecordingManager::WriteTrace(msclr::interop::marshal_as<std::wstring>(path)));
+}
+
+void Recorder::ClearTrace()
+{
+	RecordingManager::ClearTrace();
+}
+
 List<AudioDevice^>^ Recorder::GetSystemAudioDevices(AudioDeviceSource source)
 {
 	std::map<std::wstring, std::wstring> map;
@@ -560,6 +701,18 @@ OutputDimensions^ Recorder::GetOutputDimensionsForRecordingSources(IEnumerable<R
 				}
 				break;
 			}
+			case RecordingSourceType::Synthetic: {
+				for each (RecordingSourceBase ^ recordingSource in recordingSources)
+				{
+					if (isinst<SyntheticRecordingSource^>(recordingSource)) {
+						if ((gcnew String(nativeSource->ID.c_str()))->Equals(recordingSource->ID)) {
+							outputDimensions->OutputCoordinates->Add(gcnew SourceCoordinates(recordingSource, gcnew ScreenRect(nativeSourceRect.left, nativeSourceRect.top, RectWidth(nativeSourceRect), RectHeight(nativeSourceRect))));
+							break;
+						}
+					}
+				}
+				break;
+			}
 			default:
 				break;
 		}
@@ -642,6 +795,10 @@ void Recorder::Record(System::IO::Stream^ stream) {
 	m_ManagedStream = new ManagedIStream(stream);
 	m_Rec->BeginRecording(m_ManagedStream);
 }
+void Recorder::Record() {
+	SetupCallbacks();
+	m_Rec->BeginRecording(L"");
+}
 void Recorder::Record(System::String^ path) {
 	SetupCallbacks();
 	std::wstring stdPathString = msclr::interop::marshal_as<std::wstring>(path);
@@ -674,12 +831,27 @@ bool Recorder::TakeSnapshot(System::IO::Stream^ stream) {
 	OutputDebugStringW(L"Snapshot returning");
 	return SUCCEEDED(hr);
 }
+bool Recorder::SaveReplay(System::String^ path)
+{
+	std::wstring stdPathString = msclr::interop::marshal_as<std::wstring>(path);
+	HRESULT hr = m_Rec->SaveReplay(stdPathString);
+	return SUCCEEDED(hr);
+}
+bool Recorder::SaveReplay(System::IO::Stream^ stream) {
+	ManagedIStream* interopStream = new ManagedIStream(stream);
+	HRESULT hr = m_Rec->SaveReplay(interopStream);
+	interopStream->Release();
+	return SUCCEEDED(hr);
+}
 void Recorder::SetupCallbacks() {
 	CreateErrorCallback();
 	CreateCompletionCallback();
 	CreateStatusCallback();
 	CreateSnapshotCallback();
 	CreateFrameNumberCallback();
+	CreateQualityChangedCallback();
+	CreateSegmentCompletedCallback();
+	CreateEncodedPacketCallback();
 }
 
 void Recorder::ReleaseCallbacks() {
@@ -693,6 +865,12 @@ void Recorder::ReleaseCallbacks() {
 		_snapshotDelegateGcHandler.Free();
 	if (_frameNumberDelegateGcHandler.IsAllocated)
 		_frameNumberDelegateGcHandler.Free();
+	if (_qualityChangedDelegateGcHandler.IsAllocated)
+		_qualityChangedDelegateGcHandler.Free();
+	if (_segmentCompletedDelegateGcHandler.IsAllocated)
+		_segmentCompletedDelegateGcHandler.Free();
+	if (_encodedPacketDelegateGcHandler.IsAllocated)
+		_encodedPacketDelegateGcHandler.Free();
 }
 
 void Recorder::ReleaseResources() {
@@ -829,6 +1007,17 @@ HRESULT Recorder::CreateOrUpdateNativeRecordingSource(_In_ RecordingSourceBase^
 			hr = S_OK;
 		}
 	}
+	else if (isinst<SyntheticRecordingSource^>(managedSource)) {
+		SyntheticRecordingSource^ syntheticSource = (SyntheticRecordingSource^)managedSource;
+		pNativeSource->Type = RecordingSourceType::Synthetic;
+		if (syntheticSource->Size) {
+			pNativeSource->SyntheticOptions.Size = syntheticSource->Size->ToSIZE();
+		}
+		pNativeSource->SyntheticOptions.FrameRate = syntheticSource->FrameRate;
+		pNativeSource->SyntheticOptions.DirtyRegionPattern = static_cast<SyntheticDirtyPattern>(syntheticSource->DirtyRegionPattern);
+		pNativeSource->SyntheticOptions.IsCursorMotionEnabled = syntheticSource->IsCursorMotionEnabled;
+		hr = S_OK;
+	}
 	else {
 		return E_NOTIMPL;
 	}
@@ -1051,16 +1240,31 @@ void Recorder::CreateFrameNumberCallback() {
 	CallbackFrameNumberChangedFunction cb = static_cast<CallbackFrameNumberChangedFunction>(ip.ToPointer());
 	m_Rec->RecordingFrameNumberChangedCallback = cb;
 }
-void Recorder::EventComplete(std::wstring path, fifo_map<std::wstring, int> delays)
+void Recorder::CreateQualityChangedCallback() {
+	InternalQualityChangedCallbackDelegate^ fp = gcnew InternalQualityChangedCallbackDelegate(this, &Recorder::EventQualityChanged);
+	_qualityChangedDelegateGcHandler = GCHandle::Alloc(fp);
+	IntPtr ip = Marshal::GetFunctionPointerForDelegate(fp);
+	CallbackQualityChangedFunction cb = static_cast<CallbackQualityChangedFunction>(ip.ToPointer());
+	m_Rec->RecordingQualityChangedCallback = cb;
+}
+void Recorder::CreateSegmentCompletedCallback() {
+	InternalSegmentCompletedCallbackDelegate^ fp = gcnew InternalSegmentCompletedCallbackDelegate(this, &Recorder::EventSegmentCompleted);
+	_segmentCompletedDelegateGcHandler = GCHandle::Alloc(fp);
+	IntPtr ip = Marshal::GetFunctionPointerForDelegate(fp);
+	CallbackSegmentCompletedFunction cb = static_cast<CallbackSegmentCompletedFunction>(ip.ToPointer());
+	m_Rec->RecordingSegmentCompletedCallback = cb;
+}
+void Recorder::CreateEncodedPacketCallback() {
+	InternalEncodedPacketCallbackDelegate^ fp = gcnew InternalEncodedPacketCallbackDelegate(this, &Recorder::EventEncodedPacket);
+	_encodedPacketDelegateGcHandler = GCHandle::Alloc(fp);
+	IntPtr ip = Marshal::GetFunctionPointerForDelegate(fp);
+	CallbackEncodedPacketFunction cb = static_cast<CallbackEncodedPacketFunction>(ip.ToPointer());
+	m_Rec->RecordingEncodedPacketCallback = cb;
+}
+void Recorder::EventComplete(std::wstring path, std::wstring manifestPath)
 {
 	ReleaseResources();
-
-	List<FrameData^>^ frameInfos = gcnew List<FrameData^>();
-
-	for (auto x : delays) {
-		frameInfos->Add(gcnew FrameData(gcnew String(x.first.c_str()), x.second));
-	}
-	RecordingCompleteEventArgs^ args = gcnew RecordingCompleteEventArgs(gcnew String(path.c_str()), frameInfos);
+	RecordingCompleteEventArgs^ args = gcnew RecordingCompleteEventArgs(gcnew String(path.c_str()), manifestPath.empty() ? nullptr : gcnew String(manifestPath.c_str()));
 	OnRecordingComplete(this, args);
 }
 void Recorder::EventFailed(std::wstring error, std::wstring path)
@@ -1084,8 +1288,24 @@ void Recorder::FrameNumberChanged(int newFrameNumber, INT64 timestamp, FRAME_BIT
 {
 	FrameBitmapData^ managedFrameData = nullptr;
 	if (frameData != nullptr) {
-		managedFrameData = gcnew FrameBitmapData(frameData->Stride, frameData->Data, frameData->Length, frameData->Width, frameData->Height);
+		managedFrameData = gcnew FrameBitmapData(frameData->Stride, frameData->Data, frameData->Length, frameData->Width, frameData->Height, static_cast<VideoFramePreviewFormat>(frameData->Format));
 	}
 	OnFrameRecorded(this, gcnew FrameRecordedEventArgs(newFrameNumber, timestamp, managedFrameData));
 	CurrentFrameNumber = newFrameNumber;
 }
+
+void Recorder::EventQualityChanged(int level, double framerate, double bitrateScale)
+{
+	OnQualityChanged(this, gcnew QualityChangedEventArgs(level, framerate, bitrateScale));
+}
+
+void Recorder::EventSegmentCompleted(std::wstring path, int index, INT64 startMillis, INT64 durationMillis)
+{
+	OnSegmentCompleted(this, gcnew SegmentCompletedEventArgs(gcnew String(path.c_str()), index, startMillis, durationMillis));
+}
+
+void Recorder::EventEncodedPacket(const BITSTREAM_PACKET *pPacket)
+{
+	EncodedPacketType packetType = pPacket->Stream == PacketStream::Video ? EncodedPacketType::Video : EncodedPacketType::Audio;
+	OnEncodedPacket(this, gcnew EncodedPacketEventArgs(packetType, pPacket->Timestamp, pPacket->Duration, pPacket->IsKeyFrame, pPacket->pData, static_cast<int>(pPacket->Size), pPacket->pParameterSets, static_cast<int>(pPacket->ParameterSetsSize)));
+}
@@ -18,10 +18,13 @@ using namespace System::Collections::Generic;
 using namespace System::ComponentModel;
 
 delegate void InternalStatusCallbackDelegate(int status);
-delegate void InternalCompletionCallbackDelegate(std::wstring path, nlohmann::fifo_map<std::wstring, int>);
+delegate void InternalCompletionCallbackDelegate(std::wstring path, std::wstring manifestPath);
 delegate void InternalErrorCallbackDelegate(std::wstring error, std::wstring path);
 delegate void InternalSnapshotCallbackDelegate(std::wstring path);
 delegate void InternalFrameNumberCallbackDelegate(int newFrameNumber, INT64 timestamp, FRAME_BITMAP_DATA* data);
+delegate void InternalQualityChangedCallbackDelegate(int level, double framerate, double bitrateScale);
+delegate void InternalSegmentCompletedCallbackDelegate(std::wstring path, int index, INT64 startMillis, INT64 durationMillis);
+delegate void InternalEncodedPacketCallbackDelegate(const BITSTREAM_PACKET *pPacket);
 namespace ScreenRecorderLib {
 
 	ref class DynamicOptionsBuilder;
@@ -60,11 +63,17 @@ namespace ScreenRecorderLib {
 		void CreateStatusCallback();
 		void CreateSnapshotCallback();
 		void CreateFrameNumberCallback();
-		void EventComplete(std::wstring path, nlohmann::fifo_map<std::wstring, int> delays);
+		void CreateQualityChangedCallback();
+		void CreateSegmentCompletedCallback();
+		void CreateEncodedPacketCallback();
+		void EventComplete(std::wstring path, std::wstring manifestPath);
 		void EventFailed(std::wstring error, std::wstring path);
 		void EventStatusChanged(int status);
 		void EventSnapshotCreated(std::wstring str);
 		void FrameNumberChanged(int newFrameNumber, INT64 timestamp, FRAME_BITMAP_DATA* data);
+		void EventQualityChanged(int level, double framerate, double bitrateScale);
+		void EventSegmentCompleted(std::wstring path, int index, INT64 startMillis, INT64 durationMillis);
+		void EventEncodedPacket(const BITSTREAM_PACKET *pPacket);
 		void SetupCallbacks();
 		void ReleaseCallbacks();
 		void ReleaseResources();
@@ -73,6 +82,7 @@ namespace ScreenRecorderLib {
 		static List<VideoCaptureFormat^>^ CreateVideoCaptureFormatList(_In_ std::vector< IMFMediaType*> mediaTypes);
 		static std::vector<RECORDING_SOURCE> CreateRecordingSourceList(_In_ IEnumerable<RecordingSourceBase^>^ options);
 		static std::vector<RECORDING_OVERLAY> CreateOverlayList(_In_ IEnumerable<RecordingOverlayBase^>^ managedOverlays);
+		static ENCODER_OPTIONS* CreateEncoderOptions(_In_ VideoEncoderOptions^ videoEncoderOptions);
 		static Guid FromNativeGuid(_In_ const GUID& guid);
 
 		int _currentFrameNumber;
@@ -84,6 +94,9 @@ namespace ScreenRecorderLib {
 		GCHandle _completedDelegateGcHandler;
 		GCHandle _snapshotDelegateGcHandler;
 		GCHandle _frameNumberDelegateGcHandler;
+		GCHandle _qualityChangedDelegateGcHandler;
+		GCHandle _segmentCompletedDelegateGcHandler;
+		GCHandle _encodedPacketDelegateGcHandler;
 
 	internal:
 		void SetDynamicOptions(DynamicOptions^ options);
@@ -108,12 +121,22 @@ namespace ScreenRecorderLib {
 			_currentFrameNumber = value;
 		}
 		}
+		/// <summary>
+		/// Starts a recording that is not written to a file. It is kept in the replay buffer, passed to OnEncodedPacket, or both. OutputOptions.ReplayBufferDurationMillis, OutputOptions.ReplayBufferMaxSizeBytes or OutputOptions.IsBitstreamOutputEnabled must be set.
+		/// </summary>
+		void Record();
 		void Record(System::String^ path);
 		void Record(System::Runtime::InteropServices::ComTypes::IStream^ stream);
 		void Record(System::IO::Stream^ stream);
 		bool TakeSnapshot();
 		bool TakeSnapshot(System::String^ path);
 		bool TakeSnapshot(System::IO::Stream^ stream);
+		/// <summary>
+		/// Writes the replay buffer to an MP4 file, without encoding it again. It can be called during a recording, and after it until the next recording starts.
+		/// </summary>
+		/// <returns>false if the replay buffer is not enabled, has no frames yet, or could not be written.</returns>
+		bool SaveReplay(System::String^ path);
+		bool SaveReplay(System::IO::Stream^ stream);
 		void Pause();
 		void Resume();
 		void Stop();
@@ -123,8 +146,33 @@ namespace ScreenRecorderLib {
 		/// </summary>
 		/// <returns></returns>
 		DynamicOptionsBuilder^ GetDynamicOptionsBuilder();
+		/// <summary>
+		/// Gets the cost of generating video frame previews for the current recording, or for the last recording if none is in progress.
+		/// </summary>
+		FramePreviewStatistics^ GetFramePreviewStatistics();
+		/// <summary>
+		/// Gets the snapshot queue and latency statistics for the current recording, or for the last recording if none is in progress.
+		/// </summary>
+		SnapshotStatistics^ GetSnapshotStatistics();
+		/// <summary>
+		/// Gets the counters, gauges and latency histograms of the capture, encoder and audio pipeline for the current recording, or for the last recording if none is in progress.
+		/// </summary>
+		RecorderStatistics^ GetStatistics();
 
 		static bool SetExcludeFromCapture(System::IntPtr hwnd, bool isExcluded);
+		/// <summary>
+		/// Enables or disables tracing of frame capture, composition, encoding and callbacks for all recorders in the process. Disabled by default.
+		/// </summary>
+		static void SetTracingEnabled(bool isEnabled);
+		/// <summary>
+		/// Writes the traced events to a JSON file, which can be opened in chrome://tracing or https://ui.perfetto.dev. Each thread keeps its most recent events.
+		/// </summary>
+		/// <returns>true if the trace file was written, else false</returns>
+		static bool WriteTrace(String^ path);
+		/// <summary>
+		/// Discards the traced events.
+		/// </summary>
+		static void ClearTrace();
 		static Recorder^ CreateRecorder();
 		static Recorder^ CreateRecorder(RecorderOptions^ options);
 		static List<RecordableWindow^>^ GetWindows();
@@ -138,6 +186,20 @@ namespace ScreenRecorderLib {
 		event EventHandler<RecordingStatusEventArgs^>^ OnStatusChanged;
 		event EventHandler<SnapshotSavedEventArgs^>^ OnSnapshotSaved;
 		event EventHandler<FrameRecordedEventArgs^>^ OnFrameRecorded;
+		/// <summary>
+		/// Raised when the frame rate and bitrate are lowered or restored, if VideoEncoderOptions.IsAdaptiveQualityEnabled is set.
+		/// </summary>
+		event EventHandler<QualityChangedEventArgs^>^ OnQualityChanged;
+		/// <summary>
+		/// Raised when a segment file is finalized, if OutputOptions.SegmentDurationMillis or OutputOptions.MaxSegmentSizeBytes is set.
+		/// The last segment is finalized before OnRecordingComplete is raised.
+		/// </summary>
+		event EventHandler<SegmentCompletedEventArgs^>^ OnSegmentCompleted;
+		/// <summary>
+		/// Raised on a background thread with each encoded video frame and block of audio, if OutputOptions.IsBitstreamOutputEnabled is set.
+		/// Packets are raised in the order they were encoded, and the last ones before OnRecordingComplete is raised.
+		/// </summary>
+		event EventHandler<EncodedPacketEventArgs^>^ OnEncodedPacket;
 	};
 
 	public ref class DynamicOptionsBuilder {
@@ -16,6 +16,16 @@ namespace ScreenRecorderLib {
 		///<summary>WindowsGraphicsCapture requires Windows 10 version 1803 or higher. This API supports recording windows in addition to screens.</summary>
 		WindowsGraphicsCapture = 1,
 	};
+	public enum class SyntheticDirtyRegionPattern {
+		///<summary>Only the frame counter changes.</summary>
+		None = 0,
+		///<summary>A rectangle moves across the frame, so a small region changes each frame.</summary>
+		MovingRectangle = 1,
+		///<summary>The content scrolls vertically, so the whole frame changes but stays predictable.</summary>
+		Scroll = 2,
+		///<summary>Every pixel changes each frame.</summary>
+		FullFrame = 3,
+	};
 	public ref class RecordingSourceBase abstract : public INotifyPropertyChanged {
 	private:
 		String^ _id;
@@ -440,6 +450,44 @@ namespace ScreenRecorderLib {
 		}
 	};
 
+	/// <summary>
+	/// Generates frames with a known content and rate instead of capturing a device, for benchmarks and tests.
+	/// Each frame has its frame number embedded as two rows of 8x8 pixel cells in the top left corner, the second row inverting the first.
+	/// </summary>
+	public ref class SyntheticRecordingSource : public RecordingSourceBase {
+	public:
+		/// <summary>
+		/// The size of the generated frames. Default is 1920x1080.
+		/// </summary>
+		property ScreenSize^ Size;
+		/// <summary>
+		/// The rate frames are generated at. Default is 60.
+		/// </summary>
+		property double FrameRate;
+		/// <summary>
+		/// Which parts of the frame change between frames. Default is MovingRectangle.
+		/// </summary>
+		property SyntheticDirtyRegionPattern DirtyRegionPattern;
+		/// <summary>
+		/// Moves a generated mouse cursor along a fixed path. Default is true.
+		/// </summary>
+		property bool IsCursorMotionEnabled;
+
+		SyntheticRecordingSource()
+		{
+			Size = gcnew ScreenSize(1920, 1080);
+			FrameRate = 60;
+			DirtyRegionPattern = SyntheticDirtyRegionPattern::MovingRectangle;
+			IsCursorMotionEnabled = true;
+		}
+		SyntheticRecordingSource(SyntheticRecordingSource^ source) :RecordingSourceBase(source) {
+			Size = source->Size;
+			FrameRate = source->FrameRate;
+			DirtyRegionPattern = source->DirtyRegionPattern;
+			IsCursorMotionEnabled = source->IsCursorMotionEnabled;
+		}
+	};
+
 	public ref class RecordableCamera : VideoCaptureRecordingSource {
 	public:
 		RecordableCamera() {}
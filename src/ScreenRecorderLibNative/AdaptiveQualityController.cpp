@@ -0,0 +1,123 @@
+#include "AdaptiveQualityController.h"
+#include <algorithm>
+
+namespace {
+	//Each level lowers the load a little more. Lowering the bitrate first keeps the motion smooth when a small step is enough.
+	const ADAPTIVE_QUALITY_LEVEL QUALITY_LEVELS[] = {
+		{ 1.0, 1.0 },
+		{ 1.0, 0.75 },
+		{ 0.75, 0.75 },
+		{ 0.5, 0.5 },
+		{ 0.25, 0.5 }
+	};
+	const uint32_t QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+	//The longest a restore waits after repeated overloads, in idle windows.
+	const uint32_t MAX_IDLE_WINDOW_COUNT = 60;
+}
+
+AdaptiveQualityController::AdaptiveQualityController() :
+	m_FramePeriod(0),
+	m_WindowLength(DEFAULT_WINDOW_LENGTH),
+	m_OverloadedWindowTarget(DEFAULT_OVERLOADED_WINDOW_COUNT),
+	m_BaseIdleWindowTarget(DEFAULT_IDLE_WINDOW_COUNT),
+	m_IdleWindowTarget(DEFAULT_IDLE_WINDOW_COUNT),
+	m_MaxQueueDepth(DEFAULT_MAX_QUEUE_DEPTH),
+	m_LevelIndex(0),
+	m_WindowStart(0),
+	m_WindowFrameCount(0),
+	m_WindowLateFrameCount(0),
+	m_WindowSlowFrameCount(0),
+	m_WindowQueueDepthSum(0),
+	m_OverloadedWindowCount(0),
+	m_IdleWindowCount(0),
+	m_WindowsSinceRestore(UINT32_MAX),
+	m_LoweredCount(0),
+	m_RestoredCount(0)
+{
+}
+
+void AdaptiveQualityController::Start(int64_t framePeriod, int64_t time)
+{
+	m_FramePeriod = framePeriod;
+	m_IdleWindowTarget = m_BaseIdleWindowTarget;
+	m_LevelIndex = 0;
+	m_OverloadedWindowCount = 0;
+	m_IdleWindowCount = 0;
+	m_WindowsSinceRestore = UINT32_MAX;
+	m_LoweredCount = 0;
+	m_RestoredCount = 0;
+	StartWindow(time);
+}
+
+QualityAdjustment AdaptiveQualityController::RecordFrame(int64_t time, int64_t encodeLatency, uint32_t queueDepth)
+{
+	//A frame has the whole interval of the current frame rate to be encoded in.
+	const int64_t budget = static_cast<int64_t>(m_FramePeriod / QUALITY_LEVELS[m_LevelIndex].FramerateScale);
+	m_WindowFrameCount++;
+	m_WindowLateFrameCount += encodeLatency > budget ? 1 : 0;
+	m_WindowSlowFrameCount += encodeLatency > budget / 2 ? 1 : 0;
+	m_WindowQueueDepthSum += queueDepth;
+	if (time - m_WindowStart < m_WindowLength) {
+		return QualityAdjustment::None;
+	}
+	const QualityAdjustment adjustment = EndWindow();
+	StartWindow(time);
+	return adjustment;
+}
+
+ADAPTIVE_QUALITY_LEVEL AdaptiveQualityController::GetLevel()
+{
+	return QUALITY_LEVELS[m_LevelIndex];
+}
+
+uint32_t AdaptiveQualityController::GetLevelCount()
+{
+	return QUALITY_LEVEL_COUNT;
+}
+
+QualityAdjustment AdaptiveQualityController::EndWindow()
+{
+	const uint64_t frameCount = m_WindowFrameCount;
+	const bool isOverloaded = frameCount > 0
+		&& (m_WindowLateFrameCount * 4 >= frameCount || m_WindowQueueDepthSum >= frameCount * m_MaxQueueDepth);
+	const bool isIdle = m_WindowSlowFrameCount * 20 <= frameCount
+		&& m_WindowQueueDepthSum * 4 <= frameCount * m_MaxQueueDepth;
+	m_WindowsSinceRestore = m_WindowsSinceRestore == UINT32_MAX ? UINT32_MAX : m_WindowsSinceRestore + 1;
+	m_OverloadedWindowCount = isOverloaded ? m_OverloadedWindowCount + 1 : 0;
+	m_IdleWindowCount = isIdle ? m_IdleWindowCount + 1 : 0;
+
+	if (m_OverloadedWindowCount >= m_OverloadedWindowTarget && m_LevelIndex + 1 < QUALITY_LEVEL_COUNT) {
+		if (m_WindowsSinceRestore <= m_IdleWindowTarget * 2) {
+			//The restore brought the overload back, so wait longer before the next one.
+			m_IdleWindowTarget = (std::min)(m_IdleWindowTarget * 2, MAX_IDLE_WINDOW_COUNT);
+		}
+		m_LevelIndex++;
+		m_LoweredCount++;
+		m_OverloadedWindowCount = 0;
+		m_IdleWindowCount = 0;
+		m_WindowsSinceRestore = UINT32_MAX;
+		return QualityAdjustment::Lowered;
+	}
+	if (m_IdleWindowCount >= m_IdleWindowTarget && m_LevelIndex > 0) {
+		m_LevelIndex--;
+		m_RestoredCount++;
+		m_OverloadedWindowCount = 0;
+		m_IdleWindowCount = 0;
+		m_WindowsSinceRestore = 0;
+		return QualityAdjustment::Restored;
+	}
+	if (m_LevelIndex == 0 && m_IdleWindowCount >= m_IdleWindowTarget) {
+		//Back at full quality and stable, so later overloads start with the base wait again.
+		m_IdleWindowTarget = m_BaseIdleWindowTarget;
+	}
+	return QualityAdjustment::None;
+}
+
+void AdaptiveQualityController::StartWindow(int64_t time)
+{
+	m_WindowStart = time;
+	m_WindowFrameCount = 0;
+	m_WindowLateFrameCount = 0;
+	m_WindowSlowFrameCount = 0;
+	m_WindowQueueDepthSum = 0;
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+
+struct ADAPTIVE_QUALITY_LEVEL {
+	//The fraction of the configured frame rate to record at.
+	double FramerateScale;
+	//The fraction of the configured bitrate to encode at. With quality based rate control, it is applied to the quality.
+	double BitrateScale;
+};
+
+enum class QualityAdjustment {
+	None,
+	//The encoder was overloaded, and the quality was lowered by a level.
+	Lowered,
+	//The load cleared, and the quality was restored by a level.
+	Restored
+};
+
+/// <summary>
+/// Lowers the frame rate and bitrate in steps when the encoder falls behind, and restores them when the load clears.
+/// The load is measured in windows of recorded frames. A window is overloaded if a quarter of its frames took longer to encode than the frame interval, or if the encoder queue was deep.
+/// It is idle if almost all frames took less than half the frame interval, and the queue was close to empty.
+/// The quality is lowered after a few consecutive overloaded windows, and restored only after more consecutive idle windows. If the load returns soon after a restore, the next restore waits twice as long.
+/// Times are in 100 nanosecond units, and are passed in, so the controller can be driven by any clock.
+/// </summary>
+class AdaptiveQualityController
+{
+public:
+	AdaptiveQualityController();
+	/// <summary>
+	/// Starts at full quality.
+	/// </summary>
+	/// <param name="framePeriod">The interval between frames at the configured frame rate.</param>
+	/// <param name="time">The current time.</param>
+	void Start(int64_t framePeriod, int64_t time);
+	/// <summary>
+	/// Records a frame that was just written to the encoder.
+	/// </summary>
+	/// <param name="time">The current time.</param>
+	/// <param name="encodeLatency">How long it took to write the frame.</param>
+	/// <param name="queueDepth">The number of frames waiting in the encoder after the frame was written.</param>
+	/// <returns>The adjustment made when a window ended with this frame.</returns>
+	QualityAdjustment RecordFrame(int64_t time, int64_t encodeLatency, uint32_t queueDepth);
+	ADAPTIVE_QUALITY_LEVEL GetLevel();
+	/// <summary>
+	/// 0 is full quality. Higher levels lower the quality further.
+	/// </summary>
+	uint32_t GetLevelIndex() { return m_LevelIndex; }
+	static uint32_t GetLevelCount();
+
+	void SetWindowLength(int64_t length) { m_WindowLength = length; }
+	void SetOverloadedWindowCount(uint32_t count) { m_OverloadedWindowTarget = count; }
+	void SetIdleWindowCount(uint32_t count) { m_BaseIdleWindowTarget = count; }
+	/// <summary>
+	/// The average number of frames waiting in the encoder that overloads a window.
+	/// </summary>
+	void SetMaxQueueDepth(uint32_t depth) { m_MaxQueueDepth = depth; }
+	uint64_t GetLoweredCount() { return m_LoweredCount; }
+	uint64_t GetRestoredCount() { return m_RestoredCount; }
+
+	static const int64_t DEFAULT_WINDOW_LENGTH = 10000000;
+	static const uint32_t DEFAULT_OVERLOADED_WINDOW_COUNT = 2;
+	static const uint32_t DEFAULT_IDLE_WINDOW_COUNT = 5;
+	static const uint32_t DEFAULT_MAX_QUEUE_DEPTH = 4;
+private:
+	QualityAdjustment EndWindow();
+	void StartWindow(int64_t time);
+
+	int64_t m_FramePeriod;
+	int64_t m_WindowLength;
+	uint32_t m_OverloadedWindowTarget;
+	uint32_t m_BaseIdleWindowTarget;
+	uint32_t m_IdleWindowTarget;
+	uint32_t m_MaxQueueDepth;
+	uint32_t m_LevelIndex;
+
+	int64_t m_WindowStart;
+	uint32_t m_WindowFrameCount;
+	uint32_t m_WindowLateFrameCount;
+	uint32_t m_WindowSlowFrameCount;
+	uint64_t m_WindowQueueDepthSum;
+
+	uint32_t m_OverloadedWindowCount;
+	uint32_t m_IdleWindowCount;
+	//The number of windows since the last restore, to detect when the load returns soon after it.
+	uint32_t m_WindowsSinceRestore;
+	uint64_t m_LoweredCount;
+	uint64_t m_RestoredCount;
+};
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "AdditionalOutput.h"
+#include <limits>
+#include "Trace.h"
+
+using namespace std;
+
+AdditionalOutput::AdditionalOutput(_In_ ADDITIONAL_OUTPUT options, _In_ int index) :
+	m_Options(options),
+	m_MetricsPrefix("outputs." + std::to_string(index) + "."),
+	m_OutputManager(make_unique<OutputManager>()),
+	m_Device(nullptr),
+	m_FrameSize{},
+	m_FramePeriod(0),
+	m_NextFrameTime(0),
+	m_DroppedFramePos(std::nullopt),
+	m_Mutex{},
+	m_JobAvailable{},
+	m_Queue{},
+	m_QueuedFrameCount(0),
+	m_Worker{},
+	m_IsStopping(false),
+	m_Result(S_OK),
+	m_FreeTextures{},
+	m_FrameCount(nullptr),
+	m_DroppedFrameCount(nullptr),
+	m_QueueDepth(nullptr)
+{
+	m_OutputManager->SetMetricsPrefix(m_MetricsPrefix);
+}
+
+AdditionalOutput::~AdditionalOutput()
+{
+	StopWorker();
+}
+
+HRESULT AdditionalOutput::Initialize(
+	_In_ ID3D11DeviceContext *pDeviceContext,
+	_In_ ID3D11Device *pDevice,
+	_In_ std::shared_ptr<AUDIO_OPTIONS> pAudioOptions,
+	_In_ std::shared_ptr<SNAPSHOT_OPTIONS> pSnapshotOptions,
+	_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
+	_In_ std::shared_ptr<MetricsRegistry> pMetrics)
+{
+	if (!m_Options.EncoderOptions) {
+		return E_INVALIDARG;
+	}
+	{
+		//Frames still queued were rendered on the previous device.
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.clear();
+		m_QueuedFrameCount = 0;
+		m_FreeTextures.clear();
+	}
+	m_Device = pDevice;
+	m_FrameCount = pMetrics->GetCounter(m_MetricsPrefix + "frames");
+	m_DroppedFrameCount = pMetrics->GetCounter(m_MetricsPrefix + "dropped_frames");
+	m_QueueDepth = pMetrics->GetGauge(m_MetricsPrefix + "queue_depth");
+	m_FramePeriod = 10 * 1000 * 1000 / max(1u, m_Options.EncoderOptions->GetVideoFps());
+	std::shared_ptr<OUTPUT_OPTIONS> pOptions = make_shared<OUTPUT_OPTIONS>(*pOutputOptions);
+	pOptions->SetSink(nullptr);
+	pOptions->SetAdditionalOutputs({});
+	//Waits for a frame being written by the worker, as the output manager is locked while writing.
+	return m_OutputManager->Initialize(pDeviceContext, pDevice, m_Options.EncoderOptions, pAudioOptions, pSnapshotOptions, pOptions, pMetrics);
+}
+
+HRESULT AdditionalOutput::BeginRecording(_In_ SIZE videoOutputFrameSize)
+{
+	m_FrameSize = videoOutputFrameSize;
+	m_NextFrameTime = (std::numeric_limits<INT64>::min)();
+	m_DroppedFramePos.reset();
+	m_Result = S_OK;
+	RETURN_ON_BAD_HR(m_OutputManager->BeginRecording(m_Options.Path, videoOutputFrameSize));
+	m_IsStopping = false;
+	m_Worker = std::thread([this] { WorkerThreadLoop(); });
+	LOG_DEBUG(L"Started additional output to %ls with frame size %dx%d", m_Options.Path.c_str(), videoOutputFrameSize.cx, videoOutputFrameSize.cy);
+	return S_OK;
+}
+
+bool AdditionalOutput::IsFrameDue(_In_ const FrameWriteModel &model)
+{
+	//A frame is used if at least half of it is after the end of the previous frame of this output.
+	return model.StartPos + model.Duration / 2 >= m_NextFrameTime;
+}
+
+HRESULT AdditionalOutput::GetFrameTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		while (!m_FreeTextures.empty()) {
+			CComPtr<ID3D11Texture2D> pTexture = m_FreeTextures.back();
+			m_FreeTextures.pop_back();
+			D3D11_TEXTURE2D_DESC textureDesc;
+			pTexture->GetDesc(&textureDesc);
+			//Textures that no longer match, e.g. because the frame was resized on another path, are released.
+			if (textureDesc.Width == desc.Width && textureDesc.Height == desc.Height && textureDesc.Format == desc.Format
+				&& textureDesc.BindFlags == desc.BindFlags && textureDesc.MiscFlags == desc.MiscFlags) {
+				*ppTexture = pTexture.Detach();
+				return S_OK;
+			}
+		}
+	}
+	return m_Device->CreateTexture2D(&desc, nullptr, ppTexture);
+}
+
+void AdditionalOutput::ReleaseFrameTexture(_Inout_ CComPtr<ID3D11Texture2D> &pTexture)
+{
+	//One texture for each frame that can be queued, and one for the frame being rendered, is enough to never allocate.
+	if (pTexture && m_FreeTextures.size() <= max(1u, m_Options.MaxQueuedFrames)) {
+		m_FreeTextures.push_back(pTexture);
+	}
+	pTexture.Release();
+}
+
+HRESULT AdditionalOutput::QueueFrame(_In_ FrameWriteModel model)
+{
+	HRESULT hr = S_OK;
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (model.Frame && !IsFrameDue(model)) {
+			ReleaseFrameTexture(model.Frame);
+		}
+		if (FAILED(m_Result)) {
+			return m_Result;
+		}
+		if (model.Frame && m_QueuedFrameCount >= max(1u, m_Options.MaxQueuedFrames)) {
+			//The audio is still queued, so it stays continuous. The next queued frame is stretched back over the dropped frames, so the video has no gap.
+			if (!m_DroppedFramePos.has_value()) {
+				m_DroppedFramePos = max(model.StartPos, m_NextFrameTime);
+			}
+			ReleaseFrameTexture(model.Frame);
+			m_DroppedFrameCount->Increment();
+			LOG_TRACE(L"Dropped frame with start pos %lld ms for additional output %ls, the queue is full", HundredNanosToMillis(model.StartPos), m_Options.Path.c_str());
+			hr = S_FALSE;
+		}
+		if (model.Frame) {
+			//A frame that starts within the previous frame, which was stretched to the frame period of this output, starts where it ends.
+			//After dropped frames, it starts where the first dropped frame would have.
+			INT64 startPos = m_DroppedFramePos.value_or(max(model.StartPos, m_NextFrameTime));
+			INT64 endPos = max(model.StartPos + model.Duration, startPos + m_FramePeriod);
+			model.StartPos = startPos;
+			model.Duration = endPos - startPos;
+			m_NextFrameTime = endPos;
+			m_DroppedFramePos.reset();
+			m_QueuedFrameCount++;
+		}
+		else if (model.Audio.empty()) {
+			return hr;
+		}
+		m_Queue.push_back(std::move(model));
+		m_QueueDepth->Set(m_QueuedFrameCount);
+	}
+	m_JobAvailable.notify_one();
+	return hr;
+}
+
+HRESULT AdditionalOutput::FinalizeRecording()
+{
+	StopWorker();
+	HRESULT hr = m_OutputManager->FinalizeRecording();
+	if (FAILED(m_Result)) {
+		return m_Result;
+	}
+	return hr;
+}
+
+void AdditionalOutput::StopWorker()
+{
+	if (!m_Worker.joinable()) {
+		return;
+	}
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_JobAvailable.notify_all();
+	m_Worker.join();
+}
+
+void AdditionalOutput::WorkerThreadLoop()
+{
+	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+	LOG_ON_BAD_HR(hr);
+	Tracer::SetThreadName("AdditionalOutput");
+	while (true) {
+		FrameWriteModel model{};
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_JobAvailable.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+			//Queued frames are written before the worker exits.
+			if (m_Queue.empty()) {
+				break;
+			}
+			model = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		bool hasFrame = model.Frame != nullptr;
+		HRESULT renderHr = m_OutputManager->RenderFrame(model);
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			//The output manager has copied the frame, and the copy is ordered before any later writes to the texture on the device context.
+			ReleaseFrameTexture(model.Frame);
+			if (hasFrame) {
+				m_QueuedFrameCount = m_QueuedFrameCount > 0 ? m_QueuedFrameCount - 1 : 0;
+				m_QueueDepth->Set(m_QueuedFrameCount);
+			}
+			if (FAILED(renderHr)) {
+				//The main output and other outputs keep recording.
+				_com_error err(renderHr);
+				LOG_ERROR(L"Additional output to %ls failed and is stopped: %ls", m_Options.Path.c_str(), err.ErrorMessage());
+				m_Result = renderHr;
+				m_Queue.clear();
+				m_QueuedFrameCount = 0;
+				break;
+			}
+		}
+		if (hasFrame) {
+			m_FrameCount->Increment();
+		}
+	}
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+}
\ No newline at end of file
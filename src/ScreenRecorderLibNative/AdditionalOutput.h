@@ -0,0 +1,90 @@
+#pragma once
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <vector>
+#include "CommonTypes.h"
+#include "OutputManager.h"
+#include "Metrics.h"
+
+/// <summary>
+/// Encodes the frames of the main output to an additional video file, with its own frame size, frame rate and encoder options.
+/// Frames are written on a worker thread, so a slow encoder only delays this output. When too many frames are queued, new frames are dropped for this output, but their audio is kept.
+/// </summary>
+class AdditionalOutput
+{
+public:
+	/// <param name="index">The index of the output, used to name its metrics.</param>
+	AdditionalOutput(_In_ ADDITIONAL_OUTPUT options, _In_ int index);
+	~AdditionalOutput();
+	/// <summary>
+	/// Initializes the output with a device. Called again with the new device after the device was lost, which discards the queued frames.
+	/// </summary>
+	/// <param name="pOutputOptions">The options of the main output. The output sink is not used for additional outputs.</param>
+	HRESULT Initialize(
+		_In_ ID3D11DeviceContext *pDeviceContext,
+		_In_ ID3D11Device *pDevice,
+		_In_ std::shared_ptr<AUDIO_OPTIONS> pAudioOptions,
+		_In_ std::shared_ptr<SNAPSHOT_OPTIONS> pSnapshotOptions,
+		_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
+		_In_ std::shared_ptr<MetricsRegistry> pMetrics);
+	HRESULT BeginRecording(_In_ SIZE videoOutputFrameSize);
+	/// <summary>
+	/// Sets the event that is set when the recording stops. See OutputManager::SetStopEvent.
+	/// </summary>
+	void SetStopEvent(_In_ SyncEvent *pStopEvent) { m_OutputManager->SetStopEvent(pStopEvent); }
+	/// <summary>
+	/// Returns true if the frame should be encoded in this output, or false if it is skipped to reach the frame rate of the output.
+	/// </summary>
+	bool IsFrameDue(_In_ const FrameWriteModel &model);
+	/// <summary>
+	/// Gets a texture to render a frame for this output into. Textures of frames that were written or dropped are reused, so frames do not allocate textures once the queue has filled.
+	/// </summary>
+	HRESULT GetFrameTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture);
+	/// <summary>
+	/// Queues a frame of the main output to be written. The texture must not be modified after it is queued.
+	/// If the frame is null, or is not due, only the audio is written.
+	/// </summary>
+	/// <returns>S_OK if the frame was queued, S_FALSE if the video frame was dropped, or the error that made this output fail.</returns>
+	HRESULT QueueFrame(_In_ FrameWriteModel model);
+	/// <summary>
+	/// Writes the queued frames, stops the worker and finalizes the file.
+	/// </summary>
+	HRESULT FinalizeRecording();
+	SIZE GetFrameSize() { return m_FrameSize; }
+	std::wstring GetPath() { return m_Options.Path; }
+private:
+	ADDITIONAL_OUTPUT m_Options;
+	std::string m_MetricsPrefix;
+	std::unique_ptr<OutputManager> m_OutputManager;
+	ID3D11Device *m_Device;
+	SIZE m_FrameSize;
+	INT64 m_FramePeriod;
+	INT64 m_NextFrameTime;
+	//Where the first frame dropped since the last queued frame would have started. The next queued frame is stretched back to it.
+	std::optional<INT64> m_DroppedFramePos;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_JobAvailable;
+	std::deque<FrameWriteModel> m_Queue;
+	UINT32 m_QueuedFrameCount;
+	std::thread m_Worker;
+	bool m_IsStopping;
+	HRESULT m_Result;
+	//Textures of frames that were written or dropped, to be reused by GetFrameTexture.
+	std::vector<CComPtr<ID3D11Texture2D>> m_FreeTextures;
+
+	MetricCounter *m_FrameCount;
+	MetricCounter *m_DroppedFrameCount;
+	MetricGauge *m_QueueDepth;
+
+	void StopWorker();
+	void WorkerThreadLoop();
+	/// <summary>
+	/// Releases the texture of a frame that was written or dropped, and keeps it for reuse. Must be called with the mutex held.
+	/// </summary>
+	void ReleaseFrameTexture(_Inout_ CComPtr<ID3D11Texture2D> &pTexture);
+};
\ No newline at end of file
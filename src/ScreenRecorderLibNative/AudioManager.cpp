@@ -6,58 +6,48 @@ using namespace std;
 
 AudioManager::AudioManager() :
 	m_AudioOptions(nullptr),
+	m_Metrics(nullptr),
 	m_IsCaptureEnabled(false)
 {
-	InitializeCriticalSection(&m_CriticalSection);
-	m_OptionsListenerStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 }
 
 AudioManager::~AudioManager()
 {
 	StopOptionsChangeListenerThread();
-	CloseHandle(m_OptionsListenerStopEvent);
-	DeleteCriticalSection(&m_CriticalSection);
 }
 
 void AudioManager::OnOptionsChanged() {
 	bool exit = false;
-	const HANDLE events[] = {
-	m_OptionsListenerStopEvent,
-	m_AudioOptions->OnPropertyChangedEvent
-	};
 	while (!exit) {
 		if (m_AudioOptions) {
-			const DWORD ret = WaitForMultipleObjects(ARRAYSIZE(events), events,
-								 false, INFINITE);
-			switch (ret) {
+			switch (WaitAny({ &m_OptionsListenerStopEvent, &m_AudioOptions->OnPropertyChangedEvent })) {
 				default:
-				case WAIT_OBJECT_0: {
+				case 0: {
 					exit = true;
 					break;
 				}
-				case WAIT_OBJECT_0 + 1: {
-					EnterCriticalSection(&m_CriticalSection);
-					LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+				case 1: {
+					const std::lock_guard<SyncMutex> lock(m_Mutex);
 					ConfigureAudioCapture();
 					break;
 				}
 			}
 		}
 		else {
-			const DWORD ret = WaitForSingleObject(m_OptionsListenerStopEvent, 100);
-			if (ret == WAIT_OBJECT_0) {
+			if (m_OptionsListenerStopEvent.Wait(std::chrono::milliseconds(100))) {
 				exit = true;
 			}
 		}
 	}
 }
 
-HRESULT AudioManager::Initialize(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions)
+HRESULT AudioManager::Initialize(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_ std::shared_ptr<MetricsRegistry> pMetrics)
 {
 	HRESULT hr = S_OK;
 	m_AudioOptions = audioOptions;
+	m_Metrics = pMetrics;
 	StopOptionsChangeListenerThread();
-	ResetEvent(m_OptionsListenerStopEvent);
+	m_OptionsListenerStopEvent.Reset();
 	m_OptionsListenerThread = std::thread([this] {OnOptionsChanged(); });
 	return hr;
 }
@@ -71,23 +61,21 @@ void AudioManager::ClearRecordedBytes()
 }
 
 HRESULT AudioManager::StartCapture() {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	m_IsCaptureEnabled = true;
 	return ConfigureAudioCapture();
 }
 
 HRESULT AudioManager::StopCapture()
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	m_IsCaptureEnabled = false;
 	return ConfigureAudioCapture();
 }
 
 HRESULT AudioManager::StopOptionsChangeListenerThread()
 {
-	SetEvent(m_OptionsListenerStopEvent);
+	m_OptionsListenerStopEvent.Set();
 	try
 	{
 		if (m_OptionsListenerThread.joinable()) {
@@ -128,7 +116,7 @@ HRESULT AudioManager::ConfigureAudioCapture() {
 	if (GetAudioOptions()->IsAudioEnabled() && GetAudioOptions()->IsOutputDeviceEnabled() && m_IsCaptureEnabled)
 	{
 		if (!m_AudioOutputCapture) {
-			m_AudioOutputCapture = make_unique<WASAPICapture>(m_AudioOptions, L"AudioOutputDevice");
+			m_AudioOutputCapture = make_unique<WASAPICapture>(m_AudioOptions, m_Metrics, L"AudioOutputDevice");
 			hr = m_AudioOutputCapture->Initialize(GetAudioOptions()->GetAudioOutputDevice(), eRender);
 			LOG_DEBUG("Created WASAPI capture on %s", m_AudioOutputCapture->GetTag().c_str());
 		}
@@ -143,7 +131,7 @@ HRESULT AudioManager::ConfigureAudioCapture() {
 	if (GetAudioOptions()->IsAudioEnabled() && GetAudioOptions()->IsInputDeviceEnabled() && m_IsCaptureEnabled)
 	{
 		if (!m_AudioInputCapture) {
-			m_AudioInputCapture = make_unique<WASAPICapture>(m_AudioOptions, L"AudioInputDevice");
+			m_AudioInputCapture = make_unique<WASAPICapture>(m_AudioOptions, m_Metrics, L"AudioInputDevice");
 			m_AudioInputCapture->Initialize(GetAudioOptions()->GetAudioInputDevice(), eCapture);
 			LOG_DEBUG("Created WASAPI capture on %s", m_AudioInputCapture->GetTag().c_str());
 		}
@@ -159,8 +147,8 @@ HRESULT AudioManager::ConfigureAudioCapture() {
 
 std::vector<BYTE> AudioManager::GrabAudioFrame(_In_ UINT64 durationHundredNanos)
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	TRACE_SCOPE("GrabAudioFrame");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	if (m_AudioOutputCapture && m_AudioInputCapture) {
 		auto returnAudioOverflowToBuffer = [&](auto &outputDeviceData, auto &inputDeviceData) {
 			if (outputDeviceData.size() > 0 && inputDeviceData.size() > 0) {
@@ -7,14 +7,15 @@ class AudioManager
 public:
 	AudioManager();
 	~AudioManager();
-	HRESULT Initialize(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions);
+	HRESULT Initialize(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_ std::shared_ptr<MetricsRegistry> pMetrics);
 	void ClearRecordedBytes();
 	HRESULT StartCapture();
 	HRESULT StopCapture();
 	std::vector<BYTE> GrabAudioFrame(_In_ UINT64 durationHundredNanos);
 private:
-	CRITICAL_SECTION m_CriticalSection;
+	SyncMutex m_Mutex;
 	std::shared_ptr<AUDIO_OPTIONS> m_AudioOptions;
+	std::shared_ptr<MetricsRegistry> m_Metrics;
 	//Output loopback capture, e.g. system audio.
 	std::unique_ptr<WASAPICapture> m_AudioOutputCapture;
 	//Audio input, i.e. microphone
@@ -29,7 +30,7 @@ private:
 	HRESULT ConfigureAudioCapture();
 
 	std::thread m_OptionsListenerThread;
-	HANDLE m_OptionsListenerStopEvent = nullptr;
+	SyncEvent m_OptionsListenerStopEvent{ true };
 	void OnOptionsChanged();
 	HRESULT StopOptionsChangeListenerThread();
 
@@ -0,0 +1,133 @@
+#include "Bitstream.h"
+
+namespace {
+	//Finds the next start code at or after offset. Returns size if there is none.
+	size_t FindStartCode(const uint8_t *pData, size_t size, size_t offset, size_t *pStartCodeLength) {
+		for (size_t i = offset; i + 3 <= size; i++) {
+			if (pData[i] == 0 && pData[i + 1] == 0) {
+				if (pData[i + 2] == 1) {
+					*pStartCodeLength = 3;
+					return i;
+				}
+				if (i + 4 <= size && pData[i + 2] == 0 && pData[i + 3] == 1) {
+					*pStartCodeLength = 4;
+					return i;
+				}
+			}
+		}
+		*pStartCodeLength = 0;
+		return size;
+	}
+
+	bool IsParameterSet(VideoCodec codec, uint8_t nalHeader) {
+		const uint8_t type = GetNalUnitType(codec, nalHeader);
+		if (codec == VideoCodec::H264) {
+			return type == 7 || type == 8;
+		}
+		return type >= 32 && type <= 34;
+	}
+
+	bool IsAccessUnitDelimiter(VideoCodec codec, uint8_t nalHeader) {
+		return GetNalUnitType(codec, nalHeader) == (codec == VideoCodec::H264 ? 9 : 35);
+	}
+}
+
+uint8_t GetNalUnitType(VideoCodec codec, uint8_t nalHeader)
+{
+	return codec == VideoCodec::H264 ? nalHeader & 0x1F : (nalHeader >> 1) & 0x3F;
+}
+
+std::vector<std::vector<uint8_t>> SplitAnnexB(const uint8_t *pData, size_t size)
+{
+	std::vector<std::vector<uint8_t>> nalUnits{};
+	size_t startCodeLength;
+	size_t start = FindStartCode(pData, size, 0, &startCodeLength);
+	while (start < size) {
+		const size_t nalStart = start + startCodeLength;
+		size_t nextStartCodeLength;
+		const size_t nalEnd = FindStartCode(pData, size, nalStart, &nextStartCodeLength);
+		if (nalEnd > nalStart) {
+			nalUnits.emplace_back(pData + nalStart, pData + nalEnd);
+		}
+		start = nalEnd;
+		startCodeLength = nextStartCodeLength;
+	}
+	return nalUnits;
+}
+
+std::vector<uint8_t> ConvertAnnexBToLengthPrefixed(VideoCodec codec, const uint8_t *pData, size_t size)
+{
+	std::vector<uint8_t> converted{};
+	ConvertAnnexBToLengthPrefixed(codec, pData, size, converted);
+	return converted;
+}
+
+void ConvertAnnexBToLengthPrefixed(VideoCodec codec, const uint8_t *pData, size_t size, std::vector<uint8_t> &converted)
+{
+	converted.clear();
+	converted.reserve(size + 16);
+	size_t startCodeLength;
+	size_t start = FindStartCode(pData, size, 0, &startCodeLength);
+	while (start < size) {
+		const size_t nalStart = start + startCodeLength;
+		size_t nextStartCodeLength;
+		const size_t nalEnd = FindStartCode(pData, size, nalStart, &nextStartCodeLength);
+		if (nalEnd > nalStart && !IsParameterSet(codec, pData[nalStart]) && !IsAccessUnitDelimiter(codec, pData[nalStart])) {
+			const size_t length = nalEnd - nalStart;
+			converted.push_back(static_cast<uint8_t>(length >> 24));
+			converted.push_back(static_cast<uint8_t>(length >> 16));
+			converted.push_back(static_cast<uint8_t>(length >> 8));
+			converted.push_back(static_cast<uint8_t>(length));
+			converted.insert(converted.end(), pData + nalStart, pData + nalEnd);
+		}
+		start = nalEnd;
+		startCodeLength = nextStartCodeLength;
+	}
+}
+
+std::vector<uint8_t> GetAnnexBParameterSets(VideoCodec codec, const uint8_t *pData, size_t size)
+{
+	std::vector<uint8_t> parameterSets{};
+	size_t startCodeLength;
+	size_t start = FindStartCode(pData, size, 0, &startCodeLength);
+	while (start < size) {
+		const size_t nalStart = start + startCodeLength;
+		size_t nextStartCodeLength;
+		const size_t nalEnd = FindStartCode(pData, size, nalStart, &nextStartCodeLength);
+		if (nalEnd > nalStart && IsParameterSet(codec, pData[nalStart])) {
+			static const uint8_t startCode[]{ 0, 0, 0, 1 };
+			parameterSets.insert(parameterSets.end(), startCode, startCode + sizeof(startCode));
+			parameterSets.insert(parameterSets.end(), pData + nalStart, pData + nalEnd);
+		}
+		start = nalEnd;
+		startCodeLength = nextStartCodeLength;
+	}
+	return parameterSets;
+}
+
+std::vector<uint8_t> GetAacAudioSpecificConfig(uint32_t samplesPerSecond, uint16_t channels)
+{
+	static const uint32_t frequencies[]{ 96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350 };
+	uint8_t frequencyIndex = 0x0F;
+	for (uint8_t i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++) {
+		if (frequencies[i] == samplesPerSecond) {
+			frequencyIndex = i;
+			break;
+		}
+	}
+	//Audio object type 2 (AAC-LC), the sampling frequency index and the channel configuration. An escaped frequency is followed by the frequency itself.
+	const uint8_t objectType = 2;
+	if (frequencyIndex != 0x0F) {
+		return {
+			static_cast<uint8_t>((objectType << 3) | (frequencyIndex >> 1)),
+			static_cast<uint8_t>(((frequencyIndex & 1) << 7) | ((channels & 0x0F) << 3))
+		};
+	}
+	return {
+		static_cast<uint8_t>((objectType << 3) | (frequencyIndex >> 1)),
+		static_cast<uint8_t>(((frequencyIndex & 1) << 7) | ((samplesPerSecond >> 17) & 0x7F)),
+		static_cast<uint8_t>((samplesPerSecond >> 9) & 0xFF),
+		static_cast<uint8_t>((samplesPerSecond >> 1) & 0xFF),
+		static_cast<uint8_t>(((samplesPerSecond & 1) << 7) | ((channels & 0x0F) << 3))
+	};
+}
\ No newline at end of file
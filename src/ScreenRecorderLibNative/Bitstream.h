@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class VideoCodec {
+	H264,
+	HEVC
+};
+
+enum class PacketStream {
+	Video,
+	Audio
+};
+
+/// <summary>
+/// An encoded video frame or block of audio, as produced by the encoder. Video frames are in Annex B format. Timestamps and durations are in 100 nanosecond units.
+/// </summary>
+struct ENCODED_PACKET {
+	PacketStream Stream;
+	int64_t Timestamp;
+	int64_t Duration;
+	//A video frame that can be decoded without the frames before it. Audio packets are not key frames.
+	bool IsKeyFrame;
+	std::vector<uint8_t> Data;
+};
+
+/// <summary>
+/// Splits an access unit in Annex B format into its NAL units, without the start codes.
+/// </summary>
+std::vector<std::vector<uint8_t>> SplitAnnexB(const uint8_t *pData, size_t size);
+
+/// <summary>
+/// Converts an access unit in Annex B format to NAL units prefixed with their 4 byte big endian length, as stored in MP4 samples.
+/// Parameter sets and access unit delimiters are left out, as MP4 files keep the parameter sets in the sample description.
+/// </summary>
+std::vector<uint8_t> ConvertAnnexBToLengthPrefixed(VideoCodec codec, const uint8_t *pData, size_t size);
+/// <summary>
+/// Converts an access unit like ConvertAnnexBToLengthPrefixed, replacing the contents of a buffer that can be reused between calls.
+/// </summary>
+void ConvertAnnexBToLengthPrefixed(VideoCodec codec, const uint8_t *pData, size_t size, std::vector<uint8_t> &converted);
+
+/// <summary>
+/// Gets the NAL unit type from the first byte of a NAL unit header.
+/// </summary>
+uint8_t GetNalUnitType(VideoCodec codec, uint8_t nalHeader);
+
+/// <summary>
+/// Gets the parameter sets of an access unit in Annex B format, i.e. NAL units separated by start codes, as written by the encoders.
+/// These are the sequence and picture parameter sets, and for HEVC the video parameter set.
+/// </summary>
+/// <returns>The parameter sets in Annex B format, each with a 4 byte start code, or an empty vector if the access unit has none.</returns>
+std::vector<uint8_t> GetAnnexBParameterSets(VideoCodec codec, const uint8_t *pData, size_t size);
+
+/// <summary>
+/// Gets the AudioSpecificConfig of AAC-LC audio, as stored in MP4 files.
+/// </summary>
+std::vector<uint8_t> GetAacAudioSpecificConfig(uint32_t samplesPerSecond, uint16_t channels);
\ No newline at end of file
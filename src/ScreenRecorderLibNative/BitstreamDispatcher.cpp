@@ -0,0 +1,141 @@
+#include "BitstreamDispatcher.h"
+#include <algorithm>
+
+BitstreamDispatcher::BitstreamDispatcher(BitstreamCallback callback, VideoCodec codec, BitstreamFormat format, size_t maxQueuedPackets) :
+	m_Callback(callback),
+	m_Codec(codec),
+	m_Format(format),
+	m_MaxQueuedPackets((std::max)(maxQueuedPackets, static_cast<size_t>(1))),
+	m_Queue{},
+	m_FreeBuffers{},
+	m_DeliveryThread{},
+	m_IsStopping(false),
+	m_IsStopped(false),
+	m_IsDeliveringQueued(false),
+	m_IsWaitingForKeyFrame(false),
+	m_Statistics{},
+	m_ConvertedData{},
+	m_ParameterSets{}
+{
+}
+
+BitstreamDispatcher::~BitstreamDispatcher()
+{
+	Stop(false);
+}
+
+std::vector<uint8_t> BitstreamDispatcher::AcquireBuffer()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_FreeBuffers.empty()) {
+		return std::vector<uint8_t>{};
+	}
+	std::vector<uint8_t> buffer = std::move(m_FreeBuffers.back());
+	m_FreeBuffers.pop_back();
+	buffer.clear();
+	return buffer;
+}
+
+bool BitstreamDispatcher::Enqueue(ENCODED_PACKET packet)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_IsStopping || m_IsStopped) {
+			return false;
+		}
+		const bool isVideo = packet.Stream == PacketStream::Video;
+		if (isVideo && packet.IsKeyFrame) {
+			m_IsWaitingForKeyFrame = false;
+		}
+		if (m_Queue.size() >= m_MaxQueuedPackets || (isVideo && m_IsWaitingForKeyFrame)) {
+			if (isVideo) {
+				m_IsWaitingForKeyFrame = true;
+			}
+			m_Statistics.DroppedPacketCount++;
+			if (m_FreeBuffers.size() < m_MaxQueuedPackets) {
+				m_FreeBuffers.push_back(std::move(packet.Data));
+			}
+			return false;
+		}
+		m_Queue.push_back(std::move(packet));
+		m_Statistics.MaxQueuedPacketCount = (std::max)(m_Statistics.MaxQueuedPacketCount, static_cast<uint64_t>(m_Queue.size()));
+		if (!m_DeliveryThread.joinable()) {
+			m_DeliveryThread = std::thread([this] { DeliveryThreadLoop(); });
+		}
+	}
+	m_PacketAvailable.notify_one();
+	return true;
+}
+
+void BitstreamDispatcher::Stop(bool deliverQueued)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+		m_IsDeliveringQueued = deliverQueued;
+	}
+	m_PacketAvailable.notify_all();
+	if (m_DeliveryThread.joinable()) {
+		m_DeliveryThread.join();
+	}
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Queue.clear();
+	m_IsStopped = true;
+	m_IsStopping = false;
+}
+
+BITSTREAM_DISPATCHER_STATISTICS BitstreamDispatcher::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Statistics;
+}
+
+void BitstreamDispatcher::DeliveryThreadLoop()
+{
+	while (true) {
+		ENCODED_PACKET packet{};
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_PacketAvailable.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+			if (m_IsStopping && (!m_IsDeliveringQueued || m_Queue.empty())) {
+				break;
+			}
+			packet = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		Deliver(packet);
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Statistics.DeliveredPacketCount++;
+		m_Statistics.DeliveredByteCount += packet.Data.size();
+		if (m_FreeBuffers.size() < m_MaxQueuedPackets) {
+			m_FreeBuffers.push_back(std::move(packet.Data));
+		}
+	}
+}
+
+void BitstreamDispatcher::Deliver(const ENCODED_PACKET &packet)
+{
+	BITSTREAM_PACKET lent{};
+	lent.Stream = packet.Stream;
+	lent.Timestamp = packet.Timestamp;
+	lent.Duration = packet.Duration;
+	lent.IsKeyFrame = packet.IsKeyFrame;
+	lent.pData = packet.Data.data();
+	lent.Size = packet.Data.size();
+	if (packet.Stream == PacketStream::Video) {
+		if (packet.IsKeyFrame) {
+			m_ParameterSets = GetAnnexBParameterSets(m_Codec, packet.Data.data(), packet.Data.size());
+			if (!m_ParameterSets.empty()) {
+				lent.pParameterSets = m_ParameterSets.data();
+				lent.ParameterSetsSize = m_ParameterSets.size();
+			}
+		}
+		if (m_Format == BitstreamFormat::LengthPrefixed) {
+			//Converted into a buffer that is kept between packets, so it only grows to the size of the largest frame.
+			ConvertAnnexBToLengthPrefixed(m_Codec, packet.Data.data(), packet.Data.size(), m_ConvertedData);
+			lent.pData = m_ConvertedData.data();
+			lent.Size = m_ConvertedData.size();
+		}
+	}
+	m_Callback(lent);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Bitstream.h"
+
+enum class BitstreamFormat {
+	//NAL units separated by start codes, with the parameter sets in each key frame.
+	AnnexB,
+	//NAL units prefixed with their 4 byte big endian length, as in MP4 and AVCC. The parameter sets are only passed separately.
+	LengthPrefixed
+};
+
+/// <summary>
+/// An encoded video frame or block of audio, lent to the callback of a BitstreamDispatcher. Timestamps and durations are in 100 nanosecond units.
+/// The data is only valid for the duration of the call, after which the buffer is reused for a later packet.
+/// </summary>
+struct BITSTREAM_PACKET {
+	PacketStream Stream;
+	int64_t Timestamp;
+	int64_t Duration;
+	bool IsKeyFrame;
+	const uint8_t *pData;
+	size_t Size;
+	//The parameter sets of the video stream in Annex B format, on video key frames. nullptr on other packets.
+	const uint8_t *pParameterSets;
+	size_t ParameterSetsSize;
+};
+
+struct BITSTREAM_DISPATCHER_STATISTICS {
+	uint64_t DeliveredPacketCount;
+	uint64_t DeliveredByteCount;
+	//The packets dropped because the queue was full, including the video frames dropped until the next key frame.
+	uint64_t DroppedPacketCount;
+	//The highest number of packets that were waiting for the callback.
+	uint64_t MaxQueuedPacketCount;
+};
+
+typedef std::function<void(const BITSTREAM_PACKET &packet)> BitstreamCallback;
+
+/// <summary>
+/// Passes encoded packets to a callback on a delivery thread, so a slow consumer does not hold up the encoder.
+/// The packets wait in a bounded queue. When it is full, new packets are dropped, and after a dropped video frame, video is dropped until the next key frame, so the delivered video can always be decoded.
+/// Packet buffers are taken from a pool and returned to it after the callback, so no memory is allocated per packet once the pool has grown.
+/// Packets can be queued from different threads.
+/// </summary>
+class BitstreamDispatcher
+{
+public:
+	/// <param name="callback">Called on the delivery thread for each packet, in the order they were queued.</param>
+	/// <param name="maxQueuedPackets">The number of packets that can wait for the callback. At least 1.</param>
+	BitstreamDispatcher(BitstreamCallback callback, VideoCodec codec, BitstreamFormat format, size_t maxQueuedPackets);
+	~BitstreamDispatcher();
+	/// <summary>
+	/// Gets an empty buffer from the pool, to read the next packet into before it is queued.
+	/// </summary>
+	std::vector<uint8_t> AcquireBuffer();
+	/// <summary>
+	/// Queues a packet with its video in Annex B format. Starts the delivery thread if it is not running.
+	/// </summary>
+	/// <returns>false if the packet was dropped.</returns>
+	bool Enqueue(ENCODED_PACKET packet);
+	/// <summary>
+	/// Stops the delivery thread. No packets are queued after it.
+	/// </summary>
+	/// <param name="deliverQueued">If true, the queued packets are delivered first, else they are discarded.</param>
+	void Stop(bool deliverQueued);
+	BITSTREAM_DISPATCHER_STATISTICS GetStatistics();
+private:
+	BitstreamCallback m_Callback;
+	VideoCodec m_Codec;
+	BitstreamFormat m_Format;
+	size_t m_MaxQueuedPackets;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_PacketAvailable;
+	std::deque<ENCODED_PACKET> m_Queue;
+	std::vector<std::vector<uint8_t>> m_FreeBuffers;
+	std::thread m_DeliveryThread;
+	bool m_IsStopping;
+	bool m_IsStopped;
+	bool m_IsDeliveringQueued;
+	//Set when a video frame is dropped, as the frames after it cannot be decoded until the next key frame.
+	bool m_IsWaitingForKeyFrame;
+	BITSTREAM_DISPATCHER_STATISTICS m_Statistics;
+
+	//Only used on the delivery thread.
+	std::vector<uint8_t> m_ConvertedData;
+	std::vector<uint8_t> m_ParameterSets;
+
+	void DeliveryThreadLoop();
+	void Deliver(const ENCODED_PACKET &packet);
+};
\ No newline at end of file
@@ -0,0 +1,307 @@
+#include "CBufferedWriteStream.h"
+#include "Log.h"
+#include "Util.h"
+
+namespace {
+	/// <summary>
+	/// Writes the buffers of a CBufferedWriteStream to the stream it wraps, on the write thread of the coalescer.
+	/// </summary>
+	class StreamWriteTarget : public CoalescedWriteTarget {
+	public:
+		StreamWriteTarget(_In_ IStream *pStream, _In_opt_ MetricsRegistry *pMetrics, _In_ const std::string &metricsPrefix) :
+			m_Stream(pStream),
+			m_WriteCount(pMetrics ? pMetrics->GetCounter(metricsPrefix + "output_stream.target_writes") : nullptr),
+			m_SeekCount(pMetrics ? pMetrics->GetCounter(metricsPrefix + "output_stream.target_seeks") : nullptr),
+			m_WriteLatency(pMetrics ? pMetrics->GetHistogram(metricsPrefix + "output_stream.target_write_us") : nullptr)
+		{
+		}
+		virtual bool Seek(uint64_t position) override {
+			LARGE_INTEGER move{};
+			move.QuadPart = static_cast<LONGLONG>(position);
+			HRESULT hr = m_Stream->Seek(move, STREAM_SEEK_SET, nullptr);
+			if (FAILED(hr)) {
+				_com_error err(hr);
+				LOG_ERROR(L"Failed to seek in output stream: %ls", err.ErrorMessage());
+				return false;
+			}
+			if (m_SeekCount) {
+				m_SeekCount->Increment();
+			}
+			return true;
+		}
+		virtual bool Write(const uint8_t *pData, size_t size) override {
+			MeasureLatency measure(m_WriteLatency);
+			while (size > 0) {
+				ULONG written = 0;
+				ULONG chunkSize = static_cast<ULONG>(min(size, static_cast<size_t>(MAXLONG)));
+				HRESULT hr = m_Stream->Write(pData, chunkSize, &written);
+				if (FAILED(hr) || written == 0) {
+					_com_error err(hr);
+					LOG_ERROR(L"Failed to write to output stream: %ls", err.ErrorMessage());
+					return false;
+				}
+				if (m_WriteCount) {
+					m_WriteCount->Increment();
+				}
+				pData += written;
+				size -= written;
+			}
+			return true;
+		}
+	private:
+		CComPtr<IStream> m_Stream;
+		MetricCounter *m_WriteCount;
+		MetricCounter *m_SeekCount;
+		MetricHistogram *m_WriteLatency;
+	};
+}
+
+CBufferedWriteStream::CBufferedWriteStream(_In_ IStream *pStream, _In_opt_ std::shared_ptr<MetricsRegistry> pMetrics, _In_ std::string metricsPrefix) :
+	m_nRefCount(1),
+	m_Mutex{},
+	m_Stream(pStream),
+	m_Coalescer(nullptr),
+	m_Metrics(pMetrics),
+	m_WriteCount(pMetrics ? pMetrics->GetCounter(metricsPrefix + "output_stream.writes") : nullptr),
+	m_ByteCount(pMetrics ? pMetrics->GetCounter(metricsPrefix + "output_stream.bytes") : nullptr),
+	m_StartTime(std::chrono::steady_clock::now()),
+	m_Duration(0),
+	m_Statistics{},
+	m_StreamStat{},
+	m_IsClosed(false)
+{
+}
+
+CBufferedWriteStream::~CBufferedWriteStream()
+{
+	Close();
+}
+
+HRESULT CBufferedWriteStream::CreateInstance(_In_ IStream *pStream, _In_ size_t bufferSize, _In_ size_t bufferCount, _In_opt_ std::shared_ptr<MetricsRegistry> pMetrics, _In_ std::string metricsPrefix, _Outptr_ CBufferedWriteStream **ppStream)
+{
+	*ppStream = nullptr;
+	ULARGE_INTEGER position{};
+	RETURN_ON_BAD_HR(pStream->Seek(LARGE_INTEGER{}, STREAM_SEEK_CUR, &position));
+	STATSTG stat{};
+	RETURN_ON_BAD_HR(pStream->Stat(&stat, STATFLAG_NONAME));
+	CBufferedWriteStream *pBufferedStream = new (std::nothrow)CBufferedWriteStream(pStream, pMetrics, metricsPrefix);
+	if (!pBufferedStream) {
+		return E_OUTOFMEMORY;
+	}
+	pBufferedStream->m_StreamStat = stat;
+	pBufferedStream->m_Coalescer = std::make_unique<WriteCoalescer>(std::make_unique<StreamWriteTarget>(pStream, pMetrics.get(), metricsPrefix), position.QuadPart, bufferSize, bufferCount);
+	*ppStream = pBufferedStream;
+	return S_OK;
+}
+
+HRESULT CBufferedWriteStream::Close()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return S_OK;
+	}
+	bool isFlushed = m_Coalescer->Flush();
+	m_Statistics = m_Coalescer->GetStatistics();
+	//Stops the write thread, which holds the last reference to the other stream apart from this one.
+	m_Coalescer.reset();
+	m_Stream.Release();
+	m_Duration = std::chrono::steady_clock::now() - m_StartTime;
+	m_IsClosed = true;
+	return isFlushed ? S_OK : STG_E_WRITEFAULT;
+}
+
+WRITE_COALESCER_STATISTICS CBufferedWriteStream::GetStatistics()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	return m_IsClosed ? m_Statistics : m_Coalescer->GetStatistics();
+}
+
+std::chrono::steady_clock::duration CBufferedWriteStream::GetDuration()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	return m_IsClosed ? m_Duration : std::chrono::steady_clock::now() - m_StartTime;
+}
+
+HRESULT CBufferedWriteStream::FlushToStream()
+{
+	if (!m_Coalescer->Flush()) {
+		return STG_E_WRITEFAULT;
+	}
+	RETURN_ON_BAD_HR(m_Stream->Stat(&m_StreamStat, STATFLAG_NONAME));
+	LARGE_INTEGER move{};
+	move.QuadPart = static_cast<LONGLONG>(m_Coalescer->GetPosition());
+	return m_Stream->Seek(move, STREAM_SEEK_SET, nullptr);
+}
+
+STDMETHODIMP CBufferedWriteStream::Read(void *pv, ULONG cb, ULONG *pcbRead)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	RETURN_ON_BAD_HR(FlushToStream());
+	ULONG read = 0;
+	HRESULT hr = m_Stream->Read(pv, cb, &read);
+	m_Coalescer->SetPosition(m_Coalescer->GetPosition() + read);
+	if (pcbRead) {
+		*pcbRead = read;
+	}
+	return hr;
+}
+
+STDMETHODIMP CBufferedWriteStream::Write(const void *pv, ULONG cb, ULONG *pcbWritten)
+{
+	if (pcbWritten) {
+		*pcbWritten = 0;
+	}
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	if (!m_Coalescer->Write(static_cast<const uint8_t *>(pv), cb)) {
+		return STG_E_WRITEFAULT;
+	}
+	if (m_WriteCount) {
+		m_WriteCount->Increment();
+		m_ByteCount->Increment(cb);
+	}
+	if (pcbWritten) {
+		*pcbWritten = cb;
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedWriteStream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	LONGLONG position = 0;
+	switch (dwOrigin)
+	{
+		case STREAM_SEEK_SET:
+			position = dlibMove.QuadPart;
+			break;
+		case STREAM_SEEK_CUR:
+			position = static_cast<LONGLONG>(m_Coalescer->GetPosition()) + dlibMove.QuadPart;
+			break;
+		case STREAM_SEEK_END: {
+			//The end of the other stream is only known once the buffered data is written to it.
+			RETURN_ON_BAD_HR(FlushToStream());
+			ULARGE_INTEGER end{};
+			RETURN_ON_BAD_HR(m_Stream->Seek(dlibMove, STREAM_SEEK_END, &end));
+			position = static_cast<LONGLONG>(end.QuadPart);
+			break;
+		}
+		default:
+			return STG_E_INVALIDFUNCTION;
+	}
+	if (position < 0) {
+		return STG_E_INVALIDFUNCTION;
+	}
+	m_Coalescer->SetPosition(static_cast<uint64_t>(position));
+	if (plibNewPosition) {
+		plibNewPosition->QuadPart = static_cast<ULONGLONG>(position);
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedWriteStream::SetSize(ULARGE_INTEGER libNewSize)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	RETURN_ON_BAD_HR(FlushToStream());
+	RETURN_ON_BAD_HR(m_Stream->SetSize(libNewSize));
+	m_StreamStat.cbSize = libNewSize;
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedWriteStream::CopyTo(IStream *pstm, ULARGE_INTEGER cb, ULARGE_INTEGER *pcbRead, ULARGE_INTEGER *pcbWritten)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	RETURN_ON_BAD_HR(FlushToStream());
+	ULARGE_INTEGER read{};
+	HRESULT hr = m_Stream->CopyTo(pstm, cb, &read, pcbWritten);
+	m_Coalescer->SetPosition(m_Coalescer->GetPosition() + read.QuadPart);
+	if (pcbRead) {
+		*pcbRead = read;
+	}
+	return hr;
+}
+
+STDMETHODIMP CBufferedWriteStream::Commit(DWORD grfCommitFlags)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	RETURN_ON_BAD_HR(FlushToStream());
+	return m_Stream->Commit(grfCommitFlags);
+}
+
+STDMETHODIMP CBufferedWriteStream::Revert()
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedWriteStream::LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP CBufferedWriteStream::UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType)
+{
+	return STG_E_INVALIDFUNCTION;
+}
+
+STDMETHODIMP CBufferedWriteStream::Stat(STATSTG *pstatstg, DWORD grfStatFlag)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsClosed) {
+		return STG_E_REVERTED;
+	}
+	if ((grfStatFlag & STATFLAG_NONAME) == 0) {
+		//The name is only known to the other stream, which can only be asked while the write thread is idle.
+		RETURN_ON_BAD_HR(FlushToStream());
+		return m_Stream->Stat(pstatstg, grfStatFlag);
+	}
+	//The size is asked for often, so it is taken from the last flush and extended by the buffered writes, instead of flushing them.
+	*pstatstg = m_StreamStat;
+	pstatstg->cbSize.QuadPart = max(m_StreamStat.cbSize.QuadPart, m_Coalescer->GetBufferedEndPosition());
+	return S_OK;
+}
+
+STDMETHODIMP CBufferedWriteStream::Clone(IStream **ppstm)
+{
+	return E_NOTIMPL;
+}
+
+STDMETHODIMP CBufferedWriteStream::QueryInterface(REFIID riid, void **ppv)
+{
+	static const QITAB qit[] = {
+		QITABENT(CBufferedWriteStream, IStream),
+		QITABENTMULTI(CBufferedWriteStream, ISequentialStream, IStream),
+	{0}
+	};
+	return QISearch(this, qit, riid, ppv);
+}
+
+STDMETHODIMP_(ULONG) CBufferedWriteStream::AddRef()
+{
+	return InterlockedIncrement(&m_nRefCount);
+}
+
+STDMETHODIMP_(ULONG) CBufferedWriteStream::Release()
+{
+	ULONG refCount = InterlockedDecrement(&m_nRefCount);
+	if (refCount == 0) {
+		delete this;
+	}
+	return refCount;
+}
\ No newline at end of file
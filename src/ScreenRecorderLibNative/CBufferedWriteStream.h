@@ -0,0 +1,73 @@
+#pragma once
+#include <objidl.h>
+#include <Shlwapi.h>
+#include <atlbase.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "Metrics.h"
+#include "Sync.h"
+#include "WriteCoalescer.h"
+
+/// <summary>
+/// A stream that batches the writes to another stream with a WriteCoalescer, so the recording is written to it in large blocks on a background thread.
+/// The Media Foundation sinks make many small writes, and seek back to update the headers, which is kept in order. The stream is flushed before it is read, resized or committed, so these see the data written.
+/// The counters "output_stream.writes" and "output_stream.bytes" count the writes made to this stream, and "output_stream.target_writes" and "output_stream.target_seeks" the calls made to the other stream.
+/// </summary>
+class CBufferedWriteStream : public IStream {
+public:
+	static HRESULT CreateInstance(_In_ IStream *pStream, _In_ size_t bufferSize, _In_ size_t bufferCount, _In_opt_ std::shared_ptr<MetricsRegistry> pMetrics, _In_ std::string metricsPrefix, _Outptr_ CBufferedWriteStream **ppStream);
+	/// <summary>
+	/// Writes the buffered data to the other stream and releases it. The stream cannot be used after it.
+	/// </summary>
+	/// <returns>STG_E_WRITEFAULT if a write to the other stream has failed.</returns>
+	HRESULT Close();
+	WRITE_COALESCER_STATISTICS GetStatistics();
+	/// <summary>
+	/// The time since the stream was created, or until it was closed.
+	/// </summary>
+	std::chrono::steady_clock::duration GetDuration();
+
+	// ISequentialStream methods
+	STDMETHODIMP Read(void *pv, ULONG cb, ULONG *pcbRead);
+	STDMETHODIMP Write(const void *pv, ULONG cb, ULONG *pcbWritten);
+
+	// IStream methods
+	STDMETHODIMP Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition);
+	STDMETHODIMP SetSize(ULARGE_INTEGER libNewSize);
+	STDMETHODIMP CopyTo(IStream *pstm, ULARGE_INTEGER cb, ULARGE_INTEGER *pcbRead, ULARGE_INTEGER *pcbWritten);
+	STDMETHODIMP Commit(DWORD grfCommitFlags);
+	STDMETHODIMP Revert();
+	STDMETHODIMP LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	STDMETHODIMP UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb, DWORD dwLockType);
+	STDMETHODIMP Stat(STATSTG *pstatstg, DWORD grfStatFlag);
+	STDMETHODIMP Clone(IStream **ppstm);
+
+	// IUnknown methods
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+private:
+	CBufferedWriteStream(_In_ IStream *pStream, _In_opt_ std::shared_ptr<MetricsRegistry> pMetrics, _In_ std::string metricsPrefix);
+	virtual ~CBufferedWriteStream();
+	/// <summary>
+	/// Writes the buffered data, and moves the other stream to the current position, so it can be used directly. Updates the statistics of the other stream.
+	/// </summary>
+	HRESULT FlushToStream();
+
+	volatile long m_nRefCount;
+	SyncMutex m_Mutex;
+	//Released when the stream is closed.
+	CComPtr<IStream> m_Stream;
+	std::unique_ptr<WriteCoalescer> m_Coalescer;
+	//Keeps the counters of this stream and of the write thread alive.
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	MetricCounter *m_WriteCount;
+	MetricCounter *m_ByteCount;
+	std::chrono::steady_clock::time_point m_StartTime;
+	std::chrono::steady_clock::duration m_Duration;
+	WRITE_COALESCER_STATISTICS m_Statistics;
+	//The statistics of the other stream without its name, as of the last flush. The write thread can be writing to the other stream at any other time, so Stat does not ask it directly.
+	STATSTG m_StreamStat;
+	bool m_IsClosed;
+};
\ No newline at end of file
@@ -0,0 +1,520 @@
+#include "CMFPacketMediaSink.h"
+#include "Log.h"
+#include "Util.h"
+
+CMFPacketStreamSink::CMFPacketStreamSink(_In_ DWORD streamId, _In_ CMFPacketMediaSink *pSink, _In_ PacketSampleCallback callback) :
+	m_nRefCount(1),
+	m_Mutex{},
+	m_StreamId(streamId),
+	m_Sink(static_cast<IMFMediaSink *>(pSink)),
+	m_EventQueue(nullptr),
+	m_MediaType(nullptr),
+	m_Callback(callback),
+	m_IsShutdown(false)
+{
+}
+
+CMFPacketStreamSink::~CMFPacketStreamSink()
+{
+}
+
+HRESULT CMFPacketStreamSink::Initialize(_In_ IMFMediaType *pMediaType)
+{
+	RETURN_ON_BAD_HR(MFCreateEventQueue(&m_EventQueue));
+	RETURN_ON_BAD_HR(MFCreateMediaType(&m_MediaType));
+	return pMediaType->CopyAllItems(m_MediaType);
+}
+
+HRESULT CMFPacketStreamSink::Start()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	RETURN_ON_BAD_HR(m_EventQueue->QueueEventParamVar(MEStreamSinkStarted, GUID_NULL, S_OK, nullptr));
+	//Samples are processed as soon as they arrive, so a new sample is requested for each one processed. A second request keeps the encoder from waiting on the sink.
+	RETURN_ON_BAD_HR(m_EventQueue->QueueEventParamVar(MEStreamSinkRequestSample, GUID_NULL, S_OK, nullptr));
+	return m_EventQueue->QueueEventParamVar(MEStreamSinkRequestSample, GUID_NULL, S_OK, nullptr);
+}
+
+HRESULT CMFPacketStreamSink::Stop()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_EventQueue->QueueEventParamVar(MEStreamSinkStopped, GUID_NULL, S_OK, nullptr);
+}
+
+HRESULT CMFPacketStreamSink::Pause()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_EventQueue->QueueEventParamVar(MEStreamSinkPaused, GUID_NULL, S_OK, nullptr);
+}
+
+void CMFPacketStreamSink::Shutdown()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return;
+	}
+	m_IsShutdown = true;
+	if (m_EventQueue) {
+		m_EventQueue->Shutdown();
+	}
+	m_Sink.Release();
+	m_Callback = nullptr;
+}
+
+HRESULT CMFPacketStreamSink::CopyCurrentMediaType(_Outptr_ IMFMediaType **ppMediaType)
+{
+	*ppMediaType = nullptr;
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	CComPtr<IMFMediaType> pMediaType = nullptr;
+	RETURN_ON_BAD_HR(MFCreateMediaType(&pMediaType));
+	RETURN_ON_BAD_HR(m_MediaType->CopyAllItems(pMediaType));
+	*ppMediaType = pMediaType.Detach();
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetEvent(DWORD dwFlags, IMFMediaEvent **ppEvent)
+{
+	CComPtr<IMFMediaEventQueue> pEventQueue = nullptr;
+	{
+		const std::lock_guard<SyncMutex> lock(m_Mutex);
+		if (m_IsShutdown) {
+			return MF_E_SHUTDOWN;
+		}
+		pEventQueue = m_EventQueue;
+	}
+	//GetEvent can block, so it is called without holding the lock.
+	return pEventQueue->GetEvent(dwFlags, ppEvent);
+}
+
+STDMETHODIMP CMFPacketStreamSink::BeginGetEvent(IMFAsyncCallback *pCallback, IUnknown *punkState)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_EventQueue->BeginGetEvent(pCallback, punkState);
+}
+
+STDMETHODIMP CMFPacketStreamSink::EndGetEvent(IMFAsyncResult *pResult, IMFMediaEvent **ppEvent)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_EventQueue->EndGetEvent(pResult, ppEvent);
+}
+
+STDMETHODIMP CMFPacketStreamSink::QueueEvent(MediaEventType met, REFGUID guidExtendedType, HRESULT hrStatus, const PROPVARIANT *pvValue)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_EventQueue->QueueEventParamVar(met, guidExtendedType, hrStatus, pvValue);
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetMediaSink(IMFMediaSink **ppMediaSink)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_Sink.CopyTo(ppMediaSink);
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetIdentifier(DWORD *pdwIdentifier)
+{
+	*pdwIdentifier = m_StreamId;
+	return m_IsShutdown ? MF_E_SHUTDOWN : S_OK;
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetMediaTypeHandler(IMFMediaTypeHandler **ppHandler)
+{
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return QueryInterface(IID_PPV_ARGS(ppHandler));
+}
+
+STDMETHODIMP CMFPacketStreamSink::ProcessSample(IMFSample *pSample)
+{
+	if (!pSample) {
+		return E_POINTER;
+	}
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	if (m_Callback) {
+		m_Callback(m_StreamId, pSample);
+	}
+	return m_EventQueue->QueueEventParamVar(MEStreamSinkRequestSample, GUID_NULL, S_OK, nullptr);
+}
+
+STDMETHODIMP CMFPacketStreamSink::PlaceMarker(MFSTREAMSINK_MARKER_TYPE eMarkerType, const PROPVARIANT *pvarMarkerValue, const PROPVARIANT *pvarContextValue)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	//All samples before the marker have already been processed, so it is reached at once.
+	return m_EventQueue->QueueEventParamVar(MEStreamSinkMarker, GUID_NULL, S_OK, pvarContextValue);
+}
+
+STDMETHODIMP CMFPacketStreamSink::Flush()
+{
+	return m_IsShutdown ? MF_E_SHUTDOWN : S_OK;
+}
+
+STDMETHODIMP CMFPacketStreamSink::IsMediaTypeSupported(IMFMediaType *pMediaType, IMFMediaType **ppMediaType)
+{
+	if (ppMediaType) {
+		*ppMediaType = nullptr;
+	}
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	GUID majorType, subtype, currentMajorType, currentSubtype;
+	RETURN_ON_BAD_HR(pMediaType->GetMajorType(&majorType));
+	RETURN_ON_BAD_HR(pMediaType->GetGUID(MF_MT_SUBTYPE, &subtype));
+	RETURN_ON_BAD_HR(m_MediaType->GetMajorType(&currentMajorType));
+	RETURN_ON_BAD_HR(m_MediaType->GetGUID(MF_MT_SUBTYPE, &currentSubtype));
+	return majorType == currentMajorType && subtype == currentSubtype ? S_OK : MF_E_INVALIDMEDIATYPE;
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetMediaTypeCount(DWORD *pdwTypeCount)
+{
+	*pdwTypeCount = 1;
+	return m_IsShutdown ? MF_E_SHUTDOWN : S_OK;
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetMediaTypeByIndex(DWORD dwIndex, IMFMediaType **ppType)
+{
+	if (dwIndex > 0) {
+		return MF_E_NO_MORE_TYPES;
+	}
+	return GetCurrentMediaType(ppType);
+}
+
+STDMETHODIMP CMFPacketStreamSink::SetCurrentMediaType(IMFMediaType *pMediaType)
+{
+	HRESULT hr = IsMediaTypeSupported(pMediaType, nullptr);
+	if (FAILED(hr)) {
+		return hr;
+	}
+	CComPtr<IMFMediaType> pCurrentMediaType = nullptr;
+	RETURN_ON_BAD_HR(MFCreateMediaType(&pCurrentMediaType));
+	RETURN_ON_BAD_HR(pMediaType->CopyAllItems(pCurrentMediaType));
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	m_MediaType = pCurrentMediaType;
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetCurrentMediaType(IMFMediaType **ppMediaType)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_MediaType.CopyTo(ppMediaType);
+}
+
+STDMETHODIMP CMFPacketStreamSink::GetMajorType(GUID *pguidMajorType)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	return m_MediaType->GetMajorType(pguidMajorType);
+}
+
+STDMETHODIMP CMFPacketStreamSink::QueryInterface(REFIID riid, void **ppv)
+{
+	static const QITAB qit[] = {
+		QITABENT(CMFPacketStreamSink, IMFStreamSink),
+		QITABENTMULTI(CMFPacketStreamSink, IMFMediaEventGenerator, IMFStreamSink),
+		QITABENT(CMFPacketStreamSink, IMFMediaTypeHandler),
+	{0}
+	};
+	return QISearch(this, qit, riid, ppv);
+}
+
+STDMETHODIMP_(ULONG) CMFPacketStreamSink::AddRef()
+{
+	return InterlockedIncrement(&m_nRefCount);
+}
+
+STDMETHODIMP_(ULONG) CMFPacketStreamSink::Release()
+{
+	ULONG refCount = InterlockedDecrement(&m_nRefCount);
+	if (refCount == 0) {
+		delete this;
+	}
+	return refCount;
+}
+
+CMFPacketMediaSink::CMFPacketMediaSink() :
+	m_nRefCount(1),
+	m_Mutex{},
+	m_Streams{},
+	m_Clock(nullptr),
+	m_FinalizeCallback(nullptr),
+	m_IsShutdown(false)
+{
+}
+
+CMFPacketMediaSink::~CMFPacketMediaSink()
+{
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		pStream->Release();
+	}
+	m_Streams.clear();
+}
+
+HRESULT CMFPacketMediaSink::CreateInstance(_In_ IMFMediaType *pVideoMediaType, _In_opt_ IMFMediaType *pAudioMediaType, _In_ PacketSampleCallback callback, _In_opt_ PacketFinalizeCallback finalizeCallback, _Outptr_ CMFPacketMediaSink **ppSink)
+{
+	*ppSink = nullptr;
+	CMFPacketMediaSink *pSink = new (std::nothrow)CMFPacketMediaSink();
+	if (!pSink) {
+		return E_OUTOFMEMORY;
+	}
+	pSink->m_FinalizeCallback = finalizeCallback;
+	HRESULT hr = S_OK;
+	IMFMediaType *mediaTypes[]{ pVideoMediaType, pAudioMediaType };
+	for (DWORD streamId = 0; streamId < ARRAYSIZE(mediaTypes) && SUCCEEDED(hr); streamId++) {
+		if (!mediaTypes[streamId]) {
+			continue;
+		}
+		CMFPacketStreamSink *pStream = new (std::nothrow)CMFPacketStreamSink(streamId, pSink, callback);
+		if (!pStream) {
+			hr = E_OUTOFMEMORY;
+			break;
+		}
+		pSink->m_Streams.push_back(pStream);
+		hr = pStream->Initialize(mediaTypes[streamId]);
+	}
+	if (FAILED(hr)) {
+		//The streams reference the sink until they are shut down.
+		pSink->Shutdown();
+		pSink->Release();
+		return hr;
+	}
+	*ppSink = pSink;
+	return S_OK;
+}
+
+HRESULT CMFPacketMediaSink::GetStreamMediaType(_In_ DWORD streamId, _Outptr_ IMFMediaType **ppMediaType)
+{
+	*ppMediaType = nullptr;
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		DWORD id;
+		pStream->GetIdentifier(&id);
+		if (id == streamId) {
+			return pStream->CopyCurrentMediaType(ppMediaType);
+		}
+	}
+	return MF_E_INVALIDSTREAMNUMBER;
+}
+
+STDMETHODIMP CMFPacketMediaSink::GetCharacteristics(DWORD *pdwCharacteristics)
+{
+	*pdwCharacteristics = MEDIASINK_FIXED_STREAMS | MEDIASINK_RATELESS;
+	return m_IsShutdown ? MF_E_SHUTDOWN : S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::AddStreamSink(DWORD dwStreamSinkIdentifier, IMFMediaType *pMediaType, IMFStreamSink **ppStreamSink)
+{
+	return MF_E_STREAMSINKS_FIXED;
+}
+
+STDMETHODIMP CMFPacketMediaSink::RemoveStreamSink(DWORD dwStreamSinkIdentifier)
+{
+	return MF_E_STREAMSINKS_FIXED;
+}
+
+STDMETHODIMP CMFPacketMediaSink::GetStreamSinkCount(DWORD *pcStreamSinkCount)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	*pcStreamSinkCount = static_cast<DWORD>(m_Streams.size());
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::GetStreamSinkByIndex(DWORD dwIndex, IMFStreamSink **ppStreamSink)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	if (dwIndex >= m_Streams.size()) {
+		return MF_E_INVALIDINDEX;
+	}
+	*ppStreamSink = m_Streams[dwIndex];
+	(*ppStreamSink)->AddRef();
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::GetStreamSinkById(DWORD dwStreamSinkIdentifier, IMFStreamSink **ppStreamSink)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		DWORD id;
+		pStream->GetIdentifier(&id);
+		if (id == dwStreamSinkIdentifier) {
+			*ppStreamSink = pStream;
+			(*ppStreamSink)->AddRef();
+			return S_OK;
+		}
+	}
+	return MF_E_INVALIDSTREAMNUMBER;
+}
+
+STDMETHODIMP CMFPacketMediaSink::SetPresentationClock(IMFPresentationClock *pPresentationClock)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	if (m_Clock) {
+		RETURN_ON_BAD_HR(m_Clock->RemoveClockStateSink(this));
+	}
+	if (pPresentationClock) {
+		RETURN_ON_BAD_HR(pPresentationClock->AddClockStateSink(this));
+	}
+	m_Clock = pPresentationClock;
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::GetPresentationClock(IMFPresentationClock **ppPresentationClock)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	if (!m_Clock) {
+		return MF_E_NO_CLOCK;
+	}
+	return m_Clock.CopyTo(ppPresentationClock);
+}
+
+STDMETHODIMP CMFPacketMediaSink::Shutdown()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (m_IsShutdown) {
+		return MF_E_SHUTDOWN;
+	}
+	m_IsShutdown = true;
+	//The streams are kept, so their media types can still be read.
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		pStream->Shutdown();
+	}
+	if (m_Clock) {
+		m_Clock->RemoveClockStateSink(this);
+		m_Clock.Release();
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::BeginFinalize(IMFAsyncCallback *pCallback, IUnknown *punkState)
+{
+	HRESULT finalizeResult = S_OK;
+	{
+		const std::lock_guard<SyncMutex> lock(m_Mutex);
+		if (m_IsShutdown) {
+			return MF_E_SHUTDOWN;
+		}
+		if (m_FinalizeCallback) {
+			finalizeResult = m_FinalizeCallback();
+		}
+	}
+	//The finalization is done synchronously, and the result is passed to the caller through the callback.
+	CComPtr<IMFAsyncResult> pResult = nullptr;
+	RETURN_ON_BAD_HR(MFCreateAsyncResult(nullptr, pCallback, punkState, &pResult));
+	pResult->SetStatus(finalizeResult);
+	return MFInvokeCallback(pResult);
+}
+
+STDMETHODIMP CMFPacketMediaSink::EndFinalize(IMFAsyncResult *pResult)
+{
+	if (!pResult) {
+		return E_INVALIDARG;
+	}
+	return pResult->GetStatus();
+}
+
+STDMETHODIMP CMFPacketMediaSink::OnClockStart(MFTIME hnsSystemTime, LONGLONG llClockStartOffset)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		RETURN_ON_BAD_HR(pStream->Start());
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::OnClockStop(MFTIME hnsSystemTime)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		RETURN_ON_BAD_HR(pStream->Stop());
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::OnClockPause(MFTIME hnsSystemTime)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	for (CMFPacketStreamSink *pStream : m_Streams) {
+		RETURN_ON_BAD_HR(pStream->Pause());
+	}
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::OnClockRestart(MFTIME hnsSystemTime)
+{
+	return OnClockStart(hnsSystemTime, PRESENTATION_CURRENT_POSITION);
+}
+
+STDMETHODIMP CMFPacketMediaSink::OnClockSetRate(MFTIME hnsSystemTime, float flRate)
+{
+	return S_OK;
+}
+
+STDMETHODIMP CMFPacketMediaSink::QueryInterface(REFIID riid, void **ppv)
+{
+	static const QITAB qit[] = {
+		QITABENT(CMFPacketMediaSink, IMFFinalizableMediaSink),
+		QITABENTMULTI(CMFPacketMediaSink, IMFMediaSink, IMFFinalizableMediaSink),
+		QITABENT(CMFPacketMediaSink, IMFClockStateSink),
+	{0}
+	};
+	return QISearch(this, qit, riid, ppv);
+}
+
+STDMETHODIMP_(ULONG) CMFPacketMediaSink::AddRef()
+{
+	return InterlockedIncrement(&m_nRefCount);
+}
+
+STDMETHODIMP_(ULONG) CMFPacketMediaSink::Release()
+{
+	ULONG refCount = InterlockedDecrement(&m_nRefCount);
+	if (refCount == 0) {
+		delete this;
+	}
+	return refCount;
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#pragma once
+#include <mfapi.h>
+#include <mfidl.h>
+#include <Shlwapi.h>
+#include <atlbase.h>
+#include <functional>
+#include <vector>
+#include "Sync.h"
+
+/// <summary>
+/// Called with each encoded sample written to a stream of a CMFPacketMediaSink. The sample must not be modified, and is only valid during the call.
+/// </summary>
+typedef std::function<void(_In_ DWORD streamId, _In_ IMFSample *pSample)> PacketSampleCallback;
+/// <summary>
+/// Called when the sink writer is finalized, after the last sample was passed to the PacketSampleCallback. The result is returned from the finalization.
+/// </summary>
+typedef std::function<HRESULT()> PacketFinalizeCallback;
+
+class CMFPacketMediaSink;
+
+/// <summary>
+/// A stream of a CMFPacketMediaSink. It is its own media type handler, and accepts only the subtype it was created with.
+/// </summary>
+class CMFPacketStreamSink : public IMFStreamSink, public IMFMediaTypeHandler {
+public:
+	CMFPacketStreamSink(_In_ DWORD streamId, _In_ CMFPacketMediaSink *pSink, _In_ PacketSampleCallback callback);
+	virtual ~CMFPacketStreamSink();
+	HRESULT Initialize(_In_ IMFMediaType *pMediaType);
+	HRESULT Start();
+	HRESULT Stop();
+	HRESULT Pause();
+	void Shutdown();
+	/// <summary>
+	/// Gets a copy of the current media type. Unlike GetCurrentMediaType, it can be called after shutdown.
+	/// </summary>
+	HRESULT CopyCurrentMediaType(_Outptr_ IMFMediaType **ppMediaType);
+
+	// IMFMediaEventGenerator methods
+	STDMETHODIMP GetEvent(DWORD dwFlags, IMFMediaEvent **ppEvent);
+	STDMETHODIMP BeginGetEvent(IMFAsyncCallback *pCallback, IUnknown *punkState);
+	STDMETHODIMP EndGetEvent(IMFAsyncResult *pResult, IMFMediaEvent **ppEvent);
+	STDMETHODIMP QueueEvent(MediaEventType met, REFGUID guidExtendedType, HRESULT hrStatus, const PROPVARIANT *pvValue);
+
+	// IMFStreamSink methods
+	STDMETHODIMP GetMediaSink(IMFMediaSink **ppMediaSink);
+	STDMETHODIMP GetIdentifier(DWORD *pdwIdentifier);
+	STDMETHODIMP GetMediaTypeHandler(IMFMediaTypeHandler **ppHandler);
+	STDMETHODIMP ProcessSample(IMFSample *pSample);
+	STDMETHODIMP PlaceMarker(MFSTREAMSINK_MARKER_TYPE eMarkerType, const PROPVARIANT *pvarMarkerValue, const PROPVARIANT *pvarContextValue);
+	STDMETHODIMP Flush();
+
+	// IMFMediaTypeHandler methods
+	STDMETHODIMP IsMediaTypeSupported(IMFMediaType *pMediaType, IMFMediaType **ppMediaType);
+	STDMETHODIMP GetMediaTypeCount(DWORD *pdwTypeCount);
+	STDMETHODIMP GetMediaTypeByIndex(DWORD dwIndex, IMFMediaType **ppType);
+	STDMETHODIMP SetCurrentMediaType(IMFMediaType *pMediaType);
+	STDMETHODIMP GetCurrentMediaType(IMFMediaType **ppMediaType);
+	STDMETHODIMP GetMajorType(GUID *pguidMajorType);
+
+	// IUnknown methods
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+private:
+	volatile long m_nRefCount;
+	SyncMutex m_Mutex;
+	DWORD m_StreamId;
+	//Released on shutdown, which breaks the reference cycle between the sink and its streams.
+	CComPtr<IMFMediaSink> m_Sink;
+	CComPtr<IMFMediaEventQueue> m_EventQueue;
+	CComPtr<IMFMediaType> m_MediaType;
+	PacketSampleCallback m_Callback;
+	bool m_IsShutdown;
+};
+
+/// <summary>
+/// A media sink that passes the encoded samples to a callback, instead of writing them to a container.
+/// It is used with a sink writer, which encodes the samples written to it. It has a video stream with ID 0, and an audio stream with ID 1 if it was created with an audio type.
+/// </summary>
+class CMFPacketMediaSink : public IMFFinalizableMediaSink, public IMFClockStateSink {
+public:
+	static HRESULT CreateInstance(_In_ IMFMediaType *pVideoMediaType, _In_opt_ IMFMediaType *pAudioMediaType, _In_ PacketSampleCallback callback, _In_opt_ PacketFinalizeCallback finalizeCallback, _Outptr_ CMFPacketMediaSink **ppSink);
+	/// <summary>
+	/// Gets the current media type of a stream. The sink writer sets it to the output type of the encoder, which can include the codec private data.
+	/// </summary>
+	HRESULT GetStreamMediaType(_In_ DWORD streamId, _Outptr_ IMFMediaType **ppMediaType);
+
+	// IMFMediaSink methods
+	STDMETHODIMP GetCharacteristics(DWORD *pdwCharacteristics);
+	STDMETHODIMP AddStreamSink(DWORD dwStreamSinkIdentifier, IMFMediaType *pMediaType, IMFStreamSink **ppStreamSink);
+	STDMETHODIMP RemoveStreamSink(DWORD dwStreamSinkIdentifier);
+	STDMETHODIMP GetStreamSinkCount(DWORD *pcStreamSinkCount);
+	STDMETHODIMP GetStreamSinkByIndex(DWORD dwIndex, IMFStreamSink **ppStreamSink);
+	STDMETHODIMP GetStreamSinkById(DWORD dwStreamSinkIdentifier, IMFStreamSink **ppStreamSink);
+	STDMETHODIMP SetPresentationClock(IMFPresentationClock *pPresentationClock);
+	STDMETHODIMP GetPresentationClock(IMFPresentationClock **ppPresentationClock);
+	STDMETHODIMP Shutdown();
+
+	// IMFFinalizableMediaSink methods
+	STDMETHODIMP BeginFinalize(IMFAsyncCallback *pCallback, IUnknown *punkState);
+	STDMETHODIMP EndFinalize(IMFAsyncResult *pResult);
+
+	// IMFClockStateSink methods
+	STDMETHODIMP OnClockStart(MFTIME hnsSystemTime, LONGLONG llClockStartOffset);
+	STDMETHODIMP OnClockStop(MFTIME hnsSystemTime);
+	STDMETHODIMP OnClockPause(MFTIME hnsSystemTime);
+	STDMETHODIMP OnClockRestart(MFTIME hnsSystemTime);
+	STDMETHODIMP OnClockSetRate(MFTIME hnsSystemTime, float flRate);
+
+	// IUnknown methods
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv);
+	STDMETHODIMP_(ULONG) AddRef();
+	STDMETHODIMP_(ULONG) Release();
+private:
+	CMFPacketMediaSink();
+	virtual ~CMFPacketMediaSink();
+
+	volatile long m_nRefCount;
+	SyncMutex m_Mutex;
+	//Each stream holds a reference, which is released when the sink is destroyed.
+	std::vector<CMFPacketStreamSink *> m_Streams;
+	CComPtr<IMFPresentationClock> m_Clock;
+	PacketFinalizeCallback m_FinalizeCallback;
+	bool m_IsShutdown;
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <mfapi.h>
+#include <mfidl.h>
+#include <Shlwapi.h>
+#include <chrono>
+#include <memory>
+#include "InFlightSampleTracker.h"
+#include "Metrics.h"
+/// <summary>
+/// Counts video samples as released when the encoder is done with them. It is set as the allocator of tracked samples, and as the notify callback of sample allocators.
+/// </summary>
+class CMFSampleReleaseCallback : public IMFAsyncCallback, public IMFVideoSampleAllocatorNotify {
+
+public:
+	CMFSampleReleaseCallback(_In_ std::shared_ptr<InFlightSampleTracker> pTracker, _In_ std::shared_ptr<MetricsRegistry> pMetrics, _In_ std::string latencyMetricName) :
+		m_nRefCount(1),
+		m_Tracker(pTracker),
+		m_Metrics(pMetrics),
+		m_EncodeLatency(pMetrics->GetHistogram(latencyMetricName)) {}
+	virtual ~CMFSampleReleaseCallback()
+	{
+	}
+	/// <summary>
+	/// Counts a sample as submitted to the encoder. Must only be called once the sample will be released through this callback.
+	/// </summary>
+	/// <param name="isReserved">If true, the sample takes the place of the reservation made for it with the tracker.</param>
+	void OnSampleSubmitted(_In_ UINT64 byteCount, _In_ bool isReserved = false) {
+		m_Tracker->Submit(byteCount, GetTime(), isReserved);
+	}
+
+	// IMFAsyncCallback methods
+	STDMETHODIMP GetParameters(DWORD *pdwFlags, DWORD *pdwQueue) {
+		return E_NOTIMPL;
+	}
+
+	STDMETHODIMP Invoke(IMFAsyncResult *pAsyncResult) {
+		OnSampleReleased();
+		return S_OK;
+	}
+
+	// IMFVideoSampleAllocatorNotify methods
+	STDMETHODIMP NotifyRelease() {
+		OnSampleReleased();
+		return S_OK;
+	}
+
+	// IUnknown methods
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv) {
+		static const QITAB qit[] = {
+			QITABENT(CMFSampleReleaseCallback, IMFAsyncCallback),
+			QITABENT(CMFSampleReleaseCallback, IMFVideoSampleAllocatorNotify),
+		{0}
+		};
+		return QISearch(this, qit, riid, ppv);
+	}
+
+	STDMETHODIMP_(ULONG) AddRef() {
+		return InterlockedIncrement(&m_nRefCount);
+	}
+
+	STDMETHODIMP_(ULONG) Release() {
+		ULONG refCount = InterlockedDecrement(&m_nRefCount);
+		if (refCount == 0) {
+			delete this;
+		}
+		return refCount;
+	}
+
+private:
+	static INT64 GetTime() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 100;
+	}
+
+	void OnSampleReleased() {
+		INT64 latency = m_Tracker->Release(GetTime());
+		if (latency >= 0) {
+			m_EncodeLatency->Record(latency / 10);
+		}
+	}
+
+	volatile long m_nRefCount;
+	std::shared_ptr<InFlightSampleTracker> m_Tracker;
+	//Keeps the histogram alive, as samples can be released after the recording has ended.
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	MetricHistogram *m_EncodeLatency;
+};
\ No newline at end of file
@@ -35,8 +35,7 @@ HRESULT CameraCapture::InitializeSourceReader(
 	HRESULT hr = E_FAIL;
 	CComPtr<IMFAttributes> pAttributes = nullptr;
 	CComPtr<IMFSourceReader> pSourceReader = nullptr;
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"InitializeSourceReader device capture");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	UINT32 count = 0;
 	IMFActivate **ppDevices = NULL;
 	ReleaseCOMArrayOnExit releaseDevicesOnExit((IUnknown **)ppDevices, count);
@@ -126,8 +125,7 @@ HRESULT CameraCapture::InitializeMediaSource(
 	MeasureExecutionTime measure(L"InitializeMediaSource");
 	CComPtr<IMFSourceReader> pSourceReader = nullptr;
 	CComPtr<IMFAttributes> pAttributes = nullptr;
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 
 	if (sourceFormatIndex.has_value()) {
 		SetDeviceFormat(pSource, sourceFormatIndex.value());
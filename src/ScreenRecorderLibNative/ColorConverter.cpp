@@ -0,0 +1,539 @@
+#include "ColorConverter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if !defined(COLOR_CONVERTER_NO_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define COLOR_CONVERTER_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#define COLOR_CONVERTER_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace {
+	//Frames smaller than this are converted on the calling thread, as the cost of waking the workers outweighs the gain.
+	const int64_t MIN_PIXELS_PER_BAND = 256 * 1024;
+
+	inline bool IsHighBitDepth(YUVFormat format) {
+		return format == YUVFormat::P010;
+	}
+
+	inline int32_t Clamp(int32_t value, int32_t max) {
+		return std::min(std::max(value, 0), max);
+	}
+
+	//Rounds a fixed point value with the given number of fraction bits to the nearest integer.
+	inline int32_t Round(int32_t value, int32_t shift) {
+		return (value + (1 << (shift - 1))) >> shift;
+	}
+
+	inline void StoreSample(uint8_t *pDst, int32_t index, int32_t value, bool isHighBitDepth) {
+		if (isHighBitDepth) {
+			reinterpret_cast<uint16_t *>(pDst)[index] = static_cast<uint16_t>(value << 6);
+		}
+		else {
+			pDst[index] = static_cast<uint8_t>(value);
+		}
+	}
+
+#if defined(COLOR_CONVERTER_SSE2)
+	/// <summary>
+	/// Multiplies four BGRA pixels, widened to 16 bits with two pixels per register, with the coefficients, and sums the products of each pixel.
+	/// </summary>
+	/// <returns>The four sums, rounded and shifted down.</returns>
+	inline __m128i MultiplyPixels(__m128i pixels01, __m128i pixels23, __m128i coefficients, __m128i rounding, __m128i shiftCount) {
+		//Each pixel yields B*cb + G*cg and R*cr in two adjacent lanes, which are summed into the even lane.
+		__m128i lo = _mm_madd_epi16(pixels01, coefficients);
+		__m128i hi = _mm_madd_epi16(pixels23, coefficients);
+		lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+		hi = _mm_add_epi32(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+		__m128i sum = _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)));
+		return _mm_sra_epi32(_mm_add_epi32(sum, rounding), shiftCount);
+	}
+
+	inline __m128i LoadCoefficients(const int32_t *pCoefficients) {
+		return _mm_setr_epi16(
+			static_cast<int16_t>(pCoefficients[0]), static_cast<int16_t>(pCoefficients[1]), static_cast<int16_t>(pCoefficients[2]), 0,
+			static_cast<int16_t>(pCoefficients[0]), static_cast<int16_t>(pCoefficients[1]), static_cast<int16_t>(pCoefficients[2]), 0);
+	}
+#endif
+
+	/// <summary>
+	/// Converts a row of BGRA pixels to luma. The coefficients are in memory order, B, G, R.
+	/// </summary>
+	void ConvertLumaRow(const uint8_t *pSrc, uint8_t *pDst, int32_t width, const int32_t *pCoefficients, int32_t offset, int32_t max, int32_t shift, bool isHighBitDepth)
+	{
+		int32_t x = 0;
+#if defined(COLOR_CONVERTER_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i coefficients = LoadCoefficients(pCoefficients);
+		//The offset is folded into the rounding term, which is exact as it is a multiple of the divisor.
+		const __m128i rounding = _mm_set1_epi32((1 << (shift - 1)) + (offset << shift));
+		const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+		const __m128i maxValue = _mm_set1_epi16(static_cast<int16_t>(max));
+		auto convertFour = [&](const uint8_t *pPixels) {
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pPixels));
+			return MultiplyPixels(_mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero), coefficients, rounding, shiftCount);
+		};
+		for (; x + 8 <= width; x += 8) {
+			__m128i words = _mm_packs_epi32(convertFour(pSrc + x * 4), convertFour(pSrc + x * 4 + 16));
+			if (isHighBitDepth) {
+				words = _mm_min_epi16(_mm_max_epi16(words, zero), maxValue);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + x * 2), _mm_slli_epi16(words, 6));
+			}
+			else {
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(pDst + x), _mm_packus_epi16(words, words));
+			}
+		}
+#elif defined(COLOR_CONVERTER_NEON)
+		const int32x4_t rounding = vdupq_n_s32((1 << (shift - 1)) + (offset << shift));
+		const int32x4_t shiftCount = vdupq_n_s32(-shift);
+		const int16x8_t maxValue = vdupq_n_s16(static_cast<int16_t>(max));
+		const int16_t cb = static_cast<int16_t>(pCoefficients[0]);
+		const int16_t cg = static_cast<int16_t>(pCoefficients[1]);
+		const int16_t cr = static_cast<int16_t>(pCoefficients[2]);
+		for (; x + 8 <= width; x += 8) {
+			uint8x8x4_t pixels = vld4_u8(pSrc + x * 4);
+			int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(pixels.val[0]));
+			int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(pixels.val[1]));
+			int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(pixels.val[2]));
+			int32x4_t lo = vmull_n_s16(vget_low_s16(b), cb);
+			lo = vmlal_n_s16(lo, vget_low_s16(g), cg);
+			lo = vmlal_n_s16(lo, vget_low_s16(r), cr);
+			int32x4_t hi = vmull_n_s16(vget_high_s16(b), cb);
+			hi = vmlal_n_s16(hi, vget_high_s16(g), cg);
+			hi = vmlal_n_s16(hi, vget_high_s16(r), cr);
+			lo = vshlq_s32(vaddq_s32(lo, rounding), shiftCount);
+			hi = vshlq_s32(vaddq_s32(hi, rounding), shiftCount);
+			int16x8_t words = vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+			if (isHighBitDepth) {
+				words = vminq_s16(vmaxq_s16(words, vdupq_n_s16(0)), maxValue);
+				vst1q_u16(reinterpret_cast<uint16_t *>(pDst) + x, vshlq_n_u16(vreinterpretq_u16_s16(words), 6));
+			}
+			else {
+				vst1_u8(pDst + x, vqmovun_s16(words));
+			}
+		}
+#endif
+		for (; x < width; x++) {
+			const uint8_t *pPixel = pSrc + x * 4;
+			int32_t sum = pPixel[0] * pCoefficients[0] + pPixel[1] * pCoefficients[1] + pPixel[2] * pCoefficients[2];
+			StoreSample(pDst, x, Clamp(Round(sum, shift) + offset, max), isHighBitDepth);
+		}
+	}
+
+	/// <summary>
+	/// Converts a pair of rows of BGRA pixels to a row of chroma. pV is nullptr for interleaved UV, else pUV is the U row.
+	/// Left sited chroma is filtered with [1 2 1] horizontally, centered chroma with [1 1]. Both average the two rows, and the shift includes the division by the filter weights.
+	/// </summary>
+	void ConvertChromaRow(const uint8_t *pRow0, const uint8_t *pRow1, uint8_t *pUV, uint8_t *pV, int32_t width, const int32_t *pUCoefficients, const int32_t *pVCoefficients, int32_t offset, int32_t max, int32_t shift, bool isLeftSited, bool isHighBitDepth)
+	{
+		const int32_t chromaWidth = (width + 1) / 2;
+		auto convertOne = [&](int32_t i) {
+			int32_t sum[3];
+			const int32_t x = i * 2;
+			const int32_t right = std::min(x + 1, width - 1);
+			if (isLeftSited) {
+				const int32_t left = std::max(x - 1, 0);
+				for (int ch = 0; ch < 3; ch++) {
+					sum[ch] = pRow0[left * 4 + ch] + 2 * pRow0[x * 4 + ch] + pRow0[right * 4 + ch]
+						+ pRow1[left * 4 + ch] + 2 * pRow1[x * 4 + ch] + pRow1[right * 4 + ch];
+				}
+			}
+			else {
+				for (int ch = 0; ch < 3; ch++) {
+					sum[ch] = pRow0[x * 4 + ch] + pRow0[right * 4 + ch] + pRow1[x * 4 + ch] + pRow1[right * 4 + ch];
+				}
+			}
+			int32_t u = Clamp(Round(sum[0] * pUCoefficients[0] + sum[1] * pUCoefficients[1] + sum[2] * pUCoefficients[2], shift) + offset, max);
+			int32_t v = Clamp(Round(sum[0] * pVCoefficients[0] + sum[1] * pVCoefficients[1] + sum[2] * pVCoefficients[2], shift) + offset, max);
+			if (pV) {
+				pUV[i] = static_cast<uint8_t>(u);
+				pV[i] = static_cast<uint8_t>(v);
+			}
+			else {
+				StoreSample(pUV, i * 2, u, isHighBitDepth);
+				StoreSample(pUV, i * 2 + 1, v, isHighBitDepth);
+			}
+		};
+
+		int32_t i = 0;
+#if defined(COLOR_CONVERTER_SSE2) || defined(COLOR_CONVERTER_NEON)
+		//The SIMD paths read the pixel before each block for left sited chroma, so the first sample, which replicates the first column, is converted by the scalar code.
+		if (isLeftSited) {
+			convertOne(0);
+			i = 1;
+		}
+#endif
+#if defined(COLOR_CONVERTER_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i uCoefficients = LoadCoefficients(pUCoefficients);
+		const __m128i vCoefficients = LoadCoefficients(pVCoefficients);
+		const __m128i rounding = _mm_set1_epi32((1 << (shift - 1)) + (offset << shift));
+		const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+		const __m128i maxValue = _mm_set1_epi16(static_cast<int16_t>(max));
+		auto load = [](const uint8_t *pPixels) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(pPixels)); };
+		//Four chroma samples are converted from the eight pixels of each row that follow the sample position.
+		for (; i * 2 + 8 <= width; i += 4) {
+			const int32_t x = i * 2;
+			const __m128i row0Lo = load(pRow0 + x * 4);
+			const __m128i row0Hi = load(pRow0 + x * 4 + 16);
+			const __m128i row1Lo = load(pRow1 + x * 4);
+			const __m128i row1Hi = load(pRow1 + x * 4 + 16);
+			//The two rows are summed per channel, with two pixels in each register.
+			const __m128i pixels01 = _mm_add_epi16(_mm_unpacklo_epi8(row0Lo, zero), _mm_unpacklo_epi8(row1Lo, zero));
+			const __m128i pixels23 = _mm_add_epi16(_mm_unpackhi_epi8(row0Lo, zero), _mm_unpackhi_epi8(row1Lo, zero));
+			const __m128i pixels45 = _mm_add_epi16(_mm_unpacklo_epi8(row0Hi, zero), _mm_unpacklo_epi8(row1Hi, zero));
+			const __m128i pixels67 = _mm_add_epi16(_mm_unpackhi_epi8(row0Hi, zero), _mm_unpackhi_epi8(row1Hi, zero));
+			//Each even pixel is summed with the odd pixel after it into the low half of the register.
+			__m128i sum0 = _mm_add_epi16(pixels01, _mm_srli_si128(pixels01, 8));
+			__m128i sum1 = _mm_add_epi16(pixels23, _mm_srli_si128(pixels23, 8));
+			__m128i sum2 = _mm_add_epi16(pixels45, _mm_srli_si128(pixels45, 8));
+			__m128i sum3 = _mm_add_epi16(pixels67, _mm_srli_si128(pixels67, 8));
+			if (isLeftSited) {
+				//The even pixel is weighted twice, and the odd pixel before it is added.
+				const __m128i previous = _mm_add_epi16(
+					_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pRow0 + x * 4 - 8)), zero),
+					_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pRow1 + x * 4 - 8)), zero));
+				sum0 = _mm_add_epi16(_mm_add_epi16(sum0, pixels01), _mm_srli_si128(previous, 8));
+				sum1 = _mm_add_epi16(_mm_add_epi16(sum1, pixels23), _mm_srli_si128(pixels01, 8));
+				sum2 = _mm_add_epi16(_mm_add_epi16(sum2, pixels45), _mm_srli_si128(pixels23, 8));
+				sum3 = _mm_add_epi16(_mm_add_epi16(sum3, pixels67), _mm_srli_si128(pixels45, 8));
+			}
+			const __m128i sums01 = _mm_unpacklo_epi64(sum0, sum1);
+			const __m128i sums23 = _mm_unpacklo_epi64(sum2, sum3);
+			//U in the low four words, V in the high four.
+			__m128i uv = _mm_packs_epi32(MultiplyPixels(sums01, sums23, uCoefficients, rounding, shiftCount), MultiplyPixels(sums01, sums23, vCoefficients, rounding, shiftCount));
+			if (pV) {
+				const __m128i bytes = _mm_packus_epi16(uv, uv);
+				const int32_t u = _mm_cvtsi128_si32(bytes);
+				const int32_t v = _mm_cvtsi128_si32(_mm_srli_si128(bytes, 4));
+				std::memcpy(pUV + i, &u, 4);
+				std::memcpy(pV + i, &v, 4);
+			}
+			else {
+				uv = _mm_unpacklo_epi16(uv, _mm_srli_si128(uv, 8));
+				if (isHighBitDepth) {
+					uv = _mm_min_epi16(_mm_max_epi16(uv, zero), maxValue);
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(pUV + i * 4), _mm_slli_epi16(uv, 6));
+				}
+				else {
+					_mm_storel_epi64(reinterpret_cast<__m128i *>(pUV + i * 2), _mm_packus_epi16(uv, uv));
+				}
+			}
+		}
+#elif defined(COLOR_CONVERTER_NEON)
+		const int32x4_t rounding = vdupq_n_s32((1 << (shift - 1)) + (offset << shift));
+		const int32x4_t shiftCount = vdupq_n_s32(-shift);
+		const int16x8_t maxValue = vdupq_n_s16(static_cast<int16_t>(max));
+		auto multiply = [&](int16x4_t b, int16x4_t g, int16x4_t r, const int32_t *pCoefficients) {
+			int32x4_t sum = vmull_n_s16(b, static_cast<int16_t>(pCoefficients[0]));
+			sum = vmlal_n_s16(sum, g, static_cast<int16_t>(pCoefficients[1]));
+			sum = vmlal_n_s16(sum, r, static_cast<int16_t>(pCoefficients[2]));
+			return vqmovn_s32(vshlq_s32(vaddq_s32(sum, rounding), shiftCount));
+		};
+		//Four chroma samples are converted from the eight pixels of each row that follow the sample position.
+		for (; i * 2 + 8 <= width; i += 4) {
+			const int32_t x = i * 2;
+			const uint8x8x4_t row0 = vld4_u8(pRow0 + x * 4);
+			const uint8x8x4_t row1 = vld4_u8(pRow1 + x * 4);
+			//Adjacent pixels are summed pairwise, which gives the even pixel and the odd pixel after it, over both rows.
+			uint16x4_t sums[3];
+			for (int ch = 0; ch < 3; ch++) {
+				sums[ch] = vpadal_u8(vpaddl_u8(row0.val[ch]), row1.val[ch]);
+			}
+			if (isLeftSited) {
+				//The pixels one to the left pair each even pixel with the odd pixel before it, which completes the [1 2 1] filter.
+				const uint8x8x4_t previous0 = vld4_u8(pRow0 + x * 4 - 4);
+				const uint8x8x4_t previous1 = vld4_u8(pRow1 + x * 4 - 4);
+				for (int ch = 0; ch < 3; ch++) {
+					sums[ch] = vpadal_u8(vpadal_u8(sums[ch], previous0.val[ch]), previous1.val[ch]);
+				}
+			}
+			const int16x4_t b = vreinterpret_s16_u16(sums[0]);
+			const int16x4_t g = vreinterpret_s16_u16(sums[1]);
+			const int16x4_t r = vreinterpret_s16_u16(sums[2]);
+			const int16x4_t u = multiply(b, g, r, pUCoefficients);
+			const int16x4_t v = multiply(b, g, r, pVCoefficients);
+			if (pV) {
+				uint8_t bytes[8];
+				vst1_u8(bytes, vqmovun_s16(vcombine_s16(u, v)));
+				std::memcpy(pUV + i, bytes, 4);
+				std::memcpy(pV + i, bytes + 4, 4);
+			}
+			else {
+				const int16x4x2_t interleaved = vzip_s16(u, v);
+				int16x8_t words = vcombine_s16(interleaved.val[0], interleaved.val[1]);
+				if (isHighBitDepth) {
+					words = vminq_s16(vmaxq_s16(words, vdupq_n_s16(0)), maxValue);
+					vst1q_u16(reinterpret_cast<uint16_t *>(pUV) + i * 2, vshlq_n_u16(vreinterpretq_u16_s16(words), 6));
+				}
+				else {
+					vst1_u8(pUV + i * 2, vqmovun_s16(words));
+				}
+			}
+		}
+#endif
+		for (; i < chromaWidth; i++) {
+			convertOne(i);
+		}
+	}
+}
+
+ColorConverter::ColorConverter() :
+	m_Format(YUVFormat::NV12),
+	m_Matrix(YUVColorMatrix::BT709),
+	m_Range(YUVRange::Limited),
+	m_Siting(ChromaSiting::Left),
+	m_Coefficients{},
+	m_ThreadCount(0),
+	m_Buffer{},
+	m_Workers{},
+	m_WorkMutex{},
+	m_WorkAvailable{},
+	m_WorkCompleted{},
+	m_Job(nullptr),
+	m_JobCount(0),
+	m_JobBandSize(0),
+	m_NextBand(0),
+	m_PendingWorkers(0),
+	m_Generation(0),
+	m_IsStopping(false)
+{
+	UpdateCoefficients();
+}
+
+ColorConverter::~ColorConverter()
+{
+	StopWorkers();
+}
+
+void ColorConverter::SetOptions(YUVFormat format, YUVColorMatrix matrix, YUVRange range, ChromaSiting siting)
+{
+	m_Format = format;
+	m_Matrix = matrix;
+	m_Range = range;
+	m_Siting = siting;
+	UpdateCoefficients();
+}
+
+void ColorConverter::SetThreadCount(uint32_t count)
+{
+	if (count != m_ThreadCount) {
+		StopWorkers();
+		m_ThreadCount = count;
+	}
+}
+
+void ColorConverter::UpdateCoefficients()
+{
+	const double kr = m_Matrix == YUVColorMatrix::BT601 ? 0.299 : 0.2126;
+	const double kb = m_Matrix == YUVColorMatrix::BT601 ? 0.114 : 0.0722;
+	const double kg = 1.0 - kr - kb;
+	const int32_t bitDepth = IsHighBitDepth(m_Format) ? 10 : 8;
+	//Keep the coefficients within 16 bits for the SIMD paths, which multiply 8 bit samples with 16 bit coefficients.
+	const int32_t shift = 23 - bitDepth;
+	const double scale = 1 << (bitDepth - 8);
+	double yScale, uvScale;
+	if (m_Range == YUVRange::Limited) {
+		yScale = 219.0 * scale / 255.0;
+		uvScale = 224.0 * scale / 255.0;
+		m_Coefficients.YOffset = static_cast<int32_t>(16 * scale);
+	}
+	else {
+		yScale = uvScale = ((1 << bitDepth) - 1) / 255.0;
+		m_Coefficients.YOffset = 0;
+	}
+	m_Coefficients.UVOffset = static_cast<int32_t>(128 * scale);
+	m_Coefficients.Max = (1 << bitDepth) - 1;
+	m_Coefficients.Shift = shift;
+
+	auto toFixed = [&](double value) { return static_cast<int32_t>(std::lround(value * (1 << shift))); };
+	const double y[3] = { kb, kg, kr };
+	const double u[3] = { 0.5, -kg / (2.0 * (1.0 - kb)), -kr / (2.0 * (1.0 - kb)) };
+	const double v[3] = { -kb / (2.0 * (1.0 - kr)), -kg / (2.0 * (1.0 - kr)), 0.5 };
+	for (int i = 0; i < 3; i++) {
+		m_Coefficients.Y[i] = toFixed(y[i] * yScale);
+		m_Coefficients.U[i] = toFixed(u[i] * uvScale);
+		m_Coefficients.V[i] = toFixed(v[i] * uvScale);
+	}
+}
+
+size_t ColorConverter::GetImageSize(YUVFormat format, int32_t width, int32_t height)
+{
+	if (width <= 0 || height <= 0) {
+		return 0;
+	}
+	const size_t bytesPerSample = IsHighBitDepth(format) ? 2 : 1;
+	const size_t chromaWidth = (static_cast<size_t>(width) + 1) / 2;
+	const size_t chromaHeight = (static_cast<size_t>(height) + 1) / 2;
+	return (static_cast<size_t>(width) * height + chromaWidth * chromaHeight * 2) * bytesPerSample;
+}
+
+YUV_PLANES ColorConverter::GetPlanes(YUVFormat format, uint8_t *pBuffer, int32_t width, int32_t height, int32_t stride)
+{
+	YUV_PLANES planes{};
+	planes.Data[0] = pBuffer;
+	planes.Stride[0] = stride;
+	uint8_t *pChroma = pBuffer + static_cast<int64_t>(stride) * height;
+	const int32_t chromaWidth = (width + 1) / 2;
+	if (format == YUVFormat::I420) {
+		const int32_t chromaStride = std::max((stride + 1) / 2, chromaWidth);
+		planes.Data[1] = pChroma;
+		planes.Stride[1] = chromaStride;
+		planes.Data[2] = pChroma + static_cast<int64_t>(chromaStride) * ((height + 1) / 2);
+		planes.Stride[2] = chromaStride;
+	}
+	else {
+		planes.Data[1] = pChroma;
+		planes.Stride[1] = std::max(stride, chromaWidth * 2 * (IsHighBitDepth(format) ? 2 : 1));
+	}
+	return planes;
+}
+
+bool ColorConverter::Convert(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const YUV_PLANES &planes)
+{
+	if (!pSrc || width <= 0 || height <= 0 || srcStride < width * 4) {
+		return false;
+	}
+	const int32_t bytesPerSample = IsHighBitDepth(m_Format) ? 2 : 1;
+	const int32_t chromaWidth = (width + 1) / 2;
+	if (!planes.Data[0] || !planes.Data[1] || planes.Stride[0] < width * bytesPerSample) {
+		return false;
+	}
+	if (m_Format == YUVFormat::I420) {
+		if (!planes.Data[2] || planes.Stride[1] < chromaWidth || planes.Stride[2] < chromaWidth) {
+			return false;
+		}
+	}
+	else if (planes.Stride[1] < chromaWidth * 2 * bytesPerSample) {
+		return false;
+	}
+
+	const int32_t rowPairs = (height + 1) / 2;
+	const int32_t maxBands = static_cast<int32_t>(std::max<int64_t>(1, static_cast<int64_t>(width) * height / MIN_PIXELS_PER_BAND));
+	RunBands(rowPairs, maxBands, [&](int32_t first, int32_t last) {
+		ConvertRows(pSrc, srcStride, width, height, planes, first, last);
+	});
+	return true;
+}
+
+const uint8_t *ColorConverter::Convert(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, size_t *pSize)
+{
+	*pSize = 0;
+	size_t size = GetImageSize(m_Format, width, height);
+	if (size == 0) {
+		return nullptr;
+	}
+	m_Buffer.resize(size);
+	const int32_t stride = m_Format == YUVFormat::I420 ? width : width * (IsHighBitDepth(m_Format) ? 2 : 1);
+	if (!Convert(pSrc, srcStride, width, height, GetPlanes(m_Format, m_Buffer.data(), width, height, stride))) {
+		return nullptr;
+	}
+	*pSize = size;
+	return m_Buffer.data();
+}
+
+void ColorConverter::ConvertRows(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const YUV_PLANES &planes, int32_t firstRowPair, int32_t lastRowPair)
+{
+	const COEFFICIENTS &c = m_Coefficients;
+	const bool isHighBitDepth = IsHighBitDepth(m_Format);
+	const bool isLeftSited = m_Siting == ChromaSiting::Left;
+	//The weights of the left sited filter sum to 8, and those of the centered filter to 4, which the shift divides by.
+	const int32_t chromaShift = c.Shift + (isLeftSited ? 3 : 2);
+
+	for (int32_t pair = firstRowPair; pair < lastRowPair; pair++) {
+		const int32_t y0 = pair * 2;
+		const int32_t y1 = std::min(y0 + 1, height - 1);
+		const uint8_t *pRow0 = pSrc + static_cast<int64_t>(y0) * srcStride;
+		const uint8_t *pRow1 = pSrc + static_cast<int64_t>(y1) * srcStride;
+
+		ConvertLumaRow(pRow0, planes.Data[0] + static_cast<int64_t>(y0) * planes.Stride[0], width, c.Y, c.YOffset, c.Max, c.Shift, isHighBitDepth);
+		if (y1 != y0) {
+			ConvertLumaRow(pRow1, planes.Data[0] + static_cast<int64_t>(y1) * planes.Stride[0], width, c.Y, c.YOffset, c.Max, c.Shift, isHighBitDepth);
+		}
+
+		uint8_t *pUV = planes.Data[1] + static_cast<int64_t>(pair) * planes.Stride[1];
+		uint8_t *pV = m_Format == YUVFormat::I420 ? planes.Data[2] + static_cast<int64_t>(pair) * planes.Stride[2] : nullptr;
+		ConvertChromaRow(pRow0, pRow1, pUV, pV, width, c.U, c.V, c.UVOffset, c.Max, chromaShift, isLeftSited, isHighBitDepth);
+	}
+}
+
+void ColorConverter::RunBands(int32_t count, int32_t maxBands, const std::function<void(int32_t, int32_t)> &job)
+{
+	const uint32_t threadCount = m_ThreadCount > 0 ? m_ThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	const int32_t bandCount = std::min({ static_cast<int32_t>(threadCount), maxBands, count });
+	if (bandCount <= 1) {
+		job(0, count);
+		return;
+	}
+	if (m_Workers.size() != threadCount - 1) {
+		StopWorkers();
+		StartWorkers(threadCount - 1);
+	}
+	const int32_t bandSize = (count + bandCount - 1) / bandCount;
+	{
+		std::lock_guard<std::mutex> lock(m_WorkMutex);
+		m_Job = &job;
+		m_JobCount = count;
+		m_JobBandSize = bandSize;
+		m_NextBand = 0;
+		m_PendingWorkers = static_cast<int32_t>(m_Workers.size());
+		m_Generation++;
+	}
+	m_WorkAvailable.notify_all();
+	for (int32_t band = m_NextBand++; band * bandSize < count; band = m_NextBand++) {
+		job(band * bandSize, std::min(count, (band + 1) * bandSize));
+	}
+	std::unique_lock<std::mutex> lock(m_WorkMutex);
+	m_WorkCompleted.wait(lock, [&] { return m_PendingWorkers == 0; });
+	m_Job = nullptr;
+}
+
+void ColorConverter::StartWorkers(uint32_t count)
+{
+	m_IsStopping = false;
+	for (uint32_t i = 0; i < count; i++) {
+		//The worker is given the current generation, so a job published before the thread gets to run is not missed.
+		m_Workers.emplace_back(&ColorConverter::WorkerThread, this, m_Generation);
+	}
+}
+
+void ColorConverter::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_WorkMutex);
+		m_IsStopping = true;
+	}
+	m_WorkAvailable.notify_all();
+	for (std::thread &worker : m_Workers) {
+		worker.join();
+	}
+	m_Workers.clear();
+}
+
+void ColorConverter::WorkerThread(uint64_t generation)
+{
+	std::unique_lock<std::mutex> lock(m_WorkMutex);
+	while (true) {
+		m_WorkAvailable.wait(lock, [&] { return m_IsStopping || m_Generation != generation; });
+		if (m_IsStopping) {
+			return;
+		}
+		generation = m_Generation;
+		const std::function<void(int32_t, int32_t)> &job = *m_Job;
+		const int32_t count = m_JobCount;
+		const int32_t bandSize = m_JobBandSize;
+		lock.unlock();
+		for (int32_t band = m_NextBand++; band * bandSize < count; band = m_NextBand++) {
+			job(band * bandSize, std::min(count, (band + 1) * bandSize));
+		}
+		lock.lock();
+		if (--m_PendingWorkers == 0) {
+			m_WorkCompleted.notify_one();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+enum class YUVFormat {
+	///<summary>8 bit 4:2:0. A Y plane followed by an interleaved UV plane.</summary>
+	NV12,
+	///<summary>8 bit 4:2:0. Separate Y, U and V planes.</summary>
+	I420,
+	///<summary>10 bit 4:2:0 stored in the high bits of 16 bit words. A Y plane followed by an interleaved UV plane.</summary>
+	P010
+};
+
+enum class YUVColorMatrix {
+	BT601,
+	BT709
+};
+
+enum class YUVRange {
+	///<summary>Studio swing, Y in [16,235] and UV in [16,240] for 8 bit output.</summary>
+	Limited,
+	///<summary>Full swing, Y and UV in [0,255] for 8 bit output.</summary>
+	Full
+};
+
+enum class ChromaSiting {
+	///<summary>Chroma samples are horizontally co-sited with the left luma sample and vertically centered between rows, as in MPEG-2, H.264 and HEVC.</summary>
+	Left,
+	///<summary>Chroma samples are centered between the four luma samples, as in MPEG-1 and JPEG.</summary>
+	Center
+};
+
+/// <summary>
+/// Destination planes for a conversion. For NV12 and P010, plane 0 is Y and plane 1 is interleaved UV. For I420, the planes are Y, U and V.
+/// The memory is owned by the caller. Strides are in bytes.
+/// </summary>
+struct YUV_PLANES {
+	uint8_t *Data[3] = { nullptr, nullptr, nullptr };
+	int32_t Stride[3] = { 0, 0, 0 };
+};
+
+/// <summary>
+/// Converts 32bpp BGRA images to 4:2:0 YUV formats. Large frames are split into row bands that are converted in parallel.
+/// </summary>
+class ColorConverter
+{
+public:
+	ColorConverter();
+	~ColorConverter();
+	void SetOptions(YUVFormat format, YUVColorMatrix matrix, YUVRange range, ChromaSiting siting);
+	/// <summary>
+	/// Sets the maximum number of threads used for a conversion, including the calling thread. 0 uses the number of hardware threads.
+	/// </summary>
+	void SetThreadCount(uint32_t count);
+	YUVFormat GetFormat() { return m_Format; }
+	/// <summary>
+	/// Converts a BGRA image into the given planes. Odd dimensions are supported by replicating the last column and row for the chroma planes.
+	/// </summary>
+	/// <returns>false if the arguments are invalid, else true</returns>
+	bool Convert(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const YUV_PLANES &planes);
+	/// <summary>
+	/// Converts a BGRA image into a buffer owned by the converter, laid out contiguously without padding. The buffer is reused between calls.
+	/// </summary>
+	/// <returns>A pointer to the converted image, or nullptr if the arguments are invalid.</returns>
+	const uint8_t *Convert(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, size_t *pSize);
+	/// <summary>
+	/// Gets the size in bytes of a contiguous image in the given format.
+	/// </summary>
+	static size_t GetImageSize(YUVFormat format, int32_t width, int32_t height);
+	/// <summary>
+	/// Gets the planes of an image in the given format, with the Y plane starting at pBuffer and the chroma planes following it.
+	/// For NV12 and P010, the UV plane uses the same stride as the Y plane, matching the Media Foundation buffer layout.
+	/// </summary>
+	static YUV_PLANES GetPlanes(YUVFormat format, uint8_t *pBuffer, int32_t width, int32_t height, int32_t stride);
+private:
+	struct COEFFICIENTS {
+		int32_t Y[3];
+		int32_t U[3];
+		int32_t V[3];
+		int32_t YOffset;
+		int32_t UVOffset;
+		int32_t Max;
+		int32_t Shift;
+	};
+	void UpdateCoefficients();
+	void ConvertRows(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const YUV_PLANES &planes, int32_t firstRowPair, int32_t lastRowPair);
+	void RunBands(int32_t count, int32_t maxBands, const std::function<void(int32_t, int32_t)> &job);
+	void StartWorkers(uint32_t count);
+	void StopWorkers();
+	void WorkerThread(uint64_t generation);
+
+	YUVFormat m_Format;
+	YUVColorMatrix m_Matrix;
+	YUVRange m_Range;
+	ChromaSiting m_Siting;
+	COEFFICIENTS m_Coefficients;
+	uint32_t m_ThreadCount;
+	std::vector<uint8_t> m_Buffer;
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_WorkMutex;
+	std::condition_variable m_WorkAvailable;
+	std::condition_variable m_WorkCompleted;
+	const std::function<void(int32_t, int32_t)> *m_Job;
+	int32_t m_JobCount;
+	int32_t m_JobBandSize;
+	std::atomic<int32_t> m_NextBand;
+	int32_t m_PendingWorkers;
+	uint64_t m_Generation;
+	bool m_IsStopping;
+};
\ No newline at end of file
@@ -12,30 +12,97 @@
 #include <wincodec.h>
 #include <chrono>
 #include "util.h"
+#include "ImageEncoder.h"
+#include "Metrics.h"
+#include "OutputSink.h"
+#include "BitstreamDispatcher.h"
+#include "FrameScheduler.h"
+#include "InFlightSampleTracker.h"
+#include "Sync.h"
+#include "SyntheticPattern.h"
 
 typedef void(__stdcall *CallbackNewFrameDataFunction)(int, byte *, int, int, int);
 
+enum class FramePreviewFormat {
+	///<summary>32bpp BGRA pixels.</summary>
+	BGRA,
+	///<summary>8 bit 4:2:0 in BT.709 limited range. A Y plane with a stride equal to the width, followed by an interleaved UV plane with a stride equal to the width rounded up to an even number.</summary>
+	NV12,
+	///<summary>A complete JPEG file.</summary>
+	JPEG
+};
+
 struct FRAME_BITMAP_DATA {
 	int Stride;
 	int Width;
 	int Height;
 	byte *Data;
 	int Length;
+	FramePreviewFormat Format;
 	FRAME_BITMAP_DATA() :
 		Stride(0),
 		Width(0),
 		Height(0),
 		Data(nullptr),
-		Length(0) {}
-	FRAME_BITMAP_DATA(int stride, byte *data, int length, int width, int height) {
+		Length(0),
+		Format(FramePreviewFormat::BGRA) {}
+	FRAME_BITMAP_DATA(int stride, byte *data, int length, int width, int height, FramePreviewFormat format = FramePreviewFormat::BGRA) {
 		Stride = stride;
 		Data = data;
 		Length = length;
 		Width = width;
 		Height = height;
+		Format = format;
 	}
 };
 
+struct FRAME_PREVIEW_STATISTICS {
+	///<summary>Frames delivered to the frame callback with preview data.</summary>
+	UINT64 DeliveredFrameCount;
+	///<summary>Frames that were due for a preview, but were dropped because the GPU or the callback was not keeping up, the preview could not be read back, or the device was reinitialized.</summary>
+	UINT64 DroppedFrameCount;
+	///<summary>Frames skipped to keep the preview at its target frame rate.</summary>
+	UINT64 SkippedFrameCount;
+	///<summary>Total time spent on the recording thread queuing previews, including resizing and readback.</summary>
+	double RecordingThreadMillis;
+	///<summary>Total GPU time spent resizing and copying previews.</summary>
+	double GpuMillis;
+	///<summary>Total time spent on the delivery thread converting previews to the output format, excluding the callback.</summary>
+	double ProcessingMillis;
+	FRAME_PREVIEW_STATISTICS() :
+		DeliveredFrameCount(0),
+		DroppedFrameCount(0),
+		SkippedFrameCount(0),
+		RecordingThreadMillis(0),
+		GpuMillis(0),
+		ProcessingMillis(0) {}
+};
+
+struct SNAPSHOT_STATISTICS {
+	///<summary>Snapshots written successfully.</summary>
+	UINT64 WrittenCount;
+	///<summary>Snapshots discarded because the queue was full.</summary>
+	UINT64 DroppedCount;
+	///<summary>Snapshots that failed to encode or write.</summary>
+	UINT64 FailedCount;
+	///<summary>Snapshots currently waiting for a worker.</summary>
+	UINT32 QueueDepth;
+	///<summary>The highest number of snapshots that have been waiting for a worker at the same time.</summary>
+	UINT32 MaxQueueDepth;
+	///<summary>The average time from a snapshot being queued until it is written.</summary>
+	double AverageLatencyMillis;
+	///<summary>The longest time from a snapshot being queued until it is written.</summary>
+	double MaxLatencyMillis;
+	SNAPSHOT_STATISTICS() :
+		WrittenCount(0),
+		DroppedCount(0),
+		FailedCount(0),
+		QueueDepth(0),
+		MaxQueueDepth(0),
+		AverageLatencyMillis(0),
+		MaxLatencyMillis(0) {}
+};
+
 struct REC_RESULT {
 	HRESULT RecordingResult;
 	HRESULT FinalizeResult;
@@ -165,6 +232,8 @@ struct CAPTURED_FRAME
 	std::optional<PTR_INFO> PtrInfo;
 	//The number of updates written to the current frame since last fetch.
 	int FrameUpdateCount;
+	//The number of overlays updated since last fetch.
+	int OverlayUpdateCount;
 };
 
 enum class RecorderModeInternal {
@@ -204,7 +273,27 @@ enum class RecordingSourceType {
 	Window,
 	CameraCapture,
 	Picture,
-	Video
+	Video,
+	///<summary>Generated frames with a known content and rate, for benchmarks and tests that need no display or media.</summary>
+	Synthetic
+};
+
+struct SYNTHETIC_SOURCE_OPTIONS {
+	SIZE Size;
+	double FrameRate;
+	SyntheticDirtyPattern DirtyRegionPattern;
+	/// <summary>
+	/// Moves a generated mouse cursor along a fixed path.
+	/// </summary>
+	bool IsCursorMotionEnabled;
+
+	SYNTHETIC_SOURCE_OPTIONS() :
+		Size{ 1920, 1080 },
+		FrameRate(60),
+		DirtyRegionPattern(SyntheticDirtyPattern::MovingRectangle),
+		IsCursorMotionEnabled(true)
+	{
+	}
 };
 
 enum class RecordingSourceApi {
@@ -212,6 +301,13 @@ enum class RecordingSourceApi {
 	WindowsGraphicsCapture
 };
 
+enum class CompositorBackend {
+	///<summary>Compose frames with D3D11 shaders. Falls back to Software if the shader pipeline can't be created.</summary>
+	Direct3D,
+	///<summary>Compose frames on the CPU with the SoftwareCompositor.</summary>
+	Software
+};
+
 struct RECORDING_SOURCE_BASE abstract {
 private:
 	std::vector<CallbackNewFrameDataFunction> m_NewFrameDataCallbacks;
@@ -257,6 +353,10 @@ public:
 	/// The requested dimensions of the frame preview bitmap
 	/// </summary>
 	std::optional<SIZE> VideoFramePreviewSize;
+	/// <summary>
+	/// The frames to generate for a Synthetic source.
+	/// </summary>
+	SYNTHETIC_SOURCE_OPTIONS SyntheticOptions;
 
 	RECORDING_SOURCE_BASE() :
 		Type(RecordingSourceType::Display),
@@ -272,6 +372,7 @@ public:
 		IsBorderRequired(std::nullopt),
 		IsVideoFramePreviewEnabled(std::nullopt),
 		VideoFramePreviewSize(std::nullopt),
+		SyntheticOptions{},
 		m_NewFrameDataCallbacks{}
 	{
 
@@ -403,6 +504,7 @@ struct CAPTURE_THREAD_DATA :THREAD_DATA_BASE
 	RECORDING_SOURCE_DATA *RecordingSource{ nullptr };
 	INT64 TotalUpdatedFrameCount{};
 	PTR_INFO *PtrInfo{ nullptr };
+	MetricsRegistry *Metrics{ nullptr };
 };
 
 //
@@ -473,17 +575,11 @@ protected:
 	float m_OutputVolumeModifier = 1;
 	float m_InputVolumeModifier = 1;
 
-	void Notify(HANDLE h) {
-		SetEvent(h);
+	void Notify(SyncEvent &e) {
+		e.Set();
 	}
 public:
-	HANDLE OnPropertyChangedEvent;
-	AUDIO_OPTIONS() {
-		OnPropertyChangedEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	}
-	~AUDIO_OPTIONS() {
-		CloseHandle(OnPropertyChangedEvent);
-	}
+	SyncEvent OnPropertyChangedEvent{ false };
 	void SetInputVolume(float volume) { m_InputVolumeModifier = volume; Notify(OnPropertyChangedEvent); }
 	void SetOutputVolume(float volume) { m_OutputVolumeModifier = volume; Notify(OnPropertyChangedEvent); }
 	void SetAudioBitrate(UINT32 bitrate) { m_AudioBitrate = bitrate; Notify(OnPropertyChangedEvent); }
@@ -508,6 +604,21 @@ public:
 	UINT32 GetAudioSamplesPerSecond() { return AUDIO_SAMPLES_PER_SECOND; }
 };
 
+struct ENCODER_OPTIONS;
+
+/// <summary>
+/// A video file encoded from the same captured and composed frames as the main output, with its own size, frame rate and encoder options.
+/// </summary>
+struct ADDITIONAL_OUTPUT {
+	std::wstring Path;
+	//The frame size of the output. If not set, the frame size of the main output is used.
+	std::optional<SIZE> FrameSize;
+	//The encoder options of the output. A frame rate below the frame rate of the main output is reached by skipping frames of the main output.
+	std::shared_ptr<ENCODER_OPTIONS> EncoderOptions;
+	//The maximum number of frames waiting to be encoded for this output. When it is reached, new frames are dropped for this output only.
+	UINT32 MaxQueuedFrames = 8;
+};
+
 struct OUTPUT_OPTIONS {
 protected:
 	std::optional<SIZE> m_FrameSize{};
@@ -517,6 +628,19 @@ protected:
 	bool m_IsVideoCaptureEnabled = true;
 	bool m_IsVideoFramePreviewEnabled = false;
 	std::optional<SIZE> m_VideoFramePreviewSize{};
+	double m_VideoFramePreviewFramerate = 0;
+	FramePreviewFormat m_VideoFramePreviewFormat = FramePreviewFormat::BGRA;
+	CompositorBackend m_CompositorBackend = CompositorBackend::Direct3D;
+	std::shared_ptr<OutputSink> m_Sink{};
+	std::vector<ADDITIONAL_OUTPUT> m_AdditionalOutputs{};
+	std::chrono::milliseconds m_SegmentDuration = std::chrono::milliseconds(0);
+	UINT64 m_MaxSegmentSize = 0;
+	std::chrono::milliseconds m_ReplayBufferDuration = std::chrono::milliseconds(0);
+	UINT64 m_ReplayBufferMaxSize = 0;
+	bool m_IsBitstreamOutputEnabled = false;
+	BitstreamFormat m_BitstreamFormat = BitstreamFormat::AnnexB;
+	UINT32 m_MaxQueuedBitstreamPackets = 64;
+	UINT32 m_StreamWriteBufferSize = 2 * 1024 * 1024;
 public:
 	std::optional<SIZE> GetFrameSize() { return m_FrameSize; }
 	void SetFrameSize(SIZE size) { m_FrameSize = size; }
@@ -532,6 +656,65 @@ public:
 	void SetVideoFramePreviewSize(SIZE value) { m_VideoFramePreviewSize = value; }
 	bool IsVideoFramePreviewEnabled() { return m_IsVideoFramePreviewEnabled; }
 	std::optional<SIZE> GetVideoFramePreviewSize() { return m_VideoFramePreviewSize; }
+	void SetVideoFramePreviewFramerate(double value) { m_VideoFramePreviewFramerate = value; }
+	/// <summary>
+	/// The maximum number of frame previews per second. 0 produces a preview for every recorded frame.
+	/// </summary>
+	double GetVideoFramePreviewFramerate() { return m_VideoFramePreviewFramerate; }
+	void SetVideoFramePreviewFormat(FramePreviewFormat value) { m_VideoFramePreviewFormat = value; }
+	FramePreviewFormat GetVideoFramePreviewFormat() { return m_VideoFramePreviewFormat; }
+	void SetCompositorBackend(CompositorBackend value) { m_CompositorBackend = value; }
+	CompositorBackend GetCompositorBackend() { return m_CompositorBackend; }
+	/// <summary>
+	/// A sink that receives the raw frames and audio in place of the encoder and the Media Foundation sink writer. Only used in video mode.
+	/// </summary>
+	void SetSink(std::shared_ptr<OutputSink> value) { m_Sink = value; }
+	std::shared_ptr<OutputSink> GetSink() { return m_Sink; }
+	/// <summary>
+	/// Video files recorded at the same time as the main output, from the same captured frames. Only used in video mode.
+	/// </summary>
+	void SetAdditionalOutputs(std::vector<ADDITIONAL_OUTPUT> value) { m_AdditionalOutputs = value; }
+	std::vector<ADDITIONAL_OUTPUT> GetAdditionalOutputs() { return m_AdditionalOutputs; }
+	/// <summary>
+	/// Splits the recording into files of this duration. 0 disables splitting by duration. Only used in video mode, when recording to a file.
+	/// </summary>
+	void SetSegmentDuration(std::chrono::milliseconds value) { m_SegmentDuration = value; }
+	std::chrono::milliseconds GetSegmentDuration() { return m_SegmentDuration; }
+	/// <summary>
+	/// Splits the recording into files of about this size in bytes. The file is split on the first frame after the size is reached. 0 disables splitting by size.
+	/// </summary>
+	void SetMaxSegmentSize(UINT64 value) { m_MaxSegmentSize = value; }
+	UINT64 GetMaxSegmentSize() { return m_MaxSegmentSize; }
+	bool IsSegmentationEnabled() { return m_SegmentDuration.count() > 0 || m_MaxSegmentSize > 0; }
+	/// <summary>
+	/// Keeps the last encoded video and audio of this duration in memory, instead of writing the recording to the output path or stream. It is written to a file on request. Only used in video mode.
+	/// </summary>
+	void SetReplayBufferDuration(std::chrono::milliseconds value) { m_ReplayBufferDuration = value; }
+	std::chrono::milliseconds GetReplayBufferDuration() { return m_ReplayBufferDuration; }
+	/// <summary>
+	/// The maximum size in bytes of the encoded video and audio in the replay buffer. 0 only limits the duration.
+	/// </summary>
+	void SetReplayBufferMaxSize(UINT64 value) { m_ReplayBufferMaxSize = value; }
+	UINT64 GetReplayBufferMaxSize() { return m_ReplayBufferMaxSize; }
+	bool IsReplayBufferEnabled() { return m_ReplayBufferDuration.count() > 0 || m_ReplayBufferMaxSize > 0; }
+	/// <summary>
+	/// Passes the encoded video and audio packets to the encoded packet callback as they are encoded. Without an output path or stream, nothing else is written. Only used in video mode.
+	/// A file or stream recorded at the same time is written by the native muxer, and is not split into segments.
+	/// </summary>
+	void SetBitstreamOutputEnabled(bool value) { m_IsBitstreamOutputEnabled = value; }
+	bool IsBitstreamOutputEnabled() { return m_IsBitstreamOutputEnabled; }
+	void SetBitstreamFormat(BitstreamFormat value) { m_BitstreamFormat = value; }
+	BitstreamFormat GetBitstreamFormat() { return m_BitstreamFormat; }
+	/// <summary>
+	/// The number of encoded packets that can wait for the callback. When it is full, packets are dropped.
+	/// </summary>
+	void SetMaxQueuedBitstreamPackets(UINT32 value) { m_MaxQueuedBitstreamPackets = value; }
+	UINT32 GetMaxQueuedBitstreamPackets() { return m_MaxQueuedBitstreamPackets; }
+	/// <summary>
+	/// The size in bytes of the buffers the video is collected in before it is written to an output stream, on a background thread. 0 writes it to the stream directly. Only used when recording to a stream.
+	/// </summary>
+	void SetStreamWriteBufferSize(UINT32 value) { m_StreamWriteBufferSize = value; }
+	UINT32 GetStreamWriteBufferSize() { return m_StreamWriteBufferSize; }
 };
 
 struct ENCODER_OPTIONS abstract {
@@ -539,6 +722,7 @@ protected:
 #pragma region Format constants
 #pragma endregion
 	UINT32 m_VideoFps = 30;
+	double m_MinVideoFps = 2;
 	UINT32 m_VideoBitrate = 4000 * 1000;//Bitrate in bits per second
 	UINT32 m_VideoQuality = 70;//Video quality from 1 to 100. Is only used with eAVEncCommonRateControlMode_Quality.
 	bool m_IsFixedFramerate = false;
@@ -546,33 +730,83 @@ protected:
 	bool m_IsLowLatencyModeEnabled = false;
 	bool m_IsMp4FastStartEnabled = true;
 	bool m_IsFragmentedMp4Enabled = false;
+	bool m_IsNativeMuxerEnabled = false;
+	std::chrono::milliseconds m_FragmentDuration = std::chrono::milliseconds(0);
 	bool m_IsHardwareEncodingEnabled = true;
 	UINT32 m_VideoBitrateControlMode = eAVEncCommonRateControlMode_Quality;
 	UINT32 m_EncoderProfile = eAVEncH264VProfile_High;
+	FrameSchedulePolicy m_FrameSchedulePolicy = FrameSchedulePolicy::StretchDuration;
+	bool m_IsAdaptiveQualityEnabled = false;
+	UINT32 m_MaxInFlightFrames = 0;
+	UINT64 m_MaxInFlightBytes = 0;
+	InFlightFramePolicy m_InFlightFramePolicy = InFlightFramePolicy::Wait;
 public:
 	void SetVideoFps(UINT32 fps) { m_VideoFps = fps; }
+	void SetMinVideoFps(double fps) { m_MinVideoFps = fps; }
 	void SetVideoBitrate(UINT32 bitrate) { m_VideoBitrate = bitrate; }
 	void SetVideoQuality(UINT32 quality) { m_VideoQuality = quality; }
 	void SetFixedFramerate(bool value) { m_IsFixedFramerate = value; }
 	void SetThrottlingDisabled(bool value) { m_IsThrottlingDisabled = value; }
 	void SetFastStartEnabled(bool value) { m_IsMp4FastStartEnabled = value; }
 	void SetFragmentedMp4Enabled(bool value) { m_IsFragmentedMp4Enabled = value; }
+	void SetNativeMuxerEnabled(bool value) { m_IsNativeMuxerEnabled = value; }
+	void SetFragmentDuration(std::chrono::milliseconds value) { m_FragmentDuration = value; }
 	void SetHardwareEncodingEnabled(bool value) { m_IsHardwareEncodingEnabled = value; }
 	void SetLowLatencyModeEnabled(bool value) { m_IsLowLatencyModeEnabled = value; }
 	void SetVideoBitrateMode(UINT32 bitrateMode) { m_VideoBitrateControlMode = bitrateMode; }
 	void SetEncoderProfile(UINT32 profile) { m_EncoderProfile = profile; }
+	void SetFrameSchedulePolicy(FrameSchedulePolicy value) { m_FrameSchedulePolicy = value; }
+	void SetIsAdaptiveQualityEnabled(bool value) { m_IsAdaptiveQualityEnabled = value; }
+	void SetMaxInFlightFrames(UINT32 value) { m_MaxInFlightFrames = value; }
+	void SetMaxInFlightBytes(UINT64 value) { m_MaxInFlightBytes = value; }
+	void SetInFlightFramePolicy(InFlightFramePolicy value) { m_InFlightFramePolicy = value; }
 
+	/// <summary>
+	/// The frame rate, or the maximum frame rate if the frame rate is not fixed.
+	/// </summary>
 	UINT32 GetVideoFps() { return m_VideoFps; }
+	/// <summary>
+	/// The minimum frame rate if the frame rate is not fixed. Frames are written when the content changes, and at this rate when it does not.
+	/// </summary>
+	double GetMinVideoFps() { return m_MinVideoFps; }
 	UINT32 GetVideoBitrate() { return m_VideoBitrate; }
 	UINT32 GetVideoQuality() { return m_VideoQuality; }
 	bool GetIsFixedFramerate() { return  m_IsFixedFramerate; }
 	bool GetIsThrottlingDisabled() { return  m_IsThrottlingDisabled; }
 	bool GetIsFastStartEnabled() { return m_IsMp4FastStartEnabled; }
 	bool GetIsFragmentedMp4Enabled() { return m_IsFragmentedMp4Enabled; }
+	/// <summary>
+	/// If true, recordings to a file or stream are written by the built-in MP4 muxer instead of the Media Foundation MP4 sink. B-frames are disabled, and the file is not fast start.
+	/// </summary>
+	bool GetIsNativeMuxerEnabled() { return m_IsNativeMuxerEnabled; }
+	/// <summary>
+	/// The minimum duration of a fragment of a fragmented MP4 file written by the native muxer. The key frame interval is set to it. 0 uses the key frame interval of the encoder.
+	/// </summary>
+	std::chrono::milliseconds GetFragmentDuration() { return m_FragmentDuration; }
 	bool GetIsHardwareEncodingEnabled() { return m_IsHardwareEncodingEnabled; }
 	bool GetIsLowLatencyModeEnabled() { return m_IsLowLatencyModeEnabled; }
 	UINT32 GetVideoBitrateMode() { return m_VideoBitrateControlMode; }
 	UINT32 GetEncoderProfile() { return m_EncoderProfile; }
+	/// <summary>
+	/// What happens to the frame slots missed when a frame is late. Only used with a fixed framerate, as frames otherwise only arrive when the content changes.
+	/// </summary>
+	FrameSchedulePolicy GetFrameSchedulePolicy() { return m_FrameSchedulePolicy; }
+	/// <summary>
+	/// If true, the frame rate and bitrate are lowered in steps while the encoder cannot keep up, and restored when it has recovered.
+	/// </summary>
+	bool GetIsAdaptiveQualityEnabled() { return m_IsAdaptiveQualityEnabled; }
+	/// <summary>
+	/// The maximum number of video frames written to the encoder that it has not released yet. 0 does not limit them.
+	/// </summary>
+	UINT32 GetMaxInFlightFrames() { return m_MaxInFlightFrames; }
+	/// <summary>
+	/// The maximum size in bytes of the video frames written to the encoder that it has not released yet. 0 does not limit them.
+	/// </summary>
+	UINT64 GetMaxInFlightBytes() { return m_MaxInFlightBytes; }
+	/// <summary>
+	/// What happens to a video frame when the encoder holds the maximum number of frames or bytes.
+	/// </summary>
+	InFlightFramePolicy GetInFlightFramePolicy() { return m_InFlightFramePolicy; }
 
 	virtual GUID GetVideoEncoderFormat() abstract;
 	virtual std::wstring GetVideoExtension() {
@@ -596,17 +830,60 @@ public:
 	virtual GUID GetVideoEncoderFormat() override { return MFVideoFormat_HEVC; }
 };
 
+enum class SnapshotQueuePolicy {
+	///<summary>When the snapshot queue is full, new snapshots are discarded.</summary>
+	Drop,
+	///<summary>When the snapshot queue is full, the most recently queued snapshot is replaced with the new one, so the latest frame is always saved.</summary>
+	Coalesce
+};
+
+enum class SnapshotEncoderBackend {
+	///<summary>Snapshots are encoded with Windows Imaging Component.</summary>
+	WIC,
+	///<summary>PNG and BMP snapshots are encoded with the built-in encoders, directly from the mapped texture. Other formats fall back to WIC.</summary>
+	BuiltIn
+};
+
+//Not a WIC container format, WIC has no QOI codec. Selects the built-in QOI encoder.
+static const GUID GUID_ContainerFormatQoi = { 0x7a1c4f2e, 0x9b3d, 0x4e61, { 0xa8, 0x5f, 0x2c, 0x0d, 0x61, 0x9e, 0x47, 0xb3 } };
+
 struct SNAPSHOT_OPTIONS {
 protected:
 	std::wstring m_OutputSnapshotsFolderPath = L"";
 	std::chrono::milliseconds m_SnapshotsInterval = std::chrono::milliseconds(10000);
 	bool m_TakesSnapshotsWithVideo = false;
 	GUID m_ImageEncoderFormat = GUID_ContainerFormatPng;
+	UINT32 m_WorkerCount = 1;
+	UINT32 m_MaxQueuedSnapshots = 3;
+	SnapshotQueuePolicy m_QueuePolicy = SnapshotQueuePolicy::Coalesce;
+	SnapshotEncoderBackend m_EncoderBackend = SnapshotEncoderBackend::WIC;
+	UINT32 m_EncoderThreadCount = 0;
 public:
 	void SetTakeSnapshotsWithVideo(bool isEnabled) { m_TakesSnapshotsWithVideo = isEnabled; }
 	void SetSnapshotsWithVideoInterval(UINT32 value) { m_SnapshotsInterval = std::chrono::milliseconds(value); }
 	void SetSnapshotDirectory(std::wstring string) { m_OutputSnapshotsFolderPath = string; }
 	void SetSnapshotSaveFormat(GUID value) { m_ImageEncoderFormat = value; }
+	void SetWorkerCount(UINT32 value) { m_WorkerCount = value; }
+	void SetMaxQueuedSnapshots(UINT32 value) { m_MaxQueuedSnapshots = value; }
+	void SetQueuePolicy(SnapshotQueuePolicy value) { m_QueuePolicy = value; }
+	void SetEncoderBackend(SnapshotEncoderBackend value) { m_EncoderBackend = value; }
+	void SetEncoderThreadCount(UINT32 value) { m_EncoderThreadCount = value; }
+
+	/// <summary>
+	/// The number of threads encoding snapshots in parallel.
+	/// </summary>
+	UINT32 GetWorkerCount() {
+		return m_WorkerCount;
+	}
+	/// <summary>
+	/// The maximum number of snapshots waiting to be encoded. When exceeded, the queue policy decides which snapshot is discarded.
+	/// </summary>
+	UINT32 GetMaxQueuedSnapshots() {
+		return m_MaxQueuedSnapshots;
+	}
+	SnapshotQueuePolicy GetQueuePolicy() {
+		return m_QueuePolicy;
+	}
 
 	bool IsSnapshotWithVideoEnabled() {
 		return m_TakesSnapshotsWithVideo;
@@ -620,6 +897,32 @@ public:
 	GUID GetSnapshotEncoderFormat() {
 		return m_ImageEncoderFormat;
 	}
+	SnapshotEncoderBackend GetEncoderBackend() {
+		return m_EncoderBackend;
+	}
+	/// <summary>
+	/// The maximum number of threads the built-in PNG encoder uses for one snapshot. 0 uses the number of hardware threads, shared between the snapshot workers.
+	/// </summary>
+	UINT32 GetEncoderThreadCount() {
+		return m_EncoderThreadCount;
+	}
+	/// <summary>
+	/// The format to encode snapshots in with the built-in encoders, or nullopt if snapshots are encoded with WIC.
+	/// </summary>
+	std::optional<ImageEncoderFormat> GetBuiltInEncoderFormat() {
+		if (m_ImageEncoderFormat == GUID_ContainerFormatQoi) {
+			return ImageEncoderFormat::QOI;
+		}
+		if (m_EncoderBackend == SnapshotEncoderBackend::BuiltIn) {
+			if (m_ImageEncoderFormat == GUID_ContainerFormatPng) {
+				return ImageEncoderFormat::PNG;
+			}
+			else if (m_ImageEncoderFormat == GUID_ContainerFormatBmp) {
+				return ImageEncoderFormat::BMP;
+			}
+		}
+		return std::nullopt;
+	}
 
 
 	std::wstring GetImageExtension() {
@@ -635,6 +938,9 @@ public:
 		else if (m_ImageEncoderFormat == GUID_ContainerFormatTiff) {
 			return L".tiff";
 		}
+		else if (m_ImageEncoderFormat == GUID_ContainerFormatQoi) {
+			return L".qoi";
+		}
 		else {
 			return L".jpg";
 		}
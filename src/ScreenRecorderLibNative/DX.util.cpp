@@ -6,6 +6,7 @@
 #include "CameraCapture.h"
 #include "ImageReader.h"
 #include "GifReader.h"
+#include "SyntheticCapture.h"
 #include "WindowsGraphicsCapture.h"
 #include "PixelShader.h"
 #include "VertexShader.h"
@@ -242,6 +243,17 @@ HRESULT GetOutputRectsForRecordingSources(_In_ const std::vector<RECORDING_SOURC
 				}
 				break;
 			}
+			case RecordingSourceType::Synthetic: {
+				SIZE size{};
+				SyntheticCapture reader{};
+				HRESULT hr = reader.GetNativeSize(*source, &size);
+				if (SUCCEEDED(hr)) {
+					RECT sourceRect = GetOffsetSourceRect(RECT{ 0,0,size.cx,size.cy }, source);
+					std::pair<RECORDING_SOURCE *, RECT> tuple(source, sourceRect);
+					validOutputs.push_back(tuple);
+				}
+				break;
+			}
 			default:
 				break;
 		}
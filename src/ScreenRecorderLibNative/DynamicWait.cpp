@@ -1,32 +1,27 @@
 #include "DynamicWait.h"
-#include <profileapi.h>
-#include <synchapi.h>
 
-DynamicWait::DynamicWait() : m_CurrentWaitBandIdx(0), m_WaitCountInCurrentBand(0)
+DynamicWait::DynamicWait() :
+	m_CancelEvent(true),
+	m_CurrentWaitBandIdx(0),
+	m_WaitCountInCurrentBand(0),
+	m_LastWakeUpTime{}
 {
-	m_QPCValid = QueryPerformanceFrequency(&m_QPCFrequency);
-	m_LastWakeUpTime.QuadPart = 0L;
 	m_WaitBands = {
 					  {25, 10},
 					  {250, 20},
 					  {1000, WAIT_BAND_STOP}
 	};   // Never move past this band
-	m_CancelEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 }
 
 DynamicWait::~DynamicWait()
 {
-	SetEvent(m_CancelEvent);
-	CloseHandle(m_CancelEvent);
+	m_CancelEvent.Set();
 }
 
 void DynamicWait::Wait()
 {
-	LARGE_INTEGER CurrentQPC = { 0 };
-
 	// Is this wait being called with the period that we consider it to be part of the same wait sequence
-	QueryPerformanceCounter(&CurrentQPC);
-	if (m_QPCValid && (CurrentQPC.QuadPart <= (m_LastWakeUpTime.QuadPart + (m_QPCFrequency.QuadPart * m_WaitSequenceTimeInSeconds))))
+	if (std::chrono::steady_clock::now() <= m_LastWakeUpTime + std::chrono::seconds(m_WaitSequenceTimeInSeconds))
 	{
 		// We are still in the same wait sequence, lets check if we should move to the next band
 		if ((m_WaitBands[m_CurrentWaitBandIdx].WaitCount != WAIT_BAND_STOP) && (m_WaitCountInCurrentBand > m_WaitBands[m_CurrentWaitBandIdx].WaitCount))
@@ -37,19 +32,19 @@ void DynamicWait::Wait()
 	}
 	else
 	{
-		// Either we could not get the current time or we are starting a new wait sequence
+		// We are starting a new wait sequence
 		m_WaitCountInCurrentBand = 0;
 		m_CurrentWaitBandIdx = 0;
 	}
 
 	// Sleep for the required period of time
-	WaitForSingleObject(m_CancelEvent, m_WaitBands[m_CurrentWaitBandIdx].WaitTime);
+	m_CancelEvent.Wait(std::chrono::milliseconds(m_WaitBands[m_CurrentWaitBandIdx].WaitTime));
 
 	// Record the time we woke up so we can detect wait sequences
-	QueryPerformanceCounter(&m_LastWakeUpTime);
+	m_LastWakeUpTime = std::chrono::steady_clock::now();
 	m_WaitCountInCurrentBand++;
 }
 
 void DynamicWait::Cancel() {
-	SetEvent(m_CancelEvent);
+	m_CancelEvent.Set();
 }
\ No newline at end of file
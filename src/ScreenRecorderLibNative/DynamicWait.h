@@ -1,13 +1,15 @@
 #pragma once
-#include <Windows.h>
+#include <chrono>
+#include <cstdint>
 #include <vector>
+#include "Sync.h"
 
 #define WAIT_BAND_STOP 0
 
 struct WAIT_BAND
 {
-    UINT    WaitTime;
-    UINT    WaitCount;
+    uint32_t    WaitTime;
+    uint32_t    WaitCount;
 };
 
 class DynamicWait
@@ -25,14 +27,12 @@ public:
 private:
 
     std::vector<WAIT_BAND>   m_WaitBands;
-    HANDLE m_CancelEvent;
+    SyncEvent m_CancelEvent;
     // Period in seconds that a new wait call is considered part of the same wait sequence
-    static const UINT       m_WaitSequenceTimeInSeconds = 2;
+    static const uint32_t   m_WaitSequenceTimeInSeconds = 2;
 
-    UINT                    m_CurrentWaitBandIdx;
-    UINT                    m_WaitCountInCurrentBand;
-    LARGE_INTEGER           m_QPCFrequency;
-    LARGE_INTEGER           m_LastWakeUpTime;
-    BOOL                    m_QPCValid;
+    uint32_t                m_CurrentWaitBandIdx;
+    uint32_t                m_WaitCountInCurrentBand;
+    std::chrono::steady_clock::time_point m_LastWakeUpTime;
 };
 
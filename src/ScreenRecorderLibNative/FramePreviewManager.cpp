@@ -0,0 +1,400 @@
+#include "FramePreviewManager.h"
+#include "Log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+FramePreviewManager::FramePreviewManager(_In_ FramePreviewCallback callback) :
+	m_DeviceContext(nullptr),
+	m_Device(nullptr),
+	m_OutputOptions(nullptr),
+	m_TextureManager(nullptr),
+	m_Callback(callback),
+	m_Slots{},
+	m_PendingFrames{},
+	m_NextSlot(0),
+	m_NextPreviewTime{},
+	m_DeliveryQueue(MAX_QUEUED_PREVIEWS, MAX_QUEUED_FRAMES),
+	m_DeliveryThread{},
+	m_NV12Converter{},
+	m_ConvertedData{},
+	m_EncodedData{},
+	m_WICFactory(nullptr),
+	m_DeliveredFrameCount(0),
+	m_DroppedFrameCount(0),
+	m_SkippedFrameCount(0),
+	m_RecordingThreadMicroseconds(0),
+	m_GpuMicroseconds(0),
+	m_ProcessingMicroseconds(0)
+{
+	m_NV12Converter.SetOptions(YUVFormat::NV12, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+	//Previews are small, and the delivery thread should not compete with the encoder for cores.
+	m_NV12Converter.SetThreadCount(1);
+}
+
+FramePreviewManager::~FramePreviewManager()
+{
+	Stop();
+}
+
+HRESULT FramePreviewManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<OUTPUT_OPTIONS> &pOutputOptions, _In_ UINT ringSize)
+{
+	//The previews still in the staging textures of the previous device are not read back, as the device may be lost, but their frame numbers are delivered.
+	for (const PENDING_FRAME &frame : m_PendingFrames) {
+		if (frame.Slot >= 0) {
+			m_DroppedFrameCount++;
+			LOG_TRACE(L"Dropped frame preview %d, the device was reinitialized", frame.FrameNumber);
+		}
+		m_DeliveryQueue.Push(frame.FrameNumber, frame.Timestamp, nullptr);
+	}
+	m_PendingFrames.clear();
+	m_TextureManager = make_unique<TextureManager>();
+	RETURN_ON_BAD_HR(m_TextureManager->Initialize(pDeviceContext, pDevice, pOutputOptions->GetCompositorBackend()));
+	m_DeviceContext = pDeviceContext;
+	m_Device = pDevice;
+	m_OutputOptions = pOutputOptions;
+	m_Slots.clear();
+	m_Slots.resize(max(1u, ringSize));
+	m_NextSlot = 0;
+	return S_OK;
+}
+
+HRESULT FramePreviewManager::EnqueueFrame(_In_ int frameNumber, _In_ INT64 timestamp, _In_opt_ ID3D11Texture2D *pTexture)
+{
+	if (!m_DeviceContext || !m_Device) {
+		return E_NOT_VALID_STATE;
+	}
+	steady_clock::time_point start = steady_clock::now();
+	if (!m_DeliveryThread.joinable()) {
+		m_DeliveryQueue.Restart();
+		m_DeliveryThread = std::thread([this] { DeliveryThreadLoop(); });
+	}
+	CollectCompletedFrames();
+
+	HRESULT hr = S_OK;
+	int slot = -1;
+	if (pTexture) {
+		if (IsPreviewDue()) {
+			hr = QueuePreviewCopy(pTexture, &slot);
+			if (hr == S_FALSE) {
+				//The GPU is a full ring behind, so skip this preview instead of waiting for it.
+				m_DroppedFrameCount++;
+				LOG_TRACE(L"Dropped frame preview %d, all staging textures are in use", frameNumber);
+			}
+		}
+		else {
+			m_SkippedFrameCount++;
+		}
+	}
+	m_PendingFrames.push_back(PENDING_FRAME{ slot, frameNumber, timestamp });
+	if (slot < 0) {
+		CollectCompletedFrames();
+	}
+	m_RecordingThreadMicroseconds += duration_cast<microseconds>(steady_clock::now() - start).count();
+	return hr;
+}
+
+void FramePreviewManager::Stop()
+{
+	//The last previews are normally still on the GPU, so they are waited for, to deliver every frame queued before the stop.
+	CollectCompletedFrames(true);
+	if (m_DeliveryThread.joinable()) {
+		m_DeliveryQueue.Stop();
+		m_DeliveryThread.join();
+	}
+}
+
+FRAME_PREVIEW_STATISTICS FramePreviewManager::GetStatistics()
+{
+	FRAME_PREVIEW_STATISTICS stats{};
+	stats.DeliveredFrameCount = m_DeliveredFrameCount;
+	stats.DroppedFrameCount = m_DroppedFrameCount + m_DeliveryQueue.GetDroppedPreviewCount();
+	stats.SkippedFrameCount = m_SkippedFrameCount;
+	stats.RecordingThreadMillis = m_RecordingThreadMicroseconds / 1000.0;
+	stats.GpuMillis = m_GpuMicroseconds / 1000.0;
+	stats.ProcessingMillis = m_ProcessingMicroseconds / 1000.0;
+	return stats;
+}
+
+bool FramePreviewManager::IsPreviewDue()
+{
+	double framerate = m_OutputOptions->GetVideoFramePreviewFramerate();
+	if (framerate <= 0) {
+		return true;
+	}
+	steady_clock::time_point now = steady_clock::now();
+	if (now < m_NextPreviewTime) {
+		return false;
+	}
+	steady_clock::duration interval = duration_cast<steady_clock::duration>(duration<double>(1.0 / framerate));
+	m_NextPreviewTime += interval;
+	if (m_NextPreviewTime <= now) {
+		//Don't try to catch up on missed previews after a pause or a stall.
+		m_NextPreviewTime = now + interval;
+	}
+	return true;
+}
+
+HRESULT FramePreviewManager::QueuePreviewCopy(_In_ ID3D11Texture2D *pTexture, _Out_ int *pSlot)
+{
+	*pSlot = -1;
+	STAGING_SLOT &slot = m_Slots[m_NextSlot];
+	if (slot.IsPending) {
+		return S_FALSE;
+	}
+	if (!slot.DisjointQuery) {
+		//Timing is only used for statistics, so the preview works without it.
+		D3D11_QUERY_DESC queryDesc{ D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		HRESULT queryHr = m_Device->CreateQuery(&queryDesc, &slot.DisjointQuery);
+		queryDesc.Query = D3D11_QUERY_TIMESTAMP;
+		if (SUCCEEDED(queryHr)) {
+			queryHr = m_Device->CreateQuery(&queryDesc, &slot.StartQuery);
+		}
+		if (SUCCEEDED(queryHr)) {
+			queryHr = m_Device->CreateQuery(&queryDesc, &slot.EndQuery);
+		}
+		if (FAILED(queryHr)) {
+			LOG_WARN(L"Failed to create frame preview timestamp queries, GPU time will not be reported");
+			slot.DisjointQuery.Release();
+			slot.StartQuery.Release();
+			slot.EndQuery.Release();
+		}
+	}
+	if (slot.DisjointQuery) {
+		m_DeviceContext->Begin(slot.DisjointQuery);
+		m_DeviceContext->End(slot.StartQuery);
+	}
+
+	HRESULT hr = S_OK;
+	CComPtr<ID3D11Texture2D> pPreviewTexture = pTexture;
+	D3D11_TEXTURE2D_DESC desc;
+	pTexture->GetDesc(&desc);
+	if (m_OutputOptions->GetVideoFramePreviewSize().has_value()) {
+		long cx = m_OutputOptions->GetVideoFramePreviewSize().value().cx;
+		long cy = m_OutputOptions->GetVideoFramePreviewSize().value().cy;
+		if (cx > 0 && cy == 0) {
+			cy = static_cast<long>(round((static_cast<double>(desc.Height) / static_cast<double>(desc.Width)) * cx));
+		}
+		else if (cx == 0 && cy > 0) {
+			cx = static_cast<long>(round((static_cast<double>(desc.Width) / static_cast<double>(desc.Height)) * cy));
+		}
+		ID3D11Texture2D *pResizedTexture;
+		hr = m_TextureManager->ResizeTexture(pTexture, SIZE{ cx,cy }, TextureStretchMode::Uniform, &pResizedTexture);
+		if (SUCCEEDED(hr)) {
+			pPreviewTexture.Attach(pResizedTexture);
+			pResizedTexture->GetDesc(&desc);
+		}
+	}
+	if (SUCCEEDED(hr) && (!slot.Texture || slot.Desc.Width != desc.Width || slot.Desc.Height != desc.Height || slot.Desc.Format != desc.Format)) {
+		slot.Texture.Release();
+		D3D11_TEXTURE2D_DESC stagingDesc = desc;
+		stagingDesc.Usage = D3D11_USAGE_STAGING;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		stagingDesc.MiscFlags = 0;
+		stagingDesc.BindFlags = 0;
+		hr = m_Device->CreateTexture2D(&stagingDesc, nullptr, &slot.Texture);
+		slot.Desc = stagingDesc;
+	}
+	if (SUCCEEDED(hr)) {
+		m_DeviceContext->CopyResource(slot.Texture, pPreviewTexture);
+	}
+	if (slot.DisjointQuery) {
+		m_DeviceContext->End(slot.EndQuery);
+		m_DeviceContext->End(slot.DisjointQuery);
+	}
+	RETURN_ON_BAD_HR(hr);
+
+	slot.IsPending = true;
+	*pSlot = static_cast<int>(m_NextSlot);
+	m_NextSlot = (m_NextSlot + 1) % m_Slots.size();
+	return S_OK;
+}
+
+void FramePreviewManager::CollectCompletedFrames(_In_ bool wait)
+{
+	while (!m_PendingFrames.empty()) {
+		const PENDING_FRAME &frame = m_PendingFrames.front();
+		HRESULT hr = S_FALSE;
+		if (frame.Slot >= 0) {
+			hr = ReadSlot(frame, wait);
+			if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+				break;
+			}
+			LOG_ON_BAD_HR(hr);
+			if (FAILED(hr)) {
+				m_DroppedFrameCount++;
+			}
+		}
+		if (hr != S_OK) {
+			m_DeliveryQueue.Push(frame.FrameNumber, frame.Timestamp, nullptr);
+		}
+		m_PendingFrames.pop_front();
+	}
+}
+
+HRESULT FramePreviewManager::ReadSlot(_In_ const PENDING_FRAME &frame, _In_ bool wait)
+{
+	STAGING_SLOT &slot = m_Slots[frame.Slot];
+	D3D11_MAPPED_SUBRESOURCE map;
+	HRESULT hr = m_DeviceContext->Map(slot.Texture, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+	if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+		return hr;
+	}
+	slot.IsPending = false;
+	RETURN_ON_BAD_HR(hr);
+
+	if (slot.DisjointQuery) {
+		//The copy is done, so the queries around it are normally done too. If not, the sample is skipped rather than waited for.
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 startTime, endTime;
+		if (m_DeviceContext->GetData(slot.DisjointQuery, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& !disjoint.Disjoint
+			&& disjoint.Frequency > 0
+			&& m_DeviceContext->GetData(slot.StartQuery, &startTime, sizeof(startTime), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& m_DeviceContext->GetData(slot.EndQuery, &endTime, sizeof(endTime), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& endTime >= startTime) {
+			m_GpuMicroseconds += static_cast<INT64>((endTime - startTime) * 1000000.0 / disjoint.Frequency);
+		}
+	}
+
+	std::unique_ptr<PREVIEW_BUFFER> pPreview = m_DeliveryQueue.AcquireBuffer();
+	const int width = static_cast<int>(slot.Desc.Width);
+	const int height = static_cast<int>(slot.Desc.Height);
+	const int stride = width * 4;
+	pPreview->Data.resize(static_cast<size_t>(stride) * height);
+	const BYTE *pSrc = static_cast<const BYTE *>(map.pData);
+	for (int y = 0; y < height; y++) {
+		memcpy(pPreview->Data.data() + static_cast<size_t>(y) * stride, pSrc + static_cast<size_t>(y) * map.RowPitch, stride);
+	}
+	m_DeviceContext->Unmap(slot.Texture, 0);
+	pPreview->Width = width;
+	pPreview->Height = height;
+	pPreview->Stride = stride;
+	m_DeliveryQueue.Push(frame.FrameNumber, frame.Timestamp, std::move(pPreview));
+	return S_OK;
+}
+
+void FramePreviewManager::DeliveryThreadLoop()
+{
+	LOG_DEBUG("Starting frame preview delivery thread");
+	Tracer::SetThreadName("Frame preview delivery");
+	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+	LOG_ON_BAD_HR(hr);
+	QUEUED_PREVIEW_FRAME frame{};
+	//The queue returns the frames queued before it was stopped, so they are all delivered before the thread exits.
+	while (m_DeliveryQueue.Pop(&frame)) {
+		if (frame.Preview) {
+			FRAME_BITMAP_DATA frameData{};
+			steady_clock::time_point start = steady_clock::now();
+			HRESULT convertHr = ConvertPreview(frame.Preview.get(), &frameData);
+			m_ProcessingMicroseconds += duration_cast<microseconds>(steady_clock::now() - start).count();
+			TRACE_SCOPE("FramePreviewCallback");
+			if (SUCCEEDED(convertHr)) {
+				m_Callback(frame.FrameNumber, frame.Timestamp, &frameData);
+				m_DeliveredFrameCount++;
+			}
+			else {
+				m_Callback(frame.FrameNumber, frame.Timestamp, nullptr);
+				m_DroppedFrameCount++;
+			}
+			m_DeliveryQueue.ReleaseBuffer(std::move(frame.Preview));
+		}
+		else {
+			TRACE_SCOPE("FrameNumberCallback");
+			m_Callback(frame.FrameNumber, frame.Timestamp, nullptr);
+		}
+	}
+	m_WICFactory.Release();
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+	LOG_DEBUG("Exiting frame preview delivery thread");
+}
+
+HRESULT FramePreviewManager::ConvertPreview(_In_ PREVIEW_BUFFER *pPreview, _Out_ FRAME_BITMAP_DATA *pFrameData)
+{
+	switch (m_OutputOptions->GetVideoFramePreviewFormat())
+	{
+	case FramePreviewFormat::NV12: {
+		size_t size = ColorConverter::GetImageSize(YUVFormat::NV12, pPreview->Width, pPreview->Height);
+		m_ConvertedData.resize(size);
+		YUV_PLANES planes = ColorConverter::GetPlanes(YUVFormat::NV12, m_ConvertedData.data(), pPreview->Width, pPreview->Height, pPreview->Width);
+		if (!m_NV12Converter.Convert(pPreview->Data.data(), pPreview->Stride, pPreview->Width, pPreview->Height, planes)) {
+			return E_INVALIDARG;
+		}
+		*pFrameData = FRAME_BITMAP_DATA(pPreview->Width, m_ConvertedData.data(), static_cast<int>(size), pPreview->Width, pPreview->Height, FramePreviewFormat::NV12);
+		return S_OK;
+	}
+	case FramePreviewFormat::JPEG:
+		return EncodeJpeg(pPreview, pFrameData);
+	default:
+		*pFrameData = FRAME_BITMAP_DATA(pPreview->Stride, pPreview->Data.data(), static_cast<int>(pPreview->Data.size()), pPreview->Width, pPreview->Height, FramePreviewFormat::BGRA);
+		return S_OK;
+	}
+}
+
+HRESULT FramePreviewManager::EncodeJpeg(_In_ PREVIEW_BUFFER *pPreview, _Out_ FRAME_BITMAP_DATA *pFrameData)
+{
+	HRESULT hr = S_OK;
+	if (!m_WICFactory) {
+		RETURN_ON_BAD_HR(hr = CoCreateInstance(
+			CLSID_WICImagingFactory,
+			NULL,
+			CLSCTX_INPROC_SERVER,
+			IID_PPV_ARGS(&m_WICFactory)));
+	}
+	const int width = pPreview->Width;
+	const int height = pPreview->Height;
+
+	//The JPEG encoder takes 24bpp BGR, so the alpha channel is dropped here in one pass instead of through a WIC format converter.
+	const int bgrStride = width * 3;
+	m_ConvertedData.resize(static_cast<size_t>(bgrStride) * height);
+	for (int y = 0; y < height; y++) {
+		const BYTE *pSrc = pPreview->Data.data() + static_cast<size_t>(y) * pPreview->Stride;
+		BYTE *pDst = m_ConvertedData.data() + static_cast<size_t>(y) * bgrStride;
+		for (int x = 0; x < width; x++) {
+			pDst[0] = pSrc[0];
+			pDst[1] = pSrc[1];
+			pDst[2] = pSrc[2];
+			pSrc += 4;
+			pDst += 3;
+		}
+	}
+
+	//A JPEG of a screen capture is far smaller than the raw pixels, so the raw size plus room for headers is a safe upper bound.
+	m_EncodedData.resize(m_ConvertedData.size() + 64 * 1024);
+	CComPtr<IWICStream> pStream;
+	RETURN_ON_BAD_HR(hr = m_WICFactory->CreateStream(&pStream));
+	RETURN_ON_BAD_HR(hr = pStream->InitializeFromMemory(m_EncodedData.data(), static_cast<DWORD>(m_EncodedData.size())));
+	CComPtr<IWICBitmapEncoder> pEncoder;
+	RETURN_ON_BAD_HR(hr = m_WICFactory->CreateEncoder(GUID_ContainerFormatJpeg, nullptr, &pEncoder));
+	RETURN_ON_BAD_HR(hr = pEncoder->Initialize(pStream, WICBitmapEncoderNoCache));
+	CComPtr<IWICBitmapFrameEncode> pFrame;
+	CComPtr<IPropertyBag2> pProps;
+	RETURN_ON_BAD_HR(hr = pEncoder->CreateNewFrame(&pFrame, &pProps));
+
+	PROPBAG2 option = {};
+	option.pstrName = const_cast<wchar_t *>(L"ImageQuality");
+	VARIANT varValue;
+	VariantInit(&varValue);
+	varValue.vt = VT_R4;
+	varValue.fltVal = 0.8f;
+	(void)pProps->Write(1, &option, &varValue);
+
+	RETURN_ON_BAD_HR(hr = pFrame->Initialize(pProps));
+	RETURN_ON_BAD_HR(hr = pFrame->SetSize(width, height));
+	WICPixelFormatGUID pixelFormat = GUID_WICPixelFormat24bppBGR;
+	RETURN_ON_BAD_HR(hr = pFrame->SetPixelFormat(&pixelFormat));
+	if (pixelFormat != GUID_WICPixelFormat24bppBGR) {
+		LOG_ERROR(L"JPEG encoder does not support 24bpp BGR input");
+		return E_UNEXPECTED;
+	}
+	RETURN_ON_BAD_HR(hr = pFrame->WritePixels(height, bgrStride, static_cast<UINT>(m_ConvertedData.size()), m_ConvertedData.data()));
+	RETURN_ON_BAD_HR(hr = pFrame->Commit());
+	RETURN_ON_BAD_HR(hr = pEncoder->Commit());
+
+	ULARGE_INTEGER size{};
+	RETURN_ON_BAD_HR(hr = pStream->Seek(LARGE_INTEGER{}, STREAM_SEEK_CUR, &size));
+	*pFrameData = FRAME_BITMAP_DATA(0, m_EncodedData.data(), static_cast<int>(size.QuadPart), width, height, FramePreviewFormat::JPEG);
+	return S_OK;
+}
\ No newline at end of file
@@ -0,0 +1,119 @@
+#pragma once
+#include <atlbase.h>
+#include <wincodec.h>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "CommonTypes.h"
+#include "TextureManager.h"
+#include "ColorConverter.h"
+#include "PreviewDeliveryQueue.h"
+
+typedef std::function<void(int frameNumber, INT64 timestamp, _In_opt_ FRAME_BITMAP_DATA *pData)> FramePreviewCallback;
+
+/// <summary>
+/// Produces frame previews at their own rate, size and pixel format, independently of the recording.
+/// Frames that are not due for a preview are skipped before any GPU work is done. Previews are resized and copied into a ring of staging textures,
+/// which are mapped once the GPU is done with them, typically one or two frames later, and converted to the output format on a separate delivery thread.
+/// If the ring or the delivery queue is full, the preview is dropped instead of waiting.
+/// Every frame number is delivered to the callback in order, with preview data only for the frames that have a preview.
+/// </summary>
+class FramePreviewManager
+{
+public:
+	/// <param name="callback">Called on the delivery thread for each frame. The frame data is only valid for the duration of the call, and is nullptr for frames without a preview.</param>
+	FramePreviewManager(_In_ FramePreviewCallback callback);
+	~FramePreviewManager();
+	/// <summary>
+	/// Initializes the manager with a device, releasing any staging textures from a previous device. Frames whose preview was still in a staging texture are delivered without it, and the preview is counted as dropped.
+	/// </summary>
+	/// <param name="ringSize">The number of staging textures, which is also the maximum number of previews in flight on the GPU.</param>
+	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<OUTPUT_OPTIONS> &pOutputOptions, _In_ UINT ringSize = 3);
+	/// <summary>
+	/// Queues a frame for delivery, and forwards any earlier previews that have finished copying to the delivery thread.
+	/// If pTexture is set and a preview is due, the texture is resized and a GPU copy of it is queued for readback.
+	/// Must be called from the thread that owns the device context. Starts the delivery thread if it is not running.
+	/// </summary>
+	HRESULT EnqueueFrame(_In_ int frameNumber, _In_ INT64 timestamp, _In_opt_ ID3D11Texture2D *pTexture);
+	/// <summary>
+	/// Delivers the frames queued so far, waiting for the GPU to finish their previews, and stops the delivery thread.
+	/// Must be called from the thread that owns the device context.
+	/// </summary>
+	void Stop();
+	FRAME_PREVIEW_STATISTICS GetStatistics();
+private:
+	struct STAGING_SLOT {
+		CComPtr<ID3D11Texture2D> Texture;
+		D3D11_TEXTURE2D_DESC Desc;
+		CComPtr<ID3D11Query> DisjointQuery;
+		CComPtr<ID3D11Query> StartQuery;
+		CComPtr<ID3D11Query> EndQuery;
+		bool IsPending;
+	};
+	struct PENDING_FRAME {
+		//The staging slot holding the preview, or -1 if the frame has no preview.
+		int Slot;
+		int FrameNumber;
+		INT64 Timestamp;
+	};
+	//Previews waiting for the callback. When full, the oldest preview is removed from its frame, so a slow callback always gets the most recent preview.
+	static const size_t MAX_QUEUED_PREVIEWS = 2;
+	//Frames waiting for the callback, with or without a preview. When full, the oldest frame is dropped.
+	static const size_t MAX_QUEUED_FRAMES = 64;
+
+	ID3D11DeviceContext *m_DeviceContext;
+	ID3D11Device *m_Device;
+	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
+	std::unique_ptr<TextureManager> m_TextureManager;
+	FramePreviewCallback m_Callback;
+	std::vector<STAGING_SLOT> m_Slots;
+	std::deque<PENDING_FRAME> m_PendingFrames;
+	size_t m_NextSlot;
+	std::chrono::steady_clock::time_point m_NextPreviewTime;
+
+	PreviewDeliveryQueue m_DeliveryQueue;
+	std::thread m_DeliveryThread;
+
+	//Only used on the delivery thread.
+	ColorConverter m_NV12Converter;
+	std::vector<BYTE> m_ConvertedData;
+	std::vector<BYTE> m_EncodedData;
+	CComPtr<IWICImagingFactory> m_WICFactory;
+
+	std::atomic<UINT64> m_DeliveredFrameCount;
+	std::atomic<UINT64> m_DroppedFrameCount;
+	std::atomic<UINT64> m_SkippedFrameCount;
+	std::atomic<INT64> m_RecordingThreadMicroseconds;
+	std::atomic<INT64> m_GpuMicroseconds;
+	std::atomic<INT64> m_ProcessingMicroseconds;
+
+	/// <summary>
+	/// Returns true if a preview is due for the current frame, based on the configured preview frame rate.
+	/// </summary>
+	bool IsPreviewDue();
+	/// <summary>
+	/// Resizes the texture to the configured preview size, and queues a copy of it to the next staging texture.
+	/// </summary>
+	/// <returns>S_OK if the copy was queued, S_FALSE if all staging textures are in use.</returns>
+	HRESULT QueuePreviewCopy(_In_ ID3D11Texture2D *pTexture, _Out_ int *pSlot);
+	/// <summary>
+	/// Forwards pending frames to the delivery thread in submission order, until one is found whose preview the GPU is still writing to.
+	/// </summary>
+	/// <param name="wait">If true, the GPU is waited for, so all pending frames are forwarded.</param>
+	void CollectCompletedFrames(_In_ bool wait = false);
+	/// <summary>
+	/// Maps a pending staging texture, and queues its preview for delivery.
+	/// </summary>
+	/// <param name="wait">If false, the GPU is not waited for.</param>
+	/// <returns>S_OK if the preview was read back, DXGI_ERROR_WAS_STILL_DRAWING if the GPU is not done with it.</returns>
+	HRESULT ReadSlot(_In_ const PENDING_FRAME &frame, _In_ bool wait);
+	void DeliveryThreadLoop();
+	/// <summary>
+	/// Converts a BGRA preview to the configured output format.
+	/// </summary>
+	HRESULT ConvertPreview(_In_ PREVIEW_BUFFER *pPreview, _Out_ FRAME_BITMAP_DATA *pFrameData);
+	HRESULT EncodeJpeg(_In_ PREVIEW_BUFFER *pPreview, _Out_ FRAME_BITMAP_DATA *pFrameData);
+};
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "FrameScheduler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	const uint64_t HUNDRED_NANOS_PER_SECOND = 10000000;
+}
+
+int64_t SteadyFrameSchedulerClock::GetTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() / 100;
+}
+
+FrameScheduler::FrameScheduler(std::shared_ptr<FrameSchedulerClock> clock) :
+	m_Clock(clock),
+	m_Policy(FrameSchedulePolicy::StretchDuration),
+	m_StartTime(0),
+	m_SlotBase(0),
+	m_PeriodNumerator(0),
+	m_PeriodDenominator(1),
+	m_NextSlotIndex(0),
+	m_LastSlotIndex(0),
+	m_MaxRepeatCount(0),
+	m_KeepAliveNumerator(0),
+	m_KeepAliveDenominator(1),
+	m_FrameCount(0),
+	m_DroppedSlotCount(0),
+	m_DuplicatedFrameCount(0),
+	m_ElidedSlotCount(0),
+	m_KeepAliveFrameCount(0),
+	m_Lateness{}
+{
+}
+
+void FrameScheduler::Start(uint32_t periodNumerator, uint32_t periodDenominator, FrameSchedulePolicy policy)
+{
+	m_PeriodNumerator = periodNumerator;
+	m_PeriodDenominator = (std::max)(periodDenominator, 1u);
+	m_Policy = policy;
+	m_StartTime = m_Clock->GetTime();
+	m_SlotBase = 0;
+	m_NextSlotIndex = 0;
+	m_LastSlotIndex = 0;
+	m_FrameCount = 0;
+	m_DroppedSlotCount = 0;
+	m_DuplicatedFrameCount = 0;
+	m_ElidedSlotCount = 0;
+	m_KeepAliveFrameCount = 0;
+	m_Lateness.Reset();
+}
+
+void FrameScheduler::SetPeriod(uint32_t periodNumerator, uint32_t periodDenominator)
+{
+	m_SlotBase = GetSlotTimestamp(m_NextSlotIndex);
+	m_PeriodNumerator = periodNumerator;
+	m_PeriodDenominator = (std::max)(periodDenominator, 1u);
+	m_NextSlotIndex = 0;
+	m_LastSlotIndex = 0;
+}
+
+void FrameScheduler::SetKeepAlivePeriod(uint32_t keepAliveNumerator, uint32_t keepAliveDenominator)
+{
+	m_KeepAliveNumerator = keepAliveNumerator;
+	m_KeepAliveDenominator = (std::max)(keepAliveDenominator, 1u);
+}
+
+FRAME_SCHEDULE FrameScheduler::ScheduleFrame(bool isContentChanged)
+{
+	const int64_t now = m_Clock->GetTime() - m_StartTime;
+	const uint64_t firstSlotIndex = m_NextSlotIndex;
+	//The frame is due in the latest slot that has started, or in the next slot if it is early.
+	const uint64_t dueSlotIndex = (std::max)(GetSlotAt(now), firstSlotIndex);
+	const uint64_t missedSlotCount = dueSlotIndex - firstSlotIndex;
+	const int64_t endTimestamp = GetSlotTimestamp(dueSlotIndex + 1);
+
+	FRAME_SCHEDULE schedule{};
+	schedule.SchedulingError = now - GetSlotTimestamp(firstSlotIndex);
+	schedule.IntervalStart = GetSlotTimestamp(firstSlotIndex);
+	schedule.RepeatCount = 1;
+	if (IsVariableFrameRate()) {
+		//The slots without a change are not missed, so the frame is placed where it arrived, and the slots before it are elided.
+		schedule.SlotIndex = dueSlotIndex;
+		schedule.ElidedSlotCount = missedSlotCount;
+		schedule.IsKeepAlive = !isContentChanged;
+		schedule.SchedulingError = now - GetSlotTimestamp(dueSlotIndex);
+	}
+	else {
+		switch (m_Policy)
+		{
+			case FrameSchedulePolicy::Drop:
+				schedule.SlotIndex = dueSlotIndex;
+				schedule.DroppedSlotCount = missedSlotCount;
+				break;
+			case FrameSchedulePolicy::Duplicate: {
+				uint64_t repeatCount = missedSlotCount + 1;
+				if (m_MaxRepeatCount > 0) {
+					repeatCount = (std::min)(repeatCount, static_cast<uint64_t>(m_MaxRepeatCount));
+				}
+				schedule.SlotIndex = firstSlotIndex;
+				schedule.RepeatCount = static_cast<uint32_t>(repeatCount);
+				break;
+			}
+			case FrameSchedulePolicy::StretchDuration:
+			default:
+				schedule.SlotIndex = firstSlotIndex;
+				break;
+		}
+	}
+	schedule.Timestamp = GetSlotTimestamp(schedule.SlotIndex);
+	schedule.Duration = endTimestamp - schedule.Timestamp;
+
+	m_NextSlotIndex = dueSlotIndex + 1;
+	m_LastSlotIndex = dueSlotIndex;
+	m_FrameCount++;
+	m_DroppedSlotCount += schedule.DroppedSlotCount;
+	m_DuplicatedFrameCount += schedule.RepeatCount - 1;
+	m_ElidedSlotCount += schedule.ElidedSlotCount;
+	m_KeepAliveFrameCount += schedule.IsKeepAlive ? 1 : 0;
+	m_Lateness.Record(static_cast<uint64_t>((std::max)(schedule.SchedulingError, static_cast<int64_t>(0)) / 10));
+	return schedule;
+}
+
+int64_t FrameScheduler::GetTimeUntilNextDeadline()
+{
+	const int64_t now = m_Clock->GetTime() - m_StartTime;
+	return (std::max)(GetSlotTimestamp(m_NextSlotIndex) - now, static_cast<int64_t>(0));
+}
+
+int64_t FrameScheduler::GetTimeUntilKeepAlive()
+{
+	if (!IsVariableFrameRate()) {
+		return GetTimeUntilNextDeadline();
+	}
+	//The keep-alive frame is due in the first slot that starts a keep-alive period after the last frame. Before the first frame, the period counts from the start.
+	const uint64_t periods = m_KeepAliveNumerator * HUNDRED_NANOS_PER_SECOND;
+	const int64_t keepAliveTime = GetSlotTimestamp(m_LastSlotIndex) + static_cast<int64_t>(periods / m_KeepAliveDenominator);
+	uint64_t keepAliveSlotIndex = GetSlotAt(keepAliveTime);
+	if (GetSlotTimestamp(keepAliveSlotIndex) < keepAliveTime) {
+		keepAliveSlotIndex++;
+	}
+	keepAliveSlotIndex = (std::max)(keepAliveSlotIndex, m_NextSlotIndex);
+	const int64_t now = m_Clock->GetTime() - m_StartTime;
+	return (std::max)(GetSlotTimestamp(keepAliveSlotIndex) - now, static_cast<int64_t>(0));
+}
+
+int64_t FrameScheduler::GetSlotTimestamp(uint64_t slotIndex)
+{
+	//Split the offset into whole seconds and a remainder, so it is exact and does not overflow.
+	const uint64_t periods = slotIndex * m_PeriodNumerator;
+	const uint64_t seconds = periods / m_PeriodDenominator;
+	const uint64_t remainder = (periods % m_PeriodDenominator) * HUNDRED_NANOS_PER_SECOND / m_PeriodDenominator;
+	return m_SlotBase + static_cast<int64_t>(seconds * HUNDRED_NANOS_PER_SECOND + remainder);
+}
+
+uint64_t FrameScheduler::GetSlotAt(int64_t time)
+{
+	if (time <= m_SlotBase || m_PeriodNumerator == 0) {
+		return 0;
+	}
+	//Estimate the slot, and correct the estimate for rounding.
+	uint64_t slotIndex = static_cast<uint64_t>(static_cast<double>(time - m_SlotBase) * m_PeriodDenominator / (static_cast<double>(m_PeriodNumerator) * HUNDRED_NANOS_PER_SECOND));
+	while (GetSlotTimestamp(slotIndex + 1) <= time) {
+		slotIndex++;
+	}
+	while (slotIndex > 0 && GetSlotTimestamp(slotIndex) > time) {
+		slotIndex--;
+	}
+	return slotIndex;
+}
\ No newline at end of file
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "Metrics.h"
+
+/// <summary>
+/// The time source of a frame scheduler, in 100 nanosecond units. Implementations can be paused, or advanced manually in tests.
+/// </summary>
+class FrameSchedulerClock
+{
+public:
+	virtual ~FrameSchedulerClock() {}
+	virtual int64_t GetTime() = 0;
+};
+
+/// <summary>
+/// A frame scheduler clock on std::chrono::steady_clock.
+/// </summary>
+class SteadyFrameSchedulerClock : public FrameSchedulerClock
+{
+public:
+	virtual int64_t GetTime() override;
+};
+
+/// <summary>
+/// What the scheduler does with the frame slots that passed without a frame, when a frame is late.
+/// </summary>
+enum class FrameSchedulePolicy {
+	///<summary>The missed slots are dropped, and the frame is written to the latest slot that is due. The video has a gap where the slots were dropped.</summary>
+	Drop,
+	///<summary>The frame is written to each of the missed slots, so the video catches up with one frame per slot.</summary>
+	Duplicate,
+	///<summary>The frame is written once, with a duration that covers the missed slots.</summary>
+	StretchDuration
+};
+
+struct FRAME_SCHEDULE {
+	//The first slot the frame is written to.
+	uint64_t SlotIndex;
+	//The number of consecutive slots the frame is written to, starting at SlotIndex. Only more than 1 with the Duplicate policy.
+	uint32_t RepeatCount;
+	//The start of the first write, in 100 nanosecond units from the start of the schedule.
+	int64_t Timestamp;
+	//The duration of all writes together, in 100 nanosecond units.
+	int64_t Duration;
+	//The start of the time since the previous frame. It is before Timestamp if slots were dropped, and audio for that time is still due.
+	int64_t IntervalStart;
+	//The number of slots that passed without a frame and were dropped.
+	uint64_t DroppedSlotCount;
+	//The number of slots that passed without a content change, with a variable frame rate.
+	uint64_t ElidedSlotCount;
+	//True if the frame was scheduled with a variable frame rate only because the keep-alive period passed.
+	bool IsKeepAlive;
+	//How late the frame was for its ideal deadline, in 100 nanosecond units. Negative if the frame was early.
+	//With a variable frame rate, how long after the start of its slot the frame arrived.
+	int64_t SchedulingError;
+};
+
+/// <summary>
+/// Schedules frames on ideal presentation deadlines, one every periodNumerator / periodDenominator seconds, so rates like 29.97 fps (1001/30000 s) are exact and do not drift.
+/// When a frame arrives after the deadline of a later slot, the policy decides if the missed slots are dropped, filled with duplicates, or covered by stretching the frame.
+/// With a variable frame rate, frames are only scheduled when the content changed, or when the keep-alive period passed, and the slots in between are elided.
+/// The period is then the minimum frame interval, and the keep-alive period the maximum. Each frame is placed in the slot it arrived in, so the timestamps match the time of the content.
+/// The scheduler does not wait itself. The caller waits for GetTimeUntilNextDeadline, or GetTimeUntilKeepAlive if the content did not change, and calls ScheduleFrame when a frame is ready.
+/// </summary>
+class FrameScheduler
+{
+public:
+	FrameScheduler(std::shared_ptr<FrameSchedulerClock> clock);
+	/// <summary>
+	/// Starts a new schedule. The deadline of the first slot is the current time of the clock.
+	/// </summary>
+	void Start(uint32_t periodNumerator, uint32_t periodDenominator, FrameSchedulePolicy policy);
+	/// <summary>
+	/// Changes the period of a running schedule. The next slot starts where it would have with the old period, and the slots after it use the new period.
+	/// Slot indexes start over from the next slot, so the slot indexes of earlier schedules are no longer valid.
+	/// </summary>
+	void SetPeriod(uint32_t periodNumerator, uint32_t periodDenominator);
+	/// <summary>
+	/// The maximum number of times a late frame is written with the Duplicate policy. Slots beyond that are covered by stretching the last write. 0 does not limit the duplicates.
+	/// </summary>
+	void SetMaxRepeatCount(uint32_t count) { m_MaxRepeatCount = count; }
+	/// <summary>
+	/// Enables a variable frame rate, with a frame at least every keepAliveNumerator / keepAliveDenominator seconds. A numerator of 0 schedules a frame in every slot.
+	/// The policy is not used with a variable frame rate.
+	/// </summary>
+	void SetKeepAlivePeriod(uint32_t keepAliveNumerator, uint32_t keepAliveDenominator);
+	bool IsVariableFrameRate() { return m_KeepAliveNumerator > 0; }
+	/// <summary>
+	/// Schedules a frame that is ready now, and advances the schedule past it.
+	/// </summary>
+	/// <param name="isContentChanged">If the content changed since the previous frame. Only used with a variable frame rate.</param>
+	FRAME_SCHEDULE ScheduleFrame(bool isContentChanged = true);
+	/// <summary>
+	/// The time until the deadline of the next slot, in 100 nanosecond units. 0 if the deadline has passed.
+	/// </summary>
+	int64_t GetTimeUntilNextDeadline();
+	/// <summary>
+	/// The time until a frame is due even if the content did not change, in 100 nanosecond units. 0 if it is due now.
+	/// Without a variable frame rate, this is the time until the next deadline.
+	/// </summary>
+	int64_t GetTimeUntilKeepAlive();
+	/// <summary>
+	/// The start of a slot, in 100 nanosecond units from the start of the schedule.
+	/// </summary>
+	int64_t GetSlotTimestamp(uint64_t slotIndex);
+	FrameSchedulePolicy GetPolicy() { return m_Policy; }
+	uint64_t GetFrameCount() { return m_FrameCount; }
+	uint64_t GetDroppedSlotCount() { return m_DroppedSlotCount; }
+	uint64_t GetDuplicatedFrameCount() { return m_DuplicatedFrameCount; }
+	uint64_t GetElidedSlotCount() { return m_ElidedSlotCount; }
+	uint64_t GetKeepAliveFrameCount() { return m_KeepAliveFrameCount; }
+	/// <summary>
+	/// How late each frame was for its deadline, in microseconds. Early frames are recorded as 0.
+	/// </summary>
+	METRIC_HISTOGRAM_VALUE GetLateness() { return m_Lateness.GetValue(); }
+private:
+	/// <summary>
+	/// The latest slot with a deadline at or before the time, or 0 if there is none.
+	/// </summary>
+	uint64_t GetSlotAt(int64_t time);
+
+	std::shared_ptr<FrameSchedulerClock> m_Clock;
+	FrameSchedulePolicy m_Policy;
+	int64_t m_StartTime;
+	//The start of slot 0, in 100 nanosecond units from the start of the schedule. It moves when the period changes.
+	int64_t m_SlotBase;
+	uint64_t m_PeriodNumerator;
+	uint64_t m_PeriodDenominator;
+	uint64_t m_NextSlotIndex;
+	uint64_t m_LastSlotIndex;
+	uint32_t m_MaxRepeatCount;
+	uint64_t m_KeepAliveNumerator;
+	uint64_t m_KeepAliveDenominator;
+	uint64_t m_FrameCount;
+	uint64_t m_DroppedSlotCount;
+	uint64_t m_DuplicatedFrameCount;
+	uint64_t m_ElidedSlotCount;
+	uint64_t m_KeepAliveFrameCount;
+	MetricHistogram m_Lateness;
+};
\ No newline at end of file
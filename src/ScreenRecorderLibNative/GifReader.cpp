@@ -14,6 +14,7 @@ GifReader::GifReader()
 	m_pIWICFactory(nullptr),
 	m_pDecoder(nullptr),
 	m_FramerateTimer(nullptr),
+	m_NewFrameEvent(false),
 	m_LastSampleReceivedTimeStamp{ 0 },
 	m_cxGifImage(0),
 	m_cyGifImage(0),
@@ -29,8 +30,6 @@ GifReader::GifReader()
 	m_uFrameDelay(0),
 	m_framePosition{}
 {
-	InitializeCriticalSection(&m_CriticalSection);
-	m_NewFrameEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 }
 
 GifReader::~GifReader()
@@ -46,8 +45,6 @@ GifReader::~GifReader()
 	SafeRelease(&m_RenderTexture);
 	SafeRelease(&m_Device);
 	SafeRelease(&m_DeviceContext);
-	CloseHandle(m_NewFrameEvent);
-	DeleteCriticalSection(&m_CriticalSection);
 }
 
 HRESULT GifReader::StartCapture(_In_ RECORDING_SOURCE_BASE &recordingSource)
@@ -102,16 +99,15 @@ HRESULT GifReader::StopCapture()
 
 HRESULT GifReader::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_ ID3D11Texture2D **ppFrame)
 {
-	DWORD result = WAIT_OBJECT_0;
+	bool isNewFrame = true;
 
 	if (m_LastGrabTimeStamp.QuadPart >= m_LastSampleReceivedTimeStamp.QuadPart) {
-		result = WaitForSingleObject(m_NewFrameEvent, timeoutMillis);
+		isNewFrame = m_NewFrameEvent.Wait(timeoutMillis == INFINITE ? SYNC_INFINITE : std::chrono::milliseconds(timeoutMillis));
 	}
 	HRESULT hr = S_OK;
-	if (result == WAIT_OBJECT_0) {
+	if (isNewFrame) {
 		if (ppFrame) {
-			EnterCriticalSection(&m_CriticalSection);
-			LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetFrameBuffer");
+			const std::lock_guard<SyncMutex> lock(m_Mutex);
 			CComPtr<ID3D11Texture2D> pStagingTexture = nullptr;
 			D3D11_TEXTURE2D_DESC desc;
 			m_RenderTexture->GetDesc(&desc);
@@ -127,13 +123,8 @@ HRESULT GifReader::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_ ID3D1
 			QueryPerformanceCounter(&m_LastGrabTimeStamp);
 		}
 	}
-	else if (result == WAIT_TIMEOUT) {
-		hr = DXGI_ERROR_WAIT_TIMEOUT;
-	}
 	else {
-		DWORD dwErr = GetLastError();
-		LOG_ERROR(L"WaitForSingleObject failed: last error = %u", dwErr);
-		hr = HRESULT_FROM_WIN32(dwErr);
+		hr = DXGI_ERROR_WAIT_TIMEOUT;
 	}
 	return hr;
 }
@@ -150,8 +141,7 @@ HRESULT GifReader::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inou
 		hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
 		RETURN_ON_BAD_HR(hr);
 	}
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"WriteNextFrameToSharedSurface");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
 	D3D11_TEXTURE2D_DESC frameDesc;
 	pProcessedTexture->GetDesc(&frameDesc);
@@ -913,7 +903,7 @@ HRESULT GifReader::StartCaptureLoop()
 		}
 		do
 		{
-			EnterCriticalSection(&m_CriticalSection);
+			m_Mutex.lock();
 			ComposeNextFrame();
 			CComPtr<ID2D1Bitmap> pFrameToRender = nullptr;
 			HRESULT hr = m_pFrameComposeRT->GetBitmap(&pFrameToRender);
@@ -923,10 +913,10 @@ HRESULT GifReader::StartCaptureLoop()
 				m_RenderTarget->DrawBitmap(pFrameToRender);
 				m_RenderTarget->EndDraw();
 			}
-			LeaveCriticalSection(&m_CriticalSection);
+			m_Mutex.unlock();
 			//Update timestamp and notify that there is a new sample available
 			QueryPerformanceCounter(&m_LastSampleReceivedTimeStamp);
-			SetEvent(m_NewFrameEvent);
+			m_NewFrameEvent.Set();
 			hr = m_FramerateTimer->WaitFor(MillisToHundredNanos(m_uFrameDelay));
 			if (FAILED(hr)) {
 				LOG_ERROR(L"StartCaptureLoop wait for frame failed: hr = 0x%08x", hr);
@@ -64,8 +64,8 @@
 		}
 
 	private:
-		HANDLE m_NewFrameEvent;
-		CRITICAL_SECTION m_CriticalSection;
+		SyncEvent m_NewFrameEvent;
+		SyncMutex m_Mutex;
 		Concurrency::task<void> m_CaptureTask = concurrency::task_from_result();
 		LARGE_INTEGER m_LastSampleReceivedTimeStamp;
 		std::unique_ptr<HighresTimer> m_FramerateTimer;
@@ -1,25 +1,34 @@
 #pragma once
 #include "CommonTypes.h"
 #include "Util.h"
+#include "Sync.h"
+#include "PacingTimer.h"
 class HighresTimer
 {
 public:
 	HighresTimer();
 	~HighresTimer();
-	inline HANDLE GetTickEvent() { return m_TickEvent; }
-	HRESULT StartRecurringTimer(INT64 msInterval);
+	/// <summary>
+	/// Starts ticking with a period of periodNumerator / periodDenominator seconds, on absolute deadlines so the rate does not drift.
+	/// </summary>
+	HRESULT StartRecurringTimer(UINT32 periodNumerator, UINT32 periodDenominator);
 	HRESULT StopTimer(bool waitForCompletion);
 	HRESULT WaitForNextTick();
 	HRESULT WaitFor(INT64 interval100Nanos);
 	double GetMillisUntilNextTick();
 	inline INT64 GetTickCount() { return m_TickCount; }
+	/// <summary>
+	/// How late each recurring tick was reached, in microseconds.
+	/// </summary>
+	inline METRIC_HISTOGRAM_VALUE GetJitter() { return m_PacingTimer.GetJitter(); }
+	inline UINT64 GetSkippedTickCount() { return m_PacingTimer.GetSkippedTickCount(); }
 private:
-	bool m_IsActive;
 	INT64 m_TickCount;
-	std::chrono::steady_clock::time_point m_LastTick;
-	INT64 m_Interval;
-	UINT m_TimerResolution;
-	HANDLE m_TickEvent;
-	HANDLE m_StopEvent;
-	HANDLE m_EventArray[2];
+	DeadlineTimer m_DeadlineTimer;
+	PacingTimer m_PacingTimer;
+	SyncEvent m_StopEvent;
+	//Set while no thread is waiting on the timer.
+	SyncEvent m_IdleEvent;
+
+	HRESULT WaitUntil(std::chrono::steady_clock::time_point deadline);
 };
\ No newline at end of file
@@ -0,0 +1,1039 @@
+#include "ImageEncoder.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if !defined(IMAGE_ENCODER_NO_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define IMAGE_ENCODER_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#define IMAGE_ENCODER_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace {
+	const uint16_t LENGTH_BASE[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+	const uint8_t LENGTH_EXTRA_BITS[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+	const uint16_t DISTANCE_BASE[30] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+	const uint8_t DISTANCE_EXTRA_BITS[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+	//The order in which the code length code lengths are written, from RFC 1951.
+	const uint8_t CODE_LENGTH_ORDER[19] = { 16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+	const uint32_t ADLER_BASE = 65521;
+	//The largest number of bytes that can be summed before the Adler-32 sums must be reduced, to avoid overflowing 32 bits.
+	const size_t ADLER_MAX_RUN = 5552;
+
+	struct DEFLATE_TABLES {
+		//Length code index (0-28) for each match length - 3.
+		uint8_t LengthCode[256];
+		//Distance code for each distance - 1 below 256, followed by the code for each (distance - 1) >> 7 above it, as in zlib.
+		uint8_t DistanceCode[512];
+		DEFLATE_TABLES() {
+			for (int code = 0; code < 29; code++) {
+				for (int length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1 << LENGTH_EXTRA_BITS[code]) && length <= 258; length++) {
+					LengthCode[length - 3] = static_cast<uint8_t>(code);
+				}
+			}
+			for (int code = 0; code < 30; code++) {
+				for (int distance = DISTANCE_BASE[code] - 1; distance < DISTANCE_BASE[code] - 1 + (1 << DISTANCE_EXTRA_BITS[code]); distance++) {
+					if (distance < 256) {
+						DistanceCode[distance] = static_cast<uint8_t>(code);
+					}
+					else {
+						DistanceCode[256 + (distance >> 7)] = static_cast<uint8_t>(code);
+					}
+				}
+			}
+		}
+	};
+
+	const DEFLATE_TABLES &GetDeflateTables() {
+		static const DEFLATE_TABLES tables;
+		return tables;
+	}
+
+	inline uint32_t GetDistanceCode(const DEFLATE_TABLES &tables, uint32_t distanceMinusOne) {
+		return distanceMinusOne < 256 ? tables.DistanceCode[distanceMinusOne] : tables.DistanceCode[256 + (distanceMinusOne >> 7)];
+	}
+
+	inline uint32_t Load32(const uint8_t *p) {
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Load64(const uint8_t *p) {
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t CountTrailingZeros(uint64_t value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#elif defined(_MSC_VER)
+		unsigned long index;
+		if (_BitScanForward(&index, static_cast<uint32_t>(value))) {
+			return index;
+		}
+		_BitScanForward(&index, static_cast<uint32_t>(value >> 32));
+		return index + 32;
+#else
+		return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+	}
+
+	inline uint32_t ReverseBits(uint32_t code, uint32_t length) {
+		uint32_t reversed = 0;
+		for (uint32_t i = 0; i < length; i++) {
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		return reversed;
+	}
+
+	/// <summary>
+	/// Builds Huffman code lengths no longer than maxLength for the symbols with a non-zero frequency.
+	/// Lengths that are too long are shortened by moving codes up the tree, the same way as miniz does it.
+	/// </summary>
+	void BuildCodeLengths(const uint32_t *pFrequencies, int count, uint32_t maxLength, uint8_t *pLengths) {
+		memset(pLengths, 0, count);
+		struct LEAF {
+			uint32_t Frequency;
+			int Symbol;
+		};
+		LEAF leaves[286];
+		int leafCount = 0;
+		for (int i = 0; i < count; i++) {
+			if (pFrequencies[i] > 0) {
+				leaves[leafCount++] = LEAF{ pFrequencies[i], i };
+			}
+		}
+		if (leafCount == 0) {
+			return;
+		}
+		if (leafCount == 1) {
+			pLengths[leaves[0].Symbol] = 1;
+			return;
+		}
+		std::sort(leaves, leaves + leafCount, [](const LEAF &a, const LEAF &b) {
+			return a.Frequency < b.Frequency || (a.Frequency == b.Frequency && a.Symbol < b.Symbol);
+			});
+
+		//Two queue Huffman construction. The leaves are sorted, and internal nodes are created in increasing weight order.
+		uint64_t weights[2 * 286];
+		int parents[2 * 286];
+		for (int i = 0; i < leafCount; i++) {
+			weights[i] = leaves[i].Frequency;
+		}
+		int nextLeaf = 0;
+		int nextNode = leafCount;
+		int nodeCount = leafCount;
+		auto takeLowest = [&]() {
+			if (nextLeaf < leafCount && (nextNode >= nodeCount || weights[nextLeaf] <= weights[nextNode])) {
+				return nextLeaf++;
+			}
+			return nextNode++;
+		};
+		while (nodeCount < 2 * leafCount - 1) {
+			int a = takeLowest();
+			int b = takeLowest();
+			weights[nodeCount] = weights[a] + weights[b];
+			parents[a] = nodeCount;
+			parents[b] = nodeCount;
+			nodeCount++;
+		}
+		uint32_t depths[2 * 286];
+		depths[nodeCount - 1] = 0;
+		for (int i = nodeCount - 2; i >= 0; i--) {
+			depths[i] = depths[parents[i]] + 1;
+		}
+
+		uint32_t lengthCounts[33] = {};
+		for (int i = 0; i < leafCount; i++) {
+			lengthCounts[std::min(depths[i], maxLength)]++;
+		}
+		uint32_t total = 0;
+		for (uint32_t i = maxLength; i > 0; i--) {
+			total += lengthCounts[i] << (maxLength - i);
+		}
+		while (total != (1u << maxLength)) {
+			lengthCounts[maxLength]--;
+			for (uint32_t i = maxLength - 1; i > 0; i--) {
+				if (lengthCounts[i]) {
+					lengthCounts[i]--;
+					lengthCounts[i + 1] += 2;
+					break;
+				}
+			}
+			total--;
+		}
+		//The least frequent symbols get the longest codes.
+		int leaf = 0;
+		for (uint32_t length = maxLength; length > 0; length--) {
+			for (uint32_t i = 0; i < lengthCounts[length]; i++) {
+				pLengths[leaves[leaf++].Symbol] = static_cast<uint8_t>(length);
+			}
+		}
+	}
+
+	/// <summary>
+	/// Assigns canonical Huffman codes from code lengths. The codes are bit reversed, as deflate writes them starting from the most significant bit.
+	/// </summary>
+	void BuildCodes(const uint8_t *pLengths, int count, uint16_t *pCodes) {
+		uint32_t lengthCounts[16] = {};
+		for (int i = 0; i < count; i++) {
+			lengthCounts[pLengths[i]]++;
+		}
+		lengthCounts[0] = 0;
+		uint32_t nextCode[16] = {};
+		uint32_t code = 0;
+		for (int length = 1; length < 16; length++) {
+			code = (code + lengthCounts[length - 1]) << 1;
+			nextCode[length] = code;
+		}
+		for (int i = 0; i < count; i++) {
+			if (pLengths[i]) {
+				pCodes[i] = static_cast<uint16_t>(ReverseBits(nextCode[pLengths[i]]++, pLengths[i]));
+			}
+		}
+	}
+
+	/// <summary>
+	/// Makes sure at least two symbols have codes, as a single code of one bit is not a complete prefix code, which inflate rejects for some code types.
+	/// </summary>
+	void EnsureTwoCodes(uint32_t *pFrequencies, int count) {
+		int used = 0;
+		for (int i = 0; i < count && used < 2; i++) {
+			if (pFrequencies[i]) {
+				used++;
+			}
+		}
+		for (int i = 0; i < count && used < 2; i++) {
+			if (!pFrequencies[i]) {
+				pFrequencies[i] = 1;
+				used++;
+			}
+		}
+	}
+
+	inline void AppendBigEndian32(std::vector<uint8_t> &output, uint32_t value) {
+		output.push_back(static_cast<uint8_t>(value >> 24));
+		output.push_back(static_cast<uint8_t>(value >> 16));
+		output.push_back(static_cast<uint8_t>(value >> 8));
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	inline void AppendLittleEndian32(std::vector<uint8_t> &output, uint32_t value) {
+		output.push_back(static_cast<uint8_t>(value));
+		output.push_back(static_cast<uint8_t>(value >> 8));
+		output.push_back(static_cast<uint8_t>(value >> 16));
+		output.push_back(static_cast<uint8_t>(value >> 24));
+	}
+
+	inline void AppendLittleEndian16(std::vector<uint8_t> &output, uint16_t value) {
+		output.push_back(static_cast<uint8_t>(value));
+		output.push_back(static_cast<uint8_t>(value >> 8));
+	}
+
+	inline uint32_t AbsoluteByte(uint8_t value) {
+		return value < 128 ? value : 256 - value;
+	}
+
+	/// <summary>
+	/// Sums the absolute values of the filtered bytes, treated as signed, for the Sub and Up filters.
+	/// </summary>
+	void SumFilteredRow(const uint8_t *pCurrent, const uint8_t *pPrevious, size_t length, uint64_t *pSumSub, uint64_t *pSumUp) {
+		uint64_t sumSub = 0;
+		uint64_t sumUp = 0;
+		size_t i = 0;
+		for (; i < std::min<size_t>(3, length); i++) {
+			sumSub += AbsoluteByte(pCurrent[i]);
+			sumUp += AbsoluteByte(static_cast<uint8_t>(pCurrent[i] - pPrevious[i]));
+		}
+#if defined(IMAGE_ENCODER_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		__m128i accumulatedSub = zero;
+		__m128i accumulatedUp = zero;
+		for (; i + 16 <= length; i += 16) {
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCurrent + i));
+			__m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCurrent + i - 3));
+			__m128i up = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pPrevious + i));
+			__m128i sub = _mm_sub_epi8(current, left);
+			__m128i upFiltered = _mm_sub_epi8(current, up);
+			//min(x, 256 - x) is the absolute value of x as a signed byte.
+			accumulatedSub = _mm_add_epi64(accumulatedSub, _mm_sad_epu8(_mm_min_epu8(sub, _mm_sub_epi8(zero, sub)), zero));
+			accumulatedUp = _mm_add_epi64(accumulatedUp, _mm_sad_epu8(_mm_min_epu8(upFiltered, _mm_sub_epi8(zero, upFiltered)), zero));
+		}
+		sumSub += static_cast<uint64_t>(_mm_cvtsi128_si32(accumulatedSub)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(accumulatedSub, 8)));
+		sumUp += static_cast<uint64_t>(_mm_cvtsi128_si32(accumulatedUp)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(accumulatedUp, 8)));
+#elif defined(IMAGE_ENCODER_NEON)
+		uint32x4_t accumulatedSub = vdupq_n_u32(0);
+		uint32x4_t accumulatedUp = vdupq_n_u32(0);
+		const uint8x16_t zero = vdupq_n_u8(0);
+		for (; i + 16 <= length; i += 16) {
+			uint8x16_t current = vld1q_u8(pCurrent + i);
+			uint8x16_t sub = vsubq_u8(current, vld1q_u8(pCurrent + i - 3));
+			uint8x16_t upFiltered = vsubq_u8(current, vld1q_u8(pPrevious + i));
+			accumulatedSub = vpadalq_u16(accumulatedSub, vpaddlq_u8(vminq_u8(sub, vsubq_u8(zero, sub))));
+			accumulatedUp = vpadalq_u16(accumulatedUp, vpaddlq_u8(vminq_u8(upFiltered, vsubq_u8(zero, upFiltered))));
+		}
+		sumSub += static_cast<uint64_t>(vgetq_lane_u32(accumulatedSub, 0)) + vgetq_lane_u32(accumulatedSub, 1) + vgetq_lane_u32(accumulatedSub, 2) + vgetq_lane_u32(accumulatedSub, 3);
+		sumUp += static_cast<uint64_t>(vgetq_lane_u32(accumulatedUp, 0)) + vgetq_lane_u32(accumulatedUp, 1) + vgetq_lane_u32(accumulatedUp, 2) + vgetq_lane_u32(accumulatedUp, 3);
+#endif
+		for (; i < length; i++) {
+			sumSub += AbsoluteByte(static_cast<uint8_t>(pCurrent[i] - pCurrent[i - 3]));
+			sumUp += AbsoluteByte(static_cast<uint8_t>(pCurrent[i] - pPrevious[i]));
+		}
+		*pSumSub = sumSub;
+		*pSumUp = sumUp;
+	}
+
+	/// <summary>
+	/// Writes pCurrent - pReference into pDst. For the Sub filter, pReference is pCurrent - 3, with zeros before the first pixel.
+	/// </summary>
+	void SubtractRow(const uint8_t *pCurrent, const uint8_t *pReference, size_t length, bool isSub, uint8_t *pDst) {
+		size_t i = 0;
+		if (isSub) {
+			for (; i < std::min<size_t>(3, length); i++) {
+				pDst[i] = pCurrent[i];
+			}
+		}
+#if defined(IMAGE_ENCODER_SSE2)
+		for (; i + 16 <= length; i += 16) {
+			__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pCurrent + i));
+			__m128i reference = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pReference + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + i), _mm_sub_epi8(current, reference));
+		}
+#elif defined(IMAGE_ENCODER_NEON)
+		for (; i + 16 <= length; i += 16) {
+			vst1q_u8(pDst + i, vsubq_u8(vld1q_u8(pCurrent + i), vld1q_u8(pReference + i)));
+		}
+#endif
+		for (; i < length; i++) {
+			pDst[i] = static_cast<uint8_t>(pCurrent[i] - pReference[i]);
+		}
+	}
+
+	struct CRC_TABLE {
+		uint32_t Values[256];
+		CRC_TABLE() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++) {
+					crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+				}
+				Values[i] = crc;
+			}
+		}
+	};
+}
+
+uint32_t Crc32(uint32_t crc, const uint8_t *pData, size_t length)
+{
+	static const CRC_TABLE table;
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = table.Values[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void FilterPngRow(const uint8_t *pBGRA, int32_t width, const uint8_t *pPrevious, uint8_t *pCurrent, uint8_t *pFiltered)
+{
+	for (int32_t x = 0; x < width; x++) {
+		pCurrent[x * 3] = pBGRA[x * 4 + 2];
+		pCurrent[x * 3 + 1] = pBGRA[x * 4 + 1];
+		pCurrent[x * 3 + 2] = pBGRA[x * 4];
+	}
+	const size_t length = static_cast<size_t>(width) * 3;
+	//Without a previous row, Up is the same as None, so a row of zeros gives the right sums and output.
+	static const uint8_t zeros[64] = {};
+	std::vector<uint8_t> zeroRow;
+	const uint8_t *pUp = pPrevious;
+	if (!pUp) {
+		if (length <= sizeof(zeros)) {
+			pUp = zeros;
+		}
+		else {
+			zeroRow.resize(length);
+			pUp = zeroRow.data();
+		}
+	}
+	uint64_t sumSub, sumUp;
+	SumFilteredRow(pCurrent, pUp, length, &sumSub, &sumUp);
+	if (sumSub < sumUp) {
+		pFiltered[0] = 1;
+		SubtractRow(pCurrent, pCurrent - 3, length, true, pFiltered + 1);
+	}
+	else if (pPrevious) {
+		pFiltered[0] = 2;
+		SubtractRow(pCurrent, pPrevious, length, false, pFiltered + 1);
+	}
+	else {
+		pFiltered[0] = 0;
+		memcpy(pFiltered + 1, pCurrent, length);
+	}
+}
+
+DeflateEncoder::DeflateEncoder() :
+	m_Bits(0),
+	m_BitCount(0),
+	m_Output{},
+	m_HashTable(static_cast<size_t>(1) << HASH_BITS),
+	m_Symbols{},
+	m_LiteralFrequencies{},
+	m_DistanceFrequencies{}
+{
+	m_Symbols.reserve(MAX_BLOCK_SYMBOLS);
+}
+
+void DeflateEncoder::Reset()
+{
+	m_Bits = 0;
+	m_BitCount = 0;
+	m_Output.clear();
+	m_Symbols.clear();
+	memset(m_LiteralFrequencies, 0, sizeof(m_LiteralFrequencies));
+	memset(m_DistanceFrequencies, 0, sizeof(m_DistanceFrequencies));
+}
+
+void DeflateEncoder::Compress(const uint8_t *pData, size_t historySize, size_t size, bool isFinal)
+{
+	const size_t endPosition = historySize + size;
+	std::fill(m_HashTable.begin(), m_HashTable.end(), -1);
+	for (size_t position = historySize > WINDOW_SIZE ? historySize - WINDOW_SIZE : 0; position < historySize && position + 4 <= endPosition; position++) {
+		m_HashTable[(Load32(pData + position) * 2654435761u) >> (32 - HASH_BITS)] = static_cast<int32_t>(position);
+	}
+
+	size_t position = historySize;
+	size_t blockStart = historySize;
+	while (position + 4 <= endPosition) {
+		const uint32_t value = Load32(pData + position);
+		const uint32_t hash = (value * 2654435761u) >> (32 - HASH_BITS);
+		const int32_t candidate = m_HashTable[hash];
+		m_HashTable[hash] = static_cast<int32_t>(position);
+		if (candidate >= 0 && position - candidate <= WINDOW_SIZE && Load32(pData + candidate) == value) {
+			const size_t maxLength = std::min<size_t>(258, endPosition - position);
+			size_t length = 4;
+			while (length + 8 <= maxLength) {
+				uint64_t difference = Load64(pData + position + length) ^ Load64(pData + candidate + length);
+				if (difference) {
+					length += CountTrailingZeros(difference) / 8;
+					break;
+				}
+				length += 8;
+			}
+			if (length + 8 > maxLength) {
+				while (length < maxLength && pData[candidate + length] == pData[position + length]) {
+					length++;
+				}
+			}
+			AddMatch(static_cast<uint32_t>(length), static_cast<uint32_t>(position - candidate));
+			position += length;
+		}
+		else {
+			AddLiteral(pData[position]);
+			position++;
+		}
+		if (m_Symbols.size() >= MAX_BLOCK_SYMBOLS) {
+			WriteBlock(pData + blockStart, position - blockStart, false);
+			blockStart = position;
+		}
+	}
+	for (; position < endPosition; position++) {
+		AddLiteral(pData[position]);
+	}
+	if (!m_Symbols.empty() || isFinal) {
+		WriteBlock(pData + blockStart, position - blockStart, isFinal);
+	}
+}
+
+void DeflateEncoder::Align()
+{
+	PutBits(0, 3);
+	PadToByte();
+	AppendLittleEndian16(m_Output, 0x0000);
+	AppendLittleEndian16(m_Output, 0xFFFF);
+}
+
+void DeflateEncoder::WriteBytes(const uint8_t *pData, size_t length)
+{
+	m_Output.insert(m_Output.end(), pData, pData + length);
+}
+
+inline void DeflateEncoder::PutBits(uint32_t value, uint32_t count)
+{
+	m_Bits |= static_cast<uint64_t>(value) << m_BitCount;
+	m_BitCount += count;
+	if (m_BitCount >= 32) {
+		AppendLittleEndian32(m_Output, static_cast<uint32_t>(m_Bits));
+		m_Bits >>= 32;
+		m_BitCount -= 32;
+	}
+}
+
+void DeflateEncoder::PadToByte()
+{
+	while (m_BitCount > 0) {
+		m_Output.push_back(static_cast<uint8_t>(m_Bits));
+		m_Bits >>= 8;
+		m_BitCount = m_BitCount > 8 ? m_BitCount - 8 : 0;
+	}
+	m_Bits = 0;
+}
+
+inline void DeflateEncoder::AddLiteral(uint8_t literal)
+{
+	m_Symbols.push_back(literal);
+	m_LiteralFrequencies[literal]++;
+}
+
+inline void DeflateEncoder::AddMatch(uint32_t length, uint32_t distance)
+{
+	const DEFLATE_TABLES &tables = GetDeflateTables();
+	m_Symbols.push_back(0x80000000u | ((length - 3) << 15) | (distance - 1));
+	m_LiteralFrequencies[257 + tables.LengthCode[length - 3]]++;
+	m_DistanceFrequencies[GetDistanceCode(tables, distance - 1)]++;
+}
+
+void DeflateEncoder::WriteBlock(const uint8_t *pBlockStart, size_t blockSize, bool isFinal)
+{
+	const DEFLATE_TABLES &tables = GetDeflateTables();
+	m_LiteralFrequencies[256]++;
+	uint32_t literalFrequencies[286];
+	uint32_t distanceFrequencies[30];
+	memcpy(literalFrequencies, m_LiteralFrequencies, sizeof(literalFrequencies));
+	memcpy(distanceFrequencies, m_DistanceFrequencies, sizeof(distanceFrequencies));
+	EnsureTwoCodes(literalFrequencies, 286);
+	EnsureTwoCodes(distanceFrequencies, 30);
+	uint8_t literalLengths[286];
+	uint8_t distanceLengths[30];
+	BuildCodeLengths(literalFrequencies, 286, 15, literalLengths);
+	BuildCodeLengths(distanceFrequencies, 30, 15, distanceLengths);
+
+	int literalCount = 286;
+	while (literalCount > 257 && literalLengths[literalCount - 1] == 0) {
+		literalCount--;
+	}
+	int distanceCount = 30;
+	while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) {
+		distanceCount--;
+	}
+
+	//Run length encode the code lengths, with 16 repeating the previous length, and 17 and 18 repeating zeros.
+	uint8_t lengths[286 + 30];
+	memcpy(lengths, literalLengths, literalCount);
+	memcpy(lengths + literalCount, distanceLengths, distanceCount);
+	const int lengthCount = literalCount + distanceCount;
+	uint8_t runSymbols[286 + 30];
+	uint8_t runExtra[286 + 30];
+	int runCount = 0;
+	uint32_t codeLengthFrequencies[19] = {};
+	for (int i = 0; i < lengthCount;) {
+		const uint8_t length = lengths[i];
+		int run = 1;
+		while (i + run < lengthCount && lengths[i + run] == length) {
+			run++;
+		}
+		i += run;
+		if (length == 0) {
+			while (run >= 11) {
+				int count = std::min(run, 138);
+				runSymbols[runCount] = 18;
+				runExtra[runCount++] = static_cast<uint8_t>(count - 11);
+				run -= count;
+			}
+			if (run >= 3) {
+				runSymbols[runCount] = 17;
+				runExtra[runCount++] = static_cast<uint8_t>(run - 3);
+				run = 0;
+			}
+		}
+		else {
+			runSymbols[runCount] = length;
+			runExtra[runCount++] = 0;
+			run--;
+			while (run >= 3) {
+				int count = std::min(run, 6);
+				runSymbols[runCount] = 16;
+				runExtra[runCount++] = static_cast<uint8_t>(count - 3);
+				run -= count;
+			}
+		}
+		while (run > 0) {
+			runSymbols[runCount] = length;
+			runExtra[runCount++] = 0;
+			run--;
+		}
+	}
+	for (int i = 0; i < runCount; i++) {
+		codeLengthFrequencies[runSymbols[i]]++;
+	}
+	EnsureTwoCodes(codeLengthFrequencies, 19);
+	uint8_t codeLengthLengths[19];
+	BuildCodeLengths(codeLengthFrequencies, 19, 7, codeLengthLengths);
+	int codeLengthCount = 19;
+	while (codeLengthCount > 4 && codeLengthLengths[CODE_LENGTH_ORDER[codeLengthCount - 1]] == 0) {
+		codeLengthCount--;
+	}
+
+	//Compare the size of the Huffman coded block with storing the bytes as is.
+	uint64_t huffmanBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+	for (int i = 0; i < runCount; i++) {
+		huffmanBits += codeLengthLengths[runSymbols[i]] + (runSymbols[i] == 16 ? 2 : runSymbols[i] == 17 ? 3 : runSymbols[i] == 18 ? 7 : 0);
+	}
+	for (int i = 0; i < 286; i++) {
+		huffmanBits += static_cast<uint64_t>(m_LiteralFrequencies[i]) * (literalLengths[i] + (i > 256 ? LENGTH_EXTRA_BITS[i - 257] : 0));
+	}
+	for (int i = 0; i < 30; i++) {
+		huffmanBits += static_cast<uint64_t>(m_DistanceFrequencies[i]) * (distanceLengths[i] + DISTANCE_EXTRA_BITS[i]);
+	}
+	const uint64_t storedBits = (static_cast<uint64_t>(blockSize) + 5 * (blockSize / 65535 + 1)) * 8 + 7;
+	if (storedBits < huffmanBits) {
+		WriteStoredBlocks(pBlockStart, blockSize, isFinal);
+	}
+	else {
+		uint16_t literalCodes[286] = {};
+		uint16_t distanceCodes[30] = {};
+		uint16_t codeLengthCodes[19] = {};
+		BuildCodes(literalLengths, 286, literalCodes);
+		BuildCodes(distanceLengths, 30, distanceCodes);
+		BuildCodes(codeLengthLengths, 19, codeLengthCodes);
+
+		PutBits(isFinal ? 1 : 0, 1);
+		PutBits(2, 2);
+		PutBits(literalCount - 257, 5);
+		PutBits(distanceCount - 1, 5);
+		PutBits(codeLengthCount - 4, 4);
+		for (int i = 0; i < codeLengthCount; i++) {
+			PutBits(codeLengthLengths[CODE_LENGTH_ORDER[i]], 3);
+		}
+		for (int i = 0; i < runCount; i++) {
+			const uint8_t symbol = runSymbols[i];
+			PutBits(codeLengthCodes[symbol], codeLengthLengths[symbol]);
+			if (symbol >= 16) {
+				PutBits(runExtra[i], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+			}
+		}
+		for (uint32_t symbol : m_Symbols) {
+			if (symbol & 0x80000000u) {
+				const uint32_t lengthMinusThree = (symbol >> 15) & 0xFF;
+				const uint32_t distanceMinusOne = symbol & 0x7FFF;
+				const uint32_t lengthCode = tables.LengthCode[lengthMinusThree];
+				PutBits(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+				if (LENGTH_EXTRA_BITS[lengthCode]) {
+					PutBits(lengthMinusThree + 3 - LENGTH_BASE[lengthCode], LENGTH_EXTRA_BITS[lengthCode]);
+				}
+				const uint32_t distanceCode = GetDistanceCode(tables, distanceMinusOne);
+				PutBits(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+				if (DISTANCE_EXTRA_BITS[distanceCode]) {
+					PutBits(distanceMinusOne + 1 - DISTANCE_BASE[distanceCode], DISTANCE_EXTRA_BITS[distanceCode]);
+				}
+			}
+			else {
+				PutBits(literalCodes[symbol], literalLengths[symbol]);
+			}
+		}
+		PutBits(literalCodes[256], literalLengths[256]);
+		if (isFinal) {
+			PadToByte();
+		}
+	}
+	m_Symbols.clear();
+	memset(m_LiteralFrequencies, 0, sizeof(m_LiteralFrequencies));
+	memset(m_DistanceFrequencies, 0, sizeof(m_DistanceFrequencies));
+}
+
+void DeflateEncoder::WriteStoredBlocks(const uint8_t *pBlockStart, size_t blockSize, bool isFinal)
+{
+	size_t offset = 0;
+	do {
+		const size_t length = std::min<size_t>(65535, blockSize - offset);
+		const bool isLast = offset + length == blockSize;
+		PutBits(isFinal && isLast ? 1 : 0, 1);
+		PutBits(0, 2);
+		PadToByte();
+		AppendLittleEndian16(m_Output, static_cast<uint16_t>(length));
+		AppendLittleEndian16(m_Output, static_cast<uint16_t>(~length));
+		m_Output.insert(m_Output.end(), pBlockStart + offset, pBlockStart + offset + length);
+		offset += length;
+	} while (offset < blockSize);
+}
+
+uint32_t DeflateEncoder::Adler32(uint32_t adler, const uint8_t *pData, size_t length)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while (length > 0) {
+		const size_t run = std::min(length, ADLER_MAX_RUN);
+		for (size_t i = 0; i < run; i++) {
+			a += pData[i];
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+		pData += run;
+		length -= run;
+	}
+	return (b << 16) | a;
+}
+
+uint32_t DeflateEncoder::Adler32Combine(uint32_t adler1, uint32_t adler2, size_t length2)
+{
+	//From zlib's adler32_combine.
+	const uint32_t remainder = static_cast<uint32_t>(length2 % ADLER_BASE);
+	uint32_t sum1 = adler1 & 0xFFFF;
+	uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * sum1) % ADLER_BASE);
+	sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+	sum2 += ((adler1 >> 16) & 0xFFFF) + ((adler2 >> 16) & 0xFFFF) + ADLER_BASE - remainder;
+	if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE) sum1 -= ADLER_BASE;
+	if (sum2 >= (ADLER_BASE << 1)) sum2 -= (ADLER_BASE << 1);
+	if (sum2 >= ADLER_BASE) sum2 -= ADLER_BASE;
+	return sum1 | (sum2 << 16);
+}
+
+ImageEncoder::ImageEncoder() :
+	m_ThreadCount(1),
+	m_Output{},
+	m_PngWorkspaces{},
+	m_PngBands{}
+{
+}
+
+void ImageEncoder::SetThreadCount(uint32_t count)
+{
+	m_ThreadCount = count;
+}
+
+const wchar_t *ImageEncoder::GetExtension(ImageEncoderFormat format)
+{
+	switch (format)
+	{
+	case ImageEncoderFormat::QOI:
+		return L".qoi";
+	case ImageEncoderFormat::BMP:
+		return L".bmp";
+	default:
+		return L".png";
+	}
+}
+
+bool ImageEncoder::Encode(ImageEncoderFormat format, const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write)
+{
+	if (!pSrc || width <= 0 || height <= 0 || srcStride < width * 4 || !write) {
+		return false;
+	}
+	m_Output.clear();
+	switch (format)
+	{
+	case ImageEncoderFormat::QOI:
+		return EncodeQoi(pSrc, srcStride, width, height, write);
+	case ImageEncoderFormat::BMP:
+		return EncodeBmp(pSrc, srcStride, width, height, write);
+	default:
+		return EncodePng(pSrc, srcStride, width, height, write);
+	}
+}
+
+bool ImageEncoder::FlushOutput(const ImageWriteCallback &write, bool force)
+{
+	if (m_Output.empty() || (!force && m_Output.size() < OUTPUT_FLUSH_SIZE)) {
+		return true;
+	}
+	bool result = write(m_Output.data(), m_Output.size());
+	m_Output.clear();
+	return result;
+}
+
+void ImageEncoder::AppendPngChunk(const char *type, const uint8_t *pData, size_t length)
+{
+	AppendBigEndian32(m_Output, static_cast<uint32_t>(length));
+	const size_t typeOffset = m_Output.size();
+	m_Output.insert(m_Output.end(), type, type + 4);
+	if (length > 0) {
+		m_Output.insert(m_Output.end(), pData, pData + length);
+	}
+	AppendBigEndian32(m_Output, Crc32(0, m_Output.data() + typeOffset, length + 4));
+}
+
+bool ImageEncoder::EncodePng(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	m_Output.insert(m_Output.end(), signature, signature + sizeof(signature));
+	std::vector<uint8_t> header;
+	AppendBigEndian32(header, static_cast<uint32_t>(width));
+	AppendBigEndian32(header, static_cast<uint32_t>(height));
+	//8 bits per sample, RGB, deflate, adaptive filtering, no interlacing.
+	const uint8_t format[5] = { 8, 2, 0, 0, 0 };
+	header.insert(header.end(), format, format + sizeof(format));
+	AppendPngChunk("IHDR", header.data(), header.size());
+
+	PNG_JOB job{};
+	job.pSrc = pSrc;
+	job.SrcStride = srcStride;
+	job.Width = width;
+	job.Height = height;
+	job.RowSize = 1 + static_cast<size_t>(width) * 3;
+	job.RowsPerBand = static_cast<int32_t>(std::max<size_t>(1, PNG_BAND_SIZE / job.RowSize));
+	job.BandCount = (height + job.RowsPerBand - 1) / job.RowsPerBand;
+	const uint32_t threadCount = std::min(m_ThreadCount > 0 ? m_ThreadCount : std::max(1u, std::thread::hardware_concurrency()), static_cast<uint32_t>(job.BandCount));
+	//Bands are written in order, so the number of compressed bands waiting for an earlier one is bounded to keep memory use down.
+	const int32_t maxPendingBands = static_cast<int32_t>(threadCount) * 2;
+	while (m_PngWorkspaces.size() < threadCount) {
+		m_PngWorkspaces.push_back(std::make_unique<PNG_WORKSPACE>());
+	}
+	if (m_PngBands.size() < static_cast<size_t>(maxPendingBands)) {
+		m_PngBands.resize(maxPendingBands);
+	}
+	for (PNG_BAND &band : m_PngBands) {
+		band.IsCompleted = false;
+	}
+
+	std::mutex mutex;
+	std::condition_variable bandChanged;
+	int32_t nextBand = 0;
+	int32_t nextWrittenBand = 0;
+	bool isStopping = false;
+	auto canStartBand = [&]() {
+		return nextBand < job.BandCount && nextBand < nextWrittenBand + maxPendingBands;
+	};
+	auto workerLoop = [&](PNG_WORKSPACE &workspace) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			bandChanged.wait(lock, [&] { return isStopping || nextBand >= job.BandCount || canStartBand(); });
+			if (isStopping || nextBand >= job.BandCount) {
+				return;
+			}
+			const int32_t bandIndex = nextBand++;
+			PNG_BAND &band = m_PngBands[bandIndex % maxPendingBands];
+			lock.unlock();
+			CompressPngBand(job, bandIndex, workspace, band);
+			lock.lock();
+			band.IsCompleted = true;
+			bandChanged.notify_all();
+		}
+	};
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		workers.emplace_back(workerLoop, std::ref(*m_PngWorkspaces[i]));
+	}
+
+	//The calling thread writes the bands in order as they complete, and compresses bands itself while it waits.
+	bool isWritten = true;
+	uint32_t adler = 1;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (nextWrittenBand < job.BandCount) {
+			PNG_BAND &band = m_PngBands[nextWrittenBand % maxPendingBands];
+			if (band.IsCompleted) {
+				lock.unlock();
+				adler = DeflateEncoder::Adler32Combine(adler, band.Adler, band.Size);
+				if (nextWrittenBand == job.BandCount - 1) {
+					uint8_t trailer[4] = { static_cast<uint8_t>(adler >> 24), static_cast<uint8_t>(adler >> 16), static_cast<uint8_t>(adler >> 8), static_cast<uint8_t>(adler) };
+					band.Compressed.insert(band.Compressed.end(), trailer, trailer + sizeof(trailer));
+				}
+				AppendPngChunk("IDAT", band.Compressed.data(), band.Compressed.size());
+				isWritten = FlushOutput(write, false);
+				lock.lock();
+				band.IsCompleted = false;
+				nextWrittenBand++;
+				bandChanged.notify_all();
+				if (!isWritten) {
+					break;
+				}
+			}
+			else if (canStartBand()) {
+				const int32_t bandIndex = nextBand++;
+				PNG_BAND &ownBand = m_PngBands[bandIndex % maxPendingBands];
+				lock.unlock();
+				CompressPngBand(job, bandIndex, *m_PngWorkspaces[0], ownBand);
+				lock.lock();
+				ownBand.IsCompleted = true;
+			}
+			else {
+				bandChanged.wait(lock);
+			}
+		}
+		isStopping = true;
+	}
+	bandChanged.notify_all();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+	if (!isWritten) {
+		return false;
+	}
+	AppendPngChunk("IEND", nullptr, 0);
+	return FlushOutput(write, true);
+}
+
+void ImageEncoder::CompressPngBand(const PNG_JOB &job, int32_t bandIndex, PNG_WORKSPACE &workspace, PNG_BAND &band)
+{
+	const int32_t firstRow = bandIndex * job.RowsPerBand;
+	const int32_t lastRow = std::min(job.Height, firstRow + job.RowsPerBand);
+	//The rows filling the 32K window before the band are filtered again, so the band can be compressed with the same history as a single stream.
+	const int32_t historyRows = std::min(firstRow, static_cast<int32_t>((DeflateEncoder::WINDOW_SIZE + job.RowSize - 1) / job.RowSize));
+	const int32_t firstFilteredRow = firstRow - historyRows;
+	workspace.Filtered.resize(job.RowSize * (lastRow - firstFilteredRow));
+	workspace.Rows[0].resize(job.RowSize);
+	workspace.Rows[1].resize(job.RowSize);
+	int rowIndex = 0;
+	if (firstFilteredRow > 0) {
+		//Only the unfiltered row is needed, as the reference for the first filtered row. Its filtered output is overwritten.
+		FilterPngRow(job.pSrc + static_cast<size_t>(firstFilteredRow - 1) * job.SrcStride, job.Width, nullptr, workspace.Rows[1].data(), workspace.Filtered.data());
+	}
+	for (int32_t y = firstFilteredRow; y < lastRow; y++) {
+		uint8_t *pCurrent = workspace.Rows[rowIndex].data();
+		const uint8_t *pPrevious = y > 0 ? workspace.Rows[rowIndex ^ 1].data() : nullptr;
+		FilterPngRow(job.pSrc + static_cast<size_t>(y) * job.SrcStride, job.Width, pPrevious, pCurrent, workspace.Filtered.data() + static_cast<size_t>(y - firstFilteredRow) * job.RowSize);
+		rowIndex ^= 1;
+	}
+
+	const size_t historySize = std::min(DeflateEncoder::WINDOW_SIZE, job.RowSize * historyRows);
+	const uint8_t *pBandData = workspace.Filtered.data() + job.RowSize * historyRows;
+	band.Size = job.RowSize * (lastRow - firstRow);
+	band.Adler = DeflateEncoder::Adler32(1, pBandData, band.Size);
+	DeflateEncoder &deflater = workspace.Deflater;
+	deflater.Reset();
+	if (bandIndex == 0) {
+		//zlib header for a 32K window and the fastest compression level.
+		const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+		deflater.WriteBytes(zlibHeader, sizeof(zlibHeader));
+	}
+	const bool isLastBand = bandIndex == job.BandCount - 1;
+	deflater.Compress(pBandData - historySize, historySize, band.Size, isLastBand);
+	if (!isLastBand) {
+		//Ends the band on a byte boundary, so the compressed bands can be concatenated.
+		deflater.Align();
+	}
+	band.Compressed.swap(deflater.GetOutput());
+}
+
+bool ImageEncoder::EncodeQoi(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write)
+{
+	const uint8_t magic[4] = { 'q', 'o', 'i', 'f' };
+	m_Output.insert(m_Output.end(), magic, magic + sizeof(magic));
+	AppendBigEndian32(m_Output, static_cast<uint32_t>(width));
+	AppendBigEndian32(m_Output, static_cast<uint32_t>(height));
+	//3 channels, sRGB with linear alpha.
+	m_Output.push_back(3);
+	m_Output.push_back(0);
+
+	//Pixels are packed as 0xRRGGBB, the alpha channel is always 255.
+	uint32_t index[64] = {};
+	bool isIndexed[64] = {};
+	uint32_t previous = 0;
+	int run = 0;
+	for (int32_t y = 0; y < height; y++) {
+		const uint8_t *pRow = pSrc + static_cast<size_t>(y) * srcStride;
+		for (int32_t x = 0; x < width; x++) {
+			const uint8_t b = pRow[x * 4];
+			const uint8_t g = pRow[x * 4 + 1];
+			const uint8_t r = pRow[x * 4 + 2];
+			const uint32_t pixel = (static_cast<uint32_t>(r) << 16) | (static_cast<uint32_t>(g) << 8) | b;
+			//The decoder starts from black, so a black first pixel is a run as well.
+			if (pixel == previous) {
+				run++;
+				if (run == 62) {
+					m_Output.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+					run = 0;
+				}
+				continue;
+			}
+			if (run > 0) {
+				m_Output.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+				run = 0;
+			}
+			const uint8_t previousR = static_cast<uint8_t>(previous >> 16);
+			const uint8_t previousG = static_cast<uint8_t>(previous >> 8);
+			const uint8_t previousB = static_cast<uint8_t>(previous);
+			const uint32_t hash = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+			if (isIndexed[hash] && index[hash] == pixel) {
+				m_Output.push_back(static_cast<uint8_t>(hash));
+			}
+			else {
+				index[hash] = pixel;
+				isIndexed[hash] = true;
+				const int8_t dr = static_cast<int8_t>(r - previousR);
+				const int8_t dg = static_cast<int8_t>(g - previousG);
+				const int8_t db = static_cast<int8_t>(b - previousB);
+				const int8_t drg = static_cast<int8_t>(dr - dg);
+				const int8_t dbg = static_cast<int8_t>(db - dg);
+				if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+					m_Output.push_back(static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+				}
+				else if (drg > -9 && drg < 8 && dg > -33 && dg < 32 && dbg > -9 && dbg < 8) {
+					m_Output.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+					m_Output.push_back(static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8)));
+				}
+				else {
+					m_Output.push_back(0xFE);
+					m_Output.push_back(r);
+					m_Output.push_back(g);
+					m_Output.push_back(b);
+				}
+			}
+			previous = pixel;
+		}
+		if (!FlushOutput(write, false)) {
+			return false;
+		}
+	}
+	if (run > 0) {
+		m_Output.push_back(static_cast<uint8_t>(0xC0 | (run - 1)));
+	}
+	const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	m_Output.insert(m_Output.end(), end, end + sizeof(end));
+	return FlushOutput(write, true);
+}
+
+bool ImageEncoder::EncodeBmp(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write)
+{
+	const uint64_t imageSize = static_cast<uint64_t>(width) * height * 4;
+	const uint32_t headerSize = 14 + 40;
+	if (imageSize + headerSize > UINT32_MAX) {
+		return false;
+	}
+	//BITMAPFILEHEADER
+	m_Output.push_back('B');
+	m_Output.push_back('M');
+	AppendLittleEndian32(m_Output, static_cast<uint32_t>(imageSize + headerSize));
+	AppendLittleEndian32(m_Output, 0);
+	AppendLittleEndian32(m_Output, headerSize);
+	//BITMAPINFOHEADER, with a negative height for top-down rows.
+	AppendLittleEndian32(m_Output, 40);
+	AppendLittleEndian32(m_Output, static_cast<uint32_t>(width));
+	AppendLittleEndian32(m_Output, static_cast<uint32_t>(-height));
+	AppendLittleEndian16(m_Output, 1);
+	AppendLittleEndian16(m_Output, 32);
+	AppendLittleEndian32(m_Output, 0);
+	AppendLittleEndian32(m_Output, static_cast<uint32_t>(imageSize));
+	//72 DPI
+	AppendLittleEndian32(m_Output, 2835);
+	AppendLittleEndian32(m_Output, 2835);
+	AppendLittleEndian32(m_Output, 0);
+	AppendLittleEndian32(m_Output, 0);
+	if (!FlushOutput(write, true)) {
+		return false;
+	}
+	const size_t rowSize = static_cast<size_t>(width) * 4;
+	if (static_cast<size_t>(srcStride) == rowSize) {
+		return write(pSrc, rowSize * height);
+	}
+	for (int32_t y = 0; y < height; y++) {
+		if (!write(pSrc + static_cast<size_t>(y) * srcStride, rowSize)) {
+			return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <functional>
+#include <memory>
+
+enum class ImageEncoderFormat {
+	///<summary>24 bit RGB PNG, compressed with the built-in deflate encoder.</summary>
+	PNG,
+	///<summary>24 bit RGB "Quite OK Image" format. Much faster than PNG, with somewhat larger files.</summary>
+	QOI,
+	///<summary>Uncompressed 32 bit top-down BMP. The rows are written unchanged from the source.</summary>
+	BMP
+};
+
+/// <summary>
+/// Receives encoded image data in order. Returns false to abort the encoding.
+/// </summary>
+typedef std::function<bool(const uint8_t *pData, size_t length)> ImageWriteCallback;
+
+/// <summary>
+/// A fast single-pass deflate (RFC 1951) compressor. Matches are found with a single-probe hash table, and each block is written
+/// with dynamic Huffman codes, or stored if that is smaller.
+/// </summary>
+class DeflateEncoder
+{
+public:
+	DeflateEncoder();
+	/// <summary>
+	/// Compresses size bytes starting at pData + historySize. The historySize bytes before it are used as the initial window for matches, but are not written.
+	/// The compressed data is appended to the output, except for up to 7 bits that are kept until the next call.
+	/// </summary>
+	/// <param name="isFinal">Marks the last block of the stream. After this, the output is padded to a whole byte.</param>
+	void Compress(const uint8_t *pData, size_t historySize, size_t size, bool isFinal);
+	/// <summary>
+	/// Writes an empty stored block, so the output ends on a byte boundary. Streams compressed separately can be concatenated after this.
+	/// </summary>
+	void Align();
+	/// <summary>
+	/// Appends bytes to the output. Only valid on a byte boundary, i.e. before the first block, after Align or after the final block.
+	/// </summary>
+	void WriteBytes(const uint8_t *pData, size_t length);
+	/// <summary>
+	/// The compressed data written so far. The caller may consume and clear it between calls.
+	/// </summary>
+	std::vector<uint8_t> &GetOutput() { return m_Output; }
+	void Reset();
+
+	static uint32_t Adler32(uint32_t adler, const uint8_t *pData, size_t length);
+	/// <summary>
+	/// Combines the Adler-32 checksums of two consecutive buffers, where length2 is the length of the second buffer.
+	/// </summary>
+	static uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2, size_t length2);
+
+	static constexpr size_t WINDOW_SIZE = 32768;
+private:
+	static const int HASH_BITS = 15;
+	static const size_t MAX_BLOCK_SYMBOLS = 1 << 16;
+
+	void PutBits(uint32_t value, uint32_t count);
+	void PadToByte();
+	void AddLiteral(uint8_t literal);
+	void AddMatch(uint32_t length, uint32_t distance);
+	void WriteBlock(const uint8_t *pBlockStart, size_t blockSize, bool isFinal);
+	void WriteStoredBlocks(const uint8_t *pBlockStart, size_t blockSize, bool isFinal);
+
+	uint64_t m_Bits;
+	uint32_t m_BitCount;
+	std::vector<uint8_t> m_Output;
+	std::vector<int32_t> m_HashTable;
+	//Literals are stored as is. Matches have the top bit set, followed by the length - 3 and the distance - 1.
+	std::vector<uint32_t> m_Symbols;
+	uint32_t m_LiteralFrequencies[286];
+	uint32_t m_DistanceFrequencies[30];
+};
+
+/// <summary>
+/// Encodes 32bpp BGRA images to PNG, QOI and BMP without any platform codecs. The alpha channel is discarded, as in the WIC snapshots.
+/// Output is produced in pieces while encoding, so it can be written straight to a file or stream. Buffers are reused between calls.
+/// PNG images are split into row bands that are filtered and compressed in parallel, each primed with the 32K before it, as pigz does.
+/// </summary>
+class ImageEncoder
+{
+public:
+	ImageEncoder();
+	/// <summary>
+	/// Sets the maximum number of threads used for PNG encoding, including the calling thread. 0 uses the number of hardware threads. Default is 1.
+	/// </summary>
+	void SetThreadCount(uint32_t count);
+	/// <summary>
+	/// Encodes an image read directly from pSrc, e.g. a mapped staging texture.
+	/// </summary>
+	/// <returns>false if the arguments are invalid or the write callback failed, else true</returns>
+	bool Encode(ImageEncoderFormat format, const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write);
+	static const wchar_t *GetExtension(ImageEncoderFormat format);
+private:
+	static const size_t OUTPUT_FLUSH_SIZE = 256 * 1024;
+	static const size_t PNG_BAND_SIZE = 512 * 1024;
+
+	struct PNG_JOB {
+		const uint8_t *pSrc;
+		int32_t SrcStride;
+		int32_t Width;
+		int32_t Height;
+		size_t RowSize;
+		int32_t RowsPerBand;
+		int32_t BandCount;
+	};
+	//Buffers used by one thread while compressing a band.
+	struct PNG_WORKSPACE {
+		DeflateEncoder Deflater;
+		std::vector<uint8_t> Filtered;
+		std::vector<uint8_t> Rows[2];
+	};
+	struct PNG_BAND {
+		std::vector<uint8_t> Compressed;
+		uint32_t Adler;
+		size_t Size;
+		bool IsCompleted;
+	};
+
+	bool EncodePng(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write);
+	bool EncodeQoi(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write);
+	bool EncodeBmp(const uint8_t *pSrc, int32_t srcStride, int32_t width, int32_t height, const ImageWriteCallback &write);
+	void AppendPngChunk(const char *type, const uint8_t *pData, size_t length);
+	bool FlushOutput(const ImageWriteCallback &write, bool force);
+	/// <summary>
+	/// Filters and compresses one band of rows into a deflate stream that ends on a byte boundary, or ends the zlib stream for the last band.
+	/// </summary>
+	void CompressPngBand(const PNG_JOB &job, int32_t bandIndex, PNG_WORKSPACE &workspace, PNG_BAND &band);
+
+	uint32_t m_ThreadCount;
+	std::vector<uint8_t> m_Output;
+	std::vector<std::unique_ptr<PNG_WORKSPACE>> m_PngWorkspaces;
+	//Compressed bands waiting to be written, used as a ring indexed by band number.
+	std::vector<PNG_BAND> m_PngBands;
+};
+
+/// <summary>
+/// Converts a row of BGRA pixels to RGB, and writes it PNG filtered with whichever of the Sub and Up filters gives the smallest sum of absolute differences.
+/// </summary>
+/// <param name="pPrevious">The previous unfiltered RGB row, or nullptr for the first row.</param>
+/// <param name="pCurrent">Receives the unfiltered RGB row.</param>
+/// <param name="pFiltered">Receives the filter type byte followed by the filtered row.</param>
+void FilterPngRow(const uint8_t *pBGRA, int32_t width, const uint8_t *pPrevious, uint8_t *pCurrent, uint8_t *pFiltered);
+uint32_t Crc32(uint32_t crc, const uint8_t *pData, size_t length);
\ No newline at end of file
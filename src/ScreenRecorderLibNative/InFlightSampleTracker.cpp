@@ -0,0 +1,122 @@
+#include "InFlightSampleTracker.h"
+#include <algorithm>
+#include <mutex>
+
+InFlightSampleTracker::InFlightSampleTracker() :
+	m_ReleasedEvent(false),
+	m_Frames{},
+	m_MaxFrameCount(0),
+	m_MaxByteCount(0),
+	m_ByteCount(0),
+	m_ReservedFrameCount(0),
+	m_ReservedByteCount(0),
+	m_PeakFrameCount(0),
+	m_DroppedFrameCount(0)
+{
+}
+
+void InFlightSampleTracker::SetLimits(uint32_t maxFrameCount, uint64_t maxByteCount)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	m_MaxFrameCount = maxFrameCount;
+	m_MaxByteCount = maxByteCount;
+}
+
+bool InFlightSampleTracker::HasCapacity(uint64_t byteCount)
+{
+	const size_t frameCount = m_Frames.size() + m_ReservedFrameCount;
+	if (frameCount == 0) {
+		return true;
+	}
+	if (m_MaxFrameCount > 0 && frameCount >= m_MaxFrameCount) {
+		return false;
+	}
+	return m_MaxByteCount == 0 || m_ByteCount + m_ReservedByteCount + byteCount <= m_MaxByteCount;
+}
+
+bool InFlightSampleTracker::WaitForCapacity(uint64_t byteCount, std::chrono::milliseconds timeout, SyncEvent *pCancelEvent)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	for (;;) {
+		{
+			const std::lock_guard<SyncMutex> lock(m_Mutex);
+			if (HasCapacity(byteCount)) {
+				return true;
+			}
+			//The event is reset while holding the lock, so a release after the check is not missed.
+			m_ReleasedEvent.Reset();
+		}
+		const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		bool isReleased = false;
+		if (remaining > std::chrono::milliseconds(0)) {
+			isReleased = pCancelEvent ? WaitAny({ &m_ReleasedEvent, pCancelEvent }, remaining) == 0 : m_ReleasedEvent.Wait(remaining);
+		}
+		if (!isReleased) {
+			const std::lock_guard<SyncMutex> lock(m_Mutex);
+			if (HasCapacity(byteCount)) {
+				return true;
+			}
+			m_DroppedFrameCount++;
+			return false;
+		}
+	}
+}
+
+void InFlightSampleTracker::Reserve(uint64_t byteCount)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	m_ReservedFrameCount++;
+	m_ReservedByteCount += byteCount;
+}
+
+void InFlightSampleTracker::CancelReservation(uint64_t byteCount)
+{
+	{
+		const std::lock_guard<SyncMutex> lock(m_Mutex);
+		RemoveReservation(byteCount);
+	}
+	m_ReleasedEvent.Set();
+}
+
+void InFlightSampleTracker::RemoveReservation(uint64_t byteCount)
+{
+	if (m_ReservedFrameCount == 0) {
+		return;
+	}
+	m_ReservedFrameCount--;
+	m_ReservedByteCount -= (std::min)(byteCount, m_ReservedByteCount);
+}
+
+void InFlightSampleTracker::Submit(uint64_t byteCount, int64_t time, bool isReserved)
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	if (isReserved) {
+		RemoveReservation(byteCount);
+	}
+	m_Frames.push_back({ byteCount, time });
+	m_ByteCount += byteCount;
+	m_PeakFrameCount = (std::max)(m_PeakFrameCount, static_cast<uint32_t>(m_Frames.size()));
+}
+
+int64_t InFlightSampleTracker::Release(int64_t time)
+{
+	int64_t latency;
+	{
+		const std::lock_guard<SyncMutex> lock(m_Mutex);
+		if (m_Frames.empty()) {
+			return -1;
+		}
+		const IN_FLIGHT_FRAME frame = m_Frames.front();
+		m_Frames.pop_front();
+		m_ByteCount -= frame.ByteCount;
+		latency = (std::max)(time - frame.SubmitTime, static_cast<int64_t>(0));
+	}
+	m_ReleasedEvent.Set();
+	return latency;
+}
+
+IN_FLIGHT_STATISTICS InFlightSampleTracker::GetStatistics()
+{
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
+	return IN_FLIGHT_STATISTICS{ static_cast<uint32_t>(m_Frames.size()), m_ByteCount, m_ReservedFrameCount, m_PeakFrameCount, m_DroppedFrameCount };
+}
\ No newline at end of file
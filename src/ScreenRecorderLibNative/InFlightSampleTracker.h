@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include "Sync.h"
+
+/// <summary>
+/// What happens to a frame when the encoder already holds the maximum number of frames or bytes.
+/// </summary>
+enum class InFlightFramePolicy {
+	///<summary>The recording waits for the encoder to release a frame, and drops the frame if none is released within the timeout.</summary>
+	Wait,
+	///<summary>The frame is dropped right away.</summary>
+	Drop
+};
+
+struct IN_FLIGHT_STATISTICS {
+	//The number of frames submitted to the encoder and not yet released by it.
+	uint32_t FrameCount;
+	//The size of the frames submitted to the encoder and not yet released by it.
+	uint64_t ByteCount;
+	//The number of frames reserved, which count towards the limits before they are submitted.
+	uint32_t ReservedFrameCount;
+	//The highest number of frames in flight at the same time.
+	uint32_t PeakFrameCount;
+	//The number of frames that were not submitted because the limits were reached.
+	uint64_t DroppedFrameCount;
+};
+
+/// <summary>
+/// Counts the frames and bytes submitted to an asynchronous encoder that it has not released yet, and bounds them.
+/// Encoders release their input in submission order, so a release is matched with the oldest frame in flight, which gives the encode latency of each frame.
+/// Frames are submitted from one thread, and may be released from any thread.
+/// Times are in 100 nanosecond units, and are passed in, so the tracker can be driven by any clock.
+/// </summary>
+class InFlightSampleTracker
+{
+public:
+	InFlightSampleTracker();
+	/// <summary>
+	/// Sets the maximum number of frames and bytes in flight. 0 does not limit them. A single frame larger than the byte limit is accepted when no other frames are in flight.
+	/// </summary>
+	void SetLimits(uint32_t maxFrameCount, uint64_t maxByteCount);
+	/// <summary>
+	/// Checks if a frame of the given size fits within the limits, waiting up to the timeout for frames to be released. A timeout of 0 only checks.
+	/// If it does not fit, the frame is counted as dropped.
+	/// </summary>
+	/// <param name="pCancelEvent">Ends the wait early if set, for example when the recording stops.</param>
+	/// <returns>true if the frame fits, else false.</returns>
+	bool WaitForCapacity(uint64_t byteCount, std::chrono::milliseconds timeout, SyncEvent *pCancelEvent = nullptr);
+	/// <summary>
+	/// Counts a frame towards the limits before it is submitted, for a frame that is held for a while after its capacity is checked, e.g. while it is converted.
+	/// It is either submitted with isReserved set, or its reservation is canceled.
+	/// </summary>
+	void Reserve(uint64_t byteCount);
+	/// <summary>
+	/// Cancels the reservation of a frame that will not be submitted.
+	/// </summary>
+	void CancelReservation(uint64_t byteCount);
+	/// <summary>
+	/// Counts a frame as submitted to the encoder.
+	/// </summary>
+	/// <param name="isReserved">If true, the frame takes the place of the reservation made for it.</param>
+	void Submit(uint64_t byteCount, int64_t time, bool isReserved = false);
+	/// <summary>
+	/// Counts the oldest frame in flight as released by the encoder.
+	/// </summary>
+	/// <returns>The time since the frame was submitted, or -1 if no frames are in flight.</returns>
+	int64_t Release(int64_t time);
+	IN_FLIGHT_STATISTICS GetStatistics();
+private:
+	struct IN_FLIGHT_FRAME {
+		uint64_t ByteCount;
+		int64_t SubmitTime;
+	};
+	bool HasCapacity(uint64_t byteCount);
+	void RemoveReservation(uint64_t byteCount);
+
+	SyncMutex m_Mutex;
+	SyncEvent m_ReleasedEvent;
+	std::deque<IN_FLIGHT_FRAME> m_Frames;
+	uint32_t m_MaxFrameCount;
+	uint64_t m_MaxByteCount;
+	uint64_t m_ByteCount;
+	uint32_t m_ReservedFrameCount;
+	uint64_t m_ReservedByteCount;
+	uint32_t m_PeakFrameCount;
+	uint64_t m_DroppedFrameCount;
+};
\ No newline at end of file
@@ -1,32 +1,358 @@
 #include "Log.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
 #include <mutex>
+#include <thread>
 
-static std::mutex g_Mtx{};
+namespace {
+	void RemoveCrashHandlers();
 
-void _log(PCWSTR format, ...)
-{
-	const std::lock_guard<std::mutex> lock(g_Mtx);
-	wchar_t buffer[LOG_BUFFER_SIZE];
-	va_list args;
-	va_start(args, format);
+	/// <summary>
+	/// Writes log lines to the log file on a background thread, so logging threads never wait for disk I/O or for each other.
+	/// Lines are queued in a bounded lock-free ring, and the writer keeps the file open and writes them in batches.
+	/// If the ring is full, new lines are dropped and counted, and the writer notes how many were lost.
+	/// Each batch is flushed to the OS, and the ring is written out by the crash handlers, so a crash only loses the lines that could not be written before the process died.
+	/// </summary>
+	class AsyncLogWriter
+	{
+	public:
+		AsyncLogWriter() :
+			m_Slots(new SLOT[QUEUE_CAPACITY]),
+			m_EnqueuePos(0),
+			m_DequeuePos(0),
+			m_WrittenPos(0),
+			m_DroppedCount(0),
+			m_HasFile(false),
+			m_IsPathChanged(false),
+			m_IsStopping(false),
+			m_IsWriting(false),
+			m_WakeEvent(CreateEvent(nullptr, FALSE, FALSE, nullptr))
+		{
+			for (size_t i = 0; i < QUEUE_CAPACITY; i++) {
+				m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		~AsyncLogWriter()
+		{
+			RemoveCrashHandlers();
+			m_IsStopping = true;
+			SetEvent(m_WakeEvent);
+			if (m_WriterThread.joinable()) {
+				//At process exit, the writer may already have been terminated, so don't wait indefinitely for it.
+				if (WaitForSingleObject(m_WriterThread.native_handle(), 1000) == WAIT_OBJECT_0) {
+					m_WriterThread.join();
+					WriteQueuedLines();
+				}
+				else {
+					m_WriterThread.detach();
+					return;
+				}
+			}
+			if (m_File.is_open()) {
+				m_File.close();
+			}
+			CloseHandle(m_WakeEvent);
+		}
 
-	vswprintf_s(buffer, LOG_BUFFER_SIZE, format, args);
-	if (!logFilePath.empty()) {
+		bool HasFile()
+		{
+			return m_HasFile.load(std::memory_order_relaxed);
+		}
+
+		void SetFilePath(const std::wstring &path)
+		{
+			{
+				const std::lock_guard<std::mutex> lock(m_PathMutex);
+				m_Path = path;
+				m_IsPathChanged = true;
+				if (!path.empty() && !m_WriterThread.joinable()) {
+					m_WriterThread = std::thread([this] { WriterProc(); });
+				}
+			}
+			m_HasFile = !path.empty();
+			SetEvent(m_WakeEvent);
+		}
+
+		void Enqueue(const wchar_t *line, size_t length)
+		{
+			size_t pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			SLOT *pSlot;
+			for (;;) {
+				pSlot = &m_Slots[pos & (QUEUE_CAPACITY - 1)];
+				const size_t sequence = pSlot->Sequence.load(std::memory_order_acquire);
+				const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+				if (diff == 0) {
+					if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (diff < 0) {
+					m_DroppedCount.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				else {
+					pos = m_EnqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			//The slot strings keep their capacity, so once the ring has cycled, queueing a line does not allocate.
+			pSlot->Line.assign(line, length);
+			pSlot->Sequence.store(pos + 1, std::memory_order_release);
+			if (pos - m_DequeuePos.load(std::memory_order_relaxed) == QUEUE_CAPACITY / 4) {
+				SetEvent(m_WakeEvent);
+			}
+		}
 
-		std::wofstream logFile(logFilePath, std::ios_base::app | std::ios_base::out);
-		if (logFile.is_open())
+		/// <summary>
+		/// Blocks until the lines queued before the call are written to the file, or the timeout elapses.
+		/// </summary>
+		void Flush(std::chrono::milliseconds timeout)
 		{
-			logFile << buffer;
-			logFile.close();
+			if (!m_WriterThread.joinable()) {
+				return;
+			}
+			const size_t target = m_EnqueuePos.load(std::memory_order_acquire);
+			SetEvent(m_WakeEvent);
+			std::unique_lock<std::mutex> lock(m_FlushMutex);
+			m_FlushCondition.wait_for(lock, timeout, [&] { return m_WrittenPos.load(std::memory_order_acquire) >= target; });
+		}
+
+		/// <summary>
+		/// Writes the queued lines to the file on the calling thread, for when the process is about to die and the writer thread may not run again.
+		/// Gives up if the writer thread does not finish its batch within the timeout, or if it is the calling thread, as it may have crashed while writing.
+		/// </summary>
+		void WriteQueuedLinesNow(std::chrono::milliseconds timeout)
+		{
+			if (m_WriterThread.joinable() && m_WriterThread.get_id() == std::this_thread::get_id() && m_IsWriting.load()) {
+				return;
+			}
+			const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+			while (m_IsWriting.exchange(true, std::memory_order_acquire)) {
+				if (std::chrono::steady_clock::now() >= deadline) {
+					return;
+				}
+				Sleep(1);
+			}
+			WriteQueuedLines();
+			m_IsWriting.store(false, std::memory_order_release);
+		}
+
+	private:
+		struct SLOT {
+			std::atomic<size_t> Sequence;
+			std::wstring Line;
+		};
+		//Must be a power of two.
+		static const size_t QUEUE_CAPACITY = 2048;
+		static const DWORD WRITE_INTERVAL_MILLIS = 50;
+
+		std::unique_ptr<SLOT[]> m_Slots;
+		std::atomic<size_t> m_EnqueuePos;
+		std::atomic<size_t> m_DequeuePos;
+		std::atomic<size_t> m_WrittenPos;
+		std::atomic<size_t> m_DroppedCount;
+		std::atomic<bool> m_HasFile;
+		std::mutex m_PathMutex;
+		std::wstring m_Path;
+		bool m_IsPathChanged;
+		std::atomic<bool> m_IsStopping;
+		//Set while a thread writes a batch, so the crash handlers do not write at the same time as the writer thread.
+		std::atomic<bool> m_IsWriting;
+		HANDLE m_WakeEvent;
+		std::thread m_WriterThread;
+		std::mutex m_FlushMutex;
+		std::condition_variable m_FlushCondition;
+		std::wofstream m_File;
+		std::wstring m_Batch;
+
+		void WriterProc()
+		{
+			while (!m_IsStopping) {
+				WaitForSingleObject(m_WakeEvent, WRITE_INTERVAL_MILLIS);
+				//A crash handler writing the ring is never interrupted, as the process ends right after it.
+				if (!m_IsWriting.exchange(true, std::memory_order_acquire)) {
+					WriteQueuedLines();
+					m_IsWriting.store(false, std::memory_order_release);
+				}
+			}
+		}
+
+		void OpenFileIfChanged()
+		{
+			const std::lock_guard<std::mutex> lock(m_PathMutex);
+			if (!m_IsPathChanged) {
+				return;
+			}
+			m_IsPathChanged = false;
+			if (m_File.is_open()) {
+				m_File.close();
+			}
+			if (!m_Path.empty()) {
+				m_File.open(m_Path, std::ios_base::app | std::ios_base::out);
+				if (!m_File.is_open()) {
+					OutputDebugStringW(L"Error opening log file for write");
+				}
+			}
+		}
+
+		/// <summary>
+		/// Writes all queued lines to the file in one batch. Only called from one thread at a time.
+		/// </summary>
+		void WriteQueuedLines()
+		{
+			OpenFileIfChanged();
+			size_t pos = m_DequeuePos.load(std::memory_order_relaxed);
+			const size_t startPos = pos;
+			m_Batch.clear();
+			for (;;) {
+				SLOT &slot = m_Slots[pos & (QUEUE_CAPACITY - 1)];
+				if (slot.Sequence.load(std::memory_order_acquire) != pos + 1) {
+					break;
+				}
+				m_Batch.append(slot.Line);
+				slot.Sequence.store(pos + QUEUE_CAPACITY, std::memory_order_release);
+				pos++;
+				m_DequeuePos.store(pos, std::memory_order_relaxed);
+			}
+			const size_t droppedCount = m_DroppedCount.exchange(0, std::memory_order_relaxed);
+			if (droppedCount > 0) {
+				m_Batch.append(GetTimestamp() + L" [WARN]  " + std::to_wstring(droppedCount) + L" log lines were dropped because the log queue was full\n");
+			}
+			if (!m_Batch.empty()) {
+				if (m_File.is_open()) {
+					m_File << m_Batch;
+					m_File.flush();
+				}
+				else {
+					OutputDebugStringW(m_Batch.c_str());
+				}
+			}
+			if (pos != startPos) {
+				{
+					const std::lock_guard<std::mutex> lock(m_FlushMutex);
+					m_WrittenPos.store(pos, std::memory_order_release);
+				}
+				m_FlushCondition.notify_all();
+			}
+		}
+	};
+
+	AsyncLogWriter &GetLogWriter()
+	{
+		static AsyncLogWriter writer;
+		return writer;
+	}
+
+	//How long a crash handler waits for the writer thread to finish a batch, before it gives up on writing the queued lines.
+	const std::chrono::milliseconds CRASH_WRITE_TIMEOUT(500);
+
+	std::mutex g_CrashHandlersMutex;
+	bool g_AreCrashHandlersInstalled = false;
+	LPTOP_LEVEL_EXCEPTION_FILTER g_PreviousExceptionFilter = nullptr;
+	std::terminate_handler g_PreviousTerminateHandler = nullptr;
+
+	/// <summary>
+	/// Queues a last line about the crash, and writes the ring to the log file on the crashing thread.
+	/// This is best effort, as the process may be in a state where writing fails, e.g. if the heap is corrupted.
+	/// </summary>
+	void WriteLogOnCrash(const wchar_t *reason)
+	{
+		AsyncLogWriter &writer = GetLogWriter();
+		wchar_t line[LOG_BUFFER_SIZE];
+		int length = swprintf_s(line, L"%s [ERROR] %s, writing the queued log lines\n", GetTimestamp().c_str(), reason);
+		if (length > 0) {
+			writer.Enqueue(line, static_cast<size_t>(length));
 		}
-		else {
-			OutputDebugStringW(L"Error opening log file for write");
+		writer.WriteQueuedLinesNow(CRASH_WRITE_TIMEOUT);
+	}
+
+	LONG WINAPI WriteLogOnUnhandledException(EXCEPTION_POINTERS *pExceptionInfo)
+	{
+		wchar_t reason[64];
+		swprintf_s(reason, L"Unhandled exception 0x%08lX", pExceptionInfo && pExceptionInfo->ExceptionRecord ? pExceptionInfo->ExceptionRecord->ExceptionCode : 0ul);
+		WriteLogOnCrash(reason);
+		//The host application may have its own filter, e.g. to write a crash dump, which decides what happens next.
+		return g_PreviousExceptionFilter ? g_PreviousExceptionFilter(pExceptionInfo) : EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	void WriteLogOnTerminate()
+	{
+		WriteLogOnCrash(L"std::terminate was called");
+		if (g_PreviousTerminateHandler) {
+			g_PreviousTerminateHandler();
 		}
+		std::abort();
+	}
+
+	/// <summary>
+	/// Installs handlers that write the queued log lines when the process crashes, chaining to the handlers they replace. Called when a log file is first set.
+	/// </summary>
+	void InstallCrashHandlers()
+	{
+		const std::lock_guard<std::mutex> lock(g_CrashHandlersMutex);
+		if (g_AreCrashHandlersInstalled) {
+			return;
+		}
+		g_PreviousExceptionFilter = SetUnhandledExceptionFilter(WriteLogOnUnhandledException);
+		g_PreviousTerminateHandler = std::set_terminate(WriteLogOnTerminate);
+		g_AreCrashHandlersInstalled = true;
+	}
+
+	/// <summary>
+	/// Restores the handlers replaced by InstallCrashHandlers, unless they were replaced again since, so they are not called once the log writer is destroyed.
+	/// </summary>
+	void RemoveCrashHandlers()
+	{
+		const std::lock_guard<std::mutex> lock(g_CrashHandlersMutex);
+		if (!g_AreCrashHandlersInstalled) {
+			return;
+		}
+		LPTOP_LEVEL_EXCEPTION_FILTER currentFilter = SetUnhandledExceptionFilter(g_PreviousExceptionFilter);
+		if (currentFilter != WriteLogOnUnhandledException) {
+			SetUnhandledExceptionFilter(currentFilter);
+		}
+		std::terminate_handler currentHandler = std::set_terminate(g_PreviousTerminateHandler);
+		if (currentHandler != WriteLogOnTerminate) {
+			std::set_terminate(currentHandler);
+		}
+		g_AreCrashHandlersInstalled = false;
+	}
+}
+
+void _log(PCWSTR format, ...)
+{
+	//Each thread formats into its own buffer, so logging threads only contend on the queue.
+	thread_local wchar_t buffer[LOG_BUFFER_SIZE];
+	va_list args;
+	va_start(args, format);
+	int length = vswprintf_s(buffer, LOG_BUFFER_SIZE, format, args);
+	va_end(args);
+	if (length < 0) {
+		return;
+	}
+	AsyncLogWriter &writer = GetLogWriter();
+	if (writer.HasFile()) {
+		writer.Enqueue(buffer, static_cast<size_t>(length));
 	}
 	else {
 		OutputDebugStringW(buffer);
 	}
-	va_end(args);
+}
+
+void SetLogFile(const std::wstring &path)
+{
+	GetLogWriter().SetFilePath(path);
+	if (!path.empty()) {
+		InstallCrashHandlers();
+	}
+}
+
+void FlushLog()
+{
+	GetLogWriter().Flush(std::chrono::milliseconds(1000));
 }
 
 std::wstring GetTimestamp() {
@@ -36,9 +362,9 @@ std::wstring GetTimestamp() {
 	tm localTime;
 	localtime_s(&localTime, &nowAsTimeT);
 	const auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
-	std::wstringstream nowSs;
-	nowSs
-		<< std::put_time(&localTime, L"%Y-%m-%d %H:%M:%S")
-		<< '.' << std::setfill(L'0') << std::setw(3) << nowMs.count();
-	return nowSs.str();
+	wchar_t timestamp[32];
+	swprintf_s(timestamp, L"%04d-%02d-%02d %02d:%02d:%02d.%03d",
+		localTime.tm_year + 1900, localTime.tm_mon + 1, localTime.tm_mday,
+		localTime.tm_hour, localTime.tm_min, localTime.tm_sec, static_cast<int>(nowMs.count()));
+	return timestamp;
 }
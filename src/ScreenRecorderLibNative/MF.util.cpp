@@ -320,6 +320,20 @@ HRESULT GetFrameRate(_In_ IMFMediaType *pMediaType, _Out_ double *pFramerate)
 	return S_OK;
 }
 
+HRESULT GetFrameRate(_In_ IMFMediaType *pMediaType, _Out_ MFRatio *pFramerate)
+{
+	UINT32 numerator;
+	UINT32 denominator;
+	RETURN_ON_BAD_HR(MFGetAttributeRatio(
+		pMediaType,
+		MF_MT_FRAME_RATE,
+		&numerator,
+		&denominator
+	));
+	*pFramerate = MFRatio{ numerator, denominator };
+	return S_OK;
+}
+
 //Calculates the default stride based on the format and size of the frames
 HRESULT GetDefaultStride(_In_ IMFMediaType *type, _Out_ LONG *stride)
 {
@@ -362,3 +376,22 @@ bool IsVideoInfo2(_In_ IMFMediaType *pType)
 	}
 	return false;
 }
+
+HRESULT ReadEncodedPacket(_In_ IMFSample *pSample, _In_ PacketStream stream, _Inout_ ENCODED_PACKET *pPacket)
+{
+	pPacket->Stream = stream;
+	RETURN_ON_BAD_HR(pSample->GetSampleTime(&pPacket->Timestamp));
+	if (FAILED(pSample->GetSampleDuration(&pPacket->Duration))) {
+		pPacket->Duration = 0;
+	}
+	pPacket->IsKeyFrame = stream == PacketStream::Video && MFGetAttributeUINT32(pSample, MFSampleExtension_CleanPoint, FALSE);
+
+	CComPtr<IMFMediaBuffer> pMediaBuffer = nullptr;
+	BYTE *pData = nullptr;
+	DWORD length = 0;
+	RETURN_ON_BAD_HR(pSample->ConvertToContiguousBuffer(&pMediaBuffer));
+	RETURN_ON_BAD_HR(pMediaBuffer->Lock(&pData, nullptr, &length));
+	pPacket->Data.assign(pData, pData + length);
+	pMediaBuffer->Unlock();
+	return S_OK;
+}
@@ -7,6 +7,7 @@
 #include <map>
 #include <string>
 #include <mfidl.h>
+#include "Bitstream.h"
 
 HRESULT FindDecoderEx(const GUID &subtype, BOOL bAudio, IMFActivate **ppDecoder);
 HRESULT FindVideoDecoder(GUID *inputSubtype, GUID *outputSubtype, BOOL bAllowAsync, BOOL bAllowHardware, BOOL bAllowTranscode, IMFActivate **ppDecoder);
@@ -15,6 +16,11 @@ HRESULT EnumVideoCaptureDevices(_Out_ std::vector<IMFActivate *> *pDevices);
 HRESULT CopyMediaType(_In_ IMFMediaType *pType, _Outptr_ IMFMediaType **ppType);
 HRESULT EnumerateCaptureFormats(_In_ IMFMediaSource *pSource, _Out_ std::vector<IMFMediaType*> *pMediaTypes);
 HRESULT GetFrameRate(_In_ IMFMediaType *pMediaType, _Out_ double *pFramerate);
+HRESULT GetFrameRate(_In_ IMFMediaType *pMediaType, _Out_ MFRatio *pFramerate);
 HRESULT GetFrameSize(_In_ IMFAttributes *pMediaType, _Out_ SIZE *pFrameSize);
 HRESULT GetDefaultStride(_In_ IMFMediaType *pType, _Out_ LONG *plStride);
-bool IsVideoInfo2(_In_ IMFMediaType *pType);
\ No newline at end of file
+bool IsVideoInfo2(_In_ IMFMediaType *pType);
+/// <summary>
+/// Copies an encoded sample to a packet, with its timestamp, duration and key frame flag. The data replaces the contents of the packet buffer, so a buffer with enough capacity is reused.
+/// </summary>
+HRESULT ReadEncodedPacket(_In_ IMFSample *pSample, _In_ PacketStream stream, _Inout_ ENCODED_PACKET *pPacket);
\ No newline at end of file
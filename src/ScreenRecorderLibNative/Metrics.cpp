@@ -0,0 +1,133 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+#include <intrin.h>
+#endif
+
+namespace {
+	int GetHighestBit(uint64_t value) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return static_cast<int>(index);
+#elif defined(__GNUC__)
+		return 63 - __builtin_clzll(value);
+#else
+		int bit = 0;
+		for (int shift = 32; shift > 0; shift /= 2) {
+			if (value >> shift) {
+				value >>= shift;
+				bit += shift;
+			}
+		}
+		return bit;
+#endif
+	}
+}
+
+MetricHistogram::MetricHistogram() :
+	m_Buckets(new std::atomic<uint64_t>[BUCKET_COUNT]()),
+	m_Count(0),
+	m_Sum(0),
+	m_Min(UINT64_MAX),
+	m_Max(0)
+{
+}
+
+size_t MetricHistogram::GetBucketIndex(uint64_t value)
+{
+	if (value < 2 * SUB_BUCKET_COUNT) {
+		return static_cast<size_t>(value);
+	}
+	const int magnitude = GetHighestBit(value) - SUB_BUCKET_BITS;
+	return static_cast<size_t>(magnitude * SUB_BUCKET_COUNT + (value >> magnitude));
+}
+
+uint64_t MetricHistogram::GetBucketUpperBound(size_t index)
+{
+	if (index < 2 * SUB_BUCKET_COUNT) {
+		return index;
+	}
+	const int magnitude = static_cast<int>(index / SUB_BUCKET_COUNT) - 1;
+	const uint64_t subBucket = index - magnitude * SUB_BUCKET_COUNT;
+	return (subBucket << magnitude) + ((1ull << magnitude) - 1);
+}
+
+void MetricHistogram::Record(uint64_t value)
+{
+	m_Buckets[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	m_Count.fetch_add(1, std::memory_order_relaxed);
+	m_Sum.fetch_add(value, std::memory_order_relaxed);
+	uint64_t minValue = m_Min.load(std::memory_order_relaxed);
+	while (value < minValue && !m_Min.compare_exchange_weak(minValue, value, std::memory_order_relaxed)) {}
+	uint64_t maxValue = m_Max.load(std::memory_order_relaxed);
+	while (value > maxValue && !m_Max.compare_exchange_weak(maxValue, value, std::memory_order_relaxed)) {}
+}
+
+METRIC_HISTOGRAM_VALUE MetricHistogram::GetValue() const
+{
+	METRIC_HISTOGRAM_VALUE result{};
+	std::vector<uint64_t> buckets(BUCKET_COUNT);
+	uint64_t count = 0;
+	//The percentiles are based on the bucket counts alone, so they are consistent even if values are recorded while reading.
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		buckets[i] = m_Buckets[i].load(std::memory_order_relaxed);
+		count += buckets[i];
+	}
+	if (count == 0) {
+		return result;
+	}
+	result.Count = count;
+	result.Min = m_Min.load(std::memory_order_relaxed);
+	result.Max = m_Max.load(std::memory_order_relaxed);
+	result.Mean = static_cast<double>(m_Sum.load(std::memory_order_relaxed)) / (std::max)(count, m_Count.load(std::memory_order_relaxed));
+
+	const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	uint64_t *pResults[] = { &result.P50, &result.P90, &result.P99, &result.P999 };
+	size_t next = 0;
+	uint64_t cumulativeCount = 0;
+	for (size_t i = 0; i < BUCKET_COUNT && next < 4; i++) {
+		cumulativeCount += buckets[i];
+		while (next < 4 && cumulativeCount >= (std::max)(1ull, static_cast<unsigned long long>(std::ceil(percentiles[next] * count)))) {
+			*pResults[next] = (std::min)((std::max)(GetBucketUpperBound(i), result.Min), result.Max);
+			next++;
+		}
+	}
+	return result;
+}
+
+void MetricHistogram::Reset()
+{
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		m_Buckets[i].store(0, std::memory_order_relaxed);
+	}
+	m_Count.store(0, std::memory_order_relaxed);
+	m_Sum.store(0, std::memory_order_relaxed);
+	m_Min.store(UINT64_MAX, std::memory_order_relaxed);
+	m_Max.store(0, std::memory_order_relaxed);
+}
+
+METRICS_SNAPSHOT MetricsRegistry::GetSnapshot() const
+{
+	METRICS_SNAPSHOT snapshot{};
+	m_Counters.ForEach([&](const std::string &name, const MetricCounter &counter) {
+		snapshot.Counters.push_back({ name, counter.GetValue() });
+	});
+	m_Gauges.ForEach([&](const std::string &name, const MetricGauge &gauge) {
+		snapshot.Gauges.push_back({ name, gauge.GetValue(), gauge.GetMaxValue() });
+	});
+	m_Histograms.ForEach([&](const std::string &name, const MetricHistogram &histogram) {
+		METRIC_HISTOGRAM_VALUE value = histogram.GetValue();
+		value.Name = name;
+		snapshot.Histograms.push_back(value);
+	});
+	return snapshot;
+}
+
+void MetricsRegistry::Reset()
+{
+	m_Counters.ForEach([](const std::string &, MetricCounter &counter) { counter.Reset(); });
+	m_Gauges.ForEach([](const std::string &, MetricGauge &gauge) { gauge.Reset(); });
+	m_Histograms.ForEach([](const std::string &, MetricHistogram &histogram) { histogram.Reset(); });
+}
\ No newline at end of file
@@ -0,0 +1,193 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct METRIC_COUNTER_VALUE {
+	std::string Name;
+	uint64_t Value;
+};
+
+struct METRIC_GAUGE_VALUE {
+	std::string Name;
+	int64_t Value;
+	//The highest value the gauge has had since it was last reset.
+	int64_t MaxValue;
+};
+
+struct METRIC_HISTOGRAM_VALUE {
+	std::string Name;
+	uint64_t Count;
+	uint64_t Min;
+	uint64_t Max;
+	double Mean;
+	uint64_t P50;
+	uint64_t P90;
+	uint64_t P99;
+	uint64_t P999;
+};
+
+struct METRICS_SNAPSHOT {
+	std::vector<METRIC_COUNTER_VALUE> Counters;
+	std::vector<METRIC_GAUGE_VALUE> Gauges;
+	std::vector<METRIC_HISTOGRAM_VALUE> Histograms;
+};
+
+class MetricCounter
+{
+public:
+	MetricCounter() : m_Value(0) {}
+	void Increment(uint64_t value = 1) { m_Value.fetch_add(value, std::memory_order_relaxed); }
+	uint64_t GetValue() const { return m_Value.load(std::memory_order_relaxed); }
+	void Reset() { m_Value.store(0, std::memory_order_relaxed); }
+private:
+	std::atomic<uint64_t> m_Value;
+};
+
+class MetricGauge
+{
+public:
+	MetricGauge() : m_Value(0), m_MaxValue(0) {}
+	void Set(int64_t value) {
+		m_Value.store(value, std::memory_order_relaxed);
+		UpdateMax(value);
+	}
+	void Add(int64_t delta) { UpdateMax(m_Value.fetch_add(delta, std::memory_order_relaxed) + delta); }
+	int64_t GetValue() const { return m_Value.load(std::memory_order_relaxed); }
+	int64_t GetMaxValue() const { return m_MaxValue.load(std::memory_order_relaxed); }
+	void Reset() {
+		m_Value.store(0, std::memory_order_relaxed);
+		m_MaxValue.store(0, std::memory_order_relaxed);
+	}
+private:
+	void UpdateMax(int64_t value) {
+		int64_t maxValue = m_MaxValue.load(std::memory_order_relaxed);
+		while (value > maxValue && !m_MaxValue.compare_exchange_weak(maxValue, value, std::memory_order_relaxed)) {}
+	}
+	std::atomic<int64_t> m_Value;
+	std::atomic<int64_t> m_MaxValue;
+};
+
+/// <summary>
+/// A histogram with log-linear buckets, as in HdrHistogram. Values below 2 * SUB_BUCKET_COUNT are counted exactly, and every power of two above that
+/// is split into SUB_BUCKET_COUNT linear buckets, so percentiles are accurate to about 3% over the whole 64 bit range.
+/// </summary>
+class MetricHistogram
+{
+public:
+	MetricHistogram();
+	void Record(uint64_t value);
+	/// <summary>
+	/// Reads the histogram without blocking writers. Values recorded during the read may be partly included.
+	/// </summary>
+	METRIC_HISTOGRAM_VALUE GetValue() const;
+	void Reset();
+
+	static const int SUB_BUCKET_BITS = 5;
+	static const uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+	static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+	static size_t GetBucketIndex(uint64_t value);
+	/// <summary>
+	/// The highest value counted in a bucket.
+	/// </summary>
+	static uint64_t GetBucketUpperBound(size_t index);
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> m_Buckets;
+	std::atomic<uint64_t> m_Count;
+	std::atomic<uint64_t> m_Sum;
+	std::atomic<uint64_t> m_Min;
+	std::atomic<uint64_t> m_Max;
+};
+
+/// <summary>
+/// Named counters, gauges and histograms. Metrics are looked up by name once, typically when a component is initialized, and the returned pointer is then
+/// updated lock free on the hot path. Metrics are never removed, so the pointers stay valid for the lifetime of the registry.
+/// Snapshots are read lock free as well, so they can be polled while recording.
+/// </summary>
+class MetricsRegistry
+{
+public:
+	MetricCounter *GetCounter(const std::string &name) { return m_Counters.Get(name); }
+	MetricGauge *GetGauge(const std::string &name) { return m_Gauges.Get(name); }
+	/// <summary>
+	/// Gets a histogram. By convention, durations are recorded in microseconds, and the name ends with "_us".
+	/// </summary>
+	MetricHistogram *GetHistogram(const std::string &name) { return m_Histograms.Get(name); }
+	METRICS_SNAPSHOT GetSnapshot() const;
+	/// <summary>
+	/// Sets all metrics to zero, e.g. at the start of a recording.
+	/// </summary>
+	void Reset();
+
+	static const size_t MAX_METRICS_PER_TYPE = 128;
+private:
+	template<typename T>
+	class MetricList {
+	public:
+		MetricList() : m_Count(0) {}
+		T *Get(const std::string &name) {
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			const size_t count = m_Count.load(std::memory_order_relaxed);
+			for (size_t i = 0; i < count; i++) {
+				if (m_Entries[i]->Name == name) {
+					return &m_Entries[i]->Metric;
+				}
+			}
+			if (count == MAX_METRICS_PER_TYPE) {
+				//Metrics past the limit still work, but are left out of snapshots.
+				return &m_Overflow;
+			}
+			m_Entries[count] = std::make_unique<ENTRY>();
+			m_Entries[count]->Name = name;
+			m_Count.store(count + 1, std::memory_order_release);
+			return &m_Entries[count]->Metric;
+		}
+		template<typename F>
+		void ForEach(F func) const {
+			const size_t count = m_Count.load(std::memory_order_acquire);
+			for (size_t i = 0; i < count; i++) {
+				func(m_Entries[i]->Name, m_Entries[i]->Metric);
+			}
+		}
+	private:
+		struct ENTRY {
+			std::string Name;
+			T Metric;
+		};
+		std::mutex m_Mutex;
+		//Entries are only appended, and published by incrementing the count.
+		std::unique_ptr<ENTRY> m_Entries[MAX_METRICS_PER_TYPE];
+		std::atomic<size_t> m_Count;
+		T m_Overflow;
+	};
+
+	MetricList<MetricCounter> m_Counters;
+	MetricList<MetricGauge> m_Gauges;
+	MetricList<MetricHistogram> m_Histograms;
+};
+
+/// <summary>
+/// Records the microseconds from construction until the end of the scope to a histogram. Does nothing if the histogram is null.
+/// </summary>
+struct MeasureLatency {
+private:
+	MetricHistogram *m_Histogram;
+	std::chrono::steady_clock::time_point m_Start;
+public:
+	MeasureLatency(MetricHistogram *pHistogram) :
+		m_Histogram(pHistogram),
+		m_Start(pHistogram ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{})
+	{
+	}
+	~MeasureLatency() {
+		if (m_Histogram) {
+			m_Histogram->Record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_Start).count());
+		}
+	}
+	MeasureLatency(const MeasureLatency &) = delete;
+	MeasureLatency &operator=(const MeasureLatency &) = delete;
+};
\ No newline at end of file
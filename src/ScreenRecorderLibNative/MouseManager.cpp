@@ -71,9 +71,35 @@ MouseManager::~MouseManager()
 	DeleteCriticalSection(&m_CriticalSection);
 }
 
-HRESULT MouseManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<MOUSE_OPTIONS> &pOptions)
+HRESULT MouseManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<MOUSE_OPTIONS> &pOptions, _In_ CompositorBackend backend)
 {
 	CleanDX();
+	m_TextureManager = make_unique<TextureManager>();
+	HRESULT hr = m_TextureManager->Initialize(pDeviceContext, pDevice, backend);
+	RETURN_ON_BAD_HR(hr);
+	if (m_TextureManager->GetCompositorBackend() == CompositorBackend::Direct3D) {
+		hr = InitPointerShaderResources(pDevice);
+		if (FAILED(hr)) {
+			_com_error err(hr);
+			LOG_WARN(L"Failed to initialize mouse pointer shaders, falling back to software compositor: %ls", err.ErrorMessage());
+			CleanDX();
+			RETURN_ON_BAD_HR(hr = m_TextureManager->Initialize(pDeviceContext, pDevice, CompositorBackend::Software));
+		}
+	}
+	hr = InitMouseClickTexture(pDeviceContext, pDevice);
+	m_Device = pDevice;
+	m_DeviceContext = pDeviceContext;
+	m_MouseOptions = pOptions;
+
+	StopMouseClickDetection();
+	CloseHandle(m_StopPollingTaskEvent);
+	m_StopPollingTaskEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+	InitializeMouseClickDetection();
+	return hr;
+}
+
+HRESULT MouseManager::InitPointerShaderResources(_In_ ID3D11Device *pDevice)
+{
 	// Create the sample state
 	D3D11_SAMPLER_DESC SampDesc;
 	RtlZeroMemory(&SampDesc, sizeof(SampDesc));
@@ -103,20 +129,8 @@ HRESULT MouseManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_
 	hr = pDevice->CreateBlendState(&BlendStateDesc, &m_BlendState);
 	RETURN_ON_BAD_HR(hr);
 
-	m_TextureManager = make_unique<TextureManager>();
-	RETURN_ON_BAD_HR(hr = m_TextureManager->Initialize(pDeviceContext, pDevice));
 	// Initialize shaders
-	hr = InitShaders(pDevice, &m_PixelShader, &m_VertexShader, &m_InputLayout);
-	hr = InitMouseClickTexture(pDeviceContext, pDevice);
-	m_Device = pDevice;
-	m_DeviceContext = pDeviceContext;
-	m_MouseOptions = pOptions;
-
-	StopMouseClickDetection();
-	CloseHandle(m_StopPollingTaskEvent);
-	m_StopPollingTaskEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-	InitializeMouseClickDetection();
-	return hr;
+	return InitShaders(pDevice, &m_PixelShader, &m_VertexShader, &m_InputLayout);
 }
 
 void MouseManager::InitializeMouseClickDetection()
@@ -234,6 +248,7 @@ void MouseManager::GetPointerPosition(_In_ PTR_INFO *pPtrInfo, DXGI_MODE_ROTATIO
 
 HRESULT MouseManager::ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo)
 {
+	TRACE_SCOPE("DrawMousePointer");
 	HRESULT hr = S_FALSE;
 	EnterCriticalSection(&m_CriticalSection);
 	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
@@ -330,6 +345,9 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 {
 	if (!pPtrInfo || !pPtrInfo->Visible || pPtrInfo->PtrShapeBuffer == nullptr)
 		return S_FALSE;
+	if (m_TextureManager->GetCompositorBackend() == CompositorBackend::Software) {
+		return DrawMousePointerWithCPU(pPtrInfo, pBgTexture, rotation);
+	}
 	// Vars to be used
 	ID3D11Texture2D *MouseTex = nullptr;
 	ID3D11ShaderResourceView *ShaderRes = nullptr;
@@ -573,6 +591,79 @@ HRESULT MouseManager::DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Te
 	return hr;
 }
 
+//
+// Draw mouse provided in buffer to backbuffer, using the software compositor
+//
+HRESULT MouseManager::DrawMousePointerWithCPU(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Texture2D *pBgTexture, DXGI_MODE_ROTATION rotation)
+{
+	D3D11_TEXTURE2D_DESC desktopDesc = { 0 };
+	pBgTexture->GetDesc(&desktopDesc);
+
+	SOFTWARE_POINTER_SHAPE shape;
+	shape.Buffer = pPtrInfo->PtrShapeBuffer;
+	shape.Width = static_cast<int32_t>(pPtrInfo->ShapeInfo.Width);
+	shape.Height = static_cast<int32_t>(pPtrInfo->ShapeInfo.Height);
+	shape.Pitch = static_cast<int32_t>(pPtrInfo->ShapeInfo.Pitch);
+	switch (pPtrInfo->ShapeInfo.Type)
+	{
+		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR:
+			shape.Type = SoftwarePointerType::Color;
+			break;
+		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MONOCHROME:
+			shape.Type = SoftwarePointerType::Monochrome;
+			shape.Height = shape.Height / 2;
+			break;
+		case DXGI_OUTDUPL_POINTER_SHAPE_TYPE_MASKED_COLOR:
+			shape.Type = SoftwarePointerType::MaskedColor;
+			break;
+		default:
+			LOG_ERROR("Unrecognized mouse pointer type");
+			return E_FAIL;
+	}
+	if (shape.Width <= 0 || shape.Height <= 0) {
+		return S_FALSE;
+	}
+	INT ptrLeft = 0;
+	INT ptrTop = 0;
+	GetPointerPosition(pPtrInfo, rotation, desktopDesc.Width, desktopDesc.Height, &ptrLeft, &ptrTop);
+	RECT shapeRect{ ptrLeft, ptrTop, ptrLeft + shape.Width, ptrTop + shape.Height };
+	RECT desktopRect{ 0, 0, (LONG)desktopDesc.Width, (LONG)desktopDesc.Height };
+	RECT visibleRect;
+	if (!IntersectRect(&visibleRect, &shapeRect, &desktopRect)) {
+		return S_FALSE;
+	}
+
+	// Monochrome and masked color pointers are combined with the pixels underneath them, so copy those into a pointer sized buffer.
+	auto bufSize = shape.Width * shape.Height * BPP;
+	if ((int)_InitBuffer.size() < bufSize)
+	{
+		_InitBuffer.resize(bufSize);
+		_DesktopBuffer.resize(bufSize);
+	}
+	BGRA_SURFACE background{ &_DesktopBuffer[0], shape.Width * BPP, shape.Width, shape.Height };
+	BGRA_SURFACE pointer{ &_InitBuffer[0], shape.Width * BPP, shape.Width, shape.Height };
+	m_SoftwareCompositor.Fill(background, 0, 0, shape.Width, shape.Height, OPAQUE_BLACK);
+	if (shape.Type != SoftwarePointerType::Color) {
+		std::vector<BYTE> visibleBuffer;
+		BGRA_SURFACE visibleBackground;
+		RETURN_ON_BAD_HR(m_TextureManager->ReadTextureToBuffer(pBgTexture, visibleRect, &visibleBuffer, &visibleBackground));
+		m_SoftwareCompositor.Blit(visibleBackground, 0, 0, visibleBackground.Width, visibleBackground.Height, background, visibleRect.left - ptrLeft, visibleRect.top - ptrTop);
+	}
+	if (!m_SoftwareCompositor.RenderPointerShape(shape, background, pointer)) {
+		return E_INVALIDARG;
+	}
+	if (rotation == DXGI_MODE_ROTATION_ROTATE90 || rotation == DXGI_MODE_ROTATION_ROTATE180 || rotation == DXGI_MODE_ROTATION_ROTATE270) {
+		bool isSwapped = rotation != DXGI_MODE_ROTATION_ROTATE180;
+		BGRA_SURFACE rotated{ &_DesktopBuffer[0], (isSwapped ? shape.Height : shape.Width) * BPP, isSwapped ? shape.Height : shape.Width, isSwapped ? shape.Width : shape.Height };
+		SoftwareRotation softwareRotation = rotation == DXGI_MODE_ROTATION_ROTATE90 ? SoftwareRotation::Rotate90 : rotation == DXGI_MODE_ROTATION_ROTATE180 ? SoftwareRotation::Rotate180 : SoftwareRotation::Rotate270;
+		m_SoftwareCompositor.Rotate(pointer, rotated, softwareRotation);
+		pointer = rotated;
+	}
+	LONG scaledWidth = static_cast<LONG>(round(pointer.Width * pPtrInfo->Scale.cx));
+	LONG scaledHeight = static_cast<LONG>(round(pointer.Height * pPtrInfo->Scale.cy));
+	return m_TextureManager->DrawBuffer(pBgTexture, pointer, RECT{ ptrLeft, ptrTop, ptrLeft + scaledWidth, ptrTop + scaledHeight });
+}
+
 //
 // Process both masked and monochrome pointers
 //
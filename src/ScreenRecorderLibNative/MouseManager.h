@@ -14,7 +14,7 @@ public:
 	MouseManager();
 	~MouseManager();
 
-	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<MOUSE_OPTIONS> &pOptions);
+	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<MOUSE_OPTIONS> &pOptions, _In_ CompositorBackend backend = CompositorBackend::Direct3D);
 	void InitializeMouseClickDetection();
 	void StopMouseClickDetection();
 	HRESULT ProcessMousePointer(_In_ ID3D11Texture2D *pFrame, _In_ PTR_INFO *pPtrInfo);
@@ -23,6 +23,7 @@ public:
 	void CleanDX();
 protected:
 	HRESULT DrawMousePointer(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Texture2D *pBbgTexture, DXGI_MODE_ROTATION rotation);
+	HRESULT DrawMousePointerWithCPU(_In_ PTR_INFO *pPtrInfo, _Inout_ ID3D11Texture2D *pBgTexture, DXGI_MODE_ROTATION rotation);
 	HRESULT DrawMouseClick(_In_ PTR_INFO *pPtrInfo, _In_ ID3D11Texture2D *pBgTexture, std::string colorStr, float radius, DXGI_MODE_ROTATION rotation);
 private:
 	static const UINT TRANSPARENT_WHITE = 0x00FFFFFF;
@@ -40,6 +41,7 @@ private:
 	ATL::CComPtr<ID2D1Factory> m_D2DFactory;
 
 	std::unique_ptr<TextureManager> m_TextureManager;
+	SoftwareCompositor m_SoftwareCompositor;
 	std::shared_ptr<MOUSE_OPTIONS> m_MouseOptions;
 	ID3D11DeviceContext *m_DeviceContext;
 	ID3D11Device *m_Device;
@@ -57,6 +59,7 @@ private:
 	void GetPointerPosition(_In_ PTR_INFO *pPtrInfo, DXGI_MODE_ROTATION rotation, int desktopWidth, int desktopHeight, _Out_ INT *PtrLeft, _Out_ INT *PtrTop);
 	HRESULT ProcessMonoMask(_In_ ID3D11Texture2D *pBgTexture, _In_ DXGI_MODE_ROTATION rotation, _In_ bool IsMono, _Inout_ PTR_INFO *PtrInfo, _Out_ INT *PtrWidth, _Out_ INT *PtrHeight, _Out_ INT *PtrLeft, _Out_ INT *PtrTop, _Outptr_result_bytebuffer_(*PtrHeight **PtrWidth *BPP) BYTE **pInitBuffer);
 
+	HRESULT InitPointerShaderResources(_In_ ID3D11Device *pDevice);
 	HRESULT InitMouseClickTexture(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice);
 	HRESULT ResizeShapeBuffer(_Inout_ PTR_INFO *pPtrInfo, _In_ int bufferSize);
 };
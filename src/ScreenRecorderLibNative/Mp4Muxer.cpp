@@ -0,0 +1,813 @@
+#include "Mp4Muxer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	constexpr int64_t HUNDRED_NANOS_PER_SECOND = 10000000;
+	constexpr uint32_t MOVIE_TIMESCALE = 1000;
+	constexpr uint32_t VIDEO_TIMESCALE = 90000;
+	//Sample flags of movie fragments. Non key frames depend on other samples, and are not sync samples.
+	constexpr uint32_t KEY_SAMPLE_FLAGS = 0x02000000;
+	constexpr uint32_t NON_KEY_SAMPLE_FLAGS = 0x01010000;
+
+	//Writes big endian values and boxes to a byte vector. Box sizes are filled in when the box is ended.
+	class BoxWriter
+	{
+	public:
+		std::vector<uint8_t> Data;
+
+		void U8(uint32_t value) { Data.push_back(static_cast<uint8_t>(value)); }
+		void U16(uint32_t value) { U8(value >> 8); U8(value); }
+		void U24(uint32_t value) { U8(value >> 16); U16(value); }
+		void U32(uint32_t value) { U16(value >> 16); U16(value); }
+		void U64(uint64_t value) { U32(static_cast<uint32_t>(value >> 32)); U32(static_cast<uint32_t>(value)); }
+		void Zeros(size_t count) { Data.insert(Data.end(), count, 0); }
+		void Bytes(const std::vector<uint8_t> &bytes) { Data.insert(Data.end(), bytes.begin(), bytes.end()); }
+		void Bytes(const uint8_t *pBytes, size_t size) { Data.insert(Data.end(), pBytes, pBytes + size); }
+		void FourCC(const char *type) { Bytes(reinterpret_cast<const uint8_t *>(type), 4); }
+		size_t BeginBox(const char *type) {
+			const size_t position = Data.size();
+			U32(0);
+			FourCC(type);
+			return position;
+		}
+		size_t BeginFullBox(const char *type, uint8_t version, uint32_t flags) {
+			const size_t position = BeginBox(type);
+			U8(version);
+			U24(flags);
+			return position;
+		}
+		void EndBox(size_t position) { PatchU32(position, static_cast<uint32_t>(Data.size() - position)); }
+		void PatchU32(size_t position, uint32_t value) {
+			Data[position] = static_cast<uint8_t>(value >> 24);
+			Data[position + 1] = static_cast<uint8_t>(value >> 16);
+			Data[position + 2] = static_cast<uint8_t>(value >> 8);
+			Data[position + 3] = static_cast<uint8_t>(value);
+		}
+		void Matrix() {
+			static const uint32_t unity[]{ 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+			for (uint32_t value : unity) {
+				U32(value);
+			}
+		}
+		//Writes an MPEG-4 descriptor, whose length has a variable size.
+		void Descriptor(uint8_t tag, const std::vector<uint8_t> &payload) {
+			U8(tag);
+			size_t length = payload.size();
+			uint8_t lengthBytes[4];
+			int count = 0;
+			do {
+				lengthBytes[count++] = static_cast<uint8_t>(length & 0x7F);
+				length >>= 7;
+			} while (length > 0 && count < 4);
+			for (int i = count - 1; i >= 0; i--) {
+				U8(lengthBytes[i] | (i > 0 ? 0x80 : 0));
+			}
+			Bytes(payload);
+		}
+	};
+
+	//Removes the emulation prevention bytes of a NAL unit, so its fields can be read.
+	std::vector<uint8_t> GetRbsp(const std::vector<uint8_t> &nalUnit) {
+		std::vector<uint8_t> rbsp{};
+		rbsp.reserve(nalUnit.size());
+		int zeroCount = 0;
+		for (uint8_t value : nalUnit) {
+			if (zeroCount >= 2 && value == 3) {
+				zeroCount = 0;
+				continue;
+			}
+			zeroCount = value == 0 ? zeroCount + 1 : 0;
+			rbsp.push_back(value);
+		}
+		return rbsp;
+	}
+
+	//Writes a version 1 box if the duration does not fit the 32 bit fields of version 0.
+	uint8_t GetTimeBoxVersion(uint64_t duration) {
+		return duration > UINT32_MAX ? 1 : 0;
+	}
+}
+
+Mp4Muxer::Mp4Muxer(std::unique_ptr<MuxerOutput> pOutput, const MP4_MUXER_OPTIONS &options, const MP4_VIDEO_TRACK &videoTrack, const std::optional<MP4_AUDIO_TRACK> &audioTrack) :
+	m_Mutex{},
+	m_Output(std::move(pOutput)),
+	m_Options(options),
+	m_VideoTrackFormat(videoTrack),
+	m_AudioTrackFormat(audioTrack),
+	m_Tracks{},
+	m_WriteBuffer{},
+	m_OutputPosition(0),
+	m_IsStarted(false),
+	m_IsFailed(false),
+	m_IsFinalized(false),
+	m_StartTimestamp(0),
+	m_MediaDataPosition(0),
+	m_LastChunkTrack(-1),
+	m_FragmentStartTimestamp(0),
+	m_FragmentSequenceNumber(0),
+	m_Statistics{}
+{
+	m_WriteBuffer.reserve(m_Options.WriteBufferSize);
+	MP4_TRACK videoTrackState{};
+	videoTrackState.TrackId = 1;
+	videoTrackState.Timescale = VIDEO_TIMESCALE;
+	videoTrackState.Stream = PacketStream::Video;
+	m_Tracks.push_back(videoTrackState);
+	if (m_AudioTrackFormat.has_value()) {
+		if (m_AudioTrackFormat->Codec == AudioCodec::AAC && m_AudioTrackFormat->AudioSpecificConfig.empty()) {
+			m_AudioTrackFormat->AudioSpecificConfig = GetAacAudioSpecificConfig(m_AudioTrackFormat->SamplesPerSecond, m_AudioTrackFormat->Channels);
+		}
+		//Audio uses its sample rate as timescale, so the duration of each block of samples is exact.
+		MP4_TRACK audioTrackState{};
+		audioTrackState.TrackId = 2;
+		audioTrackState.Timescale = m_AudioTrackFormat->SamplesPerSecond;
+		audioTrackState.Stream = PacketStream::Audio;
+		m_Tracks.push_back(audioTrackState);
+	}
+}
+
+bool Mp4Muxer::WritePacket(const ENCODED_PACKET &packet)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_IsFailed || m_IsFinalized) {
+		return false;
+	}
+	if (!m_IsStarted) {
+		if (packet.Stream != PacketStream::Video || !packet.IsKeyFrame) {
+			return true;
+		}
+		if (!Start(packet)) {
+			m_IsFailed = true;
+			return false;
+		}
+	}
+	if (packet.Timestamp < m_StartTimestamp) {
+		//Audio from before the first key frame.
+		return true;
+	}
+	MP4_TRACK *pTrack = GetTrack(packet.Stream);
+	if (!pTrack) {
+		return false;
+	}
+	if (m_Options.IsFragmented && packet.Stream == PacketStream::Video && packet.IsKeyFrame) {
+		if (!CommitPendingSample(*pTrack, ToTrackTime(*pTrack, packet.Timestamp))) {
+			return false;
+		}
+		if (!pTrack->Samples.empty() && packet.Timestamp - m_FragmentStartTimestamp >= m_Options.FragmentDuration) {
+			if (!WriteFragment()) {
+				return false;
+			}
+			m_FragmentStartTimestamp = packet.Timestamp;
+		}
+	}
+	return AddSample(*pTrack, packet);
+}
+
+bool Mp4Muxer::Finalize()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_IsFinalized) {
+		return false;
+	}
+	m_IsFinalized = true;
+	if (!m_IsStarted || m_IsFailed) {
+		return false;
+	}
+	for (MP4_TRACK &track : m_Tracks) {
+		if (!CommitPendingSample(track, -1)) {
+			return false;
+		}
+	}
+	if (m_Options.IsFragmented) {
+		return WriteFragment() && Flush();
+	}
+	if (!Flush()) {
+		return false;
+	}
+	//The media data box was started with a 64 bit size, which is only known now.
+	BoxWriter mediaDataSize;
+	mediaDataSize.U64(m_OutputPosition - m_MediaDataPosition);
+	if (!m_Output->WriteAt(m_MediaDataPosition + 8, mediaDataSize.Data.data(), mediaDataSize.Data.size())) {
+		m_IsFailed = true;
+		return false;
+	}
+	m_Statistics.WriteCount++;
+	std::vector<uint8_t> movie = CreateMovieBox();
+	return Append(movie.data(), movie.size()) && Flush();
+}
+
+MP4_MUXER_STATISTICS Mp4Muxer::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Statistics;
+}
+
+Mp4Muxer::MP4_TRACK *Mp4Muxer::GetTrack(PacketStream stream)
+{
+	for (MP4_TRACK &track : m_Tracks) {
+		if (track.Stream == stream) {
+			return &track;
+		}
+	}
+	return nullptr;
+}
+
+bool Mp4Muxer::Start(const ENCODED_PACKET &keyFrame)
+{
+	if (m_VideoTrackFormat.ParameterSets.empty()) {
+		m_VideoTrackFormat.ParameterSets = GetAnnexBParameterSets(m_VideoTrackFormat.Codec, keyFrame.Data.data(), keyFrame.Data.size());
+	}
+	std::vector<uint8_t> videoSampleEntry = CreateVideoSampleEntry();
+	if (videoSampleEntry.empty()) {
+		return false;
+	}
+	m_IsStarted = true;
+	m_StartTimestamp = keyFrame.Timestamp;
+	m_FragmentStartTimestamp = keyFrame.Timestamp;
+
+	BoxWriter header;
+	size_t box = header.BeginBox("ftyp");
+	header.FourCC("isom");
+	header.U32(0x200);
+	header.FourCC("isom");
+	header.FourCC(m_Options.IsFragmented ? "iso6" : "iso2");
+	header.FourCC("mp41");
+	header.EndBox(box);
+	if (m_Options.IsFragmented) {
+		std::vector<uint8_t> movie = CreateMovieBox();
+		header.Bytes(movie);
+	}
+	else {
+		m_MediaDataPosition = m_OutputPosition + m_WriteBuffer.size() + header.Data.size();
+		//A size of 1 means the size follows the type as a 64 bit value, which is written when the file is finalized.
+		header.U32(1);
+		header.FourCC("mdat");
+		header.U64(0);
+	}
+	return Append(header.Data.data(), header.Data.size());
+}
+
+bool Mp4Muxer::AddSample(MP4_TRACK &track, const ENCODED_PACKET &packet)
+{
+	const int64_t timestamp = ToTrackTime(track, packet.Timestamp);
+	if (!CommitPendingSample(track, timestamp)) {
+		return false;
+	}
+	if (packet.Stream == PacketStream::Video) {
+		track.PendingData = ConvertAnnexBToLengthPrefixed(m_VideoTrackFormat.Codec, packet.Data.data(), packet.Data.size());
+	}
+	else {
+		track.PendingData = packet.Data;
+	}
+	MP4_SAMPLE sample{};
+	sample.Timestamp = timestamp;
+	//Used if this is the last sample of the track, else the time until the next sample is used.
+	sample.Duration = static_cast<uint32_t>((std::max)(ToTrackTime(track, packet.Timestamp + packet.Duration) - timestamp, static_cast<int64_t>(1)));
+	sample.Size = static_cast<uint32_t>(track.PendingData.size());
+	sample.IsKeyFrame = packet.Stream == PacketStream::Audio || packet.IsKeyFrame;
+	track.PendingSample = sample;
+	return true;
+}
+
+bool Mp4Muxer::CommitPendingSample(MP4_TRACK &track, int64_t nextTimestamp)
+{
+	if (!track.PendingSample.has_value()) {
+		return true;
+	}
+	MP4_SAMPLE sample = track.PendingSample.value();
+	track.PendingSample.reset();
+	if (nextTimestamp > sample.Timestamp) {
+		sample.Duration = static_cast<uint32_t>(nextTimestamp - sample.Timestamp);
+	}
+	if (m_Options.IsFragmented) {
+		track.FragmentData.insert(track.FragmentData.end(), track.PendingData.begin(), track.PendingData.end());
+	}
+	else {
+		sample.Position = m_OutputPosition + m_WriteBuffer.size();
+		const int trackIndex = static_cast<int>(&track - m_Tracks.data());
+		if (m_LastChunkTrack != trackIndex || track.ChunkSampleCounts.empty()) {
+			track.ChunkPositions.push_back(sample.Position);
+			track.ChunkSampleCounts.push_back(0);
+			m_LastChunkTrack = trackIndex;
+		}
+		track.ChunkSampleCounts.back()++;
+		if (!Append(track.PendingData.data(), track.PendingData.size())) {
+			return false;
+		}
+	}
+	track.PendingData.clear();
+	track.Samples.push_back(sample);
+	track.Duration += sample.Duration;
+	if (track.Stream == PacketStream::Video) {
+		m_Statistics.VideoSampleCount++;
+	}
+	else {
+		m_Statistics.AudioSampleCount++;
+	}
+	return true;
+}
+
+bool Mp4Muxer::WriteFragment()
+{
+	size_t dataSize = 0;
+	for (const MP4_TRACK &track : m_Tracks) {
+		dataSize += track.FragmentData.size();
+	}
+	if (dataSize == 0) {
+		return true;
+	}
+	BoxWriter fragment;
+	const size_t movieFragment = fragment.BeginBox("moof");
+	size_t box = fragment.BeginFullBox("mfhd", 0, 0);
+	fragment.U32(++m_FragmentSequenceNumber);
+	fragment.EndBox(box);
+	std::vector<size_t> dataOffsetPositions{};
+	for (const MP4_TRACK &track : m_Tracks) {
+		if (track.Samples.empty()) {
+			continue;
+		}
+		const size_t trackFragment = fragment.BeginBox("traf");
+		//The data offsets are relative to the start of the movie fragment box.
+		box = fragment.BeginFullBox("tfhd", 0, 0x020000);
+		fragment.U32(track.TrackId);
+		fragment.EndBox(box);
+		box = fragment.BeginFullBox("tfdt", 1, 0);
+		fragment.U64(static_cast<uint64_t>(track.Samples.front().Timestamp));
+		fragment.EndBox(box);
+		//The data offset, and the duration, size and flags of each sample.
+		box = fragment.BeginFullBox("trun", 0, 0x000701);
+		fragment.U32(static_cast<uint32_t>(track.Samples.size()));
+		dataOffsetPositions.push_back(fragment.Data.size());
+		fragment.U32(0);
+		for (const MP4_SAMPLE &sample : track.Samples) {
+			fragment.U32(sample.Duration);
+			fragment.U32(sample.Size);
+			fragment.U32(sample.IsKeyFrame ? KEY_SAMPLE_FLAGS : NON_KEY_SAMPLE_FLAGS);
+		}
+		fragment.EndBox(box);
+		fragment.EndBox(trackFragment);
+	}
+	fragment.EndBox(movieFragment);
+
+	size_t dataOffset = fragment.Data.size() + 8;
+	size_t trackIndex = 0;
+	for (const MP4_TRACK &track : m_Tracks) {
+		if (track.Samples.empty()) {
+			continue;
+		}
+		fragment.PatchU32(dataOffsetPositions[trackIndex++], static_cast<uint32_t>(dataOffset));
+		dataOffset += track.FragmentData.size();
+	}
+	fragment.U32(static_cast<uint32_t>(dataSize + 8));
+	fragment.FourCC("mdat");
+	if (!Append(fragment.Data.data(), fragment.Data.size())) {
+		return false;
+	}
+	for (MP4_TRACK &track : m_Tracks) {
+		if (!Append(track.FragmentData.data(), track.FragmentData.size())) {
+			return false;
+		}
+		track.FragmentData.clear();
+		track.Samples.clear();
+	}
+	m_Statistics.FragmentCount++;
+	//Readers of a fragmented file can use each fragment as soon as it is written, so it is not kept in the write buffer.
+	return Flush();
+}
+
+std::vector<uint8_t> Mp4Muxer::CreateMovieBox()
+{
+	BoxWriter movie;
+	const size_t movieBox = movie.BeginBox("moov");
+	uint64_t movieDuration = 0;
+	for (const MP4_TRACK &track : m_Tracks) {
+		movieDuration = (std::max)(movieDuration, static_cast<uint64_t>(track.Duration) * MOVIE_TIMESCALE / track.Timescale);
+	}
+	uint8_t version = GetTimeBoxVersion(movieDuration);
+	size_t box = movie.BeginFullBox("mvhd", version, 0);
+	if (version == 1) {
+		movie.U64(0);
+		movie.U64(0);
+		movie.U32(MOVIE_TIMESCALE);
+		movie.U64(movieDuration);
+	}
+	else {
+		movie.U32(0);
+		movie.U32(0);
+		movie.U32(MOVIE_TIMESCALE);
+		movie.U32(static_cast<uint32_t>(movieDuration));
+	}
+	movie.U32(0x00010000);
+	movie.U16(0x0100);
+	movie.Zeros(10);
+	movie.Matrix();
+	movie.Zeros(24);
+	movie.U32(static_cast<uint32_t>(m_Tracks.size() + 1));
+	movie.EndBox(box);
+
+	for (const MP4_TRACK &track : m_Tracks) {
+		const bool isVideo = track.Stream == PacketStream::Video;
+		const uint64_t trackDuration = static_cast<uint64_t>(track.Duration) * MOVIE_TIMESCALE / track.Timescale;
+		const size_t trackBox = movie.BeginBox("trak");
+		version = GetTimeBoxVersion(trackDuration);
+		//The track is enabled and used in the presentation.
+		box = movie.BeginFullBox("tkhd", version, 0x000003);
+		if (version == 1) {
+			movie.U64(0);
+			movie.U64(0);
+			movie.U32(track.TrackId);
+			movie.U32(0);
+			movie.U64(trackDuration);
+		}
+		else {
+			movie.U32(0);
+			movie.U32(0);
+			movie.U32(track.TrackId);
+			movie.U32(0);
+			movie.U32(static_cast<uint32_t>(trackDuration));
+		}
+		movie.Zeros(8);
+		movie.U16(0);
+		movie.U16(0);
+		movie.U16(isVideo ? 0 : 0x0100);
+		movie.U16(0);
+		movie.Matrix();
+		movie.U32(isVideo ? m_VideoTrackFormat.Width << 16 : 0);
+		movie.U32(isVideo ? m_VideoTrackFormat.Height << 16 : 0);
+		movie.EndBox(box);
+
+		//A track that starts after the file does is delayed with an empty edit.
+		if (!m_Options.IsFragmented && !track.Samples.empty() && track.Samples.front().Timestamp > 0) {
+			const size_t editBox = movie.BeginBox("edts");
+			box = movie.BeginFullBox("elst", 0, 0);
+			movie.U32(2);
+			movie.U32(static_cast<uint32_t>(static_cast<uint64_t>(track.Samples.front().Timestamp) * MOVIE_TIMESCALE / track.Timescale));
+			movie.U32(UINT32_MAX);
+			movie.U32(0x00010000);
+			movie.U32(static_cast<uint32_t>(trackDuration));
+			movie.U32(0);
+			movie.U32(0x00010000);
+			movie.EndBox(box);
+			movie.EndBox(editBox);
+		}
+
+		const size_t mediaBox = movie.BeginBox("mdia");
+		version = GetTimeBoxVersion(static_cast<uint64_t>(track.Duration));
+		box = movie.BeginFullBox("mdhd", version, 0);
+		if (version == 1) {
+			movie.U64(0);
+			movie.U64(0);
+			movie.U32(track.Timescale);
+			movie.U64(static_cast<uint64_t>(track.Duration));
+		}
+		else {
+			movie.U32(0);
+			movie.U32(0);
+			movie.U32(track.Timescale);
+			movie.U32(static_cast<uint32_t>(track.Duration));
+		}
+		//The packed language code of 'und'.
+		movie.U16(0x55C4);
+		movie.U16(0);
+		movie.EndBox(box);
+		box = movie.BeginFullBox("hdlr", 0, 0);
+		movie.U32(0);
+		movie.FourCC(isVideo ? "vide" : "soun");
+		movie.Zeros(12);
+		const char *handlerName = isVideo ? "VideoHandler" : "SoundHandler";
+		movie.Bytes(reinterpret_cast<const uint8_t *>(handlerName), strlen(handlerName) + 1);
+		movie.EndBox(box);
+
+		const size_t mediaInformationBox = movie.BeginBox("minf");
+		if (isVideo) {
+			box = movie.BeginFullBox("vmhd", 0, 1);
+			movie.Zeros(8);
+		}
+		else {
+			box = movie.BeginFullBox("smhd", 0, 0);
+			movie.Zeros(4);
+		}
+		movie.EndBox(box);
+		const size_t dataInformationBox = movie.BeginBox("dinf");
+		box = movie.BeginFullBox("dref", 0, 0);
+		movie.U32(1);
+		//The media data is in the same file.
+		const size_t urlBox = movie.BeginFullBox("url ", 0, 1);
+		movie.EndBox(urlBox);
+		movie.EndBox(box);
+		movie.EndBox(dataInformationBox);
+
+		const size_t sampleTableBox = movie.BeginBox("stbl");
+		box = movie.BeginFullBox("stsd", 0, 0);
+		movie.U32(1);
+		movie.Bytes(isVideo ? CreateVideoSampleEntry() : CreateAudioSampleEntry());
+		movie.EndBox(box);
+
+		//The movie box of a fragmented file is written before any samples, so its sample tables are empty, and the samples are described in the movie fragments.
+		const std::vector<MP4_SAMPLE> &samples = track.Samples;
+		box = movie.BeginFullBox("stts", 0, 0);
+		const size_t entryCountPosition = movie.Data.size();
+		uint32_t entryCount = 0;
+		movie.U32(0);
+		for (size_t i = 0; i < samples.size();) {
+			size_t runEnd = i + 1;
+			while (runEnd < samples.size() && samples[runEnd].Duration == samples[i].Duration) {
+				runEnd++;
+			}
+			movie.U32(static_cast<uint32_t>(runEnd - i));
+			movie.U32(samples[i].Duration);
+			entryCount++;
+			i = runEnd;
+		}
+		movie.PatchU32(entryCountPosition, entryCount);
+		movie.EndBox(box);
+
+		if (isVideo && !m_Options.IsFragmented) {
+			box = movie.BeginFullBox("stss", 0, 0);
+			std::vector<uint32_t> keyFrames{};
+			for (size_t i = 0; i < samples.size(); i++) {
+				if (samples[i].IsKeyFrame) {
+					keyFrames.push_back(static_cast<uint32_t>(i + 1));
+				}
+			}
+			movie.U32(static_cast<uint32_t>(keyFrames.size()));
+			for (uint32_t keyFrame : keyFrames) {
+				movie.U32(keyFrame);
+			}
+			movie.EndBox(box);
+		}
+
+		const std::vector<uint32_t> &chunkSampleCounts = track.ChunkSampleCounts;
+		box = movie.BeginFullBox("stsc", 0, 0);
+		std::vector<std::pair<uint32_t, uint32_t>> chunkRuns{};
+		for (size_t i = 0; i < chunkSampleCounts.size(); i++) {
+			if (chunkRuns.empty() || chunkRuns.back().second != chunkSampleCounts[i]) {
+				chunkRuns.push_back({ static_cast<uint32_t>(i + 1), chunkSampleCounts[i] });
+			}
+		}
+		movie.U32(static_cast<uint32_t>(chunkRuns.size()));
+		for (const std::pair<uint32_t, uint32_t> &chunkRun : chunkRuns) {
+			movie.U32(chunkRun.first);
+			movie.U32(chunkRun.second);
+			movie.U32(1);
+		}
+		movie.EndBox(box);
+
+		box = movie.BeginFullBox("stsz", 0, 0);
+		movie.U32(0);
+		movie.U32(static_cast<uint32_t>(samples.size()));
+		for (const MP4_SAMPLE &sample : samples) {
+			movie.U32(sample.Size);
+		}
+		movie.EndBox(box);
+
+		const std::vector<uint64_t> &chunkPositions = track.ChunkPositions;
+		const bool isLargeFile = !chunkPositions.empty() && chunkPositions.back() > UINT32_MAX;
+		box = movie.BeginFullBox(isLargeFile ? "co64" : "stco", 0, 0);
+		movie.U32(static_cast<uint32_t>(chunkPositions.size()));
+		for (uint64_t position : chunkPositions) {
+			if (isLargeFile) {
+				movie.U64(position);
+			}
+			else {
+				movie.U32(static_cast<uint32_t>(position));
+			}
+		}
+		movie.EndBox(box);
+		movie.EndBox(sampleTableBox);
+		movie.EndBox(mediaInformationBox);
+		movie.EndBox(mediaBox);
+		movie.EndBox(trackBox);
+	}
+
+	if (m_Options.IsFragmented) {
+		const size_t movieExtendsBox = movie.BeginBox("mvex");
+		for (const MP4_TRACK &track : m_Tracks) {
+			box = movie.BeginFullBox("trex", 0, 0);
+			movie.U32(track.TrackId);
+			movie.U32(1);
+			movie.U32(0);
+			movie.U32(0);
+			movie.U32(0);
+			movie.EndBox(box);
+		}
+		movie.EndBox(movieExtendsBox);
+	}
+	movie.EndBox(movieBox);
+	return movie.Data;
+}
+
+std::vector<uint8_t> Mp4Muxer::CreateVideoSampleEntry()
+{
+	const VideoCodec codec = m_VideoTrackFormat.Codec;
+	std::vector<std::vector<uint8_t>> videoParameterSets{};
+	std::vector<std::vector<uint8_t>> sequenceParameterSets{};
+	std::vector<std::vector<uint8_t>> pictureParameterSets{};
+	for (std::vector<uint8_t> &nalUnit : SplitAnnexB(m_VideoTrackFormat.ParameterSets.data(), m_VideoTrackFormat.ParameterSets.size())) {
+		const uint8_t type = GetNalUnitType(codec, nalUnit[0]);
+		if (codec == VideoCodec::H264 ? type == 7 : type == 33) {
+			sequenceParameterSets.push_back(std::move(nalUnit));
+		}
+		else if (codec == VideoCodec::H264 ? type == 8 : type == 34) {
+			pictureParameterSets.push_back(std::move(nalUnit));
+		}
+		else if (codec == VideoCodec::HEVC && type == 32) {
+			videoParameterSets.push_back(std::move(nalUnit));
+		}
+	}
+	if (sequenceParameterSets.empty() || pictureParameterSets.empty()) {
+		return {};
+	}
+
+	BoxWriter entry;
+	const size_t entryBox = entry.BeginBox(codec == VideoCodec::H264 ? "avc1" : "hvc1");
+	entry.Zeros(6);
+	entry.U16(1);
+	entry.Zeros(16);
+	entry.U16(m_VideoTrackFormat.Width);
+	entry.U16(m_VideoTrackFormat.Height);
+	//72 dpi.
+	entry.U32(0x00480000);
+	entry.U32(0x00480000);
+	entry.U32(0);
+	entry.U16(1);
+	entry.Zeros(32);
+	entry.U16(0x0018);
+	entry.U16(0xFFFF);
+
+	if (codec == VideoCodec::H264) {
+		const std::vector<uint8_t> &sps = sequenceParameterSets.front();
+		if (sps.size() < 4) {
+			return {};
+		}
+		const size_t configurationBox = entry.BeginBox("avcC");
+		entry.U8(1);
+		//The profile, constraint flags and level of the first sequence parameter set.
+		entry.U8(sps[1]);
+		entry.U8(sps[2]);
+		entry.U8(sps[3]);
+		//4 byte NAL unit lengths.
+		entry.U8(0xFF);
+		entry.U8(0xE0 | static_cast<uint32_t>(sequenceParameterSets.size()));
+		for (const std::vector<uint8_t> &nalUnit : sequenceParameterSets) {
+			entry.U16(static_cast<uint32_t>(nalUnit.size()));
+			entry.Bytes(nalUnit);
+		}
+		entry.U8(static_cast<uint32_t>(pictureParameterSets.size()));
+		for (const std::vector<uint8_t> &nalUnit : pictureParameterSets) {
+			entry.U16(static_cast<uint32_t>(nalUnit.size()));
+			entry.Bytes(nalUnit);
+		}
+		const uint8_t profile = sps[1];
+		if (profile == 100 || profile == 110 || profile == 122 || profile == 144) {
+			//The encoders write 8 bit 4:2:0 video.
+			entry.U8(0xFC | 1);
+			entry.U8(0xF8);
+			entry.U8(0xF8);
+			entry.U8(0);
+		}
+		entry.EndBox(configurationBox);
+	}
+	else {
+		//The general profile, tier and level follow the two byte NAL unit header and one byte of sequence parameter set fields.
+		const std::vector<uint8_t> sps = GetRbsp(sequenceParameterSets.front());
+		if (sps.size() < 15 || videoParameterSets.empty()) {
+			return {};
+		}
+		const uint8_t maxSubLayers = ((sps[2] >> 1) & 0x07) + 1;
+		const uint8_t isTemporalIdNested = sps[2] & 0x01;
+		const size_t configurationBox = entry.BeginBox("hvcC");
+		entry.U8(1);
+		entry.Bytes(sps.data() + 3, 12);
+		entry.U16(0xF000);
+		entry.U8(0xFC);
+		//8 bit 4:2:0 video.
+		entry.U8(0xFC | 1);
+		entry.U8(0xF8);
+		entry.U8(0xF8);
+		entry.U16(0);
+		//4 byte NAL unit lengths.
+		entry.U8((maxSubLayers << 3) | (isTemporalIdNested << 2) | 0x03);
+		entry.U8(3);
+		const std::pair<uint8_t, const std::vector<std::vector<uint8_t>> *> arrays[]{
+			{ 32, &videoParameterSets },
+			{ 33, &sequenceParameterSets },
+			{ 34, &pictureParameterSets } };
+		for (const auto &array : arrays) {
+			//The array is complete, as all parameter sets are in the sample description.
+			entry.U8(0x80 | array.first);
+			entry.U16(static_cast<uint32_t>(array.second->size()));
+			for (const std::vector<uint8_t> &nalUnit : *array.second) {
+				entry.U16(static_cast<uint32_t>(nalUnit.size()));
+				entry.Bytes(nalUnit);
+			}
+		}
+		entry.EndBox(configurationBox);
+	}
+	//BT.709 primaries, transfer and matrix, in limited range, as written by the encoders.
+	const size_t colorBox = entry.BeginBox("colr");
+	entry.FourCC("nclx");
+	entry.U16(1);
+	entry.U16(1);
+	entry.U16(1);
+	entry.U8(0);
+	entry.EndBox(colorBox);
+	entry.EndBox(entryBox);
+	return entry.Data;
+}
+
+std::vector<uint8_t> Mp4Muxer::CreateAudioSampleEntry()
+{
+	const MP4_AUDIO_TRACK &format = m_AudioTrackFormat.value();
+	const bool isAac = format.Codec == AudioCodec::AAC;
+	BoxWriter entry;
+	const size_t entryBox = entry.BeginBox(isAac ? "mp4a" : "ipcm");
+	entry.Zeros(6);
+	entry.U16(1);
+	entry.Zeros(8);
+	entry.U16(format.Channels);
+	entry.U16(isAac ? 16 : format.BitsPerSample);
+	entry.U16(0);
+	entry.U16(0);
+	//The sample rate is a 16.16 fixed point value, so rates above 65535 are taken from the audio configuration instead.
+	entry.U32(format.SamplesPerSecond <= 0xFFFF ? format.SamplesPerSecond << 16 : 0);
+	if (isAac) {
+		BoxWriter decoderConfig;
+		//MPEG-4 audio in an audio stream.
+		decoderConfig.U8(0x40);
+		decoderConfig.U8(0x15);
+		decoderConfig.U24(0);
+		decoderConfig.U32(0);
+		decoderConfig.U32(0);
+		decoderConfig.Descriptor(0x05, format.AudioSpecificConfig);
+		BoxWriter elementaryStream;
+		elementaryStream.U16(0);
+		elementaryStream.U8(0);
+		elementaryStream.Descriptor(0x04, decoderConfig.Data);
+		elementaryStream.Descriptor(0x06, { 0x02 });
+		const size_t descriptorBox = entry.BeginFullBox("esds", 0, 0);
+		entry.Descriptor(0x03, elementaryStream.Data);
+		entry.EndBox(descriptorBox);
+	}
+	else {
+		//Little endian samples.
+		const size_t configurationBox = entry.BeginFullBox("pcmC", 0, 0);
+		entry.U8(1);
+		entry.U8(format.BitsPerSample);
+		entry.EndBox(configurationBox);
+	}
+	entry.EndBox(entryBox);
+	return entry.Data;
+}
+
+int64_t Mp4Muxer::ToTrackTime(const MP4_TRACK &track, int64_t timestamp)
+{
+	const int64_t relative = timestamp - m_StartTimestamp;
+	return (relative * track.Timescale + HUNDRED_NANOS_PER_SECOND / 2) / HUNDRED_NANOS_PER_SECOND;
+}
+
+bool Mp4Muxer::Append(const uint8_t *pData, size_t size)
+{
+	if (m_IsFailed) {
+		return false;
+	}
+	if (size == 0) {
+		return true;
+	}
+	if (m_WriteBuffer.size() + size > m_Options.WriteBufferSize && !Flush()) {
+		return false;
+	}
+	if (size >= m_Options.WriteBufferSize) {
+		//Too large to batch, so it is written directly.
+		if (!m_Output->Write(pData, size)) {
+			m_IsFailed = true;
+			return false;
+		}
+		m_OutputPosition += size;
+		m_Statistics.ByteCount += size;
+		m_Statistics.WriteCount++;
+		return true;
+	}
+	m_WriteBuffer.insert(m_WriteBuffer.end(), pData, pData + size);
+	return true;
+}
+
+bool Mp4Muxer::Flush()
+{
+	if (m_IsFailed) {
+		return false;
+	}
+	if (m_WriteBuffer.empty()) {
+		return true;
+	}
+	if (!m_Output->Write(m_WriteBuffer.data(), m_WriteBuffer.size())) {
+		m_IsFailed = true;
+		return false;
+	}
+	m_OutputPosition += m_WriteBuffer.size();
+	m_Statistics.ByteCount += m_WriteBuffer.size();
+	m_Statistics.WriteCount++;
+	m_WriteBuffer.clear();
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "Bitstream.h"
+
+enum class AudioCodec {
+	AAC,
+	PCM
+};
+
+struct MP4_VIDEO_TRACK {
+	VideoCodec Codec;
+	uint32_t Width;
+	uint32_t Height;
+	//The parameter sets in Annex B format. If empty, they are taken from the first key frame.
+	std::vector<uint8_t> ParameterSets;
+};
+
+struct MP4_AUDIO_TRACK {
+	AudioCodec Codec;
+	uint32_t SamplesPerSecond;
+	uint16_t Channels;
+	//The bits per sample of PCM audio.
+	uint16_t BitsPerSample;
+	//The AudioSpecificConfig of AAC audio. If empty, the one for AAC-LC is used.
+	std::vector<uint8_t> AudioSpecificConfig;
+};
+
+struct MP4_MUXER_OPTIONS {
+	//If true, a fragmented MP4 file is written, which can be played while it is being written, and is readable if the recording is interrupted.
+	bool IsFragmented = false;
+	//The minimum duration of a fragment, in 100 nanosecond units. Fragments start at a video key frame, so they are as long as the key frame interval if it is longer. 0 starts a fragment at each key frame.
+	int64_t FragmentDuration = 0;
+	//The size of the buffer the boxes and samples are collected in before they are written to the output. 0 writes them as they are created.
+	size_t WriteBufferSize = 1024 * 1024;
+};
+
+struct MP4_MUXER_STATISTICS {
+	uint64_t VideoSampleCount;
+	uint64_t AudioSampleCount;
+	uint64_t FragmentCount;
+	//The bytes written to the output.
+	uint64_t ByteCount;
+	//The calls made to the output, which are fewer than the boxes and samples written, as they are batched in the write buffer.
+	uint64_t WriteCount;
+};
+
+/// <summary>
+/// The destination of a muxed file.
+/// </summary>
+class MuxerOutput
+{
+public:
+	virtual ~MuxerOutput() {}
+	/// <summary>
+	/// Appends the data to the end of the output.
+	/// </summary>
+	virtual bool Write(const uint8_t *pData, size_t size) = 0;
+	/// <summary>
+	/// Overwrites data that was already written, relative to the start of the output. It is only used to update the size of the media data box, when a file that is not fragmented is finalized.
+	/// </summary>
+	virtual bool WriteAt(uint64_t position, const uint8_t *pData, size_t size) = 0;
+};
+
+/// <summary>
+/// Writes encoded H.264 or HEVC video, with optional AAC or PCM audio, to an MP4 file. The file is written as the packets arrive.
+/// A regular MP4 file has its media data first, and the sample tables are written when it is finalized. A fragmented MP4 file has the track descriptions first, followed by a movie fragment for each group of key frames.
+/// Packets are dropped until the first video key frame. The packets of each stream must be in decoding order, and video frames must not be reordered, as their timestamps are used as decoding timestamps.
+/// Packets can be written from different threads.
+/// </summary>
+class Mp4Muxer
+{
+public:
+	Mp4Muxer(std::unique_ptr<MuxerOutput> pOutput, const MP4_MUXER_OPTIONS &options, const MP4_VIDEO_TRACK &videoTrack, const std::optional<MP4_AUDIO_TRACK> &audioTrack);
+	/// <returns>false if the packet could not be written. The file cannot be completed after a failed write.</returns>
+	bool WritePacket(const ENCODED_PACKET &packet);
+	/// <summary>
+	/// Writes the remaining samples and the sample tables, and flushes the write buffer. No packets can be written after it.
+	/// </summary>
+	/// <returns>false if the file could not be completed, or if it has no video key frame.</returns>
+	bool Finalize();
+	MP4_MUXER_STATISTICS GetStatistics();
+private:
+	struct MP4_SAMPLE {
+		//The decoding timestamp in the track timescale, relative to the start of the file.
+		int64_t Timestamp;
+		uint32_t Duration;
+		uint32_t Size;
+		bool IsKeyFrame;
+		//The position of the sample in the file. Only used for files that are not fragmented.
+		uint64_t Position;
+	};
+
+	struct MP4_TRACK {
+		uint32_t TrackId;
+		uint32_t Timescale;
+		PacketStream Stream;
+		//The sample waiting for the next one of the track, which sets its duration.
+		std::optional<MP4_SAMPLE> PendingSample;
+		std::vector<uint8_t> PendingData;
+		//The samples written to the file, or to the current fragment if the file is fragmented.
+		std::vector<MP4_SAMPLE> Samples;
+		std::vector<uint8_t> FragmentData;
+		//The samples of each chunk, which is a run of consecutive samples of this track in the media data.
+		std::vector<uint32_t> ChunkSampleCounts;
+		std::vector<uint64_t> ChunkPositions;
+		//The total duration of the samples written, in the track timescale.
+		int64_t Duration;
+	};
+
+	std::mutex m_Mutex;
+	std::unique_ptr<MuxerOutput> m_Output;
+	MP4_MUXER_OPTIONS m_Options;
+	MP4_VIDEO_TRACK m_VideoTrackFormat;
+	std::optional<MP4_AUDIO_TRACK> m_AudioTrackFormat;
+	std::vector<MP4_TRACK> m_Tracks;
+	std::vector<uint8_t> m_WriteBuffer;
+	//The number of bytes passed to the output, not counting the write buffer.
+	uint64_t m_OutputPosition;
+	bool m_IsStarted;
+	bool m_IsFailed;
+	bool m_IsFinalized;
+	//The timestamp of the first video key frame, in 100 nanosecond units, which is the start of the file.
+	int64_t m_StartTimestamp;
+	uint64_t m_MediaDataPosition;
+	//The track of the last sample written to the media data, to group consecutive samples in chunks.
+	int m_LastChunkTrack;
+	int64_t m_FragmentStartTimestamp;
+	uint32_t m_FragmentSequenceNumber;
+	MP4_MUXER_STATISTICS m_Statistics;
+
+	MP4_TRACK *GetTrack(PacketStream stream);
+	bool Start(const ENCODED_PACKET &keyFrame);
+	bool AddSample(MP4_TRACK &track, const ENCODED_PACKET &packet);
+	bool CommitPendingSample(MP4_TRACK &track, int64_t nextTimestamp);
+	/// <summary>
+	/// Writes the samples committed since the last fragment as a movie fragment.
+	/// </summary>
+	bool WriteFragment();
+	std::vector<uint8_t> CreateMovieBox();
+	std::vector<uint8_t> CreateVideoSampleEntry();
+	std::vector<uint8_t> CreateAudioSampleEntry();
+	int64_t ToTrackTime(const MP4_TRACK &track, int64_t timestamp);
+	bool Append(const uint8_t *pData, size_t size);
+	bool Flush();
+};
\ No newline at end of file
@@ -1,11 +1,58 @@
 #include "OutputManager.h"
 #include "screengrab.h"
+#include "Bitstream.h"
 #include <ppltasks.h> 
 #include <concrt.h>
 #include <filesystem>
+#include <strmif.h>
 using namespace std;
 using namespace concurrency;
 
+namespace {
+	/// <summary>
+	/// Writes the output of the native MP4 muxer to a Media Foundation byte stream, starting at its current position.
+	/// </summary>
+	class ByteStreamMuxerOutput : public MuxerOutput {
+	public:
+		ByteStreamMuxerOutput(_In_ IMFByteStream *pByteStream) :
+			m_ByteStream(pByteStream),
+			m_StartPosition(0)
+		{
+			if (FAILED(m_ByteStream->GetCurrentPosition(&m_StartPosition))) {
+				m_StartPosition = 0;
+			}
+		}
+		virtual bool Write(const uint8_t *pData, size_t size) override {
+			while (size > 0) {
+				ULONG written = 0;
+				ULONG chunkSize = static_cast<ULONG>(min(size, static_cast<size_t>(MAXLONG)));
+				HRESULT hr = m_ByteStream->Write(pData, chunkSize, &written);
+				if (FAILED(hr) || written == 0) {
+					_com_error err(hr);
+					LOG_ERROR(L"Failed to write to output stream: %ls", err.ErrorMessage());
+					return false;
+				}
+				pData += written;
+				size -= written;
+			}
+			return true;
+		}
+		virtual bool WriteAt(uint64_t position, const uint8_t *pData, size_t size) override {
+			QWORD currentPosition = 0;
+			if (FAILED(m_ByteStream->GetCurrentPosition(&currentPosition))
+				|| FAILED(m_ByteStream->SetCurrentPosition(m_StartPosition + position))) {
+				LOG_ERROR(L"Failed to seek in output stream");
+				return false;
+			}
+			bool isWritten = Write(pData, size);
+			return SUCCEEDED(m_ByteStream->SetCurrentPosition(currentPosition)) && isWritten;
+		}
+	private:
+		CComPtr<IMFByteStream> m_ByteStream;
+		QWORD m_StartPosition;
+	};
+}
+
 OutputManager::OutputManager() :
 	m_Device(nullptr),
 	m_DeviceContext(nullptr),
@@ -15,30 +62,70 @@ OutputManager::OutputManager() :
 	m_FinalizeEvent(nullptr),
 	m_SinkWriter(nullptr),
 	m_OutStream(nullptr),
+	m_BufferedOutStream(nullptr),
 	m_EncoderOptions(nullptr),
 	m_AudioOptions(nullptr),
 	m_SnapshotOptions(nullptr),
 	m_OutputOptions(nullptr),
+	m_Metrics(nullptr),
+	m_MetricsPrefix(""),
+	m_VideoWriteLatency(nullptr),
+	m_AudioWriteLatency(nullptr),
+	m_VideoSampleCount(nullptr),
+	m_AudioSampleCount(nullptr),
+	m_AudioPaddingCount(nullptr),
+	m_DroppedVideoSampleCount(nullptr),
+	m_InFlightVideoSampleCount(nullptr),
+	m_ReplayByteCount(nullptr),
+	m_ReplayDuration(nullptr),
 	m_VideoStreamIndex(0),
 	m_AudioStreamIndex(0),
 	m_OutputFolder(L""),
 	m_OutputFullPath(L""),
 	m_LastFrameHadAudio(false),
 	m_RenderedFrameCount(0),
-	m_MediaTransform(nullptr),
+	m_NV12SampleAllocator(nullptr),
+	m_InFlightSamples(nullptr),
+	m_StopEvent(nullptr),
+	m_SampleReleaseCallback(nullptr),
+	m_StagingTexture(nullptr),
+	m_ConversionSlots(CONVERSION_SLOT_COUNT),
+	m_PendingConversions{},
+	m_NextConversionSlot(0),
+	m_Sink(nullptr),
+	m_NV12Converter{},
+	m_ImageEncoder{},
 	m_DeviceManager(nullptr),
 	m_ResetToken(0),
-	m_UseManualNV12Converter(false)
+	m_UseManualNV12Converter(false),
+	m_VideoOutputFrameSize{},
+	m_VideoBitrateScale(1.0),
+	m_Segment{},
+	m_SegmentFileStream(nullptr),
+	m_SegmentPolicy{},
+	m_SegmentEndPos(0),
+	m_SegmentTimeOffset(0),
+	m_IsSegmentationFailed(false),
+	m_SegmentCompletedCallback(nullptr),
+	m_PrepareSegmentThread{},
+	m_NextSegment(nullptr),
+	m_NextSegmentResult(S_OK),
+	m_FinalizeSegmentThread{},
+	m_ReplayMutex{},
+	m_ReplayBuffer(nullptr),
+	m_PacketSink(nullptr),
+	m_ReplaySequenceHeader{},
+	m_BitstreamCallback(nullptr),
+	m_BitstreamDispatcher(nullptr)
 {
 	m_FinalizeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
-	InitializeCriticalSection(&m_CriticalSection);
 }
 
 OutputManager::~OutputManager()
 {
+	StopSegmentThreads();
 	CloseHandle(m_FinalizeEvent);
 	m_FinalizeEvent = nullptr;
-	DeleteCriticalSection(&m_CriticalSection);
 }
 
 HRESULT OutputManager::Initialize(
@@ -47,10 +134,10 @@ HRESULT OutputManager::Initialize(
 	_In_ std::shared_ptr<ENCODER_OPTIONS> &pEncoderOptions,
 	_In_ std::shared_ptr<AUDIO_OPTIONS> pAudioOptions,
 	_In_ std::shared_ptr<SNAPSHOT_OPTIONS> pSnapshotOptions,
-	_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions)
+	_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
+	_In_ std::shared_ptr<MetricsRegistry> pMetrics)
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 
 	m_DeviceContext = pDeviceContext;
 	m_Device = pDevice;
@@ -58,14 +145,29 @@ HRESULT OutputManager::Initialize(
 	m_AudioOptions = pAudioOptions;
 	m_SnapshotOptions = pSnapshotOptions;
 	m_OutputOptions = pOutputOptions;
+	m_Metrics = pMetrics;
+	m_VideoWriteLatency = m_Metrics->GetHistogram(m_MetricsPrefix + "encoder.video_write_us");
+	m_AudioWriteLatency = m_Metrics->GetHistogram(m_MetricsPrefix + "encoder.audio_write_us");
+	m_VideoSampleCount = m_Metrics->GetCounter(m_MetricsPrefix + "encoder.video_samples");
+	m_AudioSampleCount = m_Metrics->GetCounter(m_MetricsPrefix + "encoder.audio_samples");
+	m_AudioPaddingCount = m_Metrics->GetCounter(m_MetricsPrefix + "encoder.audio_padding_samples");
+	m_DroppedVideoSampleCount = m_Metrics->GetCounter(m_MetricsPrefix + "encoder.dropped_video_samples");
+	m_InFlightVideoSampleCount = m_Metrics->GetGauge(m_MetricsPrefix + "encoder.video_in_flight");
+	m_ReplayByteCount = m_Metrics->GetGauge(m_MetricsPrefix + "replay.bytes");
+	m_ReplayDuration = m_Metrics->GetGauge(m_MetricsPrefix + "replay.duration_ms");
 	if (!m_DeviceManager) {
 		RETURN_ON_BAD_HR(MFCreateDXGIDeviceManager(&m_ResetToken, &m_DeviceManager));
 	}
 	if (m_SinkWriter) {
 		m_SinkWriter->Flush(m_VideoStreamIndex);
 	}
-	if (m_MediaTransform) {
-		m_MediaTransform->ProcessMessage(MFT_MESSAGE_COMMAND_FLUSH, 0);
+	m_StagingTexture.Release();
+	//The textures belong to the previous device, so the frames waiting in them are discarded along with the flushed samples.
+	DiscardPendingConversions();
+	m_ConversionSlots = std::vector<CONVERSION_SLOT>(CONVERSION_SLOT_COUNT);
+	m_NextConversionSlot = 0;
+	if (m_SlideshowWriter) {
+		RETURN_ON_BAD_HR(m_SlideshowWriter->Initialize(pDeviceContext, pDevice, pSnapshotOptions));
 	}
 	if (!m_TimeSrc) {
 		RETURN_ON_BAD_HR(MFCreateSystemTimeSource(&m_TimeSrc));
@@ -82,31 +184,43 @@ HRESULT OutputManager::BeginRecording(_In_ std::wstring outputPath, _In_ SIZE vi
 {
 	HRESULT hr = S_FALSE;
 	m_OutputFullPath = outputPath;
-	if (outputPath.empty()) {
+	if (outputPath.empty() && !IsReplayBufferActive() && !IsBitstreamOutputActive()) {
 		LOG_ERROR("Failed to start recording due to output path parameter being empty");
 		return E_INVALIDARG;
 	}
 	std::filesystem::path filePath = outputPath;
 	m_OutputFolder = filePath.has_extension() ? filePath.parent_path().wstring() : filePath.wstring();
+	m_SlideshowWriter.reset();
 	ResetEvent(m_FinalizeEvent);
+	m_VideoOutputFrameSize = videoOutputFrameSize;
+	m_VideoBitrateScale = 1.0;
+	m_Segment = RECORDING_SEGMENT{ 0, outputPath, 0, 0, S_OK };
+	m_SegmentPolicy.Begin(MillisToHundredNanos(static_cast<double>(GetOutputOptions()->GetSegmentDuration().count())), GetOutputOptions()->GetMaxSegmentSize());
+	m_SegmentEndPos = 0;
+	m_SegmentTimeOffset = 0;
+	m_IsSegmentationFailed = false;
+	BeginBitstreamOutput();
+	if (m_BitstreamDispatcher && GetOutputOptions()->IsSegmentationEnabled()) {
+		LOG_WARN(L"The recording is not split into segments while the bitstream output is enabled");
+	}
 
-	if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video) {
+	if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video && GetOutputOptions()->GetSink()) {
+		RETURN_ON_BAD_HR(hr = BeginSink(videoOutputFrameSize));
+	}
+	else if (IsReplayBufferActive() || (outputPath.empty() && m_BitstreamDispatcher)) {
+		RETURN_ON_BAD_HR(hr = BeginPacketOutput(videoOutputFrameSize));
+	}
+	else if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video) {
 		if (m_FinalizeEvent) {
 			m_CallBack.Attach(new (std::nothrow)CMFSinkWriterCallback(m_FinalizeEvent, nullptr));
 		}
-		CComPtr<IStream> pStream = nullptr;
-		HRESULT hr = SHCreateStreamOnFileEx(
-			outputPath.c_str(),
-			STGM_READWRITE | STGM_SHARE_EXCLUSIVE,
-			FILE_ATTRIBUTE_NORMAL,
-			TRUE,
-			nullptr,
-			&pStream
-		);
-		RECT inputMediaFrameRect = RECT{ 0,0,videoOutputFrameSize.cx,videoOutputFrameSize.cy };
-		CComPtr<IMFByteStream> mfByteStream = nullptr;
-		RETURN_ON_BAD_HR(hr = MFCreateMFByteStreamOnStream(pStream, &mfByteStream));
-		RETURN_ON_BAD_HR(hr = InitializeVideoSinkWriter(mfByteStream, inputMediaFrameRect, videoOutputFrameSize, DXGI_MODE_ROTATION_UNSPECIFIED, m_CallBack, &m_SinkWriter, &m_VideoStreamIndex, &m_AudioStreamIndex));
+		m_SegmentFileStream.Release();
+		RETURN_ON_BAD_HR(hr = CreateFileSinkWriter(outputPath, videoOutputFrameSize, m_CallBack, false, &m_SegmentFileStream, &m_SinkWriter));
+	}
+	else if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Slideshow) {
+		m_SlideshowWriter = std::make_unique<SlideshowWriter>();
+		RETURN_ON_BAD_HR(hr = m_SlideshowWriter->Initialize(m_DeviceContext, m_Device, m_SnapshotOptions));
+		RETURN_ON_BAD_HR(hr = m_SlideshowWriter->Begin(m_OutputFolder));
 	}
 	StartMediaClock();
 	LOG_DEBUG("Sink Writer initialized");
@@ -121,8 +235,25 @@ HRESULT OutputManager::BeginRecording(_In_ IStream *pStream, _In_ SIZE videoOutp
 		return E_INVALIDARG;
 	}
 	m_OutStream = pStream;
+	m_SlideshowWriter.reset();
 	ResetEvent(m_FinalizeEvent);
-	if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video) {
+	m_VideoOutputFrameSize = videoOutputFrameSize;
+	m_VideoBitrateScale = 1.0;
+	m_SegmentTimeOffset = 0;
+	BeginBitstreamOutput();
+	if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video && GetOutputOptions()->GetSink()) {
+		RETURN_ON_BAD_HR(hr = BeginSink(videoOutputFrameSize));
+	}
+	else if (IsReplayBufferActive()) {
+		RETURN_ON_BAD_HR(hr = BeginPacketOutput(videoOutputFrameSize));
+	}
+	else if (GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video) {
+		m_BufferedOutStream.Release();
+		if (GetOutputOptions()->GetStreamWriteBufferSize() > 0) {
+			//The sink writer makes many small writes, which are slow on streams that are implemented in managed code or in another process.
+			RETURN_ON_BAD_HR(hr = CBufferedWriteStream::CreateInstance(pStream, GetOutputOptions()->GetStreamWriteBufferSize(), STREAM_WRITE_BUFFER_COUNT, m_Metrics, m_MetricsPrefix, &m_BufferedOutStream));
+			pStream = m_BufferedOutStream;
+		}
 		CComPtr<IMFByteStream> mfByteStream = nullptr;
 		RETURN_ON_BAD_HR(hr = MFCreateMFByteStreamOnStream(pStream, &mfByteStream));
 
@@ -130,7 +261,7 @@ HRESULT OutputManager::BeginRecording(_In_ IStream *pStream, _In_ SIZE videoOutp
 			m_CallBack.Attach(new (std::nothrow)CMFSinkWriterCallback(m_FinalizeEvent, nullptr));
 		}
 		RECT inputMediaFrameRect = RECT{ 0,0,videoOutputFrameSize.cx,videoOutputFrameSize.cy };
-		RETURN_ON_BAD_HR(hr = InitializeVideoSinkWriter(mfByteStream, inputMediaFrameRect, videoOutputFrameSize, DXGI_MODE_ROTATION_UNSPECIFIED, m_CallBack, &m_SinkWriter, &m_VideoStreamIndex, &m_AudioStreamIndex));
+		RETURN_ON_BAD_HR(hr = InitializeVideoSinkWriter(mfByteStream, inputMediaFrameRect, videoOutputFrameSize, DXGI_MODE_ROTATION_UNSPECIFIED, m_CallBack, false, &m_SinkWriter, &m_VideoStreamIndex, &m_AudioStreamIndex));
 	}
 	StartMediaClock();
 	LOG_DEBUG("Sink Writer initialized");
@@ -142,65 +273,577 @@ HRESULT OutputManager::FinalizeRecording()
 	LOG_INFO("Cleaning up resources");
 	LOG_INFO("Finalizing recording");
 	HRESULT finalizeResult = S_OK;
+	StopSegmentThreads();
+	bool isLastSegment = m_SegmentPolicy.IsStarted();
+	//The sink writer keeps its own reference to the file, which is closed when it is shut down.
+	m_SegmentFileStream.Release();
+	if (m_SinkWriter && !m_PendingConversions.empty()) {
+		HRESULT conversionResult = WritePendingConvertedFrames(true);
+		if (FAILED(conversionResult)) {
+			_com_error err(conversionResult);
+			LOG_ERROR(L"Failed to write the last converted frames: %ls", err.ErrorMessage());
+		}
+	}
+	DiscardPendingConversions();
 	if (m_SinkWriter) {
-
-		finalizeResult = m_SinkWriter->Finalize();
-		if (SUCCEEDED(finalizeResult) && m_FinalizeEvent) {
-			WaitForSingleObject(m_FinalizeEvent, INFINITE);
+		finalizeResult = FinalizeSinkWriter(m_SinkWriter, m_FinalizeEvent, m_Segment.Index > 0 ? m_Segment.Path : m_OutputFullPath);
+	}
+	if (m_BufferedOutStream) {
+		//Writes the rest of the recording to the output stream before the recording is reported complete.
+		HRESULT closeResult = m_BufferedOutStream->Close();
+		if (FAILED(closeResult)) {
+			LOG_ERROR("Failed to write recording to output stream");
+			finalizeResult = SUCCEEDED(finalizeResult) ? closeResult : finalizeResult;
+		}
+		WRITE_COALESCER_STATISTICS stats = m_BufferedOutStream->GetStatistics();
+		double seconds = max(std::chrono::duration<double>(m_BufferedOutStream->GetDuration()).count(), 0.001);
+		LOG_DEBUG(L"Output stream received %llu writes of %llu bytes (%.0f writes/s, %.0f bytes/s), and made %llu writes and %llu seeks to the stream (%.0f calls/s). %llu writes waited for a free buffer.",
+			stats.WriteCount, stats.ByteCount, stats.WriteCount / seconds, stats.ByteCount / seconds,
+			stats.TargetWriteCount, stats.TargetSeekCount, (stats.TargetWriteCount + stats.TargetSeekCount) / seconds, stats.WaitCount);
+		m_BufferedOutStream.Release();
+	}
+	if (isLastSegment && m_SegmentCompletedCallback) {
+		m_Segment.Duration = m_SegmentEndPos - m_Segment.StartPos;
+		m_Segment.Result = finalizeResult;
+		m_SegmentCompletedCallback(m_Segment);
+	}
+	if (m_BitstreamDispatcher) {
+		//The sink writer has passed on all encoded samples, so the packets still queued are the last ones.
+		m_BitstreamDispatcher->Stop(true);
+		BITSTREAM_DISPATCHER_STATISTICS stats = m_BitstreamDispatcher->GetStatistics();
+		LOG_DEBUG(L"Bitstream output delivered %llu packets of %llu bytes, and dropped %llu packets", stats.DeliveredPacketCount, stats.DeliveredByteCount, stats.DroppedPacketCount);
+		m_BitstreamDispatcher.reset();
+	}
+	if (m_Sink) {
+		if (!m_Sink->Finalize()) {
+			LOG_ERROR("Failed to finalize output sink");
+			finalizeResult = E_FAIL;
 		}
+		m_Sink.reset();
+	}
+	if (m_SlideshowWriter) {
+		finalizeResult = m_SlideshowWriter->Finalize();
 		if (FAILED(finalizeResult)) {
-			LOG_ERROR("Failed to finalize sink writer");
-		}
-		//Dispose of MPEG4MediaSink 
-		IMFMediaSink *pSink;
-		if (SUCCEEDED(m_SinkWriter->GetServiceForStream(MF_SINK_WRITER_MEDIASINK, GUID_NULL, IID_PPV_ARGS(&pSink)))) {
-			//Release the sink writer before calling Shutdown on the media sink. 
-			//https://learn.microsoft.com/en-us/windows/win32/api/mfreadwrite/nf-mfreadwrite-mfcreatesinkwriterfrommediasink
-			m_SinkWriter.Release();
-			finalizeResult = pSink->Shutdown();
-			SafeRelease(&pSink);
-			if (FAILED(finalizeResult)) {
-				LOG_ERROR("Failed to shut down IMFMediaSink");
+			LOG_ERROR("Failed to write slideshow");
+		}
+	}
+	if (m_NV12SampleAllocator) {
+		m_NV12SampleAllocator->UninitializeSampleAllocator();
+		m_NV12SampleAllocator.Release();
+	}
+	StopMediaClock();
+	return finalizeResult;
+}
+
+HRESULT OutputManager::CreateFileSinkWriter(_In_ std::wstring path, _In_ SIZE outputFrameSize, _In_ IMFSinkWriterCallback *pCallback, _In_ bool isContinuation, _Outptr_ IStream **ppFileStream, _Outptr_ IMFSinkWriter **ppWriter)
+{
+	CComPtr<IStream> pStream = nullptr;
+	RETURN_ON_BAD_HR(SHCreateStreamOnFileEx(
+		path.c_str(),
+		STGM_READWRITE | STGM_SHARE_EXCLUSIVE,
+		FILE_ATTRIBUTE_NORMAL,
+		TRUE,
+		nullptr,
+		&pStream
+	));
+	RECT inputMediaFrameRect = RECT{ 0,0,outputFrameSize.cx,outputFrameSize.cy };
+	CComPtr<IMFByteStream> mfByteStream = nullptr;
+	RETURN_ON_BAD_HR(MFCreateMFByteStreamOnStream(pStream, &mfByteStream));
+	DWORD videoStreamIndex;
+	DWORD audioStreamIndex;
+	RETURN_ON_BAD_HR(InitializeVideoSinkWriter(mfByteStream, inputMediaFrameRect, outputFrameSize, DXGI_MODE_ROTATION_UNSPECIFIED, pCallback, isContinuation, ppWriter, &videoStreamIndex, &audioStreamIndex));
+	if (!isContinuation) {
+		m_VideoStreamIndex = videoStreamIndex;
+		m_AudioStreamIndex = audioStreamIndex;
+	}
+	*ppFileStream = pStream;
+	(*ppFileStream)->AddRef();
+	return S_OK;
+}
+
+HRESULT OutputManager::FinalizeSinkWriter(_Inout_ CComPtr<IMFSinkWriter> &pSinkWriter, _In_ HANDLE finalizeEvent, _In_ std::wstring path)
+{
+	HRESULT finalizeResult = pSinkWriter->Finalize();
+	if (SUCCEEDED(finalizeResult) && finalizeEvent) {
+		WaitForSingleObject(finalizeEvent, INFINITE);
+	}
+	if (FAILED(finalizeResult)) {
+		LOG_ERROR("Failed to finalize sink writer");
+	}
+	//Dispose of MPEG4MediaSink 
+	IMFMediaSink *pSink;
+	if (SUCCEEDED(pSinkWriter->GetServiceForStream(MF_SINK_WRITER_MEDIASINK, GUID_NULL, IID_PPV_ARGS(&pSink)))) {
+		//Release the sink writer before calling Shutdown on the media sink. 
+		//https://learn.microsoft.com/en-us/windows/win32/api/mfreadwrite/nf-mfreadwrite-mfcreatesinkwriterfrommediasink
+		pSinkWriter.Release();
+		finalizeResult = pSink->Shutdown();
+		SafeRelease(&pSink);
+		if (FAILED(finalizeResult)) {
+			LOG_ERROR("Failed to shut down IMFMediaSink");
+		}
+		else {
+			LOG_DEBUG("Shut down IMFMediaSink");
+		}
+	};
+	pSinkWriter.Release();
+	if (!path.empty()) {
+		bool isFileAvailable = false;
+		for (int i = 0; i < 10; i++) {
+			isFileAvailable = IsFileAvailableForReading(path);
+			if (isFileAvailable) {
+				LOG_TRACE(L"Output file is ready");
+				break;
 			}
 			else {
-				LOG_DEBUG("Shut down IMFMediaSink");
+				Sleep(100);
+				LOG_TRACE(L"Output file is still locked for reading, waiting..");
 			}
-		};
-		if (!m_OutputFullPath.empty()) {
-			bool isFileAvailable = false;
-			for (int i = 0; i < 10; i++) {
-				isFileAvailable = IsFileAvailableForReading(m_OutputFullPath);
-				if (isFileAvailable) {
-					LOG_TRACE(L"Output file is ready");
-					break;
-				}
-				else {
-					Sleep(100);
-					LOG_TRACE(L"Output file is still locked for reading, waiting..");
-				}
+		}
+		if (!isFileAvailable) {
+			LOG_WARN("Output file is still locked after maximum retries");
+		}
+	}
+	return finalizeResult;
+}
+
+bool OutputManager::IsSegmentationActive()
+{
+	return GetOutputOptions()->IsSegmentationEnabled()
+		&& !m_IsSegmentationFailed
+		&& m_SinkWriter
+		&& m_SegmentFileStream
+		&& !m_Sink
+		&& !m_OutStream
+		&& !m_BitstreamDispatcher;
+}
+
+HRESULT OutputManager::UpdateSegment(_In_ const FrameWriteModel &model)
+{
+	INT64 frameStartPos = SegmentPolicy::GetFrameStartPos(model.StartPos, model.AudioStartPos, GetAudioOptions()->IsAudioEnabled());
+	if (!m_SegmentPolicy.IsStarted()) {
+		m_Segment.StartPos = frameStartPos;
+		m_SegmentEndPos = frameStartPos;
+	}
+	UINT64 size = 0;
+	if (m_SegmentPolicy.IsStarted() && m_SegmentPolicy.IsSizeLimited()) {
+		STATSTG stat{};
+		if (SUCCEEDED(m_SegmentFileStream->Stat(&stat, STATFLAG_NONAME))) {
+			size = stat.cbSize.QuadPart;
+		}
+	}
+	switch (m_SegmentPolicy.Update(frameStartPos, size))
+	{
+		case SegmentAction::StartNext:
+			return StartNextSegment(frameStartPos);
+		case SegmentAction::PrepareNext:
+			if (!m_PrepareSegmentThread.joinable()) {
+				PrepareNextSegment();
 			}
-			if (!isFileAvailable) {
-				LOG_WARN("Output file is still locked after maximum retries");
+			break;
+		case SegmentAction::None:
+		default:
+			break;
+	}
+	return S_OK;
+}
+
+void OutputManager::PrepareNextSegment()
+{
+	std::wstring path = SegmentPolicy::GetSegmentPath(m_OutputFullPath, m_Segment.Index + 1);
+	LOG_DEBUG(L"Preparing next segment %ls", path.c_str());
+	m_NextSegment.reset();
+	m_NextSegmentResult = S_OK;
+	m_PrepareSegmentThread = std::thread([this, path] {
+		HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+		LOG_ON_BAD_HR(hr);
+		std::unique_ptr<SINK_WRITER_SEGMENT> pSegment = make_unique<SINK_WRITER_SEGMENT>();
+		pSegment->Path = path;
+		pSegment->FinalizeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		pSegment->Callback.Attach(new (std::nothrow)CMFSinkWriterCallback(pSegment->FinalizeEvent, nullptr));
+		HRESULT createHr = pSegment->FinalizeEvent && pSegment->Callback ? S_OK : E_OUTOFMEMORY;
+		if (SUCCEEDED(createHr)) {
+			createHr = CreateFileSinkWriter(path, m_VideoOutputFrameSize, pSegment->Callback, true, &pSegment->FileStream, &pSegment->SinkWriter);
+		}
+		if (SUCCEEDED(createHr)) {
+			m_NextSegment = std::move(pSegment);
+		}
+		else if (pSegment->FinalizeEvent) {
+			CloseHandle(pSegment->FinalizeEvent);
+		}
+		m_NextSegmentResult = createHr;
+		if (SUCCEEDED(hr)) {
+			CoUninitialize();
+		}
+	});
+}
+
+HRESULT OutputManager::StartNextSegment(_In_ INT64 startPos)
+{
+	if (!m_PrepareSegmentThread.joinable()) {
+		PrepareNextSegment();
+	}
+	m_PrepareSegmentThread.join();
+	if (FAILED(m_NextSegmentResult) || !m_NextSegment) {
+		//Keep writing to the current segment, instead of failing to create a new one for every frame.
+		m_IsSegmentationFailed = true;
+		return FAILED(m_NextSegmentResult) ? m_NextSegmentResult : E_FAIL;
+	}
+	//The frames waiting for conversion have timestamps in the current segment, so they are written to it before switching.
+	RETURN_ON_BAD_HR(WritePendingConvertedFrames(true));
+	RECORDING_SEGMENT finishedSegment = m_Segment;
+	finishedSegment.Path = m_Segment.Index > 0 ? m_Segment.Path : m_OutputFullPath;
+	finishedSegment.Duration = startPos - m_Segment.StartPos;
+	SINK_WRITER_SEGMENT finishedWriter{ finishedSegment.Path, m_SegmentFileStream, m_SinkWriter, m_CallBack, m_FinalizeEvent };
+
+	m_SinkWriter = m_NextSegment->SinkWriter;
+	m_CallBack = m_NextSegment->Callback;
+	m_FinalizeEvent = m_NextSegment->FinalizeEvent;
+	m_SegmentFileStream = m_NextSegment->FileStream;
+	m_Segment = RECORDING_SEGMENT{ finishedSegment.Index + 1, m_NextSegment->Path, startPos, 0, S_OK };
+	m_SegmentPolicy.BeginNextSegment(startPos);
+	m_SegmentEndPos = startPos;
+	m_SegmentTimeOffset = startPos;
+	m_NextSegment.reset();
+	if (m_VideoBitrateScale != 1.0) {
+		HRESULT bitrateHr = SetVideoBitrateScale(m_VideoBitrateScale);
+		if (FAILED(bitrateHr)) {
+			_com_error err(bitrateHr);
+			LOG_WARN(L"Failed to change video bitrate of new segment: %ls", err.ErrorMessage());
+		}
+	}
+	LOG_INFO(L"Started recording segment %u to %ls", m_Segment.Index, m_Segment.Path.c_str());
+
+	//Segments are much longer than it takes to finalize one, so this rarely waits.
+	if (m_FinalizeSegmentThread.joinable()) {
+		m_FinalizeSegmentThread.join();
+	}
+	m_FinalizeSegmentThread = std::thread([this, finishedSegment, finishedWriter]() mutable {
+		HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+		LOG_ON_BAD_HR(hr);
+		finishedWriter.FileStream.Release();
+		finishedSegment.Result = FinalizeSinkWriter(finishedWriter.SinkWriter, finishedWriter.FinalizeEvent, finishedWriter.Path);
+		finishedWriter.Callback.Release();
+		CloseHandle(finishedWriter.FinalizeEvent);
+		if (m_SegmentCompletedCallback) {
+			m_SegmentCompletedCallback(finishedSegment);
+		}
+		if (SUCCEEDED(hr)) {
+			CoUninitialize();
+		}
+	});
+	return S_OK;
+}
+
+void OutputManager::StopSegmentThreads()
+{
+	if (m_PrepareSegmentThread.joinable()) {
+		m_PrepareSegmentThread.join();
+	}
+	if (m_NextSegment) {
+		//The recording ended before the next segment was written to, so its file is empty.
+		CComPtr<IMFMediaSink> pSink;
+		if (SUCCEEDED(m_NextSegment->SinkWriter->GetServiceForStream(MF_SINK_WRITER_MEDIASINK, GUID_NULL, IID_PPV_ARGS(&pSink)))) {
+			m_NextSegment->SinkWriter.Release();
+			pSink->Shutdown();
+		}
+		m_NextSegment->SinkWriter.Release();
+		m_NextSegment->FileStream.Release();
+		CloseHandle(m_NextSegment->FinalizeEvent);
+		if (!DeleteFileW(m_NextSegment->Path.c_str())) {
+			LOG_WARN(L"Failed to delete unused segment file %ls", m_NextSegment->Path.c_str());
+		}
+		m_NextSegment.reset();
+	}
+	if (m_FinalizeSegmentThread.joinable()) {
+		m_FinalizeSegmentThread.join();
+	}
+}
+
+bool OutputManager::IsReplayBufferActive()
+{
+	return GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video
+		&& GetOutputOptions()->IsReplayBufferEnabled()
+		&& !GetOutputOptions()->GetSink();
+}
+
+bool OutputManager::IsBitstreamOutputActive()
+{
+	return GetOutputOptions()->GetRecorderMode() == RecorderModeInternal::Video
+		&& GetOutputOptions()->IsBitstreamOutputEnabled()
+		&& !GetOutputOptions()->GetSink()
+		&& m_BitstreamCallback;
+}
+
+void OutputManager::BeginBitstreamOutput()
+{
+	if (m_BitstreamDispatcher) {
+		m_BitstreamDispatcher->Stop(false);
+		m_BitstreamDispatcher.reset();
+	}
+	if (IsBitstreamOutputActive()) {
+		VideoCodec codec = GetEncoderOptions()->GetVideoEncoderFormat() == MFVideoFormat_HEVC ? VideoCodec::HEVC : VideoCodec::H264;
+		m_BitstreamDispatcher = std::make_shared<BitstreamDispatcher>(m_BitstreamCallback, codec, GetOutputOptions()->GetBitstreamFormat(), GetOutputOptions()->GetMaxQueuedBitstreamPackets());
+	}
+}
+
+HRESULT OutputManager::BeginPacketOutput(_In_ SIZE videoOutputFrameSize)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_ReplayMutex);
+		//A new buffer is created for each recording, so a replay of the previous one can be saved until this one starts.
+		m_ReplayBuffer = IsReplayBufferActive() ? std::make_shared<ReplayBuffer>(MillisToHundredNanos(static_cast<double>(GetOutputOptions()->GetReplayBufferDuration().count())), GetOutputOptions()->GetReplayBufferMaxSize()) : nullptr;
+		m_ReplaySequenceHeader.clear();
+		m_PacketSink.Release();
+	}
+	if (m_FinalizeEvent) {
+		m_CallBack.Attach(new (std::nothrow)CMFSinkWriterCallback(m_FinalizeEvent, nullptr));
+	}
+	RECT inputMediaFrameRect = RECT{ 0,0,videoOutputFrameSize.cx,videoOutputFrameSize.cy };
+	RETURN_ON_BAD_HR(InitializeVideoSinkWriter(nullptr, inputMediaFrameRect, videoOutputFrameSize, DXGI_MODE_ROTATION_UNSPECIFIED, m_CallBack, false, &m_SinkWriter, &m_VideoStreamIndex, &m_AudioStreamIndex));
+	if (m_ReplayBuffer) {
+		LOG_DEBUG(L"Replay buffer initialized, encoded frames are kept in memory");
+	}
+	else {
+		LOG_DEBUG(L"Bitstream output initialized, encoded frames are only passed to the callback");
+	}
+	return S_OK;
+}
+
+std::shared_ptr<Mp4Muxer> OutputManager::CreateMp4Muxer(_In_ IMFByteStream *pOutStream, _In_ UINT width, _In_ UINT height, _In_ bool hasAudio)
+{
+	MP4_MUXER_OPTIONS muxerOptions{};
+	muxerOptions.IsFragmented = GetEncoderOptions()->GetIsFragmentedMp4Enabled();
+	muxerOptions.FragmentDuration = MillisToHundredNanos(static_cast<double>(GetEncoderOptions()->GetFragmentDuration().count()));
+	MP4_VIDEO_TRACK videoTrack{};
+	videoTrack.Codec = GetEncoderOptions()->GetVideoEncoderFormat() == MFVideoFormat_HEVC ? VideoCodec::HEVC : VideoCodec::H264;
+	videoTrack.Width = width;
+	videoTrack.Height = height;
+	std::optional<MP4_AUDIO_TRACK> audioTrack{};
+	if (hasAudio) {
+		MP4_AUDIO_TRACK track{};
+		track.Codec = AudioCodec::AAC;
+		track.SamplesPerSecond = GetAudioOptions()->GetAudioSamplesPerSecond();
+		track.Channels = static_cast<uint16_t>(GetAudioOptions()->GetAudioChannels());
+		track.BitsPerSample = 16;
+		audioTrack = track;
+	}
+	return std::make_shared<Mp4Muxer>(std::make_unique<ByteStreamMuxerOutput>(pOutStream), muxerOptions, videoTrack, audioTrack);
+}
+
+void OutputManager::WriteEncodedSample(_In_ DWORD streamId, _In_ IMFSample *pSample, _In_opt_ ReplayBuffer *pReplayBuffer, _In_opt_ Mp4Muxer *pMuxer, _In_opt_ BitstreamDispatcher *pDispatcher)
+{
+	ENCODED_PACKET packet{};
+	if (pDispatcher) {
+		//The sample is read into a pooled buffer, which is lent to the bitstream callback without another copy.
+		packet.Data = pDispatcher->AcquireBuffer();
+	}
+	HRESULT hr = ReadEncodedPacket(pSample, streamId == 0 ? PacketStream::Video : PacketStream::Audio, &packet);
+	if (FAILED(hr)) {
+		_com_error err(hr);
+		LOG_WARN(L"Failed to read encoded sample: %ls", err.ErrorMessage());
+		return;
+	}
+	if (pMuxer) {
+		pMuxer->WritePacket(packet);
+	}
+	if (pReplayBuffer && pDispatcher) {
+		AddReplayPacket(pReplayBuffer, packet);
+	}
+	else if (pReplayBuffer) {
+		AddReplayPacket(pReplayBuffer, std::move(packet));
+	}
+	if (pDispatcher) {
+		pDispatcher->Enqueue(std::move(packet));
+	}
+}
+
+void OutputManager::AddReplayPacket(_In_ ReplayBuffer *pBuffer, _In_ ENCODED_PACKET packet)
+{
+	if (packet.IsKeyFrame) {
+		const std::lock_guard<std::mutex> lock(m_ReplayMutex);
+		if (m_ReplaySequenceHeader.empty()) {
+			VideoCodec codec = GetEncoderOptions()->GetVideoEncoderFormat() == MFVideoFormat_HEVC ? VideoCodec::HEVC : VideoCodec::H264;
+			m_ReplaySequenceHeader = GetAnnexBParameterSets(codec, packet.Data.data(), packet.Data.size());
+		}
+	}
+	pBuffer->AddPacket(std::move(packet));
+	REPLAY_BUFFER_STATISTICS stats = pBuffer->GetStatistics();
+	m_ReplayByteCount->Set(static_cast<int64_t>(stats.ByteCount));
+	m_ReplayDuration->Set(HundredNanosToMillis(stats.EndTimestamp - stats.StartTimestamp));
+}
+
+HRESULT OutputManager::SaveReplay(_In_ std::wstring path)
+{
+	CComPtr<IStream> pStream = nullptr;
+	RETURN_ON_BAD_HR(SHCreateStreamOnFileEx(
+		path.c_str(),
+		STGM_CREATE | STGM_READWRITE | STGM_SHARE_EXCLUSIVE,
+		FILE_ATTRIBUTE_NORMAL,
+		TRUE,
+		nullptr,
+		&pStream
+	));
+	HRESULT hr = SaveReplay(pStream);
+	pStream.Release();
+	if (FAILED(hr)) {
+		DeleteFileW(path.c_str());
+	}
+	else {
+		LOG_INFO(L"Saved replay to %ls", path.c_str());
+	}
+	return hr;
+}
+
+HRESULT OutputManager::SaveReplay(_In_ IStream *pStream)
+{
+	std::vector<std::shared_ptr<const ENCODED_PACKET>> packets{};
+	std::vector<BYTE> sequenceHeader{};
+	CComPtr<CMFPacketMediaSink> pPacketSink = nullptr;
+	{
+		const std::lock_guard<std::mutex> lock(m_ReplayMutex);
+		if (!m_ReplayBuffer || !m_PacketSink) {
+			LOG_ERROR(L"Failed to save replay, the replay buffer is not enabled");
+			return E_NOT_VALID_STATE;
+		}
+		packets = m_ReplayBuffer->GetPackets();
+		sequenceHeader = m_ReplaySequenceHeader;
+		m_PacketSink.p->AddRef();
+		pPacketSink.Attach(m_PacketSink.p);
+	}
+	//The media types are read without holding the lock, as the sink holds its own lock while adding samples to the buffer.
+	CComPtr<IMFMediaType> pVideoMediaType = nullptr;
+	CComPtr<IMFMediaType> pAudioMediaType = nullptr;
+	RETURN_ON_BAD_HR(pPacketSink->GetStreamMediaType(0, &pVideoMediaType));
+	if (FAILED(pPacketSink->GetStreamMediaType(1, &pAudioMediaType))) {
+		pAudioMediaType.Release();
+	}
+	pPacketSink.Release();
+	if (packets.empty()) {
+		LOG_WARN(L"Failed to save replay, the replay buffer has no frames yet");
+		return E_NOT_VALID_STATE;
+	}
+
+	//The MP4 sink needs the codec private data, which some encoders only write in the bitstream.
+	UINT32 blobSize = 0;
+	if (FAILED(pVideoMediaType->GetBlobSize(MF_MT_MPEG_SEQUENCE_HEADER, &blobSize)) && !sequenceHeader.empty()) {
+		RETURN_ON_BAD_HR(pVideoMediaType->SetBlob(MF_MT_MPEG_SEQUENCE_HEADER, sequenceHeader.data(), static_cast<UINT32>(sequenceHeader.size())));
+	}
+	GUID audioSubtype = GUID_NULL;
+	if (pAudioMediaType
+		&& SUCCEEDED(pAudioMediaType->GetGUID(MF_MT_SUBTYPE, &audioSubtype))
+		&& audioSubtype == MFAudioFormat_AAC
+		&& FAILED(pAudioMediaType->GetBlobSize(MF_MT_USER_DATA, &blobSize))) {
+		//The user data of AAC is the part of HEAACWAVEINFO after the WAVEFORMATEX, followed by the AudioSpecificConfig.
+		std::vector<BYTE> userData(12, 0);
+		userData[2] = 0x29;
+		std::vector<uint8_t> audioSpecificConfig = GetAacAudioSpecificConfig(
+			MFGetAttributeUINT32(pAudioMediaType, MF_MT_AUDIO_SAMPLES_PER_SECOND, 0),
+			static_cast<uint16_t>(MFGetAttributeUINT32(pAudioMediaType, MF_MT_AUDIO_NUM_CHANNELS, 0)));
+		userData.insert(userData.end(), audioSpecificConfig.begin(), audioSpecificConfig.end());
+		RETURN_ON_BAD_HR(pAudioMediaType->SetUINT32(MF_MT_AAC_PAYLOAD_TYPE, 0));
+		RETURN_ON_BAD_HR(pAudioMediaType->SetUINT32(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, 0x29));
+		RETURN_ON_BAD_HR(pAudioMediaType->SetBlob(MF_MT_USER_DATA, userData.data(), static_cast<UINT32>(userData.size())));
+	}
+
+	INT64 startTimestamp = packets.front()->Timestamp;
+	for (const std::shared_ptr<const ENCODED_PACKET> &pPacket : packets) {
+		startTimestamp = min(startTimestamp, pPacket->Timestamp);
+	}
+
+	CComPtr<IMFByteStream> pByteStream = nullptr;
+	RETURN_ON_BAD_HR(MFCreateMFByteStreamOnStream(pStream, &pByteStream));
+	CComPtr<IMFMediaSink> pMediaSink = nullptr;
+	RETURN_ON_BAD_HR(MFCreateMPEG4MediaSink(pByteStream, pVideoMediaType, pAudioMediaType, &pMediaSink));
+	CComPtr<IMFAttributes> pAttributes = nullptr;
+	RETURN_ON_BAD_HR(MFCreateAttributes(&pAttributes, 2));
+	RETURN_ON_BAD_HR(pAttributes->SetUINT32(MF_SINK_WRITER_DISABLE_THROTTLING, TRUE));
+	RETURN_ON_BAD_HR(pAttributes->SetUINT32(MF_MPEG4SINK_MOOV_BEFORE_MDAT, GetEncoderOptions()->GetIsFastStartEnabled()));
+
+	//The packets are already encoded, so the sink writer is given the same input and output types, and passes them through to the MP4 sink.
+	CComPtr<IMFSinkWriter> pSinkWriter = nullptr;
+	HRESULT hr = MFCreateSinkWriterFromMediaSink(pMediaSink, pAttributes, &pSinkWriter);
+	if (SUCCEEDED(hr)) {
+		hr = pSinkWriter->SetInputMediaType(0, pVideoMediaType, nullptr);
+	}
+	if (SUCCEEDED(hr) && pAudioMediaType) {
+		hr = pSinkWriter->SetInputMediaType(1, pAudioMediaType, nullptr);
+	}
+	if (SUCCEEDED(hr)) {
+		hr = pSinkWriter->BeginWriting();
+	}
+	if (SUCCEEDED(hr)) {
+		for (const std::shared_ptr<const ENCODED_PACKET> &pPacket : packets) {
+			CComPtr<IMFMediaBuffer> pMediaBuffer = nullptr;
+			CComPtr<IMFSample> pSample = nullptr;
+			BYTE *pData = nullptr;
+			const DWORD length = static_cast<DWORD>(pPacket->Data.size());
+			BREAK_ON_BAD_HR(hr = MFCreateMemoryBuffer(length, &pMediaBuffer));
+			BREAK_ON_BAD_HR(hr = pMediaBuffer->Lock(&pData, nullptr, nullptr));
+			memcpy(pData, pPacket->Data.data(), length);
+			pMediaBuffer->Unlock();
+			BREAK_ON_BAD_HR(hr = pMediaBuffer->SetCurrentLength(length));
+			BREAK_ON_BAD_HR(hr = MFCreateSample(&pSample));
+			BREAK_ON_BAD_HR(hr = pSample->AddBuffer(pMediaBuffer));
+			BREAK_ON_BAD_HR(hr = pSample->SetSampleTime(pPacket->Timestamp - startTimestamp));
+			BREAK_ON_BAD_HR(hr = pSample->SetSampleDuration(pPacket->Duration));
+			if (pPacket->IsKeyFrame) {
+				BREAK_ON_BAD_HR(hr = pSample->SetUINT32(MFSampleExtension_CleanPoint, TRUE));
 			}
+			BREAK_ON_BAD_HR(hr = pSinkWriter->WriteSample(pPacket->Stream == PacketStream::Video ? 0 : 1, pSample));
 		}
 	}
-	StopMediaClock();
-	return finalizeResult;
+	if (SUCCEEDED(hr)) {
+		hr = pSinkWriter->Finalize();
+	}
+	if (FAILED(hr)) {
+		_com_error err(hr);
+		LOG_ERROR(L"Failed to save replay: %ls", err.ErrorMessage());
+	}
+	//Release the sink writer before calling Shutdown on the media sink.
+	pSinkWriter.Release();
+	pMediaSink->Shutdown();
+	return hr;
+}
+
+REPLAY_BUFFER_STATISTICS OutputManager::GetReplayStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_ReplayMutex);
+	if (!m_ReplayBuffer) {
+		return REPLAY_BUFFER_STATISTICS{};
+	}
+	return m_ReplayBuffer->GetStatistics();
 }
 
 HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 	HRESULT hr(S_OK);
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	MeasureExecutionTime measure(L"RenderFrame");
+	TRACE_SCOPE("RenderFrame");
 	auto recorderMode = GetOutputOptions()->GetRecorderMode();
 	if (recorderMode == RecorderModeInternal::Video) {
-		hr = WriteFrameToVideo(model.StartPos, model.Duration, m_VideoStreamIndex, model.Frame);
 		bool wroteAudioSample = false;
-		if (FAILED(hr)) {
-			_com_error err(hr);
-			LOG_ERROR(L"Writing of video frame with start pos %lld ms failed: %s", (HundredNanosToMillis(model.StartPos)), err.ErrorMessage());
-			return hr;//Stop recording if we fail
+		if (model.Frame && IsSegmentationActive()) {
+			HRESULT segmentHr = UpdateSegment(model);
+			if (FAILED(segmentHr)) {
+				_com_error err(segmentHr);
+				LOG_ERROR(L"Failed to start the next segment, the recording continues in %ls: %ls", m_Segment.Path.c_str(), err.ErrorMessage());
+			}
+		}
+		if (model.Frame) {
+			hr = WriteFrameToVideo(model.StartPos - m_SegmentTimeOffset, model.Duration, m_VideoStreamIndex, model.Frame);
+			if (FAILED(hr)) {
+				_com_error err(hr);
+				LOG_ERROR(L"Writing of video frame with start pos %lld ms failed: %s", (HundredNanosToMillis(model.StartPos)), err.ErrorMessage());
+				return hr;//Stop recording if we fail
+			}
+			if (hr == S_FALSE) {
+				LOG_TRACE(L"Dropped video frame with start pos %lld ms, the encoder holds the maximum number of frames", HundredNanosToMillis(model.StartPos));
+				m_DroppedVideoSampleCount->Increment();
+			}
+			else {
+				m_VideoSampleCount->Increment();
+			}
+			m_InFlightVideoSampleCount->Set(GetInFlightStatistics().FrameCount);
 		}
 		bool paddedAudio = false;
 
@@ -208,9 +851,10 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 		 * If we don't, the sink writer will begin throttling video frames because it expects audio samples to be delivered, and think they are delayed.
 		 * We ignore every instance where the last frame had audio, due to sometimes very short frame durations due to mouse cursor changes have zero audio length,
 		 * and inserting silence between two frames that has audio leads to glitching. */
-		if (GetAudioOptions()->IsAudioEnabled() && model.Audio.size() == 0 && model.Duration > 0) {
+		INT64 audioDuration = model.AudioDuration;
+		if (GetAudioOptions()->IsAudioEnabled() && model.Audio.size() == 0 && audioDuration > 0) {
 			if (!m_LastFrameHadAudio) {
-				int frameCount = int(ceil(GetAudioOptions()->GetAudioSamplesPerSecond() * HundredNanosToMillis(model.Duration) / 1000));
+				int frameCount = int(ceil(GetAudioOptions()->GetAudioSamplesPerSecond() * HundredNanosToMillis(audioDuration) / 1000));
 				int byteCount = frameCount * (GetAudioOptions()->GetAudioBitsPerSample() / 8) * GetAudioOptions()->GetAudioChannels();
 				model.Audio.insert(model.Audio.end(), byteCount, 0);
 				paddedAudio = true;
@@ -222,33 +866,38 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 		}
 
 		if (model.Audio.size() > 0) {
-			hr = WriteAudioSamplesToVideo(model.StartPos, model.Duration, m_AudioStreamIndex, &(model.Audio)[0], (DWORD)model.Audio.size());
+			hr = WriteAudioSamplesToVideo(model.AudioStartPos - m_SegmentTimeOffset, audioDuration, m_AudioStreamIndex, &(model.Audio)[0], (DWORD)model.Audio.size());
 			if (FAILED(hr)) {
 				_com_error err(hr);
-				LOG_ERROR(L"Writing of audio sample with start pos %lld ms failed: %s", (HundredNanosToMillis(model.StartPos)), err.ErrorMessage());
+				LOG_ERROR(L"Writing of audio sample with start pos %lld ms failed: %s", (HundredNanosToMillis(model.AudioStartPos)), err.ErrorMessage());
 				return hr;//Stop recording if we fail
 			}
 			else {
 				wroteAudioSample = true;
+				m_AudioSampleCount->Increment();
+				if (paddedAudio) {
+					m_AudioPaddingCount->Increment();
+				}
 			}
 		}
-		auto frameInfoStr = wroteAudioSample ? (paddedAudio ? L"video sample and audio padding" : L"video and audio sample") : L"video sample";
+		if (m_IsSegmentStarted) {
+			m_SegmentEndPos = max(m_SegmentEndPos, max(model.Frame ? model.StartPos + model.Duration : 0, model.AudioStartPos + audioDuration));
+		}
+		auto frameInfoStr = !model.Frame ? L"audio sample" : wroteAudioSample ? (paddedAudio ? L"video sample and audio padding" : L"video and audio sample") : L"video sample";
 		LOG_TRACE(L"Wrote %s with duration %.2f ms", frameInfoStr, HundredNanosToMillisDouble(model.Duration));
 	}
 	else if (recorderMode == RecorderModeInternal::Slideshow) {
-		wstring	path = m_OutputFolder + L"\\" + to_wstring(m_RenderedFrameCount) + GetSnapshotOptions()->GetImageExtension();
-		hr = WriteFrameToImage(model.Frame, path);
 		INT64 startposMs = HundredNanosToMillis(model.StartPos);
 		INT64 durationMs = HundredNanosToMillis(model.Duration);
+		//The frame is encoded and added to the manifest by the slideshow writer. A failure of an earlier frame is returned here.
+		hr = m_SlideshowWriter ? m_SlideshowWriter->QueueFrame(model.Frame, m_RenderedFrameCount == 0 ? 0 : durationMs) : E_NOT_VALID_STATE;
 		if (FAILED(hr)) {
 			_com_error err(hr);
 			LOG_ERROR(L"Writing of slideshow frame with start pos %lld ms failed: %s", startposMs, err.ErrorMessage());
 			return hr; //Stop recording if we fail
 		}
 		else {
-
-			m_FrameDelays.insert(std::pair<wstring, int>(path, m_RenderedFrameCount == 0 ? 0 : (int)durationMs));
-			LOG_TRACE(L"Wrote video slideshow frame with start pos %lld ms and with duration %lld ms", startposMs, durationMs);
+			LOG_TRACE(L"Queued video slideshow frame with start pos %lld ms and with duration %lld ms", startposMs, durationMs);
 		}
 	}
 	else if (recorderMode == RecorderModeInternal::Screenshot) {
@@ -268,10 +917,20 @@ HRESULT OutputManager::RenderFrame(_In_ FrameWriteModel &model) {
 
 HRESULT OutputManager::WriteFrameToImage(_In_ ID3D11Texture2D *pAcquiredDesktopImage, _In_ std::wstring filePath)
 {
+	std::optional<ImageEncoderFormat> builtInFormat = GetSnapshotOptions()->GetBuiltInEncoderFormat();
+	if (builtInFormat.has_value()) {
+		m_ImageEncoder.SetThreadCount(GetSnapshotOptions()->GetEncoderThreadCount());
+		return SaveTextureWithImageEncoderToFile(m_DeviceContext, pAcquiredDesktopImage, builtInFormat.value(), filePath.c_str(), &m_ImageEncoder);
+	}
 	return SaveWICTextureToFile(m_DeviceContext, pAcquiredDesktopImage, GetSnapshotOptions()->GetSnapshotEncoderFormat(), filePath.c_str());
 }
 HRESULT OutputManager::WriteFrameToImage(_In_ ID3D11Texture2D *pAcquiredDesktopImage, _In_ IStream *pStream)
 {
+	std::optional<ImageEncoderFormat> builtInFormat = GetSnapshotOptions()->GetBuiltInEncoderFormat();
+	if (builtInFormat.has_value()) {
+		m_ImageEncoder.SetThreadCount(GetSnapshotOptions()->GetEncoderThreadCount());
+		return SaveTextureWithImageEncoderToStream(m_DeviceContext, pAcquiredDesktopImage, builtInFormat.value(), pStream, &m_ImageEncoder);
+	}
 	return SaveWICTextureToStream(m_DeviceContext, pAcquiredDesktopImage, GetSnapshotOptions()->GetSnapshotEncoderFormat(), pStream);
 }
 HRESULT OutputManager::StartMediaClock()
@@ -310,6 +969,47 @@ HRESULT OutputManager::GetMediaTimeStamp(_Out_ INT64 *pTime)
 	return m_PresentationClock->GetTime(pTime);
 }
 
+HRESULT OutputManager::SetVideoBitrateScale(_In_ double scale)
+{
+	//Kept for the sink writers of later segments.
+	m_VideoBitrateScale = scale;
+	if (!m_SinkWriter) {
+		return S_FALSE;
+	}
+	CComPtr<ICodecAPI> pCodecApi;
+	RETURN_ON_BAD_HR(m_SinkWriter->GetServiceForStream(m_VideoStreamIndex, GUID_NULL, IID_PPV_ARGS(&pCodecApi)));
+	VARIANT value;
+	VariantInit(&value);
+	value.vt = VT_UI4;
+	if (GetEncoderOptions()->GetVideoBitrateMode() == eAVEncCommonRateControlMode_Quality) {
+		value.ulVal = static_cast<ULONG>(max(1.0, round(GetEncoderOptions()->GetVideoQuality() * scale)));
+		return pCodecApi->SetValue(&CODECAPI_AVEncCommonQuality, &value);
+	}
+	value.ulVal = static_cast<ULONG>(round(GetEncoderOptions()->GetVideoBitrate() * scale));
+	return pCodecApi->SetValue(&CODECAPI_AVEncCommonMeanBitRate, &value);
+}
+
+UINT32 OutputManager::GetVideoQueueDepth()
+{
+	if (!m_SinkWriter) {
+		return 0;
+	}
+	MF_SINK_WRITER_STATISTICS stats{};
+	stats.cb = sizeof(stats);
+	if (FAILED(m_SinkWriter->GetStatistics(m_VideoStreamIndex, &stats))) {
+		return 0;
+	}
+	return static_cast<UINT32>(stats.qwNumSamplesReceived - min(stats.qwNumSamplesReceived, stats.qwNumSamplesProcessed));
+}
+
+IN_FLIGHT_STATISTICS OutputManager::GetInFlightStatistics()
+{
+	if (!m_InFlightSamples) {
+		return IN_FLIGHT_STATISTICS{};
+	}
+	return m_InFlightSamples->GetStatistics();
+}
+
 HRESULT OutputManager::ConfigureOutputMediaTypes(
 	_In_ UINT destWidth,
 	_In_ UINT destHeight,
@@ -401,11 +1101,12 @@ HRESULT OutputManager::ConfigureInputMediaTypes(
 }
 
 HRESULT OutputManager::InitializeVideoSinkWriter(
-	_In_ IMFByteStream *pOutStream,
+	_In_opt_ IMFByteStream *pOutStream,
 	_In_ RECT sourceRect,
 	_In_ SIZE outputFrameSize,
 	_In_ DXGI_MODE_ROTATION rotation,
 	_In_ IMFSinkWriterCallback *pCallback,
+	_In_ bool isContinuation,
 	_Outptr_ IMFSinkWriter **ppWriter,
 	_Out_ DWORD *pVideoStreamIndex,
 	_Out_ DWORD *pAudioStreamIndex)
@@ -419,7 +1120,6 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 	CComPtr<IMFMediaType>         pAudioMediaTypeOut = nullptr;
 	CComPtr<IMFMediaType>         pVideoMediaTypeIn = nullptr;
 	CComPtr<IMFMediaType>		  pVideoMediaTypeIntermediate = nullptr;
-	CComPtr<IMFMediaType>		  pVideoMediaTypeTransform = nullptr;
 	CComPtr<IMFMediaType>         pAudioMediaTypeIn = nullptr;
 	CComPtr<IMFAttributes>        pAttributes = nullptr;
 
@@ -449,24 +1149,46 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 	//The source samples have the format ARGB32, but the video encoders need the input to be a YUV format, so we convert ARGB32->NV12->H264/HEVC
 	CopyMediaType(pVideoMediaTypeIn, &pVideoMediaTypeIntermediate);
 	RETURN_ON_BAD_HR(pVideoMediaTypeIntermediate->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_NV12));
-	CopyMediaType(pVideoMediaTypeIntermediate, &pVideoMediaTypeTransform);
-	pVideoMediaTypeTransform->DeleteItem(MF_MT_FRAME_RATE);
-
-	RETURN_ON_BAD_HR(CreateIMFTransform(videoStreamIndex, pVideoMediaTypeIn, pVideoMediaTypeTransform, &m_MediaTransform));
-
-	CComPtr<IMFAttributes> pTransformAttributes;
-	if (SUCCEEDED(m_MediaTransform->GetAttributes(&pTransformAttributes))) {
-		UINT32 d3d11Aware = 0;
-		pTransformAttributes->GetUINT32(MF_SA_D3D11_AWARE, &d3d11Aware);
-		if (d3d11Aware > 0) {
-			HRESULT hr = m_MediaTransform->ProcessMessage(MFT_MESSAGE_SET_D3D_MANAGER, reinterpret_cast<ULONG_PTR>(m_DeviceManager.p));
-			LOG_ON_BAD_HR(hr);
-		}
-	}
+	//Match the range and chroma siting produced by m_NV12Converter, so the encoder signals them correctly.
+	RETURN_ON_BAD_HR(pVideoMediaTypeIntermediate->SetUINT32(MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_16_235));
+	RETURN_ON_BAD_HR(pVideoMediaTypeIntermediate->SetUINT32(MF_MT_VIDEO_CHROMA_SITING, MFVideoChromaSubsampling_MPEG2));
 
 	//Creates a streaming writer
 	CComPtr<IMFMediaSink> pMp4StreamSink = nullptr;
-	if (GetEncoderOptions()->GetIsFragmentedMp4Enabled()) {
+	//The bitstream output only follows the first sink writer, as the recording is not split while it is enabled.
+	std::shared_ptr<BitstreamDispatcher> pDispatcher = isContinuation ? nullptr : m_BitstreamDispatcher;
+	bool isNativeMuxer = pOutStream && (GetEncoderOptions()->GetIsNativeMuxerEnabled() || pDispatcher);
+	if (!pOutStream || isNativeMuxer) {
+		//Without an output stream, the encoded samples are kept in the replay buffer if it is enabled.
+		std::shared_ptr<ReplayBuffer> pReplayBuffer = pOutStream ? nullptr : m_ReplayBuffer;
+		std::shared_ptr<Mp4Muxer> pMuxer = isNativeMuxer ? CreateMp4Muxer(pOutStream, destWidth, destHeight, pAudioMediaTypeOut != nullptr) : nullptr;
+		PacketFinalizeCallback finalizeCallback = nullptr;
+		if (pMuxer) {
+			finalizeCallback = [pMuxer]() {
+				bool isFinalized = pMuxer->Finalize();
+				MP4_MUXER_STATISTICS stats = pMuxer->GetStatistics();
+				LOG_DEBUG(L"MP4 muxer wrote %llu video samples, %llu audio samples and %llu fragments in %llu bytes with %llu writes", stats.VideoSampleCount, stats.AudioSampleCount, stats.FragmentCount, stats.ByteCount, stats.WriteCount);
+				if (!isFinalized) {
+					LOG_ERROR(L"Failed to finalize MP4 file");
+					return E_FAIL;
+				}
+				return S_OK;
+			};
+		}
+		CMFPacketMediaSink *pPacketSink = nullptr;
+		RETURN_ON_BAD_HR(CMFPacketMediaSink::CreateInstance(pVideoMediaTypeOut, pAudioMediaTypeOut, [this, pReplayBuffer, pMuxer, pDispatcher](DWORD streamId, IMFSample *pSample) {
+			WriteEncodedSample(streamId, pSample, pReplayBuffer.get(), pMuxer.get(), pDispatcher.get());
+		}, finalizeCallback, &pPacketSink));
+		pMp4StreamSink.Attach(static_cast<IMFMediaSink *>(pPacketSink));
+		if (!pOutStream) {
+			//SaveReplay reads the media types of the encoded samples from the sink.
+			pPacketSink->AddRef();
+			const std::lock_guard<std::mutex> lock(m_ReplayMutex);
+			m_PacketSink.Release();
+			m_PacketSink.Attach(pPacketSink);
+		}
+	}
+	else if (GetEncoderOptions()->GetIsFragmentedMp4Enabled()) {
 		RETURN_ON_BAD_HR(MFCreateFMPEG4MediaSink(pOutStream, pVideoMediaTypeOut, pAudioMediaTypeOut, &pMp4StreamSink));
 	}
 	else {
@@ -481,6 +1203,19 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 	RETURN_ON_BAD_HR(pAttributes->SetUINT32(MF_LOW_LATENCY, GetEncoderOptions()->GetIsLowLatencyModeEnabled()));
 	RETURN_ON_BAD_HR(pAttributes->SetUINT32(MF_SINK_WRITER_DISABLE_THROTTLING, GetEncoderOptions()->GetIsThrottlingDisabled()));
 	RETURN_ON_BAD_HR(pAttributes->SetUINT32(CODECAPI_AVEncCommonRateControlMode, GetEncoderOptions()->GetVideoBitrateMode()));
+	if (!pOutStream) {
+		//The replay buffer is trimmed by whole groups of pictures, and bitstream consumers can only start decoding at a key frame, so one is forced every 2 seconds.
+		RETURN_ON_BAD_HR(pAttributes->SetUINT32(CODECAPI_AVEncMPVGOPSize, GetEncoderOptions()->GetVideoFps() * 2));
+	}
+	else if (isNativeMuxer && GetEncoderOptions()->GetIsFragmentedMp4Enabled() && GetEncoderOptions()->GetFragmentDuration().count() > 0) {
+		//Fragments start at a key frame, so one is forced for each fragment.
+		UINT32 gopSize = static_cast<UINT32>(max(1LL, GetEncoderOptions()->GetVideoFps() * GetEncoderOptions()->GetFragmentDuration().count() / 1000));
+		RETURN_ON_BAD_HR(pAttributes->SetUINT32(CODECAPI_AVEncMPVGOPSize, gopSize));
+	}
+	if (!pOutStream || isNativeMuxer || pDispatcher) {
+		//The native muxer, the bitstream output and the replay buffer use the presentation timestamps as decoding timestamps, so the frames must not be reordered.
+		RETURN_ON_BAD_HR(pAttributes->SetUINT32(CODECAPI_AVEncMPVDefaultBPictureCount, 0));
+	}
 	switch (GetEncoderOptions()->GetVideoBitrateMode()) {
 		case eAVEncCommonRateControlMode_Quality:
 			RETURN_ON_BAD_HR(pAttributes->SetUINT32(CODECAPI_AVEncCommonQuality, GetEncoderOptions()->GetVideoQuality()));
@@ -503,13 +1238,20 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 		LogMediaType(pVideoMediaTypeOut);
 
 	HRESULT hr = pSinkWriter->SetInputMediaType(videoStreamIndex, m_UseManualNV12Converter ? pVideoMediaTypeIntermediate : pVideoMediaTypeIn, nullptr);
-	if ((FAILED(hr) && !m_UseManualNV12Converter)) {
+	//A continuation must take the same input as the current sink writer, as the frames are already being converted for it.
+	if ((FAILED(hr) && !m_UseManualNV12Converter && !isContinuation)) {
 		m_UseManualNV12Converter = true;
-		m_MediaTransform.Release();
-
-		return InitializeVideoSinkWriter(pOutStream, sourceRect, outputFrameSize, rotation, pCallback, ppWriter, pVideoStreamIndex, pAudioStreamIndex);
+		LOG_INFO(L"Sink writer does not accept ARGB32 input, converting frames to NV12");
+		return InitializeVideoSinkWriter(pOutStream, sourceRect, outputFrameSize, rotation, pCallback, isContinuation, ppWriter, pVideoStreamIndex, pAudioStreamIndex);
 	}
 	RETURN_ON_BAD_HR(hr);
+	if (!isContinuation) {
+		RETURN_ON_BAD_HR(InitializeInFlightTracking());
+	}
+	if (m_UseManualNV12Converter && !isContinuation) {
+		m_NV12Converter.SetOptions(YUVFormat::NV12, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+		RETURN_ON_BAD_HR(InitializeNV12SampleAllocator(pVideoMediaTypeIntermediate));
+	}
 	if (pAudioMediaTypeIn) {
 		RETURN_ON_BAD_HR(pSinkWriter->SetInputMediaType(audioStreamIndex, pAudioMediaTypeIn, nullptr));
 	}
@@ -527,15 +1269,28 @@ HRESULT OutputManager::InitializeVideoSinkWriter(
 
 HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage)
 {
-	//The encoder works async, so the input frame has to be copied, else it can be overwritten before the encoder uses it. See issue #277.
-	CComPtr<ID3D11Texture2D> pFrameCopy;
+	TRACE_SCOPE("WriteVideoSample");
+	MeasureLatency measureLatency(m_VideoWriteLatency);
+	if (m_Sink) {
+		return WriteFrameToSink(frameStartPos, frameDuration, pAcquiredDesktopImage);
+	}
+	if (m_UseManualNV12Converter) {
+		return WriteConvertedFrameToVideo(frameStartPos, frameDuration, streamIndex, pAcquiredDesktopImage);
+	}
 	D3D11_TEXTURE2D_DESC desc;
 	pAcquiredDesktopImage->GetDesc(&desc);
+	UINT64 byteCount = static_cast<UINT64>(desc.Width) * desc.Height * 4;
+	HRESULT hr = WaitForInFlightCapacity(frameStartPos, frameDuration, streamIndex, byteCount);
+	if (hr != S_OK) {
+		return hr;
+	}
+	//The encoder works async, so the input frame has to be copied, else it can be overwritten before the encoder uses it. See issue #277.
+	CComPtr<ID3D11Texture2D> pFrameCopy;
 	m_Device->CreateTexture2D(&desc, nullptr, &pFrameCopy);
 	m_DeviceContext->CopyResource(pFrameCopy, pAcquiredDesktopImage);
 
 	IMFMediaBuffer *pMediaBuffer;
-	HRESULT hr = MFCreateDXGISurfaceBuffer(__uuidof(ID3D11Texture2D), pFrameCopy, 0, FALSE, &pMediaBuffer);
+	hr = MFCreateDXGISurfaceBuffer(__uuidof(ID3D11Texture2D), pFrameCopy, 0, FALSE, &pMediaBuffer);
 	IMF2DBuffer *p2DBuffer;
 	if (SUCCEEDED(hr))
 	{
@@ -550,13 +1305,14 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 	{
 		hr = pMediaBuffer->SetCurrentLength(length);
 	}
-	IMFSample *pSample;
+	IMFSample *pSample = nullptr;
 	if (SUCCEEDED(hr))
 	{
-		hr = MFCreateSample(&pSample);
+		hr = CreateTrackedSample(&pSample);
 	}
 	if (SUCCEEDED(hr))
 	{
+		m_SampleReleaseCallback->OnSampleSubmitted(byteCount);
 		hr = pSample->AddBuffer(pMediaBuffer);
 	}
 	if (SUCCEEDED(hr))
@@ -567,67 +1323,9 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 	{
 		hr = pSample->SetSampleDuration(frameDuration);
 	}
-
 	if (SUCCEEDED(hr))
 	{
-		if (m_UseManualNV12Converter) {
-			//Run media transform to convert sample to MFVideoFormat_NV12
-
-			MFT_OUTPUT_STREAM_INFO info{};
-
-			hr = m_MediaTransform->GetOutputStreamInfo(streamIndex, &info);
-			bool transformProvidesSamples = info.dwFlags & (MFT_OUTPUT_STREAM_PROVIDES_SAMPLES | MFT_OUTPUT_STREAM_CAN_PROVIDE_SAMPLES);
-
-			IMFSample *transformSample = nullptr;
-			IMFMediaBuffer *transformBuffer = nullptr;
-			MFT_OUTPUT_DATA_BUFFER outputDataBuffer;
-			RtlZeroMemory(&outputDataBuffer, sizeof(outputDataBuffer));
-			outputDataBuffer.dwStreamID = streamIndex;
-			{
-				if (SUCCEEDED(hr) && !transformProvidesSamples)
-				{
-					hr = MFCreateMemoryBuffer(info.cbSize, &transformBuffer);
-
-					if (SUCCEEDED(hr))
-					{
-						hr = MFCreateSample(&transformSample);
-					}
-					if (SUCCEEDED(hr)) {
-						hr = transformSample->AddBuffer(transformBuffer);
-					}
-					outputDataBuffer.pSample = transformSample;
-					SafeRelease(&transformBuffer);
-				}
-				if (SUCCEEDED(hr))
-				{
-					hr = m_MediaTransform->ProcessInput(streamIndex, pSample, 0);
-				}
-				if (SUCCEEDED(hr))
-				{
-					DWORD dwDSPStatus = 0;
-					hr = m_MediaTransform->ProcessOutput(0, 1, &outputDataBuffer, &dwDSPStatus);
-				}
-				if (SUCCEEDED(hr)) {
-					transformSample = outputDataBuffer.pSample;
-				}
-			}
-			if (SUCCEEDED(hr))
-			{
-				hr = transformSample->SetSampleTime(frameStartPos);
-			}
-			if (SUCCEEDED(hr))
-			{
-				hr = transformSample->SetSampleDuration(frameDuration);
-			}
-			if (SUCCEEDED(hr))
-			{
-				hr = m_SinkWriter->WriteSample(streamIndex, transformSample);
-			}
-			SafeRelease(&transformSample);
-		}
-		else {
-			hr = m_SinkWriter->WriteSample(streamIndex, pSample);
-		}
+		hr = m_SinkWriter->WriteSample(streamIndex, pSample);
 	}
 	SafeRelease(&pSample);
 	SafeRelease(&p2DBuffer);
@@ -635,8 +1333,247 @@ HRESULT OutputManager::WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 fr
 	return hr;
 }
 
+HRESULT OutputManager::WriteConvertedFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage)
+{
+	D3D11_TEXTURE2D_DESC desc;
+	pAcquiredDesktopImage->GetDesc(&desc);
+	UINT64 byteCount = static_cast<UINT64>(desc.Width) * desc.Height * 3 / 2;
+	//The frames waiting for conversion count towards the limits, so the ones the GPU has finished copying are submitted before the capacity is checked.
+	RETURN_ON_BAD_HR(WritePendingConvertedFrames(false));
+	HRESULT hr = WaitForInFlightCapacity(frameStartPos, frameDuration, streamIndex, byteCount);
+	if (hr != S_OK) {
+		return hr;
+	}
+	if (m_PendingConversions.size() == m_ConversionSlots.size()) {
+		//All staging textures hold frames that are not converted yet, so the oldest one is waited for to free its texture.
+		RETURN_ON_BAD_HR(WriteOldestConvertedFrame(true));
+	}
+	CONVERSION_SLOT &slot = m_ConversionSlots[m_NextConversionSlot];
+	RETURN_ON_BAD_HR(CopyFrameToStagingTexture(pAcquiredDesktopImage, slot.Texture, &desc));
+	slot.FrameStartPos = frameStartPos;
+	slot.FrameDuration = frameDuration;
+	slot.StreamIndex = streamIndex;
+	slot.ByteCount = byteCount;
+	//The frame is only submitted to the encoder once it is converted, so it is counted towards the limits while it waits.
+	m_InFlightSamples->Reserve(byteCount);
+	m_PendingConversions.push_back(m_NextConversionSlot);
+	m_NextConversionSlot = (m_NextConversionSlot + 1) % m_ConversionSlots.size();
+	return WritePendingConvertedFrames(false);
+}
+
+HRESULT OutputManager::WritePendingConvertedFrames(_In_ bool wait)
+{
+	while (!m_PendingConversions.empty()) {
+		HRESULT hr = WriteOldestConvertedFrame(wait);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+			//The copies finish in order, so the newer frames are not ready either.
+			return S_OK;
+		}
+		RETURN_ON_BAD_HR(hr);
+	}
+	return S_OK;
+}
+
+HRESULT OutputManager::WriteOldestConvertedFrame(_In_ bool wait)
+{
+	const CONVERSION_SLOT &slot = m_ConversionSlots[m_PendingConversions.front()];
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	HRESULT hr = m_DeviceContext->Map(slot.Texture, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+	if (hr == DXGI_ERROR_WAS_STILL_DRAWING && !wait) {
+		return hr;
+	}
+	//The frame is not retried if it fails, so a broken frame does not hold up the ones after it.
+	m_PendingConversions.pop_front();
+	if (FAILED(hr)) {
+		m_InFlightSamples->CancelReservation(slot.ByteCount);
+		return hr;
+	}
+	D3D11_TEXTURE2D_DESC desc;
+	slot.Texture->GetDesc(&desc);
+	hr = WriteNV12Sample(slot, desc, mapped);
+	m_DeviceContext->Unmap(slot.Texture, 0);
+	return hr;
+}
+
+void OutputManager::DiscardPendingConversions()
+{
+	for (size_t slotIndex : m_PendingConversions) {
+		m_InFlightSamples->CancelReservation(m_ConversionSlots[slotIndex].ByteCount);
+	}
+	m_PendingConversions.clear();
+}
+
+HRESULT OutputManager::WriteNV12Sample(_In_ const CONVERSION_SLOT &slot, _In_ const D3D11_TEXTURE2D_DESC &desc, _In_ const D3D11_MAPPED_SUBRESOURCE &mapped)
+{
+	//Samples are recycled by the allocator once the encoder releases them. If the encoder holds on to all of them, fall back to a new sample.
+	CComPtr<IMFSample> pSample;
+	CComPtr<IMFMediaBuffer> pNewBuffer;
+	HRESULT hr = m_NV12SampleAllocator->AllocateSample(&pSample);
+	if (hr == MF_E_SAMPLEALLOCATOR_EMPTY) {
+		LOG_TRACE(L"NV12 sample pool is exhausted, allocating a new sample");
+		hr = MFCreate2DMediaBuffer(desc.Width, desc.Height, MFVideoFormat_NV12.Data1, FALSE, &pNewBuffer);
+		if (SUCCEEDED(hr)) {
+			hr = CreateTrackedSample(&pSample);
+		}
+	}
+	if (FAILED(hr)) {
+		m_InFlightSamples->CancelReservation(slot.ByteCount);
+		return hr;
+	}
+	//The sample takes the place of the frame's reservation. Pooled samples are counted as released when the allocator is notified of their return, new ones when the tracked sample is released.
+	m_SampleReleaseCallback->OnSampleSubmitted(slot.ByteCount, true);
+	if (pNewBuffer) {
+		RETURN_ON_BAD_HR(hr = pSample->AddBuffer(pNewBuffer));
+	}
+
+	CComPtr<IMFMediaBuffer> pMediaBuffer;
+	CComPtr<IMF2DBuffer2> p2DBuffer;
+	RETURN_ON_BAD_HR(hr = pSample->GetBufferByIndex(0, &pMediaBuffer));
+	RETURN_ON_BAD_HR(hr = pMediaBuffer->QueryInterface(IID_PPV_ARGS(&p2DBuffer)));
+
+	BYTE *pScanline0 = nullptr;
+	BYTE *pBufferStart = nullptr;
+	LONG pitch = 0;
+	DWORD bufferLength = 0;
+	RETURN_ON_BAD_HR(hr = p2DBuffer->Lock2DSize(MF2DBuffer_LockFlags_Write, &pScanline0, &pitch, &pBufferStart, &bufferLength));
+	YUV_PLANES planes = ColorConverter::GetPlanes(YUVFormat::NV12, pScanline0, desc.Width, desc.Height, pitch);
+	if (!m_NV12Converter.Convert(static_cast<const BYTE *>(mapped.pData), mapped.RowPitch, desc.Width, desc.Height, planes)) {
+		LOG_ERROR(L"Failed to convert frame to NV12");
+		hr = E_FAIL;
+	}
+	p2DBuffer->Unlock2D();
+	RETURN_ON_BAD_HR(hr);
+
+	DWORD length;
+	RETURN_ON_BAD_HR(hr = p2DBuffer->GetContiguousLength(&length));
+	RETURN_ON_BAD_HR(hr = pMediaBuffer->SetCurrentLength(length));
+	RETURN_ON_BAD_HR(hr = pSample->SetSampleTime(slot.FrameStartPos));
+	RETURN_ON_BAD_HR(hr = pSample->SetSampleDuration(slot.FrameDuration));
+	return m_SinkWriter->WriteSample(slot.StreamIndex, pSample);
+}
+
+HRESULT OutputManager::CopyFrameToStagingTexture(_In_ ID3D11Texture2D *pFrame, _Inout_ CComPtr<ID3D11Texture2D> &pStagingTexture, _Out_ D3D11_TEXTURE2D_DESC *pDesc)
+{
+	pFrame->GetDesc(pDesc);
+	if (pStagingTexture) {
+		D3D11_TEXTURE2D_DESC stagingDesc;
+		pStagingTexture->GetDesc(&stagingDesc);
+		if (stagingDesc.Width != pDesc->Width || stagingDesc.Height != pDesc->Height) {
+			pStagingTexture.Release();
+		}
+	}
+	if (!pStagingTexture) {
+		D3D11_TEXTURE2D_DESC stagingDesc = *pDesc;
+		stagingDesc.Usage = D3D11_USAGE_STAGING;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		stagingDesc.BindFlags = 0;
+		stagingDesc.MiscFlags = 0;
+		stagingDesc.MipLevels = 1;
+		stagingDesc.ArraySize = 1;
+		RETURN_ON_BAD_HR(m_Device->CreateTexture2D(&stagingDesc, nullptr, &pStagingTexture));
+	}
+	m_DeviceContext->CopyResource(pStagingTexture, pFrame);
+	return S_OK;
+}
+
+HRESULT OutputManager::BeginSink(_In_ SIZE videoOutputFrameSize)
+{
+	m_Sink = GetOutputOptions()->GetSink();
+	if (!m_Sink) {
+		return S_FALSE;
+	}
+	SINK_VIDEO_FORMAT videoFormat{ videoOutputFrameSize.cx, videoOutputFrameSize.cy, GetEncoderOptions()->GetVideoFps() };
+	std::optional<SINK_AUDIO_FORMAT> audioFormat = std::nullopt;
+	if (GetAudioOptions()->IsAudioEnabled()) {
+		audioFormat = SINK_AUDIO_FORMAT{
+			GetAudioOptions()->GetAudioSamplesPerSecond(),
+			static_cast<uint16_t>(GetAudioOptions()->GetAudioChannels()),
+			static_cast<uint16_t>(GetAudioOptions()->GetAudioBitsPerSample()) };
+	}
+	if (!m_Sink->Begin(videoFormat, audioFormat)) {
+		LOG_ERROR(L"Failed to start output sink");
+		m_Sink.reset();
+		return E_FAIL;
+	}
+	LOG_DEBUG(L"Output sink initialized, encoding is disabled");
+	return S_OK;
+}
+
+HRESULT OutputManager::WriteFrameToSink(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ ID3D11Texture2D *pAcquiredDesktopImage)
+{
+	if (!m_Sink->IsFrameDataRequired()) {
+		return m_Sink->WriteVideoFrame(frameStartPos, frameDuration, nullptr, 0) ? S_OK : E_FAIL;
+	}
+	D3D11_TEXTURE2D_DESC desc;
+	RETURN_ON_BAD_HR(CopyFrameToStagingTexture(pAcquiredDesktopImage, m_StagingTexture, &desc));
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	RETURN_ON_BAD_HR(m_DeviceContext->Map(m_StagingTexture, 0, D3D11_MAP_READ, 0, &mapped));
+	bool isWritten = m_Sink->WriteVideoFrame(frameStartPos, frameDuration, static_cast<const uint8_t *>(mapped.pData), mapped.RowPitch);
+	m_DeviceContext->Unmap(m_StagingTexture, 0);
+	if (!isWritten) {
+		LOG_ERROR(L"Output sink failed to write video frame");
+		return E_FAIL;
+	}
+	return S_OK;
+}
+
+HRESULT OutputManager::InitializeNV12SampleAllocator(_In_ IMFMediaType *pMediaType)
+{
+	if (m_NV12SampleAllocator) {
+		m_NV12SampleAllocator->UninitializeSampleAllocator();
+		m_NV12SampleAllocator.Release();
+	}
+	//Without a device manager, the allocator creates system memory samples that the converter can write to directly.
+	RETURN_ON_BAD_HR(MFCreateVideoSampleAllocatorEx(IID_PPV_ARGS(&m_NV12SampleAllocator)));
+	CComPtr<IMFAttributes> pAttributes;
+	RETURN_ON_BAD_HR(MFCreateAttributes(&pAttributes, 1));
+	RETURN_ON_BAD_HR(m_NV12SampleAllocator->InitializeSampleAllocatorEx(2, 8, pAttributes, pMediaType));
+	CComPtr<IMFVideoSampleAllocatorCallback> pAllocatorCallback;
+	RETURN_ON_BAD_HR(m_NV12SampleAllocator->QueryInterface(IID_PPV_ARGS(&pAllocatorCallback)));
+	return pAllocatorCallback->SetCallback(m_SampleReleaseCallback);
+}
+
+HRESULT OutputManager::InitializeInFlightTracking()
+{
+	//Each sink writer gets its own tracker, as samples of a previous one can still be released after it is replaced.
+	m_InFlightSamples = std::make_shared<InFlightSampleTracker>();
+	m_InFlightSamples->SetLimits(GetEncoderOptions()->GetMaxInFlightFrames(), GetEncoderOptions()->GetMaxInFlightBytes());
+	m_SampleReleaseCallback.Release();
+	m_SampleReleaseCallback.Attach(new (std::nothrow)CMFSampleReleaseCallback(m_InFlightSamples, m_Metrics, m_MetricsPrefix + "encoder.video_latency_us"));
+	return m_SampleReleaseCallback ? S_OK : E_OUTOFMEMORY;
+}
+
+HRESULT OutputManager::WaitForInFlightCapacity(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ UINT64 byteCount)
+{
+	//A frame is waited for at most for its own duration, so a stalled encoder makes the recording drop frames instead of stopping it.
+	std::chrono::milliseconds timeout(0);
+	if (GetEncoderOptions()->GetInFlightFramePolicy() == InFlightFramePolicy::Wait) {
+		timeout = std::chrono::milliseconds(max(1LL, HundredNanosToMillis(frameDuration)));
+	}
+	if (m_InFlightSamples->WaitForCapacity(byteCount, timeout, m_StopEvent)) {
+		return S_OK;
+	}
+	//The frames waiting for conversion were let through before this one, so they are written before the gap is marked, to keep the timestamps in order.
+	RETURN_ON_BAD_HR(WritePendingConvertedFrames(true));
+	RETURN_ON_BAD_HR(m_SinkWriter->SendStreamTick(streamIndex, frameStartPos));
+	return S_FALSE;
+}
+
+HRESULT OutputManager::CreateTrackedSample(_Outptr_ IMFSample **ppSample)
+{
+	CComPtr<IMFTrackedSample> pTrackedSample;
+	RETURN_ON_BAD_HR(MFCreateTrackedSample(&pTrackedSample));
+	RETURN_ON_BAD_HR(pTrackedSample->SetAllocator(m_SampleReleaseCallback, nullptr));
+	return pTrackedSample->QueryInterface(IID_PPV_ARGS(ppSample));
+}
+
 HRESULT OutputManager::WriteAudioSamplesToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ BYTE *pSrc, _In_ DWORD cbData)
 {
+	TRACE_SCOPE("WriteAudioSample");
+	MeasureLatency measureLatency(m_AudioWriteLatency);
+	if (m_Sink) {
+		return m_Sink->WriteAudio(frameStartPos, pSrc, cbData) ? S_OK : E_FAIL;
+	}
 	IMFMediaBuffer *pBuffer = nullptr;
 	BYTE *pData = nullptr;
 	// Create the media buffer.
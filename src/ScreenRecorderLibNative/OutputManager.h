@@ -4,9 +4,20 @@
 #include "Util.h"
 #include "MF.util.h"
 #include "CMFSinkWriterCallback.h"
+#include "CMFSampleReleaseCallback.h"
+#include "CMFPacketMediaSink.h"
+#include "CBufferedWriteStream.h"
 #include "cleanup.h"
-#include "fifo_map.h"
+#include "ColorConverter.h"
+#include "SlideshowWriter.h"
+#include "ReplayBuffer.h"
+#include "Mp4Muxer.h"
+#include "BitstreamDispatcher.h"
+#include "SegmentPolicy.h"
 #include <mfreadwrite.h>
+#include <functional>
+#include <thread>
+#include <deque>
 
 struct FrameWriteModel
 {
@@ -14,12 +25,31 @@ struct FrameWriteModel
 	INT64 StartPos;
 	//Duration of the frame, in 100 nanosecond units.
 	INT64 Duration;
+	//Timestamp of the start of the audio, in 100 nanosecond units. It is before StartPos when frames were dropped before this one, so the audio stays continuous.
+	INT64 AudioStartPos;
+	//Duration of the audio, in 100 nanosecond units. Usually ends with the frame, but it does not have to, e.g. when frames are skipped for an output with a lower frame rate.
+	INT64 AudioDuration;
 	//The audio sample bytes for this frame.
 	std::vector<BYTE> Audio;
-	//The frame texture.
+	//The frame texture. If null, only the audio is written.
 	CComPtr<ID3D11Texture2D> Frame;
 };
 
+struct RECORDING_SEGMENT
+{
+	//The index of the segment, starting at 0.
+	UINT32 Index;
+	std::wstring Path;
+	//Timestamp of the recording where the segment starts, in 100 nanosecond units. Timestamps in the segment file start at 0.
+	INT64 StartPos;
+	//Duration of the segment, in 100 nanosecond units.
+	INT64 Duration;
+	//The result of finalizing the segment file.
+	HRESULT Result;
+};
+
+typedef std::function<void(const RECORDING_SEGMENT &segment)> SegmentCompletedCallback;
+
 class OutputManager
 {
 public:
@@ -31,7 +61,8 @@ public:
 		_In_ std::shared_ptr<ENCODER_OPTIONS> &pEncoderOptions,
 		_In_ std::shared_ptr<AUDIO_OPTIONS> pAudioOptions,
 		_In_ std::shared_ptr<SNAPSHOT_OPTIONS> pSnapshotOptions,
-		_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions);
+		_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
+		_In_ std::shared_ptr<MetricsRegistry> pMetrics);
 
 	HRESULT BeginRecording(_In_ std::wstring outputPath, _In_ SIZE videoOutputFrameSizer);
 	HRESULT BeginRecording(_In_ IStream *pStream, _In_ SIZE videoOutputFrameSize);
@@ -39,16 +70,74 @@ public:
 	HRESULT RenderFrame(_In_ FrameWriteModel &model);
 	HRESULT WriteFrameToImage(_In_ ID3D11Texture2D *pAcquiredDesktopImage, _In_ std::wstring filePath);
 	HRESULT WriteFrameToImage(_In_ ID3D11Texture2D *pAcquiredDesktopImage, _In_ IStream *pStream);
-	inline nlohmann::fifo_map<std::wstring, int> GetFrameDelays() { return m_FrameDelays; }
+	/// <summary>
+	/// The path of the manifest listing the slideshow frames and their delays, or an empty string if not recording a slideshow.
+	/// </summary>
+	inline std::wstring GetSlideshowManifestPath() { return m_SlideshowWriter ? m_SlideshowWriter->GetManifestPath() : L""; }
 	inline UINT64 GetRenderedFrameCount() { return m_RenderedFrameCount; }
 	HRESULT StartMediaClock();
 	HRESULT ResumeMediaClock();
 	HRESULT PauseMediaClock();
 	HRESULT StopMediaClock();
 	HRESULT GetMediaTimeStamp(_Out_ INT64 *pTime);
+	/// <summary>
+	/// Sets a prefix for the names of the metrics of this output manager, to tell them apart from those of other outputs. Must be set before Initialize.
+	/// </summary>
+	void SetMetricsPrefix(_In_ std::string prefix) { m_MetricsPrefix = prefix; }
+	/// <summary>
+	/// Sets the callback that is called when a segment file of a segmented recording is finished. It is called on a background thread, except for the last segment.
+	/// </summary>
+	void SetSegmentCompletedCallback(_In_ SegmentCompletedCallback callback) { m_SegmentCompletedCallback = callback; }
+	/// <summary>
+	/// Sets the callback that receives the encoded packets when the bitstream output is enabled in the output options. It is called on a delivery thread. Must be set before the recording starts.
+	/// </summary>
+	void SetBitstreamCallback(_In_ BitstreamCallback callback) { m_BitstreamCallback = callback; }
+	/// <summary>
+	/// Sets the event that is set when the recording stops. It ends the waits for the encoder to release frames, so a stalled encoder does not hold up the stop, and frames that do not fit after it is set are dropped.
+	/// The event must outlive the output manager.
+	/// </summary>
+	void SetStopEvent(_In_ SyncEvent *pStopEvent) { m_StopEvent = pStopEvent; }
 	bool isMediaClockRunning();
 	bool isMediaClockPaused();
+	/// <summary>
+	/// Changes the bitrate of the video encoder during recording to a fraction of the configured bitrate, or of the configured quality with quality based rate control.
+	/// </summary>
+	/// <returns>S_FALSE if there is no encoder to change, or an error if the encoder does not support the change</returns>
+	HRESULT SetVideoBitrateScale(_In_ double scale);
+	/// <summary>
+	/// The number of video frames written to the sink writer that it has not yet passed on to the media sink.
+	/// </summary>
+	UINT32 GetVideoQueueDepth();
+	/// <summary>
+	/// The video frames written to the encoder that it has not released yet.
+	/// </summary>
+	IN_FLIGHT_STATISTICS GetInFlightStatistics();
+	/// <summary>
+	/// Writes the encoded video and audio in the replay buffer to an MP4 file, without encoding it again. Can be called from any thread during recording, and after it until the next recording.
+	/// </summary>
+	/// <returns>E_NOT_VALID_STATE if the replay buffer is not enabled or has no frames yet.</returns>
+	HRESULT SaveReplay(_In_ std::wstring path);
+	HRESULT SaveReplay(_In_ IStream *pStream);
+	REPLAY_BUFFER_STATISTICS GetReplayStatistics();
 private:
+	struct SINK_WRITER_SEGMENT
+	{
+		std::wstring Path;
+		CComPtr<IStream> FileStream;
+		CComPtr<IMFSinkWriter> SinkWriter;
+		CComPtr<IMFSinkWriterCallback> Callback;
+		HANDLE FinalizeEvent;
+	};
+	struct CONVERSION_SLOT
+	{
+		CComPtr<ID3D11Texture2D> Texture;
+		INT64 FrameStartPos;
+		INT64 FrameDuration;
+		DWORD StreamIndex;
+		//The size of the frame reserved with the in-flight tracker, so frames waiting for conversion count towards the limits.
+		UINT64 ByteCount;
+	};
+
 	ID3D11DeviceContext *m_DeviceContext = nullptr;
 	ID3D11Device *m_Device = nullptr;
 
@@ -59,15 +148,42 @@ private:
 	std::shared_ptr<AUDIO_OPTIONS> m_AudioOptions;
 	std::shared_ptr<SNAPSHOT_OPTIONS> m_SnapshotOptions;
 	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	std::string m_MetricsPrefix;
+	MetricHistogram *m_VideoWriteLatency;
+	MetricHistogram *m_AudioWriteLatency;
+	MetricCounter *m_VideoSampleCount;
+	MetricCounter *m_AudioSampleCount;
+	MetricCounter *m_AudioPaddingCount;
+	MetricCounter *m_DroppedVideoSampleCount;
+	MetricGauge *m_InFlightVideoSampleCount;
+	MetricGauge *m_ReplayByteCount;
+	MetricGauge *m_ReplayDuration;
 
-	nlohmann::fifo_map<std::wstring, int> m_FrameDelays;
+	std::unique_ptr<SlideshowWriter> m_SlideshowWriter;
 
 	CComPtr<IMFSinkWriter> m_SinkWriter;
 	CComPtr<IMFSinkWriterCallback> m_CallBack;
-	CComPtr<IMFTransform> m_MediaTransform;
+	CComPtr<IMFVideoSampleAllocatorEx> m_NV12SampleAllocator;
+	std::shared_ptr<InFlightSampleTracker> m_InFlightSamples;
+	SyncEvent *m_StopEvent;
+	CComPtr<CMFSampleReleaseCallback> m_SampleReleaseCallback;
+	CComPtr<ID3D11Texture2D> m_StagingTexture;
+	//Frames copied to staging textures for the CPU conversion to NV12. They are converted once the GPU has finished the copy, oldest first, so the recording thread does not wait for it.
+	std::vector<CONVERSION_SLOT> m_ConversionSlots;
+	std::deque<size_t> m_PendingConversions;
+	size_t m_NextConversionSlot;
+	static const size_t CONVERSION_SLOT_COUNT = 3;
+	std::shared_ptr<OutputSink> m_Sink;
+	ColorConverter m_NV12Converter;
+	ImageEncoder m_ImageEncoder;
 	CComPtr<IMFDXGIDeviceManager> m_DeviceManager;
 	UINT m_ResetToken;
 	IStream *m_OutStream;
+	//Batches the writes of the sink writer to the output stream. Closed when the recording is finalized.
+	CComPtr<CBufferedWriteStream> m_BufferedOutStream;
+	//The sink writer fills one buffer while the others wait for the output stream, which absorbs short stalls of the stream.
+	static const size_t STREAM_WRITE_BUFFER_COUNT = 4;
 	DWORD m_VideoStreamIndex;
 	DWORD m_AudioStreamIndex;
 	HANDLE m_FinalizeEvent;
@@ -76,8 +192,37 @@ private:
 	bool m_LastFrameHadAudio;
 	UINT64 m_RenderedFrameCount;
 	std::chrono::steady_clock::time_point m_PreviousSnapshotTaken;
-	CRITICAL_SECTION m_CriticalSection;
+	SyncMutex m_Mutex;
 	bool m_UseManualNV12Converter;
+	SIZE m_VideoOutputFrameSize;
+	double m_VideoBitrateScale;
+
+	//The segment of a segmented recording that is written to.
+	RECORDING_SEGMENT m_Segment;
+	CComPtr<IStream> m_SegmentFileStream;
+	SegmentPolicy m_SegmentPolicy;
+	//The end of the last frame or audio written to the segment.
+	INT64 m_SegmentEndPos;
+	//Subtracted from all timestamps, so each segment file starts at 0.
+	INT64 m_SegmentTimeOffset;
+	bool m_IsSegmentationFailed;
+	SegmentCompletedCallback m_SegmentCompletedCallback;
+	//Creates the sink writer of the next segment ahead of time. It is only accessed after joining the thread.
+	std::thread m_PrepareSegmentThread;
+	std::unique_ptr<SINK_WRITER_SEGMENT> m_NextSegment;
+	HRESULT m_NextSegmentResult;
+	std::thread m_FinalizeSegmentThread;
+
+	//Guards the replay buffer and media sink, which are read by SaveReplay on other threads.
+	std::mutex m_ReplayMutex;
+	std::shared_ptr<ReplayBuffer> m_ReplayBuffer;
+	CComPtr<CMFPacketMediaSink> m_PacketSink;
+	//The parameter sets of the first video key frame, for encoders that do not put them in the output media type.
+	std::vector<BYTE> m_ReplaySequenceHeader;
+
+	BitstreamCallback m_BitstreamCallback;
+	//Passes the encoded packets of the current recording to the bitstream callback. Created when the recording starts.
+	std::shared_ptr<BitstreamDispatcher> m_BitstreamDispatcher;
 
 	std::shared_ptr<AUDIO_OPTIONS> GetAudioOptions() { return m_AudioOptions; }
 	std::shared_ptr<ENCODER_OPTIONS> GetEncoderOptions() { return m_EncoderOptions; }
@@ -86,9 +231,120 @@ private:
 
 	HRESULT ConfigureOutputMediaTypes(_In_ UINT destWidth, _In_ UINT destHeight, _Outptr_ IMFMediaType **pVideoMediaTypeOut, _Outptr_result_maybenull_ IMFMediaType **pAudioMediaTypeOut);
 	HRESULT ConfigureInputMediaTypes(_In_ UINT sourceWidth, _In_ UINT sourceHeight, _In_ MFVideoRotationFormat rotationFormat, _In_ IMFMediaType *pVideoMediaTypeOut, _Outptr_ IMFMediaType **pVideoMediaTypeIn, _Outptr_result_maybenull_ IMFMediaType **pAudioMediaTypeIn);
-	HRESULT InitializeVideoSinkWriter(_In_ IMFByteStream *pOutStream, _In_ RECT sourceRect, _In_ SIZE outputFrameSize, _In_ DXGI_MODE_ROTATION rotation, _In_ IMFSinkWriterCallback *pCallback, _Outptr_ IMFSinkWriter **ppWriter, _Out_ DWORD *pVideoStreamIndex, _Out_ DWORD *pAudioStreamIndex);
+	/// <param name="pOutStream">The stream to write the MP4 file to. If null, the encoded samples are only added to the replay buffer and the bitstream output.</param>
+	/// <param name="isContinuation">If true, the sink writer continues the recording of the current one, and shares its in-flight tracking and sample allocator.</param>
+	HRESULT InitializeVideoSinkWriter(_In_opt_ IMFByteStream *pOutStream, _In_ RECT sourceRect, _In_ SIZE outputFrameSize, _In_ DXGI_MODE_ROTATION rotation, _In_ IMFSinkWriterCallback *pCallback, _In_ bool isContinuation, _Outptr_ IMFSinkWriter **ppWriter, _Out_ DWORD *pVideoStreamIndex, _Out_ DWORD *pAudioStreamIndex);
+	/// <summary>
+	/// Creates the file at the path and a sink writer that writes to it.
+	/// </summary>
+	HRESULT CreateFileSinkWriter(_In_ std::wstring path, _In_ SIZE outputFrameSize, _In_ IMFSinkWriterCallback *pCallback, _In_ bool isContinuation, _Outptr_ IStream **ppFileStream, _Outptr_ IMFSinkWriter **ppWriter);
+	/// <summary>
+	/// Finalizes the sink writer, releases it and shuts down its media sink, and waits for the file to be readable.
+	/// </summary>
+	HRESULT FinalizeSinkWriter(_Inout_ CComPtr<IMFSinkWriter> &pSinkWriter, _In_ HANDLE finalizeEvent, _In_ std::wstring path);
+	bool IsSegmentationActive();
+	bool IsReplayBufferActive();
+	bool IsBitstreamOutputActive();
+	/// <summary>
+	/// Creates the bitstream dispatcher of a new recording if the bitstream output is active, and stops the one of the previous recording.
+	/// </summary>
+	void BeginBitstreamOutput();
+	/// <summary>
+	/// Starts a recording that is not written to a file, where the encoded samples only go to the replay buffer and the bitstream output.
+	/// </summary>
+	HRESULT BeginPacketOutput(_In_ SIZE videoOutputFrameSize);
+	std::shared_ptr<Mp4Muxer> CreateMp4Muxer(_In_ IMFByteStream *pOutStream, _In_ UINT width, _In_ UINT height, _In_ bool hasAudio);
+	/// <summary>
+	/// Passes an encoded sample from the packet media sink to the muxer, the replay buffer and the bitstream output, whichever are set. Called on a Media Foundation thread.
+	/// </summary>
+	void WriteEncodedSample(_In_ DWORD streamId, _In_ IMFSample *pSample, _In_opt_ ReplayBuffer *pReplayBuffer, _In_opt_ Mp4Muxer *pMuxer, _In_opt_ BitstreamDispatcher *pDispatcher);
+	void AddReplayPacket(_In_ ReplayBuffer *pBuffer, _In_ ENCODED_PACKET packet);
+	/// <summary>
+	/// Starts creating the sink writer of the next segment on a background thread.
+	/// </summary>
+	void PrepareNextSegment();
+	/// <summary>
+	/// Starts a new segment if the current one is full, else prepares the next segment when the current one is close to full.
+	/// Called before the frame is written, so the frame is the first of the new segment, which makes it a keyframe.
+	/// </summary>
+	HRESULT UpdateSegment(_In_ const FrameWriteModel &model);
+	/// <summary>
+	/// Switches to the sink writer of the next segment, and finalizes the current one on a background thread.
+	/// </summary>
+	HRESULT StartNextSegment(_In_ INT64 startPos);
+	/// <summary>
+	/// Stops the background threads of a segmented recording, and discards the next segment if it was never written to.
+	/// </summary>
+	void StopSegmentThreads();
 	HRESULT WriteFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage);
+	/// <summary>
+	/// Converts the frame to NV12 on the CPU and writes it to the sink writer. Used when the sink writer does not accept ARGB32 input.
+	/// </summary>
+	HRESULT WriteConvertedFrameToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ ID3D11Texture2D *pAcquiredDesktopImage);
+	/// <summary>
+	/// Converts the frames waiting in the staging textures and writes them to the sink writer, oldest first.
+	/// </summary>
+	/// <param name="wait">If true, waits for the GPU to finish copying the frames. Else stops at the first frame that is not copied yet.</param>
+	HRESULT WritePendingConvertedFrames(_In_ bool wait);
+	/// <summary>
+	/// Converts the oldest frame waiting in the staging textures and writes it to the sink writer.
+	/// </summary>
+	/// <returns>DXGI_ERROR_WAS_STILL_DRAWING if wait is false and the GPU has not finished copying the frame, which then stays pending.</returns>
+	HRESULT WriteOldestConvertedFrame(_In_ bool wait);
+	/// <summary>
+	/// Discards the frames waiting in the staging textures, and cancels their reservations with the in-flight tracker.
+	/// </summary>
+	void DiscardPendingConversions();
+	HRESULT WriteNV12Sample(_In_ const CONVERSION_SLOT &slot, _In_ const D3D11_TEXTURE2D_DESC &desc, _In_ const D3D11_MAPPED_SUBRESOURCE &mapped);
+	HRESULT InitializeNV12SampleAllocator(_In_ IMFMediaType *pMediaType);
+	/// <summary>
+	/// Starts counting the video samples held by the encoder for a new sink writer, with the limits from the encoder options.
+	/// </summary>
+	HRESULT InitializeInFlightTracking();
+	/// <summary>
+	/// Waits until the encoder has room for another video sample, as set by the in-flight limits and policy.
+	/// If the sample must be dropped, a stream tick is sent in its place, so the sink writer knows the gap is intended.
+	/// </summary>
+	/// <returns>S_OK if the sample can be written, S_FALSE if it was dropped</returns>
+	HRESULT WaitForInFlightCapacity(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ UINT64 byteCount);
+	/// <summary>
+	/// Creates a sample that is counted as released by the in-flight tracking when the encoder releases it.
+	/// </summary>
+	HRESULT CreateTrackedSample(_Outptr_ IMFSample **ppSample);
+	/// <summary>
+	/// Copies the frame to a CPU readable staging texture, which is created or recreated if the frame size changes.
+	/// </summary>
+	HRESULT CopyFrameToStagingTexture(_In_ ID3D11Texture2D *pFrame, _Inout_ CComPtr<ID3D11Texture2D> &pStagingTexture, _Out_ D3D11_TEXTURE2D_DESC *pDesc);
+	/// <summary>
+	/// Starts the output sink set in the output options, if any, in place of the sink writer.
+	/// </summary>
+	/// <returns>S_OK if the sink was started, S_FALSE if no sink is set, else a failure code</returns>
+	HRESULT BeginSink(_In_ SIZE videoOutputFrameSize);
+	HRESULT WriteFrameToSink(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ ID3D11Texture2D *pAcquiredDesktopImage);
 
 	HRESULT WriteAudioSamplesToVideo(_In_ INT64 frameStartPos, _In_ INT64 frameDuration, _In_ DWORD streamIndex, _In_ BYTE *pSrc, _In_ DWORD cbData);
 };
 
+/// <summary>
+/// A frame scheduler clock on the media clock of the output manager, so the schedule stands still while the recording is paused.
+/// </summary>
+class MediaFrameSchedulerClock : public FrameSchedulerClock
+{
+public:
+	MediaFrameSchedulerClock(_In_ OutputManager *pOutputManager) :
+		m_OutputManager(pOutputManager),
+		m_LastTime(0)
+	{
+	}
+	virtual int64_t GetTime() override {
+		INT64 time;
+		if (SUCCEEDED(m_OutputManager->GetMediaTimeStamp(&time))) {
+			m_LastTime = time;
+		}
+		return m_LastTime;
+	}
+private:
+	OutputManager *m_OutputManager;
+	INT64 m_LastTime;
+};
+
@@ -0,0 +1,229 @@
+#include "OutputSink.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+	void WriteLittleEndian(std::ofstream &stream, uint32_t value, int byteCount) {
+		for (int i = 0; i < byteCount; i++) {
+			stream.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	//The RIFF sizes are 32 bit, so longer recordings are truncated in the header, as most readers then use the file size.
+	uint32_t ClampToRiffSize(uint64_t size) {
+		return static_cast<uint32_t>((std::min)(size, static_cast<uint64_t>(UINT32_MAX - 36)));
+	}
+}
+
+NullSink::NullSink() :
+	m_Statistics{},
+	m_FirstFrameTime{}
+{
+}
+
+bool NullSink::Begin(const SINK_VIDEO_FORMAT & /*videoFormat*/, const std::optional<SINK_AUDIO_FORMAT> & /*audioFormat*/)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Statistics = {};
+	return true;
+}
+
+bool NullSink::WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t * /*pData*/, int32_t /*stride*/)
+{
+	const auto now = std::chrono::steady_clock::now();
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_Statistics.VideoFrameCount == 0) {
+		m_FirstFrameTime = now;
+		m_Statistics.FirstTimestamp = timestamp;
+	}
+	m_Statistics.VideoFrameCount++;
+	m_Statistics.LastTimestamp = timestamp + duration;
+	m_Statistics.ElapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_FirstFrameTime).count() / 100;
+	return true;
+}
+
+bool NullSink::WriteAudio(int64_t /*timestamp*/, const uint8_t * /*pData*/, size_t size)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Statistics.AudioByteCount += size;
+	return true;
+}
+
+NULL_SINK_STATISTICS NullSink::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Statistics;
+}
+
+MemorySink::MemorySink(size_t maxFrameCount) :
+	m_MaxFrameCount(maxFrameCount),
+	m_VideoFormat{},
+	m_AudioFormat(std::nullopt),
+	m_Frames{},
+	m_Audio{},
+	m_VideoFrameCount(0)
+{
+}
+
+bool MemorySink::Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_VideoFormat = videoFormat;
+	m_AudioFormat = audioFormat;
+	m_Frames.clear();
+	m_Audio.clear();
+	m_VideoFrameCount = 0;
+	return true;
+}
+
+bool MemorySink::WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t *pData, int32_t stride)
+{
+	if (!pData) {
+		return false;
+	}
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_VideoFrameCount++;
+	if (m_MaxFrameCount > 0 && m_Frames.size() >= m_MaxFrameCount) {
+		return true;
+	}
+	const size_t rowSize = static_cast<size_t>(m_VideoFormat.Width) * 4;
+	SINK_VIDEO_FRAME frame{ timestamp, duration, std::vector<uint8_t>(rowSize * m_VideoFormat.Height) };
+	for (int32_t y = 0; y < m_VideoFormat.Height; y++) {
+		memcpy(frame.Data.data() + y * rowSize, pData + static_cast<int64_t>(y) * stride, rowSize);
+	}
+	m_Frames.push_back(std::move(frame));
+	return true;
+}
+
+bool MemorySink::WriteAudio(int64_t /*timestamp*/, const uint8_t *pData, size_t size)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Audio.insert(m_Audio.end(), pData, pData + size);
+	return true;
+}
+
+SINK_VIDEO_FORMAT MemorySink::GetVideoFormat()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_VideoFormat;
+}
+
+std::optional<SINK_AUDIO_FORMAT> MemorySink::GetAudioFormat()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_AudioFormat;
+}
+
+std::vector<SINK_VIDEO_FRAME> MemorySink::GetFrames()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Frames;
+}
+
+std::vector<uint8_t> MemorySink::GetAudio()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Audio;
+}
+
+uint64_t MemorySink::GetVideoFrameCount()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_VideoFrameCount;
+}
+
+RawFileSink::RawFileSink(const std::filesystem::path &videoPath, const std::filesystem::path &audioPath) :
+	m_VideoPath(videoPath),
+	m_AudioPath(audioPath),
+	m_VideoFormat{},
+	m_AudioByteCount(0),
+	m_Converter{}
+{
+	m_Converter.SetOptions(YUVFormat::I420, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+}
+
+RawFileSink::~RawFileSink()
+{
+	Finalize();
+}
+
+bool RawFileSink::Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat)
+{
+	Finalize();
+	m_VideoFormat = videoFormat;
+	m_AudioByteCount = 0;
+	m_VideoFile.open(m_VideoPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_VideoFile.is_open()) {
+		return false;
+	}
+	m_VideoFile << "YUV4MPEG2 W" << videoFormat.Width << " H" << videoFormat.Height
+		<< " F" << (std::max)(videoFormat.FrameRate, 1u) << ":1 Ip A1:1 C420mpeg2 XCOLORRANGE=LIMITED\n";
+
+	if (audioFormat.has_value() && !m_AudioPath.empty()) {
+		m_AudioFile.open(m_AudioPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_AudioFile.is_open()) {
+			return false;
+		}
+		const SINK_AUDIO_FORMAT &format = audioFormat.value();
+		const uint32_t blockAlign = format.Channels * format.BitsPerSample / 8;
+		//The RIFF and data sizes are written when the sink is finalized.
+		m_AudioFile.write("RIFF", 4);
+		WriteLittleEndian(m_AudioFile, 0, 4);
+		m_AudioFile.write("WAVEfmt ", 8);
+		WriteLittleEndian(m_AudioFile, 16, 4);
+		WriteLittleEndian(m_AudioFile, 1, 2);
+		WriteLittleEndian(m_AudioFile, format.Channels, 2);
+		WriteLittleEndian(m_AudioFile, format.SamplesPerSecond, 4);
+		WriteLittleEndian(m_AudioFile, format.SamplesPerSecond * blockAlign, 4);
+		WriteLittleEndian(m_AudioFile, blockAlign, 2);
+		WriteLittleEndian(m_AudioFile, format.BitsPerSample, 2);
+		m_AudioFile.write("data", 4);
+		WriteLittleEndian(m_AudioFile, 0, 4);
+	}
+	return m_VideoFile.good() && (!m_AudioFile.is_open() || m_AudioFile.good());
+}
+
+bool RawFileSink::WriteVideoFrame(int64_t /*timestamp*/, int64_t /*duration*/, const uint8_t *pData, int32_t stride)
+{
+	if (!pData || !m_VideoFile.is_open()) {
+		return false;
+	}
+	size_t size;
+	const uint8_t *pConverted = m_Converter.Convert(pData, stride, m_VideoFormat.Width, m_VideoFormat.Height, &size);
+	if (!pConverted) {
+		return false;
+	}
+	m_VideoFile.write("FRAME\n", 6);
+	m_VideoFile.write(reinterpret_cast<const char *>(pConverted), size);
+	return m_VideoFile.good();
+}
+
+bool RawFileSink::WriteAudio(int64_t /*timestamp*/, const uint8_t *pData, size_t size)
+{
+	if (!m_AudioFile.is_open()) {
+		return true;
+	}
+	m_AudioFile.write(reinterpret_cast<const char *>(pData), size);
+	m_AudioByteCount += size;
+	return m_AudioFile.good();
+}
+
+bool RawFileSink::Finalize()
+{
+	bool isSuccess = true;
+	if (m_VideoFile.is_open()) {
+		m_VideoFile.close();
+		isSuccess = !m_VideoFile.fail();
+	}
+	if (m_AudioFile.is_open()) {
+		const uint32_t dataSize = ClampToRiffSize(m_AudioByteCount);
+		m_AudioFile.seekp(4);
+		WriteLittleEndian(m_AudioFile, 36 + dataSize, 4);
+		m_AudioFile.seekp(40);
+		WriteLittleEndian(m_AudioFile, dataSize, 4);
+		m_AudioFile.close();
+		isSuccess = isSuccess && !m_AudioFile.fail();
+	}
+	return isSuccess;
+}
\ No newline at end of file
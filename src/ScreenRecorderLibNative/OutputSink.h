@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include "ColorConverter.h"
+
+struct SINK_VIDEO_FORMAT {
+	int32_t Width;
+	int32_t Height;
+	//The nominal frame rate. Frames may still have variable durations.
+	uint32_t FrameRate;
+};
+
+struct SINK_AUDIO_FORMAT {
+	uint32_t SamplesPerSecond;
+	uint16_t Channels;
+	uint16_t BitsPerSample;
+};
+
+/// <summary>
+/// A destination for recorded video frames and audio, used in place of the Media Foundation sink writer.
+/// Video frames are 32bpp BGRA, and audio is interleaved PCM. Timestamps and durations are in 100 nanosecond units.
+/// Calls are made from the recording thread, one at a time.
+/// </summary>
+class OutputSink
+{
+public:
+	virtual ~OutputSink() {}
+	/// <returns>false if the sink could not be started, else true</returns>
+	virtual bool Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat) = 0;
+	/// <summary>
+	/// If false, frames are not copied from the GPU, and WriteVideoFrame is called with no pixel data.
+	/// </summary>
+	virtual bool IsFrameDataRequired() = 0;
+	virtual bool WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t *pData, int32_t stride) = 0;
+	virtual bool WriteAudio(int64_t timestamp, const uint8_t *pData, size_t size) = 0;
+	virtual bool Finalize() = 0;
+};
+
+struct NULL_SINK_STATISTICS {
+	uint64_t VideoFrameCount;
+	uint64_t AudioByteCount;
+	//The timestamp of the first frame, in 100 nanosecond units.
+	int64_t FirstTimestamp;
+	//The end of the last frame, in 100 nanosecond units.
+	int64_t LastTimestamp;
+	//The wall clock time from the first to the last frame being written, in 100 nanosecond units.
+	int64_t ElapsedTime;
+};
+
+/// <summary>
+/// Discards all frames and audio, only counting and timestamping them, to measure capture and composition throughput without encoding.
+/// </summary>
+class NullSink : public OutputSink
+{
+public:
+	NullSink();
+	virtual bool Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat) override;
+	virtual bool IsFrameDataRequired() override { return false; }
+	virtual bool WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t *pData, int32_t stride) override;
+	virtual bool WriteAudio(int64_t timestamp, const uint8_t *pData, size_t size) override;
+	virtual bool Finalize() override { return true; }
+	/// <summary>
+	/// Can be called during recording.
+	/// </summary>
+	NULL_SINK_STATISTICS GetStatistics();
+private:
+	std::mutex m_Mutex;
+	NULL_SINK_STATISTICS m_Statistics;
+	std::chrono::steady_clock::time_point m_FirstFrameTime;
+};
+
+struct SINK_VIDEO_FRAME {
+	int64_t Timestamp;
+	int64_t Duration;
+	//Tightly packed BGRA pixels, with a stride of Width * 4.
+	std::vector<uint8_t> Data;
+};
+
+/// <summary>
+/// Keeps the raw frames and PCM audio in memory, so tests can make assertions on the recorded content.
+/// </summary>
+class MemorySink : public OutputSink
+{
+public:
+	/// <param name="maxFrameCount">The number of frames to keep. Frames after that are counted but not kept. 0 keeps all frames.</param>
+	MemorySink(size_t maxFrameCount = 0);
+	virtual bool Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat) override;
+	virtual bool IsFrameDataRequired() override { return true; }
+	virtual bool WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t *pData, int32_t stride) override;
+	virtual bool WriteAudio(int64_t timestamp, const uint8_t *pData, size_t size) override;
+	virtual bool Finalize() override { return true; }
+
+	SINK_VIDEO_FORMAT GetVideoFormat();
+	std::optional<SINK_AUDIO_FORMAT> GetAudioFormat();
+	std::vector<SINK_VIDEO_FRAME> GetFrames();
+	std::vector<uint8_t> GetAudio();
+	uint64_t GetVideoFrameCount();
+private:
+	std::mutex m_Mutex;
+	size_t m_MaxFrameCount;
+	SINK_VIDEO_FORMAT m_VideoFormat;
+	std::optional<SINK_AUDIO_FORMAT> m_AudioFormat;
+	std::vector<SINK_VIDEO_FRAME> m_Frames;
+	std::vector<uint8_t> m_Audio;
+	uint64_t m_VideoFrameCount;
+};
+
+/// <summary>
+/// Writes the raw video to a Y4M file as 8 bit 4:2:0, and the audio to a WAV file, so the output can be inspected without decoding.
+/// Y4M has no timestamps, so each frame is written once and plays back at the nominal frame rate.
+/// </summary>
+class RawFileSink : public OutputSink
+{
+public:
+	/// <param name="audioPath">The WAV file to write. If empty, audio is discarded.</param>
+	RawFileSink(const std::filesystem::path &videoPath, const std::filesystem::path &audioPath);
+	virtual ~RawFileSink();
+	virtual bool Begin(const SINK_VIDEO_FORMAT &videoFormat, const std::optional<SINK_AUDIO_FORMAT> &audioFormat) override;
+	virtual bool IsFrameDataRequired() override { return true; }
+	virtual bool WriteVideoFrame(int64_t timestamp, int64_t duration, const uint8_t *pData, int32_t stride) override;
+	virtual bool WriteAudio(int64_t timestamp, const uint8_t *pData, size_t size) override;
+	virtual bool Finalize() override;
+private:
+	std::filesystem::path m_VideoPath;
+	std::filesystem::path m_AudioPath;
+	std::ofstream m_VideoFile;
+	std::ofstream m_AudioFile;
+	SINK_VIDEO_FORMAT m_VideoFormat;
+	uint64_t m_AudioByteCount;
+	ColorConverter m_Converter;
+};
\ No newline at end of file
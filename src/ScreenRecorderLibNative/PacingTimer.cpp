@@ -0,0 +1,74 @@
+#include "PacingTimer.h"
+#include <algorithm>
+#include <thread>
+
+using namespace std::chrono;
+
+PacingTimer::PacingTimer() :
+	m_DeadlineTimer{},
+	m_StartTime{},
+	m_PeriodNumerator(0),
+	m_PeriodDenominator(1),
+	m_NextTickIndex(0),
+	m_TickCount(0),
+	m_SkippedTickCount(0),
+	m_SpinTolerance(DEFAULT_SPIN_TOLERANCE_MICROS),
+	m_Jitter{}
+{
+}
+
+void PacingTimer::Start(uint32_t periodNumerator, uint32_t periodDenominator)
+{
+	m_PeriodNumerator = periodNumerator;
+	m_PeriodDenominator = (std::max)(periodDenominator, 1u);
+	m_StartTime = steady_clock::now();
+	m_NextTickIndex = 0;
+	m_TickCount = 0;
+	m_SkippedTickCount = 0;
+	m_Jitter.Reset();
+}
+
+bool PacingTimer::WaitForNextTick(SyncEvent *pCancelEvent)
+{
+	const steady_clock::time_point deadline = GetDeadline(m_NextTickIndex);
+	//A deadline in the past only polls the cancel event.
+	if (!m_DeadlineTimer.WaitUntil(deadline - m_SpinTolerance, pCancelEvent)) {
+		return false;
+	}
+	steady_clock::time_point now = steady_clock::now();
+	while (now < deadline) {
+		std::this_thread::yield();
+		now = steady_clock::now();
+	}
+	m_Jitter.Record(duration_cast<microseconds>(now - deadline).count());
+	m_TickCount++;
+	m_NextTickIndex++;
+	if (m_PeriodNumerator > 0 && GetDeadline(m_NextTickIndex) <= now) {
+		//Estimate the first tick after now, and correct the estimate for rounding.
+		const double elapsedSeconds = duration<double>(now - m_StartTime).count();
+		uint64_t nextTickIndex = (std::max)(static_cast<uint64_t>(elapsedSeconds * m_PeriodDenominator / m_PeriodNumerator), m_NextTickIndex);
+		while (GetDeadline(nextTickIndex) <= now) {
+			nextTickIndex++;
+		}
+		while (nextTickIndex > m_NextTickIndex && GetDeadline(nextTickIndex - 1) > now) {
+			nextTickIndex--;
+		}
+		m_SkippedTickCount += nextTickIndex - m_NextTickIndex;
+		m_NextTickIndex = nextTickIndex;
+	}
+	return true;
+}
+
+steady_clock::duration PacingTimer::GetTimeUntilNextTick()
+{
+	return (std::max)(GetDeadline(m_NextTickIndex) - steady_clock::now(), steady_clock::duration::zero());
+}
+
+steady_clock::time_point PacingTimer::GetDeadline(uint64_t tickIndex)
+{
+	//Split the offset into whole seconds and a remainder, so it is exact and does not overflow.
+	const uint64_t periods = tickIndex * m_PeriodNumerator;
+	const uint64_t seconds = periods / m_PeriodDenominator;
+	const uint64_t remainderNanos = (periods % m_PeriodDenominator) * 1000000000ull / m_PeriodDenominator;
+	return m_StartTime + duration_cast<steady_clock::duration>(nanoseconds(seconds * 1000000000ull + remainderNanos));
+}
\ No newline at end of file
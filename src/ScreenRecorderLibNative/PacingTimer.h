@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "Metrics.h"
+#include "Sync.h"
+
+/// <summary>
+/// Paces a recurring tick on absolute deadlines, so the tick rate does not drift. The period is a ratio of seconds, so rates like 29.97 fps (1001/30000 s) are exact.
+/// Each wait sleeps until shortly before the deadline and spins for the rest, trading a little CPU for precision.
+/// Ticks that were missed are skipped, so later ticks stay on the original schedule.
+/// </summary>
+class PacingTimer
+{
+public:
+	PacingTimer();
+	/// <summary>
+	/// Starts the timer with a period of periodNumerator / periodDenominator seconds. The first tick is due immediately.
+	/// </summary>
+	void Start(uint32_t periodNumerator, uint32_t periodDenominator);
+	/// <summary>
+	/// How long before a deadline the timer stops sleeping and spins. 0 sleeps all the way to the deadline.
+	/// </summary>
+	void SetSpinTolerance(std::chrono::microseconds tolerance) { m_SpinTolerance = tolerance; }
+	/// <summary>
+	/// Waits for the next tick, or until the cancel event is set.
+	/// </summary>
+	/// <returns>true if the tick was reached, false if the wait was canceled</returns>
+	bool WaitForNextTick(SyncEvent *pCancelEvent = nullptr);
+	std::chrono::steady_clock::duration GetTimeUntilNextTick();
+	uint64_t GetTickCount() { return m_TickCount; }
+	uint64_t GetSkippedTickCount() { return m_SkippedTickCount; }
+	/// <summary>
+	/// How late each tick was reached, in microseconds.
+	/// </summary>
+	METRIC_HISTOGRAM_VALUE GetJitter() { return m_Jitter.GetValue(); }
+
+	static const int64_t DEFAULT_SPIN_TOLERANCE_MICROS = 500;
+private:
+	std::chrono::steady_clock::time_point GetDeadline(uint64_t tickIndex);
+
+	DeadlineTimer m_DeadlineTimer;
+	std::chrono::steady_clock::time_point m_StartTime;
+	uint64_t m_PeriodNumerator;
+	uint64_t m_PeriodDenominator;
+	uint64_t m_NextTickIndex;
+	uint64_t m_TickCount;
+	uint64_t m_SkippedTickCount;
+	std::chrono::microseconds m_SpinTolerance;
+	MetricHistogram m_Jitter;
+};
\ No newline at end of file
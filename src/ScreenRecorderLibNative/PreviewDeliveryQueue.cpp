@@ -0,0 +1,119 @@
+#include "PreviewDeliveryQueue.h"
+#include <algorithm>
+
+PreviewDeliveryQueue::PreviewDeliveryQueue(size_t maxQueuedPreviews, size_t maxQueuedFrames) :
+	m_MaxQueuedPreviews((std::max)(maxQueuedPreviews, static_cast<size_t>(1))),
+	m_MaxQueuedFrames((std::max)(maxQueuedFrames, static_cast<size_t>(1))),
+	m_Mutex{},
+	m_FrameAvailable{},
+	m_Queue{},
+	m_FreeBuffers{},
+	m_QueuedPreviewCount(0),
+	m_IsStopping(false),
+	m_DroppedPreviewCount(0)
+{
+}
+
+std::unique_ptr<PREVIEW_BUFFER> PreviewDeliveryQueue::AcquireBuffer()
+{
+	std::unique_ptr<PREVIEW_BUFFER> pPreview = nullptr;
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (!m_FreeBuffers.empty()) {
+			pPreview = std::move(m_FreeBuffers.back());
+			m_FreeBuffers.pop_back();
+		}
+		else if (m_QueuedPreviewCount >= m_MaxQueuedPreviews) {
+			for (QUEUED_PREVIEW_FRAME &queued : m_Queue) {
+				if (queued.Preview) {
+					//The frame number is still delivered, only its preview is dropped.
+					pPreview = std::move(queued.Preview);
+					m_QueuedPreviewCount--;
+					m_DroppedPreviewCount++;
+					break;
+				}
+			}
+		}
+	}
+	if (!pPreview) {
+		pPreview = std::make_unique<PREVIEW_BUFFER>();
+	}
+	return pPreview;
+}
+
+void PreviewDeliveryQueue::ReleaseBuffer(std::unique_ptr<PREVIEW_BUFFER> pPreview)
+{
+	if (pPreview) {
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_FreeBuffers.push_back(std::move(pPreview));
+	}
+}
+
+void PreviewDeliveryQueue::Push(int frameNumber, int64_t timestamp, std::unique_ptr<PREVIEW_BUFFER> pPreview)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_IsStopping) {
+			if (pPreview) {
+				m_FreeBuffers.push_back(std::move(pPreview));
+				m_DroppedPreviewCount++;
+			}
+			return;
+		}
+		if (m_Queue.size() >= m_MaxQueuedFrames) {
+			DropOldestFrame();
+		}
+		if (pPreview) {
+			m_QueuedPreviewCount++;
+		}
+		m_Queue.push_back(QUEUED_PREVIEW_FRAME{ frameNumber, timestamp, std::move(pPreview) });
+	}
+	m_FrameAvailable.notify_one();
+}
+
+bool PreviewDeliveryQueue::Pop(QUEUED_PREVIEW_FRAME *pFrame)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_FrameAvailable.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+	if (m_Queue.empty()) {
+		return false;
+	}
+	*pFrame = std::move(m_Queue.front());
+	m_Queue.pop_front();
+	if (pFrame->Preview) {
+		m_QueuedPreviewCount--;
+	}
+	return true;
+}
+
+void PreviewDeliveryQueue::Stop()
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_FrameAvailable.notify_all();
+}
+
+void PreviewDeliveryQueue::Restart()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_IsStopping = false;
+}
+
+uint64_t PreviewDeliveryQueue::GetDroppedPreviewCount()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_DroppedPreviewCount;
+}
+
+void PreviewDeliveryQueue::DropOldestFrame()
+{
+	QUEUED_PREVIEW_FRAME &oldest = m_Queue.front();
+	if (oldest.Preview) {
+		m_FreeBuffers.push_back(std::move(oldest.Preview));
+		m_QueuedPreviewCount--;
+		m_DroppedPreviewCount++;
+	}
+	m_Queue.pop_front();
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// <summary>
+/// A frame preview in 32bpp BGRA.
+/// </summary>
+struct PREVIEW_BUFFER {
+	std::vector<uint8_t> Data;
+	int Width;
+	int Height;
+	int Stride;
+};
+
+struct QUEUED_PREVIEW_FRAME {
+	int FrameNumber;
+	int64_t Timestamp;
+	//The preview of the frame, or nullptr if the frame has no preview.
+	std::unique_ptr<PREVIEW_BUFFER> Preview;
+};
+
+/// <summary>
+/// Passes frames and their previews from the recording thread to a delivery thread, in the order they were queued.
+/// Both the frames and the previews waiting for delivery are bounded. When the previews are full, the oldest queued preview is taken from its frame, so a slow consumer always gets the most recent preview,
+/// and its frame number is still delivered. When the frames are full, the oldest frame is dropped. Every preview that is taken or dropped this way is counted as dropped.
+/// Preview buffers are taken from a pool and returned to it after delivery, so no memory is allocated per preview once the pool has grown.
+/// </summary>
+class PreviewDeliveryQueue
+{
+public:
+	/// <param name="maxQueuedPreviews">The number of previews that can wait for delivery. At least 1.</param>
+	/// <param name="maxQueuedFrames">The number of frames, with or without a preview, that can wait for delivery. At least 1.</param>
+	PreviewDeliveryQueue(size_t maxQueuedPreviews, size_t maxQueuedFrames);
+	/// <summary>
+	/// Gets a buffer from the pool, to read the next preview into. If all buffers are queued for delivery and the previews are full, the buffer of the oldest queued preview is taken.
+	/// </summary>
+	std::unique_ptr<PREVIEW_BUFFER> AcquireBuffer();
+	/// <summary>
+	/// Returns the buffer of a delivered preview to the pool.
+	/// </summary>
+	void ReleaseBuffer(std::unique_ptr<PREVIEW_BUFFER> pPreview);
+	/// <summary>
+	/// Queues a frame for delivery. A frame queued after Stop is dropped.
+	/// </summary>
+	/// <param name="pPreview">The preview of the frame, or nullptr if it has none.</param>
+	void Push(int frameNumber, int64_t timestamp, std::unique_ptr<PREVIEW_BUFFER> pPreview);
+	/// <summary>
+	/// Waits for the next frame, and takes it from the queue.
+	/// </summary>
+	/// <returns>false once the queue is stopped and all frames queued before it are taken.</returns>
+	bool Pop(QUEUED_PREVIEW_FRAME *pFrame);
+	/// <summary>
+	/// Stops the queue. The frames already queued are still returned by Pop, after which it returns false instead of waiting.
+	/// </summary>
+	void Stop();
+	/// <summary>
+	/// Accepts frames again after Stop.
+	/// </summary>
+	void Restart();
+	/// <summary>
+	/// Gets the number of previews that were taken from their frame or dropped with it.
+	/// </summary>
+	uint64_t GetDroppedPreviewCount();
+private:
+	//Drops the oldest queued frame. The caller holds the lock.
+	void DropOldestFrame();
+
+	const size_t m_MaxQueuedPreviews;
+	const size_t m_MaxQueuedFrames;
+	std::mutex m_Mutex;
+	std::condition_variable m_FrameAvailable;
+	std::deque<QUEUED_PREVIEW_FRAME> m_Queue;
+	std::vector<std::unique_ptr<PREVIEW_BUFFER>> m_FreeBuffers;
+	size_t m_QueuedPreviewCount;
+	bool m_IsStopping;
+	uint64_t m_DroppedPreviewCount;
+};
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "Screengrab.h"
 #include "DynamicWait.h"
 #include "HighresTimer.h"
+#include "AdaptiveQualityController.h"
 
 #pragma comment(lib, "dxguid.lib")
 #pragma comment(lib, "D3D11.lib")
@@ -36,13 +37,13 @@ using namespace winrt::Windows::Graphics::Capture;
 static std::mutex m_DxDebugMutex{};
 bool isLoggingEnabled = true;
 int logSeverityLevel = LOG_LVL_TRACE;
+int logActiveSeverityLevel = LOG_LVL_TRACE;
 #else
 bool isLoggingEnabled = false;
 int logSeverityLevel = LOG_LVL_INFO;
+int logActiveSeverityLevel = LOG_LVL_OFF;
 #endif
 
-std::wstring logFilePath;
-
 // Driver types supported
 D3D_DRIVER_TYPE gDriverTypes[] =
 {
@@ -72,19 +73,28 @@ RecordingManager::RecordingManager() :
 	RecordingSnapshotCreatedCallback(nullptr),
 	RecordingStatusChangedCallback(nullptr),
 	RecordingFrameNumberChangedCallback(nullptr),
+	RecordingQualityChangedCallback(nullptr),
+	RecordingSegmentCompletedCallback(nullptr),
+	RecordingEncodedPacketCallback(nullptr),
 	m_TextureManager(nullptr),
 	m_OutputManager(nullptr),
+	m_AdditionalOutputs{},
 	m_CaptureManager(nullptr),
 	m_MouseManager(nullptr),
+	m_FramePreviewManager(nullptr),
+	m_LastFramePreviewStatistics{},
+	m_SnapshotService(nullptr),
+	m_LastSnapshotStatistics{},
+	m_Metrics(make_shared<MetricsRegistry>()),
 	m_EncoderOptions(new H264_ENCODER_OPTIONS()),
 	m_AudioOptions(new AUDIO_OPTIONS),
 	m_MouseOptions(new MOUSE_OPTIONS),
 	m_SnapshotOptions(new SNAPSHOT_OPTIONS),
 	m_OutputOptions(new OUTPUT_OPTIONS),
 	m_IsDestructing(false),
+	m_StopEvent(true),
 	m_RecordingSources{},
-	m_DxResources{},
-	m_FrameDataCallbackTexture(nullptr)
+	m_DxResources{}
 {
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 	m_MfStartupResult = MFStartup(MF_VERSION, MFSTARTUP_LITE);
@@ -95,7 +105,6 @@ RecordingManager::RecordingManager() :
 		m_TimerResolution = min(max(tc.wPeriodMin, targetResolutionMs), tc.wPeriodMax);
 		timeBeginPeriod(m_TimerResolution);
 	}
-	RtlZeroMemory(&m_FrameDataCallbackTextureDesc, sizeof(m_FrameDataCallbackTextureDesc));
 }
 
 RecordingManager::~RecordingManager()
@@ -104,6 +113,7 @@ RecordingManager::~RecordingManager()
 		m_IsDestructing = true;
 		LOG_WARN("Recording is in progress while destructing, cancelling recording task and waiting for completion.");
 		m_TaskWrapperImpl->m_RecordTaskCts.cancel();
+		m_StopEvent.Set();
 		m_TaskWrapperImpl->m_RecordTask.wait();
 		LOG_DEBUG("Wait for recording task completed.");
 	}
@@ -111,7 +121,6 @@ RecordingManager::~RecordingManager()
 	if (m_TimerResolution > 0) {
 		timeEndPeriod(m_TimerResolution);
 	}
-	SafeRelease(&m_FrameDataCallbackTexture);
 	ClearRecordingSources();
 	ClearOverlays();
 	CleanDx(&m_DxResources);
@@ -121,12 +130,14 @@ RecordingManager::~RecordingManager()
 
 void RecordingManager::SetLogEnabled(bool value) {
 	isLoggingEnabled = value;
+	logActiveSeverityLevel = isLoggingEnabled ? logSeverityLevel : LOG_LVL_OFF;
 }
 void RecordingManager::SetLogFilePath(std::wstring value) {
-	logFilePath = value;
+	SetLogFile(value);
 }
 void RecordingManager::SetLogSeverityLevel(int value) {
 	logSeverityLevel = value;
+	logActiveSeverityLevel = isLoggingEnabled ? logSeverityLevel : LOG_LVL_OFF;
 }
 
 
@@ -231,11 +242,11 @@ HRESULT RecordingManager::TakeSnapshot(_In_opt_ std::wstring path, _In_opt_ IStr
 				return E_FAIL;
 			}
 		}
-		RETURN_ON_BAD_HR(hr = SaveTextureAsVideoSnapshot(processedTexture, path, videoInputFrameRect));
-		LOG_TRACE(L"Wrote snapshot to %s", path.c_str());
-		if (RecordingSnapshotCreatedCallback != nullptr) {
-			RecordingSnapshotCreatedCallback(path);
+		if (!m_SnapshotService) {
+			return E_NOT_VALID_STATE;
 		}
+		//The snapshot is encoded on a worker thread, which invokes the snapshot callback when it has been written.
+		RETURN_ON_BAD_HR(hr = m_SnapshotService->QueueSnapshot(processedTexture, videoInputFrameRect, path));
 	}
 	else if (stream) {
 		RETURN_ON_BAD_HR(hr = SaveTextureAsVideoSnapshot(processedTexture, stream, videoInputFrameRect));
@@ -252,6 +263,36 @@ HRESULT RecordingManager::TakeSnapshot(_In_opt_ std::wstring path, _In_opt_ IStr
 	return hr;
 }
 
+HRESULT RecordingManager::SaveReplay(_In_ std::wstring path)
+{
+	if (!m_OutputManager) {
+		return E_NOT_VALID_STATE;
+	}
+	if (path.empty()) {
+		LOG_ERROR("Failed to save replay due to output path parameter being empty");
+		return E_INVALIDARG;
+	}
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	std::error_code ec;
+	if (!directory.empty() && !std::filesystem::exists(directory) && !std::filesystem::create_directories(directory, ec)) {
+		LOG_ERROR(L"Failed to create replay output folder");
+		return E_FAIL;
+	}
+	return m_OutputManager->SaveReplay(path);
+}
+
+HRESULT RecordingManager::SaveReplay(_In_ IStream *stream)
+{
+	if (!m_OutputManager) {
+		return E_NOT_VALID_STATE;
+	}
+	if (stream == nullptr) {
+		LOG_ERROR("Failed to save replay due to output stream parameter being NULL");
+		return E_INVALIDARG;
+	}
+	return m_OutputManager->SaveReplay(stream);
+}
+
 HRESULT RecordingManager::BeginRecording(_In_ IStream *stream) {
 	return BeginRecording(L"", stream);
 }
@@ -291,28 +332,80 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 		return S_FALSE;
 	}
 	m_IsRecording = true;
+	m_Metrics->Reset();
 	m_TaskWrapperImpl->m_RecordTaskCts = cancellation_token_source();
+	m_StopEvent.Reset();
 	m_TaskWrapperImpl->m_RecordTask = concurrency::create_task([this, stream]() {
 		LOG_INFO(L"Starting recording task");
+		Tracer::SetThreadName("Recording");
 		REC_RESULT result{};
 		HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
 		RETURN_RESULT_ON_BAD_HR(hr, L"CoInitializeEx failed");
 		RETURN_RESULT_ON_BAD_HR(hr = InitializeDx(nullptr, &m_DxResources), L"Failed to initialize DirectX");
 
 		m_TextureManager = make_unique<TextureManager>();
-		RETURN_RESULT_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DxResources.Context, m_DxResources.Device), L"Failed to initialize TextureManager");
+		RETURN_RESULT_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions()->GetCompositorBackend()), L"Failed to initialize TextureManager");
 		m_OutputManager = make_unique<OutputManager>();
-		RETURN_RESULT_ON_BAD_HR(hr = m_OutputManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetEncoderOptions(), GetAudioOptions(), GetSnapshotOptions(), GetOutputOptions()), L"Failed to initialize OutputManager");
+		m_OutputManager->SetStopEvent(&m_StopEvent);
+		m_OutputManager->SetSegmentCompletedCallback([this](const RECORDING_SEGMENT &segment) {
+			if (FAILED(segment.Result)) {
+				_com_error err(segment.Result);
+				LOG_ERROR(L"Failed to finalize recording segment %ls: %ls", segment.Path.c_str(), err.ErrorMessage());
+				return;
+			}
+			if (RecordingSegmentCompletedCallback != nullptr && !m_IsDestructing) {
+				RecordingSegmentCompletedCallback(segment.Path, segment.Index, HundredNanosToMillis(segment.StartPos), HundredNanosToMillis(segment.Duration));
+			}
+		});
+		if (RecordingEncodedPacketCallback != nullptr) {
+			m_OutputManager->SetBitstreamCallback([this](const BITSTREAM_PACKET &packet) {
+				if (RecordingEncodedPacketCallback != nullptr && !m_IsDestructing) {
+					RecordingEncodedPacketCallback(&packet);
+				}
+			});
+		}
+		RETURN_RESULT_ON_BAD_HR(hr = m_OutputManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetEncoderOptions(), GetAudioOptions(), GetSnapshotOptions(), GetOutputOptions(), m_Metrics), L"Failed to initialize OutputManager");
 		m_CaptureManager = make_unique<ScreenCaptureManager>();
-		RETURN_RESULT_ON_BAD_HR(m_CaptureManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions(), GetEncoderOptions(), GetMouseOptions()), L"Failed to initialize ScreenCaptureManager");
+		RETURN_RESULT_ON_BAD_HR(m_CaptureManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions(), GetEncoderOptions(), GetMouseOptions(), m_Metrics), L"Failed to initialize ScreenCaptureManager");
 		m_MouseManager = make_unique<MouseManager>();
-		RETURN_RESULT_ON_BAD_HR(hr = m_MouseManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetMouseOptions()), L"Failed to initialize mouse manager");
+		RETURN_RESULT_ON_BAD_HR(hr = m_MouseManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetMouseOptions(), GetOutputOptions()->GetCompositorBackend()), L"Failed to initialize mouse manager");
+		m_FramePreviewManager = make_unique<FramePreviewManager>([this](int frameNumber, INT64 timestamp, FRAME_BITMAP_DATA *pData) {
+			if (RecordingFrameNumberChangedCallback != nullptr && !m_IsDestructing) {
+				RecordingFrameNumberChangedCallback(frameNumber, timestamp, pData);
+			}
+		});
+		RETURN_RESULT_ON_BAD_HR(hr = m_FramePreviewManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions()), L"Failed to initialize frame preview manager");
+		m_SnapshotService = make_unique<SnapshotService>([this](HRESULT snapshotResult, std::wstring path) {
+			if (FAILED(snapshotResult)) {
+				_com_error err(snapshotResult);
+				LOG_ERROR(L"Failed to write snapshot to %ls: %ls", path.c_str(), err.ErrorMessage());
+				return;
+			}
+			LOG_TRACE(L"Wrote snapshot to %s", path.c_str());
+			if (RecordingSnapshotCreatedCallback != nullptr && !m_IsDestructing) {
+				TRACE_SCOPE("SnapshotCreatedCallback");
+				RecordingSnapshotCreatedCallback(path);
+			}
+		});
+		RETURN_RESULT_ON_BAD_HR(hr = m_SnapshotService->Initialize(m_DxResources.Context, m_DxResources.Device, GetSnapshotOptions()), L"Failed to initialize snapshot service");
 
 		result = StartRecorderLoop(m_RecordingSources, m_Overlays, stream);
+		m_FramePreviewManager->Stop();
+		m_LastFramePreviewStatistics = m_FramePreviewManager->GetStatistics();
+		m_SnapshotService->Stop();
+		m_LastSnapshotStatistics = m_SnapshotService->GetStatistics();
 		if (RecordingStatusChangedCallback != nullptr && !m_IsDestructing) {
 			RecordingStatusChangedCallback(STATUS_FINALIZING);
 		}
 		result.FinalizeResult = m_OutputManager->FinalizeRecording();
+		for (auto &pOutput : m_AdditionalOutputs) {
+			HRESULT outputHr = pOutput->FinalizeRecording();
+			if (FAILED(outputHr)) {
+				_com_error err(outputHr);
+				LOG_ERROR(L"Additional output to %ls failed: %ls", pOutput->GetPath().c_str(), err.ErrorMessage());
+			}
+		}
+		m_AdditionalOutputs.clear();
 		CoUninitialize();
 
 		LOG_INFO("Exiting recording task");
@@ -321,6 +414,9 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 				{
 					m_CaptureManager.reset(nullptr);
 					m_MouseManager.reset(nullptr);
+					m_FramePreviewManager.reset(nullptr);
+					m_SnapshotService.reset(nullptr);
+					m_AdditionalOutputs.clear();
 					m_IsRecording = false;
 					m_IsPaused = false;
 					REC_RESULT result{ };
@@ -333,11 +429,8 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 					}
 					CleanupDxResources();
 					if (!m_IsDestructing) {
-						nlohmann::fifo_map<std::wstring, int> delays{};
-						if (m_OutputManager) {
-							delays = m_OutputManager->GetFrameDelays();
-						}
-						SetRecordingCompleteStatus(result, delays);
+						std::wstring manifestPath = m_OutputManager ? m_OutputManager->GetSlideshowManifestPath() : L"";
+						SetRecordingCompleteStatus(result, manifestPath);
 					}
 				});
 		return S_OK;
@@ -346,6 +439,7 @@ HRESULT RecordingManager::BeginRecording(_In_opt_ std::wstring path, _In_opt_ IS
 void RecordingManager::EndRecording() {
 	if (m_IsRecording) {
 		m_TaskWrapperImpl->m_RecordTaskCts.cancel();
+		m_StopEvent.Set();
 		LOG_DEBUG(L"Stopped recording task");
 	}
 }
@@ -385,6 +479,29 @@ bool RecordingManager::SetExcludeFromCapture(HWND hwnd, bool isExcluded) {
 		return false;
 }
 
+void RecordingManager::SetTracingEnabled(bool isEnabled) {
+	Tracer::SetEnabled(isEnabled);
+	LOG_INFO(L"Tracing %ls", isEnabled ? L"enabled" : L"disabled");
+}
+
+HRESULT RecordingManager::WriteTrace(std::wstring path) {
+	std::ofstream traceFile(std::filesystem::path(path), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!traceFile.is_open()) {
+		LOG_ERROR(L"Failed to create trace file %ls", path.c_str());
+		return E_ACCESSDENIED;
+	}
+	if (!Tracer::WriteChromeTrace(traceFile)) {
+		LOG_ERROR(L"Failed to write trace file %ls", path.c_str());
+		return E_FAIL;
+	}
+	LOG_DEBUG(L"Wrote trace to %ls", path.c_str());
+	return S_OK;
+}
+
+void RecordingManager::ClearTrace() {
+	Tracer::Clear();
+}
+
 void RecordingManager::CleanupDxResources()
 {
 	SafeRelease(&m_DxResources.Context);
@@ -398,7 +515,7 @@ void RecordingManager::CleanupDxResources()
 #endif
 }
 
-void RecordingManager::SetRecordingCompleteStatus(_In_ REC_RESULT result, nlohmann::fifo_map<std::wstring, int> frameDelays)
+void RecordingManager::SetRecordingCompleteStatus(_In_ REC_RESULT result, _In_ std::wstring slideshowManifestPath)
 {
 	std::wstring errMsg = L"";
 	bool isSuccess = SUCCEEDED(result.RecordingResult) && SUCCEEDED(result.FinalizeResult);
@@ -416,13 +533,15 @@ void RecordingManager::SetRecordingCompleteStatus(_In_ REC_RESULT result, nlohma
 		}
 	}
 
+	//Make the log of the recording complete before the application is notified.
+	FlushLog();
 	if (RecordingStatusChangedCallback) {
 		RecordingStatusChangedCallback(STATUS_IDLE);
 		LOG_DEBUG("Changed Recording Status to Idle");
 	}
 	if (isSuccess) {
 		if (RecordingCompleteCallback)
-			RecordingCompleteCallback(m_OutputFullPath, frameDelays);
+			RecordingCompleteCallback(m_OutputFullPath, slideshowManifestPath);
 		LOG_DEBUG("Sent Recording Complete callback");
 	}
 	else {
@@ -481,7 +600,7 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 
 
 	if (recorderMode == RecorderModeInternal::Video) {
-		hr = pAudioManager->Initialize(GetAudioOptions());
+		hr = pAudioManager->Initialize(GetAudioOptions(), m_Metrics);
 		if (SUCCEEDED(hr)) {
 			pAudioManager->StartCapture();
 		}
@@ -495,6 +614,9 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 	else {
 		RETURN_RESULT_ON_BAD_HR(hr = m_OutputManager->BeginRecording(m_OutputFullPath, videoOutputFrameSize), L"Failed to initialize video sink writer");
 	}
+	if (recorderMode == RecorderModeInternal::Video) {
+		BeginAdditionalOutputs(videoOutputFrameSize);
+	}
 	pAudioManager->ClearRecordedBytes();
 
 	std::chrono::steady_clock::time_point previousSnapshotTaken = (std::chrono::steady_clock::time_point::min)();
@@ -505,10 +627,35 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 	else if (recorderMode == RecorderModeInternal::Slideshow) {
 		videoFrameDurationMillis = (double)GetSnapshotOptions()->GetSnapshotsInterval().count();
 	}
-	INT64 videoFrameDuration100Nanos = MillisToHundredNanos(videoFrameDurationMillis);
+	//Frames are placed on ideal deadlines on the media clock, so the schedule does not drift and stands still while paused.
+	FrameScheduler frameScheduler(std::make_shared<MediaFrameSchedulerClock>(m_OutputManager.get()));
+	bool isFixedSchedule = recorderMode == RecorderModeInternal::Video && GetEncoderOptions()->GetIsFixedFramerate();
+	if (recorderMode == RecorderModeInternal::Video) {
+		if (!isFixedSchedule) {
+			//Frames are written when the content changes, at most at the video framerate, and at the minimum framerate when it does not.
+			//The keep-alive period also bounds how long the loop waits for a frame, and so how long stopping the recording can take.
+			double minFps = max(GetEncoderOptions()->GetMinVideoFps(), 0.1);
+			frameScheduler.SetKeepAlivePeriod(1000, static_cast<UINT32>(round(minFps * 1000)));
+		}
+		frameScheduler.SetMaxRepeatCount(GetEncoderOptions()->GetVideoFps());
+		frameScheduler.Start(1, GetEncoderOptions()->GetVideoFps(), GetEncoderOptions()->GetFrameSchedulePolicy());
+	}
+	else if (recorderMode == RecorderModeInternal::Slideshow) {
+		frameScheduler.Start(static_cast<UINT32>(GetSnapshotOptions()->GetSnapshotsInterval().count()), 1000, FrameSchedulePolicy::StretchDuration);
+	}
+	else {
+		frameScheduler.Start(0, 1, FrameSchedulePolicy::StretchDuration);
+	}
+	//Lowers the framerate and bitrate while the encoder cannot keep up with the frames written to it.
+	std::unique_ptr<AdaptiveQualityController> pAdaptiveQuality = nullptr;
+	if (recorderMode == RecorderModeInternal::Video && GetEncoderOptions()->GetIsAdaptiveQualityEnabled()) {
+		INT64 mediaTime = 0;
+		m_OutputManager->GetMediaTimeStamp(&mediaTime);
+		pAdaptiveQuality = make_unique<AdaptiveQualityController>();
+		pAdaptiveQuality->Start(10 * 1000 * 1000 / GetEncoderOptions()->GetVideoFps(), mediaTime);
+	}
 
 	int frameNr = 0;
-	INT64 lastFrameStartPos100Nanos = 0;
 	cancellation_token token = m_TaskWrapperImpl->m_RecordTaskCts.get_token();
 	DynamicWait retryWait{};
 	INT64 totalDiff = 0;
@@ -525,11 +672,7 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 		});
 
 	auto GetTimeUntilNextFrameMillis([&]() {
-		INT64 timestamp;
-		m_OutputManager->GetMediaTimeStamp(&timestamp);
-		INT64 durationSinceLastFrame100Nanos = timestamp - lastFrameStartPos100Nanos;
-		INT64 nanosRemaining = max(0, videoFrameDuration100Nanos - durationSinceLastFrame100Nanos);
-		return HundredNanosToMillisDouble(nanosRemaining);
+		return HundredNanosToMillisDouble(frameScheduler.GetTimeUntilNextDeadline());
 		});
 
 	auto IsTimeToTakeSnapshot([&]()
@@ -539,9 +682,30 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			(std::chrono::steady_clock::now() - previousSnapshotTaken) > GetSnapshotOptions()->GetSnapshotsInterval();
 	});
 
-	auto PrepareAndRenderFrame([&](CComPtr<ID3D11Texture2D> pTextureToRender, INT64 duration100Nanos)->HRESULT {
+	MetricCounter *pFrameCount = m_Metrics->GetCounter("recording.frames");
+	MetricCounter *pUnchangedFrameCount = m_Metrics->GetCounter("recording.unchanged_frames");
+	MetricCounter *pCaptureRestartCount = m_Metrics->GetCounter("recording.capture_restarts");
+	MetricHistogram *pProcessLatency = m_Metrics->GetHistogram("recording.frame_process_us");
+	MetricHistogram *pRenderLatency = m_Metrics->GetHistogram("recording.frame_render_us");
+	MetricHistogram *pCallbackLatency = m_Metrics->GetHistogram("recording.frame_callback_us");
+	MetricHistogram *pScheduleLateness = m_Metrics->GetHistogram("recording.frame_lateness_us");
+	MetricCounter *pDroppedFrameCount = m_Metrics->GetCounter("recording.dropped_frames");
+	MetricCounter *pDuplicatedFrameCount = m_Metrics->GetCounter("recording.duplicated_frames");
+	MetricCounter *pElidedFrameCount = m_Metrics->GetCounter("recording.elided_frames");
+	MetricCounter *pKeepAliveFrameCount = m_Metrics->GetCounter("recording.keep_alive_frames");
+	MetricHistogram *pAdditionalOutputLatency = m_Metrics->GetHistogram("recording.additional_outputs_us");
+	MetricGauge *pQualityLevel = m_Metrics->GetGauge("adaptive_quality.level");
+	MetricCounter *pQualityLoweredCount = m_Metrics->GetCounter("adaptive_quality.lowered");
+	MetricCounter *pQualityRestoredCount = m_Metrics->GetCounter("adaptive_quality.restored");
+	QualityAdjustment qualityAdjustment = QualityAdjustment::None;
+
+	auto PrepareAndRenderFrame([&](CComPtr<ID3D11Texture2D> pTextureToRender, const FRAME_SCHEDULE &schedule)->HRESULT {
 		CComPtr<ID3D11Texture2D> processedTexture;
-		HRESULT renderHr = ProcessTexture(pTextureToRender, &processedTexture, pPtrInfo);
+		HRESULT renderHr;
+		{
+			MeasureLatency measureProcess(pProcessLatency);
+			renderHr = ProcessTexture(pTextureToRender, &processedTexture, pPtrInfo);
+		}
 		if (renderHr == S_OK) {
 			pTextureToRender.Release();
 			pTextureToRender.Attach(processedTexture);
@@ -557,26 +721,55 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			}
 		}
 
-		INT64 diff = 0;
-		auto audioBytes = pAudioManager->GrabAudioFrame(duration100Nanos);
-		if (audioBytes.size() > 0) {
-			INT64 frameCount = audioBytes.size() / (INT64)((GetAudioOptions()->GetAudioBitsPerSample() / 8) * GetAudioOptions()->GetAudioChannels());
-			INT64 newDuration = (frameCount * 10 * 1000 * 1000) / GetAudioOptions()->GetAudioSamplesPerSecond();
-			diff = newDuration - duration100Nanos;
-		}
+		//With the Duplicate policy, the frame is written once for each slot it fills.
+		for (UINT32 i = 0; i < schedule.RepeatCount; i++) {
+			INT64 startPos100Nanos = frameScheduler.GetSlotTimestamp(schedule.SlotIndex + i);
+			INT64 endPos100Nanos = i + 1 < schedule.RepeatCount ? frameScheduler.GetSlotTimestamp(schedule.SlotIndex + i + 1) : schedule.Timestamp + schedule.Duration;
+			//The audio of dropped slots is written with the first frame after them.
+			INT64 audioStartPos100Nanos = i == 0 ? schedule.IntervalStart : startPos100Nanos;
+			INT64 audioDuration100Nanos = endPos100Nanos - audioStartPos100Nanos;
+
+			INT64 diff = 0;
+			auto audioBytes = pAudioManager->GrabAudioFrame(audioDuration100Nanos);
+			if (audioBytes.size() > 0) {
+				INT64 frameCount = audioBytes.size() / (INT64)((GetAudioOptions()->GetAudioBitsPerSample() / 8) * GetAudioOptions()->GetAudioChannels());
+				INT64 newDuration = (frameCount * 10 * 1000 * 1000) / GetAudioOptions()->GetAudioSamplesPerSecond();
+				diff = newDuration - audioDuration100Nanos;
+			}
 
-		FrameWriteModel model{};
-		model.Frame = pTextureToRender;
-		model.Duration = duration100Nanos + diff;
-		model.StartPos = lastFrameStartPos100Nanos + totalDiff;
-		model.Audio = audioBytes;
-		RETURN_ON_BAD_HR(renderHr = m_EncoderResult = m_OutputManager->RenderFrame(model));
-		frameNr++;
-		totalDiff += diff;
-		if (RecordingFrameNumberChangedCallback != nullptr && !m_IsDestructing) {
-			SendNewFrameCallback(frameNr, pTextureToRender);
+			FrameWriteModel model{};
+			model.Frame = pTextureToRender;
+			model.Duration = endPos100Nanos - startPos100Nanos + diff;
+			model.StartPos = startPos100Nanos + totalDiff;
+			model.AudioStartPos = audioStartPos100Nanos + totalDiff;
+			model.AudioDuration = audioDuration100Nanos + diff;
+			model.Audio = audioBytes;
+			if (!m_AdditionalOutputs.empty()) {
+				MeasureLatency measureOutputs(pAdditionalOutputLatency);
+				QueueAdditionalOutputFrames(model);
+			}
+			auto renderStart = steady_clock::now();
+			{
+				MeasureLatency measureRender(pRenderLatency);
+				RETURN_ON_BAD_HR(renderHr = m_EncoderResult = m_OutputManager->RenderFrame(model));
+			}
+			if (pAdaptiveQuality) {
+				INT64 renderLatency100Nanos = duration_cast<nanoseconds>(steady_clock::now() - renderStart).count() / 100;
+				INT64 mediaTime = 0;
+				m_OutputManager->GetMediaTimeStamp(&mediaTime);
+				QualityAdjustment adjustment = pAdaptiveQuality->RecordFrame(mediaTime, renderLatency100Nanos, m_OutputManager->GetVideoQueueDepth());
+				if (adjustment != QualityAdjustment::None) {
+					qualityAdjustment = adjustment;
+				}
+			}
+			frameNr++;
+			pFrameCount->Increment();
+			totalDiff += diff;
+			if (RecordingFrameNumberChangedCallback != nullptr && !m_IsDestructing) {
+				MeasureLatency measureCallback(pCallbackLatency);
+				SendNewFrameCallback(frameNr, pTextureToRender);
+			}
 		}
-		lastFrameStartPos100Nanos += duration100Nanos;
 		return renderHr;
 	});
 
@@ -594,10 +787,16 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			hr = InitializeDx(nullptr, &m_DxResources);
 			SetViewPort(m_DxResources.Context, static_cast<float>(videoOutputFrameSize.cx), static_cast<float>(videoOutputFrameSize.cy));
 			if (SUCCEEDED(hr)) {
-				hr = m_MouseManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetMouseOptions());
+				hr = m_MouseManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetMouseOptions(), GetOutputOptions()->GetCompositorBackend());
 			}
 			if (SUCCEEDED(hr)) {
-				hr = m_TextureManager->Initialize(m_DxResources.Context, m_DxResources.Device);
+				hr = m_TextureManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions()->GetCompositorBackend());
+			}
+			if (SUCCEEDED(hr)) {
+				hr = m_FramePreviewManager->Initialize(m_DxResources.Context, m_DxResources.Device, GetOutputOptions());
+			}
+			if (SUCCEEDED(hr)) {
+				hr = m_SnapshotService->Initialize(m_DxResources.Context, m_DxResources.Device, GetSnapshotOptions());
 			}
 			if (SUCCEEDED(hr)) {
 				hr = m_OutputManager->Initialize(
@@ -606,7 +805,17 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 					GetEncoderOptions(),
 					GetAudioOptions(),
 					GetSnapshotOptions(),
-					GetOutputOptions());
+					GetOutputOptions(),
+					m_Metrics);
+			}
+			if (SUCCEEDED(hr)) {
+				for (auto &pOutput : m_AdditionalOutputs) {
+					HRESULT outputHr = pOutput->Initialize(m_DxResources.Context, m_DxResources.Device, GetAudioOptions(), GetSnapshotOptions(), GetOutputOptions(), m_Metrics);
+					if (FAILED(outputHr)) {
+						_com_error err(outputHr);
+						LOG_ERROR(L"Failed to reinitialize additional output to %ls: %ls", pOutput->GetPath().c_str(), err.ErrorMessage());
+					}
+				}
 			}
 		}
 		//Recreate capture manager and restart capture
@@ -619,12 +828,14 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 				m_DxResources.Device,
 				GetOutputOptions(),
 				GetEncoderOptions(),
-				GetMouseOptions());
+				GetMouseOptions(),
+				m_Metrics);
 		}
 		if (SUCCEEDED(hr)) {
 			if (result.NumberOfRetries > 0) {
 				m_RestartCaptureCount++;
 			}
+			pCaptureRestartCount->Increment();
 			ResetEvent(ErrorEvent);
 			hr = m_CaptureManager->StartCapture(sources, overlays, ErrorEvent);
 		}
@@ -704,7 +915,9 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 		}
 		CAPTURED_FRAME capturedFrame{};
 		// Get new frame
-		hr = m_CaptureManager->AcquireNextFrame(GetTimeUntilNextFrameMillis(), m_MaxFrameLengthMillis, &capturedFrame);
+		//With a variable framerate, the capture manager waits for a content change until the keep-alive frame is due.
+		double maxFrameLengthMillis = frameScheduler.IsVariableFrameRate() ? HundredNanosToMillisDouble(frameScheduler.GetTimeUntilKeepAlive()) : m_MaxFrameLengthMillis;
+		hr = m_CaptureManager->AcquireNextFrame(GetTimeUntilNextFrameMillis(), maxFrameLengthMillis, &capturedFrame);
 
 		//If there are any source previews on paused status, the loop exits here. This allows the source previews to continu render.
 		if (m_IsPaused) {
@@ -715,6 +928,9 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 			if (capturedFrame.FrameUpdateCount > 0) {
 				m_RestartCaptureCount = 0;
 			}
+			else {
+				pUnchangedFrameCount->Increment();
+			}
 			if (capturedFrame.PtrInfo) {
 				pPtrInfo = capturedFrame.PtrInfo.value();
 			}
@@ -722,11 +938,6 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 		else if (hr != DXGI_ERROR_WAIT_TIMEOUT) {
 			RETURN_RESULT_ON_BAD_HR(hr, L"");
 		}
-		INT64 timestamp;
-		RETURN_ON_BAD_HR(m_OutputManager->GetMediaTimeStamp(&timestamp));
-		INT64 durationSinceLastFrame100Nanos = timestamp - lastFrameStartPos100Nanos;
-
-
 
 		if (token.is_canceled()) {
 			LOG_DEBUG("Recording task was cancelled");
@@ -739,7 +950,37 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 				LOG_DEBUG("Changed Recording Status to Recording");
 			}
 		}
-		RETURN_RESULT_ON_BAD_HR(hr = PrepareAndRenderFrame(capturedFrame.Frame, durationSinceLastFrame100Nanos), L"Failed to render frame");
+		FRAME_SCHEDULE schedule = frameScheduler.ScheduleFrame(capturedFrame.FrameUpdateCount > 0 || capturedFrame.OverlayUpdateCount > 0);
+		if (isFixedSchedule) {
+			pScheduleLateness->Record(max(0LL, schedule.SchedulingError) / 10);
+		}
+		pDroppedFrameCount->Increment(schedule.DroppedSlotCount);
+		pDuplicatedFrameCount->Increment(schedule.RepeatCount - 1);
+		pElidedFrameCount->Increment(schedule.ElidedSlotCount);
+		pKeepAliveFrameCount->Increment(schedule.IsKeepAlive ? 1 : 0);
+		if (schedule.DroppedSlotCount > 0 || schedule.RepeatCount > 1) {
+			LOG_DEBUG(L"Frame was %.2f ms late: dropped %llu and duplicated %u frames", HundredNanosToMillisDouble(schedule.SchedulingError), schedule.DroppedSlotCount, schedule.RepeatCount - 1);
+		}
+		RETURN_RESULT_ON_BAD_HR(hr = PrepareAndRenderFrame(capturedFrame.Frame, schedule), L"Failed to render frame");
+		if (qualityAdjustment != QualityAdjustment::None) {
+			//The frame period is changed after the frame is written, as it invalidates the slot indexes of the schedule.
+			ADAPTIVE_QUALITY_LEVEL level = pAdaptiveQuality->GetLevel();
+			UINT32 levelIndex = pAdaptiveQuality->GetLevelIndex();
+			UINT32 framerate = max(1u, static_cast<UINT32>(round(GetEncoderOptions()->GetVideoFps() * level.FramerateScale)));
+			frameScheduler.SetPeriod(1, framerate);
+			HRESULT bitrateHr = m_OutputManager->SetVideoBitrateScale(level.BitrateScale);
+			if (FAILED(bitrateHr)) {
+				_com_error err(bitrateHr);
+				LOG_WARN(L"Failed to change video bitrate: %ls", err.ErrorMessage());
+			}
+			pQualityLevel->Set(levelIndex);
+			(qualityAdjustment == QualityAdjustment::Lowered ? pQualityLoweredCount : pQualityRestoredCount)->Increment();
+			LOG_INFO(L"Recording quality %ls to level %u: %u fps, %.0f%% bitrate", qualityAdjustment == QualityAdjustment::Lowered ? L"lowered" : L"restored", levelIndex, framerate, level.BitrateScale * 100);
+			if (RecordingQualityChangedCallback != nullptr && !m_IsDestructing) {
+				RecordingQualityChangedCallback(levelIndex, framerate, level.BitrateScale);
+			}
+			qualityAdjustment = QualityAdjustment::None;
+		}
 		if (recorderMode == RecorderModeInternal::Screenshot) {
 			break;
 		}
@@ -749,66 +990,13 @@ REC_RESULT RecordingManager::StartRecorderLoop(_In_ const std::vector<RECORDING_
 }
 
 HRESULT RecordingManager::SendNewFrameCallback(_In_ const int frameNumber, _In_ ID3D11Texture2D *pTexture) {
+	TRACE_SCOPE("SendNewFrameCallback");
 	HRESULT hr = S_FALSE;
 	if (RecordingFrameNumberChangedCallback != nullptr) {
 		INT64 timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-		if (m_OutputOptions->IsVideoFramePreviewEnabled()) {
-			CComPtr< ID3D11Texture2D> pProcessedTexture = nullptr;
-			unique_ptr<FRAME_BITMAP_DATA> pFramePreviewData = nullptr;
-			D3D11_TEXTURE2D_DESC textureDesc;
-			pTexture->GetDesc(&textureDesc);
-			if (m_OutputOptions->GetVideoFramePreviewSize().has_value()) {
-				long cx = m_OutputOptions->GetVideoFramePreviewSize().value().cx;
-				long cy = m_OutputOptions->GetVideoFramePreviewSize().value().cy;
-				if (cx > 0 && cy == 0) {
-					cy = static_cast<long>(round((static_cast<double>(textureDesc.Height) / static_cast<double>(textureDesc.Width)) * cx));
-				}
-				else if (cx == 0 && cy > 0) {
-					cx = static_cast<long>(round((static_cast<double>(textureDesc.Width) / static_cast<double>(textureDesc.Height)) * cy));
-				}
-				ID3D11Texture2D *pResizedTexture;
-				RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pTexture, SIZE{ cx,cy }, TextureStretchMode::Uniform, &pResizedTexture));
-				pProcessedTexture.Attach(pResizedTexture);
-				pResizedTexture->GetDesc(&textureDesc);
-			}
-			else {
-				pProcessedTexture.Attach(pTexture);
-				pTexture->AddRef();
-			}
-			int width = textureDesc.Width;
-			int height = textureDesc.Height;
-
-			if (m_FrameDataCallbackTextureDesc.Width != width || m_FrameDataCallbackTextureDesc.Height != height) {
-				SafeRelease(&m_FrameDataCallbackTexture);
-				textureDesc.Usage = D3D11_USAGE_STAGING;
-				textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-				textureDesc.MiscFlags = 0;
-				textureDesc.BindFlags = 0;
-				RETURN_ON_BAD_HR(m_DxResources.Device->CreateTexture2D(&textureDesc, nullptr, &m_FrameDataCallbackTexture));
-
-				m_FrameDataCallbackTextureDesc = textureDesc;
-			}
-
-			m_DxResources.Context->CopyResource(m_FrameDataCallbackTexture, pProcessedTexture);
-			D3D11_MAPPED_SUBRESOURCE map;
-			m_DxResources.Context->Map(m_FrameDataCallbackTexture, 0, D3D11_MAP_READ, 0, &map);
-
-			int bytesPerPixel = map.RowPitch / width;
-			int len = map.DepthPitch;
-			int stride = map.RowPitch;
-			BYTE *data = static_cast<BYTE *>(map.pData);
-			pFramePreviewData = make_unique<FRAME_BITMAP_DATA>();
-			pFramePreviewData->Data = data;
-			pFramePreviewData->Stride = stride;
-			pFramePreviewData->Width = width;
-			pFramePreviewData->Height = height;
-			pFramePreviewData->Length = len;
-			RecordingFrameNumberChangedCallback(frameNumber, timestamp, pFramePreviewData.get());
-			m_DxResources.Context->Unmap(m_FrameDataCallbackTexture, 0);
-		}
-		else {
-			RecordingFrameNumberChangedCallback(frameNumber, timestamp, nullptr);
-		}
+		//Frame numbers go through the frame preview manager even without a preview, so they reach the callback in order with the previews.
+		//Rate limiting, resizing, readback and format conversion all happen there, and only for the frames that get a preview.
+		RETURN_ON_BAD_HR(hr = m_FramePreviewManager->EnqueueFrame(frameNumber, timestamp, m_OutputOptions->IsVideoFramePreviewEnabled() ? pTexture : nullptr));
 	}
 	return hr;
 }
@@ -852,27 +1040,8 @@ HRESULT RecordingManager::ProcessTextureTransforms(_In_ ID3D11Texture2D *pTextur
 	}
 	if (RectWidth(videoInputFrameRect) != videoOutputFrameSize.cx
 		|| RectHeight(videoInputFrameRect) != videoOutputFrameSize.cy) {
-		RECT contentRect;
-		ID3D11Texture2D *pResizedFrameCopy;
-		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, videoOutputFrameSize, GetOutputOptions()->GetStretch(), &pResizedFrameCopy, &contentRect));
-
-		pResizedFrameCopy->GetDesc(&desc);
-		desc.Width = videoOutputFrameSize.cx;
-		desc.Height = videoOutputFrameSize.cy;
 		ID3D11Texture2D *pCanvas;
-		RETURN_ON_BAD_HR(hr = m_DxResources.Device->CreateTexture2D(&desc, nullptr, &pCanvas));
-		int leftMargin = (int)max(0, round(((double)videoOutputFrameSize.cx - (double)RectWidth(contentRect))) / 2);
-		int topMargin = (int)max(0, round(((double)videoOutputFrameSize.cy - (double)RectHeight(contentRect))) / 2);
-
-		D3D11_BOX Box{};
-		Box.front = 0;
-		Box.back = 1;
-		Box.left = 0;
-		Box.top = 0;
-		Box.right = RectWidth(contentRect);
-		Box.bottom = RectHeight(contentRect);
-		m_DxResources.Context->CopySubresourceRegion(pCanvas, 0, leftMargin, topMargin, 0, pResizedFrameCopy, 0, &Box);
-		pResizedFrameCopy->Release();
+		RETURN_ON_BAD_HR(hr = ResizeTextureToCanvas(pProcessedTexture, videoOutputFrameSize, &pCanvas));
 		pProcessedTexture.Release();
 		pProcessedTexture.Attach(pCanvas);
 	}
@@ -883,6 +1052,124 @@ HRESULT RecordingManager::ProcessTextureTransforms(_In_ ID3D11Texture2D *pTextur
 	return hr;
 }
 
+HRESULT RecordingManager::ResizeTextureToCanvas(_In_ ID3D11Texture2D *pTexture, _In_ SIZE size, _Outptr_ ID3D11Texture2D **ppCanvas)
+{
+	HRESULT hr;
+	RECT contentRect;
+	CComPtr<ID3D11Texture2D> pResizedFrameCopy;
+	RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pTexture, size, GetOutputOptions()->GetStretch(), &pResizedFrameCopy, &contentRect));
+
+	D3D11_TEXTURE2D_DESC desc;
+	pResizedFrameCopy->GetDesc(&desc);
+	desc.Width = size.cx;
+	desc.Height = size.cy;
+	ID3D11Texture2D *pCanvas;
+	RETURN_ON_BAD_HR(hr = m_DxResources.Device->CreateTexture2D(&desc, nullptr, &pCanvas));
+	CopyTextureToCanvasCenter(pResizedFrameCopy, contentRect, pCanvas);
+	*ppCanvas = pCanvas;
+	return hr;
+}
+
+void RecordingManager::CopyTextureToCanvasCenter(_In_ ID3D11Texture2D *pResizedTexture, _In_ RECT contentRect, _In_ ID3D11Texture2D *pCanvas)
+{
+	D3D11_TEXTURE2D_DESC canvasDesc;
+	pCanvas->GetDesc(&canvasDesc);
+	int leftMargin = (int)max(0, round(((double)canvasDesc.Width - (double)RectWidth(contentRect))) / 2);
+	int topMargin = (int)max(0, round(((double)canvasDesc.Height - (double)RectHeight(contentRect))) / 2);
+
+	D3D11_BOX Box{};
+	Box.front = 0;
+	Box.back = 1;
+	Box.left = 0;
+	Box.top = 0;
+	Box.right = RectWidth(contentRect);
+	Box.bottom = RectHeight(contentRect);
+	m_DxResources.Context->CopySubresourceRegion(pCanvas, 0, leftMargin, topMargin, 0, pResizedTexture, 0, &Box);
+}
+
+void RecordingManager::BeginAdditionalOutputs(_In_ SIZE videoOutputFrameSize)
+{
+	m_AdditionalOutputs.clear();
+	int index = 1;
+	for (ADDITIONAL_OUTPUT &options : GetOutputOptions()->GetAdditionalOutputs()) {
+		if (!options.EncoderOptions) {
+			options.EncoderOptions = GetEncoderOptions();
+		}
+		SIZE frameSize = videoOutputFrameSize;
+		if (options.FrameSize.has_value() && options.FrameSize.value().cx > 0 && options.FrameSize.value().cy > 0) {
+			frameSize = SIZE{ MakeEven(options.FrameSize.value().cx), MakeEven(options.FrameSize.value().cy) };
+		}
+		std::unique_ptr<AdditionalOutput> pOutput = make_unique<AdditionalOutput>(options, index++);
+		pOutput->SetStopEvent(&m_StopEvent);
+		HRESULT hr = pOutput->Initialize(m_DxResources.Context, m_DxResources.Device, GetAudioOptions(), GetSnapshotOptions(), GetOutputOptions(), m_Metrics);
+		if (SUCCEEDED(hr)) {
+			hr = pOutput->BeginRecording(frameSize);
+		}
+		if (FAILED(hr)) {
+			_com_error err(hr);
+			LOG_ERROR(L"Failed to start additional output to %ls: %ls", options.Path.c_str(), err.ErrorMessage());
+			continue;
+		}
+		m_AdditionalOutputs.push_back(std::move(pOutput));
+	}
+}
+
+void RecordingManager::QueueAdditionalOutputFrames(_In_ const FrameWriteModel &model)
+{
+	TRACE_SCOPE("QueueAdditionalOutputFrames");
+	//The frame is resized once for each size, and copied to the other outputs of that size, as each output writes its frames from its own textures.
+	std::vector<std::pair<SIZE, CComPtr<ID3D11Texture2D>>> frames{};
+	for (auto &pOutput : m_AdditionalOutputs) {
+		FrameWriteModel outputModel = model;
+		outputModel.Frame.Release();
+		if (model.Frame && pOutput->IsFrameDue(model)) {
+			SIZE size = pOutput->GetFrameSize();
+			auto frame = std::find_if(frames.begin(), frames.end(), [&](const std::pair<SIZE, CComPtr<ID3D11Texture2D>> &f) { return f.first.cx == size.cx && f.first.cy == size.cy; });
+			CComPtr<ID3D11Texture2D> pFrame;
+			HRESULT hr = RenderAdditionalOutputFrame(pOutput.get(), model.Frame, frame == frames.end() ? nullptr : frame->second.p, &pFrame);
+			if (FAILED(hr)) {
+				_com_error err(hr);
+				LOG_WARN(L"Failed to create frame for additional output of size %dx%d: %ls", size.cx, size.cy, err.ErrorMessage());
+			}
+			else if (frame == frames.end()) {
+				frames.push_back(std::make_pair(size, pFrame));
+			}
+			outputModel.Frame = pFrame;
+		}
+		pOutput->QueueFrame(std::move(outputModel));
+	}
+}
+
+HRESULT RecordingManager::RenderAdditionalOutputFrame(_In_ AdditionalOutput *pOutput, _In_ ID3D11Texture2D *pFrame, _In_opt_ ID3D11Texture2D *pSameSizeFrame, _Outptr_ ID3D11Texture2D **ppOutputFrame)
+{
+	SIZE size = pOutput->GetFrameSize();
+	D3D11_TEXTURE2D_DESC desc;
+	pFrame->GetDesc(&desc);
+	CComPtr<ID3D11Texture2D> pOutputFrame;
+	if (pSameSizeFrame) {
+		pSameSizeFrame->GetDesc(&desc);
+		RETURN_ON_BAD_HR(pOutput->GetFrameTexture(desc, &pOutputFrame));
+		m_DxResources.Context->CopyResource(pOutputFrame, pSameSizeFrame);
+	}
+	else if (static_cast<LONG>(desc.Width) == size.cx && static_cast<LONG>(desc.Height) == size.cy) {
+		//The frame of the main output can be overwritten by the next capture before the outputs have encoded it.
+		RETURN_ON_BAD_HR(pOutput->GetFrameTexture(desc, &pOutputFrame));
+		m_DxResources.Context->CopyResource(pOutputFrame, pFrame);
+	}
+	else {
+		RECT contentRect;
+		CComPtr<ID3D11Texture2D> pResizedFrame;
+		RETURN_ON_BAD_HR(m_TextureManager->ResizeTexture(pFrame, size, GetOutputOptions()->GetStretch(), &pResizedFrame, &contentRect));
+		pResizedFrame->GetDesc(&desc);
+		desc.Width = size.cx;
+		desc.Height = size.cy;
+		RETURN_ON_BAD_HR(pOutput->GetFrameTexture(desc, &pOutputFrame));
+		CopyTextureToCanvasCenter(pResizedFrame, contentRect, pOutputFrame);
+	}
+	*ppOutputFrame = pOutputFrame.Detach();
+	return S_OK;
+}
+
 bool RecordingManager::CheckDependencies(_Out_ std::wstring *error)
 {
 	wstring errorText;
@@ -912,54 +1199,6 @@ bool RecordingManager::CheckDependencies(_Out_ std::wstring *error)
 	*error = errorText;
 	return result;
 }
-void RecordingManager::SaveTextureAsVideoSnapshotAsync(_In_ ID3D11Texture2D *pTexture, _In_ std::wstring snapshotPath, _In_ RECT destRect, _In_opt_ std::function<void(HRESULT)> onCompletion)
-{
-	pTexture->AddRef();
-	auto token = m_TaskWrapperImpl->m_RecordTaskCts.get_token();
-	Concurrency::create_task([this, pTexture, snapshotPath, destRect, onCompletion, token]() {
-		return SaveTextureAsVideoSnapshot(pTexture, snapshotPath, destRect);
-	   }, token).then([this, snapshotPath, pTexture, destRect, onCompletion, token](concurrency::task<HRESULT> t)
-		   {
-			   HRESULT hr;
-			   try {
-				   hr = t.get();
-				   // if .get() didn't throw and the HRESULT succeeded, there are no errors.
-			   }
-			   catch (...) {
-				   // handle error
-				   LOG_ERROR(L"Exception saving snapshot", );
-				   hr = E_FAIL;
-			   }
-			   if (token.is_canceled()) {
-				   cancel_current_task();
-			   };
-			   if (onCompletion) {
-				   std::invoke(onCompletion, hr);
-			   }
-			   return hr;
-		   }, token);
-}
-
-HRESULT RecordingManager::SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ std::wstring snapshotPath, _In_ RECT destRect)
-{
-	CComPtr<ID3D11Texture2D> pProcessedTexture = nullptr;
-	D3D11_TEXTURE2D_DESC frameDesc;
-	pTexture->GetDesc(&frameDesc);
-	int destWidth = RectWidth(destRect);
-	int destHeight = RectHeight(destRect);
-	if ((int)frameDesc.Width > RectWidth(destRect)
-		|| (int)frameDesc.Height > RectHeight(destRect)) {
-		//If the source frame is larger than the destionation rect, we crop it, to avoid black borders around the snapshots.
-		RETURN_ON_BAD_HR(m_TextureManager->CropTexture(pTexture, destRect, &pProcessedTexture));
-	}
-	else {
-		RETURN_ON_BAD_HR(m_DxResources.Device->CreateTexture2D(&frameDesc, nullptr, &pProcessedTexture));
-		// Copy the current frame for a separate thread to write it to a file asynchronously.
-		m_DxResources.Context->CopyResource(pProcessedTexture, pTexture);
-	}
-	return m_OutputManager->WriteFrameToImage(pProcessedTexture, snapshotPath.c_str());
-}
-
 HRESULT RecordingManager::SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ IStream *pStream, _In_ RECT destRect)
 {
 	CComPtr<ID3D11Texture2D> pProcessedTexture = nullptr;
@@ -982,6 +1221,7 @@ HRESULT RecordingManager::SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pText
 
 HRESULT RecordingManager::ProcessTexture(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, _In_opt_ std::optional<PTR_INFO> pPtrInfo = std::nullopt)
 {
+	TRACE_SCOPE("ComposeFrame");
 	*ppProcessedTexture = nullptr;
 	HRESULT hr = E_FAIL;
 	int updatedOverlaysCount = 0;
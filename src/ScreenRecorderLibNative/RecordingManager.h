@@ -4,14 +4,19 @@
 #include "AudioManager.h"
 #include "OutputManager.h"
 #include "ScreenCaptureManager.h"
+#include "FramePreviewManager.h"
+#include "SnapshotService.h"
+#include "AdditionalOutput.h"
 #include "Log.h"
-#include "fifo_map.h"
 #include "CommonTypes.h"
-typedef void(__stdcall *CallbackCompleteFunction)(std::wstring, nlohmann::fifo_map<std::wstring, int>);
+typedef void(__stdcall *CallbackCompleteFunction)(std::wstring, std::wstring);
 typedef void(__stdcall *CallbackStatusChangedFunction)(int);
 typedef void(__stdcall *CallbackErrorFunction)(std::wstring, std::wstring);
 typedef void(__stdcall *CallbackSnapshotFunction)(std::wstring);
 typedef void(__stdcall *CallbackFrameNumberChangedFunction)(int, INT64, _In_opt_ FRAME_BITMAP_DATA *data);
+typedef void(__stdcall *CallbackQualityChangedFunction)(int level, double framerate, double bitrateScale);
+typedef void(__stdcall *CallbackSegmentCompletedFunction)(std::wstring path, int index, INT64 startMillis, INT64 durationMillis);
+typedef void(__stdcall *CallbackEncodedPacketFunction)(_In_ const BITSTREAM_PACKET *pPacket);
 
 #define STATUS_IDLE 0
 #define STATUS_RECORDING 1
@@ -31,8 +36,19 @@ public:
 	CallbackStatusChangedFunction RecordingStatusChangedCallback;
 	CallbackSnapshotFunction RecordingSnapshotCreatedCallback;
 	CallbackFrameNumberChangedFunction RecordingFrameNumberChangedCallback;
+	CallbackQualityChangedFunction RecordingQualityChangedCallback;
+	CallbackSegmentCompletedFunction RecordingSegmentCompletedCallback;
+	/// <summary>
+	/// Receives the encoded packets when the bitstream output is enabled with OUTPUT_OPTIONS::SetBitstreamOutputEnabled. The packet data is only valid for the duration of the call.
+	/// </summary>
+	CallbackEncodedPacketFunction RecordingEncodedPacketCallback;
 	HRESULT TakeSnapshot(_In_ std::wstring path);
 	HRESULT TakeSnapshot(_In_ IStream *stream);
+	/// <summary>
+	/// Writes the replay buffer of the current or last recording to an MP4 file. The replay buffer is enabled with OUTPUT_OPTIONS::SetReplayBufferDuration.
+	/// </summary>
+	HRESULT SaveReplay(_In_ std::wstring path);
+	HRESULT SaveReplay(_In_ IStream *stream);
 	HRESULT BeginRecording(_In_ std::wstring path);
 	HRESULT BeginRecording(_In_ IStream *stream);
 	void EndRecording();
@@ -42,6 +58,15 @@ public:
 	bool IsRecording() { return m_IsRecording; }
 
 	static bool SetExcludeFromCapture(HWND hwnd, bool isExcluded);
+	/// <summary>
+	/// Enables or disables recording of trace events for capture, composition, encoding and callbacks. Tracing is process wide, and is disabled by default.
+	/// </summary>
+	static void SetTracingEnabled(bool isEnabled);
+	/// <summary>
+	/// Writes the recorded trace events to a file in the Chrome trace event format.
+	/// </summary>
+	static HRESULT WriteTrace(std::wstring path);
+	static void ClearTrace();
 
 	inline void ClearRecordingSources() {
 		for each (RECORDING_SOURCE * source in m_RecordingSources)
@@ -109,6 +134,31 @@ public:
 		return S_OK;
 	}
 
+	/// <summary>
+	/// Gets the frame preview statistics of the current recording, or of the last recording if none is in progress.
+	/// </summary>
+	inline FRAME_PREVIEW_STATISTICS GetFramePreviewStatistics() {
+		if (m_IsRecording && m_FramePreviewManager) {
+			return m_FramePreviewManager->GetStatistics();
+		}
+		return m_LastFramePreviewStatistics;
+	}
+	/// <summary>
+	/// Gets the snapshot statistics of the current recording, or of the last recording if none is in progress.
+	/// </summary>
+	inline SNAPSHOT_STATISTICS GetSnapshotStatistics() {
+		if (m_IsRecording && m_SnapshotService) {
+			return m_SnapshotService->GetStatistics();
+		}
+		return m_LastSnapshotStatistics;
+	}
+	/// <summary>
+	/// Gets the counters, gauges and latency histograms of the current recording, or of the last recording if none is in progress. Does not block the recording.
+	/// </summary>
+	inline METRICS_SNAPSHOT GetStatistics() {
+		return m_Metrics->GetSnapshot();
+	}
+
 	void SetLogEnabled(bool value);
 	void SetLogFilePath(std::wstring value);
 	void SetLogSeverityLevel(int value);
@@ -128,13 +178,23 @@ private:
 	UINT m_TimerResolution;
 	struct TaskWrapper;
 	std::unique_ptr<TaskWrapper> m_TaskWrapperImpl;
+	//Set along with the cancellation of the recording task, to end the waits of the outputs on their encoders.
+	SyncEvent m_StopEvent;
 
 	DX_RESOURCES m_DxResources;
 
 	std::unique_ptr<TextureManager> m_TextureManager;
 	std::unique_ptr<OutputManager> m_OutputManager;
+	//Video files encoded from the same frames as the main output.
+	std::vector<std::unique_ptr<AdditionalOutput>> m_AdditionalOutputs;
 	std::unique_ptr<ScreenCaptureManager> m_CaptureManager;
 	std::unique_ptr<MouseManager> m_MouseManager;
+	std::unique_ptr<FramePreviewManager> m_FramePreviewManager;
+	FRAME_PREVIEW_STATISTICS m_LastFramePreviewStatistics;
+	std::unique_ptr<SnapshotService> m_SnapshotService;
+	SNAPSHOT_STATISTICS m_LastSnapshotStatistics;
+	//Reset when a recording begins, so the values of the last recording remain available after it ends.
+	std::shared_ptr<MetricsRegistry> m_Metrics;
 
 	HRESULT m_EncoderResult = E_FAIL;
 	HRESULT m_MfStartupResult = E_FAIL;
@@ -154,9 +214,6 @@ private:
 	std::shared_ptr<SNAPSHOT_OPTIONS> m_SnapshotOptions;
 	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
 
-	ID3D11Texture2D *m_FrameDataCallbackTexture;
-	D3D11_TEXTURE2D_DESC m_FrameDataCallbackTextureDesc;
-
 	bool CheckDependencies(_Out_ std::wstring *error);
 	HRESULT ConfigureOutputDir(_In_ std::wstring path);
 	REC_RESULT StartRecorderLoop(_In_ const std::vector<RECORDING_SOURCE *> &sources, _In_ const std::vector<RECORDING_OVERLAY *> &overlays, _In_opt_ IStream *pStream);
@@ -174,14 +231,6 @@ private:
 	/// <returns></returns>
 	HRESULT InitializeRects(_In_ SIZE outputSize, _Out_opt_ RECT *pAdjustedSourceRect, _Out_opt_ SIZE *pAdjustedOutputFrameSize);
 
-	/// <summary>
-	/// Save texture as snapshot image.
-	/// </summary>
-	/// <param name="pTexture">The texture to save to a snapshot</param>
-	/// <param name="snapshotPath">A file path to save the snapshot to</param>
-	/// <param name="destRect">The area of the texture to save. If the texture is larger, it will be cropped to these coordinates.</param>
-	/// <returns></returns>
-	HRESULT SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ std::wstring snapshotPath, _In_ RECT destRect);
 	/// <summary>
 	/// Save texture as snapshot image.
 	/// </summary>
@@ -190,13 +239,6 @@ private:
 	/// <param name="destRect">The area of the texture to save. If the texture is larger, it will be cropped to these coordinates.</param>
 	/// <returns></returns>
 	HRESULT SaveTextureAsVideoSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ IStream *pStream, _In_ RECT destRect);
-	/// <summary>
-	/// Save texture as snapshot image async.
-	/// </summary>
-	/// <param name="pTexture">The texture to save to a snapshot</param>
-	/// <param name="destRect">The area of the texture to save. If the texture is larger, it will be cropped to these coordinates.</param>
-	/// <returns></returns>
-	void RecordingManager::SaveTextureAsVideoSnapshotAsync(_In_ ID3D11Texture2D *pTexture, _In_ std::wstring snapshotPath, _In_ RECT destRect, _In_opt_ std::function<void(HRESULT)> onCompletion);
 
 	/// <summary>
 	/// Adds overlays, mouse cursors, and texture transforms.
@@ -217,6 +259,30 @@ private:
 	/// <returns>S_OK if any processing has been done, S_FALSE if no changes, else an error code</returns>
 	HRESULT ProcessTextureTransforms(_In_ ID3D11Texture2D *pTexture, _Out_ ID3D11Texture2D **ppProcessedTexture, RECT videoInputFrameRect, SIZE videoOutputFrameSize);
 
+	/// <summary>
+	/// Resizes the texture to fit within the size, and centers it on a new texture of that size.
+	/// </summary>
+	HRESULT ResizeTextureToCanvas(_In_ ID3D11Texture2D *pTexture, _In_ SIZE size, _Outptr_ ID3D11Texture2D **ppCanvas);
+	/// <summary>
+	/// Copies the content rectangle of a resized texture to the center of the canvas.
+	/// </summary>
+	void CopyTextureToCanvasCenter(_In_ ID3D11Texture2D *pResizedTexture, _In_ RECT contentRect, _In_ ID3D11Texture2D *pCanvas);
+	/// <summary>
+	/// Renders the frame of the main output into a texture of the additional output, resized to the frame size of the output.
+	/// </summary>
+	/// <param name="pSameSizeFrame">A frame already rendered for another output of the same size, which is copied instead of resizing the frame again.</param>
+	HRESULT RenderAdditionalOutputFrame(_In_ AdditionalOutput *pOutput, _In_ ID3D11Texture2D *pFrame, _In_opt_ ID3D11Texture2D *pSameSizeFrame, _Outptr_ ID3D11Texture2D **ppOutputFrame);
+
+	/// <summary>
+	/// Starts the additional outputs of the recording. Outputs that fail to start are logged and skipped.
+	/// </summary>
+	void BeginAdditionalOutputs(_In_ SIZE videoOutputFrameSize);
+
+	/// <summary>
+	/// Queues a frame of the main output to the additional outputs. The frame is resized once for each output size it is due for, into textures that each output reuses.
+	/// </summary>
+	void QueueAdditionalOutputFrames(_In_ const FrameWriteModel &model);
+
 	/// <summary>
 	/// Releases DirectX resources and reports any leaks
 	/// </summary>
@@ -226,6 +292,6 @@ private:
 	///	Calls the RecordingComplete or RecordingFailed callbacks depending on the success of the recording result.
 	/// </summary>
 	/// <param name="result">The recording result.</param>
-	/// <param name="frameDelays">A map of paths to saved frames with corresponding delay between them. Only used for Slideshow mode.</param>
-	void SetRecordingCompleteStatus(_In_ REC_RESULT result, nlohmann::fifo_map<std::wstring, int> frameDelays);
+	/// <param name="slideshowManifestPath">The path of the manifest listing the saved frames and the delays between them. Only used for Slideshow mode.</param>
+	void SetRecordingCompleteStatus(_In_ REC_RESULT result, _In_ std::wstring slideshowManifestPath);
 };
\ No newline at end of file
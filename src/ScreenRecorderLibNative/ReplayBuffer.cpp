@@ -0,0 +1,103 @@
+#include "ReplayBuffer.h"
+#include <algorithm>
+#include <limits>
+
+ReplayBuffer::ReplayBuffer(int64_t maxDuration, uint64_t maxBytes) :
+	m_MaxDuration(maxDuration),
+	m_MaxBytes(maxBytes),
+	m_Gops{},
+	m_ByteCount(0),
+	m_PacketCount(0),
+	m_EndTimestamp((std::numeric_limits<int64_t>::min)()),
+	m_EvictedGopCount(0),
+	m_DiscardedPacketCount(0)
+{
+}
+
+void ReplayBuffer::Clear()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Gops.clear();
+	m_ByteCount = 0;
+	m_PacketCount = 0;
+	m_EndTimestamp = (std::numeric_limits<int64_t>::min)();
+	m_EvictedGopCount = 0;
+	m_DiscardedPacketCount = 0;
+}
+
+bool ReplayBuffer::AddPacket(ENCODED_PACKET packet)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (packet.Stream == PacketStream::Video && packet.IsKeyFrame) {
+		m_Gops.push_back(REPLAY_GOP{ packet.Timestamp, 0, {} });
+	}
+	else if (m_Gops.empty()) {
+		//Nothing before the first key frame can be decoded, and audio without video is not worth keeping.
+		m_DiscardedPacketCount++;
+		return false;
+	}
+	const uint64_t size = packet.Data.size();
+	m_EndTimestamp = (std::max)(m_EndTimestamp, packet.Timestamp + packet.Duration);
+	REPLAY_GOP &gop = m_Gops.back();
+	gop.Packets.push_back(std::make_shared<const ENCODED_PACKET>(std::move(packet)));
+	gop.ByteCount += size;
+	m_ByteCount += size;
+	m_PacketCount++;
+	Trim();
+	//The packet is in the last group, which is only removed if it alone exceeds the byte limit.
+	return !m_Gops.empty();
+}
+
+std::vector<std::shared_ptr<const ENCODED_PACKET>> ReplayBuffer::GetPackets()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	std::vector<std::shared_ptr<const ENCODED_PACKET>> packets{};
+	packets.reserve(static_cast<size_t>(m_PacketCount));
+	for (const REPLAY_GOP &gop : m_Gops) {
+		packets.insert(packets.end(), gop.Packets.begin(), gop.Packets.end());
+	}
+	return packets;
+}
+
+REPLAY_BUFFER_STATISTICS ReplayBuffer::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	REPLAY_BUFFER_STATISTICS statistics{};
+	statistics.ByteCount = m_ByteCount;
+	statistics.PacketCount = m_PacketCount;
+	statistics.GopCount = static_cast<uint32_t>(m_Gops.size());
+	if (!m_Gops.empty()) {
+		statistics.StartTimestamp = m_Gops.front().StartTimestamp;
+		statistics.EndTimestamp = m_EndTimestamp;
+	}
+	statistics.EvictedGopCount = m_EvictedGopCount;
+	statistics.DiscardedPacketCount = m_DiscardedPacketCount;
+	return statistics;
+}
+
+void ReplayBuffer::Trim()
+{
+	while (m_Gops.size() > 1) {
+		bool isOverSize = m_MaxBytes > 0 && m_ByteCount > m_MaxBytes;
+		//The oldest group is only evicted if the groups after it still cover the duration.
+		bool isOverDuration = m_MaxDuration > 0 && m_EndTimestamp - m_Gops[1].StartTimestamp >= m_MaxDuration;
+		if (!isOverSize && !isOverDuration) {
+			return;
+		}
+		EvictFirstGop();
+		m_EvictedGopCount++;
+	}
+	if (m_MaxBytes > 0 && m_ByteCount > m_MaxBytes && !m_Gops.empty()) {
+		//The group can not be cut short, as the packets after the cut would not decode. Its remaining packets are discarded, since the buffer is empty until the next key frame.
+		m_DiscardedPacketCount += m_Gops.front().Packets.size();
+		EvictFirstGop();
+	}
+}
+
+void ReplayBuffer::EvictFirstGop()
+{
+	const REPLAY_GOP &gop = m_Gops.front();
+	m_ByteCount -= gop.ByteCount;
+	m_PacketCount -= gop.Packets.size();
+	m_Gops.pop_front();
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Bitstream.h"
+
+struct REPLAY_BUFFER_STATISTICS {
+	//The payload bytes of the retained packets.
+	uint64_t ByteCount;
+	uint64_t PacketCount;
+	uint32_t GopCount;
+	//The start of the first retained key frame, in 100 nanosecond units.
+	int64_t StartTimestamp;
+	//The end of the last retained packet, in 100 nanosecond units.
+	int64_t EndTimestamp;
+	//The number of groups of pictures that were evicted to stay within the limits.
+	uint64_t EvictedGopCount;
+	//The number of packets that were not retained, because no key frame came before them, or their group of pictures alone exceeded the byte limit.
+	uint64_t DiscardedPacketCount;
+};
+
+/// <summary>
+/// Keeps the most recent encoded packets of a recording in memory, organized in groups of pictures that start at a video key frame.
+/// The oldest groups are evicted as a whole, so the retained packets always start at a key frame and can be decoded.
+/// Packets can be added and read from different threads.
+/// </summary>
+class ReplayBuffer
+{
+public:
+	/// <param name="maxDuration">The duration to retain, in 100 nanosecond units. Up to one group of pictures more is retained, so the window starts at a key frame. 0 retains any duration within the byte limit.</param>
+	/// <param name="maxBytes">The maximum payload bytes to retain. If a single group of pictures exceeds it, the group is discarded, and packets are discarded until the next key frame. 0 retains any size within the duration.</param>
+	ReplayBuffer(int64_t maxDuration, uint64_t maxBytes);
+	void Clear();
+	/// <summary>
+	/// Adds a packet. Packets of each stream must be added in decoding order, and audio must be added close to the video frames it plays with.
+	/// Audio is kept with the group of pictures that was last started.
+	/// </summary>
+	/// <returns>true if the packet was retained, false if it was discarded.</returns>
+	bool AddPacket(ENCODED_PACKET packet);
+	/// <summary>
+	/// Gets the retained packets in the order they were added. The first video packet is a key frame.
+	/// The packets are shared with the buffer, so this is cheap, and they are not modified after being added.
+	/// </summary>
+	std::vector<std::shared_ptr<const ENCODED_PACKET>> GetPackets();
+	REPLAY_BUFFER_STATISTICS GetStatistics();
+private:
+	struct REPLAY_GOP {
+		int64_t StartTimestamp;
+		uint64_t ByteCount;
+		std::vector<std::shared_ptr<const ENCODED_PACKET>> Packets;
+	};
+
+	std::mutex m_Mutex;
+	int64_t m_MaxDuration;
+	uint64_t m_MaxBytes;
+	std::deque<REPLAY_GOP> m_Gops;
+	uint64_t m_ByteCount;
+	uint64_t m_PacketCount;
+	int64_t m_EndTimestamp;
+	uint64_t m_EvictedGopCount;
+	uint64_t m_DiscardedPacketCount;
+
+	void Trim();
+	void EvictFirstGop();
+};
\ No newline at end of file
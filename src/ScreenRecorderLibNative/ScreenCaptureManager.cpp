@@ -7,6 +7,7 @@
 #include "VideoReader.h"
 #include "ImageReader.h"
 #include "GifReader.h"
+#include "SyntheticCapture.h"
 #include <typeinfo>
 #include "DynamicWait.h"
 #include "Exception.h"
@@ -32,13 +33,15 @@ ScreenCaptureManager::ScreenCaptureManager() :
 	m_OutputOptions(nullptr),
 	m_EncoderOptions(nullptr),
 	m_MouseOptions(nullptr),
+	m_Metrics(nullptr),
+	m_FrameWaitLatency(nullptr),
+	m_DeadlineTimer{},
 	m_FrameCopy(nullptr),
 	m_IsInitialFrameWriteComplete(false),
 	m_IsInitialOverlayWriteComplete(false)
 {
 	// Event to tell spawned threads to quit
 	m_TerminateThreadsEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
-	InitializeCriticalSection(&m_CriticalSection);
 }
 
 ScreenCaptureManager::~ScreenCaptureManager()
@@ -47,7 +50,6 @@ ScreenCaptureManager::~ScreenCaptureManager()
 		StopCapture();
 	}
 	Clean();
-	DeleteCriticalSection(&m_CriticalSection);
 }
 
 //
@@ -58,7 +60,8 @@ HRESULT ScreenCaptureManager::Initialize(
 	_In_ ID3D11Device *pDevice,
 	_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
 	_In_ std::shared_ptr<ENCODER_OPTIONS> pEncoderOptions,
-	_In_ std::shared_ptr<MOUSE_OPTIONS> pMouseOptions)
+	_In_ std::shared_ptr<MOUSE_OPTIONS> pMouseOptions,
+	_In_ std::shared_ptr<MetricsRegistry> pMetrics)
 {
 	HRESULT hr = S_OK;
 	m_Device = pDevice;
@@ -67,9 +70,11 @@ HRESULT ScreenCaptureManager::Initialize(
 	m_OutputOptions = pOutputOptions;
 	m_EncoderOptions = pEncoderOptions;
 	m_MouseOptions = pMouseOptions;
+	m_Metrics = pMetrics;
+	m_FrameWaitLatency = m_Metrics->GetHistogram("capture.frame_wait_us");
 
 	m_TextureManager = make_unique<TextureManager>();
-	RETURN_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DeviceContext, m_Device));
+	RETURN_ON_BAD_HR(hr = m_TextureManager->Initialize(m_DeviceContext, m_Device, m_OutputOptions->GetCompositorBackend()));
 	return hr;
 }
 
@@ -78,8 +83,7 @@ HRESULT ScreenCaptureManager::Initialize(
 //
 HRESULT ScreenCaptureManager::StartCapture(_In_ const std::vector<RECORDING_SOURCE *> &sources, _In_ const std::vector<RECORDING_OVERLAY *> &overlays, _In_  HANDLE hErrorEvent)
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	ResetEvent(m_TerminateThreadsEvent);
 	m_IsInitialFrameWriteComplete = false;
 
@@ -119,6 +123,7 @@ HRESULT ScreenCaptureManager::InitializeRecordingSources(_In_ const std::vector<
 		threadData->TerminateThreadsEvent = m_TerminateThreadsEvent;
 		threadData->CanvasTexSharedHandle = sharedHandle;
 		threadData->PtrInfo = &m_PtrInfo;
+		threadData->Metrics = m_Metrics.get();
 
 		threadData->RecordingSource = data;
 		RtlZeroMemory(&threadData->RecordingSource->DxRes, sizeof(DX_RESOURCES));
@@ -211,8 +216,7 @@ HRESULT ScreenCaptureManager::InitializeOverlays(_In_ const std::vector<RECORDIN
 
 HRESULT ScreenCaptureManager::StopCapture()
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	LOG_TRACE("Stopping capture threads");
 	if (!SetEvent(m_TerminateThreadsEvent)) {
 		LOG_ERROR("Could not terminate capture threads");
@@ -225,8 +229,7 @@ HRESULT ScreenCaptureManager::StopCapture()
 
 HRESULT ScreenCaptureManager::CopyCurrentFrame(_Out_ CAPTURED_FRAME *pFrame)
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	D3D11_TEXTURE2D_DESC desc;
 	m_FrameCopy->GetDesc(&desc);
 	ID3D11Texture2D *pFrameCopy;
@@ -237,6 +240,7 @@ HRESULT ScreenCaptureManager::CopyCurrentFrame(_Out_ CAPTURED_FRAME *pFrame)
 	pFrame->Frame = pFrameCopy;
 	pFrame->PtrInfo = m_PtrInfo;
 	pFrame->FrameUpdateCount = 0;
+	pFrame->OverlayUpdateCount = 0;
 	return S_OK;
 }
 
@@ -287,7 +291,7 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 		});
 
 	DWORD syncTimeout = GetNextSyncTimeout();
-
+	TraceScope traceWait("WaitForCapturedFrame");
 	while (true)
 	{
 		// Try to acquire keyed mutex in order to access shared surface
@@ -301,6 +305,11 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 					syncTimeout = 0;
 				}
 			}
+			else if (double millisUntilNextFrame = GetMillisUntilNextFrame(); millisUntilNextFrame > 0 && millisUntilNextFrame < 2) {
+				//The keyed mutex only waits in whole milliseconds, so sleep out the rest on the deadline timer instead of polling the mutex until the frame is due.
+				m_DeadlineTimer.WaitUntil(steady_clock::now() + duration_cast<steady_clock::duration>(duration<double, std::milli>(millisUntilNextFrame)));
+				syncTimeout = 0;
+			}
 			else {
 				syncTimeout = GetNextSyncTimeout();
 			}
@@ -322,9 +331,12 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 			return hr;
 		}
 	}
+	traceWait.End();
+	m_FrameWaitLatency->Record(duration_cast<microseconds>(std::chrono::steady_clock::now() - start).count());
 	{
 		ReleaseKeyedMutexOnExit releaseMutex(m_KeyMutex, 0);
 		MeasureExecutionTime measure(L"AcquireNextFrame lock");
+		TRACE_SCOPE("CopyCapturedFrame");
 		int updatedFrameCount = GetUpdatedSourceCount();
 		int updatedOverlaysCount = GetUpdatedOverlayCount();
 
@@ -346,6 +358,7 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 		pFrame->Frame = m_FrameCopy;
 		pFrame->PtrInfo = m_PtrInfo;
 		pFrame->FrameUpdateCount = updatedFrameCount;
+		pFrame->OverlayUpdateCount = updatedOverlaysCount;
 	}
 	return hr;
 }
@@ -355,8 +368,7 @@ HRESULT ScreenCaptureManager::AcquireNextFrame(_In_  double timeUntilNextFrame,
 //
 void ScreenCaptureManager::Clean()
 {
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveOnExit(&m_CriticalSection);
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	if (m_SharedSurf) {
 		m_SharedSurf->Release();
 		m_SharedSurf = nullptr;
@@ -645,6 +657,7 @@ RECT ScreenCaptureManager::GetOverlayRect(_In_ SIZE canvasSize, _In_ SIZE overla
 
 HRESULT ScreenCaptureManager::ProcessOverlays(_Inout_ ID3D11Texture2D *pCanvasTexture, _Out_ int *updateCount)
 {
+	TRACE_SCOPE("ComposeOverlays");
 	HRESULT hr = S_FALSE;
 	int count = 0;
 
@@ -773,6 +786,10 @@ DWORD WINAPI CaptureThreadProc(_In_ void *Param)
 	CAPTURE_THREAD_DATA *pData = static_cast<CAPTURE_THREAD_DATA *>(Param);
 	RECORDING_SOURCE_DATA *pSourceData = pData->RecordingSource;
 	RECORDING_SOURCE *pSource = pSourceData->RecordingSource;
+	Tracer::SetThreadName("Source capture");
+	MetricHistogram *pKeyedMutexWaitLatency = pData->Metrics->GetHistogram("capture.keyed_mutex_wait_us");
+	MetricCounter *pWrittenFrameCount = pData->Metrics->GetCounter("capture.source_frames");
+	MetricCounter *pDroppedFrameCount = pData->Metrics->GetCounter("capture.dropped_frames");
 
 	DynamicWait retryWait;
 	retryWait.SetWaitBands({
@@ -907,6 +924,7 @@ Start:
 				CComPtr<ID3D11Texture2D> pFrame = nullptr;
 				if (!waitToProcessCurrentFrame)
 				{
+					TRACE_SCOPE("AcquireSourceFrame");
 					if (isSharedSurfaceDirty) {
 						hr = pRecordingSourceCapture->AcquireNextFrame(10, &pFrame);
 					}
@@ -924,8 +942,12 @@ Start:
 						break;
 					}
 				}
+				if (!waitToProcessCurrentFrame) {
+					WaitForFrameBegin = chrono::steady_clock::now();
+				}
 				{
 					MeasureExecutionTime measure(L"CaptureThreadProc wait for sync");
+					TRACE_SCOPE("WaitForSharedSurface");
 					// We have a new frame so try and process it
 					// Try to acquire keyed mutex in order to access shared surface
 					hr = KeyMutex->AcquireSync(0, 1);
@@ -933,9 +955,6 @@ Start:
 				if (hr == static_cast<HRESULT>(WAIT_TIMEOUT))
 				{
 					// Can't use shared surface right now, try again later
-					if (!waitToProcessCurrentFrame) {
-						WaitForFrameBegin = chrono::steady_clock::now();
-					}
 					waitToProcessCurrentFrame = true;
 					continue;
 				}
@@ -949,6 +968,8 @@ Start:
 				MeasureExecutionTime measureLock(string_format(L"CaptureThreadProc sync lock for %ls", pRecordingSourceCapture->Name().c_str()));
 #endif
 				ReleaseKeyedMutexOnExit releaseMutex(KeyMutex, 1);
+				TRACE_SCOPE("WriteSourceFrame");
+				pKeyedMutexWaitLatency->Record(duration_cast<microseconds>(chrono::steady_clock::now() - WaitForFrameBegin).count());
 
 				// We can now process the current frame
 				if (waitToProcessCurrentFrame) {
@@ -957,6 +978,7 @@ Start:
 					//If the capture has been waiting for an excessive time to draw a frame, we assume the frame is stale, and drop it.
 					if (pData->TotalUpdatedFrameCount > 0 && waitTimeMillis > 1000) {
 						isSharedSurfaceDirty = true;
+						pDroppedFrameCount->Increment();
 						LOG_DEBUG("Dropped %ls frame because wait time exceeded limit", pRecordingSourceCapture->Name().c_str());
 						continue;
 					}
@@ -1015,6 +1037,7 @@ Start:
 					continue;
 				}
 				pData->TotalUpdatedFrameCount++;
+				pWrittenFrameCount->Increment();
 				QueryPerformanceCounter(&pData->LastUpdateTimeStamp);
 			}
 		}
@@ -1076,6 +1099,7 @@ DWORD WINAPI OverlayCaptureThreadProc(_In_ void *Param) {
 
 	RECORDING_OVERLAY_DATA *pOverlayData = pData->RecordingOverlay;
 	RECORDING_OVERLAY *pOverlay = pOverlayData->RecordingOverlay;
+	Tracer::SetThreadName("Overlay capture");
 
 	DynamicWait retryWait;
 	retryWait.SetWaitBands({
@@ -1165,7 +1189,10 @@ Start:
 				}
 				pCurrentFrame.Release();
 				// Get new frame from video capture
-				hr = overlayCapture->AcquireNextFrame(10, &pCurrentFrame);
+				{
+					TRACE_SCOPE("AcquireOverlayFrame");
+					hr = overlayCapture->AcquireNextFrame(10, &pCurrentFrame);
+				}
 				if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
 					continue;
 				}
@@ -1333,6 +1360,9 @@ _Ret_maybenull_ CaptureBase *CreateCaptureInstance(_In_ RECORDING_SOURCE_BASE *p
 		case RecordingSourceType::Window: {
 			return new WindowsGraphicsCapture();
 		}
+		case RecordingSourceType::Synthetic: {
+			return new SyntheticCapture();
+		}
 		default:
 			return nullptr;
 	}
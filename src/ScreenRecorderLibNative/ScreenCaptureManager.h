@@ -19,7 +19,8 @@ public:
 		_In_ ID3D11Device *pDevice,
 		_In_ std::shared_ptr<OUTPUT_OPTIONS> pOutputOptions,
 		_In_ std::shared_ptr<ENCODER_OPTIONS> pEncoderOptions,
-		_In_ std::shared_ptr<MOUSE_OPTIONS> pMouseOptions);
+		_In_ std::shared_ptr<MOUSE_OPTIONS> pMouseOptions,
+		_In_ std::shared_ptr<MetricsRegistry> pMetrics);
 	virtual inline PTR_INFO *GetPointerInfo() {
 		return &m_PtrInfo;
 	}
@@ -57,10 +58,14 @@ private:
 	bool m_IsInitialOverlayWriteComplete;
 	bool m_IsCapturing;
 	HANDLE m_TerminateThreadsEvent;
-	CRITICAL_SECTION m_CriticalSection;
+	SyncMutex m_Mutex;
 	std::shared_ptr<ENCODER_OPTIONS> m_EncoderOptions;
 	std::shared_ptr<OUTPUT_OPTIONS> m_OutputOptions;
 	std::shared_ptr<MOUSE_OPTIONS> m_MouseOptions;
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	//Time the recording thread waits for the capture threads to update the shared surface.
+	MetricHistogram *m_FrameWaitLatency;
+	DeadlineTimer m_DeadlineTimer;
 	std::unique_ptr<TextureManager> m_TextureManager;
 	CComPtr<ID3D11Texture2D> m_FrameCopy;
 
@@ -0,0 +1,69 @@
+#include "SegmentPolicy.h"
+#include <algorithm>
+#include <cwchar>
+#include <filesystem>
+
+SegmentPolicy::SegmentPolicy() :
+	m_MaxDuration(0),
+	m_MaxSize(0),
+	m_SegmentStartPos(0),
+	m_IsStarted(false),
+	m_IsNextSegmentPrepared(false)
+{
+}
+
+void SegmentPolicy::Begin(int64_t maxDuration, uint64_t maxSize)
+{
+	m_MaxDuration = (std::max)(maxDuration, static_cast<int64_t>(0));
+	m_MaxSize = maxSize;
+	m_SegmentStartPos = 0;
+	m_IsStarted = false;
+	m_IsNextSegmentPrepared = false;
+}
+
+SegmentAction SegmentPolicy::Update(int64_t frameStartPos, uint64_t segmentSize)
+{
+	if (!m_IsStarted) {
+		BeginNextSegment(frameStartPos);
+		return SegmentAction::None;
+	}
+	const int64_t duration = frameStartPos - m_SegmentStartPos;
+	const bool isSizeLimited = IsSizeLimited();
+	if ((m_MaxDuration > 0 && duration >= m_MaxDuration) || (isSizeLimited && segmentSize >= m_MaxSize)) {
+		return SegmentAction::StartNext;
+	}
+	if (!m_IsNextSegmentPrepared
+		&& ((m_MaxDuration > 0 && duration >= m_MaxDuration - GetPrepareDuration()) || (isSizeLimited && segmentSize >= m_MaxSize / 10 * 9))) {
+		m_IsNextSegmentPrepared = true;
+		return SegmentAction::PrepareNext;
+	}
+	return SegmentAction::None;
+}
+
+void SegmentPolicy::BeginNextSegment(int64_t startPos)
+{
+	m_SegmentStartPos = startPos;
+	m_IsStarted = true;
+	m_IsNextSegmentPrepared = false;
+}
+
+int64_t SegmentPolicy::GetPrepareDuration() const
+{
+	return (std::min)(m_MaxDuration / 2, MAX_PREPARE_DURATION);
+}
+
+int64_t SegmentPolicy::GetFrameStartPos(int64_t videoStartPos, int64_t audioStartPos, bool isAudioEnabled)
+{
+	return isAudioEnabled ? (std::min)(videoStartPos, audioStartPos) : videoStartPos;
+}
+
+std::wstring SegmentPolicy::GetSegmentPath(const std::wstring &outputPath, uint32_t index)
+{
+	if (index == 0) {
+		return outputPath;
+	}
+	const std::filesystem::path path = outputPath;
+	wchar_t suffix[16];
+	swprintf(suffix, sizeof(suffix) / sizeof(suffix[0]), L"_%03u", index);
+	return (path.parent_path() / (path.stem().wstring() + suffix + path.extension().wstring())).wstring();
+}
\ No newline at end of file
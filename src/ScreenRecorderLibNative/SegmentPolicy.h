@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+enum class SegmentAction {
+	///<summary>Keep writing to the current segment.</summary>
+	None,
+	///<summary>Create the next segment in the background, as the current one is close to full.</summary>
+	PrepareNext,
+	///<summary>Start the next segment with this frame, as the current one is full.</summary>
+	StartNext
+};
+
+/// <summary>
+/// Decides when a recording that is split into segments moves on to the next segment, from the limits on the duration and file size of a segment.
+/// A segment is full once it reaches either limit, and the next segment is prepared ahead of time, shortly before the current one is full.
+/// Positions and durations are in 100 nanosecond units.
+/// </summary>
+class SegmentPolicy
+{
+public:
+	SegmentPolicy();
+	/// <summary>
+	/// Starts over at the first segment, which begins with the next frame.
+	/// </summary>
+	/// <param name="maxDuration">The longest a segment can be, or 0 for no limit.</param>
+	/// <param name="maxSize">The largest a segment file can be in bytes, or 0 for no limit.</param>
+	void Begin(int64_t maxDuration, uint64_t maxSize);
+	/// <summary>
+	/// Decides what to do before a frame is written. The first frame begins the first segment, and the frame that fills a segment begins the next one.
+	/// Returns PrepareNext once per segment.
+	/// </summary>
+	/// <param name="frameStartPos">The start of the frame, from GetFrameStartPos.</param>
+	/// <param name="segmentSize">The current size of the segment file. Only used if the size is limited.</param>
+	SegmentAction Update(int64_t frameStartPos, uint64_t segmentSize);
+	/// <summary>
+	/// Begins the next segment, after Update returned StartNext and the segment was switched.
+	/// </summary>
+	void BeginNextSegment(int64_t startPos);
+	bool IsStarted() const { return m_IsStarted; }
+	int64_t GetSegmentStartPos() const { return m_SegmentStartPos; }
+	bool IsSizeLimited() const { return m_MaxSize > 0; }
+	/// <summary>
+	/// Gets how long before a segment reaches its maximum duration the next one is prepared, which is half the maximum duration, up to MAX_PREPARE_DURATION.
+	/// </summary>
+	int64_t GetPrepareDuration() const;
+
+	/// <summary>
+	/// Gets the position a frame starts at. The audio written with a frame can start before it, and must be in the same segment to stay continuous.
+	/// </summary>
+	static int64_t GetFrameStartPos(int64_t videoStartPos, int64_t audioStartPos, bool isAudioEnabled);
+	/// <summary>
+	/// Gets the path of a segment. The first segment is written to the output path, and the following ones next to it, e.g. recording_001.mp4.
+	/// </summary>
+	static std::wstring GetSegmentPath(const std::wstring &outputPath, uint32_t index);
+
+	//Creating a segment takes long enough to delay a frame, so the next one is created up to 5 seconds before it is needed.
+	static const int64_t MAX_PREPARE_DURATION = 5 * 10000000ll;
+private:
+	int64_t m_MaxDuration;
+	uint64_t m_MaxSize;
+	int64_t m_SegmentStartPos;
+	bool m_IsStarted;
+	bool m_IsNextSegmentPrepared;
+};
\ No newline at end of file
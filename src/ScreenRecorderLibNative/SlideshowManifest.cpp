@@ -0,0 +1,70 @@
+#include "SlideshowManifest.h"
+#include <cstdio>
+
+namespace {
+	void AppendJsonString(std::string &output, const std::string &value) {
+		output += '"';
+		for (char c : value) {
+			if (c == '"' || c == '\\') {
+				output += '\\';
+				output += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+				output += escaped;
+			}
+			else {
+				output += c;
+			}
+		}
+		output += '"';
+	}
+}
+
+SlideshowManifest::SlideshowManifest() :
+	m_Stream(nullptr),
+	m_WaitingFrames{},
+	m_NextCommitIndex(0),
+	m_HasFailed(false)
+{
+}
+
+void SlideshowManifest::Begin(std::ostream *pStream)
+{
+	m_Stream = pStream;
+	m_WaitingFrames.clear();
+	m_NextCommitIndex = 0;
+	m_HasFailed = false;
+}
+
+bool SlideshowManifest::AddFrame(uint64_t index, const std::string &path, int64_t delayMillis, bool isWritten)
+{
+	if (index >= m_NextCommitIndex) {
+		m_WaitingFrames.emplace(index, WAITING_FRAME{ path, delayMillis, isWritten });
+		CommitWaitingFrames();
+	}
+	return !m_HasFailed;
+}
+
+std::string SlideshowManifest::FormatLine(uint64_t index, const std::string &path, int64_t delayMillis)
+{
+	std::string line = "{\"frame\":" + std::to_string(index) + ",\"path\":";
+	AppendJsonString(line, path);
+	line += ",\"delay\":" + std::to_string(delayMillis) + "}\n";
+	return line;
+}
+
+void SlideshowManifest::CommitWaitingFrames()
+{
+	for (auto it = m_WaitingFrames.begin(); it != m_WaitingFrames.end() && it->first == m_NextCommitIndex; it = m_WaitingFrames.erase(it)) {
+		const WAITING_FRAME &frame = it->second;
+		if (frame.IsWritten && m_Stream && !m_HasFailed) {
+			const std::string line = FormatLine(it->first, frame.Path, frame.DelayMillis);
+			m_Stream->write(line.data(), static_cast<std::streamsize>(line.size()));
+			m_Stream->flush();
+			m_HasFailed = m_Stream->fail();
+		}
+		m_NextCommitIndex++;
+	}
+}
\ No newline at end of file
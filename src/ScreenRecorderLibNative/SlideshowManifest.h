@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+
+/// <summary>
+/// Commits the frames of a slideshow to a manifest with one JSON line per frame. Frames can be added in any order as they finish writing,
+/// but are committed in frame order, each as soon as all frames before it are added. The stream is flushed as each frame is committed,
+/// so the manifest is complete up to the last committed frame if the process dies. The manifest is not thread safe.
+/// </summary>
+class SlideshowManifest
+{
+public:
+	SlideshowManifest();
+	/// <summary>
+	/// Starts a new manifest at frame 0, written to the stream, which must outlive the manifest or the next call to Begin.
+	/// </summary>
+	void Begin(std::ostream *pStream);
+	/// <summary>
+	/// Adds a frame that has finished writing, and commits it and the frames that were waiting for it.
+	/// A frame that could not be written is committed without a line in the manifest, so it does not hold up the frames after it.
+	/// </summary>
+	/// <param name="path">The path of the image file, in UTF-8.</param>
+	/// <param name="delayMillis">The time in milliseconds to show the previous frame before this one.</param>
+	/// <returns>false if writing to the stream has failed.</returns>
+	bool AddFrame(uint64_t index, const std::string &path, int64_t delayMillis, bool isWritten);
+	/// <summary>
+	/// Gets the number of frames committed since Begin. Every frame with a lower index has been committed.
+	/// </summary>
+	uint64_t GetCommittedFrameCount() const { return m_NextCommitIndex; }
+	/// <summary>
+	/// Gets the number of frames that are added, but wait for an earlier frame before they can be committed.
+	/// </summary>
+	size_t GetWaitingFrameCount() const { return m_WaitingFrames.size(); }
+	static std::string FormatLine(uint64_t index, const std::string &path, int64_t delayMillis);
+private:
+	struct WAITING_FRAME {
+		std::string Path;
+		int64_t DelayMillis;
+		bool IsWritten;
+	};
+
+	std::ostream *m_Stream;
+	std::map<uint64_t, WAITING_FRAME> m_WaitingFrames;
+	uint64_t m_NextCommitIndex;
+	bool m_HasFailed;
+
+	void CommitWaitingFrames();
+};
\ No newline at end of file
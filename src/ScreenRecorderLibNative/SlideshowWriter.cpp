@@ -0,0 +1,242 @@
+#include "SlideshowWriter.h"
+#include "screengrab.h"
+#include "Log.h"
+#include <filesystem>
+
+using namespace std;
+using namespace std::chrono;
+
+SlideshowWriter::SlideshowWriter() :
+	m_DeviceContext(nullptr),
+	m_Device(nullptr),
+	m_SnapshotOptions(nullptr),
+	m_OutputFolder(L""),
+	m_ManifestPath(L""),
+	m_ManifestFile{},
+	m_Mutex{},
+	m_FrameQueued{},
+	m_FrameCommitted{},
+	m_Queue{},
+	m_Manifest{},
+	m_FreeTextures{},
+	m_Workers{},
+	m_NextFrameIndex(0),
+	m_WriteResult(S_OK),
+	m_IsStopping(false)
+{
+}
+
+SlideshowWriter::~SlideshowWriter()
+{
+	StopWorkers();
+}
+
+HRESULT SlideshowWriter::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<SNAPSHOT_OPTIONS> &pSnapshotOptions)
+{
+	WaitForQueuedFrames();
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_DeviceContext = pDeviceContext;
+	m_Device = pDevice;
+	m_SnapshotOptions = pSnapshotOptions;
+	m_FreeTextures.clear();
+	return S_OK;
+}
+
+HRESULT SlideshowWriter::Begin(_In_ std::wstring outputFolder)
+{
+	if (!m_Device || !m_DeviceContext) {
+		return E_NOT_VALID_STATE;
+	}
+	StopWorkers();
+	m_OutputFolder = outputFolder;
+	m_ManifestPath = (std::filesystem::path(outputFolder) / MANIFEST_FILE_NAME).wstring();
+	m_ManifestFile.open(std::filesystem::path(m_ManifestPath), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_ManifestFile.is_open()) {
+		LOG_ERROR(L"Failed to create slideshow manifest %ls", m_ManifestPath.c_str());
+		return E_ACCESSDENIED;
+	}
+	m_NextFrameIndex = 0;
+	m_WriteResult = S_OK;
+	m_Manifest.Begin(&m_ManifestFile);
+	m_IsStopping = false;
+	UINT32 workerCount = max(1u, m_SnapshotOptions->GetWorkerCount());
+	for (UINT32 i = 0; i < workerCount; i++) {
+		m_Workers.push_back(std::thread([this] { WorkerThreadLoop(); }));
+	}
+	LOG_DEBUG(L"Started %u slideshow worker threads, writing manifest to %ls", workerCount, m_ManifestPath.c_str());
+	return S_OK;
+}
+
+HRESULT SlideshowWriter::QueueFrame(_In_ ID3D11Texture2D *pTexture, _In_ INT64 delayMillis)
+{
+	if (m_Workers.empty()) {
+		return E_NOT_VALID_STATE;
+	}
+	SLIDESHOW_FRAME frame{};
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		RETURN_ON_BAD_HR(m_WriteResult);
+		//The recording thread waits here when the workers fall behind, instead of dropping frames.
+		const size_t maxQueued = max(1u, m_SnapshotOptions->GetMaxQueuedSnapshots());
+		m_FrameCommitted.wait(lock, [&] { return m_Queue.size() < maxQueued || FAILED(m_WriteResult); });
+		RETURN_ON_BAD_HR(m_WriteResult);
+		frame.Index = m_NextFrameIndex;
+	}
+	D3D11_TEXTURE2D_DESC desc;
+	pTexture->GetDesc(&desc);
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.SampleDesc.Count = 1;
+	desc.SampleDesc.Quality = 0;
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+	RETURN_ON_BAD_HR(AcquireTexture(desc, &frame.Texture));
+	m_DeviceContext->CopyResource(frame.Texture, pTexture);
+	frame.Path = m_OutputFolder + L"\\" + to_wstring(frame.Index) + m_SnapshotOptions->GetImageExtension();
+	frame.DelayMillis = delayMillis;
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(frame));
+		m_NextFrameIndex++;
+	}
+	m_FrameQueued.notify_one();
+	return S_OK;
+}
+
+HRESULT SlideshowWriter::Finalize()
+{
+	WaitForQueuedFrames();
+	StopWorkers();
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_ManifestFile.is_open()) {
+		m_ManifestFile.close();
+		LOG_DEBUG(L"Committed %llu slideshow frames to %ls", m_Manifest.GetCommittedFrameCount(), m_ManifestPath.c_str());
+	}
+	m_FreeTextures.clear();
+	return m_WriteResult;
+}
+
+HRESULT SlideshowWriter::AcquireTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto it = m_FreeTextures.begin(); it != m_FreeTextures.end(); it++) {
+			D3D11_TEXTURE2D_DESC pooledDesc;
+			(*it)->GetDesc(&pooledDesc);
+			if (pooledDesc.Width == desc.Width && pooledDesc.Height == desc.Height && pooledDesc.Format == desc.Format) {
+				*ppTexture = it->Detach();
+				m_FreeTextures.erase(it);
+				return S_OK;
+			}
+		}
+	}
+	return m_Device->CreateTexture2D(&desc, nullptr, ppTexture);
+}
+
+void SlideshowWriter::WorkerThreadLoop()
+{
+	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+	LOG_ON_BAD_HR(hr);
+	ImageEncoder encoder;
+	UINT32 encoderThreadCount = m_SnapshotOptions->GetEncoderThreadCount();
+	if (encoderThreadCount == 0) {
+		encoderThreadCount = max(1u, std::thread::hardware_concurrency() / max(1u, m_SnapshotOptions->GetWorkerCount()));
+	}
+	encoder.SetThreadCount(encoderThreadCount);
+	while (true) {
+		SLIDESHOW_FRAME frame{};
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_FrameQueued.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+			if (m_Queue.empty()) {
+				break;
+			}
+			frame = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		HRESULT writeHr = WriteFrame(frame, encoder);
+		if (FAILED(writeHr)) {
+			_com_error err(writeHr);
+			LOG_ERROR(L"Writing of slideshow frame %ls failed: %s", frame.Path.c_str(), err.ErrorMessage());
+		}
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			const size_t maxPooled = static_cast<size_t>(max(1u, m_SnapshotOptions->GetMaxQueuedSnapshots())) + max(1u, m_SnapshotOptions->GetWorkerCount());
+			if (m_FreeTextures.size() >= maxPooled) {
+				m_FreeTextures.erase(m_FreeTextures.begin());
+			}
+			m_FreeTextures.push_back(frame.Texture);
+			if (FAILED(writeHr) && SUCCEEDED(m_WriteResult)) {
+				m_WriteResult = writeHr;
+			}
+			if (!m_Manifest.AddFrame(frame.Index, ws2s(frame.Path), frame.DelayMillis, SUCCEEDED(writeHr)) && SUCCEEDED(m_WriteResult)) {
+				LOG_ERROR(L"Failed to write to slideshow manifest %ls", m_ManifestPath.c_str());
+				m_WriteResult = E_FAIL;
+			}
+		}
+		m_FrameCommitted.notify_all();
+	}
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+}
+
+HRESULT SlideshowWriter::WaitForCopy(_In_ SLIDESHOW_FRAME &frame)
+{
+	//The copy is waited for outside of Map, as a blocking Map would hold the device lock and stall the recording thread.
+	//The texture is polled, backing off up to the timer resolution so a long copy does not keep the worker spinning, and a lost device fails the frame instead of hanging the worker.
+	const steady_clock::time_point deadline = steady_clock::now() + COPY_TIMEOUT;
+	DWORD sleepMillis = 0;
+	while (true) {
+		D3D11_MAPPED_SUBRESOURCE map;
+		HRESULT hr = m_DeviceContext->Map(frame.Texture, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+		if (hr != DXGI_ERROR_WAS_STILL_DRAWING) {
+			RETURN_ON_BAD_HR(hr);
+			m_DeviceContext->Unmap(frame.Texture, 0);
+			return S_OK;
+		}
+		if (steady_clock::now() >= deadline) {
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+		Sleep(sleepMillis);
+		sleepMillis = min(sleepMillis + 1, 16UL);
+	}
+}
+
+HRESULT SlideshowWriter::WriteFrame(_In_ SLIDESHOW_FRAME &frame, _In_ ImageEncoder &encoder)
+{
+	RETURN_ON_BAD_HR(WaitForCopy(frame));
+	std::optional<ImageEncoderFormat> builtInFormat = m_SnapshotOptions->GetBuiltInEncoderFormat();
+	if (builtInFormat.has_value()) {
+		return SaveTextureWithImageEncoderToFile(m_DeviceContext, frame.Texture, builtInFormat.value(), frame.Path.c_str(), &encoder);
+	}
+	return SaveWICTextureToFile(m_DeviceContext, frame.Texture, m_SnapshotOptions->GetSnapshotEncoderFormat(), frame.Path.c_str());
+}
+
+void SlideshowWriter::WaitForQueuedFrames()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if (m_Workers.empty()) {
+		return;
+	}
+	m_FrameCommitted.wait(lock, [this] { return m_Manifest.GetCommittedFrameCount() == m_NextFrameIndex; });
+}
+
+void SlideshowWriter::StopWorkers()
+{
+	if (m_Workers.empty()) {
+		return;
+	}
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_FrameQueued.notify_all();
+	for (std::thread &worker : m_Workers) {
+		worker.join();
+	}
+	m_Workers.clear();
+	m_IsStopping = false;
+}
\ No newline at end of file
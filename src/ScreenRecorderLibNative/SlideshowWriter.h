@@ -0,0 +1,86 @@
+#pragma once
+#include <atlbase.h>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <chrono>
+#include "CommonTypes.h"
+#include "SlideshowManifest.h"
+
+/// <summary>
+/// Writes slideshow frames to numbered image files on a pool of worker threads.
+/// Frames may finish encoding in any order, but are committed in order to a manifest with one JSON line per frame, which is flushed as each frame is committed.
+/// Queueing a frame blocks while the queue is full, so no frames are dropped.
+/// </summary>
+class SlideshowWriter
+{
+public:
+	SlideshowWriter();
+	~SlideshowWriter();
+	/// <summary>
+	/// Sets the device used to copy and read back frames. Any queued frames are written first, as their textures belong to the previous device.
+	/// </summary>
+	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<SNAPSHOT_OPTIONS> &pSnapshotOptions);
+	/// <summary>
+	/// Creates the manifest in the output folder, replacing any existing one, and starts the workers.
+	/// </summary>
+	HRESULT Begin(_In_ std::wstring outputFolder);
+	/// <summary>
+	/// Queues a frame to be written as the next image of the slideshow. Only a GPU copy of the texture is made on the calling thread.
+	/// </summary>
+	/// <param name="delayMillis">The time in milliseconds to show the previous frame before this one.</param>
+	/// <returns>The error of an earlier frame that could not be written, else the result of queueing this frame.</returns>
+	HRESULT QueueFrame(_In_ ID3D11Texture2D *pTexture, _In_ INT64 delayMillis);
+	/// <summary>
+	/// Waits for all queued frames to be committed, then stops the workers and closes the manifest.
+	/// </summary>
+	/// <returns>The error of the first frame that could not be written, or S_OK.</returns>
+	HRESULT Finalize();
+	std::wstring GetManifestPath() { return m_ManifestPath; }
+private:
+	static constexpr const wchar_t *MANIFEST_FILE_NAME = L"manifest.jsonl";
+	//How long a worker waits for the GPU to copy a frame, before the frame fails.
+	static constexpr std::chrono::milliseconds COPY_TIMEOUT = std::chrono::seconds(5);
+
+	struct SLIDESHOW_FRAME {
+		UINT64 Index;
+		CComPtr<ID3D11Texture2D> Texture;
+		std::wstring Path;
+		INT64 DelayMillis;
+	};
+
+	ID3D11DeviceContext *m_DeviceContext;
+	ID3D11Device *m_Device;
+	std::shared_ptr<SNAPSHOT_OPTIONS> m_SnapshotOptions;
+	std::wstring m_OutputFolder;
+	std::wstring m_ManifestPath;
+	std::ofstream m_ManifestFile;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_FrameQueued;
+	std::condition_variable m_FrameCommitted;
+	std::deque<SLIDESHOW_FRAME> m_Queue;
+	SlideshowManifest m_Manifest;
+	std::vector<CComPtr<ID3D11Texture2D>> m_FreeTextures;
+	std::vector<std::thread> m_Workers;
+	UINT64 m_NextFrameIndex;
+	HRESULT m_WriteResult;
+	bool m_IsStopping;
+
+	HRESULT AcquireTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture);
+	void WorkerThreadLoop();
+	/// <summary>
+	/// Waits for the GPU to finish copying the frame into its texture, for at most COPY_TIMEOUT.
+	/// </summary>
+	HRESULT WaitForCopy(_In_ SLIDESHOW_FRAME &frame);
+	HRESULT WriteFrame(_In_ SLIDESHOW_FRAME &frame, _In_ ImageEncoder &encoder);
+	/// <summary>
+	/// Waits until every queued frame is committed.
+	/// </summary>
+	void WaitForQueuedFrames();
+	void StopWorkers();
+};
\ No newline at end of file
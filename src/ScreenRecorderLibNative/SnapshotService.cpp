@@ -0,0 +1,301 @@
+#include "SnapshotService.h"
+#include "screengrab.h"
+#include "Log.h"
+
+using namespace std;
+using namespace std::chrono;
+
+SnapshotService::SnapshotService(_In_ SnapshotCompletedCallback callback) :
+	m_DeviceContext(nullptr),
+	m_Device(nullptr),
+	m_SnapshotOptions(nullptr),
+	m_Callback(callback),
+	m_CopyFence(nullptr),
+	m_FenceContext(nullptr),
+	m_FenceValue(0),
+	m_Mutex{},
+	m_JobAvailable{},
+	m_Queue{},
+	m_FreeTextures{},
+	m_Workers{},
+	m_IsStopping(false),
+	m_Statistics{},
+	m_TotalLatencyMillis(0)
+{
+}
+
+SnapshotService::~SnapshotService()
+{
+	Stop();
+}
+
+HRESULT SnapshotService::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<SNAPSHOT_OPTIONS> &pSnapshotOptions)
+{
+	Stop();
+	m_DeviceContext = pDeviceContext;
+	m_Device = pDevice;
+	m_SnapshotOptions = pSnapshotOptions;
+	m_FreeTextures.clear();
+	m_CopyFence.Release();
+	m_FenceContext.Release();
+	m_FenceValue = 0;
+	CComPtr<ID3D11Device5> pDevice5;
+	if (SUCCEEDED(pDevice->QueryInterface(IID_PPV_ARGS(&pDevice5)))
+		&& SUCCEEDED(pDeviceContext->QueryInterface(IID_PPV_ARGS(&m_FenceContext)))) {
+		HRESULT hr = pDevice5->CreateFence(0, D3D11_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_CopyFence));
+		if (FAILED(hr)) {
+			_com_error err(hr);
+			LOG_DEBUG(L"Failed to create snapshot copy fence, polling for copies instead: %ls", err.ErrorMessage());
+			m_FenceContext.Release();
+		}
+	}
+	else {
+		LOG_DEBUG(L"Fences are not supported by the device, polling for snapshot copies instead");
+		m_FenceContext.Release();
+	}
+	return S_OK;
+}
+
+HRESULT SnapshotService::QueueSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ RECT sourceRect, _In_ std::wstring path)
+{
+	if (!m_DeviceContext || !m_Device) {
+		return E_NOT_VALID_STATE;
+	}
+	D3D11_TEXTURE2D_DESC desc;
+	pTexture->GetDesc(&desc);
+	//If the source frame is larger than the source rect, it is cropped, to avoid black borders around the snapshots.
+	D3D11_BOX box{};
+	box.left = static_cast<UINT>(max(0L, sourceRect.left));
+	box.top = static_cast<UINT>(max(0L, sourceRect.top));
+	box.right = min(desc.Width, static_cast<UINT>(max(0L, sourceRect.right)));
+	box.bottom = min(desc.Height, static_cast<UINT>(max(0L, sourceRect.bottom)));
+	box.front = 0;
+	box.back = 1;
+	if (box.right <= box.left || box.bottom <= box.top) {
+		return E_INVALIDARG;
+	}
+
+	SNAPSHOT_JOB job{};
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_IsStopping) {
+			return E_NOT_VALID_STATE;
+		}
+		if (m_Workers.empty()) {
+			StartWorkers();
+		}
+		const size_t maxQueued = max(1u, m_SnapshotOptions->GetMaxQueuedSnapshots());
+		if (m_Queue.size() >= maxQueued) {
+			m_Statistics.DroppedCount++;
+			if (m_SnapshotOptions->GetQueuePolicy() == SnapshotQueuePolicy::Coalesce) {
+				//Reuse the texture of the replaced snapshot for the new one.
+				job = std::move(m_Queue.back());
+				m_Queue.pop_back();
+				LOG_TRACE(L"Snapshot queue is full, replacing queued snapshot %ls", job.Path.c_str());
+			}
+			else {
+				LOG_TRACE(L"Snapshot queue is full, dropping snapshot %ls", path.c_str());
+				return S_FALSE;
+			}
+		}
+	}
+
+	D3D11_TEXTURE2D_DESC stagingDesc = desc;
+	stagingDesc.Width = box.right - box.left;
+	stagingDesc.Height = box.bottom - box.top;
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.SampleDesc.Count = 1;
+	stagingDesc.SampleDesc.Quality = 0;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+	if (job.Texture) {
+		D3D11_TEXTURE2D_DESC jobDesc;
+		job.Texture->GetDesc(&jobDesc);
+		if (jobDesc.Width != stagingDesc.Width || jobDesc.Height != stagingDesc.Height || jobDesc.Format != stagingDesc.Format) {
+			job.Texture.Release();
+		}
+	}
+	if (!job.Texture) {
+		RETURN_ON_BAD_HR(AcquireTexture(stagingDesc, &job.Texture));
+	}
+	m_DeviceContext->CopySubresourceRegion(job.Texture, 0, 0, 0, 0, pTexture, 0, &box);
+	job.FenceValue = 0;
+	if (m_CopyFence) {
+		job.FenceValue = ++m_FenceValue;
+		RETURN_ON_BAD_HR(m_FenceContext->Signal(m_CopyFence, job.FenceValue));
+		//The signal is only seen by the GPU once the commands before it are submitted.
+		m_DeviceContext->Flush();
+	}
+	job.Path = path;
+	job.QueueTime = steady_clock::now();
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(job));
+		m_Statistics.MaxQueueDepth = max(m_Statistics.MaxQueueDepth, static_cast<UINT32>(m_Queue.size()));
+	}
+	m_JobAvailable.notify_one();
+	return S_OK;
+}
+
+void SnapshotService::Stop()
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Workers.empty()) {
+			return;
+		}
+		m_IsStopping = true;
+	}
+	m_JobAvailable.notify_all();
+	//New snapshots are refused while stopping, so the workers are not changed until they are joined.
+	for (std::thread &worker : m_Workers) {
+		worker.join();
+	}
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Workers.clear();
+	m_IsStopping = false;
+}
+
+SNAPSHOT_STATISTICS SnapshotService::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	SNAPSHOT_STATISTICS stats = m_Statistics;
+	stats.QueueDepth = static_cast<UINT32>(m_Queue.size());
+	UINT64 completedCount = stats.WrittenCount + stats.FailedCount;
+	stats.AverageLatencyMillis = completedCount > 0 ? m_TotalLatencyMillis / completedCount : 0;
+	return stats;
+}
+
+HRESULT SnapshotService::AcquireTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture)
+{
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		for (auto it = m_FreeTextures.begin(); it != m_FreeTextures.end(); it++) {
+			D3D11_TEXTURE2D_DESC pooledDesc;
+			(*it)->GetDesc(&pooledDesc);
+			if (pooledDesc.Width == desc.Width && pooledDesc.Height == desc.Height && pooledDesc.Format == desc.Format) {
+				*ppTexture = it->Detach();
+				m_FreeTextures.erase(it);
+				return S_OK;
+			}
+		}
+	}
+	return m_Device->CreateTexture2D(&desc, nullptr, ppTexture);
+}
+
+void SnapshotService::ReleaseTexture(_In_ ID3D11Texture2D *pTexture)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	//Enough textures to fill the queue while every worker is busy. Textures of an earlier size are evicted first.
+	const size_t maxPooled = static_cast<size_t>(max(1u, m_SnapshotOptions->GetMaxQueuedSnapshots())) + m_Workers.size();
+	if (m_FreeTextures.size() >= maxPooled) {
+		m_FreeTextures.erase(m_FreeTextures.begin());
+	}
+	m_FreeTextures.push_back(pTexture);
+}
+
+void SnapshotService::StartWorkers()
+{
+	UINT32 workerCount = max(1u, m_SnapshotOptions->GetWorkerCount());
+	for (UINT32 i = 0; i < workerCount; i++) {
+		m_Workers.push_back(std::thread([this] { WorkerThreadLoop(); }));
+	}
+	LOG_DEBUG(L"Started %u snapshot worker threads", workerCount);
+}
+
+void SnapshotService::WorkerThreadLoop()
+{
+	HRESULT hr = CoInitializeEx(nullptr, COINITBASE_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+	LOG_ON_BAD_HR(hr);
+	//Each worker keeps its own encoder, so the encoding buffers are reused between snapshots.
+	ImageEncoder encoder;
+	UINT32 encoderThreadCount = m_SnapshotOptions->GetEncoderThreadCount();
+	if (encoderThreadCount == 0) {
+		encoderThreadCount = max(1u, std::thread::hardware_concurrency() / max(1u, m_SnapshotOptions->GetWorkerCount()));
+	}
+	encoder.SetThreadCount(encoderThreadCount);
+	SyncEvent copyEvent(false);
+	while (true) {
+		SNAPSHOT_JOB job{};
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_JobAvailable.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+			//Queued snapshots are written before the worker exits.
+			if (m_Queue.empty()) {
+				break;
+			}
+			job = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		HRESULT writeHr;
+		{
+			TRACE_SCOPE("WriteSnapshot");
+			writeHr = WaitForCopy(job, copyEvent);
+			if (SUCCEEDED(writeHr)) {
+				writeHr = WriteSnapshot(job, encoder);
+			}
+		}
+		double latencyMillis = duration<double, milli>(steady_clock::now() - job.QueueTime).count();
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			if (SUCCEEDED(writeHr)) {
+				m_Statistics.WrittenCount++;
+			}
+			else {
+				m_Statistics.FailedCount++;
+			}
+			m_TotalLatencyMillis += latencyMillis;
+			m_Statistics.MaxLatencyMillis = max(m_Statistics.MaxLatencyMillis, latencyMillis);
+		}
+		ReleaseTexture(job.Texture);
+		if (m_Callback) {
+			m_Callback(writeHr, job.Path);
+		}
+	}
+	if (SUCCEEDED(hr)) {
+		CoUninitialize();
+	}
+}
+
+HRESULT SnapshotService::WaitForCopy(_In_ const SNAPSHOT_JOB &job, _In_ SyncEvent &copyEvent)
+{
+	//The copy is waited for outside of Map, as a blocking Map would hold the device lock and stall the recording thread.
+	if (m_CopyFence && job.FenceValue > 0) {
+		if (m_CopyFence->GetCompletedValue() >= job.FenceValue) {
+			return S_OK;
+		}
+		//Clears a completion of an earlier copy that was signaled after its wait timed out.
+		copyEvent.Reset();
+		RETURN_ON_BAD_HR(m_CopyFence->SetEventOnCompletion(job.FenceValue, copyEvent.GetHandle()));
+		return copyEvent.Wait(COPY_TIMEOUT) ? S_OK : DXGI_ERROR_WAIT_TIMEOUT;
+	}
+	//Without a fence, the texture is polled, backing off up to the timer resolution so a long copy does not keep the worker spinning.
+	const steady_clock::time_point deadline = steady_clock::now() + COPY_TIMEOUT;
+	DWORD sleepMillis = 0;
+	while (true) {
+		D3D11_MAPPED_SUBRESOURCE map;
+		HRESULT hr = m_DeviceContext->Map(job.Texture, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &map);
+		if (hr != DXGI_ERROR_WAS_STILL_DRAWING) {
+			RETURN_ON_BAD_HR(hr);
+			m_DeviceContext->Unmap(job.Texture, 0);
+			return S_OK;
+		}
+		if (steady_clock::now() >= deadline) {
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+		Sleep(sleepMillis);
+		sleepMillis = min(sleepMillis + 1, 16UL);
+	}
+}
+
+HRESULT SnapshotService::WriteSnapshot(_In_ SNAPSHOT_JOB &job, _In_ ImageEncoder &encoder)
+{
+	std::optional<ImageEncoderFormat> builtInFormat = m_SnapshotOptions->GetBuiltInEncoderFormat();
+	if (builtInFormat.has_value()) {
+		return SaveTextureWithImageEncoderToFile(m_DeviceContext, job.Texture, builtInFormat.value(), job.Path.c_str(), &encoder);
+	}
+	return SaveWICTextureToFile(m_DeviceContext, job.Texture, m_SnapshotOptions->GetSnapshotEncoderFormat(), job.Path.c_str());
+}
\ No newline at end of file
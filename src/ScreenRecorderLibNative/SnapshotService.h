@@ -0,0 +1,90 @@
+#pragma once
+#include <atlbase.h>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <chrono>
+#include <d3d11_4.h>
+#include "CommonTypes.h"
+#include "Sync.h"
+
+typedef std::function<void(HRESULT hr, std::wstring path)> SnapshotCompletedCallback;
+
+/// <summary>
+/// Saves snapshots to image files on a fixed set of worker threads.
+/// The calling thread only queues a GPU copy of the frame into a pooled staging texture, and the workers read it back and encode it.
+/// The number of queued snapshots is bounded, and the queue policy decides what happens to new snapshots when it is full.
+/// </summary>
+class SnapshotService
+{
+public:
+	/// <param name="callback">Called on a worker thread when a snapshot has been written or has failed.</param>
+	SnapshotService(_In_ SnapshotCompletedCallback callback);
+	~SnapshotService();
+	/// <summary>
+	/// Initializes the service with a device, releasing any pooled textures from a previous device. Workers are started when the first snapshot is queued.
+	/// Must not be called while snapshots are being queued.
+	/// </summary>
+	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ std::shared_ptr<SNAPSHOT_OPTIONS> &pSnapshotOptions);
+	/// <summary>
+	/// Queues the area of the texture within sourceRect to be saved to the file at path.
+	/// The device must be multithread protected, as the workers map the copied textures while the caller keeps using the device context.
+	/// </summary>
+	/// <returns>S_OK if the snapshot was queued, S_FALSE if it was discarded because the queue is full.</returns>
+	HRESULT QueueSnapshot(_In_ ID3D11Texture2D *pTexture, _In_ RECT sourceRect, _In_ std::wstring path);
+	/// <summary>
+	/// Waits for all queued snapshots to be written, and stops the workers.
+	/// </summary>
+	void Stop();
+	SNAPSHOT_STATISTICS GetStatistics();
+private:
+	struct SNAPSHOT_JOB {
+		CComPtr<ID3D11Texture2D> Texture;
+		std::wstring Path;
+		std::chrono::steady_clock::time_point QueueTime;
+		//The value the copy fence is signaled with once the copy into the texture has finished, or 0 without a fence.
+		UINT64 FenceValue;
+	};
+	//How long a worker waits for the GPU to copy a frame, before the snapshot fails.
+	static constexpr std::chrono::milliseconds COPY_TIMEOUT = std::chrono::seconds(5);
+
+	ID3D11DeviceContext *m_DeviceContext;
+	ID3D11Device *m_Device;
+	std::shared_ptr<SNAPSHOT_OPTIONS> m_SnapshotOptions;
+	SnapshotCompletedCallback m_Callback;
+	//Signaled on the device context after each copy, so the workers can wait for it without polling. Not available before Windows 10 1703.
+	CComPtr<ID3D11Fence> m_CopyFence;
+	CComPtr<ID3D11DeviceContext4> m_FenceContext;
+	UINT64 m_FenceValue;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_JobAvailable;
+	std::deque<SNAPSHOT_JOB> m_Queue;
+	std::vector<CComPtr<ID3D11Texture2D>> m_FreeTextures;
+	std::vector<std::thread> m_Workers;
+	bool m_IsStopping;
+
+	SNAPSHOT_STATISTICS m_Statistics;
+	double m_TotalLatencyMillis;
+
+	/// <summary>
+	/// Gets a staging texture matching the description from the pool, or creates a new one.
+	/// </summary>
+	HRESULT AcquireTexture(_In_ const D3D11_TEXTURE2D_DESC &desc, _Outptr_ ID3D11Texture2D **ppTexture);
+	void ReleaseTexture(_In_ ID3D11Texture2D *pTexture);
+	/// <summary>
+	/// Starts the workers. Must be called with m_Mutex held.
+	/// </summary>
+	void StartWorkers();
+	void WorkerThreadLoop();
+	/// <summary>
+	/// Waits for the GPU to finish copying the frame into the texture of the job, for at most COPY_TIMEOUT.
+	/// </summary>
+	/// <returns>DXGI_ERROR_WAIT_TIMEOUT if the copy did not finish in time.</returns>
+	HRESULT WaitForCopy(_In_ const SNAPSHOT_JOB &job, _In_ SyncEvent &copyEvent);
+	HRESULT WriteSnapshot(_In_ SNAPSHOT_JOB &job, _In_ ImageEncoder &encoder);
+};
\ No newline at end of file
@@ -0,0 +1,466 @@
+#include "SoftwareCompositor.h"
+#include <algorithm>
+#include <cstring>
+
+#if !defined(SOFTWARE_COMPOSITOR_NO_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define SOFTWARE_COMPOSITOR_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#define SOFTWARE_COMPOSITOR_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace {
+	const uint32_t TRANSPARENT_WHITE = 0x00FFFFFF;
+	const uint32_t OPAQUE_BLACK = 0xFF000000;
+
+	inline uint32_t *RowPtr(const BGRA_SURFACE &surface, int32_t y) {
+		return reinterpret_cast<uint32_t *>(surface.Data + static_cast<int64_t>(y) * surface.Stride);
+	}
+
+	inline bool IsValid(const BGRA_SURFACE &surface) {
+		return surface.Data != nullptr
+			&& surface.Width > 0
+			&& surface.Height > 0
+			&& surface.Stride >= surface.Width * 4;
+	}
+
+	//Exact rounded division by 255 for values in [0, 255*255].
+	inline uint32_t Div255(uint32_t value) {
+		value += 128;
+		return (value + (value >> 8)) >> 8;
+	}
+
+	inline uint32_t BilinearChannel(uint32_t p00, uint32_t p01, uint32_t p10, uint32_t p11, uint32_t wx, uint32_t wy, int shift) {
+		uint32_t c00 = (p00 >> shift) & 0xFF;
+		uint32_t c01 = (p01 >> shift) & 0xFF;
+		uint32_t c10 = (p10 >> shift) & 0xFF;
+		uint32_t c11 = (p11 >> shift) & 0xFF;
+		uint32_t top = (c00 * (256 - wx) + c01 * wx + 128) >> 8;
+		uint32_t bottom = (c10 * (256 - wx) + c11 * wx + 128) >> 8;
+		return ((top * (256 - wy) + bottom * wy + 128) >> 8) << shift;
+	}
+
+	/// <summary>
+	/// Calculates the leftmost source pixel and 8 bit interpolation weight for each destination pixel, sampling at pixel centers like the D3D sampler.
+	/// </summary>
+	void CalculateBilinearTaps(int32_t srcLength, int32_t dstLength, int32_t *pOffsets, uint16_t *pWeights) {
+		const int64_t maxPos = static_cast<int64_t>(srcLength - 1) << 16;
+		for (int32_t i = 0; i < dstLength; i++) {
+			int64_t pos = ((static_cast<int64_t>(2 * i + 1) * srcLength) << 16) / (2 * static_cast<int64_t>(dstLength)) - 32768;
+			pos = std::clamp<int64_t>(pos, 0, maxPos);
+			pOffsets[i] = static_cast<int32_t>(pos >> 16);
+			pWeights[i] = static_cast<uint16_t>((pos >> 8) & 0xFF);
+		}
+	}
+}
+
+SoftwareCompositor::SoftwareCompositor() :
+	m_ColumnOffsets{},
+	m_ColumnWeights{},
+	m_RowOffsets{},
+	m_RowWeights{},
+	m_HorizontalContributions{},
+	m_VerticalContributions{},
+	m_AreaRowBuffer{},
+	m_AreaAccumulator{}
+{
+}
+
+SoftwareCompositor::~SoftwareCompositor()
+{
+}
+
+bool SoftwareCompositor::Blit(const BGRA_SURFACE &src, int32_t srcX, int32_t srcY, int32_t width, int32_t height, BGRA_SURFACE &dst, int32_t dstX, int32_t dstY)
+{
+	if (!IsValid(src) || !IsValid(dst) || width < 0 || height < 0) {
+		return false;
+	}
+	//Clip against the source bounds
+	if (srcX < 0) { width += srcX; dstX -= srcX; srcX = 0; }
+	if (srcY < 0) { height += srcY; dstY -= srcY; srcY = 0; }
+	width = std::min(width, src.Width - srcX);
+	height = std::min(height, src.Height - srcY);
+	//Clip against the destination bounds
+	if (dstX < 0) { width += dstX; srcX -= dstX; dstX = 0; }
+	if (dstY < 0) { height += dstY; srcY -= dstY; dstY = 0; }
+	width = std::min(width, dst.Width - dstX);
+	height = std::min(height, dst.Height - dstY);
+	if (width <= 0 || height <= 0) {
+		return true;
+	}
+	for (int32_t row = 0; row < height; row++) {
+		memmove(RowPtr(dst, dstY + row) + dstX, RowPtr(src, srcY + row) + srcX, static_cast<size_t>(width) * 4);
+	}
+	return true;
+}
+
+void SoftwareCompositor::Fill(BGRA_SURFACE &dst, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t color)
+{
+	if (!IsValid(dst)) {
+		return;
+	}
+	int32_t left = std::max(x, 0);
+	int32_t top = std::max(y, 0);
+	int32_t right = std::min(x + width, dst.Width);
+	int32_t bottom = std::min(y + height, dst.Height);
+	for (int32_t row = top; row < bottom; row++) {
+		std::fill(RowPtr(dst, row) + left, RowPtr(dst, row) + std::max(left, right), color);
+	}
+}
+
+bool SoftwareCompositor::Scale(const BGRA_SURFACE &src, BGRA_SURFACE &dst, SoftwareScaleFilter filter)
+{
+	if (!IsValid(src) || !IsValid(dst)) {
+		return false;
+	}
+	if (src.Width == dst.Width && src.Height == dst.Height) {
+		return Blit(src, 0, 0, src.Width, src.Height, dst, 0, 0);
+	}
+	if (filter == SoftwareScaleFilter::Area && dst.Width <= src.Width && dst.Height <= src.Height) {
+		ScaleArea(src, dst);
+	}
+	else {
+		ScaleBilinear(src, dst);
+	}
+	return true;
+}
+
+void SoftwareCompositor::ScaleBilinear(const BGRA_SURFACE &src, BGRA_SURFACE &dst)
+{
+	m_ColumnOffsets.resize(dst.Width);
+	m_ColumnWeights.resize(dst.Width);
+	CalculateBilinearTaps(src.Width, dst.Width, m_ColumnOffsets.data(), m_ColumnWeights.data());
+
+	m_RowOffsets.resize(dst.Height);
+	m_RowWeights.resize(dst.Height);
+	CalculateBilinearTaps(src.Height, dst.Height, m_RowOffsets.data(), m_RowWeights.data());
+
+	for (int32_t y = 0; y < dst.Height; y++) {
+		const int32_t rowOffset = m_RowOffsets[y];
+		const uint32_t *pRow0 = RowPtr(src, rowOffset);
+		const uint32_t *pRow1 = RowPtr(src, std::min(rowOffset + 1, src.Height - 1));
+		uint32_t *pDst = RowPtr(dst, y);
+		const uint32_t wy = m_RowWeights[y];
+#if defined(SOFTWARE_COMPOSITOR_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(128);
+		const __m128i verticalWeights = _mm_set_epi16(
+			(short)wy, (short)wy, (short)wy, (short)wy,
+			(short)(256 - wy), (short)(256 - wy), (short)(256 - wy), (short)(256 - wy));
+#endif
+		for (int32_t x = 0; x < dst.Width; x++) {
+			const int32_t x0 = m_ColumnOffsets[x];
+			const int32_t x1 = std::min(x0 + 1, src.Width - 1);
+			const uint32_t wx = m_ColumnWeights[x];
+#if defined(SOFTWARE_COMPOSITOR_SSE2)
+			//Lanes 0-3 hold the top row, lanes 4-7 the bottom row. All intermediate values fit in unsigned 16 bit, so this matches the scalar path exactly.
+			__m128i left = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)pRow0[x0]), _mm_cvtsi32_si128((int)pRow1[x0])), zero);
+			__m128i right = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)pRow0[x1]), _mm_cvtsi32_si128((int)pRow1[x1])), zero);
+			__m128i horizontal = _mm_add_epi16(_mm_mullo_epi16(left, _mm_set1_epi16((short)(256 - wx))), _mm_mullo_epi16(right, _mm_set1_epi16((short)wx)));
+			horizontal = _mm_srli_epi16(_mm_add_epi16(horizontal, round), 8);
+			__m128i vertical = _mm_mullo_epi16(horizontal, verticalWeights);
+			vertical = _mm_add_epi16(vertical, _mm_srli_si128(vertical, 8));
+			vertical = _mm_srli_epi16(_mm_add_epi16(vertical, round), 8);
+			pDst[x] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(vertical, zero));
+#else
+			const uint32_t p00 = pRow0[x0], p01 = pRow0[x1], p10 = pRow1[x0], p11 = pRow1[x1];
+			pDst[x] = BilinearChannel(p00, p01, p10, p11, wx, wy, 0)
+				| BilinearChannel(p00, p01, p10, p11, wx, wy, 8)
+				| BilinearChannel(p00, p01, p10, p11, wx, wy, 16)
+				| BilinearChannel(p00, p01, p10, p11, wx, wy, 24);
+#endif
+		}
+	}
+}
+
+void SoftwareCompositor::CalculateAreaContributions(int32_t srcLength, int32_t dstLength, std::vector<AREA_CONTRIBUTION> *pContributions)
+{
+	//Each source pixel i covers [i * dstLength, (i + 1) * dstLength) and each destination pixel d covers [d * srcLength, (d + 1) * srcLength),
+	//so the overlaps are exact integers and the weights of each destination pixel add up to srcLength.
+	pContributions->resize(dstLength);
+	for (int32_t d = 0; d < dstLength; d++) {
+		const int64_t start = static_cast<int64_t>(d) * srcLength;
+		const int64_t end = start + srcLength;
+		AREA_CONTRIBUTION &contribution = (*pContributions)[d];
+		contribution.First = static_cast<int32_t>(start / dstLength);
+		const int32_t last = static_cast<int32_t>((end - 1) / dstLength);
+		contribution.Weights.clear();
+		for (int32_t i = contribution.First; i <= last; i++) {
+			const int64_t overlap = std::min<int64_t>(static_cast<int64_t>(i + 1) * dstLength, end) - std::max<int64_t>(static_cast<int64_t>(i) * dstLength, start);
+			contribution.Weights.push_back(static_cast<uint32_t>(overlap));
+		}
+	}
+}
+
+void SoftwareCompositor::ScaleArea(const BGRA_SURFACE &src, BGRA_SURFACE &dst)
+{
+	CalculateAreaContributions(src.Width, dst.Width, &m_HorizontalContributions);
+	CalculateAreaContributions(src.Height, dst.Height, &m_VerticalContributions);
+	const size_t channelCount = static_cast<size_t>(dst.Width) * 4;
+	m_AreaRowBuffer.resize(channelCount);
+	m_AreaAccumulator.resize(channelCount);
+	const uint64_t divisor = static_cast<uint64_t>(src.Width) * src.Height;
+
+	for (int32_t y = 0; y < dst.Height; y++) {
+		std::fill(m_AreaAccumulator.begin(), m_AreaAccumulator.end(), 0);
+		const AREA_CONTRIBUTION &rows = m_VerticalContributions[y];
+		for (size_t r = 0; r < rows.Weights.size(); r++) {
+			const uint32_t *pSrc = RowPtr(src, rows.First + static_cast<int32_t>(r));
+			for (int32_t x = 0; x < dst.Width; x++) {
+				const AREA_CONTRIBUTION &columns = m_HorizontalContributions[x];
+				uint32_t b = 0, g = 0, red = 0, a = 0;
+				for (size_t c = 0; c < columns.Weights.size(); c++) {
+					const uint32_t pixel = pSrc[columns.First + c];
+					const uint32_t weight = columns.Weights[c];
+					b += (pixel & 0xFF) * weight;
+					g += ((pixel >> 8) & 0xFF) * weight;
+					red += ((pixel >> 16) & 0xFF) * weight;
+					a += (pixel >> 24) * weight;
+				}
+				m_AreaRowBuffer[x * 4] = b;
+				m_AreaRowBuffer[x * 4 + 1] = g;
+				m_AreaRowBuffer[x * 4 + 2] = red;
+				m_AreaRowBuffer[x * 4 + 3] = a;
+			}
+			const uint64_t rowWeight = rows.Weights[r];
+			for (size_t i = 0; i < channelCount; i++) {
+				m_AreaAccumulator[i] += m_AreaRowBuffer[i] * rowWeight;
+			}
+		}
+		uint32_t *pDst = RowPtr(dst, y);
+		for (int32_t x = 0; x < dst.Width; x++) {
+			uint32_t pixel = 0;
+			for (int channel = 0; channel < 4; channel++) {
+				const uint64_t value = (m_AreaAccumulator[x * 4 + channel] + divisor / 2) / divisor;
+				pixel |= static_cast<uint32_t>(std::min<uint64_t>(value, 255)) << (channel * 8);
+			}
+			pDst[x] = pixel;
+		}
+	}
+}
+
+bool SoftwareCompositor::Rotate(const BGRA_SURFACE &src, BGRA_SURFACE &dst, SoftwareRotation rotation)
+{
+	if (!IsValid(src) || !IsValid(dst)) {
+		return false;
+	}
+	const bool isSwapped = rotation == SoftwareRotation::Rotate90 || rotation == SoftwareRotation::Rotate270;
+	if (dst.Width != (isSwapped ? src.Height : src.Width) || dst.Height != (isSwapped ? src.Width : src.Height)) {
+		return false;
+	}
+	if (rotation == SoftwareRotation::Identity) {
+		return Blit(src, 0, 0, src.Width, src.Height, dst, 0, 0);
+	}
+	//Work in tiles so both the reads and the writes stay within a few cache lines.
+	const int32_t tileSize = 32;
+	for (int32_t tileY = 0; tileY < src.Height; tileY += tileSize) {
+		const int32_t tileBottom = std::min(tileY + tileSize, src.Height);
+		for (int32_t tileX = 0; tileX < src.Width; tileX += tileSize) {
+			const int32_t tileRight = std::min(tileX + tileSize, src.Width);
+			for (int32_t y = tileY; y < tileBottom; y++) {
+				const uint32_t *pSrc = RowPtr(src, y);
+				for (int32_t x = tileX; x < tileRight; x++) {
+					switch (rotation)
+					{
+						case SoftwareRotation::Rotate90:
+							RowPtr(dst, x)[src.Height - 1 - y] = pSrc[x];
+							break;
+						case SoftwareRotation::Rotate180:
+							RowPtr(dst, src.Height - 1 - y)[src.Width - 1 - x] = pSrc[x];
+							break;
+						case SoftwareRotation::Rotate270:
+							RowPtr(dst, src.Width - 1 - x)[y] = pSrc[x];
+							break;
+						default:
+							break;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool SoftwareCompositor::AlphaBlend(const BGRA_SURFACE &src, BGRA_SURFACE &dst, int32_t dstX, int32_t dstY, SoftwareAlphaMode mode)
+{
+	if (!IsValid(src) || !IsValid(dst)) {
+		return false;
+	}
+	const int32_t srcX = std::max(0, -dstX);
+	const int32_t srcY = std::max(0, -dstY);
+	const int32_t left = std::max(0, dstX);
+	const int32_t top = std::max(0, dstY);
+	const int32_t width = std::min(src.Width - srcX, dst.Width - left);
+	const int32_t height = std::min(src.Height - srcY, dst.Height - top);
+	for (int32_t row = 0; row < height; row++) {
+		const uint32_t *pSrc = RowPtr(src, srcY + row) + srcX;
+		uint32_t *pDst = RowPtr(dst, top + row) + left;
+		if (mode == SoftwareAlphaMode::Premultiplied) {
+			BlendRowPremultiplied(pSrc, pDst, width);
+		}
+		else {
+			BlendRowStraight(pSrc, pDst, width);
+		}
+	}
+	return true;
+}
+
+void SoftwareCompositor::BlendRowPremultiplied(const uint32_t *pSrc, uint32_t *pDst, int32_t count)
+{
+	int32_t i = 0;
+#if defined(SOFTWARE_COMPOSITOR_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(128);
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDst + i));
+		__m128i result[2];
+		for (int half = 0; half < 2; half++) {
+			__m128i s16 = half == 0 ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+			__m128i d16 = half == 0 ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+			__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i t = _mm_add_epi16(_mm_mullo_epi16(d16, _mm_sub_epi16(max, alpha)), round);
+			t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+			result[half] = _mm_add_epi16(s16, t);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + i), _mm_packus_epi16(result[0], result[1]));
+	}
+#elif defined(SOFTWARE_COMPOSITOR_NEON)
+	const uint16x8_t round = vdupq_n_u16(128);
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t *>(pSrc + i));
+		uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t *>(pDst + i));
+		uint8x8_t inverseAlpha = vmvn_u8(s.val[3]);
+		for (int channel = 0; channel < 4; channel++) {
+			uint16x8_t t = vaddq_u16(vmull_u8(d.val[channel], inverseAlpha), round);
+			t = vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+			d.val[channel] = vqadd_u8(s.val[channel], vmovn_u16(t));
+		}
+		vst4_u8(reinterpret_cast<uint8_t *>(pDst + i), d);
+	}
+#endif
+	for (; i < count; i++) {
+		const uint32_t s = pSrc[i];
+		const uint32_t d = pDst[i];
+		const uint32_t inverseAlpha = 255 - (s >> 24);
+		uint32_t pixel = 0;
+		for (int shift = 0; shift < 32; shift += 8) {
+			const uint32_t value = ((s >> shift) & 0xFF) + Div255(((d >> shift) & 0xFF) * inverseAlpha);
+			pixel |= std::min<uint32_t>(value, 255) << shift;
+		}
+		pDst[i] = pixel;
+	}
+}
+
+void SoftwareCompositor::BlendRowStraight(const uint32_t *pSrc, uint32_t *pDst, int32_t count)
+{
+	int32_t i = 0;
+#if defined(SOFTWARE_COMPOSITOR_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(128);
+	const __m128i alphaMask = _mm_set1_epi32((int)OPAQUE_BLACK);
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + i));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pDst + i));
+		__m128i result[2];
+		for (int half = 0; half < 2; half++) {
+			__m128i s16 = half == 0 ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+			__m128i d16 = half == 0 ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+			__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(s16, alpha), _mm_mullo_epi16(d16, _mm_sub_epi16(max, alpha))), round);
+			result[half] = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+		}
+		__m128i color = _mm_packus_epi16(result[0], result[1]);
+		color = _mm_or_si128(_mm_andnot_si128(alphaMask, color), _mm_and_si128(alphaMask, s));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + i), color);
+	}
+#elif defined(SOFTWARE_COMPOSITOR_NEON)
+	const uint16x8_t round = vdupq_n_u16(128);
+	for (; i + 8 <= count; i += 8) {
+		uint8x8x4_t s = vld4_u8(reinterpret_cast<const uint8_t *>(pSrc + i));
+		uint8x8x4_t d = vld4_u8(reinterpret_cast<const uint8_t *>(pDst + i));
+		uint8x8_t inverseAlpha = vmvn_u8(s.val[3]);
+		for (int channel = 0; channel < 3; channel++) {
+			uint16x8_t t = vaddq_u16(vmlal_u8(vmull_u8(s.val[channel], s.val[3]), d.val[channel], inverseAlpha), round);
+			t = vshrq_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+			d.val[channel] = vmovn_u16(t);
+		}
+		d.val[3] = s.val[3];
+		vst4_u8(reinterpret_cast<uint8_t *>(pDst + i), d);
+	}
+#endif
+	for (; i < count; i++) {
+		const uint32_t s = pSrc[i];
+		const uint32_t d = pDst[i];
+		const uint32_t alpha = s >> 24;
+		uint32_t pixel = s & OPAQUE_BLACK;
+		for (int shift = 0; shift < 24; shift += 8) {
+			pixel |= Div255(((s >> shift) & 0xFF) * alpha + ((d >> shift) & 0xFF) * (255 - alpha)) << shift;
+		}
+		pDst[i] = pixel;
+	}
+}
+
+bool SoftwareCompositor::RenderPointerShape(const SOFTWARE_POINTER_SHAPE &shape, const BGRA_SURFACE &background, BGRA_SURFACE &dst)
+{
+	if (!shape.Buffer || shape.Width <= 0 || shape.Height <= 0 || !IsValid(background) || !IsValid(dst)) {
+		return false;
+	}
+	if (background.Width < shape.Width || background.Height < shape.Height || dst.Width < shape.Width || dst.Height < shape.Height) {
+		return false;
+	}
+	for (int32_t row = 0; row < shape.Height; row++) {
+		const uint32_t *pBackground = RowPtr(background, row);
+		uint32_t *pDst = RowPtr(dst, row);
+		switch (shape.Type)
+		{
+			case SoftwarePointerType::Color: {
+				memcpy(pDst, shape.Buffer + static_cast<int64_t>(row) * shape.Pitch, static_cast<size_t>(shape.Width) * 4);
+				break;
+			}
+			case SoftwarePointerType::Monochrome: {
+				//https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-monochrome-pointers
+				const uint8_t *pAndMask = shape.Buffer + static_cast<int64_t>(row) * shape.Pitch;
+				const uint8_t *pXorMask = shape.Buffer + static_cast<int64_t>(row + shape.Height) * shape.Pitch;
+				for (int32_t col = 0; col < shape.Width; col++) {
+					const uint8_t bit = static_cast<uint8_t>(0x80 >> (col % 8));
+					const bool andMask = (pAndMask[col / 8] & bit) != 0;
+					const bool xorMask = (pXorMask[col / 8] & bit) != 0;
+					if (andMask && !xorMask) {
+						pDst[col] = TRANSPARENT_WHITE;
+					}
+					else {
+						pDst[col] = ((andMask ? pBackground[col] : 0) ^ (xorMask ? TRANSPARENT_WHITE : 0)) | OPAQUE_BLACK;
+					}
+				}
+				break;
+			}
+			case SoftwarePointerType::MaskedColor: {
+				//https://docs.microsoft.com/en-us/windows-hardware/drivers/display/drawing-color-pointers
+				const uint32_t *pShape = reinterpret_cast<const uint32_t *>(shape.Buffer + static_cast<int64_t>(row) * shape.Pitch);
+				for (int32_t col = 0; col < shape.Width; col++) {
+					const uint32_t value = pShape[col];
+					const uint32_t mask = value & OPAQUE_BLACK;
+					if (!mask) {
+						pDst[col] = value | OPAQUE_BLACK;
+					}
+					else if (value == mask) {
+						pDst[col] = TRANSPARENT_WHITE;
+					}
+					else {
+						pDst[col] = (pBackground[col] ^ value) | OPAQUE_BLACK;
+					}
+				}
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// A view of a 32bpp BGRA image in CPU memory. The memory is owned by the caller.
+/// </summary>
+struct BGRA_SURFACE {
+	uint8_t *Data = nullptr;
+	int32_t Stride = 0;
+	int32_t Width = 0;
+	int32_t Height = 0;
+};
+
+enum class SoftwareScaleFilter {
+	///<summary>Interpolate between the four nearest source pixels.</summary>
+	Bilinear,
+	///<summary>Average all source pixels covered by the destination pixel. Falls back to bilinear when upscaling.</summary>
+	Area
+};
+
+enum class SoftwareRotation {
+	Identity,
+	///<summary>Rotate 90 degrees clockwise.</summary>
+	Rotate90,
+	Rotate180,
+	///<summary>Rotate 270 degrees clockwise.</summary>
+	Rotate270
+};
+
+enum class SoftwareAlphaMode {
+	///<summary>Source color is premultiplied by alpha: dst = src + dst * (1 - srcAlpha).</summary>
+	Premultiplied,
+	///<summary>Source color is straight alpha, matching the D3D blend state used by TextureManager: dst.rgb = src.rgb * srcAlpha + dst.rgb * (1 - srcAlpha), dst.a = src.a.</summary>
+	Straight
+};
+
+enum class SoftwarePointerType {
+	Monochrome,
+	Color,
+	MaskedColor
+};
+
+/// <summary>
+/// A mouse pointer shape as delivered by Desktop Duplication. For monochrome pointers, Height is the height of the visible pointer,
+/// and the buffer contains the AND mask followed by the XOR mask.
+/// </summary>
+struct SOFTWARE_POINTER_SHAPE {
+	const uint8_t *Buffer = nullptr;
+	SoftwarePointerType Type = SoftwarePointerType::Color;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	int32_t Pitch = 0;
+};
+
+/// <summary>
+/// Portable CPU implementation of the composition operations otherwise done with D3D11 shaders.
+/// All operations work on BGRA surfaces and clip to the destination bounds.
+/// </summary>
+class SoftwareCompositor
+{
+public:
+	SoftwareCompositor();
+	~SoftwareCompositor();
+	/// <summary>
+	/// Copies a region of the source surface to the given position in the destination surface.
+	/// </summary>
+	/// <returns>false if the arguments are invalid, else true</returns>
+	bool Blit(const BGRA_SURFACE &src, int32_t srcX, int32_t srcY, int32_t width, int32_t height, BGRA_SURFACE &dst, int32_t dstX, int32_t dstY);
+	/// <summary>
+	/// Scales the whole source surface to fill the whole destination surface.
+	/// </summary>
+	bool Scale(const BGRA_SURFACE &src, BGRA_SURFACE &dst, SoftwareScaleFilter filter);
+	/// <summary>
+	/// Rotates the source surface into the destination surface, which must have the rotated dimensions.
+	/// </summary>
+	bool Rotate(const BGRA_SURFACE &src, BGRA_SURFACE &dst, SoftwareRotation rotation);
+	/// <summary>
+	/// Blends the source surface on top of the destination surface at the given position.
+	/// </summary>
+	bool AlphaBlend(const BGRA_SURFACE &src, BGRA_SURFACE &dst, int32_t dstX, int32_t dstY, SoftwareAlphaMode mode);
+	/// <summary>
+	/// Renders a pointer shape against the background it will be drawn on, producing a straight alpha image of the same size as the shape.
+	/// Pixels where the pointer is not visible are transparent, so the result can be scaled independently of the background before being blended.
+	/// </summary>
+	/// <param name="shape">The pointer shape</param>
+	/// <param name="background">The background pixels covered by the pointer, with the same dimensions as the pointer</param>
+	/// <param name="dst">The rendered pointer, with the same dimensions as the pointer</param>
+	bool RenderPointerShape(const SOFTWARE_POINTER_SHAPE &shape, const BGRA_SURFACE &background, BGRA_SURFACE &dst);
+	/// <summary>
+	/// Fills a region of the surface with a single BGRA value.
+	/// </summary>
+	void Fill(BGRA_SURFACE &dst, int32_t x, int32_t y, int32_t width, int32_t height, uint32_t color);
+private:
+	struct AREA_CONTRIBUTION {
+		int32_t First;
+		std::vector<uint32_t> Weights;
+	};
+	void ScaleBilinear(const BGRA_SURFACE &src, BGRA_SURFACE &dst);
+	void ScaleArea(const BGRA_SURFACE &src, BGRA_SURFACE &dst);
+	void CalculateAreaContributions(int32_t srcLength, int32_t dstLength, std::vector<AREA_CONTRIBUTION> *pContributions);
+	void BlendRowPremultiplied(const uint32_t *pSrc, uint32_t *pDst, int32_t count);
+	void BlendRowStraight(const uint32_t *pSrc, uint32_t *pDst, int32_t count);
+
+	std::vector<int32_t> m_ColumnOffsets;
+	std::vector<uint16_t> m_ColumnWeights;
+	std::vector<int32_t> m_RowOffsets;
+	std::vector<uint16_t> m_RowWeights;
+	std::vector<AREA_CONTRIBUTION> m_HorizontalContributions;
+	std::vector<AREA_CONTRIBUTION> m_VerticalContributions;
+	std::vector<uint32_t> m_AreaRowBuffer;
+	std::vector<uint64_t> m_AreaAccumulator;
+};
\ No newline at end of file
@@ -8,11 +8,11 @@ SourceReaderBase::SourceReaderBase() :
 	m_LastSampleReceivedTimeStamp{ 0 },
 	m_ReferenceCount(1),
 	m_Stride(0),
-	m_FrameRate(0),
+	m_FrameRate{ 0, 1 },
 	m_FrameSize{},
 	m_FramerateTimer(nullptr),
-	m_NewFrameEvent(nullptr),
-	m_StopCaptureEvent(nullptr),
+	m_NewFrameEvent(false),
+	m_StopCaptureEvent(true),
 	m_OutputMediaType(nullptr),
 	m_InputMediaType(nullptr),
 	m_SourceReader(nullptr),
@@ -22,20 +22,13 @@ SourceReaderBase::SourceReaderBase() :
 	m_DeviceManager(nullptr),
 	m_ResetToken(0)
 {
-	InitializeCriticalSection(&m_CriticalSection);
-	m_NewFrameEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-	m_StopCaptureEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 }
 SourceReaderBase::~SourceReaderBase()
 {
 	Close();
-	EnterCriticalSection(&m_CriticalSection);
-
+	m_Mutex.lock();
 	delete m_FramerateTimer;
-	CloseHandle(m_NewFrameEvent);
-	CloseHandle(m_StopCaptureEvent);
-	LeaveCriticalSection(&m_CriticalSection);
-	DeleteCriticalSection(&m_CriticalSection);
+	m_Mutex.unlock();
 
 	delete[] m_PtrFrameBuffer;
 	m_PtrFrameBuffer = nullptr;
@@ -44,8 +37,7 @@ SourceReaderBase::~SourceReaderBase()
 HRESULT SourceReaderBase::StartCapture(_In_ RECORDING_SOURCE_BASE &recordingSource)
 {
 	HRESULT hr;
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"StartCapture");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	m_RecordingSource = &recordingSource;
 	long streamIndex;
 
@@ -61,7 +53,7 @@ HRESULT SourceReaderBase::StartCapture(_In_ RECORDING_SOURCE_BASE &recordingSour
 	RETURN_ON_BAD_HR(GetFrameSize(m_InputMediaType, &m_FrameSize));
 	if (SUCCEEDED(hr))
 	{
-		ResetEvent(m_StopCaptureEvent);
+		m_StopCaptureEvent.Reset();
 		// Ask for the first sample.
 		hr = m_SourceReader->ReadSample(streamIndex, 0, NULL, NULL, NULL, NULL);
 	}
@@ -91,13 +83,17 @@ HRESULT SourceReaderBase::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSou
 
 void SourceReaderBase::Close()
 {
-	EnterCriticalSection(&m_CriticalSection);
+	m_Mutex.lock();
 	SafeRelease(&m_Sample);
 	if (m_FramerateTimer) {
 		m_FramerateTimer->StopTimer(true);
+		METRIC_HISTOGRAM_VALUE jitter = m_FramerateTimer->GetJitter();
+		if (jitter.Count > 0) {
+			LOG_DEBUG(L"Source reader frame pacing lateness: p50 %llu us, p99 %llu us, max %llu us, %llu ticks skipped", jitter.P50, jitter.P99, jitter.Max, m_FramerateTimer->GetSkippedTickCount());
+		}
 	}
-	SetEvent(m_StopCaptureEvent);
-	LeaveCriticalSection(&m_CriticalSection);
+	m_StopCaptureEvent.Set();
+	m_Mutex.unlock();
 	SafeRelease(&m_SourceReader);
 	SafeRelease(&m_InputMediaType);
 	SafeRelease(&m_MediaTransform);
@@ -105,17 +101,16 @@ void SourceReaderBase::Close()
 
 HRESULT SourceReaderBase::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_ ID3D11Texture2D **ppFrame)
 {
-	DWORD result = WAIT_OBJECT_0;
+	bool isNewFrame = true;
 
 	if (m_LastGrabTimeStamp.QuadPart >= m_LastSampleReceivedTimeStamp.QuadPart) {
-		result = WaitForSingleObject(m_NewFrameEvent, timeoutMillis);
+		isNewFrame = m_NewFrameEvent.Wait(timeoutMillis == INFINITE ? SYNC_INFINITE : std::chrono::milliseconds(timeoutMillis));
 	}
 	HRESULT hr = S_OK;
-	if (result == WAIT_OBJECT_0) {
+	if (isNewFrame) {
 		//Only create frame if the caller accepts one.
 		if (ppFrame) {
-			EnterCriticalSection(&m_CriticalSection);
-			LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"GetFrameBuffer");
+			const std::lock_guard<SyncMutex> lock(m_Mutex);
 
 
 			DWORD len;
@@ -153,13 +148,8 @@ HRESULT SourceReaderBase::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt
 			}
 		}
 	}
-	else if (result == WAIT_TIMEOUT) {
-		hr = DXGI_ERROR_WAIT_TIMEOUT;
-	}
 	else {
-		DWORD dwErr = GetLastError();
-		LOG_ERROR(L"WaitForSingleObject failed: last error = %u", dwErr);
-		hr = HRESULT_FROM_WIN32(dwErr);
+		hr = DXGI_ERROR_WAIT_TIMEOUT;
 	}
 	return hr;
 }
@@ -356,7 +346,7 @@ HRESULT SourceReaderBase::CreateIMFTransform(_In_ DWORD streamIndex, _In_ IMFMed
 HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD streamFlags, LONGLONG timeStamp, IMFSample *sample)
 {
 	HRESULT hr = status;
-	if (SUCCEEDED(hr) && WaitForSingleObject(m_StopCaptureEvent, 0) != WAIT_OBJECT_0) {
+	if (SUCCEEDED(hr) && !m_StopCaptureEvent.Wait(std::chrono::milliseconds(0))) {
 		if (streamFlags & MF_SOURCE_READERF_ENDOFSTREAM) {
 			PROPVARIANT var;
 			HRESULT hr = InitPropVariantFromInt64(0, &var);
@@ -365,9 +355,8 @@ HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD
 		}
 		if (sample)
 		{
-			EnterCriticalSection(&m_CriticalSection);
 			{
-				LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"OnReadSample");
+				const std::lock_guard<SyncMutex> lock(m_Mutex);
 				if (m_MediaTransform) {
 					//Run media transform to convert sample to MFVideoFormat_ARGB32
 					MFT_OUTPUT_STREAM_INFO info{};
@@ -421,14 +410,15 @@ HRESULT SourceReaderBase::OnReadSample(HRESULT status, DWORD streamIndex, DWORD
 				}
 				//Update timestamp and notify that there is a new sample available
 				QueryPerformanceCounter(&m_LastSampleReceivedTimeStamp);
-				SetEvent(m_NewFrameEvent);
+				m_NewFrameEvent.Set();
 			}
 			if (SUCCEEDED(hr)) {
 				if (!m_FramerateTimer) {
 					m_FramerateTimer = new HighresTimer();
-					m_FramerateTimer->StartRecurringTimer((INT64)floor(1000 / m_FrameRate));
+					//The period is the inverse of the frame rate, so rates like 30000/1001 fps are paced exactly.
+					m_FramerateTimer->StartRecurringTimer(m_FrameRate.Denominator, m_FrameRate.Numerator);
 				}
-				if (m_FrameRate > 0) {
+				if (m_FrameRate.Numerator > 0) {
 					auto t1 = std::chrono::high_resolution_clock::now();
 					auto sleepTime = m_FramerateTimer->GetMillisUntilNextTick();
 					MeasureExecutionTime measureNextTick(L"OnReadSample scheduled delay");
@@ -61,12 +61,12 @@ protected:
 	virtual HRESULT CreateOutputMediaType(_In_ SIZE frameSize, _Outptr_ IMFMediaType **pType, _Out_ LONG *stride);
 	virtual HRESULT CreateIMFTransform(_In_ DWORD streamIndex, _In_ IMFMediaType *pInputMediaType, _Outptr_ IMFTransform **pColorConverter, _Outptr_ IMFMediaType **ppOutputMediaType);
 	virtual HRESULT SourceReaderBase::ResizeFrameBuffer(UINT bufferSize);
-	CRITICAL_SECTION m_CriticalSection;
+	SyncMutex m_Mutex;
 	inline IMFDXGIDeviceManager *GetDeviceManager() { return m_DeviceManager; }
 private:
 	long m_ReferenceCount;
-	HANDLE m_NewFrameEvent;
-	HANDLE m_StopCaptureEvent;
+	SyncEvent m_NewFrameEvent;
+	SyncEvent m_StopCaptureEvent;
 	LARGE_INTEGER m_LastSampleReceivedTimeStamp;
 	IMFMediaBuffer *m_Sample;
 	HighresTimer *m_FramerateTimer;
@@ -80,5 +80,5 @@ private:
 	_Field_size_bytes_(m_BufferSize) BYTE *m_PtrFrameBuffer;
 	LONG m_Stride;
 	SIZE m_FrameSize;
-	double m_FrameRate;
+	MFRatio m_FrameRate;
 };
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "Sync.h"
+#include <algorithm>
+#include <thread>
+#ifdef _WIN32
+#include <timeapi.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <cerrno>
+#include <condition_variable>
+#include <time.h>
+#endif
+
+#ifdef _WIN32
+namespace {
+	DWORD ToTimeoutMillis(std::chrono::milliseconds timeout)
+	{
+		if (timeout == SYNC_INFINITE) {
+			return INFINITE;
+		}
+		return static_cast<DWORD>((std::clamp)(timeout.count(), static_cast<long long>(0), static_cast<long long>(INFINITE - 1)));
+	}
+}
+
+SyncEvent::SyncEvent(bool isManualReset, bool isInitiallySet) :
+	m_Handle(CreateEvent(nullptr, isManualReset, isInitiallySet, nullptr))
+{
+}
+
+SyncEvent::~SyncEvent()
+{
+	if (m_Handle) {
+		CloseHandle(m_Handle);
+	}
+}
+
+void SyncEvent::Set()
+{
+	SetEvent(m_Handle);
+}
+
+void SyncEvent::Reset()
+{
+	ResetEvent(m_Handle);
+}
+
+bool SyncEvent::Wait(std::chrono::milliseconds timeout)
+{
+	return WaitForSingleObject(m_Handle, ToTimeoutMillis(timeout)) == WAIT_OBJECT_0;
+}
+
+size_t WaitAny(std::initializer_list<SyncEvent *> events, std::chrono::milliseconds timeout)
+{
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	DWORD count = 0;
+	for (SyncEvent *pEvent : events) {
+		if (count < MAXIMUM_WAIT_OBJECTS) {
+			handles[count++] = pEvent->m_Handle;
+		}
+	}
+	const DWORD result = WaitForMultipleObjects(count, handles, FALSE, ToTimeoutMillis(timeout));
+	if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + count) {
+		return result - WAIT_OBJECT_0;
+	}
+	return SYNC_WAIT_TIMEOUT;
+}
+
+SyncMutex::SyncMutex()
+{
+	InitializeCriticalSection(&m_CriticalSection);
+}
+
+SyncMutex::~SyncMutex()
+{
+	DeleteCriticalSection(&m_CriticalSection);
+}
+
+void SyncMutex::lock()
+{
+	EnterCriticalSection(&m_CriticalSection);
+}
+
+void SyncMutex::unlock()
+{
+	LeaveCriticalSection(&m_CriticalSection);
+}
+
+bool SyncMutex::try_lock()
+{
+	return TryEnterCriticalSection(&m_CriticalSection);
+}
+
+DeadlineTimer::DeadlineTimer() :
+	m_Timer(nullptr),
+	m_TimerResolution(0)
+{
+	//CREATE_WAITABLE_TIMER_HIGH_RESOLUTION was introduced in Windows 10 1803. CreateWaitableTimerEx returns NULL if it is not available.
+	m_Timer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!m_Timer) {
+		m_Timer = CreateWaitableTimer(nullptr, FALSE, nullptr);
+		//Regular waitable timers fire on the system timer tick, so raise its resolution.
+		TIMECAPS tc;
+		if (timeGetDevCaps(&tc, sizeof(TIMECAPS)) == TIMERR_NOERROR) {
+			m_TimerResolution = (std::min)((std::max)(tc.wPeriodMin, 1u), tc.wPeriodMax);
+			timeBeginPeriod(m_TimerResolution);
+		}
+	}
+}
+
+DeadlineTimer::~DeadlineTimer()
+{
+	if (m_TimerResolution > 0) {
+		timeEndPeriod(m_TimerResolution);
+	}
+	if (m_Timer) {
+		CloseHandle(m_Timer);
+	}
+}
+
+bool DeadlineTimer::WaitUntil(std::chrono::steady_clock::time_point deadline, SyncEvent *pCancelEvent)
+{
+	const auto remaining = deadline - std::chrono::steady_clock::now();
+	if (remaining <= std::chrono::steady_clock::duration::zero()) {
+		return !(pCancelEvent && pCancelEvent->Wait(std::chrono::milliseconds(0)));
+	}
+	if (!m_Timer) {
+		const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(remaining);
+		if (pCancelEvent) {
+			return !pCancelEvent->Wait(timeout);
+		}
+		Sleep(static_cast<DWORD>(timeout.count()));
+		return true;
+	}
+	LARGE_INTEGER dueTime;
+	//Negative values are relative, in 100 nanosecond units.
+	dueTime.QuadPart = -(std::max)(static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100), 1LL);
+	if (!SetWaitableTimer(m_Timer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+		return !(pCancelEvent && pCancelEvent->Wait(std::chrono::ceil<std::chrono::milliseconds>(remaining)));
+	}
+	if (!pCancelEvent) {
+		WaitForSingleObject(m_Timer, INFINITE);
+		return true;
+	}
+	const HANDLE handles[]{ pCancelEvent->m_Handle, m_Timer };
+	if (WaitForMultipleObjects(ARRAYSIZE(handles), handles, FALSE, INFINITE) == WAIT_OBJECT_0) {
+		CancelWaitableTimer(m_Timer);
+		return false;
+	}
+	return true;
+}
+#else
+namespace {
+	//All events share one mutex and condition variable, which lets a thread wait on any set of them.
+	//The recorder only has a handful of events, so waking every waiter on each set is cheaper than tracking waiters per event.
+	struct EVENT_STATE {
+		std::mutex Mutex;
+		std::condition_variable Condition;
+	};
+
+	EVENT_STATE &GetEventState()
+	{
+		static EVENT_STATE state;
+		return state;
+	}
+}
+
+SyncEvent::SyncEvent(bool isManualReset, bool isInitiallySet) :
+	m_IsManualReset(isManualReset),
+	m_IsSet(isInitiallySet)
+{
+}
+
+SyncEvent::~SyncEvent()
+{
+}
+
+void SyncEvent::Set()
+{
+	EVENT_STATE &state = GetEventState();
+	{
+		const std::lock_guard<std::mutex> lock(state.Mutex);
+		m_IsSet = true;
+	}
+	state.Condition.notify_all();
+}
+
+void SyncEvent::Reset()
+{
+	const std::lock_guard<std::mutex> lock(GetEventState().Mutex);
+	m_IsSet = false;
+}
+
+bool SyncEvent::Wait(std::chrono::milliseconds timeout)
+{
+	return WaitAny({ this }, timeout) == 0;
+}
+
+size_t SyncEvent::WaitAnyUntil(std::initializer_list<SyncEvent *> events, const std::optional<std::chrono::steady_clock::time_point> &deadline)
+{
+	EVENT_STATE &state = GetEventState();
+	std::unique_lock<std::mutex> lock(state.Mutex);
+	bool isTimedOut = false;
+	for (;;) {
+		size_t index = 0;
+		for (SyncEvent *pEvent : events) {
+			if (pEvent->m_IsSet) {
+				if (!pEvent->m_IsManualReset) {
+					pEvent->m_IsSet = false;
+				}
+				return index;
+			}
+			index++;
+		}
+		if (isTimedOut) {
+			return SYNC_WAIT_TIMEOUT;
+		}
+		if (!deadline.has_value()) {
+			state.Condition.wait(lock);
+		}
+		else {
+			//The events are checked once more after a timeout, so an event set right at the deadline is not missed.
+			isTimedOut = state.Condition.wait_until(lock, deadline.value()) == std::cv_status::timeout;
+		}
+	}
+}
+
+size_t WaitAny(std::initializer_list<SyncEvent *> events, std::chrono::milliseconds timeout)
+{
+	if (timeout == SYNC_INFINITE) {
+		return SyncEvent::WaitAnyUntil(events, std::nullopt);
+	}
+	return SyncEvent::WaitAnyUntil(events, std::chrono::steady_clock::now() + (std::max)(timeout, std::chrono::milliseconds(0)));
+}
+
+SyncMutex::SyncMutex()
+{
+}
+
+SyncMutex::~SyncMutex()
+{
+}
+
+void SyncMutex::lock()
+{
+	m_Mutex.lock();
+}
+
+void SyncMutex::unlock()
+{
+	m_Mutex.unlock();
+}
+
+bool SyncMutex::try_lock()
+{
+	return m_Mutex.try_lock();
+}
+
+DeadlineTimer::DeadlineTimer()
+{
+}
+
+DeadlineTimer::~DeadlineTimer()
+{
+}
+
+bool DeadlineTimer::WaitUntil(std::chrono::steady_clock::time_point deadline, SyncEvent *pCancelEvent)
+{
+	if (!pCancelEvent) {
+#ifdef __linux__
+		//On Linux, steady_clock is CLOCK_MONOTONIC, so the deadline can be passed as an absolute time, which does not drift when the sleep is interrupted.
+		const auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+		const timespec absoluteDeadline{ static_cast<time_t>(sinceEpoch / 1000000000), static_cast<long>(sinceEpoch % 1000000000) };
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &absoluteDeadline, nullptr) == EINTR) {}
+#else
+		std::this_thread::sleep_until(deadline);
+#endif
+		return true;
+	}
+	return SyncEvent::WaitAnyUntil({ pCancelEvent }, deadline) == SYNC_WAIT_TIMEOUT;
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <mutex>
+#include <optional>
+#endif
+
+// Events, waits, deadlines and mutexes for the scheduling and queueing code. They are implemented on Win32, and on the standard library elsewhere, so the code using them can be built and verified on any platform.
+
+//Waits without a timeout.
+constexpr std::chrono::milliseconds SYNC_INFINITE = (std::chrono::milliseconds::max)();
+//Returned by WaitAny if the timeout elapsed before any of the events was set.
+constexpr size_t SYNC_WAIT_TIMEOUT = SIZE_MAX;
+
+/// <summary>
+/// An event with the semantics of a Win32 event. A manual reset event stays set until it is reset, and releases all waiters.
+/// An auto reset event releases a single waiter, and is reset by the wait that observes it.
+/// </summary>
+class SyncEvent
+{
+public:
+	SyncEvent(bool isManualReset, bool isInitiallySet = false);
+	~SyncEvent();
+	SyncEvent(const SyncEvent &) = delete;
+	SyncEvent &operator=(const SyncEvent &) = delete;
+	void Set();
+	void Reset();
+	/// <summary>
+	/// Waits for the event to be set. A timeout of 0 polls the event.
+	/// </summary>
+	/// <returns>true if the event was set, false if the timeout elapsed</returns>
+	bool Wait(std::chrono::milliseconds timeout = SYNC_INFINITE);
+#ifdef _WIN32
+	/// <summary>
+	/// The event handle, for APIs that signal or wait on a Win32 event. It is owned by this object.
+	/// </summary>
+	HANDLE GetHandle() { return m_Handle; }
+#endif
+private:
+	friend size_t WaitAny(std::initializer_list<SyncEvent *> events, std::chrono::milliseconds timeout);
+	friend class DeadlineTimer;
+#ifdef _WIN32
+	HANDLE m_Handle;
+#else
+	bool m_IsManualReset;
+	bool m_IsSet;
+	static size_t WaitAnyUntil(std::initializer_list<SyncEvent *> events, const std::optional<std::chrono::steady_clock::time_point> &deadline);
+#endif
+};
+
+/// <summary>
+/// Waits until any of the events is set. If several are set, the first in the list is returned, and only that one is reset if it is an auto reset event.
+/// </summary>
+/// <returns>The index of the event that was set, or SYNC_WAIT_TIMEOUT</returns>
+size_t WaitAny(std::initializer_list<SyncEvent *> events, std::chrono::milliseconds timeout = SYNC_INFINITE);
+
+/// <summary>
+/// A recursive mutex, to be used with std::lock_guard and std::unique_lock. It wraps a critical section on Windows.
+/// </summary>
+class SyncMutex
+{
+public:
+	SyncMutex();
+	~SyncMutex();
+	SyncMutex(const SyncMutex &) = delete;
+	SyncMutex &operator=(const SyncMutex &) = delete;
+	void lock();
+	void unlock();
+	bool try_lock();
+private:
+#ifdef _WIN32
+	CRITICAL_SECTION m_CriticalSection;
+#else
+	std::recursive_mutex m_Mutex;
+#endif
+};
+
+/// <summary>
+/// Sleeps until a deadline on the steady clock with sub-millisecond precision, where the platform allows it.
+/// On Windows this uses a high resolution waitable timer, and falls back to a regular waitable timer with the system timer resolution raised to 1 ms.
+/// </summary>
+class DeadlineTimer
+{
+public:
+	DeadlineTimer();
+	~DeadlineTimer();
+	DeadlineTimer(const DeadlineTimer &) = delete;
+	DeadlineTimer &operator=(const DeadlineTimer &) = delete;
+	/// <summary>
+	/// Waits until the deadline, or until the cancel event is set. A deadline in the past only polls the cancel event.
+	/// </summary>
+	/// <returns>true if the deadline was reached, false if the wait was canceled</returns>
+	bool WaitUntil(std::chrono::steady_clock::time_point deadline, SyncEvent *pCancelEvent = nullptr);
+private:
+#ifdef _WIN32
+	HANDLE m_Timer;
+	UINT m_TimerResolution;
+#endif
+};
\ No newline at end of file
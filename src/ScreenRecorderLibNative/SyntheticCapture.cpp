@@ -0,0 +1,249 @@
+#include "SyntheticCapture.h"
+#include "util.h"
+#include "cleanup.h"
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+	const int CURSOR_SIZE = 16;
+	const double PI = 3.14159265358979323846;
+}
+
+SyntheticCapture::SyntheticCapture() :
+	m_Options{},
+	m_Pattern(nullptr),
+	m_Texture(nullptr),
+	m_FrameTimer(nullptr),
+	m_StartTime{},
+	m_FrameNumber(-1),
+	m_CursorPosition{}
+{
+}
+
+SyntheticCapture::~SyntheticCapture()
+{
+	StopCapture();
+	SafeRelease(&m_Device);
+	SafeRelease(&m_DeviceContext);
+}
+
+HRESULT SyntheticCapture::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice)
+{
+	m_Device = pDevice;
+	m_DeviceContext = pDeviceContext;
+
+	m_Device->AddRef();
+	m_DeviceContext->AddRef();
+
+	m_TextureManager = make_unique<TextureManager>();
+	return m_TextureManager->Initialize(pDeviceContext, pDevice);
+}
+
+HRESULT SyntheticCapture::StartCapture(_In_ RECORDING_SOURCE_BASE &source)
+{
+	HRESULT hr;
+	SIZE size;
+	RETURN_ON_BAD_HR(hr = GetNativeSize(source, &size));
+	m_RecordingSource = &source;
+	m_Options = source.SyntheticOptions;
+	m_Pattern = make_unique<SyntheticPattern>(size.cx, size.cy, m_Options.DirtyRegionPattern);
+	m_Texture.Release();
+	RETURN_ON_BAD_HR(hr = m_TextureManager->CreateTextureFromBuffer(const_cast<BYTE *>(m_Pattern->GetData()), m_Pattern->GetStride(), size.cx, size.cy, &m_Texture, 0, D3D11_BIND_SHADER_RESOURCE));
+	m_FrameTimer = make_unique<HighresTimer>();
+	m_FrameNumber = -1;
+	m_StartTime = steady_clock::now();
+	LOG_DEBUG(L"Started synthetic capture of %dx%d at %.2f fps", size.cx, size.cy, m_Options.FrameRate);
+	return hr;
+}
+
+HRESULT SyntheticCapture::GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize)
+{
+	const SYNTHETIC_SOURCE_OPTIONS &options = recordingSource.SyntheticOptions;
+	if (options.Size.cx <= 0 || options.Size.cy <= 0 || options.FrameRate <= 0) {
+		LOG_ERROR(L"Invalid synthetic source options: %dx%d at %.2f fps", options.Size.cx, options.Size.cy, options.FrameRate);
+		*nativeMediaSize = SIZE{};
+		return E_INVALIDARG;
+	}
+	*nativeMediaSize = options.Size;
+	return S_OK;
+}
+
+HRESULT SyntheticCapture::StopCapture()
+{
+	if (m_FrameTimer) {
+		return m_FrameTimer->StopTimer(false);
+	}
+	return S_OK;
+}
+
+HRESULT SyntheticCapture::AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame)
+{
+	if (ppFrame) {
+		*ppFrame = nullptr;
+	}
+	if (!m_Texture) {
+		return E_NOT_VALID_STATE;
+	}
+	auto now = steady_clock::now();
+	INT64 frameNumber = static_cast<INT64>(duration<double>(now - m_StartTime).count() * m_Options.FrameRate);
+	if (frameNumber <= m_FrameNumber) {
+		frameNumber = m_FrameNumber + 1;
+		auto frameTime = m_StartTime + duration_cast<steady_clock::duration>(duration<double>(frameNumber / m_Options.FrameRate));
+		auto waitTime = frameTime - now;
+		if (waitTime > milliseconds(timeoutMillis)) {
+			if (timeoutMillis > 0) {
+				m_FrameTimer->WaitFor(static_cast<INT64>(timeoutMillis) * 10000);
+			}
+			return DXGI_ERROR_WAIT_TIMEOUT;
+		}
+		INT64 waitTime100Nanos = duration_cast<nanoseconds>(waitTime).count() / 100;
+		if (waitTime100Nanos > 0) {
+			RETURN_ON_BAD_HR(m_FrameTimer->WaitFor(waitTime100Nanos));
+		}
+	}
+
+	PATTERN_RECT dirtyRect = m_Pattern->DrawFrame(frameNumber);
+	m_FrameNumber = frameNumber;
+	m_CursorPosition = GetCursorPosition(frameNumber);
+	if (!dirtyRect.IsEmpty()) {
+		D3D11_BOX box{ static_cast<UINT>(dirtyRect.Left), static_cast<UINT>(dirtyRect.Top), 0, static_cast<UINT>(dirtyRect.Right), static_cast<UINT>(dirtyRect.Bottom), 1 };
+		const BYTE *pSource = m_Pattern->GetData() + static_cast<size_t>(dirtyRect.Top) * m_Pattern->GetStride() + static_cast<size_t>(dirtyRect.Left) * 4;
+		m_DeviceContext->UpdateSubresource(m_Texture, 0, &box, pSource, m_Pattern->GetStride(), 0);
+	}
+
+	if (ppFrame) {
+		CComPtr<ID3D11Texture2D> pStagingTexture = nullptr;
+		D3D11_TEXTURE2D_DESC desc;
+		m_Texture->GetDesc(&desc);
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.MiscFlags = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+
+		RETURN_ON_BAD_HR(m_Device->CreateTexture2D(&desc, nullptr, &pStagingTexture));
+		m_DeviceContext->CopyResource(pStagingTexture, m_Texture);
+		*ppFrame = pStagingTexture;
+		(*ppFrame)->AddRef();
+	}
+	QueryPerformanceCounter(&m_LastGrabTimeStamp);
+	return S_OK;
+}
+
+HRESULT SyntheticCapture::WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture)
+{
+	if (!m_RecordingSource) {
+		LOG_ERROR("No recording source found in SyntheticCapture");
+		return E_FAIL;
+	}
+
+	CComPtr<ID3D11Texture2D> pProcessedTexture;
+	HRESULT hr = E_FAIL;
+	if (pTexture) {
+		pProcessedTexture = pTexture;
+		hr = S_OK;
+	}
+	else {
+		hr = AcquireNextFrame(timeoutMillis, &pProcessedTexture);
+		RETURN_ON_BAD_HR(hr);
+	}
+
+	D3D11_TEXTURE2D_DESC frameDesc;
+	pProcessedTexture->GetDesc(&frameDesc);
+	RECORDING_SOURCE *recordingSource = dynamic_cast<RECORDING_SOURCE *>(m_RecordingSource);
+
+	if (recordingSource && recordingSource->SourceRect.has_value()
+		&& IsValidRect(recordingSource->SourceRect.value())
+		&& (RectWidth(recordingSource->SourceRect.value()) != frameDesc.Width || (RectHeight(recordingSource->SourceRect.value()) != frameDesc.Height))) {
+		ID3D11Texture2D *pCroppedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->CropTexture(pProcessedTexture, recordingSource->SourceRect.value(), &pCroppedTexture));
+		if (hr == S_OK) {
+			pProcessedTexture.Release();
+			pProcessedTexture.Attach(pCroppedTexture);
+		}
+	}
+	pProcessedTexture->GetDesc(&frameDesc);
+
+	RECT contentRect = destinationRect;
+	if (RectWidth(destinationRect) != frameDesc.Width || RectHeight(destinationRect) != frameDesc.Height) {
+		ID3D11Texture2D *pResizedTexture;
+		RETURN_ON_BAD_HR(hr = m_TextureManager->ResizeTexture(pProcessedTexture, SIZE{ RectWidth(destinationRect),RectHeight(destinationRect) }, m_RecordingSource->Stretch, &pResizedTexture, &contentRect));
+		pProcessedTexture.Release();
+		pProcessedTexture.Attach(pResizedTexture);
+	}
+
+	SIZE contentOffset = GetContentOffset(m_RecordingSource->Anchor, destinationRect, contentRect);
+	long left = destinationRect.left + offsetX + contentOffset.cx;
+	long top = destinationRect.top + offsetY + contentOffset.cy;
+	long right = left + MakeEven(frameDesc.Width);
+	long bottom = top + MakeEven(frameDesc.Height);
+	m_TextureManager->DrawTexture(pSharedSurf, pProcessedTexture, RECT{ left,top,right,bottom });
+	SendBitmapCallback(pProcessedTexture);
+	return hr;
+}
+
+HRESULT SyntheticCapture::GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY)
+{
+	pPtrInfo->IsPointerShapeUpdated = false;
+	if (!m_Options.IsCursorMotionEnabled || m_FrameNumber < 0) {
+		pPtrInfo->Visible = false;
+		return S_OK;
+	}
+	const UINT shapeSize = CURSOR_SIZE * CURSOR_SIZE * 4;
+	if (pPtrInfo->ShapeInfo.Type != DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR
+		|| pPtrInfo->ShapeInfo.Width != CURSOR_SIZE
+		|| pPtrInfo->ShapeInfo.Height != CURSOR_SIZE
+		|| !pPtrInfo->PtrShapeBuffer) {
+		if (pPtrInfo->BufferSize < shapeSize) {
+			delete[] pPtrInfo->PtrShapeBuffer;
+			pPtrInfo->PtrShapeBuffer = new (std::nothrow) BYTE[shapeSize];
+			if (!pPtrInfo->PtrShapeBuffer) {
+				pPtrInfo->BufferSize = 0;
+				LOG_ERROR(L"Failed to allocate memory for pointer shape in SyntheticCapture");
+				return E_OUTOFMEMORY;
+			}
+			pPtrInfo->BufferSize = shapeSize;
+		}
+		//A white arrow with a black outline, pointing to the top left.
+		for (int y = 0; y < CURSOR_SIZE; y++) {
+			UINT32 *pRow = reinterpret_cast<UINT32 *>(pPtrInfo->PtrShapeBuffer + y * CURSOR_SIZE * 4);
+			for (int x = 0; x < CURSOR_SIZE; x++) {
+				if (x > y) {
+					pRow[x] = 0x00000000;
+				}
+				else if (x == 0 || x == y || y == CURSOR_SIZE - 1) {
+					pRow[x] = 0xFF000000;
+				}
+				else {
+					pRow[x] = 0xFFFFFFFF;
+				}
+			}
+		}
+		DXGI_OUTDUPL_POINTER_SHAPE_INFO shapeInfo{};
+		shapeInfo.Type = DXGI_OUTDUPL_POINTER_SHAPE_TYPE_COLOR;
+		shapeInfo.Width = CURSOR_SIZE;
+		shapeInfo.Height = CURSOR_SIZE;
+		shapeInfo.Pitch = CURSOR_SIZE * 4;
+		shapeInfo.HotSpot = POINT{ 0, 0 };
+		pPtrInfo->ShapeInfo = shapeInfo;
+		pPtrInfo->IsPointerShapeUpdated = true;
+	}
+	pPtrInfo->Position.x = frameCoordinates.left + offsetX + MulDiv(m_CursorPosition.x, RectWidth(frameCoordinates), m_Options.Size.cx);
+	pPtrInfo->Position.y = frameCoordinates.top + offsetY + MulDiv(m_CursorPosition.y, RectHeight(frameCoordinates), m_Options.Size.cy);
+	pPtrInfo->WhoUpdatedPositionLast = frameCoordinates;
+	pPtrInfo->Visible = true;
+	QueryPerformanceCounter(&pPtrInfo->LastTimeStamp);
+	return S_OK;
+}
+
+POINT SyntheticCapture::GetCursorPosition(_In_ INT64 frameNumber)
+{
+	//A figure eight that takes four seconds to complete.
+	const double phase = 2 * PI * frameNumber / (m_Options.FrameRate * 4);
+	const double halfWidth = m_Options.Size.cx / 2.0;
+	const double halfHeight = m_Options.Size.cy / 2.0;
+	return POINT{
+		static_cast<LONG>(halfWidth + 0.8 * (halfWidth - CURSOR_SIZE) * std::sin(phase)),
+		static_cast<LONG>(halfHeight + 0.8 * (halfHeight - CURSOR_SIZE) * std::sin(2 * phase))
+	};
+}
\ No newline at end of file
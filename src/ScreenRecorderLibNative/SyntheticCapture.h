@@ -0,0 +1,37 @@
+#pragma once
+#include "CaptureBase.h"
+#include "CommonTypes.h"
+#include "HighresTimer.h"
+#include "SyntheticPattern.h"
+#include <memory>
+#include <atlbase.h>
+
+/// <summary>
+/// Generates deterministic frames at a fixed rate, with a configurable dirty region pattern and cursor motion.
+/// The frames are drawn by SyntheticPattern, which embeds the frame number so it can be read back with SyntheticPattern::ReadFrameNumber.
+/// Frames that are due while no frame is requested are skipped, as on a real display.
+/// </summary>
+class SyntheticCapture :public CaptureBase
+{
+public:
+	SyntheticCapture();
+	~SyntheticCapture();
+	virtual HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice) override;
+	virtual HRESULT StartCapture(_In_ RECORDING_SOURCE_BASE &source) override;
+	virtual HRESULT GetNativeSize(_In_ RECORDING_SOURCE_BASE &recordingSource, _Out_ SIZE *nativeMediaSize) override;
+	virtual HRESULT StopCapture();
+	virtual HRESULT AcquireNextFrame(_In_ DWORD timeoutMillis, _Outptr_opt_result_maybenull_ ID3D11Texture2D **ppFrame) override;
+	virtual HRESULT WriteNextFrameToSharedSurface(_In_ DWORD timeoutMillis, _Inout_ ID3D11Texture2D *pSharedSurf, INT offsetX, INT offsetY, _In_ RECT destinationRect, _In_opt_ ID3D11Texture2D *pTexture = nullptr) override;
+	virtual HRESULT GetMouse(_Inout_ PTR_INFO *pPtrInfo, _In_ RECT frameCoordinates, _In_ int offsetX, _In_ int offsetY) override;
+	virtual inline std::wstring Name() override { return L"SyntheticCapture"; };
+private:
+	POINT GetCursorPosition(_In_ INT64 frameNumber);
+
+	SYNTHETIC_SOURCE_OPTIONS m_Options;
+	std::unique_ptr<SyntheticPattern> m_Pattern;
+	CComPtr<ID3D11Texture2D> m_Texture;
+	std::unique_ptr<HighresTimer> m_FrameTimer;
+	std::chrono::steady_clock::time_point m_StartTime;
+	INT64 m_FrameNumber;
+	POINT m_CursorPosition;
+};
\ No newline at end of file
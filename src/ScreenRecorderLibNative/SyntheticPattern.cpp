@@ -0,0 +1,160 @@
+#include "SyntheticPattern.h"
+#include <algorithm>
+
+namespace {
+	const int32_t SCROLL_PIXELS_PER_FRAME = 4;
+
+	//A triangle wave over [0, range], so moving objects bounce off the frame edges.
+	int32_t Bounce(int64_t position, int32_t range) {
+		if (range <= 0) {
+			return 0;
+		}
+		int64_t period = 2 * static_cast<int64_t>(range);
+		int64_t value = position % period;
+		return static_cast<int32_t>(value <= range ? value : period - value);
+	}
+
+	PATTERN_RECT Union(const PATTERN_RECT &a, const PATTERN_RECT &b) {
+		if (a.IsEmpty()) {
+			return b;
+		}
+		if (b.IsEmpty()) {
+			return a;
+		}
+		return PATTERN_RECT{ (std::min)(a.Left, b.Left), (std::min)(a.Top, b.Top), (std::max)(a.Right, b.Right), (std::max)(a.Bottom, b.Bottom) };
+	}
+}
+
+SyntheticPattern::SyntheticPattern(int32_t width, int32_t height, SyntheticDirtyPattern pattern) :
+	m_Width((std::max)(width, 1)),
+	m_Height((std::max)(height, 1)),
+	m_Pattern(pattern),
+	m_Stride(m_Width * 4),
+	m_Buffer(static_cast<size_t>(m_Stride) * m_Height, 0),
+	m_ColumnGradient(m_Width),
+	m_IsDrawn(false),
+	m_RectanglePosition{}
+{
+	for (int32_t x = 0; x < m_Width; x++) {
+		m_ColumnGradient[x] = static_cast<uint8_t>(x * 255 / m_Width);
+	}
+}
+
+PATTERN_RECT SyntheticPattern::DrawFrame(int64_t frameNumber)
+{
+	const PATTERN_RECT frameRect{ 0, 0, m_Width, m_Height };
+	PATTERN_RECT dirtyRect{};
+	if (!m_IsDrawn) {
+		DrawBackground(frameRect, 0, 0);
+		dirtyRect = frameRect;
+		m_IsDrawn = true;
+	}
+	switch (m_Pattern)
+	{
+		case SyntheticDirtyPattern::MovingRectangle: {
+			const int32_t rectWidth = (std::max)(m_Width / 8, 1);
+			const int32_t rectHeight = (std::max)(m_Height / 8, 1);
+			const int32_t left = Bounce(frameNumber * 8, m_Width - rectWidth);
+			const int32_t top = Bounce(frameNumber * 5, m_Height - rectHeight);
+			const PATTERN_RECT rect{ left, top, left + rectWidth, top + rectHeight };
+			if (!m_RectanglePosition.IsEmpty()) {
+				DrawBackground(m_RectanglePosition, 0, 0);
+				dirtyRect = Union(dirtyRect, m_RectanglePosition);
+			}
+			const uint32_t color = static_cast<uint32_t>((frameNumber * 0x0F1D2B) & 0x00FFFFFF);
+			FillRect(rect, static_cast<uint8_t>(color), static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color >> 16));
+			dirtyRect = Union(dirtyRect, rect);
+			m_RectanglePosition = rect;
+			break;
+		}
+		case SyntheticDirtyPattern::Scroll: {
+			DrawBackground(frameRect, static_cast<int32_t>((frameNumber * SCROLL_PIXELS_PER_FRAME) % m_Height), 0);
+			dirtyRect = frameRect;
+			break;
+		}
+		case SyntheticDirtyPattern::FullFrame: {
+			DrawBackground(frameRect, 0, static_cast<uint8_t>(frameNumber));
+			dirtyRect = frameRect;
+			break;
+		}
+		case SyntheticDirtyPattern::None:
+		default:
+			break;
+	}
+	DrawFrameNumber(static_cast<uint32_t>(frameNumber), &dirtyRect);
+	return dirtyRect;
+}
+
+bool SyntheticPattern::ReadFrameNumber(const uint8_t *pFrame, int32_t stride, int32_t width, int32_t height, uint32_t *pFrameNumber)
+{
+	*pFrameNumber = 0;
+	if (!pFrame || width < COUNTER_BITS * COUNTER_CELL_SIZE || height < 2 * COUNTER_CELL_SIZE || stride < width * 4) {
+		return false;
+	}
+	//Each cell is sampled in its center, so the edges of the cells may be blurred by scaling or encoding.
+	auto isCellSet = [&](int32_t bit, int32_t row) {
+		const uint8_t *pPixel = pFrame + static_cast<size_t>(row * COUNTER_CELL_SIZE + COUNTER_CELL_SIZE / 2) * stride + static_cast<size_t>(bit * COUNTER_CELL_SIZE + COUNTER_CELL_SIZE / 2) * 4;
+		return pPixel[0] + pPixel[1] + pPixel[2] > 3 * 128;
+	};
+	uint32_t frameNumber = 0;
+	for (int32_t bit = 0; bit < COUNTER_BITS; bit++) {
+		bool isSet = isCellSet(bit, 0);
+		if (isSet == isCellSet(bit, 1)) {
+			return false;
+		}
+		frameNumber = (frameNumber << 1) | (isSet ? 1 : 0);
+	}
+	*pFrameNumber = frameNumber;
+	return true;
+}
+
+void SyntheticPattern::DrawBackground(const PATTERN_RECT &rect, int32_t scrollOffset, uint8_t tint)
+{
+	//A gradient over a checkerboard, so both flat and detailed areas are encoded.
+	for (int32_t y = rect.Top; y < rect.Bottom; y++) {
+		const int32_t patternY = (y + scrollOffset) % m_Height;
+		const uint8_t green = static_cast<uint8_t>(patternY * 255 / m_Height + tint * 3);
+		const uint8_t blueTint = static_cast<uint8_t>(tint * 7);
+		const uint8_t redEven = static_cast<uint8_t>(((patternY >> 6) & 1 ? 192 : 64) + tint);
+		const uint8_t redOdd = static_cast<uint8_t>(((patternY >> 6) & 1 ? 64 : 192) + tint);
+		uint8_t *pPixel = m_Buffer.data() + static_cast<size_t>(y) * m_Stride + static_cast<size_t>(rect.Left) * 4;
+		for (int32_t x = rect.Left; x < rect.Right; x++) {
+			pPixel[0] = static_cast<uint8_t>(m_ColumnGradient[x] + blueTint);
+			pPixel[1] = green;
+			pPixel[2] = (x >> 6) & 1 ? redOdd : redEven;
+			pPixel[3] = 0xFF;
+			pPixel += 4;
+		}
+	}
+}
+
+void SyntheticPattern::FillRect(const PATTERN_RECT &rect, uint8_t blue, uint8_t green, uint8_t red)
+{
+	for (int32_t y = rect.Top; y < rect.Bottom; y++) {
+		uint8_t *pPixel = m_Buffer.data() + static_cast<size_t>(y) * m_Stride + static_cast<size_t>(rect.Left) * 4;
+		for (int32_t x = rect.Left; x < rect.Right; x++) {
+			pPixel[0] = blue;
+			pPixel[1] = green;
+			pPixel[2] = red;
+			pPixel[3] = 0xFF;
+			pPixel += 4;
+		}
+	}
+}
+
+void SyntheticPattern::DrawFrameNumber(uint32_t frameNumber, PATTERN_RECT *pDirtyRect)
+{
+	const PATTERN_RECT counterRect{ 0, 0, (std::min)(COUNTER_BITS * COUNTER_CELL_SIZE, m_Width), (std::min)(2 * COUNTER_CELL_SIZE, m_Height) };
+	for (int32_t bit = 0; bit < COUNTER_BITS; bit++) {
+		const bool isSet = ((frameNumber >> (COUNTER_BITS - 1 - bit)) & 1) != 0;
+		for (int32_t row = 0; row < 2; row++) {
+			//The second row is inverted, so a cell that is the same in both rows shows that the counter was not read correctly.
+			const uint8_t value = isSet != (row == 1) ? 0xFF : 0x00;
+			PATTERN_RECT cell{ bit * COUNTER_CELL_SIZE, row * COUNTER_CELL_SIZE, (bit + 1) * COUNTER_CELL_SIZE, (row + 1) * COUNTER_CELL_SIZE };
+			cell.Right = (std::min)(cell.Right, counterRect.Right);
+			cell.Bottom = (std::min)(cell.Bottom, counterRect.Bottom);
+			FillRect(cell, value, value, value);
+		}
+	}
+	*pDirtyRect = Union(*pDirtyRect, counterRect);
+}
\ No newline at end of file
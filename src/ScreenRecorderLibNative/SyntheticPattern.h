@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+enum class SyntheticDirtyPattern {
+	///<summary>Only the frame counter changes.</summary>
+	None,
+	///<summary>A rectangle moves across the frame, so a small region changes each frame.</summary>
+	MovingRectangle,
+	///<summary>The content scrolls vertically, so the whole frame changes but stays predictable.</summary>
+	Scroll,
+	///<summary>Every pixel changes each frame.</summary>
+	FullFrame
+};
+
+/// <summary>
+/// A region of a frame, from Left and Top up to but not including Right and Bottom. It is empty if either size is 0 or less.
+/// </summary>
+struct PATTERN_RECT {
+	int32_t Left = 0;
+	int32_t Top = 0;
+	int32_t Right = 0;
+	int32_t Bottom = 0;
+	bool IsEmpty() const { return Right <= Left || Bottom <= Top; }
+};
+
+/// <summary>
+/// Draws the deterministic 32bpp BGRA frames of a synthetic source, with a dirty region pattern, into a buffer in CPU memory.
+/// Each frame has its frame number embedded in the top left corner, so it can be read back after encoding to measure dropped frames and latency.
+/// The content of a frame depends only on its frame number, and the pixels are written byte by byte, so the frames are the same on every platform.
+/// </summary>
+class SyntheticPattern
+{
+public:
+	/// <param name="width">The width of the frames, at least 1.</param>
+	/// <param name="height">The height of the frames, at least 1.</param>
+	SyntheticPattern(int32_t width, int32_t height, SyntheticDirtyPattern pattern);
+	/// <summary>
+	/// Draws a frame over the previous one.
+	/// </summary>
+	/// <returns>The region that changed since the previous frame, which is the whole frame for the first one.</returns>
+	PATTERN_RECT DrawFrame(int64_t frameNumber);
+	const uint8_t *GetData() const { return m_Buffer.data(); }
+	int32_t GetStride() const { return m_Stride; }
+	int32_t GetWidth() const { return m_Width; }
+	int32_t GetHeight() const { return m_Height; }
+
+	/// <summary>
+	/// Reads the frame number embedded in a BGRA frame of a synthetic source.
+	/// </summary>
+	/// <returns>true if a valid frame number was found, else false.</returns>
+	static bool ReadFrameNumber(const uint8_t *pFrame, int32_t stride, int32_t width, int32_t height, uint32_t *pFrameNumber);
+
+	//The frame number is drawn as two rows of COUNTER_BITS square cells, the second row inverting the first. The frame must be at least as large as the counter for it to be read.
+	static const int32_t COUNTER_BITS = 32;
+	static const int32_t COUNTER_CELL_SIZE = 8;
+private:
+	void DrawBackground(const PATTERN_RECT &rect, int32_t scrollOffset, uint8_t tint);
+	void FillRect(const PATTERN_RECT &rect, uint8_t blue, uint8_t green, uint8_t red);
+	void DrawFrameNumber(uint32_t frameNumber, PATTERN_RECT *pDirtyRect);
+
+	const int32_t m_Width;
+	const int32_t m_Height;
+	const SyntheticDirtyPattern m_Pattern;
+	const int32_t m_Stride;
+	std::vector<uint8_t> m_Buffer;
+	//The blue gradient of each column of the background, which does not depend on the frame.
+	std::vector<uint8_t> m_ColumnGradient;
+	bool m_IsDrawn;
+	PATTERN_RECT m_RectanglePosition;
+};
\ No newline at end of file
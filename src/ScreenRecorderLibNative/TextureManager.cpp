@@ -13,7 +13,12 @@ TextureManager::TextureManager() :
 	m_BlendState(nullptr),
 	m_VertexShader(nullptr),
 	m_PixelShader(nullptr),
-	m_InputLayout(nullptr)
+	m_InputLayout(nullptr),
+	m_CompositorBackend(CompositorBackend::Direct3D),
+	m_SoftwareCompositor(),
+	m_SourceBuffer{},
+	m_TargetBuffer{},
+	m_ScaledBuffer{}
 {
 }
 
@@ -22,13 +27,30 @@ TextureManager::~TextureManager()
 	CleanRefs();
 }
 
-HRESULT TextureManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice)
+HRESULT TextureManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *pDevice, _In_ CompositorBackend backend)
 {
 	m_Device = pDevice;
 	m_DeviceContext = pDeviceContext;
+	m_CompositorBackend = backend;
 
 	CleanRefs();
 
+	if (m_CompositorBackend == CompositorBackend::Software) {
+		return S_OK;
+	}
+	HRESULT hr = InitializeShaderPipeline();
+	if (FAILED(hr)) {
+		_com_error err(hr);
+		LOG_WARN(L"Failed to initialize D3D compositor, falling back to software compositor: %ls", err.ErrorMessage());
+		CleanRefs();
+		m_CompositorBackend = CompositorBackend::Software;
+		hr = S_OK;
+	}
+	return hr;
+}
+
+HRESULT TextureManager::InitializeShaderPipeline()
+{
 	HRESULT hr = S_OK;
 
 	// Create the sample state
@@ -60,7 +82,7 @@ HRESULT TextureManager::Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In
 	RETURN_ON_BAD_HR(hr);
 
 	// Initialize shaders
-	hr = InitShaders(pDevice, &m_PixelShader, &m_VertexShader, &m_InputLayout);
+	hr = InitShaders(m_Device, &m_PixelShader, &m_VertexShader, &m_InputLayout);
 	RETURN_ON_BAD_HR(hr);
 
 	return hr;
@@ -115,6 +137,9 @@ HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  S
 	if (pContentRect) {
 		*pContentRect = RECT{ 0,0,resizedWidth,resizedHeight };
 	}
+	if (m_CompositorBackend == CompositorBackend::Software) {
+		return ResizeTextureWithCPU(pOrgTexture, resizedWidth, resizedHeight, ppResizedTexture);
+	}
 	D3D11_SHADER_RESOURCE_VIEW_DESC SDesc = {};
 	SDesc.Format = frameDesc.Format;
 	SDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
@@ -216,6 +241,9 @@ HRESULT TextureManager::ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  S
 
 HRESULT TextureManager::RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DXGI_MODE_ROTATION rotation, _Outptr_ ID3D11Texture2D **ppRotatedTexture)
 {
+	if (m_CompositorBackend == CompositorBackend::Software) {
+		return RotateTextureWithCPU(pOrgTexture, rotation, ppRotatedTexture);
+	}
 	HRESULT hr;
 	// Create shader resource from texture of the original frame
 	D3D11_TEXTURE2D_DESC textureDesc = {};
@@ -339,6 +367,9 @@ HRESULT TextureManager::RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DX
 
 HRESULT TextureManager::DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect)
 {
+	if (m_CompositorBackend == CompositorBackend::Software) {
+		return DrawTextureWithCPU(pCanvasTexture, pTexture, rect);
+	}
 	HRESULT hr = S_FALSE;
 	D3D11_TEXTURE2D_DESC desktopDesc = {};
 	pCanvasTexture->GetDesc(&desktopDesc);
@@ -542,6 +573,177 @@ void TextureManager::ConfigureRotationVertices(_Inout_ VERTEX(&vertices)[6], _In
 	vertices[4].TexCoord = vertices[1].TexCoord;
 }
 
+HRESULT TextureManager::ResizeTextureWithCPU(_In_ ID3D11Texture2D *pOrgTexture, _In_ LONG width, _In_ LONG height, _Outptr_ ID3D11Texture2D **ppResizedTexture)
+{
+	D3D11_TEXTURE2D_DESC frameDesc = {};
+	pOrgTexture->GetDesc(&frameDesc);
+	BGRA_SURFACE source;
+	RETURN_ON_BAD_HR(ReadTextureToBuffer(pOrgTexture, RECT{ 0,0,(LONG)frameDesc.Width,(LONG)frameDesc.Height }, &m_SourceBuffer, &source));
+
+	m_TargetBuffer.resize(static_cast<size_t>(width) * height * 4);
+	BGRA_SURFACE target{ m_TargetBuffer.data(), width * 4, width, height };
+	if (!m_SoftwareCompositor.Scale(source, target, SoftwareScaleFilter::Area)) {
+		return E_INVALIDARG;
+	}
+	D3D11_TEXTURE2D_DESC targetDesc;
+	InitializeDesc(width, height, &targetDesc);
+	ID3D11Texture2D *pResizedFrame = nullptr;
+	RETURN_ON_BAD_HR(GetOrCreateTexture(targetDesc, &pResizedFrame));
+	RETURN_ON_BAD_HR(WriteBufferToTexture(target, pResizedFrame, POINT{ 0,0 }));
+	*ppResizedTexture = pResizedFrame;
+	(*ppResizedTexture)->AddRef();
+	return S_OK;
+}
+
+HRESULT TextureManager::RotateTextureWithCPU(_In_ ID3D11Texture2D *pOrgTexture, _In_ DXGI_MODE_ROTATION rotation, _Outptr_ ID3D11Texture2D **ppRotatedTexture)
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	pOrgTexture->GetDesc(&textureDesc);
+	BGRA_SURFACE source;
+	RETURN_ON_BAD_HR(ReadTextureToBuffer(pOrgTexture, RECT{ 0,0,(LONG)textureDesc.Width,(LONG)textureDesc.Height }, &m_SourceBuffer, &source));
+
+	LONG rotatedWidth = textureDesc.Width;
+	LONG rotatedHeight = textureDesc.Height;
+	SoftwareRotation softwareRotation = SoftwareRotation::Identity;
+	switch (rotation)
+	{
+		case DXGI_MODE_ROTATION_ROTATE90:
+			softwareRotation = SoftwareRotation::Rotate90;
+			rotatedWidth = textureDesc.Height;
+			rotatedHeight = textureDesc.Width;
+			break;
+		case DXGI_MODE_ROTATION_ROTATE180:
+			softwareRotation = SoftwareRotation::Rotate180;
+			break;
+		case DXGI_MODE_ROTATION_ROTATE270:
+			softwareRotation = SoftwareRotation::Rotate270;
+			rotatedWidth = textureDesc.Height;
+			rotatedHeight = textureDesc.Width;
+			break;
+	}
+	m_TargetBuffer.resize(static_cast<size_t>(rotatedWidth) * rotatedHeight * 4);
+	BGRA_SURFACE target{ m_TargetBuffer.data(), rotatedWidth * 4, rotatedWidth, rotatedHeight };
+	if (!m_SoftwareCompositor.Rotate(source, target, softwareRotation)) {
+		return E_INVALIDARG;
+	}
+	D3D11_TEXTURE2D_DESC targetDesc;
+	InitializeDesc(rotatedWidth, rotatedHeight, &targetDesc);
+	ID3D11Texture2D *pRotatedFrame = nullptr;
+	RETURN_ON_BAD_HR(GetOrCreateTexture(targetDesc, &pRotatedFrame));
+	RETURN_ON_BAD_HR(WriteBufferToTexture(target, pRotatedFrame, POINT{ 0,0 }));
+	*ppRotatedTexture = pRotatedFrame;
+	(*ppRotatedTexture)->AddRef();
+	return S_OK;
+}
+
+HRESULT TextureManager::DrawTextureWithCPU(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect)
+{
+	D3D11_TEXTURE2D_DESC overlayDesc = {};
+	pTexture->GetDesc(&overlayDesc);
+	BGRA_SURFACE overlay;
+	RETURN_ON_BAD_HR(ReadTextureToBuffer(pTexture, RECT{ 0,0,(LONG)overlayDesc.Width,(LONG)overlayDesc.Height }, &m_SourceBuffer, &overlay));
+	return DrawBuffer(pCanvasTexture, overlay, rect);
+}
+
+HRESULT TextureManager::DrawBuffer(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ const BGRA_SURFACE &surface, _In_ RECT rect)
+{
+	if (RectWidth(rect) <= 0 || RectHeight(rect) <= 0) {
+		return S_FALSE;
+	}
+	BGRA_SURFACE scaled = surface;
+	if (surface.Width != RectWidth(rect) || surface.Height != RectHeight(rect)) {
+		m_ScaledBuffer.resize(static_cast<size_t>(RectWidth(rect)) * RectHeight(rect) * 4);
+		scaled = BGRA_SURFACE{ m_ScaledBuffer.data(), RectWidth(rect) * 4, RectWidth(rect), RectHeight(rect) };
+		if (!m_SoftwareCompositor.Scale(surface, scaled, SoftwareScaleFilter::Area)) {
+			return E_INVALIDARG;
+		}
+	}
+	D3D11_TEXTURE2D_DESC canvasDesc = {};
+	pCanvasTexture->GetDesc(&canvasDesc);
+	RECT canvasRect{ 0,0,(LONG)canvasDesc.Width,(LONG)canvasDesc.Height };
+	RECT visibleRect;
+	if (!IntersectRect(&visibleRect, &rect, &canvasRect)) {
+		return S_FALSE;
+	}
+	BGRA_SURFACE canvas;
+	RETURN_ON_BAD_HR(ReadTextureToBuffer(pCanvasTexture, visibleRect, &m_TargetBuffer, &canvas));
+	if (!m_SoftwareCompositor.AlphaBlend(scaled, canvas, rect.left - visibleRect.left, rect.top - visibleRect.top, SoftwareAlphaMode::Straight)) {
+		return E_INVALIDARG;
+	}
+	return WriteBufferToTexture(canvas, pCanvasTexture, POINT{ visibleRect.left, visibleRect.top });
+}
+
+HRESULT TextureManager::ReadTextureToBuffer(_In_ ID3D11Texture2D *pTexture, _In_ RECT rect, _Inout_ std::vector<BYTE> *pBuffer, _Out_ BGRA_SURFACE *pSurface)
+{
+	*pSurface = BGRA_SURFACE{};
+	D3D11_TEXTURE2D_DESC desc = {};
+	pTexture->GetDesc(&desc);
+	if (desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM && desc.Format != DXGI_FORMAT_B8G8R8A8_UNORM_SRGB) {
+		LOG_ERROR(L"Software compositor only supports BGRA textures, got format %u", desc.Format);
+		return E_INVALIDARG;
+	}
+	RECT textureRect{ 0,0,(LONG)desc.Width,(LONG)desc.Height };
+	if (!IntersectRect(&rect, &rect, &textureRect)) {
+		return E_INVALIDARG;
+	}
+	D3D11_TEXTURE2D_DESC stagingDesc = desc;
+	stagingDesc.Width = RectWidth(rect);
+	stagingDesc.Height = RectHeight(rect);
+	stagingDesc.MipLevels = 1;
+	stagingDesc.ArraySize = 1;
+	stagingDesc.SampleDesc.Count = 1;
+	stagingDesc.SampleDesc.Quality = 0;
+	stagingDesc.Usage = D3D11_USAGE_STAGING;
+	stagingDesc.BindFlags = 0;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	stagingDesc.MiscFlags = 0;
+	ID3D11Texture2D *pStagingTexture = nullptr;
+	RETURN_ON_BAD_HR(GetOrCreateTexture(stagingDesc, &pStagingTexture));
+
+	D3D11_BOX sourceRegion;
+	sourceRegion.left = rect.left;
+	sourceRegion.right = rect.right;
+	sourceRegion.top = rect.top;
+	sourceRegion.bottom = rect.bottom;
+	sourceRegion.front = 0;
+	sourceRegion.back = 1;
+	m_DeviceContext->CopySubresourceRegion(pStagingTexture, 0, 0, 0, 0, pTexture, 0, &sourceRegion);
+
+	D3D11_MAPPED_SUBRESOURCE mapped{};
+	RETURN_ON_BAD_HR(m_DeviceContext->Map(pStagingTexture, 0, D3D11_MAP_READ, 0, &mapped));
+	const LONG stride = stagingDesc.Width * 4;
+	pBuffer->resize(static_cast<size_t>(stride) * stagingDesc.Height);
+	for (UINT row = 0; row < stagingDesc.Height; row++) {
+		memcpy(pBuffer->data() + static_cast<size_t>(row) * stride, static_cast<BYTE *>(mapped.pData) + static_cast<size_t>(row) * mapped.RowPitch, stride);
+	}
+	m_DeviceContext->Unmap(pStagingTexture, 0);
+
+	*pSurface = BGRA_SURFACE{ pBuffer->data(), stride, (int32_t)stagingDesc.Width, (int32_t)stagingDesc.Height };
+	return S_OK;
+}
+
+HRESULT TextureManager::WriteBufferToTexture(_In_ const BGRA_SURFACE &surface, _Inout_ ID3D11Texture2D *pTexture, _In_ POINT position)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	pTexture->GetDesc(&desc);
+	RECT textureRect{ 0,0,(LONG)desc.Width,(LONG)desc.Height };
+	RECT surfaceRect{ position.x, position.y, position.x + surface.Width, position.y + surface.Height };
+	RECT targetRect;
+	if (!surface.Data || !IntersectRect(&targetRect, &surfaceRect, &textureRect)) {
+		return S_FALSE;
+	}
+	D3D11_BOX targetRegion;
+	targetRegion.left = targetRect.left;
+	targetRegion.right = targetRect.right;
+	targetRegion.top = targetRect.top;
+	targetRegion.bottom = targetRect.bottom;
+	targetRegion.front = 0;
+	targetRegion.back = 1;
+	const BYTE *pData = surface.Data + static_cast<size_t>(targetRect.top - position.y) * surface.Stride + static_cast<size_t>(targetRect.left - position.x) * 4;
+	m_DeviceContext->UpdateSubresource(pTexture, 0, &targetRegion, pData, surface.Stride, 0);
+	return S_OK;
+}
+
 HRESULT TextureManager::InitializeDesc(_In_ UINT width, _In_ UINT height, _Out_ D3D11_TEXTURE2D_DESC *pTargetDesc)
 {
 	// Create shared texture for the target view
@@ -771,4 +973,5 @@ void TextureManager::CleanRefs()
 	{
 		SafeRelease(&pair.second);
 	}
+	m_TextureCache.clear();
 }
@@ -2,6 +2,7 @@
 #include <DirectXMath.h>
 #include "CommonTypes.h"
 #include "DX.util.h"
+#include "SoftwareCompositor.h"
 #include <unordered_map>
 
 using namespace std;
@@ -11,7 +12,8 @@ class TextureManager
 public:
 	TextureManager();
 	~TextureManager();
-	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *Device);
+	HRESULT Initialize(_In_ ID3D11DeviceContext *pDeviceContext, _In_ ID3D11Device *Device, _In_ CompositorBackend backend = CompositorBackend::Direct3D);
+	inline CompositorBackend GetCompositorBackend() { return m_CompositorBackend; }
 	HRESULT ResizeTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_  SIZE targetSize, _In_ TextureStretchMode stretch, _Outptr_ ID3D11Texture2D **ppResizedTexture, _Out_opt_ RECT *pContentRect = nullptr);
 	HRESULT RotateTexture(_In_ ID3D11Texture2D *pOrgTexture, _In_ DXGI_MODE_ROTATION rotation, _Outptr_ ID3D11Texture2D **ppRotatedTexture);
 	HRESULT DrawTexture(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect);
@@ -33,7 +35,27 @@ public:
 	HRESULT CreateTexture(_In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag = 0, UINT bindFlag = 0);
 	HRESULT CreateTextureFromBuffer(_In_ BYTE *pFrameBuffer, _In_ LONG stride, _In_ UINT width, _In_ UINT height, _Outptr_ ID3D11Texture2D **ppTexture, UINT miscFlag = 0, UINT bindFlag = 0);
 	HRESULT BlankTexture(_Inout_ ID3D11Texture2D *pTexture, _In_ RECT rect, _In_ INT OffsetX = 0, _In_  INT OffsetY = 0);
+	/// <summary>
+	/// Copies a region of a BGRA texture to CPU memory.
+	/// </summary>
+	/// <param name="pTexture">The texture to read</param>
+	/// <param name="rect">The region to read. It is clipped to the texture bounds.</param>
+	/// <param name="pBuffer">A buffer that is resized to hold the pixels</param>
+	/// <param name="pSurface">A surface describing the pixels in the buffer</param>
+	HRESULT ReadTextureToBuffer(_In_ ID3D11Texture2D *pTexture, _In_ RECT rect, _Inout_ std::vector<BYTE> *pBuffer, _Out_ BGRA_SURFACE *pSurface);
+	/// <summary>
+	/// Copies a surface in CPU memory to the given position in a texture, clipped to the texture bounds.
+	/// </summary>
+	HRESULT WriteBufferToTexture(_In_ const BGRA_SURFACE &surface, _Inout_ ID3D11Texture2D *pTexture, _In_ POINT position);
+	/// <summary>
+	/// Blends a surface in CPU memory onto a texture, scaled to fill the given rectangle. This is the software equivalent of DrawTexture.
+	/// </summary>
+	HRESULT DrawBuffer(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ const BGRA_SURFACE &surface, _In_ RECT rect);
 private:
+	HRESULT InitializeShaderPipeline();
+	HRESULT ResizeTextureWithCPU(_In_ ID3D11Texture2D *pOrgTexture, _In_ LONG width, _In_ LONG height, _Outptr_ ID3D11Texture2D **ppResizedTexture);
+	HRESULT RotateTextureWithCPU(_In_ ID3D11Texture2D *pOrgTexture, _In_ DXGI_MODE_ROTATION rotation, _Outptr_ ID3D11Texture2D **ppRotatedTexture);
+	HRESULT DrawTextureWithCPU(_Inout_ ID3D11Texture2D *pCanvasTexture, _In_ ID3D11Texture2D *pTexture, _In_ RECT rect);
 	HRESULT InitializeDesc(_In_ UINT width, _In_ UINT height, _Out_ D3D11_TEXTURE2D_DESC *pTargetDesc);
 	HRESULT GetOrCreateTexture(_In_ D3D11_TEXTURE2D_DESC desc, _Outptr_ ID3D11Texture2D **ppTexture);
 	void ConfigureRotationVertices(_Inout_ VERTEX(&vertices)[6], _In_ RECT textureRect, _In_opt_ DXGI_MODE_ROTATION rotation = DXGI_MODE_ROTATION_UNSPECIFIED);
@@ -46,7 +68,11 @@ private:
 	ID3D11VertexShader *m_VertexShader;
 	ID3D11PixelShader *m_PixelShader;
 	ID3D11InputLayout *m_InputLayout;
-
+	CompositorBackend m_CompositorBackend;
+	SoftwareCompositor m_SoftwareCompositor;
+	std::vector<BYTE> m_SourceBuffer;
+	std::vector<BYTE> m_TargetBuffer;
+	std::vector<BYTE> m_ScaledBuffer;
 
 	struct TextureDescHasher {
 		std::size_t operator()(const D3D11_TEXTURE2D_DESC &desc) const noexcept {
@@ -0,0 +1,185 @@
+#include "Trace.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Tracer::s_IsEnabled(false);
+
+namespace {
+	struct TRACE_EVENT {
+		std::atomic<const char *> Name;
+		std::atomic<int64_t> Start;
+		std::atomic<int64_t> End;
+	};
+	struct THREAD_TRACE_BUFFER {
+		uint32_t ThreadId;
+		std::atomic<const char *> ThreadName;
+		//The number of events recorded by the thread. Event i is stored at index i % EVENTS_PER_THREAD.
+		std::atomic<uint64_t> WriteCount;
+		//The first event that has not been cleared.
+		std::atomic<uint64_t> ReadStart;
+		std::atomic<bool> IsRetired;
+		std::unique_ptr<TRACE_EVENT[]> Events;
+	};
+
+	std::mutex g_BuffersMutex;
+	std::vector<std::shared_ptr<THREAD_TRACE_BUFFER>> g_Buffers;
+	uint32_t g_NextThreadId = 1;
+
+	//Keeps the buffer of a thread registered after the thread exits, so its events are still exported.
+	struct THREAD_TRACE_STATE {
+		const char *ThreadName = nullptr;
+		std::shared_ptr<THREAD_TRACE_BUFFER> Buffer;
+		~THREAD_TRACE_STATE() {
+			if (Buffer) {
+				Buffer->IsRetired.store(true);
+			}
+		}
+	};
+	thread_local THREAD_TRACE_STATE t_TraceState;
+
+	THREAD_TRACE_BUFFER *GetThreadBuffer() {
+		if (!t_TraceState.Buffer) {
+			auto buffer = std::make_shared<THREAD_TRACE_BUFFER>();
+			buffer->ThreadName = t_TraceState.ThreadName;
+			buffer->WriteCount = 0;
+			buffer->ReadStart = 0;
+			buffer->IsRetired = false;
+			buffer->Events.reset(new TRACE_EVENT[Tracer::EVENTS_PER_THREAD]());
+			{
+				const std::lock_guard<std::mutex> lock(g_BuffersMutex);
+				buffer->ThreadId = g_NextThreadId++;
+				g_Buffers.push_back(buffer);
+			}
+			t_TraceState.Buffer = buffer;
+		}
+		return t_TraceState.Buffer.get();
+	}
+
+	void WriteJsonString(std::ostream &stream, const char *value) {
+		stream << '"';
+		for (const char *c = value; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				stream << '\\' << *c;
+			}
+			else if (static_cast<unsigned char>(*c) < 0x20) {
+				//Control characters are not allowed in JSON strings.
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(*c)));
+				stream << escaped;
+			}
+			else {
+				stream << *c;
+			}
+		}
+		stream << '"';
+	}
+
+	void WriteMicros(std::ostream &stream, int64_t nanos) {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%" PRId64 ".%03d", nanos / 1000, static_cast<int>(nanos % 1000));
+		stream << buffer;
+	}
+}
+
+void Tracer::SetEnabled(bool isEnabled)
+{
+	s_IsEnabled.store(isEnabled);
+}
+
+void Tracer::SetThreadName(const char *name)
+{
+	t_TraceState.ThreadName = name;
+	if (t_TraceState.Buffer) {
+		t_TraceState.Buffer->ThreadName.store(name);
+	}
+}
+
+void Tracer::AddEvent(const char *name, int64_t startNanos, int64_t endNanos)
+{
+	THREAD_TRACE_BUFFER *pBuffer = GetThreadBuffer();
+	const uint64_t index = pBuffer->WriteCount.load(std::memory_order_relaxed);
+	//A reader that sees any of the stores below is then guaranteed to see that the slot is being reused, and discards it.
+	std::atomic_thread_fence(std::memory_order_release);
+	TRACE_EVENT &event = pBuffer->Events[index % EVENTS_PER_THREAD];
+	event.Name.store(name, std::memory_order_relaxed);
+	event.Start.store(startNanos, std::memory_order_relaxed);
+	event.End.store(endNanos, std::memory_order_relaxed);
+	pBuffer->WriteCount.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::WriteChromeTrace(std::ostream &stream)
+{
+	std::vector<std::shared_ptr<THREAD_TRACE_BUFFER>> buffers;
+	{
+		const std::lock_guard<std::mutex> lock(g_BuffersMutex);
+		buffers = g_Buffers;
+	}
+	struct EVENT_COPY {
+		uint64_t Index;
+		const char *Name;
+		int64_t Start;
+		int64_t End;
+	};
+	std::vector<EVENT_COPY> events;
+	bool isFirstEvent = true;
+	auto BeginEvent([&]() {
+		stream << (isFirstEvent ? "\n" : ",\n");
+		isFirstEvent = false;
+	});
+	stream << "{\"traceEvents\":[";
+	for (const std::shared_ptr<THREAD_TRACE_BUFFER> &buffer : buffers) {
+		const char *threadName = buffer->ThreadName.load();
+		if (threadName) {
+			BeginEvent();
+			stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadId << ",\"args\":{\"name\":";
+			WriteJsonString(stream, threadName);
+			stream << "}}";
+		}
+		const uint64_t writeCount = buffer->WriteCount.load(std::memory_order_acquire);
+		uint64_t first = writeCount > EVENTS_PER_THREAD ? writeCount - EVENTS_PER_THREAD : 0;
+		first = (std::max)(first, buffer->ReadStart.load());
+		events.clear();
+		for (uint64_t i = first; i < writeCount; i++) {
+			const TRACE_EVENT &event = buffer->Events[i % EVENTS_PER_THREAD];
+			events.push_back({ i, event.Name.load(std::memory_order_relaxed), event.Start.load(std::memory_order_relaxed), event.End.load(std::memory_order_relaxed) });
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		//The thread may have reused slots while they were copied, in which case those events can be torn.
+		const uint64_t currentWriteCount = buffer->WriteCount.load(std::memory_order_relaxed);
+		const uint64_t firstIntact = currentWriteCount >= EVENTS_PER_THREAD ? currentWriteCount - EVENTS_PER_THREAD + 1 : 0;
+		for (const EVENT_COPY &event : events) {
+			if (event.Index < firstIntact) {
+				continue;
+			}
+			BeginEvent();
+			stream << "{\"name\":";
+			WriteJsonString(stream, event.Name);
+			stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->ThreadId << ",\"ts\":";
+			WriteMicros(stream, event.Start);
+			stream << ",\"dur\":";
+			WriteMicros(stream, event.End - event.Start);
+			stream << "}";
+		}
+	}
+	stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	stream.flush();
+	return !stream.fail();
+}
+
+void Tracer::Clear()
+{
+	const std::lock_guard<std::mutex> lock(g_BuffersMutex);
+	for (auto it = g_Buffers.begin(); it != g_Buffers.end();) {
+		if ((*it)->IsRetired.load()) {
+			it = g_Buffers.erase(it);
+		}
+		else {
+			(*it)->ReadStart.store((*it)->WriteCount.load());
+			it++;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+/// <summary>
+/// Records the time from this line to the end of the enclosing scope as a trace event. The name must be a string literal.
+/// </summary>
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+/// <summary>
+/// Records timed events into a fixed size ring buffer per thread, which can be exported in the Chrome trace event format and opened in chrome://tracing or Perfetto.
+/// Recording an event takes no locks, and while tracing is disabled, a scope costs a single relaxed load and branch.
+/// When a thread records more events than fit in its buffer, the oldest events are overwritten.
+/// </summary>
+class Tracer
+{
+public:
+	static void SetEnabled(bool isEnabled);
+	static bool IsEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+	/// <summary>
+	/// Names the calling thread in the exported trace. The name must be a string literal.
+	/// </summary>
+	static void SetThreadName(const char *name);
+	/// <summary>
+	/// Records an event on the calling thread. The name must be a string literal, as only the pointer is stored.
+	/// </summary>
+	static void AddEvent(const char *name, int64_t startNanos, int64_t endNanos);
+	/// <summary>
+	/// Writes the recorded events of all threads, including threads that have exited, as a Chrome trace JSON object.
+	/// </summary>
+	/// <returns>false if writing to the stream failed, else true</returns>
+	static bool WriteChromeTrace(std::ostream &stream);
+	/// <summary>
+	/// Discards the recorded events, and the buffers of threads that have exited.
+	/// </summary>
+	static void Clear();
+	static int64_t GetTimestamp()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static const size_t EVENTS_PER_THREAD = 16384;
+private:
+	static std::atomic<bool> s_IsEnabled;
+};
+
+struct TraceScope {
+private:
+	const char *m_Name;
+	int64_t m_Start;
+public:
+	TraceScope(const char *name) :
+		m_Name(Tracer::IsEnabled() ? name : nullptr),
+		m_Start(m_Name ? Tracer::GetTimestamp() : 0)
+	{
+	}
+	~TraceScope() {
+		End();
+	}
+	/// <summary>
+	/// Records the event now instead of at the end of the scope.
+	/// </summary>
+	void End() {
+		if (m_Name) {
+			Tracer::AddEvent(m_Name, m_Start, Tracer::GetTimestamp());
+			m_Name = nullptr;
+		}
+	}
+	TraceScope(const TraceScope &) = delete;
+	TraceScope &operator=(const TraceScope &) = delete;
+};
\ No newline at end of file
@@ -22,8 +22,7 @@ HRESULT VideoReader::InitializeSourceReader(
 	if (ppSourceReader) {
 		*ppSourceReader = nullptr;
 	}
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"InitializeSourceReader video reader");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	CComPtr<IMFAttributes> pAttributes = nullptr;
 	HRESULT hr = CreateAttributes(&pAttributes);
 	if (SUCCEEDED(hr)) {
@@ -60,8 +59,7 @@ HRESULT VideoReader::InitializeSourceReader(
 	if (ppSourceReader) {
 		*ppSourceReader = nullptr;
 	}
-	EnterCriticalSection(&m_CriticalSection);
-	LeaveCriticalSectionOnExit leaveCriticalSection(&m_CriticalSection, L"InitializeSourceReader video reader");
+	const std::lock_guard<SyncMutex> lock(m_Mutex);
 	CComPtr<IMFAttributes> pAttributes = nullptr;
 	HRESULT hr = CreateAttributes(&pAttributes);
 	if (SUCCEEDED(hr)) {
@@ -17,7 +17,7 @@ struct WASAPICapture::TaskWrapper {
 	std::thread m_ReconnectThread;
 };
 
-WASAPICapture::WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_opt_ std::wstring tag) :
+WASAPICapture::WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_ std::shared_ptr<MetricsRegistry> pMetrics, _In_opt_ std::wstring tag) :
 	m_DeviceId(L""),
 	m_DeviceName(L""),
 	m_DefaultDeviceId(L""),
@@ -28,6 +28,7 @@ WASAPICapture::WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions,
 {
 	m_Tag = tag;
 	m_AudioOptions = audioOptions;
+	m_Metrics = pMetrics;
 	m_TaskWrapperImpl = make_unique<TaskWrapper>();
 	m_TaskWrapperImpl->m_Notify = new WASAPINotify(this);
 	m_CaptureStartedEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
@@ -36,7 +37,7 @@ WASAPICapture::WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions,
 	m_ReconnectThreadStopEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 	m_CaptureReconnectEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
 
-	ResetEvent(m_AudioOptions->OnPropertyChangedEvent);
+	m_AudioOptions->OnPropertyChangedEvent.Reset();
 	m_TaskWrapperImpl->m_ReconnectThread = std::thread([this] {ReconnectThreadLoop(); });
 	m_RetryWait.SetWaitBands({
 							  {0, 1},
@@ -62,6 +63,10 @@ WASAPICapture::~WASAPICapture()
 
 HRESULT WASAPICapture::Initialize(_In_ std::wstring deviceId, _In_ EDataFlow flow) {
 	m_Flow = flow;
+	const std::string metricPrefix = flow == eRender ? "audio.output." : "audio.input.";
+	m_BufferedByteCount = m_Metrics->GetGauge(metricPrefix + "buffered_bytes");
+	m_DiscontinuityCount = m_Metrics->GetCounter(metricPrefix + "discontinuities");
+	m_RestartCount = m_Metrics->GetCounter(metricPrefix + "restarts");
 	CComPtr<IMMDevice> pDevice = nullptr;
 	if (deviceId.empty() || m_IsDefaultDevice) {
 		m_IsDefaultDevice = true;
@@ -353,6 +358,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 				SUCCEEDED(hr) && nNextPacketSize > 0;
 				hr = pAudioCaptureClient->GetNextPacketSize(&nNextPacketSize)
 				) {
+				TRACE_SCOPE("ReadAudioPacket");
 				// get the captured data
 				BYTE *pData;
 				UINT32 nNumFramesToRead;
@@ -379,6 +385,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 					else {
 						LOG_DEBUG(L"IAudioCaptureClient::GetBuffer set flags to 0x%08x on pass %u after %u frames on %ls", dwFlags, nPasses, nFrames, m_Tag.c_str());
 						isDiscontinuity = true;
+						m_DiscontinuityCount->Increment();
 					}
 				}
 				else if ((dwFlags & AUDCLNT_BUFFERFLAGS_SILENT) != 0) {
@@ -420,6 +427,7 @@ HRESULT WASAPICapture::StartCaptureLoop(
 						LOG_DEBUG(L"Discontinuity detected, padded audio bytes with %d bytes of silence on %ls", frameDiff, m_Tag.c_str());
 					}
 				}
+				m_BufferedByteCount->Set(m_RecordedBytes.size());
 				nFrames += nNumFramesToRead;
 				bFirstPacket = false;
 				nLastDevicePosition = nDevicePosition;
@@ -471,6 +479,7 @@ std::vector<BYTE> WASAPICapture::GetRecordedBytes(UINT64 duration100Nanos)
 		byteCount = min((frameCount * m_InputFormat.FrameBytes()), m_RecordedBytes.size());
 		newvector = std::vector<BYTE>(m_RecordedBytes.begin(), m_RecordedBytes.begin() + byteCount);
 		m_RecordedBytes.erase(m_RecordedBytes.begin(), m_RecordedBytes.begin() + byteCount);
+		m_BufferedByteCount->Set(m_RecordedBytes.size());
 		LOG_TRACE(L"Got %d bytes from WASAPICapture %ls. %d bytes remaining", newvector.size(), m_Tag.c_str(), m_RecordedBytes.size());
 
 		// convert audio
@@ -526,6 +535,7 @@ HRESULT WASAPICapture::StartCapture()
 	ResetEvent(m_CaptureStartedEvent);
 	m_TaskWrapperImpl->m_CaptureThread = std::thread([&]() {
 		LOG_TRACE("WASAPICapture thread started");
+		Tracer::SetThreadName("Audio capture");
 		HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
 		_set_se_translator(ExceptionTranslator);
 		// register with MMCSS
@@ -560,6 +570,7 @@ HRESULT WASAPICapture::StartCapture()
 		bool isRestart = WaitForSingleObjectEx(m_CaptureRestartEvent, 0, FALSE) == WAIT_OBJECT_0;
 
 		if (!isStop || isRestart) {
+			m_RestartCount->Increment();
 			SetEvent(m_CaptureReconnectEvent);
 		}
 		SetEvent(m_CaptureStopEvent);
@@ -691,6 +702,9 @@ void WASAPICapture::ClearRecordedBytes()
 {
 	const std::lock_guard<std::mutex> lock(m_TaskWrapperImpl->m_Mutex);
 	m_RecordedBytes.clear();
+	if (m_BufferedByteCount) {
+		m_BufferedByteCount->Set(0);
+	}
 }
 
 HRESULT WASAPICapture::ReconnectThreadLoop() {
@@ -21,7 +21,7 @@
 class WASAPICapture
 {
 public:
-	WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_opt_ std::wstring tag = L"");
+	WASAPICapture(_In_ std::shared_ptr<AUDIO_OPTIONS> &audioOptions, _In_ std::shared_ptr<MetricsRegistry> pMetrics, _In_opt_ std::wstring tag = L"");
 	~WASAPICapture();
 	void ClearRecordedBytes();
 	bool IsCapturing();
@@ -98,5 +98,9 @@ private:
 	WWMFPcmFormat m_OutputFormat;
 
 	std::shared_ptr<AUDIO_OPTIONS> m_AudioOptions;
+	std::shared_ptr<MetricsRegistry> m_Metrics;
+	MetricGauge *m_BufferedByteCount = nullptr;
+	MetricCounter *m_DiscontinuityCount = nullptr;
+	MetricCounter *m_RestartCount = nullptr;
 };
 
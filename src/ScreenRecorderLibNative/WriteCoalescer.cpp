@@ -0,0 +1,165 @@
+#include "WriteCoalescer.h"
+#include <algorithm>
+
+WriteCoalescer::WriteCoalescer(std::unique_ptr<CoalescedWriteTarget> pTarget, uint64_t position, size_t bufferSize, size_t bufferCount) :
+	m_Target(std::move(pTarget)),
+	m_BufferSize((std::max)(bufferSize, static_cast<size_t>(1))),
+	m_BufferCount((std::max)(bufferCount, static_cast<size_t>(1))),
+	m_CurrentBuffer{},
+	m_Queue{},
+	m_FreeBuffers{},
+	m_AllocatedBufferCount(0),
+	m_WriteThread{},
+	m_IsWriting(false),
+	m_IsStopping(false),
+	m_IsFailed(false),
+	m_Position(position),
+	m_BufferedEndPosition(0),
+	m_Statistics{},
+	m_TargetPosition(position)
+{
+}
+
+WriteCoalescer::~WriteCoalescer()
+{
+	Flush();
+	{
+		const std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopping = true;
+	}
+	m_BufferQueued.notify_all();
+	if (m_WriteThread.joinable()) {
+		m_WriteThread.join();
+	}
+}
+
+bool WriteCoalescer::Write(const uint8_t *pData, size_t size)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if (m_IsFailed) {
+		return false;
+	}
+	m_Statistics.WriteCount++;
+	m_Statistics.ByteCount += size;
+	while (size > 0) {
+		if (m_CurrentBuffer && m_CurrentBuffer->Position + m_CurrentBuffer->Data.size() != m_Position) {
+			QueueCurrentBuffer();
+		}
+		if (!m_CurrentBuffer) {
+			if (m_FreeBuffers.empty() && m_AllocatedBufferCount < m_BufferCount) {
+				std::vector<uint8_t> buffer{};
+				buffer.reserve(m_BufferSize);
+				m_FreeBuffers.push_back(std::move(buffer));
+				m_AllocatedBufferCount++;
+			}
+			if (m_FreeBuffers.empty()) {
+				m_Statistics.WaitCount++;
+				m_BufferWritten.wait(lock, [this] { return !m_FreeBuffers.empty() || m_IsFailed; });
+				if (m_IsFailed) {
+					return false;
+				}
+			}
+			m_CurrentBuffer = WRITE_BUFFER{ m_Position, std::move(m_FreeBuffers.back()) };
+			m_FreeBuffers.pop_back();
+		}
+		std::vector<uint8_t> &data = m_CurrentBuffer->Data;
+		const size_t count = (std::min)(size, m_BufferSize - data.size());
+		data.insert(data.end(), pData, pData + count);
+		pData += count;
+		size -= count;
+		m_Position += count;
+		m_BufferedEndPosition = (std::max)(m_BufferedEndPosition, m_Position);
+		if (data.size() == m_BufferSize) {
+			QueueCurrentBuffer();
+		}
+	}
+	return true;
+}
+
+void WriteCoalescer::SetPosition(uint64_t position)
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Position = position;
+}
+
+uint64_t WriteCoalescer::GetPosition()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Position;
+}
+
+uint64_t WriteCoalescer::GetBufferedEndPosition()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_BufferedEndPosition;
+}
+
+bool WriteCoalescer::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if (m_CurrentBuffer) {
+		QueueCurrentBuffer();
+	}
+	m_BufferWritten.wait(lock, [this] { return m_Queue.empty() && !m_IsWriting; });
+	m_BufferedEndPosition = 0;
+	m_TargetPosition.reset();
+	return !m_IsFailed;
+}
+
+WRITE_COALESCER_STATISTICS WriteCoalescer::GetStatistics()
+{
+	const std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Statistics;
+}
+
+void WriteCoalescer::QueueCurrentBuffer()
+{
+	m_Queue.push_back(std::move(*m_CurrentBuffer));
+	m_CurrentBuffer.reset();
+	if (!m_WriteThread.joinable()) {
+		m_WriteThread = std::thread([this] { WriteThreadLoop(); });
+	}
+	m_BufferQueued.notify_one();
+}
+
+void WriteCoalescer::WriteThreadLoop()
+{
+	while (true) {
+		WRITE_BUFFER buffer{};
+		bool isFailed = false;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_BufferQueued.wait(lock, [this] { return m_IsStopping || !m_Queue.empty(); });
+			if (m_Queue.empty()) {
+				break;
+			}
+			buffer = std::move(m_Queue.front());
+			m_Queue.pop_front();
+			m_IsWriting = true;
+			isFailed = m_IsFailed;
+		}
+		bool isSeeked = false;
+		bool isWritten = false;
+		if (!isFailed) {
+			if (m_TargetPosition != buffer.Position) {
+				isSeeked = true;
+				isFailed = !m_Target->Seek(buffer.Position);
+			}
+			if (!isFailed) {
+				isWritten = true;
+				isFailed = !m_Target->Write(buffer.Data.data(), buffer.Data.size());
+			}
+			m_TargetPosition = isFailed ? std::nullopt : std::optional<uint64_t>(buffer.Position + buffer.Data.size());
+		}
+		{
+			const std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Statistics.TargetSeekCount += isSeeked ? 1 : 0;
+			m_Statistics.TargetWriteCount += isWritten ? 1 : 0;
+			m_IsFailed = m_IsFailed || isFailed;
+			buffer.Data.clear();
+			m_FreeBuffers.push_back(std::move(buffer.Data));
+			m_IsWriting = false;
+		}
+		m_BufferWritten.notify_all();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+struct WRITE_COALESCER_STATISTICS {
+	//The writes made to the coalescer, and the bytes written.
+	uint64_t WriteCount;
+	uint64_t ByteCount;
+	//The calls made to the target, which are fewer than the writes made, as they are batched in the buffers.
+	uint64_t TargetWriteCount;
+	uint64_t TargetSeekCount;
+	//The writes that waited for a buffer to be written to the target, because all buffers were full.
+	uint64_t WaitCount;
+};
+
+/// <summary>
+/// The destination of a WriteCoalescer. It is called on the write thread of the coalescer, one call at a time.
+/// </summary>
+class CoalescedWriteTarget
+{
+public:
+	virtual ~CoalescedWriteTarget() {}
+	/// <summary>
+	/// Moves the position of the target, relative to its start.
+	/// </summary>
+	virtual bool Seek(uint64_t position) = 0;
+	/// <summary>
+	/// Writes the data at the position of the target, and moves the position to its end.
+	/// </summary>
+	virtual bool Write(const uint8_t *pData, size_t size) = 0;
+};
+
+/// <summary>
+/// Collects small writes in large buffers, which are written to a target on a write thread, so the target is called once per buffer instead of once per write, and a slow target does not hold up the writer.
+/// Writes can be made at any position, e.g. to update a header that was already written. A write that does not continue the current buffer starts a new one, and the buffers are written in order,
+/// seeking the target as needed, so a later write overwrites an earlier one as it would without the buffers. When all buffers are waiting to be written, the next write waits for one to be free.
+/// After a failed write to the target, the remaining data is discarded, and writes to the coalescer fail.
+/// </summary>
+class WriteCoalescer
+{
+public:
+	/// <param name="position">The current position of the target, where the first write is made if the position is not changed.</param>
+	/// <param name="bufferSize">The size of each buffer. At least 1.</param>
+	/// <param name="bufferCount">The number of buffers that can be filled or waiting to be written. At least 1.</param>
+	WriteCoalescer(std::unique_ptr<CoalescedWriteTarget> pTarget, uint64_t position, size_t bufferSize, size_t bufferCount);
+	/// <summary>
+	/// Writes the buffered data to the target, and stops the write thread.
+	/// </summary>
+	~WriteCoalescer();
+	/// <summary>
+	/// Writes the data at the current position, and moves the position to its end.
+	/// </summary>
+	/// <returns>false if a write to the target has failed.</returns>
+	bool Write(const uint8_t *pData, size_t size);
+	void SetPosition(uint64_t position);
+	uint64_t GetPosition();
+	/// <summary>
+	/// Gets the end of the furthest write since the last flush, or 0 if there was none. The size of the target is the larger of this and its size after the last flush.
+	/// </summary>
+	uint64_t GetBufferedEndPosition();
+	/// <summary>
+	/// Writes the buffered data to the target, and waits until it is written. The target can then be used directly until the next write, e.g. to read from it.
+	/// The position of the target is not assumed after it, so the next buffer written seeks the target to its position.
+	/// </summary>
+	/// <returns>false if a write to the target has failed.</returns>
+	bool Flush();
+	WRITE_COALESCER_STATISTICS GetStatistics();
+private:
+	struct WRITE_BUFFER {
+		//The position of the first byte of the buffer in the target.
+		uint64_t Position;
+		std::vector<uint8_t> Data;
+	};
+
+	std::unique_ptr<CoalescedWriteTarget> m_Target;
+	size_t m_BufferSize;
+	size_t m_BufferCount;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_BufferQueued;
+	std::condition_variable m_BufferWritten;
+	//The buffer being filled, which continues until a write at another position, or until it is full.
+	std::optional<WRITE_BUFFER> m_CurrentBuffer;
+	std::deque<WRITE_BUFFER> m_Queue;
+	std::vector<std::vector<uint8_t>> m_FreeBuffers;
+	//The buffers allocated, up to the buffer count. They are allocated as they are needed, so short writes only use one.
+	size_t m_AllocatedBufferCount;
+	std::thread m_WriteThread;
+	bool m_IsWriting;
+	bool m_IsStopping;
+	bool m_IsFailed;
+	uint64_t m_Position;
+	uint64_t m_BufferedEndPosition;
+	WRITE_COALESCER_STATISTICS m_Statistics;
+
+	//Only used on the write thread, and by Flush while the write thread is idle.
+	std::optional<uint64_t> m_TargetPosition;
+
+	void QueueCurrentBuffer();
+	void WriteThreadLoop();
+};
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include "Trace.h"
 
 #if _DEBUG
 #define MEASURE_EXECUTION_TIME false
@@ -19,17 +20,28 @@
 #define LOG_LVL_INFO 2
 #define LOG_LVL_WARN 3
 #define LOG_LVL_ERR 4
+#define LOG_LVL_OFF 5
 
-#define LOG_TRACE(format, ...) if(isLoggingEnabled && LOG_LVL_TRACE >= logSeverityLevel) {_log(L"%s [TRACE] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_DEBUG(format, ...) if(isLoggingEnabled && LOG_LVL_DEBUG >= logSeverityLevel) {_log(L"%s [DEBUG] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_INFO(format, ...) if(isLoggingEnabled && LOG_LVL_INFO >= logSeverityLevel) {_log(L"%s [INFO]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_WARN(format, ...) if(isLoggingEnabled && LOG_LVL_WARN >= logSeverityLevel) {_log(L"%s [WARN]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
-#define LOG_ERROR(format, ...) if(isLoggingEnabled && LOG_LVL_ERR >= logSeverityLevel) {_log(L"%s [ERROR] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_TRACE(format, ...) if(LOG_LVL_TRACE >= logActiveSeverityLevel) {_log(L"%s [TRACE] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_DEBUG(format, ...) if(LOG_LVL_DEBUG >= logActiveSeverityLevel) {_log(L"%s [DEBUG] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_INFO(format, ...) if(LOG_LVL_INFO >= logActiveSeverityLevel) {_log(L"%s [INFO]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_WARN(format, ...) if(LOG_LVL_WARN >= logActiveSeverityLevel) {_log(L"%s [WARN]  [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
+#define LOG_ERROR(format, ...) if(LOG_LVL_ERR >= logActiveSeverityLevel) {_log(L"%s [ERROR] [%-25.24hs|%20.19hs:%4d] >> " format L"\n", GetTimestamp().c_str(), file_name(__FILE__), __func__, __LINE__, __VA_ARGS__);}
 
 extern bool isLoggingEnabled;
 extern int logSeverityLevel;
-extern std::wstring logFilePath;
+//The lowest severity that is logged, or LOG_LVL_OFF if logging is disabled, so skipped log calls cost a single comparison.
+extern int logActiveSeverityLevel;
 void _log(PCWSTR format, ...);
+/// <summary>
+/// Sets the file log lines are written to, or an empty path to write them to the debugger output. Lines are written to the file asynchronously.
+/// Setting a file also installs an unhandled exception filter and a terminate handler, which write the queued lines before the process dies and then call the handlers they replaced.
+/// </summary>
+void SetLogFile(const std::wstring &path);
+/// <summary>
+/// Waits until the queued log lines are written to the log file.
+/// </summary>
+void FlushLog();
 std::wstring GetTimestamp();
 
 constexpr const char *file_name(const char *path) {
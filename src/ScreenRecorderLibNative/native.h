@@ -1,6 +1,5 @@
 #pragma once
 #include "RecordingManager.h"
-#include "fifo_map.h"
 #include "DX.util.h"
 #include "MF.util.h"
 #include "CoreAudio.util.h"
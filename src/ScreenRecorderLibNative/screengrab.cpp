@@ -183,6 +183,44 @@ namespace {
 		}
 		return S_OK;
 	}
+
+	HRESULT EncodeTexture(_In_ ID3D11DeviceContext *pContext,
+		_In_ ID3D11Resource *pSource,
+		_In_ ImageEncoderFormat format,
+		_In_opt_ ImageEncoder *pEncoder,
+		_In_ const ImageWriteCallback &write)
+	{
+		D3D11_TEXTURE2D_DESC desc = {};
+		CComPtr<ID3D11Texture2D> pStaging;
+		HRESULT hr = CaptureTexture(pContext, pSource, desc, pStaging);
+		if (FAILED(hr))
+			return hr;
+
+		switch (desc.Format)
+		{
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			break;
+		default:
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+
+		D3D11_MAPPED_SUBRESOURCE mapInfo;
+		hr = pContext->Map(pStaging, 0, D3D11_MAP_READ, 0, &mapInfo);
+		if (FAILED(hr))
+			return hr;
+
+		std::unique_ptr<ImageEncoder> temporaryEncoder;
+		if (!pEncoder) {
+			temporaryEncoder = std::make_unique<ImageEncoder>();
+			pEncoder = temporaryEncoder.get();
+		}
+		bool isEncoded = pEncoder->Encode(format, static_cast<const uint8_t *>(mapInfo.pData), static_cast<int32_t>(mapInfo.RowPitch), static_cast<int32_t>(desc.Width), static_cast<int32_t>(desc.Height), write);
+		pContext->Unmap(pStaging, 0);
+		return isEncoded ? S_OK : E_FAIL;
+	}
 } // anonymous namespace
 
 HRESULT __cdecl SaveWICTextureToFile(
@@ -532,6 +570,75 @@ HRESULT __cdecl SaveWICTextureToWicStream(
 	return S_OK;
 }
 
+HRESULT SaveTextureWithImageEncoderToFile(
+	_In_ ID3D11DeviceContext *pContext,
+	_In_ ID3D11Resource *pSource,
+	_In_ ImageEncoderFormat format,
+	_In_z_ const wchar_t *filePath,
+	_In_opt_ ImageEncoder *pEncoder)
+{
+	if (!filePath)
+		return E_INVALIDARG;
+
+	HANDLE hFile = CreateFileW(filePath, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	HRESULT writeHr = S_OK;
+	HRESULT hr = EncodeTexture(pContext, pSource, format, pEncoder, [&](const uint8_t *pData, size_t length) {
+		while (length > 0) {
+			DWORD written = 0;
+			if (!WriteFile(hFile, pData, static_cast<DWORD>(min(length, static_cast<size_t>(MAXDWORD))), &written, nullptr)) {
+				writeHr = HRESULT_FROM_WIN32(GetLastError());
+				return false;
+			}
+			pData += written;
+			length -= written;
+		}
+		return true;
+		});
+	CloseHandle(hFile);
+	if (FAILED(writeHr)) {
+		hr = writeHr;
+	}
+	if (FAILED(hr)) {
+		DeleteFileW(filePath);
+	}
+	return hr;
+}
+
+HRESULT SaveTextureWithImageEncoderToStream(
+	_In_ ID3D11DeviceContext *pContext,
+	_In_ ID3D11Resource *pSource,
+	_In_ ImageEncoderFormat format,
+	_In_ IStream *pStream,
+	_In_opt_ ImageEncoder *pEncoder)
+{
+	if (!pStream)
+		return E_INVALIDARG;
+
+	HRESULT writeHr = S_OK;
+	HRESULT hr = EncodeTexture(pContext, pSource, format, pEncoder, [&](const uint8_t *pData, size_t length) {
+		while (length > 0) {
+			ULONG written = 0;
+			writeHr = pStream->Write(pData, static_cast<ULONG>(min(length, static_cast<size_t>(ULONG_MAX))), &written);
+			if (SUCCEEDED(writeHr) && written == 0) {
+				writeHr = STG_E_MEDIUMFULL;
+			}
+			if (FAILED(writeHr)) {
+				return false;
+			}
+			pData += written;
+			length -= written;
+		}
+		return true;
+		});
+	if (FAILED(writeHr)) {
+		hr = writeHr;
+	}
+	return hr;
+}
+
 HRESULT CreateWICBitmapFromFile(_In_z_ const wchar_t *filePath, _In_ const GUID targetFormat, _Outptr_ IWICBitmapSource **ppIWICBitmapSource)
 {
 	HRESULT hr = S_OK;
@@ -3,6 +3,7 @@
 #include <functional>
 #include <wincodec.h>
 #include <optional>
+#include "ImageEncoder.h"
 
 #pragma comment(lib, "Windowscodecs.lib")
 
@@ -33,6 +34,24 @@ HRESULT __cdecl SaveWICTextureToWicStream(
 	_In_opt_ const GUID *targetFormat = nullptr,
 	_In_opt_ std::function<void __cdecl(IPropertyBag2 *)> setCustomProps = nullptr);
 
+/// <summary>
+/// Saves a 32bpp BGRA texture with the built-in image encoder, reading the pixels directly from the mapped staging texture.
+/// </summary>
+/// <param name="pEncoder">An encoder to reuse the buffers of, or nullptr to use a temporary one.</param>
+HRESULT SaveTextureWithImageEncoderToFile(
+	_In_ ID3D11DeviceContext *pContext,
+	_In_ ID3D11Resource *pSource,
+	_In_ ImageEncoderFormat format,
+	_In_z_ const wchar_t *filePath,
+	_In_opt_ ImageEncoder *pEncoder = nullptr);
+
+HRESULT SaveTextureWithImageEncoderToStream(
+	_In_ ID3D11DeviceContext *pContext,
+	_In_ ID3D11Resource *pSource,
+	_In_ ImageEncoderFormat format,
+	_In_ IStream *pStream,
+	_In_opt_ ImageEncoder *pEncoder = nullptr);
+
 HRESULT CreateWICBitmapFromFile(
 	_In_z_ const wchar_t *filePath,
 	_In_ const GUID targetFormat,
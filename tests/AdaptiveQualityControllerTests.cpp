@@ -0,0 +1,155 @@
+#include "Test.h"
+#include "AdaptiveQualityController.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+	//30 fps, in 100 nanosecond units.
+	const int64_t FRAME_PERIOD = 333333;
+	const int64_t SECOND = 10000000;
+
+	struct SIMULATION_RESULT {
+		uint32_t MaxLevelIndex;
+		uint32_t FinalLevelIndex;
+		uint64_t LoweredCount;
+		uint64_t RestoredCount;
+	};
+
+	/// <summary>
+	/// Records at 30 fps against an encoder with the given load over time, where 1.0 takes the whole frame period to encode a frame at full quality.
+	/// The frame rate and bitrate of the current level lower the load, and frames that take longer than their interval build up a queue.
+	/// </summary>
+	SIMULATION_RESULT Simulate(std::function<double(double seconds)> load, double seconds) {
+		AdaptiveQualityController controller;
+		controller.Start(FRAME_PERIOD, 0);
+		SIMULATION_RESULT result{};
+		double backlog = 0;
+		for (int64_t time = 0; time < static_cast<int64_t>(seconds * SECOND);) {
+			const ADAPTIVE_QUALITY_LEVEL level = controller.GetLevel();
+			const int64_t interval = static_cast<int64_t>(FRAME_PERIOD / level.FramerateScale);
+			const double cost = load(static_cast<double>(time) / SECOND) * (0.7 + 0.3 * level.BitrateScale) * FRAME_PERIOD;
+			backlog = std::clamp(backlog + cost - interval, 0.0, 8.0 * interval);
+			//The sink writer blocks the recording thread once its queue is full, so the write latency is capped.
+			const int64_t latency = static_cast<int64_t>((std::min)(cost, 2.0 * interval));
+			controller.RecordFrame(time, latency, static_cast<uint32_t>(backlog / interval));
+			result.MaxLevelIndex = (std::max)(result.MaxLevelIndex, controller.GetLevelIndex());
+			time += interval;
+		}
+		result.FinalLevelIndex = controller.GetLevelIndex();
+		result.LoweredCount = controller.GetLoweredCount();
+		result.RestoredCount = controller.GetRestoredCount();
+		return result;
+	}
+
+	//Records a window of 30 frames with the same latency and queue depth, and returns the adjustment made at its end.
+	//The last frame is exactly a window length after the start, so it ends the window.
+	QualityAdjustment RecordWindow(AdaptiveQualityController &controller, int64_t &time, int64_t latency, uint32_t queueDepth) {
+		QualityAdjustment adjustment = QualityAdjustment::None;
+		const int64_t windowStart = time;
+		for (int i = 1; i <= 30; i++) {
+			time = windowStart + AdaptiveQualityController::DEFAULT_WINDOW_LENGTH * i / 30;
+			const QualityAdjustment frameAdjustment = controller.RecordFrame(time, latency, queueDepth);
+			if (frameAdjustment != QualityAdjustment::None) {
+				adjustment = frameAdjustment;
+			}
+		}
+		return adjustment;
+	}
+}
+
+TEST(StepOverloadLowersAndRecovers)
+{
+	SIMULATION_RESULT result = Simulate([](double seconds) { return seconds < 10 ? 0.5 : seconds < 40 ? 1.6 : 0.3; }, 120);
+	CHECK_EQUAL(3u, result.MaxLevelIndex);
+	CHECK_EQUAL(0u, result.FinalLevelIndex);
+	CHECK_EQUAL(3u, result.LoweredCount);
+	CHECK_EQUAL(3u, result.RestoredCount);
+}
+
+TEST(SteadyLightLoadIsUnchanged)
+{
+	SIMULATION_RESULT result = Simulate([](double) { return 0.6; }, 60);
+	CHECK_EQUAL(0u, result.LoweredCount);
+	CHECK_EQUAL(0u, result.MaxLevelIndex);
+}
+
+TEST(BriefSpikeIsIgnored)
+{
+	SIMULATION_RESULT result = Simulate([](double seconds) { return seconds >= 10.5 && seconds < 11.0 ? 3.0 : 0.5; }, 60);
+	CHECK_EQUAL(0u, result.LoweredCount);
+}
+
+TEST(MarginalLoadDoesNotOscillate)
+{
+	//A load that is only just too high at full quality would bounce between two levels without the growing wait before a restore.
+	SIMULATION_RESULT result = Simulate([](double seconds) { return seconds < 5 ? 0.5 : 1.15; }, 200);
+	CHECK(result.LoweredCount >= 1);
+	CHECK(result.RestoredCount <= 3);
+	CHECK(result.FinalLevelIndex >= 1);
+}
+
+TEST(OverloadNeedsConsecutiveWindows)
+{
+	AdaptiveQualityController controller;
+	int64_t time = 0;
+	controller.Start(FRAME_PERIOD, time);
+	//Late frames overload a window, and a normal window in between starts the count over.
+	CHECK(RecordWindow(controller, time, FRAME_PERIOD * 2, 0) == QualityAdjustment::None);
+	CHECK(RecordWindow(controller, time, FRAME_PERIOD / 4, 0) == QualityAdjustment::None);
+	CHECK(RecordWindow(controller, time, FRAME_PERIOD * 2, 0) == QualityAdjustment::None);
+	CHECK(RecordWindow(controller, time, FRAME_PERIOD * 2, 0) == QualityAdjustment::Lowered);
+	CHECK_EQUAL(1u, controller.GetLevelIndex());
+	//A deep queue overloads a window too, even if each write is fast.
+	CHECK(RecordWindow(controller, time, 0, AdaptiveQualityController::DEFAULT_MAX_QUEUE_DEPTH) == QualityAdjustment::None);
+	CHECK(RecordWindow(controller, time, 0, AdaptiveQualityController::DEFAULT_MAX_QUEUE_DEPTH) == QualityAdjustment::Lowered);
+	CHECK_EQUAL(2u, controller.GetLevelIndex());
+	CHECK(controller.GetLevel().FramerateScale < 1.0);
+}
+
+TEST(LevelsAreBounded)
+{
+	AdaptiveQualityController controller;
+	int64_t time = 0;
+	controller.Start(FRAME_PERIOD, time);
+	for (int i = 0; i < 40; i++) {
+		RecordWindow(controller, time, SECOND, 100);
+	}
+	CHECK_EQUAL(AdaptiveQualityController::GetLevelCount() - 1, controller.GetLevelIndex());
+	CHECK_EQUAL(static_cast<uint64_t>(AdaptiveQualityController::GetLevelCount() - 1), controller.GetLoweredCount());
+	for (int i = 0; i < 40 * static_cast<int>(AdaptiveQualityController::GetLevelCount()); i++) {
+		RecordWindow(controller, time, 0, 0);
+	}
+	CHECK_EQUAL(0u, controller.GetLevelIndex());
+	CHECK(controller.GetLevel().FramerateScale == 1.0 && controller.GetLevel().BitrateScale == 1.0);
+}
+
+TEST(RestoreWaitsLongerAfterRelapse)
+{
+	AdaptiveQualityController controller;
+	controller.SetOverloadedWindowCount(1);
+	controller.SetIdleWindowCount(2);
+	int64_t time = 0;
+	controller.Start(FRAME_PERIOD, time);
+	CHECK(RecordWindow(controller, time, SECOND, 0) == QualityAdjustment::Lowered);
+	CHECK(RecordWindow(controller, time, 0, 0) == QualityAdjustment::None);
+	CHECK(RecordWindow(controller, time, 0, 0) == QualityAdjustment::Restored);
+	//The load returns right after the restore, so the next restore needs twice the idle windows.
+	CHECK(RecordWindow(controller, time, SECOND, 0) == QualityAdjustment::Lowered);
+	for (int i = 0; i < 3; i++) {
+		CHECK(RecordWindow(controller, time, 0, 0) == QualityAdjustment::None);
+	}
+	CHECK(RecordWindow(controller, time, 0, 0) == QualityAdjustment::Restored);
+	CHECK_EQUAL(2u, controller.GetRestoredCount());
+}
+
+TEST(StartResetsLevel)
+{
+	AdaptiveQualityController controller;
+	controller.SetOverloadedWindowCount(1);
+	int64_t time = 0;
+	controller.Start(FRAME_PERIOD, time);
+	CHECK(RecordWindow(controller, time, SECOND, 0) == QualityAdjustment::Lowered);
+	controller.Start(FRAME_PERIOD, time);
+	CHECK_EQUAL(0u, controller.GetLevelIndex());
+	CHECK_EQUAL(0u, controller.GetLoweredCount());
+}
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "Test.h"
+#include "BitstreamDispatcher.h"
+#include <chrono>
+#include <future>
+
+namespace {
+	struct DELIVERED_PACKET {
+		PacketStream Stream;
+		int64_t Timestamp;
+		bool IsKeyFrame;
+		std::vector<uint8_t> Data;
+		std::vector<uint8_t> ParameterSets;
+		bool HasParameterSets;
+	};
+
+	const std::vector<uint8_t> PARAMETER_SETS{ 0, 0, 0, 1, 0x67, 1, 0, 0, 0, 1, 0x68, 2 };
+
+	//A video frame in Annex B format, with an access unit delimiter, and with the parameter sets if it is a key frame.
+	ENCODED_PACKET CreateVideoPacket(int64_t timestamp, bool isKeyFrame) {
+		const std::vector<uint8_t> delimiter{ 0, 0, 0, 1, 0x09, 0xF0 };
+		const std::vector<uint8_t> slice{ 0, 0, 1, static_cast<uint8_t>(isKeyFrame ? 0x65 : 0x41), static_cast<uint8_t>(timestamp) };
+		std::vector<uint8_t> data = delimiter;
+		if (isKeyFrame) {
+			data.insert(data.end(), PARAMETER_SETS.begin(), PARAMETER_SETS.end());
+		}
+		data.insert(data.end(), slice.begin(), slice.end());
+		return ENCODED_PACKET{ PacketStream::Video, timestamp, 1, isKeyFrame, data };
+	}
+
+	ENCODED_PACKET CreateAudioPacket(int64_t timestamp) {
+		return ENCODED_PACKET{ PacketStream::Audio, timestamp, 1, false, { 0xFF, 0xF1, static_cast<uint8_t>(timestamp) } };
+	}
+
+	DELIVERED_PACKET Copy(const BITSTREAM_PACKET &packet) {
+		DELIVERED_PACKET copy{ packet.Stream, packet.Timestamp, packet.IsKeyFrame, std::vector<uint8_t>(packet.pData, packet.pData + packet.Size), {}, packet.pParameterSets != nullptr };
+		if (packet.pParameterSets) {
+			copy.ParameterSets.assign(packet.pParameterSets, packet.pParameterSets + packet.ParameterSetsSize);
+		}
+		return copy;
+	}
+
+	//Waits for the delivery thread to deliver a number of packets.
+	bool WaitForDelivery(BitstreamDispatcher &dispatcher, uint64_t count) {
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (dispatcher.GetStatistics().DeliveredPacketCount < count) {
+			if (std::chrono::steady_clock::now() > timeout) {
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+}
+
+TEST(AnnexBPacketsAreDeliveredUnchanged)
+{
+	std::vector<DELIVERED_PACKET> delivered{};
+	BitstreamDispatcher dispatcher([&](const BITSTREAM_PACKET &packet) { delivered.push_back(Copy(packet)); }, VideoCodec::H264, BitstreamFormat::AnnexB, 100);
+	std::vector<ENCODED_PACKET> packets{};
+	for (int64_t i = 0; i < 20; i++) {
+		packets.push_back(CreateVideoPacket(i, i % 5 == 0));
+		packets.push_back(CreateAudioPacket(i));
+	}
+	uint64_t byteCount = 0;
+	for (const ENCODED_PACKET &packet : packets) {
+		CHECK(dispatcher.Enqueue(packet));
+		byteCount += packet.Data.size();
+	}
+	dispatcher.Stop(true);
+	CHECK_EQUAL(packets.size(), delivered.size());
+	for (size_t i = 0; i < packets.size() && i < delivered.size(); i++) {
+		CHECK(delivered[i].Stream == packets[i].Stream);
+		CHECK_EQUAL(packets[i].Timestamp, delivered[i].Timestamp);
+		CHECK(delivered[i].Data == packets[i].Data);
+		//The parameter sets are passed on key frames in both formats.
+		CHECK(delivered[i].HasParameterSets == (packets[i].Stream == PacketStream::Video && packets[i].IsKeyFrame));
+	}
+	BITSTREAM_DISPATCHER_STATISTICS stats = dispatcher.GetStatistics();
+	CHECK_EQUAL(packets.size(), stats.DeliveredPacketCount);
+	CHECK_EQUAL(byteCount, stats.DeliveredByteCount);
+	CHECK_EQUAL(0u, stats.DroppedPacketCount);
+	//No packets are queued after the dispatcher is stopped.
+	CHECK(!dispatcher.Enqueue(CreateAudioPacket(20)));
+}
+
+TEST(LengthPrefixedVideoHasSeparateParameterSets)
+{
+	std::vector<DELIVERED_PACKET> delivered{};
+	BitstreamDispatcher dispatcher([&](const BITSTREAM_PACKET &packet) { delivered.push_back(Copy(packet)); }, VideoCodec::H264, BitstreamFormat::LengthPrefixed, 100);
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(0, true)));
+	CHECK(dispatcher.Enqueue(CreateAudioPacket(0)));
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(1, false)));
+	dispatcher.Stop(true);
+	CHECK_EQUAL(3u, delivered.size());
+	if (delivered.size() == 3) {
+		//Only the slice is left in the frame, without the delimiter and parameter sets.
+		CHECK((delivered[0].Data == std::vector<uint8_t>{ 0, 0, 0, 2, 0x65, 0 }));
+		CHECK(delivered[0].ParameterSets == PARAMETER_SETS);
+		CHECK(delivered[1].Data == CreateAudioPacket(0).Data);
+		CHECK(!delivered[1].HasParameterSets);
+		CHECK((delivered[2].Data == std::vector<uint8_t>{ 0, 0, 0, 2, 0x41, 1 }));
+		CHECK(!delivered[2].HasParameterSets);
+	}
+}
+
+TEST(FullQueueDropsVideoUntilKeyFrame)
+{
+	std::vector<DELIVERED_PACKET> delivered{};
+	std::promise<void> isDelivering{};
+	std::promise<void> isReleased{};
+	std::shared_future<void> release = isReleased.get_future().share();
+	BitstreamDispatcher dispatcher([&](const BITSTREAM_PACKET &packet) {
+		delivered.push_back(Copy(packet));
+		if (delivered.size() == 1) {
+			isDelivering.set_value();
+			release.wait();
+		}
+	}, VideoCodec::H264, BitstreamFormat::AnnexB, 2);
+	//The first frame holds up the delivery thread, so the queue fills.
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(0, true)));
+	isDelivering.get_future().wait();
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(1, false)));
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(2, false)));
+	CHECK(!dispatcher.Enqueue(CreateVideoPacket(3, false)));
+	CHECK(!dispatcher.Enqueue(CreateAudioPacket(3)));
+	isReleased.set_value();
+	CHECK(WaitForDelivery(dispatcher, 3));
+	//The queue has room again, but the video after the dropped frame can not be decoded. Audio is not affected.
+	CHECK(!dispatcher.Enqueue(CreateVideoPacket(4, false)));
+	CHECK(dispatcher.Enqueue(CreateAudioPacket(4)));
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(5, true)));
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(6, false)));
+	dispatcher.Stop(true);
+	const int64_t expectedTimestamps[]{ 0, 1, 2, 4, 5, 6 };
+	CHECK_EQUAL(6u, delivered.size());
+	for (size_t i = 0; i < 6 && i < delivered.size(); i++) {
+		CHECK_EQUAL(expectedTimestamps[i], delivered[i].Timestamp);
+	}
+	BITSTREAM_DISPATCHER_STATISTICS stats = dispatcher.GetStatistics();
+	CHECK_EQUAL(3u, stats.DroppedPacketCount);
+	CHECK_EQUAL(2u, stats.MaxQueuedPacketCount);
+}
+
+TEST(StopCanDiscardQueuedPackets)
+{
+	int deliveredCount = 0;
+	std::promise<void> isDelivering{};
+	std::promise<void> isReleased{};
+	std::shared_future<void> release = isReleased.get_future().share();
+	BitstreamDispatcher dispatcher([&](const BITSTREAM_PACKET &) {
+		if (++deliveredCount == 1) {
+			isDelivering.set_value();
+			release.wait();
+		}
+	}, VideoCodec::H264, BitstreamFormat::AnnexB, 10);
+	CHECK(dispatcher.Enqueue(CreateVideoPacket(0, true)));
+	isDelivering.get_future().wait();
+	for (int64_t i = 1; i < 5; i++) {
+		CHECK(dispatcher.Enqueue(CreateVideoPacket(i, false)));
+	}
+	std::thread releaser([&]() {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		isReleased.set_value();
+	});
+	dispatcher.Stop(false);
+	releaser.join();
+	CHECK_EQUAL(1, deliveredCount);
+	CHECK_EQUAL(1u, dispatcher.GetStatistics().DeliveredPacketCount);
+}
+
+TEST(BuffersAreReused)
+{
+	BitstreamDispatcher dispatcher([](const BITSTREAM_PACKET &) {}, VideoCodec::H264, BitstreamFormat::AnnexB, 4);
+	CHECK(dispatcher.AcquireBuffer().capacity() == 0);
+	ENCODED_PACKET packet = CreateAudioPacket(0);
+	packet.Data.assign(4096, 1);
+	CHECK(dispatcher.Enqueue(std::move(packet)));
+	CHECK(WaitForDelivery(dispatcher, 1));
+	//The buffer of the delivered packet is returned empty, with its memory kept for the next packet.
+	std::vector<uint8_t> buffer = dispatcher.AcquireBuffer();
+	CHECK(buffer.empty());
+	CHECK(buffer.capacity() >= 4096);
+}
\ No newline at end of file
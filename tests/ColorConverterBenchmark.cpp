@@ -0,0 +1,54 @@
+#include "ColorConverter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Measures the throughput of the BGRA to YUV conversion for common frame sizes, with one thread and with all hardware threads.
+// Usage: ColorConverterBenchmark [frames per measurement]
+
+namespace {
+	struct FRAME_SIZE {
+		const char *Name;
+		int32_t Width;
+		int32_t Height;
+	};
+
+	void Measure(const FRAME_SIZE &size, YUVFormat format, const char *formatName, uint32_t threadCount, int frameCount) {
+		std::vector<uint8_t> source(static_cast<size_t>(size.Width) * size.Height * 4);
+		uint32_t state = 1;
+		for (uint8_t &value : source) {
+			state = state * 1664525u + 1013904223u;
+			value = static_cast<uint8_t>(state >> 24);
+		}
+		ColorConverter converter;
+		converter.SetOptions(format, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+		converter.SetThreadCount(threadCount);
+		size_t outputSize = 0;
+		//The first conversion allocates the output buffer and starts the workers.
+		converter.Convert(source.data(), size.Width * 4, size.Width, size.Height, &outputSize);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frameCount; i++) {
+			converter.Convert(source.data(), size.Width * 4, size.Width, size.Height, &outputSize);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double milliseconds = seconds * 1000.0 / frameCount;
+		double megapixels = static_cast<double>(size.Width) * size.Height * frameCount / seconds / 1e6;
+		std::printf("%-6s %-5s %2u threads: %8.3f ms/frame %8.1f fps %8.1f Mpixel/s\n", size.Name, formatName, threadCount, milliseconds, 1000.0 / milliseconds, megapixels);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const int frameCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 100;
+	const FRAME_SIZE sizes[] = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "1440p", 2560, 1440 }, { "2160p", 3840, 2160 } };
+	const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (const FRAME_SIZE &size : sizes) {
+		Measure(size, YUVFormat::NV12, "NV12", 1, frameCount);
+		Measure(size, YUVFormat::NV12, "NV12", hardwareThreads, frameCount);
+		Measure(size, YUVFormat::P010, "P010", hardwareThreads, frameCount);
+	}
+	return 0;
+}
\ No newline at end of file
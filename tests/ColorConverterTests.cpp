@@ -0,0 +1,246 @@
+#include "Test.h"
+#include "ColorConverter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+	//A BGRA image with padded rows and a deterministic pattern, so every channel value is covered.
+	struct SourceImage {
+		std::vector<uint8_t> Data;
+		int32_t Width;
+		int32_t Height;
+		int32_t Stride;
+		SourceImage(int32_t width, int32_t height, uint32_t seed) :
+			Data(static_cast<size_t>(width + 5) * 4 * height),
+			Width(width),
+			Height(height),
+			Stride((width + 5) * 4)
+		{
+			uint32_t state = seed;
+			for (uint8_t &value : Data) {
+				state = state * 1664525u + 1013904223u;
+				value = static_cast<uint8_t>(state >> 24);
+			}
+		}
+		const uint8_t *At(int32_t x, int32_t y) const { return Data.data() + static_cast<size_t>(y) * Stride + x * 4; }
+	};
+
+	struct ReferenceSample {
+		double Y;
+		double U;
+		double V;
+	};
+
+	/// <summary>
+	/// Converts one pixel, or the filtered chroma input, in double precision. The result is in code values of the output bit depth, before rounding.
+	/// </summary>
+	ReferenceSample ReferenceConvert(double b, double g, double r, YUVColorMatrix matrix, YUVRange range, int32_t bitDepth) {
+		const double kr = matrix == YUVColorMatrix::BT601 ? 0.299 : 0.2126;
+		const double kb = matrix == YUVColorMatrix::BT601 ? 0.114 : 0.0722;
+		const double kg = 1.0 - kr - kb;
+		const double scale = std::pow(2.0, bitDepth - 8);
+		const double y = (kr * r + kg * g + kb * b) / 255.0;
+		const double u = (b / 255.0 - y) / (2.0 * (1.0 - kb));
+		const double v = (r / 255.0 - y) / (2.0 * (1.0 - kr));
+		if (range == YUVRange::Limited) {
+			return ReferenceSample{ (16.0 + 219.0 * y) * scale, (128.0 + 224.0 * u) * scale, (128.0 + 224.0 * v) * scale };
+		}
+		const double max = std::pow(2.0, bitDepth) - 1.0;
+		return ReferenceSample{ y * max, 128.0 * scale + u * max, 128.0 * scale + v * max };
+	}
+
+	int32_t ReadSample(const uint8_t *pPlane, int32_t stride, int32_t x, int32_t y, bool isHighBitDepth) {
+		const uint8_t *pRow = pPlane + static_cast<size_t>(y) * stride;
+		return isHighBitDepth ? reinterpret_cast<const uint16_t *>(pRow)[x] >> 6 : pRow[x];
+	}
+
+	struct CONVERSION_ERROR {
+		//The largest difference to the reference, in code values.
+		double MaxError;
+		//Samples of P010 with any of the low 6 bits set.
+		int32_t InvalidSampleCount;
+	};
+
+	/// <summary>
+	/// Converts the image with the converter and compares every sample with the double precision reference.
+	/// The chroma is the reference conversion of the source filtered as documented in ChromaSiting, with the last column and row replicated.
+	/// </summary>
+	CONVERSION_ERROR MeasureError(const SourceImage &source, YUVFormat format, YUVColorMatrix matrix, YUVRange range, ChromaSiting siting) {
+		const bool isHighBitDepth = format == YUVFormat::P010;
+		const int32_t bitDepth = isHighBitDepth ? 10 : 8;
+		const int32_t bytesPerSample = isHighBitDepth ? 2 : 1;
+		//A padded stride, so the planes are not assumed to be contiguous.
+		const int32_t stride = (source.Width + 7) * bytesPerSample;
+		std::vector<uint8_t> buffer(ColorConverter::GetImageSize(format, source.Width + 7, source.Height) * 2);
+		YUV_PLANES planes = ColorConverter::GetPlanes(format, buffer.data(), source.Width, source.Height, stride);
+		ColorConverter converter;
+		converter.SetOptions(format, matrix, range, siting);
+		CONVERSION_ERROR result{};
+		if (!converter.Convert(source.Data.data(), source.Stride, source.Width, source.Height, planes)) {
+			result.MaxError = 1e9;
+			return result;
+		}
+		auto compare = [&](int32_t actual, double expected) {
+			const double max = std::pow(2.0, bitDepth) - 1.0;
+			result.MaxError = std::max(result.MaxError, std::abs(actual - std::min(std::max(expected, 0.0), max)));
+		};
+		auto countInvalid = [&](const uint8_t *pPlane, int32_t planeStride, int32_t x, int32_t y) {
+			if (isHighBitDepth && (reinterpret_cast<const uint16_t *>(pPlane + static_cast<size_t>(y) * planeStride)[x] & 0x3F) != 0) {
+				result.InvalidSampleCount++;
+			}
+		};
+		for (int32_t y = 0; y < source.Height; y++) {
+			for (int32_t x = 0; x < source.Width; x++) {
+				const uint8_t *pPixel = source.At(x, y);
+				compare(ReadSample(planes.Data[0], planes.Stride[0], x, y, isHighBitDepth), ReferenceConvert(pPixel[0], pPixel[1], pPixel[2], matrix, range, bitDepth).Y);
+				countInvalid(planes.Data[0], planes.Stride[0], x, y);
+			}
+		}
+		for (int32_t j = 0; j < (source.Height + 1) / 2; j++) {
+			for (int32_t i = 0; i < (source.Width + 1) / 2; i++) {
+				const int32_t x = i * 2;
+				const int32_t rows[2] = { j * 2, std::min(j * 2 + 1, source.Height - 1) };
+				double sum[3] = { 0, 0, 0 };
+				double weightSum = 0;
+				for (int32_t row : rows) {
+					//Left sited chroma is filtered with [1 2 1] around the even column, centered chroma with [1 1] over the even and odd column.
+					const int32_t columns[3] = { std::max(x - 1, 0), x, std::min(x + 1, source.Width - 1) };
+					const double weights[3] = { siting == ChromaSiting::Left ? 1.0 : 0.0, siting == ChromaSiting::Left ? 2.0 : 1.0, 1.0 };
+					for (int k = 0; k < 3; k++) {
+						for (int channel = 0; channel < 3; channel++) {
+							sum[channel] += weights[k] * source.At(columns[k], row)[channel];
+						}
+						weightSum += weights[k];
+					}
+				}
+				ReferenceSample expected = ReferenceConvert(sum[0] / weightSum, sum[1] / weightSum, sum[2] / weightSum, matrix, range, bitDepth);
+				int32_t u, v;
+				if (format == YUVFormat::I420) {
+					u = ReadSample(planes.Data[1], planes.Stride[1], i, j, false);
+					v = ReadSample(planes.Data[2], planes.Stride[2], i, j, false);
+				}
+				else {
+					u = ReadSample(planes.Data[1], planes.Stride[1], i * 2, j, isHighBitDepth);
+					v = ReadSample(planes.Data[1], planes.Stride[1], i * 2 + 1, j, isHighBitDepth);
+					countInvalid(planes.Data[1], planes.Stride[1], i * 2, j);
+					countInvalid(planes.Data[1], planes.Stride[1], i * 2 + 1, j);
+				}
+				compare(u, expected.U);
+				compare(v, expected.V);
+			}
+		}
+		return result;
+	}
+
+	//The fixed point coefficients and the final rounding keep each sample within one code value of the exact result.
+	const double MAX_ERROR = 1.0;
+}
+
+TEST(NV12MatchesReference)
+{
+	//Odd sizes, and a width that is not a multiple of the SIMD block, cover the replicated column and row and the scalar tail.
+	SourceImage source(37, 21, 1);
+	CONVERSION_ERROR error = MeasureError(source, YUVFormat::NV12, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+	CHECK(error.MaxError <= MAX_ERROR);
+}
+
+TEST(NV12CenteredMatchesReference)
+{
+	SourceImage source(64, 16, 2);
+	CONVERSION_ERROR error = MeasureError(source, YUVFormat::NV12, YUVColorMatrix::BT601, YUVRange::Limited, ChromaSiting::Center);
+	CHECK(error.MaxError <= MAX_ERROR);
+}
+
+TEST(I420FullRangeMatchesReference)
+{
+	SourceImage source(33, 17, 3);
+	CHECK(MeasureError(source, YUVFormat::I420, YUVColorMatrix::BT709, YUVRange::Full, ChromaSiting::Left).MaxError <= MAX_ERROR);
+	CHECK(MeasureError(source, YUVFormat::I420, YUVColorMatrix::BT601, YUVRange::Full, ChromaSiting::Center).MaxError <= MAX_ERROR);
+}
+
+TEST(P010MatchesReference)
+{
+	SourceImage source(45, 13, 4);
+	CONVERSION_ERROR limited = MeasureError(source, YUVFormat::P010, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+	CHECK(limited.MaxError <= MAX_ERROR);
+	CHECK_EQUAL(0, limited.InvalidSampleCount);
+	CONVERSION_ERROR full = MeasureError(source, YUVFormat::P010, YUVColorMatrix::BT601, YUVRange::Full, ChromaSiting::Center);
+	CHECK(full.MaxError <= MAX_ERROR);
+	CHECK_EQUAL(0, full.InvalidSampleCount);
+}
+
+TEST(AllWidthsMatchReference)
+{
+	//Every width up to a few SIMD blocks, so the blocks meet the first sample and the scalar tail at each offset.
+	const YUVFormat formats[3] = { YUVFormat::NV12, YUVFormat::I420, YUVFormat::P010 };
+	for (int32_t width = 1; width <= 40; width++) {
+		SourceImage source(width, 3, static_cast<uint32_t>(width));
+		for (YUVFormat format : formats) {
+			CHECK(MeasureError(source, format, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left).MaxError <= MAX_ERROR);
+			CHECK(MeasureError(source, format, YUVColorMatrix::BT601, YUVRange::Full, ChromaSiting::Center).MaxError <= MAX_ERROR);
+		}
+	}
+}
+
+TEST(PrimaryColorsHaveExactLevels)
+{
+	//White, black, and the BT.709 limited range levels of pure red, green and blue.
+	const uint8_t colors[5][4] = { { 255, 255, 255, 255 }, { 0, 0, 0, 255 }, { 0, 0, 255, 255 }, { 0, 255, 0, 255 }, { 255, 0, 0, 255 } };
+	const int32_t expected[5][3] = { { 235, 128, 128 }, { 16, 128, 128 }, { 63, 102, 240 }, { 173, 42, 26 }, { 32, 240, 118 } };
+	ColorConverter converter;
+	converter.SetOptions(YUVFormat::NV12, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+	for (int i = 0; i < 5; i++) {
+		std::vector<uint8_t> source(2 * 2 * 4);
+		for (size_t pixel = 0; pixel < 4; pixel++) {
+			std::copy(colors[i], colors[i] + 4, source.begin() + pixel * 4);
+		}
+		size_t size = 0;
+		const uint8_t *pImage = converter.Convert(source.data(), 8, 2, 2, &size);
+		CHECK_EQUAL(static_cast<size_t>(6), size);
+		if (!pImage) {
+			continue;
+		}
+		CHECK_EQUAL(expected[i][0], pImage[0]);
+		CHECK_EQUAL(expected[i][0], pImage[3]);
+		CHECK_EQUAL(expected[i][1], pImage[4]);
+		CHECK_EQUAL(expected[i][2], pImage[5]);
+	}
+}
+
+TEST(MultithreadedConversionMatchesSingleThreaded)
+{
+	//Large enough to be split into bands.
+	SourceImage source(1280, 722, 5);
+	ColorConverter singleThreaded;
+	singleThreaded.SetThreadCount(1);
+	ColorConverter multithreaded;
+	multithreaded.SetThreadCount(4);
+	size_t singleSize = 0;
+	size_t multiSize = 0;
+	const uint8_t *pSingle = singleThreaded.Convert(source.Data.data(), source.Stride, source.Width, source.Height, &singleSize);
+	for (int run = 0; run < 3; run++) {
+		const uint8_t *pMulti = multithreaded.Convert(source.Data.data(), source.Stride, source.Width, source.Height, &multiSize);
+		CHECK(pSingle && pMulti);
+		CHECK_EQUAL(ColorConverter::GetImageSize(YUVFormat::NV12, source.Width, source.Height), multiSize);
+		CHECK(pSingle && pMulti && singleSize == multiSize && std::equal(pSingle, pSingle + singleSize, pMulti));
+	}
+}
+
+TEST(InvalidArgumentsAreRejected)
+{
+	std::vector<uint8_t> source(16 * 4 * 4);
+	std::vector<uint8_t> buffer(ColorConverter::GetImageSize(YUVFormat::NV12, 16, 4));
+	ColorConverter converter;
+	YUV_PLANES planes = ColorConverter::GetPlanes(YUVFormat::NV12, buffer.data(), 16, 4, 16);
+	CHECK(converter.Convert(source.data(), 64, 16, 4, planes));
+	CHECK(!converter.Convert(nullptr, 64, 16, 4, planes));
+	CHECK(!converter.Convert(source.data(), 60, 16, 4, planes));
+	CHECK(!converter.Convert(source.data(), 64, 0, 4, planes));
+	YUV_PLANES narrow = planes;
+	narrow.Stride[0] = 8;
+	CHECK(!converter.Convert(source.data(), 64, 16, 4, narrow));
+	size_t size = 1;
+	CHECK(converter.Convert(source.data(), 64, 16, 0, &size) == nullptr);
+	CHECK_EQUAL(static_cast<size_t>(0), size);
+}
\ No newline at end of file
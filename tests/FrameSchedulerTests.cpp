@@ -0,0 +1,288 @@
+#include "Test.h"
+#include "FrameScheduler.h"
+
+namespace {
+	const int64_t HUNDRED_NANOS_PER_SECOND = 10000000;
+
+	//A clock that only moves when a test sets it.
+	class ManualClock : public FrameSchedulerClock
+	{
+	public:
+		int64_t Time = 0;
+		virtual int64_t GetTime() override { return Time; }
+	};
+
+	//The start of a slot at 30 fps, relative to the start of the schedule.
+	int64_t Slot30(uint64_t slotIndex) {
+		return static_cast<int64_t>(slotIndex * HUNDRED_NANOS_PER_SECOND / 30);
+	}
+
+	//Schedules a frame at 30 fps, and then one 3.5 slots later, so slots 1 and 2 are missed.
+	FRAME_SCHEDULE ScheduleLateFrame(FrameScheduler &scheduler, ManualClock &clock, FrameSchedulePolicy policy) {
+		clock.Time = 5000;
+		scheduler.Start(1, 30, policy);
+		scheduler.ScheduleFrame();
+		clock.Time = 5000 + Slot30(3) + Slot30(1) / 2;
+		return scheduler.ScheduleFrame();
+	}
+}
+
+TEST(RationalPeriodDoesNotDrift)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	//29.97 fps. After 30000 frames, exactly 1001 seconds have passed.
+	scheduler.Start(1001, 30000, FrameSchedulePolicy::StretchDuration);
+	int64_t end = 0;
+	for (uint64_t i = 0; i < 30000; i++) {
+		const int64_t expected = static_cast<int64_t>(i * 1001 * HUNDRED_NANOS_PER_SECOND / 30000);
+		clock->Time = expected;
+		FRAME_SCHEDULE schedule = scheduler.ScheduleFrame();
+		CHECK_EQUAL(i, schedule.SlotIndex);
+		CHECK_EQUAL(expected, schedule.Timestamp);
+		CHECK_EQUAL(end, schedule.Timestamp);
+		CHECK_EQUAL(0, schedule.SchedulingError);
+		end = schedule.Timestamp + schedule.Duration;
+	}
+	CHECK_EQUAL(1001 * HUNDRED_NANOS_PER_SECOND, end);
+	CHECK_EQUAL(30000u, scheduler.GetFrameCount());
+	CHECK_EQUAL(0u, scheduler.GetDroppedSlotCount() + scheduler.GetDuplicatedFrameCount() + scheduler.GetElidedSlotCount());
+}
+
+TEST(DropSkipsMissedSlots)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	FRAME_SCHEDULE schedule = ScheduleLateFrame(scheduler, *clock, FrameSchedulePolicy::Drop);
+	CHECK_EQUAL(3u, schedule.SlotIndex);
+	CHECK_EQUAL(1u, schedule.RepeatCount);
+	CHECK_EQUAL(Slot30(3), schedule.Timestamp);
+	CHECK_EQUAL(Slot30(4) - Slot30(3), schedule.Duration);
+	CHECK_EQUAL(2u, schedule.DroppedSlotCount);
+	//The audio of the dropped slots is still due with this frame.
+	CHECK_EQUAL(Slot30(1), schedule.IntervalStart);
+	CHECK_EQUAL(Slot30(3) + Slot30(1) / 2 - Slot30(1), schedule.SchedulingError);
+	CHECK_EQUAL(2u, scheduler.GetDroppedSlotCount());
+}
+
+TEST(DuplicateFillsMissedSlots)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	FRAME_SCHEDULE schedule = ScheduleLateFrame(scheduler, *clock, FrameSchedulePolicy::Duplicate);
+	CHECK_EQUAL(1u, schedule.SlotIndex);
+	CHECK_EQUAL(3u, schedule.RepeatCount);
+	CHECK_EQUAL(Slot30(1), schedule.Timestamp);
+	CHECK_EQUAL(Slot30(4) - Slot30(1), schedule.Duration);
+	CHECK_EQUAL(0u, schedule.DroppedSlotCount);
+	CHECK_EQUAL(2u, scheduler.GetDuplicatedFrameCount());
+
+	//With a limit, the last write is stretched over the slots beyond it.
+	scheduler.SetMaxRepeatCount(2);
+	schedule = ScheduleLateFrame(scheduler, *clock, FrameSchedulePolicy::Duplicate);
+	CHECK_EQUAL(2u, schedule.RepeatCount);
+	CHECK_EQUAL(Slot30(1), schedule.Timestamp);
+	CHECK_EQUAL(Slot30(4) - Slot30(1), schedule.Duration);
+	CHECK_EQUAL(1u, scheduler.GetDuplicatedFrameCount());
+}
+
+TEST(StretchCoversMissedSlots)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	CHECK(scheduler.GetPolicy() == FrameSchedulePolicy::StretchDuration);
+	FRAME_SCHEDULE schedule = ScheduleLateFrame(scheduler, *clock, FrameSchedulePolicy::StretchDuration);
+	CHECK_EQUAL(1u, schedule.SlotIndex);
+	CHECK_EQUAL(1u, schedule.RepeatCount);
+	CHECK_EQUAL(Slot30(1), schedule.Timestamp);
+	CHECK_EQUAL(Slot30(4) - Slot30(1), schedule.Duration);
+	CHECK_EQUAL(0u, scheduler.GetDroppedSlotCount() + scheduler.GetDuplicatedFrameCount());
+	//The next frame is due in the slot after the stretched frame.
+	clock->Time = 5000 + Slot30(4);
+	schedule = scheduler.ScheduleFrame();
+	CHECK_EQUAL(4u, schedule.SlotIndex);
+	CHECK_EQUAL(0, schedule.SchedulingError);
+}
+
+TEST(EarlyFrameWaitsForNextSlot)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	scheduler.ScheduleFrame();
+	clock->Time = 100000;
+	CHECK_EQUAL(Slot30(1) - 100000, scheduler.GetTimeUntilNextDeadline());
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame();
+	CHECK_EQUAL(1u, schedule.SlotIndex);
+	CHECK_EQUAL(Slot30(1), schedule.Timestamp);
+	CHECK_EQUAL(100000 - Slot30(1), schedule.SchedulingError);
+	CHECK_EQUAL(0u, schedule.DroppedSlotCount);
+	clock->Time = Slot30(5);
+	CHECK_EQUAL(0, scheduler.GetTimeUntilNextDeadline());
+}
+
+TEST(TimelineIsContinuous)
+{
+	//With every policy, each frame's interval starts where the previous frame ended, so the audio can be written without gaps.
+	const FrameSchedulePolicy policies[] = { FrameSchedulePolicy::Drop, FrameSchedulePolicy::Duplicate, FrameSchedulePolicy::StretchDuration };
+	for (FrameSchedulePolicy policy : policies) {
+		auto clock = std::make_shared<ManualClock>();
+		FrameScheduler scheduler(clock);
+		scheduler.Start(1001, 60000, policy);
+		int64_t end = 0;
+		uint32_t state = 1;
+		for (int i = 0; i < 1000; i++) {
+			state = state * 1664525u + 1013904223u;
+			//Mostly on time, sometimes several slots late.
+			clock->Time += (state >> 28) == 0 ? 800000 : 150000 + (state >> 8) % 40000;
+			FRAME_SCHEDULE schedule = scheduler.ScheduleFrame();
+			CHECK_EQUAL(end, schedule.IntervalStart);
+			CHECK(schedule.Timestamp >= schedule.IntervalStart);
+			CHECK(schedule.Duration > 0);
+			end = schedule.Timestamp + schedule.Duration;
+		}
+		//The schedule kept up with the clock, and is at most one slot ahead of it, plus the slot of an early frame.
+		CHECK(end > clock->Time);
+		CHECK(end <= clock->Time + 2 * scheduler.GetSlotTimestamp(1));
+	}
+}
+
+TEST(SetPeriodKeepsTimestampsContinuous)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	for (uint64_t i = 0; i < 3; i++) {
+		clock->Time = Slot30(i);
+		scheduler.ScheduleFrame();
+	}
+	scheduler.SetPeriod(1, 15);
+	CHECK_EQUAL(Slot30(3), scheduler.GetSlotTimestamp(0));
+	CHECK_EQUAL(Slot30(3) + HUNDRED_NANOS_PER_SECOND / 15, scheduler.GetSlotTimestamp(1));
+	clock->Time = Slot30(3);
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame();
+	CHECK_EQUAL(0u, schedule.SlotIndex);
+	CHECK_EQUAL(Slot30(3), schedule.Timestamp);
+	CHECK_EQUAL(HUNDRED_NANOS_PER_SECOND / 15, schedule.Duration);
+	CHECK_EQUAL(0, schedule.SchedulingError);
+}
+
+TEST(LatenessIsRecorded)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	scheduler.ScheduleFrame();
+	//5 ms late for slot 1.
+	clock->Time = Slot30(1) + 50000;
+	scheduler.ScheduleFrame();
+	METRIC_HISTOGRAM_VALUE lateness = scheduler.GetLateness();
+	CHECK_EQUAL(2u, lateness.Count);
+	CHECK_EQUAL(0u, lateness.Min);
+	CHECK_EQUAL(5000u, lateness.Max);
+
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	CHECK_EQUAL(0u, scheduler.GetLateness().Count);
+	CHECK_EQUAL(0u, scheduler.GetFrameCount());
+}
+
+TEST(VariableFrameRateElidesIdleSlots)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	scheduler.SetKeepAlivePeriod(1, 2);
+	CHECK(scheduler.IsVariableFrameRate());
+	scheduler.ScheduleFrame();
+	//The content changes halfway through slot 2. The frame is placed in that slot, and slot 1 is elided.
+	clock->Time = Slot30(2) + Slot30(1) / 2;
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame(true);
+	CHECK_EQUAL(2u, schedule.SlotIndex);
+	CHECK_EQUAL(Slot30(2), schedule.Timestamp);
+	CHECK_EQUAL(Slot30(3) - Slot30(2), schedule.Duration);
+	CHECK_EQUAL(1u, schedule.ElidedSlotCount);
+	CHECK_EQUAL(0u, schedule.DroppedSlotCount);
+	CHECK(!schedule.IsKeepAlive);
+	//The audio of the elided slot is written with the frame.
+	CHECK_EQUAL(Slot30(1), schedule.IntervalStart);
+	CHECK_EQUAL(Slot30(1) / 2, schedule.SchedulingError);
+	CHECK_EQUAL(1u, scheduler.GetElidedSlotCount());
+	CHECK_EQUAL(0u, scheduler.GetDroppedSlotCount());
+}
+
+TEST(VariableFrameRateIsLimitedToFramerate)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	scheduler.SetKeepAlivePeriod(1, 2);
+	scheduler.ScheduleFrame();
+	//A second change within the slot of the first frame goes to the next slot.
+	clock->Time = Slot30(1) / 2;
+	CHECK_EQUAL(Slot30(1) - Slot30(1) / 2, scheduler.GetTimeUntilNextDeadline());
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame(true);
+	CHECK_EQUAL(1u, schedule.SlotIndex);
+	CHECK_EQUAL(Slot30(1), schedule.Timestamp);
+	CHECK_EQUAL(0u, schedule.ElidedSlotCount);
+}
+
+TEST(VariableFrameRateKeepsAlive)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	scheduler.SetKeepAlivePeriod(1, 2);
+	//Before the first frame, the keep-alive period counts from the start.
+	CHECK_EQUAL(HUNDRED_NANOS_PER_SECOND / 2, scheduler.GetTimeUntilKeepAlive());
+	clock->Time = Slot30(3);
+	scheduler.ScheduleFrame(true);
+	//Half a second after slot 3 is the start of slot 18.
+	clock->Time = Slot30(5);
+	CHECK_EQUAL(Slot30(18) - Slot30(5), scheduler.GetTimeUntilKeepAlive());
+	CHECK_EQUAL(0, scheduler.GetTimeUntilNextDeadline());
+	clock->Time = Slot30(18);
+	CHECK_EQUAL(0, scheduler.GetTimeUntilKeepAlive());
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame(false);
+	CHECK(schedule.IsKeepAlive);
+	CHECK_EQUAL(18u, schedule.SlotIndex);
+	CHECK_EQUAL(14u, schedule.ElidedSlotCount);
+	CHECK_EQUAL(Slot30(4), schedule.IntervalStart);
+	CHECK_EQUAL(1u, scheduler.GetKeepAliveFrameCount());
+	CHECK_EQUAL(2u, scheduler.GetFrameCount());
+}
+
+TEST(KeepAliveIsDueOnSlotBoundary)
+{
+	//At 29.97 fps, half a second is not a whole number of slots, so the keep-alive frame is due in the first slot after it.
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1001, 30000, FrameSchedulePolicy::Drop);
+	scheduler.SetKeepAlivePeriod(1, 2);
+	scheduler.ScheduleFrame(true);
+	const int64_t keepAliveTime = scheduler.GetTimeUntilKeepAlive();
+	CHECK_EQUAL(scheduler.GetSlotTimestamp(15), keepAliveTime);
+	CHECK(scheduler.GetSlotTimestamp(14) < HUNDRED_NANOS_PER_SECOND / 2);
+	CHECK(keepAliveTime >= HUNDRED_NANOS_PER_SECOND / 2);
+}
+
+TEST(FixedFrameRateHasNoKeepAlive)
+{
+	auto clock = std::make_shared<ManualClock>();
+	FrameScheduler scheduler(clock);
+	scheduler.Start(1, 30, FrameSchedulePolicy::Drop);
+	CHECK(!scheduler.IsVariableFrameRate());
+	scheduler.ScheduleFrame();
+	clock->Time = 1000;
+	CHECK_EQUAL(scheduler.GetTimeUntilNextDeadline(), scheduler.GetTimeUntilKeepAlive());
+	//Unchanged content is still scheduled in every slot, and missed slots are dropped rather than elided.
+	clock->Time = Slot30(3);
+	FRAME_SCHEDULE schedule = scheduler.ScheduleFrame(false);
+	CHECK(!schedule.IsKeepAlive);
+	CHECK_EQUAL(2u, schedule.DroppedSlotCount);
+	CHECK_EQUAL(0u, schedule.ElidedSlotCount);
+	//A numerator of 0 turns the variable frame rate off again.
+	scheduler.SetKeepAlivePeriod(1, 2);
+	CHECK(scheduler.IsVariableFrameRate());
+	scheduler.SetKeepAlivePeriod(0, 1);
+	CHECK(!scheduler.IsVariableFrameRate());
+}
\ No newline at end of file
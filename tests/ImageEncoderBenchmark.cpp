@@ -0,0 +1,151 @@
+#include "ImageEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Measures the encode time and size of the built-in image encoders on generated screen content, and how the PNG encode time of a large canvas scales with threads.
+// The WIC encoders used by default on Windows are not included, as WIC is not available on other platforms.
+// Usage: ImageEncoderBenchmark [encodes per measurement]
+
+namespace {
+	struct FIXTURE {
+		std::string Name;
+		int32_t Width;
+		int32_t Height;
+		std::vector<uint8_t> Pixels;
+	};
+
+	FIXTURE CreateFixture(const std::string &name, int32_t width, int32_t height, uint32_t(*pixel)(int32_t x, int32_t y, uint32_t &state)) {
+		FIXTURE fixture{ name, width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4) };
+		uint32_t state = 1;
+		for (int32_t y = 0; y < height; y++) {
+			for (int32_t x = 0; x < width; x++) {
+				const uint32_t rgb = pixel(x, y, state);
+				uint8_t *pPixel = &fixture.Pixels[(static_cast<size_t>(y) * width + x) * 4];
+				pPixel[0] = static_cast<uint8_t>(rgb);
+				pPixel[1] = static_cast<uint8_t>(rgb >> 8);
+				pPixel[2] = static_cast<uint8_t>(rgb >> 16);
+				pPixel[3] = 255;
+			}
+		}
+		return fixture;
+	}
+
+	uint32_t NextRandom(uint32_t &state) {
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	//A desktop with a task bar, window frames, and rows of text on flat backgrounds.
+	uint32_t DesktopPixel(int32_t x, int32_t y, uint32_t &state) {
+		if (y >= 1040) {
+			return 0x1F1F1F;
+		}
+		const bool isWindow = x >= 200 && x < 1400 && y >= 100 && y < 900;
+		if (!isWindow) {
+			return 0x2D5F8B + (y / 8);
+		}
+		if (y < 132) {
+			return 0xF3F3F3;
+		}
+		//Glyphs of 7x12 pixels in lines of 18 pixels, with anti-aliased edges.
+		if ((y - 132) % 18 < 12 && (x / 7 + (y - 132) / 18) % 9 != 0) {
+			const uint32_t value = NextRandom(state) & 0xFF;
+			return value < 160 ? 0xFFFFFF : 0x010101 * (255 - value);
+		}
+		return 0xFFFFFF;
+	}
+
+	//A code editor with dark theme and colored text.
+	uint32_t EditorPixel(int32_t x, int32_t y, uint32_t &state) {
+		static const uint32_t colors[] = { 0xD4D4D4, 0x569CD6, 0xCE9178, 0x6A9955, 0xDCDCAA };
+		if (x < 48) {
+			return 0x1E1E1E;
+		}
+		if (y % 19 < 14 && ((x - 48) / 8 + y / 19 * 7) % 13 < 10 && (NextRandom(state) & 3) != 0) {
+			return colors[(x / 64 + y / 19) % 5];
+		}
+		return 0x1E1E1E;
+	}
+
+	//Smooth gradients, as in wallpapers and video.
+	uint32_t GradientPixel(int32_t x, int32_t y, uint32_t &state) {
+		const uint32_t noise = NextRandom(state) & 3;
+		return ((x * 255 / 1920 + noise) & 0xFF) << 16 | ((y * 255 / 1080) & 0xFF) << 8 | (((x + y) * 255 / 3000 + noise) & 0xFF);
+	}
+
+	//Photographic content, which compresses poorly with every lossless format.
+	uint32_t PhotoPixel(int32_t x, int32_t y, uint32_t &state) {
+		const uint32_t base = ((x / 3) * 7 + (y / 3) * 13) & 0xFF;
+		const uint32_t noise = NextRandom(state) & 0x1F;
+		return ((base + noise) & 0xFF) << 16 | ((base * 2 + noise) & 0xFF) << 8 | ((255 - base + noise) & 0xFF);
+	}
+
+	//Three desktops side by side, as in a multi-monitor canvas.
+	uint32_t CanvasPixel(int32_t x, int32_t y, uint32_t &state) {
+		switch (x / 2560) {
+		case 0:
+			return DesktopPixel(x % 1920, y % 1080, state);
+		case 1:
+			return EditorPixel(x % 2560, y, state);
+		default:
+			return GradientPixel(x % 1920, y % 1080, state);
+		}
+	}
+
+	void Measure(ImageEncoder &encoder, ImageEncoderFormat format, const char *formatName, const FIXTURE &fixture, int encodeCount) {
+		//The output is copied to memory, as it would be to a stream, so the formats that are mostly copying are measured too.
+		std::vector<uint8_t> output;
+		auto write = [&](const uint8_t *pData, size_t length) {
+			output.insert(output.end(), pData, pData + length);
+			return true;
+		};
+		encoder.Encode(format, fixture.Pixels.data(), fixture.Width * 4, fixture.Width, fixture.Height, write);
+		const size_t size = output.size();
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < encodeCount; i++) {
+			output.clear();
+			encoder.Encode(format, fixture.Pixels.data(), fixture.Width * 4, fixture.Width, fixture.Height, write);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const double milliseconds = seconds * 1000.0 / encodeCount;
+		const double rawSize = static_cast<double>(fixture.Width) * fixture.Height * 3;
+		std::printf("%-9s %-4s %9.2f ms %11zu bytes %6.1f%% of RGB %8.1f Mpixel/s\n", fixture.Name.c_str(), formatName, milliseconds, size,
+			size * 100.0 / rawSize, static_cast<double>(fixture.Width) * fixture.Height / (seconds / encodeCount) / 1e6);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const int encodeCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+	const FIXTURE fixtures[] = {
+		CreateFixture("desktop", 1920, 1080, DesktopPixel),
+		CreateFixture("editor", 1920, 1080, EditorPixel),
+		CreateFixture("gradient", 1920, 1080, GradientPixel),
+		CreateFixture("photo", 1920, 1080, PhotoPixel)
+	};
+	ImageEncoder encoder;
+	for (const FIXTURE &fixture : fixtures) {
+		Measure(encoder, ImageEncoderFormat::PNG, "PNG", fixture, encodeCount);
+		Measure(encoder, ImageEncoderFormat::QOI, "QOI", fixture, encodeCount);
+		Measure(encoder, ImageEncoderFormat::BMP, "BMP", fixture, encodeCount);
+	}
+
+	const FIXTURE canvas = CreateFixture("canvas", 7680, 2160, CanvasPixel);
+	const uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::printf("\nPNG of a %dx%d canvas with %u hardware threads\n", canvas.Width, canvas.Height, hardwareThreads);
+	for (uint32_t threadCount = 1; ; threadCount = std::min(threadCount * 2, hardwareThreads)) {
+		ImageEncoder threadedEncoder;
+		threadedEncoder.SetThreadCount(threadCount);
+		std::printf("%2u threads: ", threadCount);
+		Measure(threadedEncoder, ImageEncoderFormat::PNG, "PNG", canvas, encodeCount);
+		if (threadCount == hardwareThreads) {
+			break;
+		}
+	}
+	return 0;
+}
\ No newline at end of file
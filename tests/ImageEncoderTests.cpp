@@ -0,0 +1,688 @@
+#include "Test.h"
+#include "ImageEncoder.h"
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+	/// <summary>
+	/// A minimal inflater (RFC 1951), written after zlib's puff.c, so the encoded images can be decoded without other dependencies.
+	/// </summary>
+	class Inflater
+	{
+	public:
+		Inflater(const uint8_t *pData, size_t size) :
+			m_Data(pData),
+			m_Size(size),
+			m_Position(0),
+			m_BitBuffer(0),
+			m_BitCount(0),
+			m_IsError(false)
+		{
+		}
+		bool Inflate(std::vector<uint8_t> &output) {
+			bool isLast = false;
+			while (!isLast && !m_IsError) {
+				isLast = Bits(1) == 1;
+				const int type = Bits(2);
+				bool isValid = false;
+				if (type == 0) {
+					isValid = Stored(output);
+				}
+				else if (type == 1) {
+					isValid = Fixed(output);
+				}
+				else if (type == 2) {
+					isValid = Dynamic(output);
+				}
+				if (!isValid) {
+					return false;
+				}
+			}
+			return !m_IsError;
+		}
+		//The number of bytes read, including the partial last byte.
+		size_t GetPosition() const { return m_Position; }
+	private:
+		struct HUFFMAN {
+			uint16_t Count[16];
+			uint16_t Symbol[320];
+		};
+
+		int Bits(int count) {
+			uint32_t value = m_BitBuffer;
+			while (m_BitCount < count) {
+				if (m_Position >= m_Size) {
+					m_IsError = true;
+					return 0;
+				}
+				value |= static_cast<uint32_t>(m_Data[m_Position++]) << m_BitCount;
+				m_BitCount += 8;
+			}
+			m_BitBuffer = value >> count;
+			m_BitCount -= count;
+			return static_cast<int>(value & ((1u << count) - 1));
+		}
+		bool Stored(std::vector<uint8_t> &output) {
+			m_BitBuffer = 0;
+			m_BitCount = 0;
+			if (m_Position + 4 > m_Size) {
+				return false;
+			}
+			const uint32_t length = m_Data[m_Position] | (m_Data[m_Position + 1] << 8);
+			const uint32_t complement = m_Data[m_Position + 2] | (m_Data[m_Position + 3] << 8);
+			m_Position += 4;
+			if (length != (~complement & 0xFFFF) || m_Position + length > m_Size) {
+				return false;
+			}
+			output.insert(output.end(), m_Data + m_Position, m_Data + m_Position + length);
+			m_Position += length;
+			return true;
+		}
+		int Decode(const HUFFMAN &huffman) {
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int length = 1; length < 16; length++) {
+				code |= Bits(1);
+				const int count = huffman.Count[length];
+				if (code - count < first) {
+					return huffman.Symbol[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			return -1;
+		}
+		static bool Build(HUFFMAN &huffman, const uint16_t *pLengths, int count) {
+			std::fill(std::begin(huffman.Count), std::end(huffman.Count), static_cast<uint16_t>(0));
+			for (int symbol = 0; symbol < count; symbol++) {
+				huffman.Count[pLengths[symbol]]++;
+			}
+			int left = 1;
+			for (int length = 1; length < 16; length++) {
+				left <<= 1;
+				left -= huffman.Count[length];
+				if (left < 0) {
+					return false;
+				}
+			}
+			uint16_t offsets[16] = {};
+			for (int length = 1; length < 15; length++) {
+				offsets[length + 1] = offsets[length] + huffman.Count[length];
+			}
+			for (int symbol = 0; symbol < count; symbol++) {
+				if (pLengths[symbol] != 0) {
+					huffman.Symbol[offsets[pLengths[symbol]]++] = static_cast<uint16_t>(symbol);
+				}
+			}
+			return true;
+		}
+		bool Codes(std::vector<uint8_t> &output, const HUFFMAN &lengthCode, const HUFFMAN &distanceCode) {
+			static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static const uint16_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static const uint16_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+			while (true) {
+				int symbol = Decode(lengthCode);
+				if (symbol < 0 || m_IsError) {
+					return false;
+				}
+				if (symbol < 256) {
+					output.push_back(static_cast<uint8_t>(symbol));
+					continue;
+				}
+				if (symbol == 256) {
+					return true;
+				}
+				symbol -= 257;
+				if (symbol >= 29) {
+					return false;
+				}
+				const size_t length = lengthBase[symbol] + Bits(lengthExtra[symbol]);
+				const int distanceSymbol = Decode(distanceCode);
+				if (distanceSymbol < 0 || distanceSymbol >= 30) {
+					return false;
+				}
+				const size_t distance = distanceBase[distanceSymbol] + Bits(distanceExtra[distanceSymbol]);
+				if (distance > output.size() || m_IsError) {
+					return false;
+				}
+				for (size_t i = 0; i < length; i++) {
+					output.push_back(output[output.size() - distance]);
+				}
+			}
+		}
+		bool Fixed(std::vector<uint8_t> &output) {
+			uint16_t lengths[288 + 30];
+			std::fill(lengths, lengths + 144, static_cast<uint16_t>(8));
+			std::fill(lengths + 144, lengths + 256, static_cast<uint16_t>(9));
+			std::fill(lengths + 256, lengths + 280, static_cast<uint16_t>(7));
+			std::fill(lengths + 280, lengths + 288, static_cast<uint16_t>(8));
+			std::fill(lengths + 288, lengths + 318, static_cast<uint16_t>(5));
+			HUFFMAN lengthCode, distanceCode;
+			Build(lengthCode, lengths, 288);
+			Build(distanceCode, lengths + 288, 30);
+			return Codes(output, lengthCode, distanceCode);
+		}
+		bool Dynamic(std::vector<uint8_t> &output) {
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			const int lengthCount = Bits(5) + 257;
+			const int distanceCount = Bits(5) + 1;
+			const int codeCount = Bits(4) + 4;
+			if (lengthCount > 286 || distanceCount > 30) {
+				return false;
+			}
+			uint16_t lengths[320] = {};
+			for (int i = 0; i < codeCount; i++) {
+				lengths[order[i]] = static_cast<uint16_t>(Bits(3));
+			}
+			HUFFMAN lengthCode, distanceCode;
+			if (!Build(lengthCode, lengths, 19)) {
+				return false;
+			}
+			int index = 0;
+			while (index < lengthCount + distanceCount) {
+				int symbol = Decode(lengthCode);
+				if (symbol < 0 || m_IsError) {
+					return false;
+				}
+				if (symbol < 16) {
+					lengths[index++] = static_cast<uint16_t>(symbol);
+					continue;
+				}
+				uint16_t length = 0;
+				int repeat;
+				if (symbol == 16) {
+					if (index == 0) {
+						return false;
+					}
+					length = lengths[index - 1];
+					repeat = 3 + Bits(2);
+				}
+				else if (symbol == 17) {
+					repeat = 3 + Bits(3);
+				}
+				else {
+					repeat = 11 + Bits(7);
+				}
+				if (index + repeat > lengthCount + distanceCount) {
+					return false;
+				}
+				while (repeat-- > 0) {
+					lengths[index++] = length;
+				}
+			}
+			if (lengths[256] == 0 || !Build(lengthCode, lengths, lengthCount) || !Build(distanceCode, lengths + lengthCount, distanceCount)) {
+				return false;
+			}
+			return Codes(output, lengthCode, distanceCode);
+		}
+
+		const uint8_t *m_Data;
+		size_t m_Size;
+		size_t m_Position;
+		uint32_t m_BitBuffer;
+		int m_BitCount;
+		bool m_IsError;
+	};
+
+	uint32_t ReadBigEndian32(const uint8_t *pData) {
+		return (static_cast<uint32_t>(pData[0]) << 24) | (pData[1] << 16) | (pData[2] << 8) | pData[3];
+	}
+
+	uint32_t ReadLittleEndian32(const uint8_t *pData) {
+		return pData[0] | (pData[1] << 8) | (pData[2] << 16) | (static_cast<uint32_t>(pData[3]) << 24);
+	}
+
+	//Bitwise reference implementations, independent of the table driven ones in the encoder.
+	uint32_t ReferenceCrc32(const uint8_t *pData, size_t length) {
+		uint32_t crc = 0xFFFFFFFF;
+		for (size_t i = 0; i < length; i++) {
+			crc ^= pData[i];
+			for (int bit = 0; bit < 8; bit++) {
+				crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+			}
+		}
+		return ~crc;
+	}
+
+	uint32_t ReferenceAdler32(const uint8_t *pData, size_t length) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < length; i++) {
+			a = (a + pData[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	//An image decoded to RGB, for comparison with the source.
+	struct DECODED_IMAGE {
+		int32_t Width;
+		int32_t Height;
+		std::vector<uint8_t> Rgb;
+		int32_t IdatCount;
+	};
+
+	bool DecodePng(const std::vector<uint8_t> &file, DECODED_IMAGE &image) {
+		static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		if (file.size() < 8 || !std::equal(signature, signature + 8, file.begin())) {
+			return false;
+		}
+		std::vector<uint8_t> compressed;
+		image = DECODED_IMAGE{};
+		bool isEnded = false;
+		size_t position = 8;
+		while (!isEnded) {
+			if (position + 12 > file.size()) {
+				return false;
+			}
+			const uint32_t length = ReadBigEndian32(&file[position]);
+			if (position + 12 + length > file.size()) {
+				return false;
+			}
+			const uint8_t *pType = &file[position + 4];
+			const uint8_t *pData = pType + 4;
+			if (ReadBigEndian32(pData + length) != ReferenceCrc32(pType, length + 4)) {
+				return false;
+			}
+			const std::string type(reinterpret_cast<const char *>(pType), 4);
+			if (type == "IHDR") {
+				//8 bit RGB, without interlacing.
+				if (length != 13 || pData[8] != 8 || pData[9] != 2 || pData[10] != 0 || pData[11] != 0 || pData[12] != 0) {
+					return false;
+				}
+				image.Width = static_cast<int32_t>(ReadBigEndian32(pData));
+				image.Height = static_cast<int32_t>(ReadBigEndian32(pData + 4));
+			}
+			else if (type == "IDAT") {
+				compressed.insert(compressed.end(), pData, pData + length);
+				image.IdatCount++;
+			}
+			else if (type == "IEND") {
+				isEnded = true;
+			}
+			position += 12 + length;
+		}
+		if (position != file.size() || compressed.size() < 6 || image.Width <= 0 || image.Height <= 0) {
+			return false;
+		}
+		//zlib header with deflate, a 32K window and no preset dictionary.
+		if ((compressed[0] * 256 + compressed[1]) % 31 != 0 || compressed[0] != 0x78 || (compressed[1] & 0x20) != 0) {
+			return false;
+		}
+		std::vector<uint8_t> filtered;
+		Inflater inflater(compressed.data() + 2, compressed.size() - 2);
+		if (!inflater.Inflate(filtered) || inflater.GetPosition() + 2 + 4 != compressed.size()) {
+			return false;
+		}
+		if (ReadBigEndian32(&compressed[compressed.size() - 4]) != ReferenceAdler32(filtered.data(), filtered.size())) {
+			return false;
+		}
+		const size_t rowSize = static_cast<size_t>(image.Width) * 3;
+		if (filtered.size() != (rowSize + 1) * image.Height) {
+			return false;
+		}
+		image.Rgb.resize(rowSize * image.Height);
+		for (int32_t y = 0; y < image.Height; y++) {
+			const uint8_t filter = filtered[y * (rowSize + 1)];
+			const uint8_t *pIn = &filtered[y * (rowSize + 1) + 1];
+			uint8_t *pOut = &image.Rgb[y * rowSize];
+			const uint8_t *pUp = y > 0 ? pOut - rowSize : nullptr;
+			for (size_t i = 0; i < rowSize; i++) {
+				const int a = i >= 3 ? pOut[i - 3] : 0;
+				const int b = pUp ? pUp[i] : 0;
+				const int c = pUp && i >= 3 ? pUp[i - 3] : 0;
+				int predictor;
+				switch (filter) {
+				case 0: predictor = 0; break;
+				case 1: predictor = a; break;
+				case 2: predictor = b; break;
+				case 3: predictor = (a + b) / 2; break;
+				case 4: {
+					const int p = a + b - c;
+					const int pa = std::abs(p - a);
+					const int pb = std::abs(p - b);
+					const int pc = std::abs(p - c);
+					predictor = pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+					break;
+				}
+				default:
+					return false;
+				}
+				pOut[i] = static_cast<uint8_t>(pIn[i] + predictor);
+			}
+		}
+		return true;
+	}
+
+	//Decodes a QOI image as described in the specification at qoiformat.org.
+	bool DecodeQoi(const std::vector<uint8_t> &file, DECODED_IMAGE &image) {
+		if (file.size() < 14 + 8 || std::string(file.begin(), file.begin() + 4) != "qoif" || file[12] != 3) {
+			return false;
+		}
+		static const uint8_t end[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+		if (!std::equal(end, end + 8, file.end() - 8)) {
+			return false;
+		}
+		image = DECODED_IMAGE{};
+		image.Width = static_cast<int32_t>(ReadBigEndian32(&file[4]));
+		image.Height = static_cast<int32_t>(ReadBigEndian32(&file[8]));
+		const size_t pixelCount = static_cast<size_t>(image.Width) * image.Height;
+		uint8_t index[64][4] = {};
+		uint8_t pixel[4] = { 0, 0, 0, 255 };
+		size_t position = 14;
+		const size_t dataEnd = file.size() - 8;
+		int run = 0;
+		while (image.Rgb.size() < pixelCount * 3) {
+			if (run > 0) {
+				run--;
+			}
+			else {
+				if (position >= dataEnd) {
+					return false;
+				}
+				const uint8_t op = file[position++];
+				if (op == 0xFE) {
+					if (position + 3 > dataEnd) {
+						return false;
+					}
+					pixel[0] = file[position];
+					pixel[1] = file[position + 1];
+					pixel[2] = file[position + 2];
+					position += 3;
+				}
+				else if (op == 0xFF) {
+					return false;
+				}
+				else if ((op & 0xC0) == 0x00) {
+					std::copy(index[op], index[op] + 4, pixel);
+				}
+				else if ((op & 0xC0) == 0x40) {
+					pixel[0] += ((op >> 4) & 3) - 2;
+					pixel[1] += ((op >> 2) & 3) - 2;
+					pixel[2] += (op & 3) - 2;
+				}
+				else if ((op & 0xC0) == 0x80) {
+					if (position >= dataEnd) {
+						return false;
+					}
+					const int dg = (op & 0x3F) - 32;
+					const uint8_t next = file[position++];
+					pixel[0] += dg - 8 + ((next >> 4) & 0x0F);
+					pixel[1] += dg;
+					pixel[2] += dg - 8 + (next & 0x0F);
+				}
+				else {
+					run = op & 0x3F;
+				}
+				const int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+				std::copy(pixel, pixel + 4, index[hash]);
+			}
+			image.Rgb.insert(image.Rgb.end(), pixel, pixel + 3);
+		}
+		return position == dataEnd && run == 0;
+	}
+
+	bool DecodeBmp(const std::vector<uint8_t> &file, DECODED_IMAGE &image) {
+		if (file.size() < 54 || file[0] != 'B' || file[1] != 'M' || ReadLittleEndian32(&file[2]) != file.size()) {
+			return false;
+		}
+		const uint32_t offset = ReadLittleEndian32(&file[10]);
+		image = DECODED_IMAGE{};
+		image.Width = static_cast<int32_t>(ReadLittleEndian32(&file[18]));
+		//Top-down rows have a negative height.
+		image.Height = -static_cast<int32_t>(ReadLittleEndian32(&file[22]));
+		const uint16_t bitCount = static_cast<uint16_t>(file[28] | (file[29] << 8));
+		if (bitCount != 32 || image.Width <= 0 || image.Height <= 0 || offset + static_cast<size_t>(image.Width) * image.Height * 4 != file.size()) {
+			return false;
+		}
+		for (size_t i = offset; i < file.size(); i += 4) {
+			image.Rgb.push_back(file[i + 2]);
+			image.Rgb.push_back(file[i + 1]);
+			image.Rgb.push_back(file[i]);
+		}
+		return true;
+	}
+
+	//A BGRA image with padded rows.
+	struct SourceImage {
+		std::vector<uint8_t> Data;
+		int32_t Width;
+		int32_t Height;
+		int32_t Stride;
+		SourceImage(int32_t width, int32_t height, int32_t padding = 3) :
+			Data(static_cast<size_t>(width + padding) * 4 * height, 0xCD),
+			Width(width),
+			Height(height),
+			Stride((width + padding) * 4)
+		{
+		}
+		uint8_t *At(int32_t x, int32_t y) { return Data.data() + static_cast<size_t>(y) * Stride + x * 4; }
+		void Set(int32_t x, int32_t y, uint32_t rgb) {
+			uint8_t *pPixel = At(x, y);
+			pPixel[0] = static_cast<uint8_t>(rgb);
+			pPixel[1] = static_cast<uint8_t>(rgb >> 8);
+			pPixel[2] = static_cast<uint8_t>(rgb >> 16);
+			//The alpha channel is discarded, so it is set to a value that would show if it were not.
+			pPixel[3] = static_cast<uint8_t>(x * 7 + y);
+		}
+		std::vector<uint8_t> GetRgb() {
+			std::vector<uint8_t> rgb;
+			for (int32_t y = 0; y < Height; y++) {
+				for (int32_t x = 0; x < Width; x++) {
+					rgb.push_back(At(x, y)[2]);
+					rgb.push_back(At(x, y)[1]);
+					rgb.push_back(At(x, y)[0]);
+				}
+			}
+			return rgb;
+		}
+	};
+
+	SourceImage CreateNoise(int32_t width, int32_t height, uint32_t seed) {
+		SourceImage image(width, height);
+		uint32_t state = seed;
+		for (int32_t y = 0; y < height; y++) {
+			for (int32_t x = 0; x < width; x++) {
+				state = state * 1664525u + 1013904223u;
+				image.Set(x, y, state >> 8);
+			}
+		}
+		return image;
+	}
+
+	//Flat areas, gradients, long runs and repeated small patterns, as in screen content, so every QOI operation and deflate matches are used.
+	SourceImage CreateScreenContent(int32_t width, int32_t height) {
+		SourceImage image(width, height);
+		uint32_t state = 7;
+		for (int32_t y = 0; y < height; y++) {
+			for (int32_t x = 0; x < width; x++) {
+				uint32_t rgb;
+				if (y < height / 8) {
+					rgb = 0x202830 + ((x / 4) & 0x0F);
+				}
+				else if (x < width / 5) {
+					rgb = static_cast<uint32_t>((x * 255 / width) << 16 | (y * 255 / height) << 8 | 0x40);
+				}
+				else if ((x / 6 + y / 9) % 5 == 0 && (x % 6) < 4 && (y % 9) < 7) {
+					state = state * 1664525u + 1013904223u;
+					rgb = (state >> 29) == 0 ? 0x000000 : 0x101010 * (state >> 29);
+				}
+				else {
+					rgb = 0xF0F0F0;
+				}
+				image.Set(x, y, rgb);
+			}
+		}
+		return image;
+	}
+
+	std::vector<uint8_t> Encode(ImageEncoder &encoder, ImageEncoderFormat format, SourceImage &image, int32_t *pWriteCount = nullptr) {
+		std::vector<uint8_t> file;
+		int32_t writeCount = 0;
+		bool isEncoded = encoder.Encode(format, image.Data.data(), image.Stride, image.Width, image.Height, [&](const uint8_t *pData, size_t length) {
+			file.insert(file.end(), pData, pData + length);
+			writeCount++;
+			return true;
+		});
+		CHECK(isEncoded);
+		if (pWriteCount) {
+			*pWriteCount = writeCount;
+		}
+		return file;
+	}
+
+	void CheckRoundTrip(ImageEncoderFormat format, SourceImage image, bool(*decode)(const std::vector<uint8_t> &, DECODED_IMAGE &)) {
+		ImageEncoder encoder;
+		DECODED_IMAGE decoded{};
+		CHECK(decode(Encode(encoder, format, image), decoded));
+		CHECK_EQUAL(image.Width, decoded.Width);
+		CHECK_EQUAL(image.Height, decoded.Height);
+		CHECK(decoded.Rgb == image.GetRgb());
+	}
+}
+
+TEST(PngRoundTrip)
+{
+	CheckRoundTrip(ImageEncoderFormat::PNG, CreateNoise(1, 1, 1), DecodePng);
+	CheckRoundTrip(ImageEncoderFormat::PNG, CreateNoise(37, 23, 2), DecodePng);
+	CheckRoundTrip(ImageEncoderFormat::PNG, CreateScreenContent(300, 200), DecodePng);
+}
+
+TEST(PngBandsFormOneStream)
+{
+	//Tall enough for several bands, each compressed with the window of the band before it.
+	SourceImage image = CreateScreenContent(1500, 500);
+	ImageEncoder singleThreaded;
+	ImageEncoder multithreaded;
+	multithreaded.SetThreadCount(4);
+	std::vector<uint8_t> single = Encode(singleThreaded, ImageEncoderFormat::PNG, image);
+	for (int run = 0; run < 3; run++) {
+		std::vector<uint8_t> multi = Encode(multithreaded, ImageEncoderFormat::PNG, image);
+		DECODED_IMAGE decoded{};
+		CHECK(DecodePng(multi, decoded));
+		CHECK(decoded.IdatCount > 1);
+		CHECK(decoded.Rgb == image.GetRgb());
+		//The bands do not depend on the thread count, so neither does the output.
+		CHECK(multi == single);
+	}
+}
+
+TEST(PngCompressesScreenContent)
+{
+	SourceImage image = CreateScreenContent(640, 480);
+	ImageEncoder encoder;
+	std::vector<uint8_t> file = Encode(encoder, ImageEncoderFormat::PNG, image);
+	CHECK(file.size() * 10 < static_cast<size_t>(image.Width) * image.Height * 3);
+}
+
+TEST(QoiRoundTrip)
+{
+	CheckRoundTrip(ImageEncoderFormat::QOI, CreateNoise(1, 1, 3), DecodeQoi);
+	CheckRoundTrip(ImageEncoderFormat::QOI, CreateNoise(41, 19, 4), DecodeQoi);
+	CheckRoundTrip(ImageEncoderFormat::QOI, CreateScreenContent(300, 200), DecodeQoi);
+	//A black image is a single run from the initial pixel, longer than one run operation.
+	SourceImage black(100, 3);
+	for (int32_t y = 0; y < black.Height; y++) {
+		for (int32_t x = 0; x < black.Width; x++) {
+			black.Set(x, y, 0);
+		}
+	}
+	CheckRoundTrip(ImageEncoderFormat::QOI, black, DecodeQoi);
+}
+
+TEST(BmpRoundTrip)
+{
+	CheckRoundTrip(ImageEncoderFormat::BMP, CreateNoise(33, 17, 5), DecodeBmp);
+	//Without padding, the rows are written in one piece.
+	SourceImage image(16, 8, 0);
+	for (int32_t y = 0; y < image.Height; y++) {
+		for (int32_t x = 0; x < image.Width; x++) {
+			image.Set(x, y, static_cast<uint32_t>(x * 0x10203 + y * 0x30201));
+		}
+	}
+	ImageEncoder encoder;
+	int32_t writeCount = 0;
+	DECODED_IMAGE decoded{};
+	CHECK(DecodeBmp(Encode(encoder, ImageEncoderFormat::BMP, image, &writeCount), decoded));
+	CHECK(decoded.Rgb == image.GetRgb());
+	CHECK_EQUAL(2, writeCount);
+}
+
+TEST(DeflateBlocksCanBeConcatenated)
+{
+	std::vector<uint8_t> data;
+	uint32_t state = 11;
+	for (int i = 0; i < 200000; i++) {
+		state = state * 1664525u + 1013904223u;
+		//Runs of random bytes, with repeats of earlier data within the window.
+		data.push_back(i % 3000 < 1000 ? static_cast<uint8_t>(state >> 24) : data[i - 1000]);
+	}
+	DeflateEncoder deflater;
+	std::vector<uint8_t> stream;
+	const size_t partSize = 50000;
+	for (size_t offset = 0; offset < data.size(); offset += partSize) {
+		deflater.Reset();
+		const size_t historySize = std::min(offset, DeflateEncoder::WINDOW_SIZE);
+		const bool isFinal = offset + partSize >= data.size();
+		deflater.Compress(data.data() + offset - historySize, historySize, std::min(partSize, data.size() - offset), isFinal);
+		if (!isFinal) {
+			deflater.Align();
+		}
+		stream.insert(stream.end(), deflater.GetOutput().begin(), deflater.GetOutput().end());
+	}
+	std::vector<uint8_t> inflated;
+	Inflater inflater(stream.data(), stream.size());
+	CHECK(inflater.Inflate(inflated));
+	CHECK_EQUAL(stream.size(), inflater.GetPosition());
+	CHECK(inflated == data);
+	CHECK(stream.size() < data.size());
+}
+
+TEST(Adler32CombineMatchesSingleBuffer)
+{
+	std::vector<uint8_t> data(100000);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>(i * 31 + (i >> 7));
+	}
+	const uint32_t expected = ReferenceAdler32(data.data(), data.size());
+	CHECK_EQUAL(expected, DeflateEncoder::Adler32(1, data.data(), data.size()));
+	const size_t splits[] = { 0, 1, 5551, 65521, data.size() };
+	for (size_t split : splits) {
+		const uint32_t first = DeflateEncoder::Adler32(1, data.data(), split);
+		const uint32_t second = DeflateEncoder::Adler32(1, data.data() + split, data.size() - split);
+		CHECK_EQUAL(expected, DeflateEncoder::Adler32Combine(first, second, data.size() - split));
+	}
+}
+
+TEST(FailedWriteStopsEncoding)
+{
+	SourceImage image = CreateScreenContent(1500, 500);
+	const ImageEncoderFormat formats[] = { ImageEncoderFormat::PNG, ImageEncoderFormat::QOI, ImageEncoderFormat::BMP };
+	for (ImageEncoderFormat format : formats) {
+		ImageEncoder encoder;
+		encoder.SetThreadCount(4);
+		int32_t writeCount = 0;
+		CHECK(!encoder.Encode(format, image.Data.data(), image.Stride, image.Width, image.Height, [&](const uint8_t *, size_t) {
+			writeCount++;
+			return false;
+		}));
+		CHECK_EQUAL(1, writeCount);
+	}
+}
+
+TEST(InvalidArgumentsAreRejected)
+{
+	SourceImage image = CreateNoise(8, 8, 6);
+	ImageEncoder encoder;
+	auto write = [](const uint8_t *, size_t) { return true; };
+	CHECK(encoder.Encode(ImageEncoderFormat::PNG, image.Data.data(), image.Stride, 8, 8, write));
+	CHECK(!encoder.Encode(ImageEncoderFormat::PNG, nullptr, image.Stride, 8, 8, write));
+	CHECK(!encoder.Encode(ImageEncoderFormat::PNG, image.Data.data(), 16, 8, 8, write));
+	CHECK(!encoder.Encode(ImageEncoderFormat::QOI, image.Data.data(), image.Stride, 0, 8, write));
+	CHECK(!encoder.Encode(ImageEncoderFormat::BMP, image.Data.data(), image.Stride, 8, 8, ImageWriteCallback{}));
+}
\ No newline at end of file
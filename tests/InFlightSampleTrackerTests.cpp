@@ -0,0 +1,150 @@
+#include "Test.h"
+#include "InFlightSampleTracker.h"
+#include <thread>
+
+using namespace std::chrono;
+
+namespace {
+	const milliseconds LONG_TIMEOUT = seconds(10);
+}
+
+TEST(FrameLimitIsEnforced)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(2, 0);
+	CHECK(tracker.WaitForCapacity(100, milliseconds(0)));
+	tracker.Submit(100, 0);
+	CHECK(tracker.WaitForCapacity(100, milliseconds(0)));
+	tracker.Submit(100, 10);
+	CHECK(!tracker.WaitForCapacity(100, milliseconds(0)));
+	//Frames are released oldest first, which gives the latency of each.
+	CHECK_EQUAL(50, tracker.Release(50));
+	CHECK(tracker.WaitForCapacity(100, milliseconds(0)));
+	IN_FLIGHT_STATISTICS stats = tracker.GetStatistics();
+	CHECK_EQUAL(1u, stats.FrameCount);
+	CHECK_EQUAL(100u, stats.ByteCount);
+	CHECK_EQUAL(2u, stats.PeakFrameCount);
+	CHECK_EQUAL(1u, stats.DroppedFrameCount);
+	CHECK_EQUAL(50, tracker.Release(60));
+	CHECK_EQUAL(-1, tracker.Release(70));
+}
+
+TEST(ByteLimitIsEnforced)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(0, 1000);
+	//A frame larger than the limit is accepted when nothing else is in flight.
+	CHECK(tracker.WaitForCapacity(5000, milliseconds(0)));
+	tracker.Submit(600, 0);
+	CHECK(tracker.WaitForCapacity(400, milliseconds(0)));
+	CHECK(!tracker.WaitForCapacity(401, milliseconds(0)));
+	CHECK(!tracker.WaitForCapacity(5000, milliseconds(0)));
+	CHECK_EQUAL(2u, tracker.GetStatistics().DroppedFrameCount);
+}
+
+TEST(NoLimitsAcceptAllFrames)
+{
+	InFlightSampleTracker tracker;
+	for (int i = 0; i < 100; i++) {
+		CHECK(tracker.WaitForCapacity(1 << 20, milliseconds(0)));
+		tracker.Submit(1 << 20, i);
+	}
+	CHECK_EQUAL(100u, tracker.GetStatistics().FrameCount);
+}
+
+TEST(WaitEndsOnRelease)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(1, 0);
+	tracker.Submit(100, 0);
+	std::thread releaser([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		tracker.Release(1);
+	});
+	CHECK(tracker.WaitForCapacity(100, LONG_TIMEOUT));
+	releaser.join();
+	CHECK_EQUAL(0u, tracker.GetStatistics().DroppedFrameCount);
+}
+
+TEST(WaitTimesOut)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(1, 0);
+	tracker.Submit(100, 0);
+	const auto start = steady_clock::now();
+	CHECK(!tracker.WaitForCapacity(100, milliseconds(20)));
+	CHECK(steady_clock::now() - start >= milliseconds(20));
+	CHECK_EQUAL(1u, tracker.GetStatistics().DroppedFrameCount);
+}
+
+TEST(WaitIsCanceledByStop)
+{
+	InFlightSampleTracker tracker;
+	SyncEvent stopEvent(true);
+	tracker.SetLimits(1, 0);
+	tracker.Submit(100, 0);
+	std::thread stopper([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		stopEvent.Set();
+	});
+	const auto start = steady_clock::now();
+	CHECK(!tracker.WaitForCapacity(100, LONG_TIMEOUT, &stopEvent));
+	CHECK(steady_clock::now() - start < LONG_TIMEOUT);
+	stopper.join();
+	//Once stopped, frames that do not fit are dropped without waiting.
+	CHECK(!tracker.WaitForCapacity(100, LONG_TIMEOUT, &stopEvent));
+	CHECK_EQUAL(2u, tracker.GetStatistics().DroppedFrameCount);
+	tracker.Release(1);
+	CHECK(tracker.WaitForCapacity(100, LONG_TIMEOUT, &stopEvent));
+}
+
+TEST(ReservedFramesCountTowardsLimits)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(2, 1000);
+	//A frame is reserved when it is queued for conversion, and submitted once it is converted.
+	CHECK(tracker.WaitForCapacity(400, milliseconds(0)));
+	tracker.Reserve(400);
+	CHECK(tracker.WaitForCapacity(400, milliseconds(0)));
+	tracker.Reserve(400);
+	CHECK(!tracker.WaitForCapacity(100, milliseconds(0)));
+	IN_FLIGHT_STATISTICS stats = tracker.GetStatistics();
+	CHECK_EQUAL(0u, stats.FrameCount);
+	CHECK_EQUAL(2u, stats.ReservedFrameCount);
+	tracker.Submit(400, 0, true);
+	tracker.Submit(400, 10, true);
+	stats = tracker.GetStatistics();
+	CHECK_EQUAL(2u, stats.FrameCount);
+	CHECK_EQUAL(800u, stats.ByteCount);
+	CHECK_EQUAL(0u, stats.ReservedFrameCount);
+	CHECK(!tracker.WaitForCapacity(100, milliseconds(0)));
+	CHECK_EQUAL(20, tracker.Release(20));
+	//The byte limit includes the reservations as well.
+	tracker.Reserve(200);
+	CHECK(!tracker.WaitForCapacity(1, milliseconds(0)));
+	tracker.Release(30);
+	CHECK(tracker.WaitForCapacity(800, milliseconds(0)));
+	CHECK(!tracker.WaitForCapacity(801, milliseconds(0)));
+	CHECK_EQUAL(4u, tracker.GetStatistics().DroppedFrameCount);
+}
+
+TEST(WaitEndsOnCanceledReservation)
+{
+	InFlightSampleTracker tracker;
+	tracker.SetLimits(1, 0);
+	tracker.Reserve(100);
+	std::thread canceler([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		tracker.CancelReservation(100);
+	});
+	CHECK(tracker.WaitForCapacity(100, LONG_TIMEOUT));
+	canceler.join();
+	IN_FLIGHT_STATISTICS stats = tracker.GetStatistics();
+	CHECK_EQUAL(0u, stats.ReservedFrameCount);
+	CHECK_EQUAL(0u, stats.DroppedFrameCount);
+	//Canceling more reservations than were made has no effect.
+	tracker.CancelReservation(100);
+	tracker.Submit(100, 0, true);
+	CHECK_EQUAL(0u, tracker.GetStatistics().ReservedFrameCount);
+	CHECK_EQUAL(1u, tracker.GetStatistics().FrameCount);
+}
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "Test.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+
+TEST(SmallValuesHaveTheirOwnBucket)
+{
+	int wrongIndexCount = 0;
+	for (uint64_t value = 0; value < 2 * MetricHistogram::SUB_BUCKET_COUNT; value++) {
+		const size_t index = MetricHistogram::GetBucketIndex(value);
+		wrongIndexCount += index == value && MetricHistogram::GetBucketUpperBound(index) == value ? 0 : 1;
+	}
+	CHECK_EQUAL(0, wrongIndexCount);
+}
+
+TEST(BucketIndexAtPowersOfTwo)
+{
+	//Above 63, each power of two is split into 32 buckets of 2^magnitude values, where magnitude is the highest bit minus 5.
+	CHECK_EQUAL(64u, MetricHistogram::GetBucketIndex(64));
+	CHECK_EQUAL(64u, MetricHistogram::GetBucketIndex(65));
+	CHECK_EQUAL(65u, MetricHistogram::GetBucketIndex(66));
+	CHECK_EQUAL(95u, MetricHistogram::GetBucketIndex(127));
+	CHECK_EQUAL(96u, MetricHistogram::GetBucketIndex(128));
+	CHECK_EQUAL(96u, MetricHistogram::GetBucketIndex(131));
+	CHECK_EQUAL(97u, MetricHistogram::GetBucketIndex(132));
+	CHECK_EQUAL(MetricHistogram::BUCKET_COUNT - 1, MetricHistogram::GetBucketIndex(UINT64_MAX));
+	CHECK(MetricHistogram::GetBucketUpperBound(MetricHistogram::BUCKET_COUNT - 1) == UINT64_MAX);
+	int wrongIndexCount = 0;
+	for (int bit = MetricHistogram::SUB_BUCKET_BITS + 1; bit < 64; bit++) {
+		const uint64_t powerOfTwo = 1ull << bit;
+		const uint64_t magnitude = bit - MetricHistogram::SUB_BUCKET_BITS;
+		const size_t expectedIndex = static_cast<size_t>(magnitude * MetricHistogram::SUB_BUCKET_COUNT + MetricHistogram::SUB_BUCKET_COUNT);
+		//The last value of the previous power of two is in the bucket just before.
+		wrongIndexCount += MetricHistogram::GetBucketIndex(powerOfTwo) == expectedIndex ? 0 : 1;
+		wrongIndexCount += MetricHistogram::GetBucketIndex(powerOfTwo - 1) == expectedIndex - 1 ? 0 : 1;
+		wrongIndexCount += MetricHistogram::GetBucketUpperBound(expectedIndex - 1) == powerOfTwo - 1 ? 0 : 1;
+	}
+	CHECK_EQUAL(0, wrongIndexCount);
+}
+
+TEST(BucketBoundsAreContiguous)
+{
+	//Every value is counted in exactly one bucket, so the buckets cover the range without gaps or overlaps.
+	int wrongBoundCount = 0;
+	for (size_t index = 1; index < MetricHistogram::BUCKET_COUNT; index++) {
+		const uint64_t lowerBound = MetricHistogram::GetBucketUpperBound(index - 1) + 1;
+		const uint64_t upperBound = MetricHistogram::GetBucketUpperBound(index);
+		wrongBoundCount += upperBound >= lowerBound ? 0 : 1;
+		wrongBoundCount += MetricHistogram::GetBucketIndex(lowerBound) == index ? 0 : 1;
+		wrongBoundCount += MetricHistogram::GetBucketIndex(upperBound) == index ? 0 : 1;
+		//The width of a bucket is at most 1/32 of its lowest value.
+		wrongBoundCount += (upperBound - lowerBound) * MetricHistogram::SUB_BUCKET_COUNT <= lowerBound ? 0 : 1;
+	}
+	CHECK_EQUAL(0, wrongBoundCount);
+}
+
+TEST(PercentilesAreWithinBucketError)
+{
+	std::mt19937_64 random(42);
+	for (uint64_t range : { 100ull, 10000ull, 1000000ull, 1ull << 40 }) {
+		MetricHistogram histogram;
+		std::vector<uint64_t> values(10000);
+		for (uint64_t &value : values) {
+			value = random() % range;
+			histogram.Record(value);
+		}
+		std::sort(values.begin(), values.end());
+		const METRIC_HISTOGRAM_VALUE result = histogram.GetValue();
+		CHECK_EQUAL(values.size(), result.Count);
+		CHECK_EQUAL(values.front(), result.Min);
+		CHECK_EQUAL(values.back(), result.Max);
+		const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+		const uint64_t results[] = { result.P50, result.P90, result.P99, result.P999 };
+		for (int i = 0; i < 4; i++) {
+			//The exact percentile is the value at the rank, and the histogram reports the upper bound of its bucket.
+			const uint64_t exact = values[static_cast<size_t>(std::ceil(percentiles[i] * values.size())) - 1];
+			CHECK(results[i] >= exact);
+			CHECK(results[i] - exact <= exact / MetricHistogram::SUB_BUCKET_COUNT);
+		}
+	}
+}
+
+TEST(PercentilesOfSingleValue)
+{
+	MetricHistogram histogram;
+	CHECK_EQUAL(0u, histogram.GetValue().Count);
+	histogram.Record(1000);
+	const METRIC_HISTOGRAM_VALUE result = histogram.GetValue();
+	//The percentiles are clamped to the recorded range, so they are exact for a single value.
+	CHECK_EQUAL(1000u, result.P50);
+	CHECK_EQUAL(1000u, result.P999);
+	CHECK(result.Mean == 1000.0);
+	histogram.Reset();
+	CHECK_EQUAL(0u, histogram.GetValue().Count);
+}
+
+TEST(SnapshotsAreConsistentWhileWriting)
+{
+	MetricsRegistry registry;
+	MetricCounter *pCounter = registry.GetCounter("frames");
+	MetricGauge *pGauge = registry.GetGauge("queue_depth");
+	MetricHistogram *pHistogram = registry.GetHistogram("latency_us");
+	const int threadCount = 4;
+	const int iterationCount = 100000;
+	std::atomic<int> finishedWriterCount(0);
+	std::vector<std::thread> writers;
+	for (int t = 0; t < threadCount; t++) {
+		writers.emplace_back([=, &finishedWriterCount]() {
+			for (int i = 0; i < iterationCount; i++) {
+				pCounter->Increment();
+				//Each writer adds and removes one item, so the depth stays within [0, threadCount].
+				pGauge->Add(1);
+				pHistogram->Record(static_cast<uint64_t>(i % 1000));
+				pGauge->Add(-1);
+			}
+			finishedWriterCount++;
+		});
+	}
+	uint64_t previousCounter = 0;
+	uint64_t previousHistogramCount = 0;
+	int inconsistentCount = 0;
+	while (finishedWriterCount.load() < threadCount) {
+		const METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+		if (snapshot.Counters.size() != 1 || snapshot.Gauges.size() != 1 || snapshot.Histograms.size() != 1) {
+			inconsistentCount++;
+			continue;
+		}
+		const uint64_t counter = snapshot.Counters[0].Value;
+		const METRIC_GAUGE_VALUE &gauge = snapshot.Gauges[0];
+		const METRIC_HISTOGRAM_VALUE &histogram = snapshot.Histograms[0];
+		inconsistentCount += counter >= previousCounter && counter <= static_cast<uint64_t>(threadCount) * iterationCount ? 0 : 1;
+		inconsistentCount += gauge.Value >= 0 && gauge.Value <= threadCount && gauge.MaxValue <= threadCount ? 0 : 1;
+		inconsistentCount += histogram.Count >= previousHistogramCount ? 0 : 1;
+		if (histogram.Count > 0) {
+			inconsistentCount += histogram.P50 <= histogram.P90 && histogram.P90 <= histogram.P99 && histogram.P99 <= histogram.P999 && histogram.P999 <= 999 ? 0 : 1;
+		}
+		previousCounter = counter;
+		previousHistogramCount = histogram.Count;
+	}
+	for (std::thread &writer : writers) {
+		writer.join();
+	}
+	CHECK_EQUAL(0, inconsistentCount);
+	const METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+	CHECK_EQUAL(static_cast<uint64_t>(threadCount) * iterationCount, snapshot.Counters[0].Value);
+	CHECK_EQUAL(0, snapshot.Gauges[0].Value);
+	CHECK(snapshot.Gauges[0].MaxValue >= 1);
+	CHECK_EQUAL(static_cast<uint64_t>(threadCount) * iterationCount, snapshot.Histograms[0].Count);
+	CHECK_EQUAL(999u, snapshot.Histograms[0].Max);
+	registry.Reset();
+	const METRICS_SNAPSHOT resetSnapshot = registry.GetSnapshot();
+	CHECK_EQUAL(0u, resetSnapshot.Counters[0].Value);
+	CHECK_EQUAL(0, resetSnapshot.Gauges[0].MaxValue);
+	CHECK_EQUAL(0u, resetSnapshot.Histograms[0].Count);
+}
+
+TEST(MetricsAreLookedUpByName)
+{
+	MetricsRegistry registry;
+	MetricCounter *pCounter = registry.GetCounter("frames");
+	CHECK(registry.GetCounter("frames") == pCounter);
+	CHECK(registry.GetCounter("drops") != pCounter);
+	//Each type has its own names.
+	registry.GetGauge("frames")->Set(5);
+	pCounter->Increment(3);
+	const METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+	CHECK_EQUAL(2u, snapshot.Counters.size());
+	CHECK(!snapshot.Counters.empty() && snapshot.Counters[0].Name == "frames");
+	CHECK(!snapshot.Counters.empty() && snapshot.Counters[0].Value == 3);
+	CHECK_EQUAL(1u, snapshot.Gauges.size());
+	CHECK(!snapshot.Gauges.empty() && snapshot.Gauges[0].Value == 5);
+}
+
+TEST(MetricsPastLimitAreLeftOutOfSnapshots)
+{
+	MetricsRegistry registry;
+	for (size_t i = 0; i < MetricsRegistry::MAX_METRICS_PER_TYPE; i++) {
+		registry.GetCounter("counter" + std::to_string(i))->Increment();
+	}
+	MetricCounter *pOverflow = registry.GetCounter("overflow");
+	CHECK(pOverflow != nullptr);
+	pOverflow->Increment();
+	CHECK(registry.GetCounter("counter0") != pOverflow);
+	const METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+	CHECK_EQUAL(MetricsRegistry::MAX_METRICS_PER_TYPE, snapshot.Counters.size());
+	CHECK(std::none_of(snapshot.Counters.begin(), snapshot.Counters.end(), [](const METRIC_COUNTER_VALUE &counter) { return counter.Name == "overflow"; }));
+}
+
+TEST(MetricsCanBeAddedWhileTakingSnapshots)
+{
+	MetricsRegistry registry;
+	std::vector<MetricCounter *> counters(MetricsRegistry::MAX_METRICS_PER_TYPE);
+	std::thread registrar([&]() {
+		for (size_t i = 0; i < counters.size(); i++) {
+			counters[i] = registry.GetCounter("counter" + std::to_string(i));
+			counters[i]->Increment(i);
+		}
+	});
+	//Metrics are only appended, so each snapshot holds a prefix of the final list, in order, with complete names.
+	size_t previousSize = 0;
+	int inconsistentCount = 0;
+	while (previousSize < counters.size()) {
+		const METRICS_SNAPSHOT snapshot = registry.GetSnapshot();
+		inconsistentCount += snapshot.Counters.size() >= previousSize ? 0 : 1;
+		for (size_t i = 0; i < snapshot.Counters.size(); i++) {
+			inconsistentCount += snapshot.Counters[i].Name == "counter" + std::to_string(i) ? 0 : 1;
+			inconsistentCount += snapshot.Counters[i].Value <= i ? 0 : 1;
+		}
+		previousSize = snapshot.Counters.size();
+	}
+	registrar.join();
+	CHECK_EQUAL(0, inconsistentCount);
+	//The pointers stay valid and keep referring to the same metric.
+	int movedCount = 0;
+	for (size_t i = 0; i < counters.size(); i++) {
+		movedCount += registry.GetCounter("counter" + std::to_string(i)) == counters[i] && counters[i]->GetValue() == i ? 0 : 1;
+	}
+	CHECK_EQUAL(0, movedCount);
+}
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include "Test.h"
+#include "Mp4Muxer.h"
+#include <string>
+
+namespace {
+	//30 fps, in 100 nanosecond units, which is 3000 in the 90 kHz video timescale.
+	const int64_t FRAME_DURATION = 333333;
+	//1024 AAC samples at 48 kHz.
+	const int64_t AUDIO_DURATION = 213333;
+	//The first key frame, which is the start of the file.
+	const int64_t START_TIMESTAMP = 5000000;
+	//Audio starts 5 ms, or 240 samples at 48 kHz, after the video.
+	const int64_t AUDIO_OFFSET = 50000;
+	const uint32_t KEY_SAMPLE_FLAGS = 0x02000000;
+	const uint32_t NON_KEY_SAMPLE_FLAGS = 0x01010000;
+
+	class MemoryOutput : public MuxerOutput
+	{
+	public:
+		std::vector<uint8_t> &Data;
+		int WriteCount;
+
+		MemoryOutput(std::vector<uint8_t> &data) :
+			Data(data),
+			WriteCount(0)
+		{
+		}
+		bool Write(const uint8_t *pData, size_t size) override {
+			Data.insert(Data.end(), pData, pData + size);
+			WriteCount++;
+			return true;
+		}
+		bool WriteAt(uint64_t position, const uint8_t *pData, size_t size) override {
+			if (position + size > Data.size()) {
+				return false;
+			}
+			std::copy(pData, pData + size, Data.begin() + position);
+			return true;
+		}
+	};
+
+	struct BOX {
+		std::string Type;
+		size_t Position;
+		size_t Size;
+		size_t HeaderSize;
+	};
+
+	uint32_t ReadU32(const std::vector<uint8_t> &data, size_t position) {
+		return static_cast<uint32_t>(data[position]) << 24 | static_cast<uint32_t>(data[position + 1]) << 16 | static_cast<uint32_t>(data[position + 2]) << 8 | data[position + 3];
+	}
+
+	uint64_t ReadU64(const std::vector<uint8_t> &data, size_t position) {
+		return static_cast<uint64_t>(ReadU32(data, position)) << 32 | ReadU32(data, position + 4);
+	}
+
+	//Reads the boxes between start and end, which must fill the range exactly.
+	std::vector<BOX> ReadBoxes(const std::vector<uint8_t> &data, size_t start, size_t end) {
+		std::vector<BOX> boxes{};
+		size_t position = start;
+		while (position + 8 <= end) {
+			BOX box{ std::string(reinterpret_cast<const char *>(&data[position + 4]), 4), position, ReadU32(data, position), 8 };
+			if (box.Size == 1) {
+				box.Size = static_cast<size_t>(ReadU64(data, position + 8));
+				box.HeaderSize = 16;
+			}
+			if (box.Size < box.HeaderSize || position + box.Size > end) {
+				break;
+			}
+			boxes.push_back(box);
+			position += box.Size;
+		}
+		CHECK(position == end);
+		return boxes;
+	}
+
+	//Reads the boxes in a box, after the fields of the box itself.
+	std::vector<BOX> ReadChildren(const std::vector<uint8_t> &data, const BOX &box, size_t fieldSize = 0) {
+		return ReadBoxes(data, box.Position + box.HeaderSize + fieldSize, box.Position + box.Size);
+	}
+
+	//The size of the fields before the boxes in a box that has both, i.e. the sample description and the sample entries.
+	size_t GetFieldSize(const std::string &type) {
+		if (type == "stsd") {
+			return 8;
+		}
+		if (type == "avc1" || type == "hvc1") {
+			return 78;
+		}
+		if (type == "mp4a" || type == "ipcm") {
+			return 28;
+		}
+		return 0;
+	}
+
+	//Finds a box by its path, e.g. "trak/mdia/minf/stbl/stts".
+	BOX FindBox(const std::vector<uint8_t> &data, const BOX &parent, const std::string &path) {
+		const size_t separator = path.find('/');
+		const std::string type = path.substr(0, separator);
+		for (const BOX &box : ReadChildren(data, parent, GetFieldSize(parent.Type))) {
+			if (box.Type == type) {
+				return separator == std::string::npos ? box : FindBox(data, box, path.substr(separator + 1));
+			}
+		}
+		return BOX{ "", 0, 0, 0 };
+	}
+
+	std::vector<BOX> FindBoxes(const std::vector<uint8_t> &data, const BOX &parent, const std::string &type) {
+		std::vector<BOX> boxes{};
+		for (const BOX &box : ReadChildren(data, parent)) {
+			if (box.Type == type) {
+				boxes.push_back(box);
+			}
+		}
+		return boxes;
+	}
+
+	std::vector<std::string> GetTypes(const std::vector<BOX> &boxes) {
+		std::vector<std::string> types{};
+		for (const BOX &box : boxes) {
+			types.push_back(box.Type);
+		}
+		return types;
+	}
+
+	//The start of the fields of a full box, after its version and flags.
+	size_t GetFields(const BOX &box) {
+		return box.Position + box.HeaderSize + 4;
+	}
+
+	//An access unit in Annex B format. Key frames carry the parameter sets. The frame index is in each slice, so samples can be found in the file.
+	std::vector<uint8_t> CreateFrame(VideoCodec codec, bool isKeyFrame, int frameIndex) {
+		std::vector<uint8_t> frame{};
+		auto addNalUnit = [&](std::vector<uint8_t> nalUnit) {
+			frame.insert(frame.end(), { 0, 0, 0, 1 });
+			frame.insert(frame.end(), nalUnit.begin(), nalUnit.end());
+		};
+		const uint8_t index = static_cast<uint8_t>(frameIndex);
+		if (codec == VideoCodec::H264) {
+			addNalUnit({ 0x09, 0xF0 });
+			if (isKeyFrame) {
+				addNalUnit({ 0x67, 100, 0, 40, 0xAC, 0, 0, 3, 1 });
+				addNalUnit({ 0x68, 0xEE, 0x3C, 0x80 });
+				addNalUnit({ 0x65, 0x88, index, 1, 2, 3 });
+			}
+			else {
+				addNalUnit({ 0x41, 0x9A, index, 4, 5 });
+			}
+		}
+		else {
+			addNalUnit({ 0x46, 0x01, 0x50 });
+			if (isKeyFrame) {
+				addNalUnit({ 0x40, 0x01, 0x0C, 0x01 });
+				addNalUnit({ 0x42, 0x01, 0x01, 0x01, 0x60, 0, 0, 3, 0, 0x90, 0, 0, 0, 0, 0, 0x5D, 0xA0, 2, 0x80 });
+				addNalUnit({ 0x44, 0x01, 0xC1, 0x72 });
+				addNalUnit({ 0x26, 0x01, index, 9 });
+			}
+			else {
+				addNalUnit({ 0x02, 0x01, index, 8 });
+			}
+		}
+		return frame;
+	}
+
+	struct RECORDING {
+		std::vector<uint8_t> Data;
+		bool IsFinalized;
+		MP4_MUXER_STATISTICS Statistics;
+		int OutputWriteCount;
+	};
+
+	/// <summary>
+	/// Muxes 30 frames of video with a key frame every 10 frames, and the AAC audio that goes with it, after a frame and an audio packet from before the first key frame.
+	/// </summary>
+	RECORDING Record(const MP4_MUXER_OPTIONS &options, VideoCodec codec = VideoCodec::H264) {
+		RECORDING recording{};
+		MemoryOutput *pOutput = new MemoryOutput(recording.Data);
+		Mp4Muxer muxer(std::unique_ptr<MuxerOutput>(pOutput), options, MP4_VIDEO_TRACK{ codec, 1280, 720, {} }, MP4_AUDIO_TRACK{ AudioCodec::AAC, 48000, 2, 16, {} });
+		CHECK(muxer.WritePacket(ENCODED_PACKET{ PacketStream::Audio, START_TIMESTAMP - 100000, AUDIO_DURATION, false, std::vector<uint8_t>(10) }));
+		CHECK(muxer.WritePacket(ENCODED_PACKET{ PacketStream::Video, START_TIMESTAMP - FRAME_DURATION, FRAME_DURATION, false, CreateFrame(codec, false, 99) }));
+		int64_t audioTimestamp = START_TIMESTAMP + AUDIO_OFFSET;
+		for (int i = 0; i < 30; i++) {
+			const int64_t timestamp = START_TIMESTAMP + i * FRAME_DURATION;
+			CHECK(muxer.WritePacket(ENCODED_PACKET{ PacketStream::Video, timestamp, FRAME_DURATION, i % 10 == 0, CreateFrame(codec, i % 10 == 0, i) }));
+			while (audioTimestamp < timestamp + FRAME_DURATION) {
+				CHECK(muxer.WritePacket(ENCODED_PACKET{ PacketStream::Audio, audioTimestamp, AUDIO_DURATION, false, std::vector<uint8_t>(20, static_cast<uint8_t>(i)) }));
+				audioTimestamp += AUDIO_DURATION;
+			}
+		}
+		recording.IsFinalized = muxer.Finalize();
+		recording.Statistics = muxer.GetStatistics();
+		recording.OutputWriteCount = pOutput->WriteCount;
+		return recording;
+	}
+
+	BOX GetFileBox(const std::vector<uint8_t> &data) {
+		return BOX{ "", 0, data.size(), 0 };
+	}
+}
+
+TEST(FileHasMediaDataBeforeMovie)
+{
+	RECORDING recording = Record(MP4_MUXER_OPTIONS{});
+	CHECK(recording.IsFinalized);
+	CHECK_EQUAL(30u, recording.Statistics.VideoSampleCount);
+	CHECK_EQUAL(47u, recording.Statistics.AudioSampleCount);
+	CHECK_EQUAL(0u, recording.Statistics.FragmentCount);
+	const std::vector<uint8_t> &data = recording.Data;
+	std::vector<BOX> boxes = ReadBoxes(data, 0, data.size());
+	//The media data is written as the packets arrive, and the movie box with the sample tables when the file is finalized.
+	CHECK((GetTypes(boxes) == std::vector<std::string>{ "ftyp", "mdat", "moov" }));
+	CHECK_EQUAL(16u, boxes[1].HeaderSize);
+	CHECK((GetTypes(ReadChildren(data, boxes[2])) == std::vector<std::string>{ "mvhd", "trak", "trak" }));
+	//The movie lasts as long as its longest track, the audio, in milliseconds.
+	CHECK_EQUAL(1000u, ReadU32(data, GetFields(FindBox(data, boxes[2], "mvhd")) + 8));
+	CHECK_EQUAL(1002u, ReadU32(data, GetFields(FindBox(data, boxes[2], "mvhd")) + 12));
+}
+
+TEST(SampleTablesHaveTiming)
+{
+	RECORDING recording = Record(MP4_MUXER_OPTIONS{});
+	const std::vector<uint8_t> &data = recording.Data;
+	const BOX movie = FindBox(data, GetFileBox(data), "moov");
+	std::vector<BOX> tracks = FindBoxes(data, movie, "trak");
+	CHECK_EQUAL(2u, tracks.size());
+
+	const BOX &video = tracks[0];
+	const BOX videoMediaHeader = FindBox(data, video, "mdia/mdhd");
+	CHECK_EQUAL(90000u, ReadU32(data, GetFields(videoMediaHeader) + 8));
+	CHECK_EQUAL(90000u, ReadU32(data, GetFields(videoMediaHeader) + 12));
+	CHECK(FindBox(data, video, "mdia/minf/stbl/stsd/avc1/avcC").Size > 0);
+	//All frames are 1/30 s, so one entry describes them.
+	const BOX videoTimes = FindBox(data, video, "mdia/minf/stbl/stts");
+	CHECK_EQUAL(1u, ReadU32(data, GetFields(videoTimes)));
+	CHECK_EQUAL(30u, ReadU32(data, GetFields(videoTimes) + 4));
+	CHECK_EQUAL(3000u, ReadU32(data, GetFields(videoTimes) + 8));
+	const BOX syncSamples = FindBox(data, video, "mdia/minf/stbl/stss");
+	CHECK_EQUAL(3u, ReadU32(data, GetFields(syncSamples)));
+	CHECK_EQUAL(1u, ReadU32(data, GetFields(syncSamples) + 4));
+	CHECK_EQUAL(11u, ReadU32(data, GetFields(syncSamples) + 8));
+	CHECK_EQUAL(21u, ReadU32(data, GetFields(syncSamples) + 12));
+	//Frames are not reordered, so the decoding timestamps are the presentation timestamps, and there are no composition offsets.
+	CHECK(FindBox(data, video, "mdia/minf/stbl/ctts").Size == 0);
+	//The video starts the file, so it needs no edit.
+	CHECK(FindBox(data, video, "edts").Size == 0);
+
+	const BOX &audio = tracks[1];
+	const BOX audioMediaHeader = FindBox(data, audio, "mdia/mdhd");
+	CHECK_EQUAL(48000u, ReadU32(data, GetFields(audioMediaHeader) + 8));
+	CHECK_EQUAL(47u * 1024u, ReadU32(data, GetFields(audioMediaHeader) + 12));
+	CHECK(FindBox(data, audio, "mdia/minf/stbl/stsd/mp4a/esds").Size > 0);
+	const BOX audioTimes = FindBox(data, audio, "mdia/minf/stbl/stts");
+	CHECK_EQUAL(1u, ReadU32(data, GetFields(audioTimes)));
+	CHECK_EQUAL(47u, ReadU32(data, GetFields(audioTimes) + 4));
+	CHECK_EQUAL(1024u, ReadU32(data, GetFields(audioTimes) + 8));
+	CHECK(FindBox(data, audio, "mdia/minf/stbl/stss").Size == 0);
+	//The audio starts 5 ms into the file, which is an empty edit followed by the whole track.
+	const BOX edits = FindBox(data, audio, "edts/elst");
+	CHECK_EQUAL(2u, ReadU32(data, GetFields(edits)));
+	CHECK_EQUAL(5u, ReadU32(data, GetFields(edits) + 4));
+	CHECK_EQUAL(UINT32_MAX, ReadU32(data, GetFields(edits) + 8));
+	CHECK_EQUAL(1002u, ReadU32(data, GetFields(edits) + 16));
+	CHECK_EQUAL(0u, ReadU32(data, GetFields(edits) + 20));
+	CHECK_EQUAL(0x00010000u, ReadU32(data, GetFields(edits) + 24));
+}
+
+TEST(ChunksPointToSamples)
+{
+	RECORDING recording = Record(MP4_MUXER_OPTIONS{});
+	const std::vector<uint8_t> &data = recording.Data;
+	const BOX mediaData = FindBox(data, GetFileBox(data), "mdat");
+	const BOX movie = FindBox(data, GetFileBox(data), "moov");
+	size_t sampleBytes = 0;
+	int trackIndex = 0;
+	for (const BOX &track : FindBoxes(data, movie, "trak")) {
+		const BOX sizes = FindBox(data, track, "mdia/minf/stbl/stsz");
+		const BOX chunks = FindBox(data, track, "mdia/minf/stbl/stco");
+		const BOX chunkSamples = FindBox(data, track, "mdia/minf/stbl/stsc");
+		const uint32_t sampleCount = ReadU32(data, GetFields(sizes) + 4);
+		const uint32_t chunkCount = ReadU32(data, GetFields(chunks));
+		const uint32_t runCount = ReadU32(data, GetFields(chunkSamples));
+		uint32_t sampleIndex = 0;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			//The samples per chunk of the last run that starts at or before this chunk.
+			uint32_t samplesPerChunk = 0;
+			for (uint32_t run = 0; run < runCount && ReadU32(data, GetFields(chunkSamples) + 4 + run * 12) <= chunk + 1; run++) {
+				samplesPerChunk = ReadU32(data, GetFields(chunkSamples) + 8 + run * 12);
+			}
+			size_t position = ReadU32(data, GetFields(chunks) + 4 + chunk * 4);
+			for (uint32_t i = 0; i < samplesPerChunk && sampleIndex < sampleCount; i++, sampleIndex++) {
+				const uint32_t size = ReadU32(data, GetFields(sizes) + 8 + sampleIndex * 4);
+				CHECK(position >= mediaData.Position + mediaData.HeaderSize && position + size <= mediaData.Position + mediaData.Size);
+				if (trackIndex == 0) {
+					//A length prefixed slice, without the delimiter and parameter sets, with the frame index as its third byte.
+					CHECK_EQUAL(size - 4, ReadU32(data, position));
+					CHECK_EQUAL(sampleIndex, data[position + 6]);
+				}
+				position += size;
+				sampleBytes += size;
+			}
+		}
+		CHECK_EQUAL(sampleCount, sampleIndex);
+		trackIndex++;
+	}
+	CHECK_EQUAL(mediaData.Size - mediaData.HeaderSize, sampleBytes);
+}
+
+TEST(FragmentedFileHasFragmentsAfterMovie)
+{
+	MP4_MUXER_OPTIONS options{};
+	options.IsFragmented = true;
+	options.FragmentDuration = 5000000;
+	RECORDING recording = Record(options);
+	CHECK(recording.IsFinalized);
+	CHECK_EQUAL(2u, recording.Statistics.FragmentCount);
+	const std::vector<uint8_t> &data = recording.Data;
+	std::vector<BOX> boxes = ReadBoxes(data, 0, data.size());
+	//Fragments start at a key frame at least 0.5 s after the last one, so the key frame at 1/3 s does not start one.
+	CHECK((GetTypes(boxes) == std::vector<std::string>{ "ftyp", "moov", "moof", "mdat", "moof", "mdat" }));
+	const BOX &movie = boxes[1];
+	CHECK(FindBox(data, movie, "mvex").Size > 0);
+	CHECK_EQUAL(2u, FindBoxes(data, FindBox(data, movie, "mvex"), "trex").size());
+	//The samples are only described in the fragments.
+	for (const BOX &track : FindBoxes(data, movie, "trak")) {
+		CHECK_EQUAL(0u, ReadU32(data, GetFields(FindBox(data, track, "mdia/minf/stbl/stts"))));
+		CHECK(FindBox(data, track, "edts").Size == 0);
+	}
+	CHECK_EQUAL(1u, ReadU32(data, GetFields(FindBox(data, boxes[2], "mfhd"))));
+	CHECK_EQUAL(2u, ReadU32(data, GetFields(FindBox(data, boxes[4], "mfhd"))));
+}
+
+TEST(FragmentsHaveTiming)
+{
+	MP4_MUXER_OPTIONS options{};
+	options.IsFragmented = true;
+	options.FragmentDuration = 5000000;
+	RECORDING recording = Record(options);
+	const std::vector<uint8_t> &data = recording.Data;
+	std::vector<BOX> boxes = ReadBoxes(data, 0, data.size());
+	CHECK_EQUAL(6u, boxes.size());
+	//The first fragment has frames 0 to 19 and the audio committed before frame 20, which is the audio packet written after frame 19, the second has the rest.
+	const uint32_t videoCounts[]{ 20, 10 };
+	const uint32_t audioCounts[]{ 31, 16 };
+	const uint64_t videoStarts[]{ 0, 60000 };
+	const uint64_t audioStarts[]{ 240, 240 + 31 * 1024 };
+	for (size_t fragment = 0; fragment < 2 && boxes.size() == 6; fragment++) {
+		const BOX &movieFragment = boxes[2 + fragment * 2];
+		const BOX &mediaData = boxes[3 + fragment * 2];
+		std::vector<BOX> trackFragments = FindBoxes(data, movieFragment, "traf");
+		CHECK_EQUAL(2u, trackFragments.size());
+		size_t sampleBytes = 0;
+		for (size_t trackIndex = 0; trackIndex < trackFragments.size(); trackIndex++) {
+			const BOX &trackFragment = trackFragments[trackIndex];
+			const bool isVideo = trackIndex == 0;
+			CHECK_EQUAL(trackIndex + 1, ReadU32(data, GetFields(FindBox(data, trackFragment, "tfhd"))));
+			const BOX decodeTime = FindBox(data, trackFragment, "tfdt");
+			CHECK_EQUAL(1, data[decodeTime.Position + 8]);
+			CHECK_EQUAL(isVideo ? videoStarts[fragment] : audioStarts[fragment], ReadU64(data, GetFields(decodeTime)));
+			const BOX run = FindBox(data, trackFragment, "trun");
+			const uint32_t sampleCount = ReadU32(data, GetFields(run));
+			CHECK_EQUAL(isVideo ? videoCounts[fragment] : audioCounts[fragment], sampleCount);
+			//The data offset is relative to the movie fragment, and the samples of each track follow each other in the media data.
+			const size_t dataPosition = movieFragment.Position + ReadU32(data, GetFields(run) + 4);
+			CHECK_EQUAL(mediaData.Position + mediaData.HeaderSize + sampleBytes, dataPosition);
+			for (uint32_t i = 0; i < sampleCount; i++) {
+				const size_t sample = GetFields(run) + 8 + i * 12;
+				CHECK_EQUAL(isVideo ? 3000u : 1024u, ReadU32(data, sample));
+				const bool isKeyFrame = !isVideo || (fragment * 20 + i) % 10 == 0;
+				CHECK_EQUAL(isKeyFrame ? KEY_SAMPLE_FLAGS : NON_KEY_SAMPLE_FLAGS, ReadU32(data, sample + 8));
+				if (isVideo) {
+					CHECK_EQUAL(fragment * 20 + i, data[mediaData.Position + mediaData.HeaderSize + sampleBytes + 6]);
+				}
+				sampleBytes += ReadU32(data, sample + 4);
+			}
+		}
+		CHECK_EQUAL(mediaData.Size - mediaData.HeaderSize, sampleBytes);
+	}
+}
+
+TEST(HevcFileHasParameterSets)
+{
+	RECORDING recording = Record(MP4_MUXER_OPTIONS{}, VideoCodec::HEVC);
+	CHECK(recording.IsFinalized);
+	const std::vector<uint8_t> &data = recording.Data;
+	const BOX video = FindBox(data, GetFileBox(data), "moov/trak");
+	const BOX configuration = FindBox(data, video, "mdia/minf/stbl/stsd/hvc1/hvcC");
+	CHECK(configuration.Size > 0);
+	//The parameter set arrays of the VPS, SPS and PPS.
+	CHECK_EQUAL(3, data[configuration.Position + configuration.HeaderSize + 22]);
+	CHECK_EQUAL(30u, ReadU32(data, GetFields(FindBox(data, video, "mdia/minf/stbl/stts")) + 4));
+}
+
+TEST(WritesAreBatched)
+{
+	MP4_MUXER_OPTIONS options{};
+	options.WriteBufferSize = 4096;
+	RECORDING buffered = Record(options);
+	options.WriteBufferSize = 0;
+	RECORDING unbuffered = Record(options);
+	CHECK(buffered.Data == unbuffered.Data);
+	//The whole file fits the buffer, so the media data is written when the file is finalized, followed by the movie box.
+	CHECK_EQUAL(2, buffered.OutputWriteCount);
+	CHECK(unbuffered.OutputWriteCount > 77);
+	CHECK_EQUAL(static_cast<uint64_t>(buffered.Data.size()), buffered.Statistics.ByteCount);
+}
+
+TEST(FileWithoutKeyFrameIsNotFinalized)
+{
+	std::vector<uint8_t> data{};
+	Mp4Muxer muxer(std::unique_ptr<MuxerOutput>(new MemoryOutput(data)), MP4_MUXER_OPTIONS{}, MP4_VIDEO_TRACK{ VideoCodec::H264, 1280, 720, {} }, std::nullopt);
+	CHECK(muxer.WritePacket(ENCODED_PACKET{ PacketStream::Video, 0, FRAME_DURATION, false, CreateFrame(VideoCodec::H264, false, 0) }));
+	CHECK(!muxer.Finalize());
+	CHECK(data.empty());
+	//No packets are accepted after the muxer is finalized.
+	CHECK(!muxer.WritePacket(ENCODED_PACKET{ PacketStream::Video, FRAME_DURATION, FRAME_DURATION, true, CreateFrame(VideoCodec::H264, true, 1) }));
+}
\ No newline at end of file
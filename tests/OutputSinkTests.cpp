@@ -0,0 +1,225 @@
+#include "Test.h"
+#include "OutputSink.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+namespace {
+	const SINK_VIDEO_FORMAT VIDEO_FORMAT{ 6, 4, 30 };
+	const SINK_AUDIO_FORMAT AUDIO_FORMAT{ 48000, 2, 16 };
+	//One second in 100 nanosecond units, divided by the frame rate.
+	const int64_t FRAME_DURATION = 10000000 / 30;
+
+	//A BGRA frame with two bytes of padding at the end of each row, which the sinks must not copy.
+	std::vector<uint8_t> CreateFrame(uint8_t seed, int32_t *pStride) {
+		*pStride = VIDEO_FORMAT.Width * 4 + 2;
+		std::vector<uint8_t> frame(static_cast<size_t>(*pStride) * VIDEO_FORMAT.Height, 0xEE);
+		for (int32_t y = 0; y < VIDEO_FORMAT.Height; y++) {
+			for (int32_t i = 0; i < VIDEO_FORMAT.Width * 4; i++) {
+				frame[static_cast<size_t>(y) * *pStride + i] = static_cast<uint8_t>(seed + y * 31 + i);
+			}
+		}
+		return frame;
+	}
+
+	std::vector<uint8_t> ReadFile(const std::filesystem::path &path) {
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	uint32_t ReadLittleEndian(const std::vector<uint8_t> &data, size_t offset, int byteCount) {
+		uint32_t value = 0;
+		for (int i = 0; i < byteCount; i++) {
+			value |= static_cast<uint32_t>(data[offset + i]) << (8 * i);
+		}
+		return value;
+	}
+
+	//A directory for the files of one test, removed when the test ends.
+	struct TemporaryDirectory {
+		std::filesystem::path Path;
+		TemporaryDirectory(const char *name) :
+			Path(std::filesystem::temp_directory_path() / (std::string("OutputSinkTests-") + name))
+		{
+			std::filesystem::remove_all(Path);
+			std::filesystem::create_directories(Path);
+		}
+		~TemporaryDirectory() {
+			std::error_code error;
+			std::filesystem::remove_all(Path, error);
+		}
+	};
+}
+
+TEST(NullSinkCountsFramesAndAudio)
+{
+	NullSink sink;
+	CHECK(!sink.IsFrameDataRequired());
+	CHECK(sink.Begin(VIDEO_FORMAT, AUDIO_FORMAT));
+	for (int i = 0; i < 5; i++) {
+		CHECK(sink.WriteVideoFrame(1000 + i * FRAME_DURATION, FRAME_DURATION, nullptr, 0));
+	}
+	const uint8_t audio[64] = {};
+	CHECK(sink.WriteAudio(1000, audio, sizeof(audio)));
+	CHECK(sink.WriteAudio(1000 + FRAME_DURATION, nullptr, 32));
+	NULL_SINK_STATISTICS stats = sink.GetStatistics();
+	CHECK_EQUAL(5u, stats.VideoFrameCount);
+	CHECK_EQUAL(96u, stats.AudioByteCount);
+	CHECK_EQUAL(1000, stats.FirstTimestamp);
+	CHECK_EQUAL(1000 + 5 * FRAME_DURATION, stats.LastTimestamp);
+	CHECK(stats.ElapsedTime >= 0);
+	CHECK(sink.Finalize());
+
+	//A new recording starts counting again.
+	CHECK(sink.Begin(VIDEO_FORMAT, std::nullopt));
+	CHECK(sink.WriteVideoFrame(0, FRAME_DURATION, nullptr, 0));
+	stats = sink.GetStatistics();
+	CHECK_EQUAL(1u, stats.VideoFrameCount);
+	CHECK_EQUAL(0u, stats.AudioByteCount);
+	CHECK_EQUAL(0, stats.FirstTimestamp);
+}
+
+TEST(MemorySinkKeepsPackedFrames)
+{
+	MemorySink sink;
+	CHECK(sink.IsFrameDataRequired());
+	CHECK(sink.Begin(VIDEO_FORMAT, AUDIO_FORMAT));
+	CHECK_EQUAL(VIDEO_FORMAT.Width, sink.GetVideoFormat().Width);
+	CHECK(sink.GetAudioFormat().has_value() && sink.GetAudioFormat()->SamplesPerSecond == AUDIO_FORMAT.SamplesPerSecond);
+	int32_t stride = 0;
+	std::vector<uint8_t> first = CreateFrame(1, &stride);
+	std::vector<uint8_t> second = CreateFrame(2, &stride);
+	CHECK(sink.WriteVideoFrame(0, FRAME_DURATION, first.data(), stride));
+	CHECK(sink.WriteVideoFrame(FRAME_DURATION, FRAME_DURATION * 2, second.data(), stride));
+	CHECK(!sink.WriteVideoFrame(FRAME_DURATION * 3, FRAME_DURATION, nullptr, stride));
+	const uint8_t audio[6] = { 1, 2, 3, 4, 5, 6 };
+	CHECK(sink.WriteAudio(0, audio, 4));
+	CHECK(sink.WriteAudio(FRAME_DURATION, audio + 4, 2));
+	CHECK(sink.Finalize());
+
+	std::vector<SINK_VIDEO_FRAME> frames = sink.GetFrames();
+	CHECK_EQUAL(2u, frames.size());
+	CHECK_EQUAL(2u, sink.GetVideoFrameCount());
+	if (frames.size() == 2) {
+		CHECK_EQUAL(FRAME_DURATION, frames[1].Timestamp);
+		CHECK_EQUAL(FRAME_DURATION * 2, frames[1].Duration);
+		const size_t rowSize = static_cast<size_t>(VIDEO_FORMAT.Width) * 4;
+		CHECK_EQUAL(rowSize * VIDEO_FORMAT.Height, frames[0].Data.size());
+		for (int32_t y = 0; y < VIDEO_FORMAT.Height; y++) {
+			CHECK(std::equal(frames[0].Data.begin() + y * rowSize, frames[0].Data.begin() + (y + 1) * rowSize, first.begin() + static_cast<size_t>(y) * stride));
+			CHECK(std::equal(frames[1].Data.begin() + y * rowSize, frames[1].Data.begin() + (y + 1) * rowSize, second.begin() + static_cast<size_t>(y) * stride));
+		}
+	}
+	CHECK(sink.GetAudio() == std::vector<uint8_t>(audio, audio + 6));
+}
+
+TEST(MemorySinkCountsFramesPastLimit)
+{
+	MemorySink sink(2);
+	CHECK(sink.Begin(VIDEO_FORMAT, std::nullopt));
+	CHECK(!sink.GetAudioFormat().has_value());
+	int32_t stride = 0;
+	std::vector<uint8_t> frame = CreateFrame(3, &stride);
+	for (int i = 0; i < 5; i++) {
+		CHECK(sink.WriteVideoFrame(i * FRAME_DURATION, FRAME_DURATION, frame.data(), stride));
+	}
+	CHECK_EQUAL(2u, sink.GetFrames().size());
+	CHECK_EQUAL(5u, sink.GetVideoFrameCount());
+	CHECK(sink.Begin(VIDEO_FORMAT, std::nullopt));
+	CHECK_EQUAL(0u, sink.GetFrames().size());
+	CHECK_EQUAL(0u, sink.GetVideoFrameCount());
+}
+
+TEST(RawFileSinkWritesY4M)
+{
+	TemporaryDirectory directory("Y4M");
+	const std::filesystem::path videoPath = directory.Path / "video.y4m";
+	int32_t stride = 0;
+	std::vector<uint8_t> frame = CreateFrame(4, &stride);
+	{
+		RawFileSink sink(videoPath, "");
+		CHECK(sink.IsFrameDataRequired());
+		CHECK(sink.Begin(VIDEO_FORMAT, AUDIO_FORMAT));
+		for (int i = 0; i < 3; i++) {
+			CHECK(sink.WriteVideoFrame(i * FRAME_DURATION, FRAME_DURATION, frame.data(), stride));
+		}
+		CHECK(!sink.WriteVideoFrame(3 * FRAME_DURATION, FRAME_DURATION, nullptr, stride));
+		//Audio is discarded without a WAV path.
+		const uint8_t audio[4] = {};
+		CHECK(sink.WriteAudio(0, audio, sizeof(audio)));
+		CHECK(sink.Finalize());
+	}
+	std::vector<uint8_t> file = ReadFile(videoPath);
+	const std::string header = "YUV4MPEG2 W6 H4 F30:1 Ip A1:1 C420mpeg2 XCOLORRANGE=LIMITED\n";
+	CHECK(file.size() > header.size() && std::string(file.begin(), file.begin() + header.size()) == header);
+
+	//Each frame is the I420 conversion of the source, after a frame header.
+	ColorConverter converter;
+	converter.SetOptions(YUVFormat::I420, YUVColorMatrix::BT709, YUVRange::Limited, ChromaSiting::Left);
+	size_t frameSize = 0;
+	const uint8_t *pExpected = converter.Convert(frame.data(), stride, VIDEO_FORMAT.Width, VIDEO_FORMAT.Height, &frameSize);
+	CHECK_EQUAL(static_cast<size_t>(6 * 4 + 3 * 2 * 2), frameSize);
+	CHECK_EQUAL(header.size() + 3 * (6 + frameSize), file.size());
+	for (size_t i = 0; i < 3 && file.size() == header.size() + 3 * (6 + frameSize); i++) {
+		const size_t offset = header.size() + i * (6 + frameSize);
+		CHECK(std::string(file.begin() + offset, file.begin() + offset + 6) == "FRAME\n");
+		CHECK(std::equal(pExpected, pExpected + frameSize, file.begin() + offset + 6));
+	}
+	CHECK(!std::filesystem::exists(directory.Path / "audio.wav"));
+}
+
+TEST(RawFileSinkPatchesWavSizes)
+{
+	TemporaryDirectory directory("WAV");
+	const std::filesystem::path audioPath = directory.Path / "audio.wav";
+	std::vector<uint8_t> audio(1000);
+	for (size_t i = 0; i < audio.size(); i++) {
+		audio[i] = static_cast<uint8_t>(i * 7);
+	}
+	RawFileSink sink(directory.Path / "video.y4m", audioPath);
+	CHECK(sink.Begin(VIDEO_FORMAT, AUDIO_FORMAT));
+	CHECK(sink.WriteAudio(0, audio.data(), 600));
+	CHECK(sink.WriteAudio(FRAME_DURATION, audio.data() + 600, 400));
+	CHECK(sink.Finalize());
+
+	std::vector<uint8_t> file = ReadFile(audioPath);
+	CHECK_EQUAL(44u + audio.size(), file.size());
+	if (file.size() == 44 + audio.size()) {
+		CHECK(std::string(file.begin(), file.begin() + 4) == "RIFF");
+		CHECK_EQUAL(36u + audio.size(), ReadLittleEndian(file, 4, 4));
+		CHECK(std::string(file.begin() + 8, file.begin() + 16) == "WAVEfmt ");
+		CHECK_EQUAL(16u, ReadLittleEndian(file, 16, 4));
+		//PCM, with the format of the recording.
+		CHECK_EQUAL(1u, ReadLittleEndian(file, 20, 2));
+		CHECK_EQUAL(2u, ReadLittleEndian(file, 22, 2));
+		CHECK_EQUAL(48000u, ReadLittleEndian(file, 24, 4));
+		CHECK_EQUAL(48000u * 4, ReadLittleEndian(file, 28, 4));
+		CHECK_EQUAL(4u, ReadLittleEndian(file, 32, 2));
+		CHECK_EQUAL(16u, ReadLittleEndian(file, 34, 2));
+		CHECK(std::string(file.begin() + 36, file.begin() + 40) == "data");
+		CHECK_EQUAL(audio.size(), ReadLittleEndian(file, 40, 4));
+		CHECK(std::equal(audio.begin(), audio.end(), file.begin() + 44));
+	}
+
+	//A second recording replaces the files, and the sizes start over.
+	CHECK(sink.Begin(VIDEO_FORMAT, AUDIO_FORMAT));
+	CHECK(sink.WriteAudio(0, audio.data(), 100));
+	CHECK(sink.Finalize());
+	file = ReadFile(audioPath);
+	CHECK_EQUAL(144u, file.size());
+	if (file.size() == 144) {
+		CHECK_EQUAL(136u, ReadLittleEndian(file, 4, 4));
+		CHECK_EQUAL(100u, ReadLittleEndian(file, 40, 4));
+	}
+}
+
+TEST(RawFileSinkFailsForMissingDirectory)
+{
+	TemporaryDirectory directory("Missing");
+	RawFileSink sink(directory.Path / "missing" / "video.y4m", "");
+	CHECK(!sink.Begin(VIDEO_FORMAT, std::nullopt));
+	int32_t stride = 0;
+	std::vector<uint8_t> frame = CreateFrame(5, &stride);
+	CHECK(!sink.WriteVideoFrame(0, FRAME_DURATION, frame.data(), stride));
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "Test.h"
+#include "PacingTimer.h"
+#include <thread>
+
+using namespace std::chrono;
+
+namespace {
+	//The slack allowed for a tick to be late, so a loaded machine does not fail the tests. Ticks must never be early.
+	const milliseconds MAX_LATENESS = milliseconds(200);
+
+	nanoseconds GetPeriodOffset(uint64_t tickIndex, uint64_t periodNumerator, uint64_t periodDenominator) {
+		return nanoseconds(tickIndex * periodNumerator * 1000000000ull / periodDenominator);
+	}
+}
+
+TEST(TicksAreNotEarly)
+{
+	//59.94 fps, a period that is not a whole number of milliseconds.
+	PacingTimer timer;
+	const auto before = steady_clock::now();
+	timer.Start(1001, 60000);
+	const auto after = steady_clock::now();
+	for (uint64_t i = 0; i < 10; i++) {
+		CHECK(timer.WaitForNextTick());
+		const auto now = steady_clock::now();
+		CHECK(now >= before + GetPeriodOffset(i, 1001, 60000));
+		CHECK(now < after + GetPeriodOffset(i, 1001, 60000) + MAX_LATENESS);
+	}
+	CHECK_EQUAL(10u, timer.GetTickCount() + timer.GetSkippedTickCount());
+	CHECK_EQUAL(timer.GetTickCount(), timer.GetJitter().Count);
+}
+
+TEST(FirstTickIsImmediate)
+{
+	PacingTimer timer;
+	timer.Start(10, 1);
+	const auto start = steady_clock::now();
+	CHECK(timer.WaitForNextTick());
+	CHECK(steady_clock::now() - start < MAX_LATENESS);
+	//The next tick is a full period away.
+	CHECK(timer.GetTimeUntilNextTick() > seconds(9));
+}
+
+TEST(MissedTicksAreSkipped)
+{
+	PacingTimer timer;
+	timer.SetSpinTolerance(microseconds(0));
+	const auto before = steady_clock::now();
+	timer.Start(1, 100);
+	CHECK(timer.WaitForNextTick());
+	std::this_thread::sleep_for(milliseconds(55));
+	//The late tick is reached at once, and the ticks that passed while sleeping are skipped.
+	CHECK(timer.WaitForNextTick());
+	CHECK_EQUAL(2u, timer.GetTickCount());
+	const uint64_t skippedCount = timer.GetSkippedTickCount();
+	CHECK(skippedCount >= 4);
+	CHECK(timer.GetTimeUntilNextTick() <= milliseconds(10));
+	//The next tick stays on the original schedule.
+	CHECK(timer.WaitForNextTick());
+	CHECK(steady_clock::now() >= before + GetPeriodOffset(2 + skippedCount, 1, 100));
+	CHECK_EQUAL(3u, timer.GetTickCount());
+}
+
+TEST(WaitIsCanceled)
+{
+	PacingTimer timer;
+	SyncEvent cancel(true);
+	timer.Start(60, 1);
+	CHECK(timer.WaitForNextTick(&cancel));
+	std::thread canceler([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		cancel.Set();
+	});
+	const auto start = steady_clock::now();
+	CHECK(!timer.WaitForNextTick(&cancel));
+	CHECK(steady_clock::now() - start < seconds(30));
+	canceler.join();
+	CHECK_EQUAL(1u, timer.GetTickCount());
+	CHECK_EQUAL(0u, timer.GetSkippedTickCount());
+}
+
+TEST(RestartResetsCounts)
+{
+	PacingTimer timer;
+	timer.Start(1, 1000);
+	for (int i = 0; i < 3; i++) {
+		CHECK(timer.WaitForNextTick());
+	}
+	timer.Start(1, 1000);
+	CHECK_EQUAL(0u, timer.GetTickCount());
+	CHECK_EQUAL(0u, timer.GetSkippedTickCount());
+	CHECK_EQUAL(0u, timer.GetJitter().Count);
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "Test.h"
+#include "PreviewDeliveryQueue.h"
+#include <thread>
+
+namespace {
+	std::unique_ptr<PREVIEW_BUFFER> CreatePreview(PreviewDeliveryQueue &queue, int frameNumber) {
+		std::unique_ptr<PREVIEW_BUFFER> pPreview = queue.AcquireBuffer();
+		pPreview->Data.assign(16, static_cast<uint8_t>(frameNumber));
+		pPreview->Width = 2;
+		pPreview->Height = 2;
+		pPreview->Stride = 8;
+		return pPreview;
+	}
+
+	struct DELIVERED_FRAME {
+		int FrameNumber;
+		//The frame number the preview was made for, or -1 if the frame had no preview.
+		int PreviewFrameNumber;
+	};
+
+	//Takes the frames from the queue until it is stopped, as the delivery thread does.
+	std::vector<DELIVERED_FRAME> DeliverAll(PreviewDeliveryQueue &queue) {
+		std::vector<DELIVERED_FRAME> delivered{};
+		QUEUED_PREVIEW_FRAME frame{};
+		while (queue.Pop(&frame)) {
+			delivered.push_back(DELIVERED_FRAME{ frame.FrameNumber, frame.Preview ? frame.Preview->Data[0] : -1 });
+			queue.ReleaseBuffer(std::move(frame.Preview));
+		}
+		return delivered;
+	}
+}
+
+TEST(FramesQueuedBeforeStopAreDelivered)
+{
+	PreviewDeliveryQueue queue(2, 64);
+	std::vector<DELIVERED_FRAME> delivered{};
+	std::thread deliveryThread([&]() { delivered = DeliverAll(queue); });
+	for (int i = 0; i < 20; i++) {
+		queue.Push(i, i * 10, i % 2 == 0 ? CreatePreview(queue, i) : nullptr);
+	}
+	//Stopped right after the last frame is queued, which is still delivered with its preview.
+	queue.Push(20, 200, CreatePreview(queue, 20));
+	queue.Stop();
+	deliveryThread.join();
+	CHECK_EQUAL(21u, delivered.size());
+	for (size_t i = 0; i < delivered.size(); i++) {
+		CHECK_EQUAL(static_cast<int>(i), delivered[i].FrameNumber);
+	}
+	CHECK(!delivered.empty() && delivered.back().PreviewFrameNumber == 20);
+}
+
+TEST(SlowConsumerGetsLatestPreviews)
+{
+	PreviewDeliveryQueue queue(2, 64);
+	for (int i = 0; i < 5; i++) {
+		queue.Push(i, i, CreatePreview(queue, i));
+	}
+	queue.Stop();
+	std::vector<DELIVERED_FRAME> delivered = DeliverAll(queue);
+	//Every frame number is delivered, but only the last two with their preview.
+	const int expectedPreviews[]{ -1, -1, -1, 3, 4 };
+	CHECK_EQUAL(5u, delivered.size());
+	for (size_t i = 0; i < 5 && i < delivered.size(); i++) {
+		CHECK_EQUAL(static_cast<int>(i), delivered[i].FrameNumber);
+		CHECK_EQUAL(expectedPreviews[i], delivered[i].PreviewFrameNumber);
+	}
+	CHECK_EQUAL(3u, queue.GetDroppedPreviewCount());
+}
+
+TEST(FullQueueDropsOldestFrames)
+{
+	PreviewDeliveryQueue queue(10, 4);
+	queue.Push(0, 0, CreatePreview(queue, 0));
+	for (int i = 1; i < 6; i++) {
+		queue.Push(i, i, nullptr);
+	}
+	queue.Stop();
+	std::vector<DELIVERED_FRAME> delivered = DeliverAll(queue);
+	CHECK_EQUAL(4u, delivered.size());
+	CHECK(!delivered.empty() && delivered.front().FrameNumber == 2);
+	//Only the dropped frame that had a preview counts as a dropped preview.
+	CHECK_EQUAL(1u, queue.GetDroppedPreviewCount());
+}
+
+TEST(FramesAfterStopAreDropped)
+{
+	PreviewDeliveryQueue queue(2, 64);
+	queue.Stop();
+	queue.Push(0, 0, CreatePreview(queue, 0));
+	queue.Push(1, 1, nullptr);
+	QUEUED_PREVIEW_FRAME frame{};
+	CHECK(!queue.Pop(&frame));
+	CHECK_EQUAL(1u, queue.GetDroppedPreviewCount());
+	queue.Restart();
+	queue.Push(2, 2, CreatePreview(queue, 2));
+	queue.Stop();
+	std::vector<DELIVERED_FRAME> delivered = DeliverAll(queue);
+	CHECK_EQUAL(1u, delivered.size());
+	CHECK(!delivered.empty() && delivered[0].FrameNumber == 2 && delivered[0].PreviewFrameNumber == 2);
+}
+
+TEST(PreviewBuffersAreReused)
+{
+	PreviewDeliveryQueue queue(2, 64);
+	std::unique_ptr<PREVIEW_BUFFER> pPreview = CreatePreview(queue, 0);
+	pPreview->Data.resize(4096);
+	const PREVIEW_BUFFER *pBuffer = pPreview.get();
+	queue.Push(0, 0, std::move(pPreview));
+	QUEUED_PREVIEW_FRAME frame{};
+	CHECK(queue.Pop(&frame));
+	queue.ReleaseBuffer(std::move(frame.Preview));
+	std::unique_ptr<PREVIEW_BUFFER> pReused = queue.AcquireBuffer();
+	CHECK(pReused.get() == pBuffer);
+	CHECK(pReused->Data.capacity() >= 4096);
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "Test.h"
+#include "ReplayBuffer.h"
+#include <thread>
+
+namespace {
+	//100 fps, in 100 nanosecond units.
+	const int64_t FRAME_DURATION = 100000;
+
+	ENCODED_PACKET VideoPacket(int64_t frameIndex, bool isKeyFrame, size_t size) {
+		return ENCODED_PACKET{ PacketStream::Video, frameIndex * FRAME_DURATION, FRAME_DURATION, isKeyFrame, std::vector<uint8_t>(size, static_cast<uint8_t>(frameIndex)) };
+	}
+
+	ENCODED_PACKET AudioPacket(int64_t frameIndex, size_t size) {
+		return ENCODED_PACKET{ PacketStream::Audio, frameIndex * FRAME_DURATION, FRAME_DURATION, false, std::vector<uint8_t>(size) };
+	}
+}
+
+TEST(PacketsBeforeFirstKeyFrameAreDiscarded)
+{
+	ReplayBuffer buffer(0, 0);
+	CHECK(!buffer.AddPacket(VideoPacket(0, false, 10)));
+	CHECK(!buffer.AddPacket(AudioPacket(0, 4)));
+	CHECK(buffer.AddPacket(VideoPacket(1, true, 10)));
+	CHECK(buffer.AddPacket(AudioPacket(1, 4)));
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	CHECK_EQUAL(2u, stats.DiscardedPacketCount);
+	CHECK_EQUAL(2u, stats.PacketCount);
+	CHECK_EQUAL(14u, stats.ByteCount);
+	CHECK_EQUAL(FRAME_DURATION, stats.StartTimestamp);
+	CHECK_EQUAL(2 * FRAME_DURATION, stats.EndTimestamp);
+}
+
+TEST(DurationLimitEvictsWholeGops)
+{
+	//A key frame every 5 frames, and 10 frames of history.
+	ReplayBuffer buffer(10 * FRAME_DURATION, 0);
+	for (int64_t i = 0; i < 30; i++) {
+		CHECK(buffer.AddPacket(VideoPacket(i, i % 5 == 0, 10)));
+		CHECK(buffer.AddPacket(AudioPacket(i, 4)));
+	}
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	//The groups at 20 and 25 cover exactly 10 frames, so the group at 15 is no longer needed.
+	CHECK_EQUAL(2u, stats.GopCount);
+	CHECK_EQUAL(20 * FRAME_DURATION, stats.StartTimestamp);
+	CHECK_EQUAL(30 * FRAME_DURATION, stats.EndTimestamp);
+	CHECK_EQUAL(4u, stats.EvictedGopCount);
+	CHECK_EQUAL(20u, stats.PacketCount);
+	CHECK_EQUAL(140u, stats.ByteCount);
+	CHECK_EQUAL(0u, stats.DiscardedPacketCount);
+
+	//One frame into the next group, the window of 10 frames starts in the group at 20, which is kept.
+	CHECK(buffer.AddPacket(VideoPacket(30, true, 10)));
+	stats = buffer.GetStatistics();
+	CHECK_EQUAL(3u, stats.GopCount);
+	CHECK_EQUAL(20 * FRAME_DURATION, stats.StartTimestamp);
+}
+
+TEST(ByteLimitEvictsWholeGops)
+{
+	//Groups of 4 frames of 10 bytes.
+	ReplayBuffer buffer(0, 100);
+	for (int64_t i = 0; i < 20; i++) {
+		CHECK(buffer.AddPacket(VideoPacket(i, i % 4 == 0, 10)));
+		REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+		CHECK(stats.ByteCount <= 100);
+	}
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	//The last two groups are 80 bytes, and a third would exceed the limit.
+	CHECK_EQUAL(2u, stats.GopCount);
+	CHECK_EQUAL(80u, stats.ByteCount);
+	CHECK_EQUAL(12 * FRAME_DURATION, stats.StartTimestamp);
+	CHECK_EQUAL(3u, stats.EvictedGopCount);
+}
+
+TEST(OversizedGopIsDiscarded)
+{
+	ReplayBuffer buffer(0, 50);
+	CHECK(buffer.AddPacket(VideoPacket(0, true, 30)));
+	//The group exceeds the limit alone, so it is discarded, and the rest of it can not be decoded.
+	CHECK(!buffer.AddPacket(VideoPacket(1, false, 30)));
+	CHECK(!buffer.AddPacket(VideoPacket(2, false, 5)));
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	CHECK_EQUAL(0u, stats.GopCount);
+	CHECK_EQUAL(0u, stats.ByteCount);
+	CHECK_EQUAL(0u, stats.PacketCount);
+	CHECK_EQUAL(3u, stats.DiscardedPacketCount);
+	CHECK(buffer.GetPackets().empty());
+	CHECK(buffer.AddPacket(VideoPacket(3, true, 20)));
+	CHECK_EQUAL(1u, buffer.GetStatistics().GopCount);
+}
+
+TEST(PacketsAreReturnedInOrderFromKeyFrame)
+{
+	ReplayBuffer buffer(6 * FRAME_DURATION, 0);
+	for (int64_t i = 0; i < 17; i++) {
+		buffer.AddPacket(VideoPacket(i, i % 3 == 0, 8));
+		buffer.AddPacket(AudioPacket(i, 2));
+	}
+	std::vector<std::shared_ptr<const ENCODED_PACKET>> packets = buffer.GetPackets();
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	CHECK_EQUAL(stats.PacketCount, packets.size());
+	CHECK(!packets.empty() && packets[0]->Stream == PacketStream::Video && packets[0]->IsKeyFrame);
+	CHECK(!packets.empty() && packets[0]->Timestamp == stats.StartTimestamp);
+	//Video and audio alternate as they were added, with rising timestamps.
+	for (size_t i = 1; i < packets.size(); i++) {
+		CHECK(packets[i]->Stream == (i % 2 == 0 ? PacketStream::Video : PacketStream::Audio));
+		CHECK_EQUAL(packets[i - 1]->Timestamp + (i % 2 == 0 ? FRAME_DURATION : 0), packets[i]->Timestamp);
+	}
+	CHECK(!packets.empty() && packets.back()->Timestamp + packets.back()->Duration == stats.EndTimestamp);
+}
+
+TEST(SnapshotIsNotChangedByLaterPackets)
+{
+	ReplayBuffer buffer(2 * FRAME_DURATION, 0);
+	buffer.AddPacket(VideoPacket(0, true, 8));
+	buffer.AddPacket(VideoPacket(1, false, 8));
+	std::vector<std::shared_ptr<const ENCODED_PACKET>> packets = buffer.GetPackets();
+	for (int64_t i = 2; i < 10; i++) {
+		buffer.AddPacket(VideoPacket(i, true, 8));
+	}
+	//The evicted packets are still held by the snapshot.
+	CHECK_EQUAL(2u, packets.size());
+	CHECK_EQUAL(0, packets[0]->Timestamp);
+	CHECK_EQUAL(0, packets[0]->Data[0]);
+	CHECK_EQUAL(FRAME_DURATION, packets[1]->Timestamp);
+	CHECK(buffer.GetPackets()[0]->Timestamp > FRAME_DURATION);
+}
+
+TEST(ClearResetsBuffer)
+{
+	ReplayBuffer buffer(0, 0);
+	buffer.AddPacket(VideoPacket(0, false, 8));
+	buffer.AddPacket(VideoPacket(1, true, 8));
+	buffer.Clear();
+	REPLAY_BUFFER_STATISTICS stats = buffer.GetStatistics();
+	CHECK_EQUAL(0u, stats.PacketCount);
+	CHECK_EQUAL(0u, stats.GopCount);
+	CHECK_EQUAL(0u, stats.DiscardedPacketCount);
+	CHECK(buffer.GetPackets().empty());
+}
+
+TEST(PacketsCanBeReadWhileAdded)
+{
+	ReplayBuffer buffer(10 * FRAME_DURATION, 0);
+	std::thread writer([&]() {
+		for (int64_t i = 0; i < 5000; i++) {
+			buffer.AddPacket(VideoPacket(i, i % 5 == 0, 16));
+		}
+	});
+	bool isAlwaysKeyFrame = true;
+	for (int i = 0; i < 200; i++) {
+		std::vector<std::shared_ptr<const ENCODED_PACKET>> packets = buffer.GetPackets();
+		if (!packets.empty() && !packets[0]->IsKeyFrame) {
+			isAlwaysKeyFrame = false;
+		}
+	}
+	writer.join();
+	CHECK(isAlwaysKeyFrame);
+	CHECK_EQUAL(2u, buffer.GetStatistics().GopCount);
+}
\ No newline at end of file
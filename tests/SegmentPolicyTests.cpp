@@ -0,0 +1,107 @@
+#include "Test.h"
+#include "SegmentPolicy.h"
+#include <filesystem>
+
+namespace {
+	const int64_t ONE_SECOND = 10000000;
+}
+
+TEST(FirstFrameBeginsFirstSegment)
+{
+	SegmentPolicy policy;
+	policy.Begin(60 * ONE_SECOND, 0);
+	CHECK(!policy.IsStarted());
+	CHECK(policy.Update(3 * ONE_SECOND, 0) == SegmentAction::None);
+	CHECK(policy.IsStarted());
+	CHECK_EQUAL(3 * ONE_SECOND, policy.GetSegmentStartPos());
+	//Begin starts over.
+	policy.Begin(60 * ONE_SECOND, 0);
+	CHECK(!policy.IsStarted());
+}
+
+TEST(SegmentEndsAtMaxDuration)
+{
+	SegmentPolicy policy;
+	policy.Begin(60 * ONE_SECOND, 0);
+	CHECK(policy.Update(ONE_SECOND, 0) == SegmentAction::None);
+	CHECK(policy.Update(30 * ONE_SECOND, 0) == SegmentAction::None);
+	//The next segment is prepared 5 seconds before the end, and only once.
+	CHECK(policy.Update(56 * ONE_SECOND - 1, 0) == SegmentAction::None);
+	CHECK(policy.Update(56 * ONE_SECOND, 0) == SegmentAction::PrepareNext);
+	CHECK(policy.Update(57 * ONE_SECOND, 0) == SegmentAction::None);
+	CHECK(policy.Update(61 * ONE_SECOND - 1, 0) == SegmentAction::None);
+	CHECK(policy.Update(61 * ONE_SECOND, 0) == SegmentAction::StartNext);
+	//The segment is not switched until BeginNextSegment is called.
+	CHECK(policy.Update(61 * ONE_SECOND + 1, 0) == SegmentAction::StartNext);
+	policy.BeginNextSegment(61 * ONE_SECOND);
+	CHECK_EQUAL(61 * ONE_SECOND, policy.GetSegmentStartPos());
+	CHECK(policy.Update(62 * ONE_SECOND, 0) == SegmentAction::None);
+	CHECK(policy.Update(116 * ONE_SECOND, 0) == SegmentAction::PrepareNext);
+	CHECK(policy.Update(121 * ONE_SECOND, 0) == SegmentAction::StartNext);
+}
+
+TEST(PrepareWindowIsHalfOfShortSegments)
+{
+	SegmentPolicy policy;
+	policy.Begin(4 * ONE_SECOND, 0);
+	CHECK_EQUAL(2 * ONE_SECOND, policy.GetPrepareDuration());
+	CHECK(policy.Update(0, 0) == SegmentAction::None);
+	CHECK(policy.Update(2 * ONE_SECOND - 1, 0) == SegmentAction::None);
+	CHECK(policy.Update(2 * ONE_SECOND, 0) == SegmentAction::PrepareNext);
+	policy.Begin(60 * ONE_SECOND, 0);
+	CHECK_EQUAL(SegmentPolicy::MAX_PREPARE_DURATION, policy.GetPrepareDuration());
+	CHECK_EQUAL(5 * ONE_SECOND, SegmentPolicy::MAX_PREPARE_DURATION);
+}
+
+TEST(SegmentEndsAtMaxSize)
+{
+	SegmentPolicy policy;
+	policy.Begin(0, 1000);
+	CHECK(policy.IsSizeLimited());
+	CHECK(policy.Update(0, 0) == SegmentAction::None);
+	//Without a duration limit, a segment can be any length.
+	CHECK(policy.Update(3600 * ONE_SECOND, 899) == SegmentAction::None);
+	//The next segment is prepared at 90% of the size.
+	CHECK(policy.Update(3601 * ONE_SECOND, 900) == SegmentAction::PrepareNext);
+	CHECK(policy.Update(3602 * ONE_SECOND, 999) == SegmentAction::None);
+	CHECK(policy.Update(3603 * ONE_SECOND, 1000) == SegmentAction::StartNext);
+	policy.BeginNextSegment(3603 * ONE_SECOND);
+	CHECK(policy.Update(3604 * ONE_SECOND, 950) == SegmentAction::PrepareNext);
+}
+
+TEST(FirstLimitReachedEndsSegment)
+{
+	SegmentPolicy policy;
+	policy.Begin(60 * ONE_SECOND, 1000);
+	CHECK(policy.Update(0, 0) == SegmentAction::None);
+	CHECK(policy.Update(10 * ONE_SECOND, 1000) == SegmentAction::StartNext);
+	policy.BeginNextSegment(10 * ONE_SECOND);
+	CHECK(policy.Update(70 * ONE_SECOND, 10) == SegmentAction::StartNext);
+}
+
+TEST(UnlimitedSegmentNeverEnds)
+{
+	SegmentPolicy policy;
+	policy.Begin(0, 0);
+	CHECK(!policy.IsSizeLimited());
+	CHECK(policy.Update(0, 0) == SegmentAction::None);
+	CHECK(policy.Update(INT64_MAX, UINT64_MAX) == SegmentAction::None);
+}
+
+TEST(FrameStartsWithItsAudio)
+{
+	CHECK_EQUAL(90, SegmentPolicy::GetFrameStartPos(100, 90, true));
+	CHECK_EQUAL(100, SegmentPolicy::GetFrameStartPos(100, 110, true));
+	CHECK_EQUAL(100, SegmentPolicy::GetFrameStartPos(100, 90, false));
+}
+
+TEST(SegmentsAreNumberedNextToOutput)
+{
+	const std::filesystem::path folder = std::filesystem::path(L"recordings") / L"today";
+	const std::wstring outputPath = (folder / L"capture.mp4").wstring();
+	CHECK(SegmentPolicy::GetSegmentPath(outputPath, 0) == outputPath);
+	CHECK(SegmentPolicy::GetSegmentPath(outputPath, 1) == (folder / L"capture_001.mp4").wstring());
+	CHECK(SegmentPolicy::GetSegmentPath(outputPath, 42) == (folder / L"capture_042.mp4").wstring());
+	CHECK(SegmentPolicy::GetSegmentPath(outputPath, 1234) == (folder / L"capture_1234.mp4").wstring());
+	CHECK(SegmentPolicy::GetSegmentPath(L"capture", 2) == L"capture_002");
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "Test.h"
+#include "SlideshowManifest.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+	std::string GetFramePath(uint64_t index) {
+		return "C:\\Slideshow\\" + std::to_string(index) + ".png";
+	}
+
+	//The manifest as it should be when the frames up to the count are committed.
+	std::string GetExpectedManifest(uint64_t frameCount) {
+		std::string manifest;
+		for (uint64_t i = 0; i < frameCount; i++) {
+			manifest += SlideshowManifest::FormatLine(i, GetFramePath(i), static_cast<int64_t>(i) * 10);
+		}
+		return manifest;
+	}
+}
+
+TEST(LineIsEscapedJson)
+{
+	CHECK(SlideshowManifest::FormatLine(3, "C:\\a \"b\"\tc.png", -5) == "{\"frame\":3,\"path\":\"C:\\\\a \\\"b\\\"\\u0009c.png\",\"delay\":-5}\n");
+}
+
+TEST(FramesAreCommittedInOrder)
+{
+	std::ostringstream stream;
+	SlideshowManifest manifest;
+	manifest.Begin(&stream);
+	CHECK(manifest.AddFrame(1, GetFramePath(1), 10, true));
+	CHECK(manifest.AddFrame(2, GetFramePath(2), 20, true));
+	//Frames 1 and 2 wait for frame 0.
+	CHECK(stream.str().empty());
+	CHECK_EQUAL(0u, manifest.GetCommittedFrameCount());
+	CHECK_EQUAL(2u, manifest.GetWaitingFrameCount());
+	CHECK(manifest.AddFrame(0, GetFramePath(0), 0, true));
+	CHECK_EQUAL(3u, manifest.GetCommittedFrameCount());
+	CHECK_EQUAL(0u, manifest.GetWaitingFrameCount());
+	CHECK(stream.str() == GetExpectedManifest(3));
+}
+
+TEST(ManifestIsAppendedAsFramesAreCommitted)
+{
+	//Frames finish in a random order, and after each one the manifest holds exactly the frames before the first missing one.
+	std::mt19937 random(7);
+	std::vector<uint64_t> order(200);
+	for (size_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::shuffle(order.begin(), order.end(), random);
+	std::ostringstream stream;
+	SlideshowManifest manifest;
+	manifest.Begin(&stream);
+	std::vector<bool> isAdded(order.size(), false);
+	uint64_t firstMissing = 0;
+	int wrongManifestCount = 0;
+	for (uint64_t index : order) {
+		CHECK(manifest.AddFrame(index, GetFramePath(index), static_cast<int64_t>(index) * 10, true));
+		isAdded[index] = true;
+		while (firstMissing < isAdded.size() && isAdded[firstMissing]) {
+			firstMissing++;
+		}
+		wrongManifestCount += manifest.GetCommittedFrameCount() == firstMissing && stream.str() == GetExpectedManifest(firstMissing) ? 0 : 1;
+	}
+	CHECK_EQUAL(0, wrongManifestCount);
+	CHECK_EQUAL(order.size(), manifest.GetCommittedFrameCount());
+}
+
+TEST(FailedFrameDoesNotHoldUpLaterFrames)
+{
+	std::ostringstream stream;
+	SlideshowManifest manifest;
+	manifest.Begin(&stream);
+	CHECK(manifest.AddFrame(0, GetFramePath(0), 0, true));
+	CHECK(manifest.AddFrame(2, GetFramePath(2), 20, true));
+	//The failed frame is committed without a line.
+	CHECK(manifest.AddFrame(1, GetFramePath(1), 10, false));
+	CHECK_EQUAL(3u, manifest.GetCommittedFrameCount());
+	CHECK(stream.str() == SlideshowManifest::FormatLine(0, GetFramePath(0), 0) + SlideshowManifest::FormatLine(2, GetFramePath(2), 20));
+}
+
+TEST(StreamFailureIsReported)
+{
+	std::ostringstream stream;
+	SlideshowManifest manifest;
+	manifest.Begin(&stream);
+	CHECK(manifest.AddFrame(0, GetFramePath(0), 0, true));
+	stream.setstate(std::ios::badbit);
+	CHECK(!manifest.AddFrame(1, GetFramePath(1), 10, true));
+	//Frames are still committed, so waiting for them does not hang.
+	CHECK(!manifest.AddFrame(2, GetFramePath(2), 20, true));
+	CHECK_EQUAL(3u, manifest.GetCommittedFrameCount());
+	std::ostringstream nextStream;
+	manifest.Begin(&nextStream);
+	CHECK_EQUAL(0u, manifest.GetCommittedFrameCount());
+	CHECK(manifest.AddFrame(0, GetFramePath(0), 0, true));
+	CHECK(nextStream.str() == GetExpectedManifest(1));
+}
+
+TEST(BeginDiscardsWaitingFrames)
+{
+	std::ostringstream stream;
+	SlideshowManifest manifest;
+	manifest.Begin(&stream);
+	CHECK(manifest.AddFrame(1, GetFramePath(1), 10, true));
+	std::ostringstream nextStream;
+	manifest.Begin(&nextStream);
+	CHECK_EQUAL(0u, manifest.GetWaitingFrameCount());
+	CHECK(manifest.AddFrame(0, GetFramePath(0), 0, true));
+	CHECK(nextStream.str() == GetExpectedManifest(1));
+	CHECK(stream.str().empty());
+}
\ No newline at end of file
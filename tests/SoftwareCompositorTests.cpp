@@ -0,0 +1,354 @@
+#include "Test.h"
+#include "SoftwareCompositor.h"
+#include <algorithm>
+
+namespace {
+	/// <summary>
+	/// A BGRA image that owns its pixels. Rows are padded, so the stride is never assumed to equal the width.
+	/// </summary>
+	struct TestImage {
+		std::vector<uint32_t> Pixels;
+		BGRA_SURFACE Surface;
+		TestImage(int32_t width, int32_t height, uint32_t color = 0) :
+			Pixels(static_cast<size_t>(width + 3) * height, color),
+			Surface{}
+		{
+			Surface.Data = reinterpret_cast<uint8_t *>(Pixels.data());
+			Surface.Stride = (width + 3) * 4;
+			Surface.Width = width;
+			Surface.Height = height;
+		}
+		uint32_t &At(int32_t x, int32_t y) { return Pixels[static_cast<size_t>(y) * (Surface.Width + 3) + x]; }
+	};
+
+	//A deterministic pattern with every channel and alpha value varying, so all blend and filter cases are covered.
+	TestImage CreatePattern(int32_t width, int32_t height, uint32_t seed) {
+		TestImage image(width, height);
+		uint32_t state = seed;
+		for (int32_t y = 0; y < height; y++) {
+			for (int32_t x = 0; x < width; x++) {
+				state = state * 1664525u + 1013904223u;
+				image.At(x, y) = state;
+			}
+		}
+		return image;
+	}
+
+	uint32_t Channel(uint32_t pixel, int channel) {
+		return (pixel >> (channel * 8)) & 0xFF;
+	}
+
+	//Rounds value / 255 to the nearest integer.
+	uint32_t DivideRounded255(uint32_t value) {
+		return (2 * value + 255) / 510;
+	}
+
+	//The reference images below are computed per pixel from the formulas in SoftwareCompositor.h, independently of the row kernels.
+	uint32_t ReferencePremultiplied(uint32_t s, uint32_t d) {
+		uint32_t pixel = 0;
+		for (int channel = 0; channel < 4; channel++) {
+			uint32_t value = Channel(s, channel) + DivideRounded255(Channel(d, channel) * (255 - Channel(s, 3)));
+			pixel |= std::min<uint32_t>(value, 255) << (channel * 8);
+		}
+		return pixel;
+	}
+
+	uint32_t ReferenceStraight(uint32_t s, uint32_t d) {
+		const uint32_t alpha = Channel(s, 3);
+		uint32_t pixel = alpha << 24;
+		for (int channel = 0; channel < 3; channel++) {
+			pixel |= DivideRounded255(Channel(s, channel) * alpha + Channel(d, channel) * (255 - alpha)) << (channel * 8);
+		}
+		return pixel;
+	}
+
+	//The source position of a destination pixel center, (index + 0.5) * srcLength / dstLength - 0.5, in 16.16 fixed point, with the 8 bit weight the compositor interpolates with.
+	void ReferenceTap(int32_t index, int32_t srcLength, int32_t dstLength, int32_t *pOffset, uint32_t *pWeight) {
+		const int64_t center = ((2 * index + 1) * static_cast<int64_t>(srcLength) - dstLength) * 65536 / (2 * static_cast<int64_t>(dstLength));
+		const int64_t position = std::clamp<int64_t>(center, 0, static_cast<int64_t>(srcLength - 1) << 16);
+		*pOffset = static_cast<int32_t>(position >> 16);
+		*pWeight = static_cast<uint32_t>((position >> 8) & 0xFF);
+	}
+
+	TestImage ReferenceBilinear(TestImage &src, int32_t width, int32_t height) {
+		TestImage dst(width, height);
+		for (int32_t y = 0; y < height; y++) {
+			int32_t y0;
+			uint32_t wy;
+			ReferenceTap(y, src.Surface.Height, height, &y0, &wy);
+			const int32_t y1 = std::min(y0 + 1, src.Surface.Height - 1);
+			for (int32_t x = 0; x < width; x++) {
+				int32_t x0;
+				uint32_t wx;
+				ReferenceTap(x, src.Surface.Width, width, &x0, &wx);
+				const int32_t x1 = std::min(x0 + 1, src.Surface.Width - 1);
+				uint32_t pixel = 0;
+				for (int channel = 0; channel < 4; channel++) {
+					const uint32_t top = (Channel(src.At(x0, y0), channel) * (256 - wx) + Channel(src.At(x1, y0), channel) * wx + 128) >> 8;
+					const uint32_t bottom = (Channel(src.At(x0, y1), channel) * (256 - wx) + Channel(src.At(x1, y1), channel) * wx + 128) >> 8;
+					pixel |= ((top * (256 - wy) + bottom * wy + 128) >> 8) << (channel * 8);
+				}
+				dst.At(x, y) = pixel;
+			}
+		}
+		return dst;
+	}
+
+	//Averages the source pixels covered by each destination pixel, weighted by the covered area.
+	TestImage ReferenceArea(TestImage &src, int32_t width, int32_t height) {
+		TestImage dst(width, height);
+		const int64_t srcWidth = src.Surface.Width;
+		const int64_t srcHeight = src.Surface.Height;
+		for (int32_t y = 0; y < height; y++) {
+			for (int32_t x = 0; x < width; x++) {
+				uint64_t sums[4]{};
+				for (int64_t sy = 0; sy < srcHeight; sy++) {
+					const int64_t overlapY = std::min((sy + 1) * height, (y + 1) * srcHeight) - std::max(sy * height, y * srcHeight);
+					if (overlapY <= 0) {
+						continue;
+					}
+					for (int64_t sx = 0; sx < srcWidth; sx++) {
+						const int64_t overlapX = std::min((sx + 1) * width, (x + 1) * srcWidth) - std::max(sx * width, x * srcWidth);
+						if (overlapX <= 0) {
+							continue;
+						}
+						for (int channel = 0; channel < 4; channel++) {
+							sums[channel] += Channel(src.At(static_cast<int32_t>(sx), static_cast<int32_t>(sy)), channel) * static_cast<uint64_t>(overlapX * overlapY);
+						}
+					}
+				}
+				const uint64_t divisor = static_cast<uint64_t>(srcWidth * srcHeight);
+				uint32_t pixel = 0;
+				for (int channel = 0; channel < 4; channel++) {
+					pixel |= static_cast<uint32_t>((sums[channel] + divisor / 2) / divisor) << (channel * 8);
+				}
+				dst.At(x, y) = pixel;
+			}
+		}
+		return dst;
+	}
+
+	int CountMismatches(TestImage &expected, TestImage &actual) {
+		int count = 0;
+		for (int32_t y = 0; y < expected.Surface.Height; y++) {
+			for (int32_t x = 0; x < expected.Surface.Width; x++) {
+				if (expected.At(x, y) != actual.At(x, y)) {
+					if (count == 0) {
+						std::fprintf(stderr, "    first mismatch at %d,%d: expected %08X, actual %08X\n", x, y, expected.At(x, y), actual.At(x, y));
+					}
+					count++;
+				}
+			}
+		}
+		return count;
+	}
+}
+
+TEST(BlitClipsToBothSurfaces)
+{
+	SoftwareCompositor compositor;
+	TestImage src = CreatePattern(4, 4, 1);
+	TestImage dst(3, 3, 0x11111111);
+	CHECK(compositor.Blit(src.Surface, 0, 0, 4, 4, dst.Surface, -1, 2));
+	//Only source columns 1 to 3 of row 0 land in the last destination row.
+	for (int32_t x = 0; x < 3; x++) {
+		CHECK_EQUAL(src.At(x + 1, 0), dst.At(x, 2));
+		CHECK_EQUAL(0x11111111u, dst.At(x, 0));
+		CHECK_EQUAL(0x11111111u, dst.At(x, 1));
+	}
+	CHECK(!compositor.Blit(src.Surface, 0, 0, -1, 1, dst.Surface, 0, 0));
+}
+
+TEST(FillClipsToSurface)
+{
+	SoftwareCompositor compositor;
+	TestImage dst(4, 2);
+	compositor.Fill(dst.Surface, 2, -1, 10, 2, 0xFF00FF00);
+	CHECK_EQUAL(0u, dst.At(1, 0));
+	CHECK_EQUAL(0xFF00FF00u, dst.At(2, 0));
+	CHECK_EQUAL(0xFF00FF00u, dst.At(3, 0));
+	CHECK_EQUAL(0u, dst.At(3, 1));
+}
+
+TEST(RotateMatchesGoldenLayouts)
+{
+	SoftwareCompositor compositor;
+	TestImage src(3, 2);
+	for (uint32_t i = 0; i < 6; i++) {
+		src.At(i % 3, i / 3) = i + 1;
+	}
+	TestImage rotated90(2, 3);
+	CHECK(compositor.Rotate(src.Surface, rotated90.Surface, SoftwareRotation::Rotate90));
+	const uint32_t expected90[] = { 4, 1, 5, 2, 6, 3 };
+	TestImage rotated180(3, 2);
+	CHECK(compositor.Rotate(src.Surface, rotated180.Surface, SoftwareRotation::Rotate180));
+	const uint32_t expected180[] = { 6, 5, 4, 3, 2, 1 };
+	TestImage rotated270(2, 3);
+	CHECK(compositor.Rotate(src.Surface, rotated270.Surface, SoftwareRotation::Rotate270));
+	const uint32_t expected270[] = { 3, 6, 2, 5, 1, 4 };
+	for (int32_t i = 0; i < 6; i++) {
+		CHECK_EQUAL(expected90[i], rotated90.At(i % 2, i / 2));
+		CHECK_EQUAL(expected180[i], rotated180.At(i % 3, i / 3));
+		CHECK_EQUAL(expected270[i], rotated270.At(i % 2, i / 2));
+	}
+	CHECK(!compositor.Rotate(src.Surface, rotated180.Surface, SoftwareRotation::Rotate90));
+}
+
+TEST(RotateLargeImageRoundTrips)
+{
+	//Larger than a tile, so the tiled loops are covered.
+	SoftwareCompositor compositor;
+	TestImage src = CreatePattern(75, 41, 2);
+	TestImage rotated(41, 75);
+	TestImage restored(75, 41);
+	CHECK(compositor.Rotate(src.Surface, rotated.Surface, SoftwareRotation::Rotate90));
+	CHECK(compositor.Rotate(rotated.Surface, restored.Surface, SoftwareRotation::Rotate270));
+	CHECK_EQUAL(0, CountMismatches(src, restored));
+}
+
+TEST(BilinearMatchesGoldenRow)
+{
+	SoftwareCompositor compositor;
+	TestImage src(2, 1);
+	src.At(0, 0) = 0xFF000000;
+	src.At(1, 0) = 0xFF0000FF;
+	TestImage dst(4, 1);
+	CHECK(compositor.Scale(src.Surface, dst.Surface, SoftwareScaleFilter::Bilinear));
+	const uint32_t expected[] = { 0xFF000000, 0xFF000040, 0xFF0000BF, 0xFF0000FF };
+	for (int32_t x = 0; x < 4; x++) {
+		CHECK_EQUAL(expected[x], dst.At(x, 0));
+	}
+}
+
+TEST(BilinearMatchesReferenceImage)
+{
+	SoftwareCompositor compositor;
+	TestImage src = CreatePattern(64, 48, 3);
+	const int32_t sizes[][2] = { { 37, 29 }, { 101, 77 }, { 64, 17 }, { 1, 1 } };
+	for (const auto &size : sizes) {
+		TestImage expected = ReferenceBilinear(src, size[0], size[1]);
+		TestImage actual(size[0], size[1]);
+		CHECK(compositor.Scale(src.Surface, actual.Surface, SoftwareScaleFilter::Bilinear));
+		CHECK_EQUAL(0, CountMismatches(expected, actual));
+	}
+}
+
+TEST(AreaMatchesGoldenBlocks)
+{
+	SoftwareCompositor compositor;
+	TestImage src(4, 2);
+	const uint32_t values[] = { 0, 10, 100, 101, 1, 11, 100, 102 };
+	for (int32_t i = 0; i < 8; i++) {
+		src.At(i % 4, i / 4) = 0xFF000000 | values[i];
+	}
+	TestImage dst(2, 1);
+	CHECK(compositor.Scale(src.Surface, dst.Surface, SoftwareScaleFilter::Area));
+	//(0 + 10 + 1 + 11) / 4 = 5.5 and (100 + 101 + 100 + 102) / 4 = 100.75, rounded.
+	CHECK_EQUAL(0xFF000006u, dst.At(0, 0));
+	CHECK_EQUAL(0xFF000065u, dst.At(1, 0));
+}
+
+TEST(AreaMatchesReferenceImage)
+{
+	SoftwareCompositor compositor;
+	TestImage src = CreatePattern(64, 48, 4);
+	const int32_t sizes[][2] = { { 37, 29 }, { 32, 24 }, { 7, 48 }, { 1, 1 } };
+	for (const auto &size : sizes) {
+		TestImage expected = ReferenceArea(src, size[0], size[1]);
+		TestImage actual(size[0], size[1]);
+		CHECK(compositor.Scale(src.Surface, actual.Surface, SoftwareScaleFilter::Area));
+		CHECK_EQUAL(0, CountMismatches(expected, actual));
+	}
+}
+
+TEST(AreaFallsBackToBilinearWhenUpscaling)
+{
+	SoftwareCompositor compositor;
+	TestImage src = CreatePattern(16, 16, 5);
+	TestImage expected = ReferenceBilinear(src, 24, 20);
+	TestImage actual(24, 20);
+	CHECK(compositor.Scale(src.Surface, actual.Surface, SoftwareScaleFilter::Area));
+	CHECK_EQUAL(0, CountMismatches(expected, actual));
+}
+
+TEST(PremultipliedBlendMatchesGoldenPixel)
+{
+	SoftwareCompositor compositor;
+	TestImage src(1, 1, 0x80402010);
+	TestImage dst(1, 1, 0xFFFFFFFF);
+	CHECK(compositor.AlphaBlend(src.Surface, dst.Surface, 0, 0, SoftwareAlphaMode::Premultiplied));
+	CHECK_EQUAL(0xFFBF9F8Fu, dst.At(0, 0));
+}
+
+TEST(StraightBlendMatchesGoldenPixel)
+{
+	SoftwareCompositor compositor;
+	TestImage src(1, 1, 0x80FF0000);
+	TestImage dst(1, 1, 0xFF0000FF);
+	CHECK(compositor.AlphaBlend(src.Surface, dst.Surface, 0, 0, SoftwareAlphaMode::Straight));
+	CHECK_EQUAL(0x8080007Fu, dst.At(0, 0));
+}
+
+TEST(BlendMatchesReferenceImage)
+{
+	//Widths that are not multiples of the 4 and 8 pixel kernels, at offsets that clip the source on every side.
+	SoftwareCompositor compositor;
+	const int32_t offsets[][2] = { { 0, 0 }, { 5, 3 }, { -7, -2 }, { 20, 25 } };
+	for (SoftwareAlphaMode mode : { SoftwareAlphaMode::Premultiplied, SoftwareAlphaMode::Straight }) {
+		for (const auto &offset : offsets) {
+			TestImage src = CreatePattern(23, 19, 6);
+			TestImage expected = CreatePattern(31, 29, 7);
+			TestImage actual = CreatePattern(31, 29, 7);
+			for (int32_t y = 0; y < src.Surface.Height; y++) {
+				for (int32_t x = 0; x < src.Surface.Width; x++) {
+					const int32_t dstX = x + offset[0];
+					const int32_t dstY = y + offset[1];
+					if (dstX >= 0 && dstY >= 0 && dstX < expected.Surface.Width && dstY < expected.Surface.Height) {
+						uint32_t &pixel = expected.At(dstX, dstY);
+						pixel = mode == SoftwareAlphaMode::Premultiplied ? ReferencePremultiplied(src.At(x, y), pixel) : ReferenceStraight(src.At(x, y), pixel);
+					}
+				}
+			}
+			CHECK(compositor.AlphaBlend(src.Surface, actual.Surface, offset[0], offset[1], mode));
+			CHECK_EQUAL(0, CountMismatches(expected, actual));
+		}
+	}
+}
+
+TEST(MonochromePointerMatchesTruthTable)
+{
+	//One row of four pixels, with the AND mask followed by the XOR mask. The columns are AND/XOR 1/0, 0/0, 0/1 and 1/1.
+	const uint8_t buffer[] = { 0x90, 0x30 };
+	SOFTWARE_POINTER_SHAPE shape{};
+	shape.Buffer = buffer;
+	shape.Type = SoftwarePointerType::Monochrome;
+	shape.Width = 4;
+	shape.Height = 1;
+	shape.Pitch = 1;
+	TestImage background(4, 1, 0xFF123456);
+	TestImage dst(4, 1);
+	SoftwareCompositor compositor;
+	CHECK(compositor.RenderPointerShape(shape, background.Surface, dst.Surface));
+	CHECK_EQUAL(0x00FFFFFFu, dst.At(0, 0));
+	CHECK_EQUAL(0xFF000000u, dst.At(1, 0));
+	CHECK_EQUAL(0xFFFFFFFFu, dst.At(2, 0));
+	CHECK_EQUAL(0xFFEDCBA9u, dst.At(3, 0));
+}
+
+TEST(MaskedColorPointerMatchesGoldenPixels)
+{
+	const uint32_t buffer[] = { 0x00336699, 0xFF000000, 0xFF00FF00 };
+	SOFTWARE_POINTER_SHAPE shape{};
+	shape.Buffer = reinterpret_cast<const uint8_t *>(buffer);
+	shape.Type = SoftwarePointerType::MaskedColor;
+	shape.Width = 3;
+	shape.Height = 1;
+	shape.Pitch = sizeof(buffer);
+	TestImage background(3, 1, 0xFF123456);
+	TestImage dst(3, 1);
+	SoftwareCompositor compositor;
+	CHECK(compositor.RenderPointerShape(shape, background.Surface, dst.Surface));
+	CHECK_EQUAL(0xFF336699u, dst.At(0, 0));
+	CHECK_EQUAL(0x00FFFFFFu, dst.At(1, 0));
+	CHECK_EQUAL(0xFF12CB56u, dst.At(2, 0));
+}
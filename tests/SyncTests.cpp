@@ -0,0 +1,162 @@
+#include "Test.h"
+#include "Sync.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// HighresTimer is not tested here, as it depends on the Windows types in CommonTypes.h. It is a thin layer over DeadlineTimer and PacingTimer, which are.
+
+using namespace std::chrono;
+
+namespace {
+	//Waits that must not time out use a long timeout, so a slow machine does not fail the tests, and a broken wait does not hang them.
+	const milliseconds LONG_TIMEOUT = seconds(10);
+}
+
+TEST(ManualResetEventStaysSet)
+{
+	SyncEvent event(true);
+	CHECK(!event.Wait(milliseconds(0)));
+	event.Set();
+	CHECK(event.Wait(milliseconds(0)));
+	CHECK(event.Wait(milliseconds(0)));
+	event.Reset();
+	CHECK(!event.Wait(milliseconds(0)));
+
+	SyncEvent initiallySet(true, true);
+	CHECK(initiallySet.Wait(milliseconds(0)));
+}
+
+TEST(AutoResetEventReleasesOneWait)
+{
+	SyncEvent event(false, true);
+	CHECK(event.Wait(milliseconds(0)));
+	CHECK(!event.Wait(milliseconds(0)));
+	event.Set();
+	event.Set();
+	CHECK(event.Wait(milliseconds(0)));
+	CHECK(!event.Wait(milliseconds(0)));
+}
+
+TEST(EventWaitTimesOut)
+{
+	SyncEvent event(true);
+	const auto start = steady_clock::now();
+	CHECK(!event.Wait(milliseconds(20)));
+	CHECK(steady_clock::now() - start >= milliseconds(20));
+}
+
+TEST(EventReleasesWaitingThreads)
+{
+	SyncEvent event(true);
+	std::atomic<int> releasedCount(0);
+	std::thread waiters[3];
+	for (std::thread &waiter : waiters) {
+		waiter = std::thread([&]() {
+			if (event.Wait(LONG_TIMEOUT)) {
+				releasedCount++;
+			}
+		});
+	}
+	std::this_thread::sleep_for(milliseconds(10));
+	event.Set();
+	for (std::thread &waiter : waiters) {
+		waiter.join();
+	}
+	CHECK_EQUAL(3, releasedCount.load());
+}
+
+TEST(WaitAnyReturnsFirstSetEvent)
+{
+	SyncEvent first(false);
+	SyncEvent second(false);
+	SyncEvent manual(true);
+	CHECK_EQUAL(SYNC_WAIT_TIMEOUT, WaitAny({ &first, &second, &manual }, milliseconds(0)));
+	second.Set();
+	manual.Set();
+	CHECK_EQUAL(1u, WaitAny({ &first, &second, &manual }, milliseconds(0)));
+	//Only the returned auto reset event is reset, and the manual reset event stays set.
+	CHECK_EQUAL(2u, WaitAny({ &first, &second, &manual }, milliseconds(0)));
+	CHECK_EQUAL(2u, WaitAny({ &first, &second, &manual }, milliseconds(0)));
+	manual.Reset();
+
+	std::thread setter([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		first.Set();
+	});
+	CHECK_EQUAL(1u, WaitAny({ &second, &first }, LONG_TIMEOUT));
+	setter.join();
+	CHECK(!first.Wait(milliseconds(0)));
+}
+
+TEST(MutexIsRecursive)
+{
+	SyncMutex mutex;
+	std::lock_guard<SyncMutex> outer(mutex);
+	{
+		std::lock_guard<SyncMutex> inner(mutex);
+		CHECK(mutex.try_lock());
+		mutex.unlock();
+	}
+	bool isLockedElsewhere = false;
+	std::thread other([&]() {
+		isLockedElsewhere = mutex.try_lock();
+		if (isLockedElsewhere) {
+			mutex.unlock();
+		}
+	});
+	other.join();
+	CHECK(!isLockedElsewhere);
+}
+
+TEST(MutexExcludesThreads)
+{
+	SyncMutex mutex;
+	int64_t counter = 0;
+	std::thread threads[4];
+	for (std::thread &thread : threads) {
+		thread = std::thread([&]() {
+			for (int i = 0; i < 10000; i++) {
+				std::lock_guard<SyncMutex> lock(mutex);
+				counter++;
+			}
+		});
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	CHECK_EQUAL(40000, counter);
+}
+
+TEST(DeadlineTimerWaitsUntilDeadline)
+{
+	DeadlineTimer timer;
+	SyncEvent cancel(true);
+	for (int i = 0; i < 2; i++) {
+		//The same deadline is used with and without a cancel event, as they take different paths.
+		const auto deadline = steady_clock::now() + milliseconds(15);
+		CHECK(timer.WaitUntil(deadline, i == 0 ? nullptr : &cancel));
+		CHECK(steady_clock::now() >= deadline);
+	}
+	//A deadline in the past returns at once.
+	CHECK(timer.WaitUntil(steady_clock::now() - seconds(1)));
+	CHECK(timer.WaitUntil(steady_clock::now() - seconds(1), &cancel));
+}
+
+TEST(DeadlineTimerIsCanceled)
+{
+	DeadlineTimer timer;
+	SyncEvent cancel(true, true);
+	CHECK(!timer.WaitUntil(steady_clock::now() - seconds(1), &cancel));
+	CHECK(!timer.WaitUntil(steady_clock::now() + LONG_TIMEOUT, &cancel));
+	cancel.Reset();
+
+	std::thread canceler([&]() {
+		std::this_thread::sleep_for(milliseconds(10));
+		cancel.Set();
+	});
+	const auto start = steady_clock::now();
+	CHECK(!timer.WaitUntil(start + LONG_TIMEOUT, &cancel));
+	CHECK(steady_clock::now() - start < LONG_TIMEOUT);
+	canceler.join();
+}
\ No newline at end of file
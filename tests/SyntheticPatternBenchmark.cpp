@@ -0,0 +1,50 @@
+#include "SyntheticPattern.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Measures the time to draw the frames of a synthetic source and read back their frame numbers, for each dirty region pattern and common frame sizes.
+// Usage: SyntheticPatternBenchmark [frames per measurement]
+
+namespace {
+	struct FRAME_SIZE {
+		const char *Name;
+		int32_t Width;
+		int32_t Height;
+	};
+
+	void Measure(const FRAME_SIZE &size, SyntheticDirtyPattern dirtyPattern, const char *patternName, int frameCount) {
+		SyntheticPattern pattern(size.Width, size.Height, dirtyPattern);
+		//The first frame draws the whole background.
+		pattern.DrawFrame(0);
+		uint64_t dirtyPixels = 0;
+		int misreadCount = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 1; i <= frameCount; i++) {
+			PATTERN_RECT dirty = pattern.DrawFrame(i);
+			dirtyPixels += static_cast<uint64_t>(dirty.Right - dirty.Left) * (dirty.Bottom - dirty.Top);
+			uint32_t frameNumber = 0;
+			if (!SyntheticPattern::ReadFrameNumber(pattern.GetData(), pattern.GetStride(), pattern.GetWidth(), pattern.GetHeight(), &frameNumber) || frameNumber != static_cast<uint32_t>(i)) {
+				misreadCount++;
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		double milliseconds = seconds * 1000.0 / frameCount;
+		double dirtyPercent = 100.0 * dirtyPixels / (static_cast<double>(size.Width) * size.Height * frameCount);
+		std::printf("%-6s %-16s %8.3f ms/frame %8.1f fps %6.1f%% dirty %d misread\n", size.Name, patternName, milliseconds, 1000.0 / milliseconds, dirtyPercent, misreadCount);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const int frameCount = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+	const FRAME_SIZE sizes[] = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "2160p", 3840, 2160 } };
+	for (const FRAME_SIZE &size : sizes) {
+		Measure(size, SyntheticDirtyPattern::None, "None", frameCount);
+		Measure(size, SyntheticDirtyPattern::MovingRectangle, "MovingRectangle", frameCount);
+		Measure(size, SyntheticDirtyPattern::Scroll, "Scroll", frameCount);
+		Measure(size, SyntheticDirtyPattern::FullFrame, "FullFrame", frameCount);
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "Test.h"
+#include "SyntheticPattern.h"
+#include <random>
+
+namespace {
+	struct FRAME_SIZE {
+		int32_t Width;
+		int32_t Height;
+	};
+
+	//The smallest frame the counter fits in, odd sizes, and common resolutions.
+	const FRAME_SIZE FRAME_SIZES[]{ { 256, 16 }, { 257, 17 }, { 640, 360 }, { 1281, 721 } };
+	const SyntheticDirtyPattern PATTERNS[]{ SyntheticDirtyPattern::None, SyntheticDirtyPattern::MovingRectangle, SyntheticDirtyPattern::Scroll, SyntheticDirtyPattern::FullFrame };
+
+	//Frame numbers with every bit set and cleared, the boundaries of the counter, and random values.
+	std::vector<uint32_t> GetFrameNumbers() {
+		std::vector<uint32_t> frameNumbers{ 0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFE, 0xFFFFFFFF, 0x55555555, 0xAAAAAAAA };
+		for (int bit = 0; bit < 32; bit++) {
+			frameNumbers.push_back(1u << bit);
+			frameNumbers.push_back(~(1u << bit));
+		}
+		std::mt19937 random(1);
+		for (int i = 0; i < 50; i++) {
+			frameNumbers.push_back(static_cast<uint32_t>(random()));
+		}
+		return frameNumbers;
+	}
+
+	bool IsFrameNumberRead(const SyntheticPattern &pattern, uint32_t expected) {
+		uint32_t frameNumber = 0;
+		return SyntheticPattern::ReadFrameNumber(pattern.GetData(), pattern.GetStride(), pattern.GetWidth(), pattern.GetHeight(), &frameNumber) && frameNumber == expected;
+	}
+}
+
+TEST(FrameNumbersSurviveRoundTrip)
+{
+	const std::vector<uint32_t> frameNumbers = GetFrameNumbers();
+	for (const FRAME_SIZE &size : FRAME_SIZES) {
+		for (SyntheticDirtyPattern dirtyPattern : PATTERNS) {
+			SyntheticPattern pattern(size.Width, size.Height, dirtyPattern);
+			int failureCount = 0;
+			//Consecutive frames, as a recording draws them, and then frames far apart.
+			for (uint32_t frameNumber = 0; frameNumber < 100; frameNumber++) {
+				pattern.DrawFrame(frameNumber);
+				failureCount += IsFrameNumberRead(pattern, frameNumber) ? 0 : 1;
+			}
+			for (uint32_t frameNumber : frameNumbers) {
+				pattern.DrawFrame(frameNumber);
+				failureCount += IsFrameNumberRead(pattern, frameNumber) ? 0 : 1;
+			}
+			CHECK_EQUAL(0, failureCount);
+		}
+	}
+}
+
+TEST(FrameNumberIsReadFromPaddedRows)
+{
+	SyntheticPattern pattern(300, 20, SyntheticDirtyPattern::FullFrame);
+	pattern.DrawFrame(123456789);
+	//A stride larger than the width, as in a mapped texture.
+	const int32_t stride = pattern.GetStride() + 64;
+	std::vector<uint8_t> padded(static_cast<size_t>(stride) * pattern.GetHeight(), 0x80);
+	for (int32_t y = 0; y < pattern.GetHeight(); y++) {
+		std::copy(pattern.GetData() + static_cast<size_t>(y) * pattern.GetStride(), pattern.GetData() + static_cast<size_t>(y + 1) * pattern.GetStride(), padded.begin() + static_cast<size_t>(y) * stride);
+	}
+	uint32_t frameNumber = 0;
+	CHECK(SyntheticPattern::ReadFrameNumber(padded.data(), stride, pattern.GetWidth(), pattern.GetHeight(), &frameNumber));
+	CHECK_EQUAL(123456789u, frameNumber);
+}
+
+TEST(InvalidFramesAreRejected)
+{
+	uint32_t frameNumber = 1;
+	//Too small for the counter.
+	SyntheticPattern small(255, 16, SyntheticDirtyPattern::None);
+	small.DrawFrame(5);
+	CHECK(!SyntheticPattern::ReadFrameNumber(small.GetData(), small.GetStride(), small.GetWidth(), small.GetHeight(), &frameNumber));
+	CHECK_EQUAL(0u, frameNumber);
+	//A frame without a counter has no inverted second row.
+	std::vector<uint8_t> gray(256 * 4 * 16, 0x80);
+	CHECK(!SyntheticPattern::ReadFrameNumber(gray.data(), 256 * 4, 256, 16, &frameNumber));
+	CHECK(!SyntheticPattern::ReadFrameNumber(nullptr, 256 * 4, 256, 16, &frameNumber));
+}
+
+TEST(DirtyRegionCoversChanges)
+{
+	for (SyntheticDirtyPattern dirtyPattern : PATTERNS) {
+		SyntheticPattern pattern(640, 360, dirtyPattern);
+		PATTERN_RECT first = pattern.DrawFrame(0);
+		CHECK(first.Left == 0 && first.Top == 0 && first.Right == 640 && first.Bottom == 360);
+		std::vector<uint8_t> previous(pattern.GetData(), pattern.GetData() + static_cast<size_t>(pattern.GetStride()) * pattern.GetHeight());
+		for (int64_t frameNumber = 1; frameNumber < 20; frameNumber++) {
+			PATTERN_RECT dirty = pattern.DrawFrame(frameNumber);
+			int outsideCount = 0;
+			for (int32_t y = 0; y < pattern.GetHeight(); y++) {
+				for (int32_t x = 0; x < pattern.GetWidth(); x++) {
+					const size_t offset = static_cast<size_t>(y) * pattern.GetStride() + static_cast<size_t>(x) * 4;
+					const bool isChanged = !std::equal(previous.begin() + offset, previous.begin() + offset + 4, pattern.GetData() + offset);
+					const bool isInside = x >= dirty.Left && x < dirty.Right && y >= dirty.Top && y < dirty.Bottom;
+					outsideCount += isChanged && !isInside ? 1 : 0;
+				}
+			}
+			CHECK_EQUAL(0, outsideCount);
+			previous.assign(pattern.GetData(), pattern.GetData() + previous.size());
+		}
+		//Only the counter changes without a pattern.
+		if (dirtyPattern == SyntheticDirtyPattern::None) {
+			PATTERN_RECT dirty = pattern.DrawFrame(20);
+			CHECK_EQUAL(SyntheticPattern::COUNTER_BITS * SyntheticPattern::COUNTER_CELL_SIZE, dirty.Right);
+			CHECK_EQUAL(2 * SyntheticPattern::COUNTER_CELL_SIZE, dirty.Bottom);
+		}
+	}
+}
\ No newline at end of file
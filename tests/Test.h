@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A minimal test runner, so the portable parts of the native library can be tested on any platform without other dependencies.
+
+struct TEST_CASE {
+	const char *Name;
+	void(*Function)();
+};
+
+std::vector<TEST_CASE> &GetTestCases();
+void ReportFailure(const char *file, int line, const char *expression);
+
+struct TestRegistration {
+	TestRegistration(const char *name, void(*function)()) {
+		GetTestCases().push_back(TEST_CASE{ name, function });
+	}
+};
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { \
+		if (!(expression)) { \
+			ReportFailure(__FILE__, __LINE__, #expression); \
+		} \
+	} while (0)
+
+//Checks two integral values, and prints both when they differ.
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		const auto expectedValue = (expected); \
+		const auto actualValue = (actual); \
+		if (!(expectedValue == actualValue)) { \
+			ReportFailure(__FILE__, __LINE__, #expected " == " #actual); \
+			std::fprintf(stderr, "    expected %lld, actual %lld\n", static_cast<long long>(expectedValue), static_cast<long long>(actualValue)); \
+		} \
+	} while (0)
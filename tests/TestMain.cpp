@@ -0,0 +1,43 @@
+#include "Test.h"
+#include <cstring>
+
+namespace {
+	int g_FailureCount = 0;
+}
+
+std::vector<TEST_CASE> &GetTestCases()
+{
+	static std::vector<TEST_CASE> testCases;
+	return testCases;
+}
+
+void ReportFailure(const char *file, int line, const char *expression)
+{
+	std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", file, line, expression);
+	g_FailureCount++;
+}
+
+//Runs all tests, or the tests whose names contain the first argument.
+int main(int argc, char **argv)
+{
+	const char *filter = argc > 1 ? argv[1] : nullptr;
+	int failedTestCount = 0;
+	int testCount = 0;
+	for (const TEST_CASE &testCase : GetTestCases()) {
+		if (filter && !std::strstr(testCase.Name, filter)) {
+			continue;
+		}
+		const int failureCount = g_FailureCount;
+		testCase.Function();
+		testCount++;
+		if (g_FailureCount != failureCount) {
+			failedTestCount++;
+			std::printf("[FAILED] %s\n", testCase.Name);
+		}
+		else {
+			std::printf("[    OK] %s\n", testCase.Name);
+		}
+	}
+	std::printf("%d of %d tests passed\n", testCount - failedTestCount, testCount);
+	return failedTestCount == 0 ? 0 : 1;
+}
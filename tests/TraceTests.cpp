@@ -0,0 +1,457 @@
+#include "Test.h"
+#include "Trace.h"
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+	struct JSON_VALUE {
+		enum class JsonType { Null, Boolean, Number, String, Array, Object };
+		JsonType Type = JsonType::Null;
+		double Number = 0;
+		std::string String;
+		std::vector<JSON_VALUE> Items;
+		std::vector<std::pair<std::string, JSON_VALUE>> Members;
+
+		const JSON_VALUE *Get(const char *name) const {
+			for (const auto &member : Members) {
+				if (member.first == name) {
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+	};
+
+	/// <summary>
+	/// A strict parser for the JSON grammar of RFC 8259, so a trace that a viewer would reject fails the tests.
+	/// </summary>
+	class JsonParser
+	{
+	public:
+		JsonParser(const std::string &text) : m_Text(text), m_Position(0) {}
+		bool Parse(JSON_VALUE *pValue) {
+			if (!ParseValue(pValue, 0)) {
+				return false;
+			}
+			SkipWhitespace();
+			return m_Position == m_Text.size();
+		}
+	private:
+		const std::string &m_Text;
+		size_t m_Position;
+
+		void SkipWhitespace() {
+			while (m_Position < m_Text.size() && std::strchr(" \t\r\n", m_Text[m_Position]) && m_Text[m_Position] != '\0') {
+				m_Position++;
+			}
+		}
+		bool Consume(char c) {
+			SkipWhitespace();
+			if (m_Position < m_Text.size() && m_Text[m_Position] == c) {
+				m_Position++;
+				return true;
+			}
+			return false;
+		}
+		bool ConsumeLiteral(const char *literal) {
+			const size_t length = std::strlen(literal);
+			if (m_Text.compare(m_Position, length, literal) != 0) {
+				return false;
+			}
+			m_Position += length;
+			return true;
+		}
+		bool IsDigit() {
+			return m_Position < m_Text.size() && m_Text[m_Position] >= '0' && m_Text[m_Position] <= '9';
+		}
+		bool ParseValue(JSON_VALUE *pValue, int depth) {
+			SkipWhitespace();
+			if (m_Position >= m_Text.size() || depth > 32) {
+				return false;
+			}
+			const char c = m_Text[m_Position];
+			if (c == '{') {
+				pValue->Type = JSON_VALUE::JsonType::Object;
+				m_Position++;
+				if (Consume('}')) {
+					return true;
+				}
+				do {
+					std::pair<std::string, JSON_VALUE> member;
+					SkipWhitespace();
+					if (!ParseString(&member.first) || !Consume(':') || !ParseValue(&member.second, depth + 1)) {
+						return false;
+					}
+					pValue->Members.push_back(std::move(member));
+				} while (Consume(','));
+				return Consume('}');
+			}
+			if (c == '[') {
+				pValue->Type = JSON_VALUE::JsonType::Array;
+				m_Position++;
+				if (Consume(']')) {
+					return true;
+				}
+				do {
+					JSON_VALUE item;
+					if (!ParseValue(&item, depth + 1)) {
+						return false;
+					}
+					pValue->Items.push_back(std::move(item));
+				} while (Consume(','));
+				return Consume(']');
+			}
+			if (c == '"') {
+				pValue->Type = JSON_VALUE::JsonType::String;
+				return ParseString(&pValue->String);
+			}
+			if (c == 't' || c == 'f') {
+				pValue->Type = JSON_VALUE::JsonType::Boolean;
+				pValue->Number = c == 't' ? 1 : 0;
+				return ConsumeLiteral(c == 't' ? "true" : "false");
+			}
+			if (c == 'n') {
+				return ConsumeLiteral("null");
+			}
+			pValue->Type = JSON_VALUE::JsonType::Number;
+			return ParseNumber(&pValue->Number);
+		}
+		bool ParseNumber(double *pNumber) {
+			const size_t start = m_Position;
+			if (m_Text[m_Position] == '-') {
+				m_Position++;
+			}
+			if (!IsDigit()) {
+				return false;
+			}
+			//No leading zeros.
+			if (m_Text[m_Position] == '0') {
+				m_Position++;
+			}
+			else {
+				while (IsDigit()) {
+					m_Position++;
+				}
+			}
+			if (m_Position < m_Text.size() && m_Text[m_Position] == '.') {
+				m_Position++;
+				if (!IsDigit()) {
+					return false;
+				}
+				while (IsDigit()) {
+					m_Position++;
+				}
+			}
+			if (m_Position < m_Text.size() && (m_Text[m_Position] == 'e' || m_Text[m_Position] == 'E')) {
+				m_Position++;
+				if (m_Position < m_Text.size() && (m_Text[m_Position] == '+' || m_Text[m_Position] == '-')) {
+					m_Position++;
+				}
+				if (!IsDigit()) {
+					return false;
+				}
+				while (IsDigit()) {
+					m_Position++;
+				}
+			}
+			*pNumber = std::stod(m_Text.substr(start, m_Position - start));
+			return true;
+		}
+		bool ParseString(std::string *pString) {
+			if (m_Position >= m_Text.size() || m_Text[m_Position] != '"') {
+				return false;
+			}
+			m_Position++;
+			while (m_Position < m_Text.size()) {
+				const char c = m_Text[m_Position++];
+				if (c == '"') {
+					return true;
+				}
+				if (static_cast<unsigned char>(c) < 0x20) {
+					return false;
+				}
+				if (c != '\\') {
+					pString->push_back(c);
+					continue;
+				}
+				if (m_Position >= m_Text.size()) {
+					return false;
+				}
+				const char escaped = m_Text[m_Position++];
+				const char *pSimple = std::strchr("\"\\/bfnrt", escaped);
+				if (escaped == 'u') {
+					if (m_Position + 4 > m_Text.size()) {
+						return false;
+					}
+					unsigned int code = 0;
+					for (int i = 0; i < 4; i++) {
+						const char digit = m_Text[m_Position++];
+						const char *pHex = std::strchr("0123456789abcdef", digit >= 'A' && digit <= 'F' ? digit - 'A' + 'a' : digit);
+						if (!pHex || digit == '\0') {
+							return false;
+						}
+						code = code * 16 + static_cast<unsigned int>(pHex - "0123456789abcdef");
+					}
+					//The tests only use ASCII names.
+					pString->push_back(static_cast<char>(code));
+				}
+				else if (pSimple && escaped != '\0') {
+					pString->push_back("\"\\/\b\f\n\r\t"[pSimple - "\"\\/bfnrt"]);
+				}
+				else {
+					return false;
+				}
+			}
+			return false;
+		}
+	};
+
+	struct PARSED_EVENT {
+		std::string Name;
+		uint32_t ThreadId;
+		double TimestampMicros;
+		double DurationMicros;
+	};
+
+	struct PARSED_TRACE {
+		bool IsValid = false;
+		std::vector<PARSED_EVENT> Events;
+		std::vector<std::pair<uint32_t, std::string>> ThreadNames;
+
+		std::vector<PARSED_EVENT> GetEvents(const std::string &name) const {
+			std::vector<PARSED_EVENT> events;
+			for (const PARSED_EVENT &event : Events) {
+				if (event.Name == name) {
+					events.push_back(event);
+				}
+			}
+			return events;
+		}
+	};
+
+	/// <summary>
+	/// Exports the trace and parses it, checking the fields of each event that chrome://tracing and Perfetto rely on.
+	/// </summary>
+	PARSED_TRACE ExportTrace() {
+		PARSED_TRACE trace;
+		std::ostringstream stream;
+		if (!Tracer::WriteChromeTrace(stream)) {
+			return trace;
+		}
+		const std::string text = stream.str();
+		JSON_VALUE root;
+		JsonParser parser(text);
+		if (!parser.Parse(&root) || root.Type != JSON_VALUE::JsonType::Object) {
+			return trace;
+		}
+		const JSON_VALUE *pEvents = root.Get("traceEvents");
+		if (!pEvents || pEvents->Type != JSON_VALUE::JsonType::Array) {
+			return trace;
+		}
+		for (const JSON_VALUE &event : pEvents->Items) {
+			const JSON_VALUE *pName = event.Get("name");
+			const JSON_VALUE *pPhase = event.Get("ph");
+			const JSON_VALUE *pProcess = event.Get("pid");
+			const JSON_VALUE *pThread = event.Get("tid");
+			if (!pName || pName->Type != JSON_VALUE::JsonType::String || !pPhase || !pProcess || pProcess->Type != JSON_VALUE::JsonType::Number
+				|| !pThread || pThread->Type != JSON_VALUE::JsonType::Number) {
+				return trace;
+			}
+			const uint32_t threadId = static_cast<uint32_t>(pThread->Number);
+			if (pPhase->String == "M") {
+				const JSON_VALUE *pArgs = event.Get("args");
+				const JSON_VALUE *pThreadName = pArgs ? pArgs->Get("name") : nullptr;
+				if (pName->String != "thread_name" || !pThreadName || pThreadName->Type != JSON_VALUE::JsonType::String) {
+					return trace;
+				}
+				trace.ThreadNames.push_back({ threadId, pThreadName->String });
+			}
+			else if (pPhase->String == "X") {
+				const JSON_VALUE *pTimestamp = event.Get("ts");
+				const JSON_VALUE *pDuration = event.Get("dur");
+				if (!pTimestamp || pTimestamp->Type != JSON_VALUE::JsonType::Number || !pDuration || pDuration->Type != JSON_VALUE::JsonType::Number || pDuration->Number < 0) {
+					return trace;
+				}
+				trace.Events.push_back(PARSED_EVENT{ pName->String, threadId, pTimestamp->Number, pDuration->Number });
+			}
+			else {
+				return trace;
+			}
+		}
+		trace.IsValid = true;
+		return trace;
+	}
+
+	bool IsNear(double expected, double actual) {
+		return std::abs(expected - actual) < 1e-6;
+	}
+}
+
+TEST(EventsAreRecordedOnlyWhileEnabled)
+{
+	Tracer::Clear();
+	Tracer::SetEnabled(false);
+	{
+		TRACE_SCOPE("DisabledScope");
+	}
+	Tracer::SetEnabled(true);
+	{
+		TRACE_SCOPE("EnabledScope");
+	}
+	//A scope is recorded if tracing was enabled when it began, so a scope that spans the switch is complete.
+	{
+		TRACE_SCOPE("SpanningScope");
+		Tracer::SetEnabled(false);
+	}
+	{
+		TRACE_SCOPE("DisabledAgainScope");
+	}
+	PARSED_TRACE trace = ExportTrace();
+	CHECK(trace.IsValid);
+	CHECK_EQUAL(0u, trace.GetEvents("DisabledScope").size());
+	CHECK_EQUAL(1u, trace.GetEvents("EnabledScope").size());
+	CHECK_EQUAL(1u, trace.GetEvents("SpanningScope").size());
+	CHECK_EQUAL(0u, trace.GetEvents("DisabledAgainScope").size());
+	CHECK(!Tracer::IsEnabled());
+}
+
+TEST(ScopeCanEndEarly)
+{
+	Tracer::Clear();
+	Tracer::SetEnabled(true);
+	{
+		TraceScope scope("EarlyScope");
+		scope.End();
+		//Ending again, or at the end of the scope, does not record it twice.
+		scope.End();
+	}
+	Tracer::SetEnabled(false);
+	CHECK_EQUAL(1u, ExportTrace().GetEvents("EarlyScope").size());
+}
+
+TEST(RingKeepsNewestEvents)
+{
+	Tracer::Clear();
+	const uint64_t eventCount = Tracer::EVENTS_PER_THREAD + 1000;
+	//A new thread, so its buffer starts empty.
+	std::thread recorder([&]() {
+		Tracer::SetThreadName("RingRecorder");
+		for (uint64_t i = 0; i < eventCount; i++) {
+			Tracer::AddEvent("RingEvent", static_cast<int64_t>(i) * 1000, static_cast<int64_t>(i) * 1000 + 500);
+		}
+	});
+	recorder.join();
+	PARSED_TRACE trace = ExportTrace();
+	CHECK(trace.IsValid);
+	std::vector<PARSED_EVENT> events = trace.GetEvents("RingEvent");
+	//The oldest events were overwritten, and the rest are exported in the order they were recorded.
+	//The slot the thread writes next is never exported, as it may be overwritten while it is read, so a full ring exports one event less than it holds.
+	const uint64_t exportedCount = Tracer::EVENTS_PER_THREAD - 1;
+	CHECK_EQUAL(exportedCount, events.size());
+	int outOfOrderCount = 0;
+	for (size_t i = 0; i < events.size(); i++) {
+		const double expectedMicros = static_cast<double>(eventCount - exportedCount + i);
+		outOfOrderCount += IsNear(expectedMicros, events[i].TimestampMicros) && IsNear(0.5, events[i].DurationMicros) ? 0 : 1;
+	}
+	CHECK_EQUAL(0, outOfOrderCount);
+}
+
+TEST(TraceIsValidJson)
+{
+	Tracer::Clear();
+	std::thread recorder([]() {
+		Tracer::SetThreadName("Thread \"with\" \\ quotes");
+		Tracer::AddEvent("Quoted \"name\" with \\ backslash", 1234567, 1240000);
+		Tracer::AddEvent("Name with\ttab and\nnewline", 2000000, 2000001);
+	});
+	recorder.join();
+	PARSED_TRACE trace = ExportTrace();
+	CHECK(trace.IsValid);
+	std::vector<PARSED_EVENT> quoted = trace.GetEvents("Quoted \"name\" with \\ backslash");
+	CHECK_EQUAL(1u, quoted.size());
+	if (quoted.size() == 1) {
+		//Microseconds with nanosecond precision.
+		CHECK(IsNear(1234.567, quoted[0].TimestampMicros));
+		CHECK(IsNear(5.433, quoted[0].DurationMicros));
+	}
+	std::vector<PARSED_EVENT> controlCharacters = trace.GetEvents("Name with\ttab and\nnewline");
+	CHECK_EQUAL(1u, controlCharacters.size());
+	if (controlCharacters.size() == 1) {
+		CHECK(IsNear(0.001, controlCharacters[0].DurationMicros));
+	}
+	bool isThreadNamed = false;
+	for (const auto &threadName : trace.ThreadNames) {
+		if (!quoted.empty() && threadName.first == quoted[0].ThreadId) {
+			isThreadNamed = threadName.second == "Thread \"with\" \\ quotes";
+		}
+	}
+	CHECK(isThreadNamed);
+}
+
+TEST(TraceCanBeWrittenWhileThreadsRecord)
+{
+	Tracer::Clear();
+	std::atomic<bool> isStopping(false);
+	const char *names[] = { "Recorder0", "Recorder1", "Recorder2", "Recorder3" };
+	std::vector<std::thread> recorders;
+	for (const char *name : names) {
+		recorders.emplace_back([&, name]() {
+			//Each event lasts 1 microsecond and starts 2 microseconds after the previous one, so a torn event shows as a wrong duration or a gap.
+			for (int64_t i = 0; !isStopping.load(); i++) {
+				Tracer::AddEvent(name, i * 2000, i * 2000 + 1000);
+			}
+		});
+	}
+	int invalidTraceCount = 0;
+	int tornEventCount = 0;
+	for (int dump = 0; dump < 20; dump++) {
+		PARSED_TRACE trace = ExportTrace();
+		invalidTraceCount += trace.IsValid ? 0 : 1;
+		for (const char *name : names) {
+			std::vector<PARSED_EVENT> events = trace.GetEvents(name);
+			for (size_t i = 0; i < events.size(); i++) {
+				const bool isIntact = IsNear(1.0, events[i].DurationMicros) && (i == 0 || IsNear(events[i - 1].TimestampMicros + 2.0, events[i].TimestampMicros));
+				tornEventCount += isIntact ? 0 : 1;
+			}
+		}
+	}
+	isStopping = true;
+	for (std::thread &recorder : recorders) {
+		recorder.join();
+	}
+	CHECK_EQUAL(0, invalidTraceCount);
+	CHECK_EQUAL(0, tornEventCount);
+}
+
+TEST(ClearDiscardsEventsAndExitedThreads)
+{
+	Tracer::Clear();
+	std::thread recorder([]() {
+		Tracer::SetThreadName("ExitedRecorder");
+		Tracer::AddEvent("ExitedEvent", 0, 1000);
+	});
+	recorder.join();
+	Tracer::AddEvent("LiveEvent", 0, 1000);
+	//The events of a thread that has exited are still exported.
+	PARSED_TRACE trace = ExportTrace();
+	CHECK_EQUAL(1u, trace.GetEvents("ExitedEvent").size());
+	CHECK_EQUAL(1u, trace.GetEvents("LiveEvent").size());
+	Tracer::Clear();
+	trace = ExportTrace();
+	CHECK(trace.IsValid);
+	CHECK_EQUAL(0u, trace.GetEvents("ExitedEvent").size());
+	CHECK_EQUAL(0u, trace.GetEvents("LiveEvent").size());
+	bool isExitedThreadNamed = false;
+	for (const auto &threadName : trace.ThreadNames) {
+		isExitedThreadNamed = isExitedThreadNamed || threadName.second == "ExitedRecorder";
+	}
+	CHECK(!isExitedThreadNamed);
+	//The buffer of the live thread is kept, and records again.
+	Tracer::AddEvent("LiveEvent", 2000, 3000);
+	CHECK_EQUAL(1u, ExportTrace().GetEvents("LiveEvent").size());
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "Test.h"
+#include "WriteCoalescer.h"
+#include <chrono>
+#include <cstring>
+#include <random>
+
+namespace {
+	class MemoryTarget : public CoalescedWriteTarget
+	{
+	public:
+		std::vector<uint8_t> &Data;
+		uint64_t Position;
+		//The number of writes that succeed before the others fail, or -1 if none fail.
+		int FailAfterWriteCount;
+		std::chrono::milliseconds WriteDelay;
+
+		MemoryTarget(std::vector<uint8_t> &data) :
+			Data(data),
+			Position(0),
+			FailAfterWriteCount(-1),
+			WriteDelay(0)
+		{
+		}
+		bool Seek(uint64_t position) override {
+			Position = position;
+			return true;
+		}
+		bool Write(const uint8_t *pData, size_t size) override {
+			if (FailAfterWriteCount == 0) {
+				return false;
+			}
+			if (FailAfterWriteCount > 0) {
+				FailAfterWriteCount--;
+			}
+			std::this_thread::sleep_for(WriteDelay);
+			if (Data.size() < Position + size) {
+				Data.resize(static_cast<size_t>(Position + size));
+			}
+			std::memcpy(Data.data() + Position, pData, size);
+			Position += size;
+			return true;
+		}
+	};
+
+	std::vector<uint8_t> CreateData(size_t size, uint8_t first) {
+		std::vector<uint8_t> data(size);
+		for (size_t i = 0; i < size; i++) {
+			data[i] = static_cast<uint8_t>(first + i);
+		}
+		return data;
+	}
+}
+
+TEST(SmallWritesAreBatched)
+{
+	std::vector<uint8_t> file{};
+	WriteCoalescer coalescer(std::make_unique<MemoryTarget>(file), 0, 100, 2);
+	std::vector<uint8_t> expected{};
+	for (int i = 0; i < 25; i++) {
+		std::vector<uint8_t> data = CreateData(10, static_cast<uint8_t>(i * 10));
+		CHECK(coalescer.Write(data.data(), data.size()));
+		expected.insert(expected.end(), data.begin(), data.end());
+	}
+	CHECK_EQUAL(250u, coalescer.GetPosition());
+	CHECK_EQUAL(250u, coalescer.GetBufferedEndPosition());
+	CHECK(coalescer.Flush());
+	CHECK(file == expected);
+	CHECK_EQUAL(0u, coalescer.GetBufferedEndPosition());
+	WRITE_COALESCER_STATISTICS stats = coalescer.GetStatistics();
+	CHECK_EQUAL(25u, stats.WriteCount);
+	CHECK_EQUAL(250u, stats.ByteCount);
+	//Two full buffers and the rest, at the position the target was at.
+	CHECK_EQUAL(3u, stats.TargetWriteCount);
+	CHECK_EQUAL(0u, stats.TargetSeekCount);
+}
+
+TEST(LaterWritesOverwriteEarlierOnes)
+{
+	std::vector<uint8_t> file{};
+	WriteCoalescer coalescer(std::make_unique<MemoryTarget>(file), 0, 64, 3);
+	//A header whose size is only known at the end, like the media data box of an MP4 file.
+	std::vector<uint8_t> header(8, 0);
+	std::vector<uint8_t> body = CreateData(1000, 1);
+	CHECK(coalescer.Write(header.data(), header.size()));
+	CHECK(coalescer.Write(body.data(), body.size()));
+	std::vector<uint8_t> size{ 0, 0, 0x03, 0xF0 };
+	coalescer.SetPosition(0);
+	CHECK(coalescer.Write(size.data(), size.size()));
+	CHECK_EQUAL(4u, coalescer.GetPosition());
+	CHECK_EQUAL(1008u, coalescer.GetBufferedEndPosition());
+	CHECK(coalescer.Flush());
+	std::vector<uint8_t> expected = size;
+	expected.insert(expected.end(), 4, 0);
+	expected.insert(expected.end(), body.begin(), body.end());
+	CHECK(file == expected);
+	CHECK_EQUAL(1u, coalescer.GetStatistics().TargetSeekCount);
+	//The position of the target is not assumed after a flush, so the next write seeks it.
+	coalescer.SetPosition(1008);
+	CHECK(coalescer.Write(size.data(), size.size()));
+	CHECK(coalescer.Flush());
+	CHECK_EQUAL(1012u, file.size());
+	CHECK_EQUAL(2u, coalescer.GetStatistics().TargetSeekCount);
+}
+
+TEST(RandomWritesMatchDirectWrites)
+{
+	std::mt19937 random(1);
+	for (int iteration = 0; iteration < 50; iteration++) {
+		std::vector<uint8_t> file{};
+		std::vector<uint8_t> expected{};
+		{
+			WriteCoalescer coalescer(std::make_unique<MemoryTarget>(file), 0, 1 + random() % 5000, 1 + random() % 4);
+			uint64_t position = 0;
+			for (int i = 0; i < 300; i++) {
+				const uint32_t operation = random() % 20;
+				if (operation == 0) {
+					position = expected.empty() ? 0 : random() % expected.size();
+					coalescer.SetPosition(position);
+				}
+				else if (operation == 1) {
+					CHECK(coalescer.Flush());
+					CHECK(file == expected);
+				}
+				else {
+					//Mostly small writes, and some larger than the buffers.
+					std::vector<uint8_t> data = CreateData(random() % (operation == 2 ? 20000 : 300), static_cast<uint8_t>(random()));
+					CHECK(coalescer.Write(data.data(), data.size()));
+					if (expected.size() < position + data.size()) {
+						expected.resize(static_cast<size_t>(position + data.size()));
+					}
+					std::copy(data.begin(), data.end(), expected.begin() + position);
+					position += data.size();
+					CHECK_EQUAL(position, coalescer.GetPosition());
+				}
+			}
+		}
+		//The buffered data is written when the coalescer is destroyed.
+		CHECK(file == expected);
+	}
+}
+
+TEST(FullBuffersWaitForTarget)
+{
+	std::vector<uint8_t> file{};
+	std::unique_ptr<MemoryTarget> pTarget = std::make_unique<MemoryTarget>(file);
+	pTarget->WriteDelay = std::chrono::milliseconds(10);
+	WriteCoalescer coalescer(std::move(pTarget), 0, 10, 1);
+	std::vector<uint8_t> data = CreateData(50, 0);
+	CHECK(coalescer.Write(data.data(), data.size()));
+	CHECK(coalescer.Flush());
+	CHECK(file == data);
+	WRITE_COALESCER_STATISTICS stats = coalescer.GetStatistics();
+	CHECK_EQUAL(5u, stats.TargetWriteCount);
+	CHECK(stats.WaitCount >= 1);
+}
+
+TEST(FailedWriteIsReported)
+{
+	std::vector<uint8_t> file{};
+	std::unique_ptr<MemoryTarget> pTarget = std::make_unique<MemoryTarget>(file);
+	pTarget->FailAfterWriteCount = 2;
+	WriteCoalescer coalescer(std::move(pTarget), 0, 100, 2);
+	std::vector<uint8_t> data(50);
+	bool isWritten = true;
+	for (int i = 0; i < 100 && isWritten; i++) {
+		isWritten = coalescer.Write(data.data(), data.size());
+	}
+	CHECK(!isWritten || !coalescer.Flush());
+	CHECK(!coalescer.Flush());
+	CHECK(!coalescer.Write(data.data(), data.size()));
+	CHECK_EQUAL(200u, file.size());
+}
\ No newline at end of file